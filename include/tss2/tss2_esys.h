@@ -3302,6 +3302,61 @@ Esys_GetSysContext(
     ESYS_CONTEXT *esys_context,
     TSS2_SYS_CONTEXT **sys_context);
 
+/*
+ * TPM 2.0 ESAPI Metrics
+ */
+
+/** Number of buckets of the latency histograms.
+ *
+ * Bucket 0 counts latencies below 1 microsecond, bucket i latencies from
+ * 2^(i-1) up to 2^i microseconds. The last bucket counts all longer latencies.
+ */
+#define ESYS_METRICS_BUCKETS 24
+
+/** Maximum number of command codes returned by Esys_GetMetrics().
+ *
+ * The value is fixed and does not follow the range of command codes known to
+ * the library, so the size of ESYS_METRICS does not change if commands are
+ * added.
+ */
+#define ESYS_METRICS_MAX_COMMANDS 256
+
+/** The metrics recorded for one TPM command code.
+ *
+ * The latency of a command is split into the client side processing of ESYS
+ * (marshaling, cpHash and rpHash computation, HMACs and parameter
+ * encryption) and the time waiting for the TPM.
+ */
+typedef struct ESYS_COMMAND_METRICS ESYS_COMMAND_METRICS;
+struct ESYS_COMMAND_METRICS {
+    TPM2_CC commandCode;              /**< The command code */
+    UINT64 calls;                     /**< Number of executed commands */
+    UINT64 resubmissions;             /**< Number of automatic resubmissions */
+    UINT64 bytesSent;                 /**< Bytes sent including resubmissions */
+    UINT64 bytesReceived;             /**< Bytes received including resubmissions */
+    UINT64 clientNs;                  /**< Total client side processing time */
+    UINT64 tpmNs;                     /**< Total time waiting for the TPM */
+    UINT64 clientHistogram[ESYS_METRICS_BUCKETS]; /**< Client side latencies */
+    UINT64 tpmHistogram[ESYS_METRICS_BUCKETS];    /**< TPM latencies */
+};
+
+/** The metrics of all commands executed since metrics were enabled. */
+typedef struct ESYS_METRICS ESYS_METRICS;
+struct ESYS_METRICS {
+    UINT32 count;                     /**< Number of used entries */
+    ESYS_COMMAND_METRICS commands[ESYS_METRICS_MAX_COMMANDS]; /**< Entries ordered by command code */
+};
+
+TSS2_RC
+Esys_SetMetrics(
+    ESYS_CONTEXT *esys_context,
+    TPMI_YES_NO enable);
+
+TSS2_RC
+Esys_GetMetrics(
+    ESYS_CONTEXT *esys_context,
+    ESYS_METRICS **metrics);
+
 #ifdef __cplusplus
 }
 #endif
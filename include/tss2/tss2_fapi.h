@@ -147,6 +147,25 @@ TSS2_RC Fapi_List_Finish(
     FAPI_CONTEXT   *context,
     char          **pathList);
 
+TSS2_RC Fapi_ListNext(
+    FAPI_CONTEXT   *context,
+    char     const *searchPath,
+    char     const *cursor,
+    size_t          pageSize,
+    char          **pathList,
+    char          **nextCursor);
+
+TSS2_RC Fapi_ListNext_Async(
+    FAPI_CONTEXT   *context,
+    char     const *searchPath,
+    char     const *cursor,
+    size_t          pageSize);
+
+TSS2_RC Fapi_ListNext_Finish(
+    FAPI_CONTEXT   *context,
+    char          **pathList,
+    char          **nextCursor);
+
 TSS2_RC Fapi_Delete(
     FAPI_CONTEXT   *context,
     char     const *path);
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef TSS2_TCTI_MUX_H
+#define TSS2_TCTI_MUX_H
+
+#include <stdint.h>
+
+#include "tss2_tcti.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSS2_TCTI_MUX_PRIORITY_LOW     0
+#define TSS2_TCTI_MUX_PRIORITY_NORMAL  128
+#define TSS2_TCTI_MUX_PRIORITY_HIGH    255
+
+TSS2_RC Tss2_Tcti_Mux_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf);
+
+TSS2_RC Tss2_Tcti_Mux_ClientInit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    TSS2_TCTI_CONTEXT *muxContext);
+
+TSS2_RC Tss2_Tcti_Mux_SetPriority (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSS2_TCTI_MUX_H */
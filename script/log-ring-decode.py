@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+"""Print the records of a trace file written by the log ring backend.
+
+The file is written when TSS2_LOG_RING is set, see doc/logging.md. It holds
+one segment per thread and library; the records of all segments are printed
+in the order of their timestamps.
+"""
+import argparse
+import datetime
+import struct
+import sys
+
+MAGIC = b'TSS2RING'
+VERSION = 1
+
+# log_ring_header and log_ring_record of src/util/log-ring.h
+HEADER = struct.Struct('=8sIII4xQQQ')
+RECORD = struct.Struct('=QQIIBB6x16s32s32s96s48s')
+
+LEVELS = {
+    0: 'none',
+    2: 'ERROR',
+    3: 'WARNING',
+    4: 'info',
+    5: 'debug',
+    6: 'trace',
+}
+
+
+def cstring(field):
+    return field.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+
+def read_segments(data):
+    """Yield (header, records) for each segment of the file."""
+    offset = 0
+    while offset < len(data):
+        if len(data) - offset < HEADER.size:
+            raise ValueError('truncated header at offset %d' % offset)
+        magic, version, record_size, pid, thread, count, dropped = \
+            HEADER.unpack_from(data, offset)
+        if magic != MAGIC:
+            raise ValueError('bad magic at offset %d' % offset)
+        if version != VERSION or record_size != RECORD.size:
+            raise ValueError('unsupported segment version %d record size %d'
+                             % (version, record_size))
+        offset += HEADER.size
+        if len(data) - offset < count * RECORD.size:
+            raise ValueError('truncated segment at offset %d' % offset)
+        records = []
+        for _ in range(count):
+            (seq, timestamp, line, blob_size, level, blob_len, module, file,
+             func, msg, blob) = RECORD.unpack_from(data, offset)
+            offset += RECORD.size
+            # Records written while a fatal signal was handled may be
+            # incomplete.
+            if seq == 0:
+                continue
+            records.append({
+                'pid': pid,
+                'thread': thread,
+                'seq': seq,
+                'timestamp': timestamp,
+                'line': line,
+                'level': LEVELS.get(level, str(level)),
+                'module': cstring(module),
+                'file': cstring(file),
+                'func': cstring(func),
+                'msg': cstring(msg),
+                'blob': blob[:blob_len] if blob_size else None,
+                'blob_size': blob_size,
+            })
+        yield (pid, thread, dropped), records
+
+
+def hexdump(blob, out):
+    for i in range(0, len(blob), 16):
+        line = blob[i:i + 16]
+        text = ''.join(chr(c) if 0x21 <= c < 0x7f else '.' for c in line)
+        out.write('    %04x: %-32s  %s\n' % (i, line.hex(), text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('file', help='trace file named by TSS2_LOG_RING')
+    parser.add_argument('--no-blobs', action='store_true',
+                        help='do not print the stored start of blobs')
+    args = parser.parse_args()
+
+    with open(args.file, 'rb') as f:
+        data = f.read()
+
+    records = []
+    for (pid, thread, dropped), segment in read_segments(data):
+        if dropped:
+            sys.stderr.write('%d/%d: %d records dropped\n'
+                             % (pid, thread, dropped))
+        records.extend(segment)
+    records.sort(key=lambda r: (r['timestamp'], r['pid'], r['thread'],
+                                r['seq']))
+
+    out = sys.stdout
+    for r in records:
+        time = datetime.datetime.fromtimestamp(r['timestamp'] / 1e9)
+        out.write('%s.%09d [%d/%d] %s:%s:%s:%d:%s() %s\n' % (
+            time.strftime('%Y-%m-%d %H:%M:%S'), r['timestamp'] % 1000000000,
+            r['pid'], r['thread'], r['level'], r['module'], r['file'], r['line'],
+            r['func'], r['msg']))
+        if r['blob'] is not None:
+            out.write('    (size=%d, %d bytes stored)\n'
+                      % (r['blob_size'], len(r['blob'])))
+            if not args.no_blobs:
+                hexdump(r['blob'], out)
+
+
+if __name__ == '__main__':
+    main()
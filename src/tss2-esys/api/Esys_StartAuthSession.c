@@ -278,7 +278,7 @@ Esys_StartAuthSession_Async(
     }
 
     /* Trigger execution and finish the async invocation */
-    r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+    r = iesys_execute_async(esysContext);
     return_state_if_error(r, _ESYS_STATE_INTERNALERROR,
                           "Finish (Execute Async)");
 
@@ -357,7 +357,7 @@ Esys_StartAuthSession_Finish(
     rsrc->misc.rsrc_session.nonceCaller = esysContext->in.StartAuthSession.nonceCallerData;
 
     /* Receive the TPM response and handle resubmissions if necessary. */
-    r = Tss2_Sys_ExecuteFinish(esysContext->sys, esysContext->timeout);
+    r = iesys_execute_finish(esysContext);
     if (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN) {
         LOG_DEBUG("A layer below returned TRY_AGAIN: %" PRIx32, r);
         esysContext->state = _ESYS_STATE_SENT;
@@ -374,7 +374,7 @@ Esys_StartAuthSession_Finish(
             goto error_cleanup;
         }
         esysContext->state = _ESYS_STATE_RESUBMISSION;
-        r = Tss2_Sys_ExecuteAsync(esysContext->sys);
+        r = iesys_execute_async(esysContext);
         if (r != TSS2_RC_SUCCESS) {
             LOG_WARNING("Error attempting to resubmit");
             /* We do not set esysContext->state here but inherit the most recent
@@ -472,7 +472,8 @@ Esys_StartAuthSession_Finish(
                                        &bindNode->auth,
                                        &sessionHandleNode->rsrc.misc.rsrc_session.bound_entity);
         LOGBLOB_DEBUG(secret, secret_size, "ESYS Session Secret");
-        r = iesys_crypto_KDFa(esysContext->in.StartAuthSession.authHash, secret,
+        r = iesys_crypto_KDFa(&esysContext->crypto_pool,
+                              esysContext->in.StartAuthSession.authHash, secret,
                               secret_size, "ATH",
                                &lnonceTPM, esysContext->in.StartAuthSession.nonceCaller,
                                authHash_size*8, NULL,
@@ -139,6 +139,9 @@ Esys_Finalize(ESYS_CONTEXT ** esys_context)
         Tss2_TctiLdr_Finalize(&tctcontext);
     }
 
+    iesys_crypto_pool_free(&(*esys_context)->crypto_pool);
+    free((*esys_context)->metrics);
+
     /* Free esys_context */
     free(*esys_context);
     *esys_context = NULL;
@@ -220,6 +223,85 @@ Esys_SetTimeout(ESYS_CONTEXT * esys_context, int32_t timeout)
     return TSS2_RC_SUCCESS;
 }
 
+/** Enable or disable the recording of command metrics.
+ *
+ * If enabled, the number of calls, resubmissions, bytes transferred and the
+ * latencies are recorded per TPM command code. The latency is split into the
+ * client side processing of ESYS and the time waiting for the TPM. Enabling
+ * the metrics again resets all recorded values.
+ * @param esys_context [in] The ESYS_CONTEXT.
+ * @param enable [in] TPM2_YES to record metrics, TPM2_NO to stop recording
+ *        and to release the recorded metrics.
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if a command is in progress.
+ * @retval TSS2_ESYS_RC_MEMORY if memory for the metrics can't be allocated.
+ */
+TSS2_RC
+Esys_SetMetrics(ESYS_CONTEXT *esys_context, TPMI_YES_NO enable)
+{
+    _ESYS_ASSERT_NON_NULL(esys_context);
+
+    if (esys_context->state != _ESYS_STATE_INIT) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Command in progress.");
+    }
+
+    if (enable == TPM2_NO) {
+        SAFE_FREE(esys_context->metrics);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (!esys_context->metrics) {
+        esys_context->metrics = calloc(1, sizeof(IESYS_METRICS));
+        return_if_null(esys_context->metrics, "Out of memory.",
+                       TSS2_ESYS_RC_MEMORY);
+    } else {
+        memset(esys_context->metrics, 0, sizeof(IESYS_METRICS));
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Retrieve the metrics recorded since Esys_SetMetrics().
+ *
+ * Only command codes which were executed are returned. Vendor specific
+ * commands are not recorded.
+ * @param esys_context [in] The ESYS_CONTEXT.
+ * @param metrics [out] The recorded metrics ordered by command code
+ *        (callee-allocated, use Esys_Free()).
+ * @retval TSS2_RC_SUCCESS on Success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE if esysContext or metrics is NULL.
+ * @retval TSS2_ESYS_RC_BAD_SEQUENCE if the recording of metrics is not
+ *         enabled.
+ * @retval TSS2_ESYS_RC_MEMORY if memory for the metrics can't be allocated.
+ */
+TSS2_RC
+Esys_GetMetrics(ESYS_CONTEXT *esys_context, ESYS_METRICS **metrics)
+{
+    ESYS_COMMAND_METRICS *cmd;
+
+    _ESYS_ASSERT_NON_NULL(esys_context);
+    _ESYS_ASSERT_NON_NULL(metrics);
+
+    if (!esys_context->metrics) {
+        return_error(TSS2_ESYS_RC_BAD_SEQUENCE, "Metrics are not enabled.");
+    }
+
+    /* The last command is complete if no other command is in progress. */
+    if (esys_context->state == _ESYS_STATE_INIT)
+        iesys_metrics_commit(esys_context);
+
+    *metrics = calloc(1, sizeof(ESYS_METRICS));
+    return_if_null(*metrics, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+    for (size_t i = 0; i < IESYS_METRICS_COMMANDS &&
+             (*metrics)->count < ESYS_METRICS_MAX_COMMANDS; i++) {
+        cmd = &esys_context->metrics->commands[i];
+        if (cmd->calls)
+            (*metrics)->commands[(*metrics)->count++] = *cmd;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 /** Helper function that returns sys contest from the give esys context.
  *
  * Function returns sys contest from the give esys context.
@@ -66,6 +66,8 @@ iesys_crypto_hash_get_digest_size(TPM2_ALG_ID hashAlg, size_t * size)
  * authorization of commands, or for the HMAC used for checking the responses.
  * The name parameters are only used for the command parameter hash (cp) and
  * must be NULL for the computation of the response parameter rp hash (rp).
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
  * @param[in] alg The hash algorithm.
  * @param[in] rcBuffer The response code in marshaled form.
  * @param[in] ccBuffer The command code in marshaled form.
@@ -80,7 +82,8 @@ iesys_crypto_hash_get_digest_size(TPM2_ALG_ID hashAlg, size_t * size)
  */
 
 TSS2_RC
-iesys_crypto_pHash(TPM2_ALG_ID alg,
+iesys_crypto_pHash(IESYS_CRYPTO_POOL **pool,
+                   TPM2_ALG_ID alg,
                    const uint8_t rcBuffer[4],
                    const uint8_t ccBuffer[4],
                    const TPM2B_NAME * name1,
@@ -98,7 +101,7 @@ iesys_crypto_pHash(TPM2_ALG_ID alg,
 
     IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
 
-    TSS2_RC r = iesys_crypto_hash_start(&cryptoContext, alg);
+    TSS2_RC r = iesys_crypto_hash_start_pooled(pool, &cryptoContext, alg);
     return_if_error(r, "Error");
 
     if (rcBuffer != NULL) {
@@ -142,6 +145,8 @@ iesys_crypto_pHash(TPM2_ALG_ID alg,
  * Based on the session nonces, caller nonce, TPM nonce, if used encryption and
  * decryption nonce, the command parameter hash, and the session attributes the
  * HMAC used for authorization is computed.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
  * @param[in] alg The hash algorithm used for HMAC computation.
  * @param[in] hmacKey The HMAC key byte buffer.
  * @param[in] hmacKeySize The size of the HMAC key byte buffer.
@@ -158,7 +163,8 @@ iesys_crypto_pHash(TPM2_ALG_ID alg,
  * @retval TSS2_ESYS_RC_BAD_REFERENCE If a pointer is invalid.
  */
 TSS2_RC
-iesys_crypto_authHmac(TPM2_ALG_ID alg,
+iesys_crypto_authHmac(IESYS_CRYPTO_POOL **pool,
+                      TPM2_ALG_ID alg,
                       uint8_t * hmacKey, size_t hmacKeySize,
                       const uint8_t * pHash,
                       size_t pHash_size,
@@ -180,8 +186,8 @@ iesys_crypto_authHmac(TPM2_ALG_ID alg,
 
     IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
 
-    TSS2_RC r =
-        iesys_crypto_hmac_start(&cryptoContext, alg, hmacKey, hmacKeySize);
+    TSS2_RC r = iesys_crypto_hmac_start_pooled(pool, &cryptoContext, alg,
+                                               hmacKey, hmacKeySize);
     return_if_error(r, "Error");
 
     r = iesys_crypto_hmac_update(cryptoContext, pHash, pHash_size);
@@ -224,10 +230,60 @@ iesys_crypto_authHmac(TPM2_ALG_ID alg,
 
 }
 
+/**
+ * Feed the data of one iteration of KDFa into an HMAC context.
+ *
+ * @param[in,out] cryptoContext The HMAC context keyed with the KDFa key.
+ * @param[in] counter The curren iteration step.
+ * @param[in] label Indicates the use of the produced key.
+ * @param[in] contextU, contextV are used for construction of a binary string
+ *            containing information related to the derived key.
+ * @param[in] bitlength The size of the generated key in bits.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ */
+static TSS2_RC
+iesys_crypto_KDFaHmac_update(IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext,
+                             uint32_t counter,
+                             const char *label,
+                             TPM2B_NONCE * contextU,
+                             TPM2B_NONCE * contextV,
+                             uint32_t bitlength)
+{
+    uint8_t buffer32[sizeof(uint32_t)];
+    size_t buffer32_size = 0;
+
+    TSS2_RC r = Tss2_MU_UINT32_Marshal(counter, &buffer32[0], sizeof(UINT32),
+                                       &buffer32_size);
+    return_if_error(r, "Marsahling");
+    r = iesys_crypto_hmac_update(cryptoContext, &buffer32[0], buffer32_size);
+    return_if_error(r, "HMAC-Update");
+
+    if (label != NULL) {
+        size_t lsize = strlen(label) + 1;
+        r = iesys_crypto_hmac_update(cryptoContext, (uint8_t *) label, lsize);
+        return_if_error(r, "Error");
+    }
+
+    r = iesys_crypto_hmac_update2b(cryptoContext, (TPM2B *) contextU);
+    return_if_error(r, "Error");
+
+    r = iesys_crypto_hmac_update2b(cryptoContext, (TPM2B *) contextV);
+    return_if_error(r, "Error");
+
+    buffer32_size = 0;
+    r = Tss2_MU_UINT32_Marshal(bitlength, &buffer32[0], sizeof(UINT32),
+                               &buffer32_size);
+    return_if_error(r, "Marsahling");
+    return iesys_crypto_hmac_update(cryptoContext, &buffer32[0], buffer32_size);
+}
+
 /**
  * HMAC computation for inner loop of KDFa key derivation.
  *
  * Except of ECDH this function is used for key derivation.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
  * @param[in] alg The algorithm used for the HMAC.
  * @param[in] hmacKey The hmacKey used in KDFa.
  * @param[in] hmacKeySize The size of the HMAC key.
@@ -242,7 +298,8 @@ iesys_crypto_authHmac(TPM2_ALG_ID alg,
  * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
  */
 TSS2_RC
-iesys_crypto_KDFaHmac(TPM2_ALG_ID alg,
+iesys_crypto_KDFaHmac(IESYS_CRYPTO_POOL **pool,
+                      TPM2_ALG_ID alg,
                       uint8_t * hmacKey,
                       size_t hmacKeySize,
                       uint32_t counter,
@@ -257,38 +314,14 @@ iesys_crypto_KDFaHmac(TPM2_ALG_ID alg,
         return TSS2_ESYS_RC_BAD_REFERENCE;
     }
 
-    uint8_t buffer32[sizeof(uint32_t)];
-    size_t buffer32_size = 0;
-
     IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
 
-    TSS2_RC r =
-        iesys_crypto_hmac_start(&cryptoContext, alg, hmacKey, hmacKeySize);
+    TSS2_RC r = iesys_crypto_hmac_start_pooled(pool, &cryptoContext, alg,
+                                               hmacKey, hmacKeySize);
     return_if_error(r, "Error");
 
-    r = Tss2_MU_UINT32_Marshal(counter, &buffer32[0], sizeof(UINT32),
-                               &buffer32_size);
-    goto_if_error(r, "Marsahling", error);
-    r = iesys_crypto_hmac_update(cryptoContext, &buffer32[0], buffer32_size);
-    goto_if_error(r, "HMAC-Update", error);
-
-    if (label != NULL) {
-        size_t lsize = strlen(label) + 1;
-        r = iesys_crypto_hmac_update(cryptoContext, (uint8_t *) label, lsize);
-        goto_if_error(r, "Error", error);
-    }
-
-    r = iesys_crypto_hmac_update2b(cryptoContext, (TPM2B *) contextU);
-    goto_if_error(r, "Error", error);
-
-    r = iesys_crypto_hmac_update2b(cryptoContext, (TPM2B *) contextV);
-    goto_if_error(r, "Error", error);
-
-    buffer32_size = 0;
-    r = Tss2_MU_UINT32_Marshal(bitlength, &buffer32[0], sizeof(UINT32),
-                               &buffer32_size);
-    goto_if_error(r, "Marsahling", error);
-    r = iesys_crypto_hmac_update(cryptoContext, &buffer32[0], buffer32_size);
+    r = iesys_crypto_KDFaHmac_update(cryptoContext, counter, label, contextU,
+                                     contextV, bitlength);
     goto_if_error(r, "Error", error);
 
     r = iesys_crypto_hmac_finish(&cryptoContext, hmac, hmacSize);
@@ -301,10 +334,161 @@ iesys_crypto_KDFaHmac(TPM2_ALG_ID alg,
     return r;
 }
 
+/**
+ * XOR a byte buffer with a key stream.
+ *
+ * The buffers are processed in machine words, which the compiler can turn
+ * into vector instructions; the rest is processed byte by byte.
+ * @param[in,out] data The data to be XORed.
+ * @param[in] mask The key stream.
+ * @param[in] size The number of bytes to be XORed.
+ */
+static void
+iesys_xor_bytes(BYTE *data, const BYTE *mask, size_t size)
+{
+    uint64_t d, m;
+    size_t i = 0;
+
+    for (; i + sizeof(d) <= size; i += sizeof(d)) {
+        memcpy(&d, &data[i], sizeof(d));
+        memcpy(&m, &mask[i], sizeof(m));
+        d ^= m;
+        memcpy(&data[i], &d, sizeof(d));
+    }
+    for (; i < size; i++)
+        data[i] ^= mask[i];
+}
+
+/**
+ * Generate the key stream of KDFa with a keyed HMAC context.
+ *
+ * The HMAC is restarted from the keyed state for every counter block instead
+ * of being keyed again for each block. The context stays keyed afterwards.
+ * @param[in,out] cryptoContext The HMAC context keyed with the KDFa key.
+ * @param[in] hlen The digest size of the HMAC.
+ * @param[in] label Indicates the use of the produced key.
+ * @param[in] contextU, contextV are used for construction of a binary string
+ *            containing information related to the derived key.
+ * @param[in] bitLength The bit length passed to the KDFa iterations.
+ * @param[in,out] counter The counter of the last KDFa iteration, which will be
+ *                set to the counter of the last generated block.
+ * @param[in,out] out The buffer for the key stream or the data to be XORed
+ *                with the key stream. If the key stream is stored, the buffer
+ *                has to be large enough for complete digests.
+ * @param[in] size The number of bytes to be generated.
+ * @param[in] xor_data Indicates whether out is XORed with the key stream or
+ *            the key stream is stored in out.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+static TSS2_RC
+iesys_crypto_KDFa_blocks(IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext,
+                         size_t hlen,
+                         const char *label,
+                         TPM2B_NONCE * contextU,
+                         TPM2B_NONCE * contextV,
+                         uint32_t bitLength,
+                         uint32_t * counter,
+                         BYTE * out,
+                         size_t size,
+                         BOOL xor_data)
+{
+    TSS2_RC r;
+    BYTE block[sizeof(TPMU_HA)];
+    BYTE *digest;
+    size_t digest_size;
+
+    while (size > 0) {
+        *counter += 1;
+        r = iesys_crypto_KDFaHmac_update(cryptoContext, *counter, label,
+                                         contextU, contextV, bitLength);
+        return_if_error(r, "Error");
+
+        digest = xor_data ? &block[0] : out;
+        digest_size = hlen;
+        r = iesys_crypto_hmac_finish_restart(cryptoContext, digest,
+                                             &digest_size);
+        return_if_error(r, "Error");
+
+        digest_size = size < hlen ? size : hlen;
+        if (xor_data)
+            iesys_xor_bytes(out, &block[0], digest_size);
+        out += digest_size;
+        size -= digest_size;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/**
+ * Generate the key stream of KDFa.
+ *
+ * The HMAC is keyed once for all counter blocks.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
+ * @param[in] hashAlg The hash algorithm to use.
+ * @param[in] hmacKey The hmacKey used in KDFa.
+ * @param[in] hmacKeySize The size of the HMAC key.
+ * @param[in] label Indicates the use of the produced key.
+ * @param[in] contextU, contextV are used for construction of a binary string
+ *            containing information related to the derived key.
+ * @param[in] bitLength The bit length passed to the KDFa iterations.
+ * @param[in,out] counter The counter of the last KDFa iteration, which will be
+ *                set to the counter of the last generated block.
+ * @param[in,out] out The buffer for the key stream or the data to be XORed
+ *                with the key stream. If the key stream is stored, the buffer
+ *                has to be large enough for complete digests.
+ * @param[in] size The number of bytes to be generated.
+ * @param[in] xor_data Indicates whether out is XORed with the key stream or
+ *            the key stream is stored in out.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if hashAlg is unknown or unsupported.
+ */
+static TSS2_RC
+iesys_crypto_KDFa_stream(IESYS_CRYPTO_POOL **pool,
+                         TPM2_ALG_ID hashAlg,
+                         uint8_t * hmacKey,
+                         size_t hmacKeySize,
+                         const char *label,
+                         TPM2B_NONCE * contextU,
+                         TPM2B_NONCE * contextV,
+                         uint32_t bitLength,
+                         uint32_t * counter,
+                         BYTE * out,
+                         size_t size,
+                         BOOL xor_data)
+{
+    TSS2_RC r;
+    IESYS_CRYPTO_CONTEXT_BLOB *cryptoContext;
+    size_t hlen;
+
+    if (hmacKey == NULL || contextU == NULL || contextV == NULL) {
+        LOG_ERROR("Null-Pointer passed");
+        return TSS2_ESYS_RC_BAD_REFERENCE;
+    }
+    r = iesys_crypto_hash_get_digest_size(hashAlg, &hlen);
+    return_if_error(r, "Error");
+    if (size == 0)
+        return TSS2_RC_SUCCESS;
+
+    r = iesys_crypto_hmac_start_pooled(pool, &cryptoContext, hashAlg,
+                                       hmacKey, hmacKeySize);
+    return_if_error(r, "Error");
+
+    r = iesys_crypto_KDFa_blocks(cryptoContext, hlen, label, contextU,
+                                 contextV, bitLength, counter, out, size,
+                                 xor_data);
+    iesys_crypto_hmac_abort(&cryptoContext);
+    return r;
+}
+
 /**
  * KDFa Key derivation.
  *
  * Except of ECDH this function is used for key derivation.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
  * @param[in] hashAlg The hash algorithm to use.
  * @param[in] hmacKey The hmacKey used in KDFa.
  * @param[in] hmacKeySize The size of the HMAC key.
@@ -323,7 +507,8 @@ iesys_crypto_KDFaHmac(TPM2_ALG_ID alg,
  * @retval TSS2_ESYS_RC_BAD_VALUE if hashAlg is unknown or unsupported.
  */
 TSS2_RC
-iesys_crypto_KDFa(TPM2_ALG_ID hashAlg,
+iesys_crypto_KDFa(IESYS_CRYPTO_POOL **pool,
+                  TPM2_ALG_ID hashAlg,
                   uint8_t * hmacKey,
                   size_t hmacKeySize,
                   const char *label,
@@ -344,7 +529,6 @@ iesys_crypto_KDFa(TPM2_ALG_ID hashAlg,
                   "IESYS KDFa contextU key");
     LOGBLOB_DEBUG(&contextV->buffer[0], contextV->size,
                   "IESYS KDFa contextV key");
-    BYTE *subKey = outKey;
     UINT32 counter = 0;
     INT32 bytes = 0;
     size_t hlen = 0;
@@ -355,17 +539,12 @@ iesys_crypto_KDFa(TPM2_ALG_ID hashAlg,
     bytes = use_digest_size ? hlen : (bitLength + 7) / 8;
     LOG_DEBUG("IESYS KDFa hmac key bytes: %i", bytes);
 
-     /* Fill outKey with results from KDFaHmac */
-    for (; bytes > 0; subKey = &subKey[hlen], bytes = bytes - hlen) {
-        LOG_TRACE("IESYS KDFa hmac key bytes: %i", bytes);
-        //if(bytes < (INT32)hlen)
-        //    hlen = bytes;
-        counter++;
-        r = iesys_crypto_KDFaHmac(hashAlg, hmacKey,
-                                  hmacKeySize, counter, label, contextU,
-                                  contextV, bitLength, &subKey[0], &hlen);
-        return_if_error(r, "Error");
-    }
+    /* Fill outKey with complete HMAC digests */
+    r = iesys_crypto_KDFa_stream(pool, hashAlg, hmacKey, hmacKeySize, label,
+                                 contextU, contextV, bitLength, &counter,
+                                 outKey, (bytes + hlen - 1) / hlen * hlen,
+                                 FALSE);
+    return_if_error(r, "Error");
     if ((bitLength % 8) != 0)
         outKey[0] &= ((1 << (bitLength % 8)) - 1);
     if (counterInOut != NULL)
@@ -472,6 +651,8 @@ iesys_crypto_KDFe(TPM2_ALG_ID hashAlg,
  * The application of this function to data encrypted with this function will
  * produce the origin data. The key for XOR obfuscation will be derived with
  * KDFa form the passed key the session nonces, and the hash algorithm.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
  * @param[in] hash_alg The algorithm used for key derivation.
  * @param[in] key key used for obfuscation
  * @param[in] key_size Key size in bits.
@@ -484,7 +665,8 @@ iesys_crypto_KDFe(TPM2_ALG_ID hashAlg,
  * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
  */
 TSS2_RC
-iesys_xor_parameter_obfuscation(TPM2_ALG_ID hash_alg,
+iesys_xor_parameter_obfuscation(IESYS_CRYPTO_POOL **pool,
+                                TPM2_ALG_ID hash_alg,
                                 uint8_t *key,
                                 size_t key_size,
                                 TPM2B_NONCE * contextU,
@@ -494,37 +676,164 @@ iesys_xor_parameter_obfuscation(TPM2_ALG_ID hash_alg,
 {
     TSS2_RC r;
     uint32_t counter = 0;
-    BYTE  kdfa_result[TPM2_MAX_DIGEST_BUFFER];
-    size_t digest_size;
-    size_t data_size_bits = data_size * 8;
-    size_t rest_size = data_size;
-    BYTE *kdfa_byte_ptr;
 
     if (key == NULL || data == NULL) {
         LOG_ERROR("Bad reference");
         return TSS2_ESYS_RC_BAD_REFERENCE;
     }
 
-    r = iesys_crypto_hash_get_digest_size(hash_alg, &digest_size);
+    LOGBLOB_TRACE(data, data_size, "Parameter data before XOR");
+    r = iesys_crypto_KDFa_stream(pool, hash_alg, key, key_size, "XOR",
+                                 contextU, contextV, data_size * 8, &counter,
+                                 data, data_size, TRUE);
+    return_if_error(r, "KDFa XOR obfuscation failed");
+    LOGBLOB_TRACE(data, data_size, "Parameter data after XOR");
+    return TSS2_RC_SUCCESS;
+}
+
+
+/** Release the cached crypto state of a session.
+ *
+ * @param[in,out] cache The cached state, which will be set to NULL.
+ */
+void
+iesys_crypto_session_cache_free(IESYS_CRYPTO_SESSION_CACHE **cache)
+{
+    if (cache == NULL || *cache == NULL)
+        return;
+    iesys_crypto_hmac_abort(&(*cache)->kdfa);
+    iesys_crypto_sym_free(&(*cache)->sym);
+    memset((*cache)->kdfa_key, 0, sizeof((*cache)->kdfa_key));
+    SAFE_FREE(*cache);
+}
+
+/** Encryption/Decryption of a parameter with AES-CFB.
+ *
+ * The AES key and IV are derived with KDFa from the passed key and the
+ * session nonces, and the data is encrypted or decrypted in CFB mode.
+ * If a cache is passed, the HMAC of KDFa is only keyed again if the hash
+ * algorithm or the key changed since the last call, and the cipher context
+ * is only re-initialized with the new AES key and IV.
+ * @param[in,out] pool The pool of hash and HMAC contexts of the ESYS context
+ *                or NULL.
+ * @param[in,out] cache The crypto state cached in the session, which is
+ *                allocated on first use, or NULL.
+ * @param[in] hash_alg The algorithm used for key derivation.
+ * @param[in] key The key used for KDFa (sessionKey || authValue).
+ * @param[in] key_size The size of key in bytes.
+ * @param[in] contextU, contextV are used for construction of a binary string
+ *            containing information related to the derived key.
+ * @param[in] key_bits The AES key size in bits.
+ * @param[in,out] data Data to be encrypted/decrypted the result will be
+ *                will be stored in this buffer.
+ * @param[in] data_size size of data to be encrypted/decrypted.
+ * @param[in] encrypt Indicates whether the data is encrypted or decrypted.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_VALUE if the key size is too large.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_crypto_param_aes_cfb(IESYS_CRYPTO_POOL **pool,
+                           IESYS_CRYPTO_SESSION_CACHE **cache,
+                           TPM2_ALG_ID hash_alg,
+                           uint8_t *key,
+                           size_t key_size,
+                           TPM2B_NONCE * contextU,
+                           TPM2B_NONCE * contextV,
+                           TPMI_AES_KEY_BITS key_bits,
+                           BYTE *data,
+                           size_t data_size,
+                           BOOL encrypt)
+{
+    TSS2_RC r;
+    IESYS_CRYPTO_SESSION_CACHE *mycache;
+    uint32_t counter = 0;
+    uint32_t bitLength = key_bits + AES_BLOCK_SIZE_IN_BYTES * 8;
+    size_t hlen;
+    size_t aes_off = (key_bits + 7) / 8;
+    BYTE symKey[TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE
+                + sizeof(TPMU_HA)];
+
+    if (key == NULL || data == NULL || contextU == NULL || contextV == NULL) {
+        LOG_ERROR("Bad reference");
+        return TSS2_ESYS_RC_BAD_REFERENCE;
+    }
+    if (key_bits > TPM2_MAX_SYM_KEY_BYTES * 8 ||
+        key_size > sizeof(mycache->kdfa_key)) {
+        return_error(TSS2_ESYS_RC_BAD_VALUE, "Key size too large");
+    }
+    r = iesys_crypto_hash_get_digest_size(hash_alg, &hlen);
     return_if_error(r, "Hash alg not supported");
-    while(rest_size > 0) {
-        r = iesys_crypto_KDFa(hash_alg, key, key_size, "XOR",
-                              contextU, contextV, data_size_bits, &counter,
-                              kdfa_result, TRUE);
-        return_if_error(r, "iesys_crypto_KDFa failed");
-        /* XOR next data sub block with KDFa result  */
-        kdfa_byte_ptr = kdfa_result;
-        LOGBLOB_TRACE(data, data_size, "Parameter data before XOR");
-        for(size_t i = digest_size < rest_size ? digest_size : rest_size; i > 0;
-            i--)
-            *data++ ^= *kdfa_byte_ptr++;
-        LOGBLOB_TRACE(data, data_size, "Parameter data after XOR");
-        rest_size = rest_size < digest_size ? 0 : rest_size - digest_size;
+
+    if (cache == NULL) {
+        r = iesys_crypto_KDFa(pool, hash_alg, key, key_size, "CFB", contextU,
+                              contextV, bitLength, NULL, &symKey[0], FALSE);
+        return_if_error(r, "while computing KDFa");
+        r = encrypt ?
+            iesys_crypto_sym_aes_encrypt(&symKey[0], TPM2_ALG_AES, key_bits,
+                                         TPM2_ALG_CFB, AES_BLOCK_SIZE_IN_BYTES,
+                                         data, data_size, &symKey[aes_off]) :
+            iesys_crypto_sym_aes_decrypt(&symKey[0], TPM2_ALG_AES, key_bits,
+                                         TPM2_ALG_CFB, AES_BLOCK_SIZE_IN_BYTES,
+                                         data, data_size, &symKey[aes_off]);
+        memset(symKey, 0, sizeof(symKey));
+        return_if_error(r, "AES-CFB not possible");
+        return TSS2_RC_SUCCESS;
     }
+
+    if (*cache == NULL) {
+        *cache = calloc(1, sizeof(IESYS_CRYPTO_SESSION_CACHE));
+        return_if_null(*cache, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+    }
+    mycache = *cache;
+
+    /* The HMAC stays keyed as long as the KDFa key does not change. */
+    if (mycache->kdfa != NULL &&
+        (mycache->kdfa_alg != hash_alg || mycache->kdfa_key_size != key_size ||
+         memcmp(mycache->kdfa_key, key, key_size) != 0)) {
+        iesys_crypto_hmac_abort(&mycache->kdfa);
+    }
+    if (mycache->kdfa == NULL) {
+        r = iesys_crypto_hmac_start_pooled(pool, &mycache->kdfa, hash_alg,
+                                           key, key_size);
+        return_if_error(r, "Error");
+        mycache->kdfa_alg = hash_alg;
+        mycache->kdfa_key_size = key_size;
+        memcpy(mycache->kdfa_key, key, key_size);
+    }
+
+    LOG_DEBUG("IESYS KDFa hashAlg: %i label: CFB bitLength: %i", hash_alg,
+              bitLength);
+    r = iesys_crypto_KDFa_blocks(mycache->kdfa, hlen, "CFB", contextU,
+                                 contextV, bitLength, &counter, &symKey[0],
+                                 ((bitLength + 7) / 8 + hlen - 1) / hlen * hlen,
+                                 FALSE);
+    if (r != TSS2_RC_SUCCESS) {
+        /* The state of the HMAC is unknown. */
+        iesys_crypto_hmac_abort(&mycache->kdfa);
+        return_error(r, "while computing KDFa");
+    }
+
+    r = encrypt ?
+        iesys_crypto_sym_aes_encrypt_cached(&mycache->sym, &symKey[0],
+                                            TPM2_ALG_AES, key_bits,
+                                            TPM2_ALG_CFB,
+                                            AES_BLOCK_SIZE_IN_BYTES,
+                                            data, data_size,
+                                            &symKey[aes_off]) :
+        iesys_crypto_sym_aes_decrypt_cached(&mycache->sym, &symKey[0],
+                                            TPM2_ALG_AES, key_bits,
+                                            TPM2_ALG_CFB,
+                                            AES_BLOCK_SIZE_IN_BYTES,
+                                            data, data_size,
+                                            &symKey[aes_off]);
+    memset(symKey, 0, sizeof(symKey));
+    return_if_error(r, "AES-CFB not possible");
     return TSS2_RC_SUCCESS;
 }
 
-
 /** Initialize crypto backend.
  *
  * Initialize internal tables of crypto backend.
@@ -23,9 +23,23 @@ extern "C" {
 
 #define AES_BLOCK_SIZE_IN_BYTES 16
 
+/** Crypto state of a session for parameter encryption
+ *
+ * The state is kept in the resource object of the session and reused by the
+ * following commands of the session.
+ */
+typedef struct _IESYS_CRYPTO_SESSION_CACHE {
+    IESYS_CRYPTO_CONTEXT_BLOB *kdfa;    /**< The keyed HMAC of KDFa or NULL */
+    TPM2_ALG_ID kdfa_alg;               /**< The hash algorithm of kdfa */
+    size_t kdfa_key_size;               /**< The size of the key of kdfa */
+    BYTE kdfa_key[2*sizeof(TPMU_HA)];   /**< The key of kdfa */
+    IESYS_CRYPTO_SYM_CONTEXT_BLOB *sym; /**< The AES-CFB context or NULL */
+} IESYS_CRYPTO_SESSION_CACHE;
+
 TSS2_RC iesys_crypto_hash_get_digest_size(TPM2_ALG_ID hashAlg, size_t *size);
 
 TSS2_RC iesys_crypto_pHash(
+    IESYS_CRYPTO_POOL **pool,
     TPM2_ALG_ID alg,
     const uint8_t rcBuffer[4],
     const uint8_t ccBuffer[4],
@@ -37,17 +51,18 @@ TSS2_RC iesys_crypto_pHash(
     uint8_t *pHash,
     size_t *pHash_size);
 
-#define iesys_crypto_cpHash(alg, ccBuffer, name1, name2, name3, \
+#define iesys_crypto_cpHash(pool, alg, ccBuffer, name1, name2, name3, \
                             cpBuffer, cpBuffer_size, cpHash, cpHash_size) \
-        iesys_crypto_pHash(alg, NULL, ccBuffer, name1, name2, name3, cpBuffer, \
-                           cpBuffer_size, cpHash, cpHash_size)
-#define iesys_crypto_rpHash(alg, rcBuffer, ccBuffer, rpBuffer, rpBuffer_size, \
-                            rpHash, rpHash_size)                        \
-        iesys_crypto_pHash(alg, rcBuffer, ccBuffer, NULL, NULL, NULL, rpBuffer, \
-                           rpBuffer_size, rpHash, rpHash_size)
+        iesys_crypto_pHash(pool, alg, NULL, ccBuffer, name1, name2, name3, \
+                           cpBuffer, cpBuffer_size, cpHash, cpHash_size)
+#define iesys_crypto_rpHash(pool, alg, rcBuffer, ccBuffer, rpBuffer,    \
+                            rpBuffer_size, rpHash, rpHash_size)         \
+        iesys_crypto_pHash(pool, alg, rcBuffer, ccBuffer, NULL, NULL, NULL, \
+                           rpBuffer, rpBuffer_size, rpHash, rpHash_size)
 
 
 TSS2_RC iesys_crypto_authHmac(
+    IESYS_CRYPTO_POOL **pool,
     TPM2_ALG_ID alg,
     uint8_t *hmacKey,
     size_t hmacKeySize,
@@ -61,6 +76,7 @@ TSS2_RC iesys_crypto_authHmac(
     TPM2B_AUTH *hmac);
 
 TSS2_RC iesys_crypto_KDFaHmac(
+    IESYS_CRYPTO_POOL **pool,
     TPM2_ALG_ID alg,
     uint8_t *hmacKey,
     size_t hmacKeySize,
@@ -73,6 +89,7 @@ TSS2_RC iesys_crypto_KDFaHmac(
     size_t *hmacSize);
 
 TSS2_RC iesys_crypto_KDFa(
+    IESYS_CRYPTO_POOL **pool,
     TPM2_ALG_ID hashAlg,
     uint8_t *hmacKey,
     size_t hmacKeySize,
@@ -85,6 +102,7 @@ TSS2_RC iesys_crypto_KDFa(
     BOOL use_digest_size);
 
 TSS2_RC iesys_xor_parameter_obfuscation(
+    IESYS_CRYPTO_POOL **pool,
     TPM2_ALG_ID hash_alg,
     uint8_t *key,
     size_t key_size,
@@ -93,6 +111,21 @@ TSS2_RC iesys_xor_parameter_obfuscation(
     BYTE *data,
     size_t data_size);
 
+void iesys_crypto_session_cache_free(IESYS_CRYPTO_SESSION_CACHE **cache);
+
+TSS2_RC iesys_crypto_param_aes_cfb(
+    IESYS_CRYPTO_POOL **pool,
+    IESYS_CRYPTO_SESSION_CACHE **cache,
+    TPM2_ALG_ID hash_alg,
+    uint8_t *key,
+    size_t key_size,
+    TPM2B_NONCE *contextU,
+    TPM2B_NONCE *contextV,
+    TPMI_AES_KEY_BITS key_bits,
+    BYTE *data,
+    size_t data_size,
+    BOOL encrypt);
+
 TSS2_RC iesys_crypto_KDFe(
     TPM2_ALG_ID hashAlg,
     TPM2B_ECC_PARAMETER *Z,
@@ -391,6 +391,48 @@ iesys_cryptmbed_hmac_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
     return r;
 }
 
+/** Write the HMAC digest value to a byte buffer and restart the context.
+ *
+ * The digest value will be written to a passed buffer and the context is
+ * reset to the state right after keying, so further HMACs with the same key
+ * can be computed without keying the HMAC again. The context stays open and
+ * has to be released by finish or abort.
+ * @param[in,out] context The context of the HMAC object.
+ * @param[out] buffer The buffer for the digest value (caller-allocated).
+ * @param[in,out] size The size of the buffer and the size of the digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_SIZE If the size passed is lower than the HMAC length.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptmbed_hmac_finish_restart(IESYS_CRYPTO_CONTEXT_BLOB * context,
+                                    uint8_t * buffer, size_t * size)
+{
+    if (context == NULL || buffer == NULL || size == NULL) {
+        return_error(TSS2_ESYS_RC_BAD_REFERENCE, "Null-Pointer passed");
+    }
+    IESYS_CRYPTMBED_CONTEXT *mycontext = (IESYS_CRYPTMBED_CONTEXT *) context;
+    if (mycontext->type != IESYS_CRYPTMBED_TYPE_HMAC) {
+        return_error(TSS2_ESYS_RC_BAD_REFERENCE, "bad context");
+    }
+
+    if (*size < mycontext->hmac.hmac_len) {
+        return_error(TSS2_ESYS_RC_BAD_SIZE, "Buffer too small");
+    }
+
+    if (mbedtls_md_hmac_finish(&mycontext->hmac.mbed_context, buffer) != 0) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "MBED HMAC finish");
+    }
+    *size = mycontext->hmac.hmac_len;
+
+    if (mbedtls_md_hmac_reset(&mycontext->hmac.mbed_context) != 0) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "MBED HMAC reset");
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
 /** Write the HMAC digest value to a TPM2B object and close the context.
  *
  * The digest value will written to a passed TPM2B object and the resources of
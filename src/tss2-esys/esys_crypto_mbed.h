@@ -17,6 +17,16 @@ extern "C" {
 
 typedef struct _IESYS_CRYPTO_CONTEXT IESYS_CRYPTO_CONTEXT_BLOB;
 
+/* The mbed TLS backend does not pool contexts, the pool stays NULL. */
+typedef struct _IESYS_CRYPTO_POOL IESYS_CRYPTO_POOL;
+
+#define iesys_crypto_pool_free(pool) (void)(pool)
+
+/* The mbed TLS backend does not cache cipher contexts, they stay NULL. */
+typedef struct _IESYS_CRYPTO_SYM_CONTEXT IESYS_CRYPTO_SYM_CONTEXT_BLOB;
+
+#define iesys_crypto_sym_free(context) (void)(context)
+
 TSS2_RC iesys_cryptmbed_hash_start(
     IESYS_CRYPTO_CONTEXT_BLOB **context,
     TPM2_ALG_ID hashAlg);
@@ -42,6 +52,8 @@ void iesys_cryptmbed_hash_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 
 #define iesys_crypto_pk_encrypt iesys_cryptmbed_pk_encrypt
 #define iesys_crypto_hash_start iesys_cryptmbed_hash_start
+#define iesys_crypto_hash_start_pooled(pool, context, hashAlg) \
+        iesys_cryptmbed_hash_start(context, hashAlg)
 #define iesys_crypto_hash_update iesys_cryptmbed_hash_update
 #define iesys_crypto_hash_update2b iesys_cryptmbed_hash_update2b
 #define iesys_crypto_hash_finish iesys_cryptmbed_hash_finish
@@ -73,6 +85,11 @@ TSS2_RC iesys_cryptmbed_hmac_finish(
     uint8_t *buffer,
     size_t *size);
 
+TSS2_RC iesys_cryptmbed_hmac_finish_restart(
+    IESYS_CRYPTO_CONTEXT_BLOB *context,
+    uint8_t *buffer,
+    size_t *size);
+
 TSS2_RC iesys_cryptmbed_hmac_finish2b(
     IESYS_CRYPTO_CONTEXT_BLOB **context,
     TPM2B *b);
@@ -80,10 +97,13 @@ TSS2_RC iesys_cryptmbed_hmac_finish2b(
 void iesys_cryptmbed_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 
 #define iesys_crypto_hmac_start iesys_cryptmbed_hmac_start
+#define iesys_crypto_hmac_start_pooled(pool, context, hmacAlg, key, size) \
+        iesys_cryptmbed_hmac_start(context, hmacAlg, key, size)
 #define iesys_crypto_hmac_start2b iesys_cryptmbed_hmac_start2b
 #define iesys_crypto_hmac_update iesys_cryptmbed_hmac_update
 #define iesys_crypto_hmac_update2b iesys_cryptmbed_hmac_update2b
 #define iesys_crypto_hmac_finish iesys_cryptmbed_hmac_finish
+#define iesys_crypto_hmac_finish_restart iesys_cryptmbed_hmac_finish_restart
 #define iesys_crypto_hmac_finish2b iesys_cryptmbed_hmac_finish2b
 #define iesys_crypto_hmac_abort iesys_cryptmbed_hmac_abort
 
@@ -131,6 +151,16 @@ TSS2_RC iesys_cryptmbed_get_ecdh_point(
 #define iesys_crypto_get_ecdh_point iesys_cryptmbed_get_ecdh_point
 #define iesys_crypto_sym_aes_encrypt iesys_cryptmbed_sym_aes_encrypt
 #define iesys_crypto_sym_aes_decrypt iesys_cryptmbed_sym_aes_decrypt
+#define iesys_crypto_sym_aes_encrypt_cached(context, key, tpm_sym_alg, \
+                                            key_bits, tpm_mode, blk_len, \
+                                            dst, dst_size, iv) \
+        iesys_cryptmbed_sym_aes_encrypt(key, tpm_sym_alg, key_bits, tpm_mode, \
+                                        blk_len, dst, dst_size, iv)
+#define iesys_crypto_sym_aes_decrypt_cached(context, key, tpm_sym_alg, \
+                                            key_bits, tpm_mode, blk_len, \
+                                            dst, dst_size, iv) \
+        iesys_cryptmbed_sym_aes_decrypt(key, tpm_sym_alg, key_bits, tpm_mode, \
+                                        blk_len, dst, dst_size, iv)
 
 #define iesys_crypto_init(...) TSS2_RC_SUCCESS;
 
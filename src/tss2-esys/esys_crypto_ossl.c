@@ -12,6 +12,9 @@
 #include <openssl/aes.h>
 #include <openssl/rsa.h>
 #include <openssl/engine.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 #include <stdio.h>
 
 #include "tss2_esys.h"
@@ -40,6 +43,12 @@
         EC_POINT_get_affine_coordinates_GFp(group, tpm_pub_key, bn_x, bn_y, dmy)
 #endif /* OPENSSL_VERSION_NUMBER >= 0x10101000L */
 
+#define ARRAY_LEN(x) (sizeof(x)/sizeof(x[0]))
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_reset(ctx) EVP_MD_CTX_cleanup(ctx)
+#endif /* OPENSSL_VERSION_NUMBER < 0x10100000L */
+
 static int
 iesys_bn2binpad(const BIGNUM *bn, unsigned char *bin, int bin_length)
 {
@@ -50,6 +59,9 @@ iesys_bn2binpad(const BIGNUM *bn, unsigned char *bin, int bin_length)
     return 1;
 }
 
+/** The maximum number of free hash or HMAC contexts kept in a pool */
+#define IESYS_CRYPTOSSL_POOL_SIZE 4
+
 /** Context to hold temporary values for iesys_crypto */
 typedef struct _IESYS_CRYPTO_CONTEXT {
     enum {
@@ -63,13 +75,46 @@ typedef struct _IESYS_CRYPTO_CONTEXT {
             size_t hash_len;
         } hash; /**< the state variables for a hash context */
         struct {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            EVP_MAC_CTX *ossl_context;
+#else
             EVP_MD_CTX *ossl_context;
+            EVP_PKEY *ossl_key; /**< The key, kept for restarts */
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
             const EVP_MD *ossl_hash_alg;
             size_t hmac_len;
         } hmac; /**< the state variables for an hmac context */
     };
+    IESYS_CRYPTO_POOL *pool; /**< The pool the context is returned to by
+                                  finish and abort, or NULL. */
+    struct _IESYS_CRYPTO_CONTEXT *next; /**< The next free context of the pool */
 } IESYS_CRYPTOSSL_CONTEXT;
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/** The hash algorithms with pre-fetched digests in a pool */
+static const TPM2_ALG_ID pool_hash_algs[] = {
+    TPM2_ALG_SHA1, TPM2_ALG_SHA256, TPM2_ALG_SHA384, TPM2_ALG_SHA512
+};
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+/** Pool of reusable hash and HMAC contexts
+ *
+ * The pool belongs to an ESYS context. Finished hash and HMAC contexts are
+ * kept in the pool and reinitialized by the next start instead of being
+ * reallocated. The OpenSSL state of an HMAC context holds its key, so it is
+ * freed when the context is returned and only the context itself is kept.
+ * With OpenSSL 3 the pool also holds the pre-fetched digest and MAC
+ * algorithms, which otherwise are fetched implicitly on every start.
+ */
+struct _IESYS_CRYPTO_POOL {
+    IESYS_CRYPTOSSL_CONTEXT *free[2]; /**< The free hash and HMAC contexts */
+    size_t num_free[2];               /**< The number of free contexts */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MD *md[ARRAY_LEN(pool_hash_algs)]; /**< The pre-fetched digests */
+    EVP_MAC *mac;                     /**< The pre-fetched HMAC algorithm */
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+};
+
 const EVP_MD *
 get_ossl_hash_md(TPM2_ALG_ID hashAlg)
 {
@@ -91,9 +136,167 @@ get_ossl_hash_md(TPM2_ALG_ID hashAlg)
     }
 }
 
+/** Get the digest for a hash algorithm, pre-fetched if a pool is used.
+ *
+ * @param[in] pool The pool of the ESYS context or NULL.
+ * @param[in] hashAlg The hash algorithm.
+ * @retval The digest or NULL if the hash algorithm is not supported.
+ */
+static const EVP_MD *
+pool_hash_md(IESYS_CRYPTO_POOL *pool, TPM2_ALG_ID hashAlg)
+{
+    const EVP_MD *md = get_ossl_hash_md(hashAlg);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (!pool || !md)
+        return md;
+    for (size_t i = 0; i < ARRAY_LEN(pool_hash_algs); i++) {
+        if (pool_hash_algs[i] != hashAlg)
+            continue;
+        if (!pool->md[i])
+            pool->md[i] = EVP_MD_fetch(NULL, EVP_MD_get0_name(md), NULL);
+        if (pool->md[i])
+            return pool->md[i];
+        break;
+    }
+#else
+    (void)pool;
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+    return md;
+}
+
+/** Allocate the pool of an ESYS context on first use.
+ *
+ * @param[in,out] pool The pool to be allocated if it is NULL.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ */
+static TSS2_RC
+pool_init(IESYS_CRYPTO_POOL **pool)
+{
+    if (*pool == NULL) {
+        *pool = calloc(1, sizeof(IESYS_CRYPTO_POOL));
+        return_if_null(*pool, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Take a free context of a certain type from a pool.
+ *
+ * @param[in] pool The pool or NULL.
+ * @param[in] type The type of the context (hash or hmac).
+ * @retval The context or NULL if no free context is available.
+ */
+static IESYS_CRYPTOSSL_CONTEXT *
+pool_get(IESYS_CRYPTO_POOL *pool, int type)
+{
+    IESYS_CRYPTOSSL_CONTEXT *mycontext;
+
+    if (!pool || !pool->free[type - 1])
+        return NULL;
+
+    mycontext = pool->free[type - 1];
+    pool->free[type - 1] = mycontext->next;
+    pool->num_free[type - 1] -= 1;
+    mycontext->next = NULL;
+    return mycontext;
+}
+
+/** Release the OpenSSL state of an HMAC context, which holds the key.
+ *
+ * @param[in,out] mycontext The HMAC context.
+ */
+static void
+hmac_state_free(IESYS_CRYPTOSSL_CONTEXT *mycontext)
+{
+    if (mycontext->hmac.ossl_context) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC_CTX_free(mycontext->hmac.ossl_context);
+#else
+        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+        mycontext->hmac.ossl_context = NULL;
+    }
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+    OSSL_FREE(mycontext->hmac.ossl_key, EVP_PKEY);
+#endif /* OPENSSL_VERSION_NUMBER < 0x30000000L */
+}
+
+/** Release the resources of a hash or HMAC context.
+ *
+ * @param[in] mycontext The context to be freed.
+ */
+static void
+context_free(IESYS_CRYPTOSSL_CONTEXT *mycontext)
+{
+    if (mycontext->type == IESYS_CRYPTOSSL_TYPE_HASH) {
+        if (mycontext->hash.ossl_context)
+            EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
+    } else {
+        hmac_state_free(mycontext);
+    }
+    free(mycontext);
+}
+
+/** Return a hash or HMAC context to its pool.
+ *
+ * The context is freed if it does not belong to a pool or if the pool is full.
+ * @param[in,out] context The context, which will be set to NULL.
+ */
+static void
+context_release(IESYS_CRYPTO_CONTEXT_BLOB **context)
+{
+    IESYS_CRYPTOSSL_CONTEXT *mycontext = *context;
+    IESYS_CRYPTO_POOL *pool = mycontext->pool;
+    int i = mycontext->type - 1;
+
+    *context = NULL;
+    /* The keyed HMAC state is not kept in the pool. */
+    if (mycontext->type == IESYS_CRYPTOSSL_TYPE_HMAC)
+        hmac_state_free(mycontext);
+    if (!pool || pool->num_free[i] >= IESYS_CRYPTOSSL_POOL_SIZE) {
+        context_free(mycontext);
+        return;
+    }
+    mycontext->next = pool->free[i];
+    pool->free[i] = mycontext;
+    pool->num_free[i] += 1;
+}
+
+/** Release the pool of an ESYS context.
+ *
+ * All free contexts and pre-fetched algorithms of the pool are released and
+ * the pool is set to NULL.
+ * @param[in,out] pool The pool to be released.
+ */
+void
+iesys_cryptossl_pool_free(IESYS_CRYPTO_POOL **pool)
+{
+    IESYS_CRYPTOSSL_CONTEXT *mycontext;
+
+    if (pool == NULL || *pool == NULL)
+        return;
+
+    for (size_t i = 0; i < ARRAY_LEN((*pool)->free); i++) {
+        while ((mycontext = (*pool)->free[i])) {
+            (*pool)->free[i] = mycontext->next;
+            context_free(mycontext);
+        }
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    for (size_t i = 0; i < ARRAY_LEN((*pool)->md); i++)
+        EVP_MD_free((*pool)->md[i]);
+    EVP_MAC_free((*pool)->mac);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+    SAFE_FREE(*pool);
+}
+
 /** Provide the context for the computation of a hash digest.
  *
- * The context will be created and initialized according to the hash function.
+ * The context will be taken from the pool if a free one is available, else
+ * it will be created. It is initialized according to the hash function.
+ * @param[in,out] pool The pool of the ESYS context or NULL if no pool is used.
+ *                The pool is allocated on first use.
  * @param[out] context The created context (callee-allocated).
  * @param[in] hashAlg The hash algorithm for the creation of the context.
  * @retval TSS2_RC_SUCCESS on success.
@@ -102,19 +305,31 @@ get_ossl_hash_md(TPM2_ALG_ID hashAlg)
  * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
  */
 TSS2_RC
-iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
-                           TPM2_ALG_ID hashAlg)
+iesys_cryptossl_hash_start_pooled(IESYS_CRYPTO_POOL **pool,
+                                  IESYS_CRYPTO_CONTEXT_BLOB ** context,
+                                  TPM2_ALG_ID hashAlg)
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
+    IESYS_CRYPTO_POOL *mypool = NULL;
+    IESYS_CRYPTOSSL_CONTEXT *mycontext;
+
     LOG_TRACE("call: context=%p hashAlg=%"PRIu16, context, hashAlg);
-    return_if_null(context, "Context is NULL", TSS2_ESYS_RC_BAD_REFERENCE);
     return_if_null(context, "Null-Pointer passed for context", TSS2_ESYS_RC_BAD_REFERENCE);
-    IESYS_CRYPTOSSL_CONTEXT *mycontext;
-    mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
-    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
-    mycontext->type = IESYS_CRYPTOSSL_TYPE_HASH;
+    if (pool) {
+        r = pool_init(pool);
+        return_if_error(r, "Initialize pool");
+        mypool = *pool;
+    }
+
+    mycontext = pool_get(mypool, IESYS_CRYPTOSSL_TYPE_HASH);
+    if (!mycontext) {
+        mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
+        return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+        mycontext->type = IESYS_CRYPTOSSL_TYPE_HASH;
+        mycontext->pool = mypool;
+    }
 
-    if (!(mycontext->hash.ossl_hash_alg = get_ossl_hash_md(hashAlg))) {
+    if (!(mycontext->hash.ossl_hash_alg = pool_hash_md(mypool, hashAlg))) {
         goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
                    "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
     }
@@ -124,12 +339,13 @@ iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
                    "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
     }
 
-    if (!(mycontext->hash.ossl_context =  EVP_MD_CTX_create())) {
+    if (!mycontext->hash.ossl_context &&
+        !(mycontext->hash.ossl_context =  EVP_MD_CTX_create())) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Error EVP_MD_CTX_create", cleanup);
     }
 
-    if (1 != EVP_DigestInit(mycontext->hash.ossl_context,
-                               mycontext->hash.ossl_hash_alg)) {
+    if (1 != EVP_DigestInit_ex(mycontext->hash.ossl_context,
+                               mycontext->hash.ossl_hash_alg, NULL)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Errror EVP_DigestInit", cleanup);
     }
 
@@ -138,13 +354,28 @@ iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
     return TSS2_RC_SUCCESS;
 
  cleanup:
-    if (mycontext->hash.ossl_context)
-        EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    SAFE_FREE(mycontext);
+    context_free(mycontext);
 
     return r;
 }
 
+/** Provide the context for the computation of a hash digest.
+ *
+ * The context will be created and initialized according to the hash function.
+ * @param[out] context The created context (callee-allocated).
+ * @param[in] hashAlg The hash algorithm for the creation of the context.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_VALUE or TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptossl_hash_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
+                           TPM2_ALG_ID hashAlg)
+{
+    return iesys_cryptossl_hash_start_pooled(NULL, context, hashAlg);
+}
+
 /** Update the digest value of a digest object from a byte buffer.
  *
  * The context of a digest object will be updated according to the hash
@@ -244,9 +475,7 @@ iesys_cryptossl_hash_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
     LOGBLOB_TRACE(buffer, mycontext->hash.hash_len, "read hash result");
 
     *size = mycontext->hash.hash_len;
-    EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    free(mycontext);
-    *context = NULL;
+    context_release(context);
 
     return TSS2_RC_SUCCESS;
 }
@@ -271,17 +500,18 @@ iesys_cryptossl_hash_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
         return;
     }
 
-    EVP_MD_CTX_destroy(mycontext->hash.ossl_context);
-    free(mycontext);
-    *context = NULL;
+    context_release(context);
 }
 
 /* HMAC */
 
 /** Provide the context an HMAC digest object from a byte buffer key.
  *
- * The context will be created and initialized according to the hash function
- * and the used HMAC key.
+ * The context will be taken from the pool if a free one is available, else
+ * it will be created. It is initialized according to the hash function and
+ * the used HMAC key.
+ * @param[in,out] pool The pool of the ESYS context or NULL if no pool is used.
+ *                The pool is allocated on first use.
  * @param[out] context The created context (callee-allocated).
  * @param[in] hashAlg The hash algorithm for the HMAC computation.
  * @param[in] key The byte buffer of the HMAC key.
@@ -292,12 +522,20 @@ iesys_cryptossl_hash_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
  * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
  */
 TSS2_RC
-iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
-                           TPM2_ALG_ID hashAlg,
-                           const uint8_t * key, size_t size)
+iesys_cryptossl_hmac_start_pooled(IESYS_CRYPTO_POOL **pool,
+                                  IESYS_CRYPTO_CONTEXT_BLOB ** context,
+                                  TPM2_ALG_ID hashAlg,
+                                  const uint8_t * key, size_t size)
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
+    IESYS_CRYPTO_POOL *mypool = NULL;
+    IESYS_CRYPTOSSL_CONTEXT *mycontext;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC *mac = NULL;
+    OSSL_PARAM params[2];
+#else
     EVP_PKEY *hkey = NULL;
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 
     LOG_TRACE("called for context-pointer %p and hmacAlg %d", context, hashAlg);
     LOGBLOB_TRACE(key, size, "Starting  hmac with");
@@ -305,10 +543,21 @@ iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
         return_error(TSS2_ESYS_RC_BAD_REFERENCE,
                      "Null-Pointer passed in for context");
     }
-    IESYS_CRYPTOSSL_CONTEXT *mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
-    return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+    if (pool) {
+        r = pool_init(pool);
+        return_if_error(r, "Initialize pool");
+        mypool = *pool;
+    }
 
-    if (!(mycontext->hmac.ossl_hash_alg = get_ossl_hash_md(hashAlg))) {
+    mycontext = pool_get(mypool, IESYS_CRYPTOSSL_TYPE_HMAC);
+    if (!mycontext) {
+        mycontext = calloc(1, sizeof(IESYS_CRYPTOSSL_CONTEXT));
+        return_if_null(mycontext, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+        mycontext->type = IESYS_CRYPTOSSL_TYPE_HMAC;
+        mycontext->pool = mypool;
+    }
+
+    if (!(mycontext->hmac.ossl_hash_alg = pool_hash_md(mypool, hashAlg))) {
         goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
                    "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
     }
@@ -318,7 +567,40 @@ iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
                    "Unsupported hash algorithm (%"PRIu16")", cleanup, hashAlg);
     }
 
-    if (!(mycontext->hmac.ossl_context =  EVP_MD_CTX_create())) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (!mycontext->hmac.ossl_context) {
+        if (mypool) {
+            if (!mypool->mac)
+                mypool->mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+            mac = mypool->mac;
+        } else {
+            mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+        }
+        if (!mac) {
+            goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                       "Error EVP_MAC_fetch", cleanup);
+        }
+        /* The context holds its own reference to the MAC algorithm. */
+        mycontext->hmac.ossl_context = EVP_MAC_CTX_new(mac);
+        if (!mypool)
+            EVP_MAC_free(mac);
+        if (!mycontext->hmac.ossl_context) {
+            goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                       "Error EVP_MAC_CTX_new", cleanup);
+        }
+    }
+
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                    (char *) EVP_MD_get0_name(mycontext->hmac.ossl_hash_alg), 0);
+    params[1] = OSSL_PARAM_construct_end();
+    if (1 != EVP_MAC_init(mycontext->hmac.ossl_context, key, size, params)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "EVP_MAC_init", cleanup);
+    }
+#else
+    if (mycontext->hmac.ossl_context) {
+        EVP_MD_CTX_reset(mycontext->hmac.ossl_context);
+    } else if (!(mycontext->hmac.ossl_context =  EVP_MD_CTX_create())) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
                    "Error EVP_MD_CTX_create", cleanup);
     }
@@ -334,23 +616,43 @@ iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
                    "DigestSignInit", cleanup);
     }
 
-    mycontext->type = IESYS_CRYPTOSSL_TYPE_HMAC;
+    mycontext->hmac.ossl_key = hkey;
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 
     *context = (IESYS_CRYPTO_CONTEXT_BLOB *) mycontext;
 
-    EVP_PKEY_free(hkey);
-
     return TSS2_RC_SUCCESS;
 
  cleanup:
-    if (mycontext->hmac.ossl_context)
-        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
+    context_free(mycontext);
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
     if(hkey)
         EVP_PKEY_free(hkey);
-    SAFE_FREE(mycontext);
+#endif /* OPENSSL_VERSION_NUMBER < 0x30000000L */
     return r;
 }
 
+/** Provide the context an HMAC digest object from a byte buffer key.
+ *
+ * The context will be created and initialized according to the hash function
+ * and the used HMAC key.
+ * @param[out] context The created context (callee-allocated).
+ * @param[in] hashAlg The hash algorithm for the HMAC computation.
+ * @param[in] key The byte buffer of the HMAC key.
+ * @param[in] size The size of the HMAC key.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptossl_hmac_start(IESYS_CRYPTO_CONTEXT_BLOB ** context,
+                           TPM2_ALG_ID hashAlg,
+                           const uint8_t * key, size_t size)
+{
+    return iesys_cryptossl_hmac_start_pooled(NULL, context, hashAlg, key, size);
+}
+
 /** Update and HMAC digest value from a byte buffer.
  *
  * The context of a digest object will be updated according to the hash
@@ -378,7 +680,11 @@ iesys_cryptossl_hmac_update(IESYS_CRYPTO_CONTEXT_BLOB * context,
     LOGBLOB_TRACE(buffer, size, "Updating hmac with");
 
     /* Call update with the message */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if(1 != EVP_MAC_update(mycontext->hmac.ossl_context, buffer, size)) {
+#else
     if(1 != EVP_DigestSignUpdate(mycontext->hmac.ossl_context, buffer, size)) {
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
         return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "OSSL HMAC update");
     }
 
@@ -439,19 +745,81 @@ iesys_cryptossl_hmac_finish(IESYS_CRYPTO_CONTEXT_BLOB ** context,
         return_error(TSS2_ESYS_RC_BAD_SIZE, "Buffer too small");
     }
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (1 != EVP_MAC_final(mycontext->hmac.ossl_context, buffer, size, *size)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "EVP_MAC_final", cleanup);
+    }
+#else
     if (1 != EVP_DigestSignFinal(mycontext->hmac.ossl_context, buffer, size)) {
         goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "DigestSignFinal", cleanup);
     }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 
     LOGBLOB_TRACE(buffer, *size, "read hmac result");
 
  cleanup:
-    EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
-    SAFE_FREE(mycontext);
-    *context = NULL;
+    context_release(context);
     return r;
 }
 
+/** Write the HMAC digest value to a byte buffer and restart the context.
+ *
+ * The digest value will be written to a passed buffer and the context is
+ * reset to the state right after keying, so further HMACs with the same key
+ * can be computed without keying the HMAC again. With OpenSSL 3 the inner and
+ * outer hash states computed from the key are reused; with older versions the
+ * key object is reused. The context stays open and has to be released by
+ * finish or abort.
+ * @param[in,out] context The context of the HMAC object.
+ * @param[out] buffer The buffer for the digest value (caller-allocated).
+ * @param[in,out] size The size of the buffer and the size of the digest.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_SIZE If the size passed is lower than the HMAC length.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptossl_hmac_finish_restart(IESYS_CRYPTO_CONTEXT_BLOB * context,
+                                    uint8_t * buffer, size_t * size)
+{
+    LOG_TRACE("called for context %p, buffer %p and size-pointer %p",
+              context, buffer, size);
+    if (context == NULL || buffer == NULL || size == NULL) {
+        return_error(TSS2_ESYS_RC_BAD_REFERENCE, "Null-Pointer passed");
+    }
+    IESYS_CRYPTOSSL_CONTEXT *mycontext = (IESYS_CRYPTOSSL_CONTEXT *) context;
+    if (mycontext->type != IESYS_CRYPTOSSL_TYPE_HMAC) {
+        return_error(TSS2_ESYS_RC_BAD_REFERENCE, "bad context");
+    }
+
+    if (*size < mycontext->hmac.hmac_len) {
+        return_error(TSS2_ESYS_RC_BAD_SIZE, "Buffer too small");
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (1 != EVP_MAC_final(mycontext->hmac.ossl_context, buffer, size, *size)) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "EVP_MAC_final");
+    }
+    /* Without a key the HMAC is reset to the keyed inner and outer states. */
+    if (1 != EVP_MAC_init(mycontext->hmac.ossl_context, NULL, 0, NULL)) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "EVP_MAC_init");
+    }
+#else
+    if (1 != EVP_DigestSignFinal(mycontext->hmac.ossl_context, buffer, size)) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "DigestSignFinal");
+    }
+    EVP_MD_CTX_reset(mycontext->hmac.ossl_context);
+    if (1 != EVP_DigestSignInit(mycontext->hmac.ossl_context, NULL,
+                                mycontext->hmac.ossl_hash_alg, NULL,
+                                mycontext->hmac.ossl_key)) {
+        return_error(TSS2_ESYS_RC_GENERAL_FAILURE, "DigestSignInit");
+    }
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+    LOGBLOB_TRACE(buffer, *size, "read hmac result");
+    return TSS2_RC_SUCCESS;
+}
+
 /** Write the HMAC digest value to a TPM2B object and close the context.
  *
  * The digest value will written to a passed TPM2B object and the resources of
@@ -497,10 +865,7 @@ iesys_cryptossl_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB ** context)
             return;
         }
 
-        EVP_MD_CTX_destroy(mycontext->hmac.ossl_context);
-
-        free(mycontext);
-        *context = NULL;
+        context_release(context);
     }
 }
 
@@ -941,8 +1306,107 @@ iesys_cryptossl_get_ecdh_point(TPM2B_PUBLIC *key,
     return r;
 }
 
-/** Encrypt data with AES.
+/** Cached AES-CFB cipher context
+ *
+ * The context belongs to a session. It stays initialized for the cipher, so
+ * the following commands of the session only set a new key and IV.
+ */
+struct _IESYS_CRYPTO_SYM_CONTEXT {
+    EVP_CIPHER_CTX *ossl_context;    /**< The OpenSSL cipher context */
+    const EVP_CIPHER *ossl_cipher;   /**< The cipher of the context or NULL */
+};
+
+/** Release a cached cipher context.
+ *
+ * @param[in,out] context The cipher context, which will be set to NULL.
+ */
+void
+iesys_cryptossl_sym_free(IESYS_CRYPTO_SYM_CONTEXT_BLOB **context)
+{
+    if (context == NULL || *context == NULL)
+        return;
+    OSSL_FREE((*context)->ossl_context, EVP_CIPHER_CTX);
+    SAFE_FREE(*context);
+}
+
+/** Encrypt or decrypt data with AES-CFB.
+ *
+ * If a cached context is passed, it is allocated on first use and only
+ * re-initialized with the key and the IV as long as the cipher does not
+ * change. Else a temporary cipher context is used.
+ * @param[in,out] context The cached cipher context or NULL.
+ * @param[in] cipher_alg The OpenSSL cipher.
+ * @param[in] key key used for AES.
+ * @param[in,out] buffer Data to be encrypted or decrypted in place.
+ * @param[in] buffer_size size of data to be encrypted or decrypted.
+ * @param[in] iv The initialization vector.
+ * @param[in] enc 1 for encryption, 0 for decryption.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+static TSS2_RC
+sym_aes_cfb(IESYS_CRYPTO_SYM_CONTEXT_BLOB **context,
+            const EVP_CIPHER *cipher_alg,
+            uint8_t * key,
+            uint8_t * buffer,
+            size_t buffer_size,
+            uint8_t * iv,
+            int enc)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    IESYS_CRYPTO_SYM_CONTEXT_BLOB tmp_context = { 0 };
+    IESYS_CRYPTO_SYM_CONTEXT_BLOB *mycontext = &tmp_context;
+    int cipher_len;
+
+    if (context) {
+        if (!*context) {
+            *context = calloc(1, sizeof(IESYS_CRYPTO_SYM_CONTEXT_BLOB));
+            return_if_null(*context, "Out of Memory", TSS2_ESYS_RC_MEMORY);
+        }
+        mycontext = *context;
+    }
+
+    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES input");
+
+    /* Create and initialize the context */
+    if (!mycontext->ossl_context &&
+        !(mycontext->ossl_context = EVP_CIPHER_CTX_new())) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Initialize cipher context", cleanup);
+    }
+
+    /* A context which holds the cipher already only gets the key and IV. */
+    if (1 != EVP_CipherInit_ex(mycontext->ossl_context,
+                               mycontext->ossl_cipher == cipher_alg ?
+                               NULL : cipher_alg, NULL, key, iv, enc)) {
+        mycontext->ossl_cipher = NULL;
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
+                   "Initialize cipher operation", cleanup);
+    }
+    mycontext->ossl_cipher = cipher_alg;
+
+    /* Perform the encryption or decryption */
+    if (1 != EVP_CipherUpdate(mycontext->ossl_context, buffer, &cipher_len,
+                              buffer, buffer_size)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Cipher update", cleanup);
+    }
+
+    if (1 != EVP_CipherFinal_ex(mycontext->ossl_context, buffer, &cipher_len)) {
+        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Cipher final", cleanup);
+    }
+    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES output");
+
+ cleanup:
+    if (mycontext == &tmp_context)
+        OSSL_FREE(tmp_context.ossl_context, EVP_CIPHER_CTX);
+    return r;
+}
+
+/** Encrypt data with AES using a cached cipher context.
  *
+ * @param[in,out] context The cipher context cached in the session, which is
+ *                allocated on first use, or NULL.
  * @param[in] key key used for AES.
  * @param[in] tpm_sym_alg AES type in TSS2 notation (must be TPM2_ALG_AES).
  * @param[in] key_bits Key size in bits.
@@ -955,29 +1419,26 @@ iesys_cryptossl_get_ecdh_point(TPM2B_PUBLIC *key,
  * @param[in] iv The initialization vector. The size is equal to blk_len.
  * @retval TSS2_RC_SUCCESS on success, or TSS2_ESYS_RC_BAD_VALUE and
  * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters,
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
  * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
  */
 TSS2_RC
-iesys_cryptossl_sym_aes_encrypt(uint8_t * key,
-                                TPM2_ALG_ID tpm_sym_alg,
-                                TPMI_AES_KEY_BITS key_bits,
-                                TPM2_ALG_ID tpm_mode,
-                                size_t blk_len,
-                                uint8_t * buffer,
-                                size_t buffer_size,
-                                uint8_t * iv)
+iesys_cryptossl_sym_aes_encrypt_cached(IESYS_CRYPTO_SYM_CONTEXT_BLOB **context,
+                                       uint8_t * key,
+                                       TPM2_ALG_ID tpm_sym_alg,
+                                       TPMI_AES_KEY_BITS key_bits,
+                                       TPM2_ALG_ID tpm_mode,
+                                       size_t blk_len,
+                                       uint8_t * buffer,
+                                       size_t buffer_size,
+                                       uint8_t * iv)
 {
-    TSS2_RC r = TSS2_RC_SUCCESS;
     const EVP_CIPHER  *cipher_alg = NULL;
-    EVP_CIPHER_CTX *ctx = NULL;
-    int cipher_len;
 
     if (key == NULL || buffer == NULL) {
         return_error(TSS2_ESYS_RC_BAD_REFERENCE, "Bad reference");
     }
 
-    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES input");
-
     /* Parameter blk_len needed for other crypto libraries */
     (void)blk_len;
 
@@ -988,45 +1449,19 @@ iesys_cryptossl_sym_aes_encrypt(uint8_t * key,
     else if (key_bits == 256 && tpm_mode == TPM2_ALG_CFB)
         cipher_alg = EVP_aes_256_cfb();
     else {
-        goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
-                   "AES algorithm not implemented or illegal mode (CFB expected).",
-                   cleanup);
+        return_error(TSS2_ESYS_RC_BAD_VALUE,
+                     "AES algorithm not implemented or illegal mode (CFB expected).");
     }
 
     if (tpm_sym_alg != TPM2_ALG_AES) {
-        goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
-                   "AES encrypt called with wrong algorithm.", cleanup);
-    }
-
-    /* Create and initialize the context */
-    if(!(ctx = EVP_CIPHER_CTX_new())) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Initialize cipher context", cleanup);
-    }
-
-    if (1 != EVP_EncryptInit(ctx, cipher_alg,key, iv)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Initialize cipher operation", cleanup);
-    }
-
-    /* Perform the encryption */
-    if (1 != EVP_EncryptUpdate(ctx, buffer, &cipher_len, buffer, buffer_size)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Encrypt update", cleanup);
+        return_error(TSS2_ESYS_RC_BAD_VALUE,
+                     "AES encrypt called with wrong algorithm.");
     }
 
-    if (1 != EVP_EncryptFinal(ctx, buffer, &cipher_len)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Encrypt final", cleanup);
-    }
-    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES output");
-
- cleanup:
-
-    OSSL_FREE(ctx,EVP_CIPHER_CTX);
-
-    return r;
+    return sym_aes_cfb(context, cipher_alg, key, buffer, buffer_size, iv, 1);
 }
 
-/** Decrypt data with AES.
+/** Encrypt data with AES.
  *
  * @param[in] key key used for AES.
  * @param[in] tpm_sym_alg AES type in TSS2 notation (must be TPM2_ALG_AES).
@@ -1034,7 +1469,7 @@ iesys_cryptossl_sym_aes_encrypt(uint8_t * key,
  * @param[in] tpm_mode Block cipher mode of opertion in TSS2 notation (CFB).
  *            For parameter encryption only CFB can be used.
  * @param[in] blk_len Length Block length of AES.
- * @param[in,out] buffer Data to be decrypted. The decrypted date will be stored
+ * @param[in,out] buffer Data to be encrypted. The encrypted date will be stored
  *                in this buffer.
  * @param[in] buffer_size size of data to be encrypted.
  * @param[in] iv The initialization vector. The size is equal to blk_len.
@@ -1043,7 +1478,7 @@ iesys_cryptossl_sym_aes_encrypt(uint8_t * key,
  * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
  */
 TSS2_RC
-iesys_cryptossl_sym_aes_decrypt(uint8_t * key,
+iesys_cryptossl_sym_aes_encrypt(uint8_t * key,
                                 TPM2_ALG_ID tpm_sym_alg,
                                 TPMI_AES_KEY_BITS key_bits,
                                 TPM2_ALG_ID tpm_mode,
@@ -1052,10 +1487,42 @@ iesys_cryptossl_sym_aes_decrypt(uint8_t * key,
                                 size_t buffer_size,
                                 uint8_t * iv)
 {
-    TSS2_RC r = TSS2_RC_SUCCESS;
+    return iesys_cryptossl_sym_aes_encrypt_cached(NULL, key, tpm_sym_alg,
+                                                  key_bits, tpm_mode, blk_len,
+                                                  buffer, buffer_size, iv);
+}
+
+/** Decrypt data with AES using a cached cipher context.
+ *
+ * @param[in,out] context The cipher context cached in the session, which is
+ *                allocated on first use, or NULL.
+ * @param[in] key key used for AES.
+ * @param[in] tpm_sym_alg AES type in TSS2 notation (must be TPM2_ALG_AES).
+ * @param[in] key_bits Key size in bits.
+ * @param[in] tpm_mode Block cipher mode of opertion in TSS2 notation (CFB).
+ *            For parameter encryption only CFB can be used.
+ * @param[in] blk_len Length Block length of AES.
+ * @param[in,out] buffer Data to be decrypted. The decrypted date will be stored
+ *                in this buffer.
+ * @param[in] buffer_size size of data to be encrypted.
+ * @param[in] iv The initialization vector. The size is equal to blk_len.
+ * @retval TSS2_RC_SUCCESS on success, or TSS2_ESYS_RC_BAD_VALUE and
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters,
+ * @retval TSS2_ESYS_RC_MEMORY Memory cannot be allocated.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptossl_sym_aes_decrypt_cached(IESYS_CRYPTO_SYM_CONTEXT_BLOB **context,
+                                       uint8_t * key,
+                                       TPM2_ALG_ID tpm_sym_alg,
+                                       TPMI_AES_KEY_BITS key_bits,
+                                       TPM2_ALG_ID tpm_mode,
+                                       size_t blk_len,
+                                       uint8_t * buffer,
+                                       size_t buffer_size,
+                                       uint8_t * iv)
+{
     const EVP_CIPHER *cipher_alg = NULL;
-    EVP_CIPHER_CTX *ctx = NULL;
-    int cipher_len = 0;
 
     /* Parameter blk_len needed for other crypto libraries */
     (void)blk_len;
@@ -1065,8 +1532,8 @@ iesys_cryptossl_sym_aes_decrypt(uint8_t * key,
     }
 
     if (tpm_sym_alg != TPM2_ALG_AES) {
-        goto_error(r, TSS2_ESYS_RC_BAD_VALUE,
-                   "AES encrypt called with wrong algorithm.", cleanup);
+        return_error(TSS2_ESYS_RC_BAD_VALUE,
+                     "AES encrypt called with wrong algorithm.");
     }
 
     if (key_bits == 128 && tpm_mode == TPM2_ALG_CFB)
@@ -1076,40 +1543,43 @@ iesys_cryptossl_sym_aes_decrypt(uint8_t * key,
     else if (key_bits == 256 && tpm_mode == TPM2_ALG_CFB)
         cipher_alg = EVP_aes_256_cfb();
     else {
-
-        goto_error(r, TSS2_ESYS_RC_NOT_IMPLEMENTED,
-                   "AES algorithm not implemented.", cleanup);
-    }
-
-    /* Create and initialize the context */
-    if(!(ctx = EVP_CIPHER_CTX_new())) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Initialize cipher context", cleanup);
-    }
-
-    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES input");
-
-    if (1 != EVP_DecryptInit(ctx, cipher_alg, key, iv)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE,
-                   "Initialize cipher operation", cleanup);
-    }
-
-    /* Perform the decryption */
-    if (1 != EVP_DecryptUpdate(ctx, buffer, &cipher_len, buffer, buffer_size)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Encrypt update", cleanup);
-    }
-
-    if (1 != EVP_DecryptFinal(ctx, buffer, &cipher_len)) {
-        goto_error(r, TSS2_ESYS_RC_GENERAL_FAILURE, "Encrypt final", cleanup);
+        return_error(TSS2_ESYS_RC_NOT_IMPLEMENTED,
+                     "AES algorithm not implemented.");
     }
-    LOGBLOB_TRACE(buffer, buffer_size, "IESYS AES output");
 
- cleanup:
-
-    OSSL_FREE(ctx,EVP_CIPHER_CTX);
-    return r;
+    return sym_aes_cfb(context, cipher_alg, key, buffer, buffer_size, iv, 0);
 }
 
+/** Decrypt data with AES.
+ *
+ * @param[in] key key used for AES.
+ * @param[in] tpm_sym_alg AES type in TSS2 notation (must be TPM2_ALG_AES).
+ * @param[in] key_bits Key size in bits.
+ * @param[in] tpm_mode Block cipher mode of opertion in TSS2 notation (CFB).
+ *            For parameter encryption only CFB can be used.
+ * @param[in] blk_len Length Block length of AES.
+ * @param[in,out] buffer Data to be decrypted. The decrypted date will be stored
+ *                in this buffer.
+ * @param[in] buffer_size size of data to be encrypted.
+ * @param[in] iv The initialization vector. The size is equal to blk_len.
+ * @retval TSS2_RC_SUCCESS on success, or TSS2_ESYS_RC_BAD_VALUE and
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for invalid parameters,
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ */
+TSS2_RC
+iesys_cryptossl_sym_aes_decrypt(uint8_t * key,
+                                TPM2_ALG_ID tpm_sym_alg,
+                                TPMI_AES_KEY_BITS key_bits,
+                                TPM2_ALG_ID tpm_mode,
+                                size_t blk_len,
+                                uint8_t * buffer,
+                                size_t buffer_size,
+                                uint8_t * iv)
+{
+    return iesys_cryptossl_sym_aes_decrypt_cached(NULL, key, tpm_sym_alg,
+                                                  key_bits, tpm_mode, blk_len,
+                                                  buffer, buffer_size, iv);
+}
 
 /** Initialize OpenSSL crypto backend.
  *
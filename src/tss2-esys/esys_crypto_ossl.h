@@ -17,11 +17,22 @@ extern "C" {
 #define OSSL_FREE(S,TYPE) if((S) != NULL) {TYPE##_free((void*) (S)); (S)=NULL;}
 
 typedef struct _IESYS_CRYPTO_CONTEXT IESYS_CRYPTO_CONTEXT_BLOB;
+typedef struct _IESYS_CRYPTO_POOL IESYS_CRYPTO_POOL;
+typedef struct _IESYS_CRYPTO_SYM_CONTEXT IESYS_CRYPTO_SYM_CONTEXT_BLOB;
+
+void iesys_cryptossl_pool_free(IESYS_CRYPTO_POOL **pool);
+
+#define iesys_crypto_pool_free iesys_cryptossl_pool_free
 
 TSS2_RC iesys_cryptossl_hash_start(
     IESYS_CRYPTO_CONTEXT_BLOB **context,
     TPM2_ALG_ID hashAlg);
 
+TSS2_RC iesys_cryptossl_hash_start_pooled(
+    IESYS_CRYPTO_POOL **pool,
+    IESYS_CRYPTO_CONTEXT_BLOB **context,
+    TPM2_ALG_ID hashAlg);
+
 TSS2_RC iesys_cryptossl_hash_update(
     IESYS_CRYPTO_CONTEXT_BLOB *context,
     const uint8_t *buffer, size_t size);
@@ -43,6 +54,7 @@ void iesys_cryptossl_hash_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 
 #define iesys_crypto_pk_encrypt iesys_cryptossl_pk_encrypt
 #define iesys_crypto_hash_start iesys_cryptossl_hash_start
+#define iesys_crypto_hash_start_pooled iesys_cryptossl_hash_start_pooled
 #define iesys_crypto_hash_update iesys_cryptossl_hash_update
 #define iesys_crypto_hash_update2b iesys_cryptossl_hash_update2b
 #define iesys_crypto_hash_finish iesys_cryptossl_hash_finish
@@ -55,6 +67,13 @@ TSS2_RC iesys_cryptossl_hmac_start(
     const uint8_t *key,
     size_t size);
 
+TSS2_RC iesys_cryptossl_hmac_start_pooled(
+    IESYS_CRYPTO_POOL **pool,
+    IESYS_CRYPTO_CONTEXT_BLOB **context,
+    TPM2_ALG_ID hmacAlg,
+    const uint8_t *key,
+    size_t size);
+
 TSS2_RC iesys_cryptossl_hmac_start2b(
     IESYS_CRYPTO_CONTEXT_BLOB **context,
     TPM2_ALG_ID hmacAlg,
@@ -74,6 +93,11 @@ TSS2_RC iesys_cryptossl_hmac_finish(
     uint8_t *buffer,
     size_t *size);
 
+TSS2_RC iesys_cryptossl_hmac_finish_restart(
+    IESYS_CRYPTO_CONTEXT_BLOB *context,
+    uint8_t *buffer,
+    size_t *size);
+
 TSS2_RC iesys_cryptossl_hmac_finish2b(
     IESYS_CRYPTO_CONTEXT_BLOB **context,
     TPM2B *b);
@@ -81,10 +105,12 @@ TSS2_RC iesys_cryptossl_hmac_finish2b(
 void iesys_cryptossl_hmac_abort(IESYS_CRYPTO_CONTEXT_BLOB **context);
 
 #define iesys_crypto_hmac_start iesys_cryptossl_hmac_start
+#define iesys_crypto_hmac_start_pooled iesys_cryptossl_hmac_start_pooled
 #define iesys_crypto_hmac_start2b iesys_cryptossl_hmac_start2b
 #define iesys_crypto_hmac_update iesys_cryptossl_hmac_update
 #define iesys_crypto_hmac_update2b iesys_cryptossl_hmac_update2b
 #define iesys_crypto_hmac_finish iesys_cryptossl_hmac_finish
+#define iesys_crypto_hmac_finish_restart iesys_cryptossl_hmac_finish_restart
 #define iesys_crypto_hmac_finish2b iesys_cryptossl_hmac_finish2b
 #define iesys_crypto_hmac_abort iesys_cryptossl_hmac_abort
 
@@ -120,6 +146,30 @@ TSS2_RC iesys_cryptossl_sym_aes_decrypt(
     size_t dst_size,
     uint8_t *iv);
 
+TSS2_RC iesys_cryptossl_sym_aes_encrypt_cached(
+    IESYS_CRYPTO_SYM_CONTEXT_BLOB **context,
+    uint8_t *key,
+    TPM2_ALG_ID tpm_sym_alg,
+    TPMI_AES_KEY_BITS key_bits,
+    TPM2_ALG_ID tpm_mode,
+    size_t blk_len,
+    uint8_t *dst,
+    size_t dst_size,
+    uint8_t *iv);
+
+TSS2_RC iesys_cryptossl_sym_aes_decrypt_cached(
+    IESYS_CRYPTO_SYM_CONTEXT_BLOB **context,
+    uint8_t *key,
+    TPM2_ALG_ID tpm_sym_alg,
+    TPMI_AES_KEY_BITS key_bits,
+    TPM2_ALG_ID tpm_mode,
+    size_t blk_len,
+    uint8_t *dst,
+    size_t dst_size,
+    uint8_t *iv);
+
+void iesys_cryptossl_sym_free(IESYS_CRYPTO_SYM_CONTEXT_BLOB **context);
+
 TSS2_RC iesys_cryptossl_get_ecdh_point(
     TPM2B_PUBLIC *key,
     size_t max_out_size,
@@ -132,6 +182,9 @@ TSS2_RC iesys_cryptossl_get_ecdh_point(
 #define iesys_crypto_get_ecdh_point iesys_cryptossl_get_ecdh_point
 #define iesys_crypto_sym_aes_encrypt iesys_cryptossl_sym_aes_encrypt
 #define iesys_crypto_sym_aes_decrypt iesys_cryptossl_sym_aes_decrypt
+#define iesys_crypto_sym_aes_encrypt_cached iesys_cryptossl_sym_aes_encrypt_cached
+#define iesys_crypto_sym_aes_decrypt_cached iesys_cryptossl_sym_aes_decrypt_cached
+#define iesys_crypto_sym_free iesys_cryptossl_sym_free
 
 TSS2_RC iesys_cryptossl_init();
 
@@ -7,25 +7,42 @@
 #define ESYS_INT_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "tss2_esys.h"
 #include "esys_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** Linked list type for object meta data.
+/** Type for object meta data.
  *
- * This structure represents a linked list to store meta data information of
- * type IESYS_RESOURCE.
+ * This structure stores meta data information of type IESYS_RESOURCE for one
+ * ESYS_TR object.
  */
 typedef struct RSRC_NODE_T {
     ESYS_TR esys_handle;        /**< The ESYS_TR handle used by the application
                                      to reference this entry. */
     TPM2B_AUTH auth;            /**< The authValue for this resource object. */
     IESYS_RESOURCE rsrc;        /**< The meta data for this resource object. */
-    struct RSRC_NODE_T * next;  /**< The next object in the linked list. */
+    struct _IESYS_CRYPTO_SESSION_CACHE *crypto_cache; /**< The cached crypto
+                                     state of a session used for parameter
+                                     encryption, or NULL. */
 } RSRC_NODE_T;
 
+/** Hash table type for object meta data.
+ *
+ * The ESYS_TR objects of a context are stored in an open addressing hash
+ * table with linear probing which is keyed by the ESYS_TR handle. The nodes
+ * are allocated individually, so pointers to them stay valid when the table
+ * grows.
+ */
+typedef struct {
+    RSRC_NODE_T **slots;        /**< The table slots, NULL if unused. */
+    size_t size;                /**< The number of slots (a power of two). */
+    size_t count;               /**< The number of used slots. */
+} RSRC_TABLE_T;
+
 typedef struct {
     ESYS_TR tpmKey;
     ESYS_TR bind;
@@ -139,6 +156,29 @@ enum _ESYS_STATE {
                                    ESAPI code. */
 };
 
+/** The metrics of the command currently executed. */
+typedef struct {
+    bool sent;                   /**< The command was sent to the TPM. */
+    TPM2_CC commandCode;         /**< The command code in host endianness. */
+    UINT64 start;                /**< Start of the client side processing. */
+    UINT64 submitted;            /**< Time of the last submission. */
+    UINT64 client_ns;            /**< Client side processing time. */
+    UINT64 tpm_ns;               /**< Time waiting for the TPM. */
+    UINT64 bytes_sent;           /**< Bytes sent to the TPM. */
+    UINT64 bytes_received;       /**< Bytes received from the TPM. */
+    UINT32 resubmissions;        /**< Number of resubmissions. */
+} IESYS_CMD_METRICS;
+
+/** Number of command codes for which metrics are recorded. */
+#define IESYS_METRICS_COMMANDS (TPM2_CC_LAST - TPM2_CC_FIRST + 1)
+
+/** The metrics recorded if enabled with Esys_SetMetrics(). */
+typedef struct {
+    ESYS_COMMAND_METRICS commands[IESYS_METRICS_COMMANDS]; /**< Indexed by
+                                      command code - TPM2_CC_FIRST. */
+    IESYS_CMD_METRICS current;   /**< The command not yet accounted. */
+} IESYS_METRICS;
+
 /** The data structure holding internal state information.
  *
  * Each ESYS_CONTEXT respresents a logically independent connection to the TPM.
@@ -150,7 +190,7 @@ struct ESYS_CONTEXT {
     TSS2_SYS_CONTEXT *sys;       /**< The SYS context used internally to talk to
                                       the TPM. */
     ESYS_TR esys_handle_cnt;     /**< The next free ESYS_TR number. */
-    RSRC_NODE_T *rsrc_list;      /**< The linked list of all ESYS_TR objects. */
+    RSRC_TABLE_T rsrc_table;     /**< The hash table of all ESYS_TR objects. */
     int32_t timeout;             /**< The timeout to be used during
                                       Tss2_Sys_ExecuteFinish. */
     ESYS_TR session_type[3];     /**< The list of TPM session handles in the
@@ -176,6 +216,11 @@ struct ESYS_CONTEXT {
                                       automatically loaded. */
     IESYS_SESSION *enc_session;  /**< Ptr to the enc param session.
                                       Used to restore session attributes */
+    struct _IESYS_CRYPTO_POOL *crypto_pool; /**< The reusable hash and HMAC
+                                                 contexts of the crypto
+                                                 backend. */
+    IESYS_METRICS *metrics;      /**< The recorded metrics or NULL if metrics
+                                      are disabled. */
 };
 
 /** The number of authomatic resubmissions.
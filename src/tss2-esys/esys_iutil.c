@@ -8,6 +8,10 @@
 #endif
 
 #include <inttypes.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #include "tss2_esys.h"
 #include "esys_mu.h"
@@ -17,6 +21,7 @@
 #define LOGMODULE esys
 #include "util/log.h"
 #include "util/aux_util.h"
+#include "util/tss2_endian.h"
 
 /**
  * Compare variables of type UINT16.
@@ -136,22 +141,103 @@ init_session_tab(ESYS_CONTEXT *esys_context,
     return r;
 }
 
+/** The initial number of slots of the resource table. */
+#define RSRC_TABLE_MIN_SIZE 16
+
+/** Compute the home slot of an ESYS_TR in a resource table.
+ *
+ * ESYS_TR handles are mostly handed out sequentially, a multiplicative hash
+ * spreads them over the table nonetheless.
+ * @param[in] esys_handle The ESYS_TR handle.
+ * @param[in] size The number of slots of the table (a power of two).
+ * @retval The index of the home slot.
+ */
+static size_t
+rsrc_table_hash(ESYS_TR esys_handle, size_t size)
+{
+    return ((size_t) esys_handle * 0x9E3779B1U) & (size - 1);
+}
+
+/** Find the slot of an ESYS_TR in a resource table.
+ *
+ * @param[in] table The resource table; it must have at least one free slot.
+ * @param[in] esys_handle The ESYS_TR handle to search for.
+ * @retval The index of the slot holding the object or of the free slot
+ *         where the object would have to be inserted.
+ */
+static size_t
+rsrc_table_find(const RSRC_TABLE_T *table, ESYS_TR esys_handle)
+{
+    size_t i = rsrc_table_hash(esys_handle, table->size);
+
+    while (table->slots[i] != NULL &&
+           table->slots[i]->esys_handle != esys_handle) {
+        i = (i + 1) & (table->size - 1);
+    }
+    return i;
+}
+
+/** Resize a resource table.
+ *
+ * All objects are re-inserted into a newly allocated slot array.
+ * @param[in,out] table The resource table.
+ * @param[in] size The new number of slots (a power of two).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY if the slots can not be allocated.
+ */
+static TSS2_RC
+rsrc_table_resize(RSRC_TABLE_T *table, size_t size)
+{
+    RSRC_TABLE_T new_table = { .size = size, .count = table->count };
+    size_t i;
+
+    new_table.slots = calloc(size, sizeof(RSRC_NODE_T *));
+    return_if_null(new_table.slots, "Out of memory.", TSS2_ESYS_RC_MEMORY);
+
+    for (i = 0; i < table->size; i++) {
+        if (table->slots[i] != NULL) {
+            new_table.slots[rsrc_table_find(&new_table,
+                                            table->slots[i]->esys_handle)]
+                = table->slots[i];
+        }
+    }
+    SAFE_FREE(table->slots);
+    *table = new_table;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free an esys resource object.
+ *
+ * @param[in,out] node The resource object, which will be set to NULL.
+ */
+static void
+rsrc_node_free(RSRC_NODE_T **node)
+{
+    iesys_crypto_session_cache_free(&(*node)->crypto_cache);
+    SAFE_FREE(*node);
+}
+
 /** Delete all resource objects stored in the esys context.
  *
- * All resource objects stored in a linked list of the esys context are deleted.
+ * All resource objects stored in the resource table of the esys context are
+ * deleted and the table is released.
  * @param[in,out] esys_context The ESYS_CONTEXT
  */
 void
 iesys_DeleteAllResourceObjects(ESYS_CONTEXT * esys_context)
 {
-    RSRC_NODE_T *node_rsrc;
-    RSRC_NODE_T *next_node_rsrc;
-    for (node_rsrc = esys_context->rsrc_list; node_rsrc != NULL;
-         node_rsrc = next_node_rsrc) {
-        next_node_rsrc = node_rsrc->next;
-        SAFE_FREE(node_rsrc);
+    RSRC_TABLE_T *table = &esys_context->rsrc_table;
+    size_t i;
+
+    for (i = 0; i < table->size && table->count > 0; i++) {
+        if (table->slots[i] != NULL) {
+            rsrc_node_free(&table->slots[i]);
+            table->count -= 1;
+        }
     }
-    esys_context->rsrc_list = NULL;
+    SAFE_FREE(table->slots);
+    table->size = 0;
+    table->count = 0;
 }
 /**  Compute the TPM nonce of the session used for parameter encryption.
  *
@@ -239,7 +325,8 @@ iesys_compute_cp_hashtab(ESYS_CONTEXT * esys_context,
             /* If not, we compute it and append it to the list */
             if (!cpHashFound) {
                 cp_hash_tab[*cpHashNum].size = sizeof(TPMU_HA);
-                r = iesys_crypto_cpHash(session->rsrc.misc.rsrc_session.
+                r = iesys_crypto_cpHash(&esys_context->crypto_pool,
+                                        session->rsrc.misc.rsrc_session.
                                         authHash, ccBuffer, name1, name2, name3,
                                         cpBuffer, cpBuffer_size,
                                         &cp_hash_tab[*cpHashNum].digest[0],
@@ -302,7 +389,8 @@ iesys_compute_rp_hashtab(ESYS_CONTEXT * esys_context,
         /* If not, we compute it and append it to the list */
         if (!rpHashFound) {
             rp_hash_tab[*rpHashNum].size = sizeof(TPMU_HA);
-            r = iesys_crypto_rpHash(session->rsrc.misc.rsrc_session.authHash,
+            r = iesys_crypto_rpHash(&esys_context->crypto_pool,
+                                    session->rsrc.misc.rsrc_session.authHash,
                                     rcBuffer, ccBuffer, rpBuffer, rpBuffer_size,
                                     &rp_hash_tab[*rpHashNum].digest[0],
                                     &rp_hash_tab[*rpHashNum].size);
@@ -316,32 +404,85 @@ iesys_compute_rp_hashtab(ESYS_CONTEXT * esys_context,
 }
 /** Create an esys resource object corresponding to a TPM object.
  *
- * The esys object is appended to the resource list stored in the esys context
- * (rsrc_list).
+ * The esys object is inserted into the resource table stored in the esys
+ * context (rsrc_table). The table is grown when it becomes three quarters
+ * full.
  * @param[in] esys_context The ESYS_CONTEXT
  * @param[in] esys_handle The esys handle which will be used for this object.
  * @param[out] esys_object The new resource object.
  * @retval TSS2_RC_SUCCESS on success.
  * @retval TSS2_ESYS_RC_MEMORY if the object can not be allocated.
+ * @retval TSS2_ESYS_RC_BAD_TR if an object with this handle already exists.
  */
 TSS2_RC
 esys_CreateResourceObject(ESYS_CONTEXT * esys_context,
                           ESYS_TR esys_handle, RSRC_NODE_T ** esys_object)
 {
-    RSRC_NODE_T *new_esys_object = calloc(1, sizeof(RSRC_NODE_T));
+    RSRC_TABLE_T *table = &esys_context->rsrc_table;
+    RSRC_NODE_T *new_esys_object;
+    size_t slot;
+    TSS2_RC r;
+
+    if (table->slots == NULL) {
+        r = rsrc_table_resize(table, RSRC_TABLE_MIN_SIZE);
+        return_if_error(r, "Allocating resource table.");
+    } else if ((table->count + 1) * 4 > table->size * 3) {
+        r = rsrc_table_resize(table, table->size * 2);
+        return_if_error(r, "Growing resource table.");
+    }
+
+    slot = rsrc_table_find(table, esys_handle);
+    if (table->slots[slot] != NULL) {
+        LOG_ERROR("Esys handle already exists (%" PRIx32 ").", esys_handle);
+        return TSS2_ESYS_RC_BAD_TR;
+    }
+
+    new_esys_object = calloc(1, sizeof(RSRC_NODE_T));
     if (new_esys_object == NULL)
         return_error(TSS2_ESYS_RC_MEMORY, "Out of memory.");
-    if (esys_context->rsrc_list == NULL) {
-        /* The first object of the list will be added */
-        esys_context->rsrc_list = new_esys_object;
-        new_esys_object->next = NULL;
-    } else {
-        /* The new object will become the first element of the list */
-        new_esys_object->next = esys_context->rsrc_list;
-        esys_context->rsrc_list = new_esys_object;
-    }
-    *esys_object = new_esys_object;
     new_esys_object->esys_handle = esys_handle;
+    table->slots[slot] = new_esys_object;
+    table->count += 1;
+    *esys_object = new_esys_object;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Delete an esys resource object.
+ *
+ * The object is removed from the resource table of the esys context and
+ * freed. The following objects of the probe sequence are shifted back, so
+ * that no tombstones are needed.
+ * @param[in,out] esys_context The ESYS_CONTEXT
+ * @param[in] esys_handle The esys handle of the object to be deleted.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_BAD_TR if the object does not exist.
+ */
+TSS2_RC
+esys_DeleteResourceObject(ESYS_CONTEXT * esys_context, ESYS_TR esys_handle)
+{
+    RSRC_TABLE_T *table = &esys_context->rsrc_table;
+    size_t mask = table->size - 1;
+    size_t i, j, home;
+
+    if (table->count == 0)
+        return TSS2_ESYS_RC_BAD_TR;
+
+    i = rsrc_table_find(table, esys_handle);
+    if (table->slots[i] == NULL)
+        return TSS2_ESYS_RC_BAD_TR;
+
+    rsrc_node_free(&table->slots[i]);
+    table->count -= 1;
+
+    for (j = (i + 1) & mask; table->slots[j] != NULL; j = (j + 1) & mask) {
+        home = rsrc_table_hash(table->slots[j]->esys_handle, table->size);
+        /* Move the entry unless its home slot lies cyclically in (i, j]. */
+        if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) {
+            table->slots[i] = table->slots[j];
+            table->slots[j] = NULL;
+            i = j;
+        }
+    }
     return TSS2_RC_SUCCESS;
 }
 
@@ -696,13 +837,6 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
         if (rsrc_session->sessionAttributes & TPMA_SESSION_DECRYPT) {
             *decryptNonceIdx = i;
             *decryptNonce = &rsrc_session->nonceTPM;
-            size_t hlen;
-            r = iesys_crypto_hash_get_digest_size(rsrc_session->authHash, &hlen);
-            return_if_error(r, "get digest size");
-            size_t key_len = TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE;
-            if (key_len % hlen > 0)
-                key_len = key_len + hlen - (key_len % hlen);
-            uint8_t symKey[key_len];
             size_t paramSize = 0;
             const uint8_t *paramBuffer;
 
@@ -723,28 +857,22 @@ iesys_encrypt_param(ESYS_CONTEXT * esys_context,
                     return_error(TSS2_ESYS_RC_BAD_VALUE,
                                  "Invalid symmetric mode (must be CFB)");
                 }
-                r = iesys_crypto_KDFa(rsrc_session->authHash,
-                                      &rsrc_session->sessionValue[0],
-                                      rsrc_session->sizeSessionValue, "CFB",
-                                      &rsrc_session->nonceCaller,
-                                      &rsrc_session->nonceTPM,
-                                      symDef->keyBits.aes + AES_BLOCK_SIZE_IN_BYTES * 8,
-                                      NULL, &symKey[0], FALSE);
-                return_if_error(r, "while computing KDFa");
-
-                size_t aes_off = ( symDef->keyBits.aes + 7) / 8;
-                r = iesys_crypto_sym_aes_encrypt(&symKey[0],
-                                                 symDef->algorithm,
-                                                 symDef->keyBits.aes,
-                                                 symDef->mode.aes,
-                                                 AES_BLOCK_SIZE_IN_BYTES,
-                                                 &encrypt_buffer[0], paramSize,
-                                                 &symKey[aes_off]);
+                r = iesys_crypto_param_aes_cfb(&esys_context->crypto_pool,
+                                               &session->crypto_cache,
+                                               rsrc_session->authHash,
+                                               &rsrc_session->sessionValue[0],
+                                               rsrc_session->sizeSessionValue,
+                                               &rsrc_session->nonceCaller,
+                                               &rsrc_session->nonceTPM,
+                                               symDef->keyBits.aes,
+                                               &encrypt_buffer[0], paramSize,
+                                               TRUE);
                 return_if_error(r, "AES encryption not possible");
             }
             /* XOR obfuscation of parameter */
             else if (symDef->algorithm == TPM2_ALG_XOR) {
-                r = iesys_xor_parameter_obfuscation(rsrc_session->authHash,
+                r = iesys_xor_parameter_obfuscation(&esys_context->crypto_pool,
+                                                    rsrc_session->authHash,
                                                     &rsrc_session->sessionValue[0],
                                                     rsrc_session->sizeSessionValue,
                                                     &rsrc_session->nonceCaller,
@@ -785,23 +913,14 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
     TSS2_RC r;
     const uint8_t *ciphertext;
     size_t p2BSize;
-    size_t hlen;
     RSRC_NODE_T *session;
     IESYS_SESSION *rsrc_session;
     TPMT_SYM_DEF *symDef;
-    size_t key_len = TPM2_MAX_SYM_KEY_BYTES + TPM2_MAX_SYM_BLOCK_SIZE;
 
     session = esys_context->session_tab[esys_context->encryptNonceIdx];
     rsrc_session = &session->rsrc.misc.rsrc_session;
     symDef = &rsrc_session->symmetric;
 
-    r = iesys_crypto_hash_get_digest_size(rsrc_session->authHash, &hlen);
-    return_if_error(r, "Error");
-    if (key_len % hlen > 0)
-        key_len = key_len + hlen - (key_len % hlen);
-
-    uint8_t symKey[key_len];
-
     r = Tss2_Sys_GetEncryptParam(esys_context->sys, &p2BSize, &ciphertext);
     return_if_error(r, "Getting encrypt param");
 
@@ -818,35 +937,23 @@ iesys_decrypt_param(ESYS_CONTEXT * esys_context)
                       rsrc_session->sessionKey.size,
                       "IESYS encrypt session key");
 
-        r = iesys_crypto_KDFa(rsrc_session->authHash,
-                              &rsrc_session->sessionValue[0],
-                              rsrc_session->sizeSessionValue,
-                              "CFB", &rsrc_session->nonceTPM,
-                              &rsrc_session->nonceCaller,
-                              symDef->keyBits.aes
-                              + AES_BLOCK_SIZE_IN_BYTES * 8, NULL,
-                              &symKey[0], FALSE);
-        return_if_error(r, "KDFa error");
-        LOGBLOB_DEBUG(&symKey[0],
-                      ((symDef->keyBits.aes +
-                        AES_BLOCK_SIZE_IN_BYTES * 8) + 7) / 8,
-                      "IESYS encrypt KDFa key");
-
-        size_t aes_off = ( symDef->keyBits.aes + 7) / 8;
-        r = iesys_crypto_sym_aes_decrypt(&symKey[0],
-                                     symDef->algorithm,
-                                     symDef->keyBits.aes,
-                                     symDef->mode.aes,
-                                     AES_BLOCK_SIZE_IN_BYTES,
-                                     &plaintext[0], p2BSize,
-                                     &symKey[aes_off]);
+        r = iesys_crypto_param_aes_cfb(&esys_context->crypto_pool,
+                                       &session->crypto_cache,
+                                       rsrc_session->authHash,
+                                       &rsrc_session->sessionValue[0],
+                                       rsrc_session->sizeSessionValue,
+                                       &rsrc_session->nonceTPM,
+                                       &rsrc_session->nonceCaller,
+                                       symDef->keyBits.aes,
+                                       &plaintext[0], p2BSize, FALSE);
         return_if_error(r, "Decryption error");
 
         r = Tss2_Sys_SetEncryptParam(esys_context->sys, p2BSize, &plaintext[0]);
         return_if_error(r, "Setting plaintext");
     } else if (symDef->algorithm == TPM2_ALG_XOR) {
         /* Parameter decryption with XOR obfuscation */
-        r = iesys_xor_parameter_obfuscation(rsrc_session->authHash,
+        r = iesys_xor_parameter_obfuscation(&esys_context->crypto_pool,
+                                            rsrc_session->authHash,
                                             &rsrc_session->sessionValue[0],
                                             rsrc_session->sizeSessionValue,
                                             &rsrc_session->nonceTPM,
@@ -919,7 +1026,8 @@ iesys_check_rp_hmacs(ESYS_CONTEXT * esys_context,
         rsrc_session->nonceTPM = rspAuths->auths[i].nonce;
         rsrc_session->sessionAttributes =
             rspAuths->auths[i].sessionAttributes;
-        r = iesys_crypto_authHmac(rsrc_session->authHash,
+        r = iesys_crypto_authHmac(&esys_context->crypto_pool,
+                                  rsrc_session->authHash,
                                   &rsrc_session->sessionValue[0],
                                   rsrc_session->sizeHmacValue,
                                   &rp_hash_tab[hi].digest[0],
@@ -1081,14 +1189,15 @@ esys_GetResourceObject(ESYS_CONTEXT * esys_context,
     }
 
     /* The typical case is that we have a resource object already within the
-       esys context's linked list. We iterate through the list and search
-       for the corresponding object and return it if found.
+       esys context's resource table. We look up the corresponding object
+       and return it if found.
        If no object is found, this can be an erroneous handle number or it
        can be because of a reference "global" object that does not require
        previous initialization. */
-    for (esys_object_aux = esys_context->rsrc_list; esys_object_aux != NULL;
-         esys_object_aux = esys_object_aux->next) {
-        if (esys_object_aux->esys_handle == esys_handle) {
+    if (esys_context->rsrc_table.count > 0) {
+        esys_object_aux = esys_context->rsrc_table.slots[
+            rsrc_table_find(&esys_context->rsrc_table, esys_handle)];
+        if (esys_object_aux != NULL) {
             *esys_object = esys_object_aux;
             return TPM2_RC_SUCCESS;
         }
@@ -1125,6 +1234,79 @@ esys_GetResourceObject(ESYS_CONTEXT * esys_context,
     return TSS2_RC_SUCCESS;
 }
 
+/** Get the time of a monotonic clock in nanoseconds. */
+static UINT64
+metrics_time_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (UINT64) (counter.QuadPart / frequency.QuadPart) * 1000000000 +
+        (UINT64) (counter.QuadPart % frequency.QuadPart) * 1000000000 /
+        (UINT64) frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UINT64) ts.tv_sec * 1000000000 + (UINT64) ts.tv_nsec;
+#endif
+}
+
+/** Compute the histogram bucket of a latency.
+ *
+ * @param[in] ns The latency in nanoseconds.
+ * @retval The index of the bucket counting the latency.
+ */
+static size_t
+metrics_bucket(UINT64 ns)
+{
+    UINT64 us = ns / 1000;
+    size_t bucket = 0;
+
+    while (us && bucket < ESYS_METRICS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/** Account the metrics of the last command executed.
+ *
+ * The client side processing of the response ends after the _Finish function
+ * returned, so the metrics of a command are accounted when the next command
+ * starts or the metrics are retrieved.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ */
+void
+iesys_metrics_commit(ESYS_CONTEXT *esys_context)
+{
+    IESYS_METRICS *metrics = esys_context->metrics;
+    IESYS_CMD_METRICS *current;
+    ESYS_COMMAND_METRICS *cmd;
+
+    if (!metrics || !metrics->current.sent)
+        return;
+
+    current = &metrics->current;
+    current->sent = false;
+    if (current->commandCode < TPM2_CC_FIRST || current->commandCode > TPM2_CC_LAST)
+        return;
+
+    cmd = &metrics->commands[current->commandCode - TPM2_CC_FIRST];
+    cmd->commandCode = current->commandCode;
+    cmd->calls += 1;
+    cmd->resubmissions += current->resubmissions;
+    cmd->bytesSent += current->bytes_sent;
+    cmd->bytesReceived += current->bytes_received;
+    cmd->clientNs += current->client_ns;
+    cmd->tpmNs += current->tpm_ns;
+    cmd->clientHistogram[metrics_bucket(current->client_ns)] += 1;
+    cmd->tpmHistogram[metrics_bucket(current->tpm_ns)] += 1;
+}
+
 /**
  * Check that the esys context is ready for an _async call.
  *
@@ -1150,6 +1332,12 @@ iesys_check_sequence_async(ESYS_CONTEXT * esys_context)
         return TSS2_ESYS_RC_BAD_SEQUENCE;
     }
     esys_context->submissionCount = 1;
+
+    if (esys_context->metrics) {
+        iesys_metrics_commit(esys_context);
+        memset(&esys_context->metrics->current, 0, sizeof(IESYS_CMD_METRICS));
+        esys_context->metrics->current.start = metrics_time_ns();
+    }
     return TSS2_RC_SUCCESS;
 }
 
@@ -1191,6 +1379,7 @@ check_session_feasibility(ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3,
  * The HMAC is computed from the appropriate cp hash, the caller nonce, the TPM
  * nonce and the session attributes. If an encrypt session is not the first
  * session also the encrypt and the decrypt nonce have to be included.
+ * @param[in,out] esys_context The ESYS context providing the crypto pool.
  * @param[in] session The session for which the HMAC has to be computed.
  * @param[in] cp_hash_tab The table of computed cp hash values.
  * @param[in] cpHashNum The number of computed cp hash values which depens on
@@ -1209,7 +1398,8 @@ check_session_feasibility(ESYS_TR shandle1, ESYS_TR shandle2, ESYS_TR shandle3,
  * @retval TSS2_SYS_RC_* for SAPI errors.
  */
 TSS2_RC
-iesys_compute_hmac(RSRC_NODE_T * session,
+iesys_compute_hmac(ESYS_CONTEXT * esys_context,
+                   RSRC_NODE_T * session,
                    HASH_TAB_ITEM cp_hash_tab[3],
                    uint8_t cpHashNum,
                    TPM2B_NONCE * decryptNonce,
@@ -1236,7 +1426,8 @@ iesys_compute_hmac(RSRC_NODE_T * session,
         /* if other than first session is used for for parameter encryption
            the corresponding nonces have to be included into the hmac
            computation of the first session */
-        r = iesys_crypto_authHmac(rsrc_session->authHash,
+        r = iesys_crypto_authHmac(&esys_context->crypto_pool,
+                                  rsrc_session->authHash,
                                   &rsrc_session->sessionValue[0],
                                   rsrc_session->sizeHmacValue,
                                   &cp_hash_tab[hi].digest[0],
@@ -1336,7 +1527,8 @@ iesys_gen_auths(ESYS_CONTEXT * esys_context,
                 continue;
             }
         }
-        r = iesys_compute_hmac(esys_context->session_tab[session_idx],
+        r = iesys_compute_hmac(esys_context,
+                               esys_context->session_tab[session_idx],
                                &cp_hash_tab[0], cpHashNum,
                                (session_idx == 0
                                 && decryptNonceIdx > 0) ? decryptNonce : NULL,
@@ -1371,8 +1563,8 @@ iesys_gen_auths(ESYS_CONTEXT * esys_context,
  * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if hash algorithm is not implemented.
  * @retval TSS2_SYS_RC_* for SAPI errors.
  */
-TSS2_RC
-iesys_check_response(ESYS_CONTEXT * esys_context)
+static TSS2_RC
+check_response(ESYS_CONTEXT * esys_context)
 {
     TSS2_RC r;
     const uint8_t *rpBuffer;
@@ -1427,6 +1619,100 @@ iesys_check_response(ESYS_CONTEXT * esys_context)
     return TSS2_RC_SUCCESS;
 }
 
+/** Check the response of a TPM command and record its processing time.
+ *
+ * See check_response() for the checks of the response.
+ *
+ * @param[in] esys_context The esys context which is used to get the response
+ * auth values and the sessions.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_ESYS_RC_MEMORY Memory can not be allocated.
+ * @retval TSS2_ESYS_RC_BAD_VALUE for invalid parameters.
+ * @retval TSS2_ESYS_RC_BAD_REFERENCE for unexpected NULL pointer parameters.
+ * @retval TSS2_ESYS_RC_GENERAL_FAILURE for errors of the crypto library.
+ * @retval TSS2_ESYS_RC_NOT_IMPLEMENTED if hash algorithm is not implemented.
+ * @retval TSS2_SYS_RC_* for SAPI errors.
+ */
+TSS2_RC
+iesys_check_response(ESYS_CONTEXT * esys_context)
+{
+    TSS2_RC r;
+    UINT64 start;
+
+    if (!esys_context->metrics)
+        return check_response(esys_context);
+
+    start = metrics_time_ns();
+    r = check_response(esys_context);
+    esys_context->metrics->current.client_ns += metrics_time_ns() - start;
+    return r;
+}
+
+/** Send the prepared command to the TPM.
+ *
+ * Wrapper for Tss2_Sys_ExecuteAsync() which records the metrics of the
+ * command if enabled. Called by the _Async functions and for the
+ * resubmission of commands in the _Finish functions.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_SYS_RC_* for SAPI errors.
+ * @retval TSS2_TCTI_RC_* for TCTI errors.
+ */
+TSS2_RC
+iesys_execute_async(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+    IESYS_CMD_METRICS *current;
+    _TSS2_SYS_CONTEXT_BLOB *sys;
+
+    r = Tss2_Sys_ExecuteAsync(esys_context->sys);
+    if (!esys_context->metrics || r != TSS2_RC_SUCCESS)
+        return r;
+
+    current = &esys_context->metrics->current;
+    sys = syscontext_cast(esys_context->sys);
+    current->submitted = metrics_time_ns();
+    if (esys_context->state == _ESYS_STATE_RESUBMISSION) {
+        current->resubmissions += 1;
+    } else {
+        current->sent = true;
+        current->commandCode = sys->commandCode;
+        current->client_ns = current->submitted - current->start;
+    }
+    current->bytes_sent += BE_TO_HOST_32(req_header_from_cxt(sys)->commandSize);
+    return r;
+}
+
+/** Receive the response of the TPM.
+ *
+ * Wrapper for Tss2_Sys_ExecuteFinish() which records the metrics of the
+ * command if enabled.
+ *
+ * @param[in,out] esys_context The ESYS_CONTEXT.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_TCTI_RC_TRY_AGAIN if the response is not yet available.
+ * @retval TSS2_SYS_RC_* for SAPI errors.
+ * @retval TSS2_TCTI_RC_* for TCTI errors.
+ * @retval TPM2_RC_* for TPM errors.
+ */
+TSS2_RC
+iesys_execute_finish(ESYS_CONTEXT *esys_context)
+{
+    TSS2_RC r;
+    IESYS_CMD_METRICS *current;
+
+    r = Tss2_Sys_ExecuteFinish(esys_context->sys, esys_context->timeout);
+    if (!esys_context->metrics || base_rc(r) == TSS2_BASE_RC_TRY_AGAIN)
+        return r;
+
+    current = &esys_context->metrics->current;
+    current->tpm_ns += metrics_time_ns() - current->submitted;
+    if (r == TSS2_RC_SUCCESS || iesys_tpm_error(r))
+        current->bytes_received += syscontext_cast(esys_context->sys)->rsp_header.responseSize;
+    return r;
+}
+
 /** Compute the name from the public data of a NV index.
  *
  * The name of a NV index is computed as follows:
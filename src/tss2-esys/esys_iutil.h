@@ -70,6 +70,10 @@ TSS2_RC esys_CreateResourceObject(
     ESYS_TR esys_handle,
     RSRC_NODE_T **node);
 
+TSS2_RC esys_DeleteResourceObject(
+    ESYS_CONTEXT *esys_context,
+    ESYS_TR esys_handle);
+
 TSS2_RC iesys_handle_to_tpm_handle(
     ESYS_TR esys_handle,
     TPM2_HANDLE *tpm_handle);
@@ -139,6 +143,7 @@ void iesys_compute_session_value(
     const TPM2B_AUTH *auth_value);
 
 TSS2_RC iesys_compute_hmac(
+    ESYS_CONTEXT *esys_context,
     RSRC_NODE_T *session,
     HASH_TAB_ITEM cp_hash_tab[3],
     uint8_t cpHashNum,
@@ -156,6 +161,15 @@ TSS2_RC iesys_gen_auths(
 TSS2_RC iesys_check_response(
     ESYS_CONTEXT * esys_context);
 
+TSS2_RC iesys_execute_async(
+    ESYS_CONTEXT *esys_context);
+
+TSS2_RC iesys_execute_finish(
+    ESYS_CONTEXT *esys_context);
+
+void iesys_metrics_commit(
+    ESYS_CONTEXT *esys_context);
+
 TSS2_RC iesys_nv_get_name(
     TPM2B_NV_PUBLIC *publicInfo,
     TPM2B_NAME *name);
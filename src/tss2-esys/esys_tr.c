@@ -339,23 +339,16 @@ Esys_TR_FromTPMPublic(ESYS_CONTEXT * esys_context,
 TSS2_RC
 Esys_TR_Close(ESYS_CONTEXT * esys_context, ESYS_TR * object)
 {
-    RSRC_NODE_T *node;
-    RSRC_NODE_T **update_ptr;
+    TSS2_RC r;
 
     _ESYS_ASSERT_NON_NULL(esys_context);
-    for (node = esys_context->rsrc_list,
-         update_ptr = &esys_context->rsrc_list;
-         node != NULL;
-         update_ptr = &node->next, node = node->next) {
-        if (node->esys_handle == *object) {
-            *update_ptr = node->next;
-            SAFE_FREE(node);
-            *object = ESYS_TR_NONE;
-            return TSS2_RC_SUCCESS;
-        }
+    r = esys_DeleteResourceObject(esys_context, *object);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_ERROR("Error: Esys handle does not exist (%x).", r);
+        return r;
     }
-    LOG_ERROR("Error: Esys handle does not exist (%x).", TSS2_ESYS_RC_BAD_TR);
-    return TSS2_ESYS_RC_BAD_TR;
+    *object = ESYS_TR_NONE;
+    return TSS2_RC_SUCCESS;
 }
 
 /** Set the authorization value of an ESYS_TR.
@@ -387,7 +387,8 @@ Fapi_ChangeAuth_Finish(
 
             /* Flush the parent key as well. */
             if (!context->loadKey.parent_handle_persistent
-                    && context->loadKey.parent_handle != ESYS_TR_NONE) {
+                    && context->loadKey.parent_handle != ESYS_TR_NONE
+                    && !ifapi_object_cached(context, context->loadKey.parent_handle)) {
                 r = Esys_FlushContext_Async(context->esys, context->loadKey.parent_handle);
                 goto_if_error(r, "Flush parent", error_cleanup);
 
@@ -540,7 +541,8 @@ Fapi_ChangeAuth_Finish(
 
 error_cleanup:
     /* In error cases object might not be flushed. */
-    if (context->loadKey.parent_handle != ESYS_TR_NONE)
+    if (context->loadKey.parent_handle != ESYS_TR_NONE &&
+        !ifapi_object_cached(context, context->loadKey.parent_handle))
         Esys_FlushContext(context->esys, context->loadKey.parent_handle);
     if (command->handle != ESYS_TR_NONE)
         Esys_FlushContext(context->esys, command->handle);
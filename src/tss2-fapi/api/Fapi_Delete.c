@@ -442,6 +442,9 @@ Fapi_Delete_Async(
         r = ifapi_session_init(context);
         return_if_error(r, "Initialize Entity_Delete");
 
+        /* Keys kept resident might be deleted. */
+        ifapi_key_cache_flush(context);
+
         r = ifapi_get_sessions_async(context,
                                  IFAPI_SESSION_GENEK | IFAPI_SESSION1,
                                  0, 0);
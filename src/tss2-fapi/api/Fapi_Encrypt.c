@@ -360,7 +360,8 @@ Fapi_Encrypt_Finish(
             SAFE_FREE(tpmCipherText);
 
             /* Flush the key from the TPM. */
-            if (!command->key_object->misc.key.persistent_handle) {
+            if (!command->key_object->misc.key.persistent_handle &&
+                !ifapi_object_cached(context, command->key_handle)) {
                 r = Esys_FlushContext_Async(context->esys,
                                         command->key_handle);
                 goto_if_error(r, "Error: FlushContext", error_cleanup);
@@ -368,7 +369,8 @@ Fapi_Encrypt_Finish(
             fallthrough;
 
         statecase(context->state, DATA_ENCRYPT_WAIT_FOR_FLUSH);
-            if (!command->key_object->misc.key.persistent_handle) {
+            if (!command->key_object->misc.key.persistent_handle &&
+                !ifapi_object_cached(context, command->key_handle)) {
                 r = Esys_FlushContext_Finish(context->esys);
                 return_try_again(r);
 
@@ -394,7 +396,8 @@ Fapi_Encrypt_Finish(
 
 error_cleanup:
     /* Cleanup any intermediate results and state stored in the context. */
-    if (command->key_handle != ESYS_TR_NONE)
+    if (command->key_handle != ESYS_TR_NONE &&
+        !ifapi_object_cached(context, command->key_handle))
         Esys_FlushContext(context->esys,  command->key_handle);
     if (r)
         SAFE_FREE(command->cipherText);
@@ -53,6 +53,11 @@ Fapi_Finalize(
     TSS2_TCTI_CONTEXT *tcti = NULL;
 
     if ((*context)->esys) {
+        /* Flush the sessions and objects kept loaded across commands. */
+        ifapi_session_pool_flush(*context);
+        ifapi_primary_cache_flush(*context);
+        ifapi_key_cache_flush(*context);
+
         Esys_GetTcti((*context)->esys, &tcti);
         Esys_Finalize(&((*context)->esys));
         if (tcti) {
@@ -61,11 +66,14 @@ Fapi_Finalize(
         }
     }
 
+    /* Drop the files read ahead. */
+    ifapi_io_batch_cleanup(&(*context)->io);
+
     /* Finalize the keystore module. */
     ifapi_cleanup_ifapi_keystore(&(*context)->keystore);
 
     /* Finalize the policy module. */
-    SAFE_FREE((*context)->pstore.policydir);
+    ifapi_cleanup_policy_store(&(*context)->pstore);
 
     /* Finalize leftovers from provisioning. */
     SAFE_FREE((*context)->cmd.Provision.root_crt);
@@ -83,7 +91,18 @@ Fapi_Finalize(
     SAFE_FREE((*context)->config.intel_cert_service);
 
     /* Finalize the eventlog module. */
-    SAFE_FREE((*context)->eventlog.log_dir);
+    ifapi_eventlog_cleanup(&(*context)->eventlog);
+
+    /* Finalize the directory walk of Fapi_ListNext. */
+    ifapi_io_dirwalk_cleanup(&(*context)->list_walk);
+
+    /* Finalize the replay cache of Fapi_VerifyQuote. */
+    ifapi_pcr_replay_cache_free(&(*context)->pcr_replay_cache);
+    SAFE_FREE((*context)->primary_cache.entries);
+    SAFE_FREE((*context)->session_pool.entries);
+    SAFE_FREE((*context)->key_cache.entries);
+    SAFE_FREE((*context)->createPrimary.root);
+    SAFE_FREE((*context)->loadKey.root);
 
     /* Finalize all remaining object of the context. */
     ifapi_free_objects(*context);
@@ -339,7 +339,8 @@ Fapi_GetEsysBlob_Finish(
             goto_if_error(r, "Cleanup policy session", error_cleanup);
 
             /* Flush current object used for blob computation. */
-            if (!key_object->misc.key.persistent_handle) {
+            if (!key_object->misc.key.persistent_handle &&
+                !ifapi_object_cached(context, key_object->handle)) {
                 r = Esys_FlushContext_Async(context->esys, key_object->handle);
                 goto_if_error(r, "Flush Context", error_cleanup);
             }
@@ -347,7 +348,8 @@ Fapi_GetEsysBlob_Finish(
             fallthrough;
 
         statecase(context->state, GET_ESYS_BLOB_WAIT_FOR_FLUSH);
-            if (!key_object->misc.key.persistent_handle) {
+            if (!key_object->misc.key.persistent_handle &&
+                !ifapi_object_cached(context, key_object->handle)) {
                 r = Esys_FlushContext_Finish(context->esys);
                 return_try_again(r);
                 goto_if_error(r, "Flush Context", error_cleanup);
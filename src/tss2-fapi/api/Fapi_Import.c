@@ -444,7 +444,8 @@ Fapi_Import_Finish(
             return_try_again(r);
             return_if_error_reset_state(r, "write_finish failed");
 
-            if (!context->loadKey.auth_object.misc.key.persistent_handle) {
+            if (!context->loadKey.auth_object.misc.key.persistent_handle &&
+                !ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
                 /* Prepare Flushing of key used for authorization */
                 r = Esys_FlushContext_Async(context->esys, context->loadKey.auth_object.handle);
                 goto_if_error(r, "Flush parent", error_cleanup);
@@ -452,7 +453,8 @@ Fapi_Import_Finish(
             fallthrough;
 
         statecase(context->state, IMPORT_FLUSH_PARENT);
-            if (!context->loadKey.auth_object.misc.key.persistent_handle) {
+            if (!context->loadKey.auth_object.misc.key.persistent_handle &&
+                !ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
                 r = Esys_FlushContext_Finish(context->esys);
                 try_again_or_error_goto(r, "Flush context", error_cleanup);
             }
@@ -204,6 +204,8 @@ Fapi_Initialize_Finish(
                                       (*context)->config.user_dir,
                                       (*context)->config.profile_name);
         goto_if_error2(r, "Keystore could not be initialized.", cleanup_return);
+        (*context)->keystore.binary =
+            (*context)->config.keystore_format == IFAPI_KEYSTORE_FORMAT_BINARY;
 
         /* Initialize the policy store. */
         /* Policy directory will be placed in keystore dir */
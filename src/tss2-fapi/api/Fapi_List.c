@@ -23,6 +23,77 @@
 #include "util/log.h"
 #include "util/aux_util.h"
 
+/** Join paths to a colon-separated list.
+ *
+ * @param[in] pathArray The paths to be joined.
+ * @param[in] numPaths The number of paths.
+ * @param[out] pathList The colon-separated list (callee-allocated).
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         the list.
+ */
+static TSS2_RC
+join_paths(char **pathArray, size_t numPaths, char **pathList)
+{
+    size_t sizePathList = 0, offset = 0, len;
+
+    /* Determine size of char string to be returnded */
+    for (size_t i = 0; i < numPaths; i++)
+        sizePathList += strlen(pathArray[i]);
+
+    /* Allocate path list plus colon separators plus \0-terminator */
+    *pathList = malloc(sizePathList + (numPaths ? numPaths - 1 : 0) + 1);
+    return_if_null(*pathList, "Out of memory", TSS2_FAPI_RC_MEMORY);
+
+    /* Copy the path entries to the output string. */
+    for (size_t i = 0; i < numPaths; i++) {
+        if (i > 0) {
+            memcpy(&(*pathList)[offset], IFAPI_LIST_DELIM, strlen(IFAPI_LIST_DELIM));
+            offset += strlen(IFAPI_LIST_DELIM);
+        }
+        len = strlen(pathArray[i]);
+        memcpy(&(*pathList)[offset], pathArray[i], len);
+        offset += len;
+    }
+    (*pathList)[offset] = '\0';
+    return TSS2_RC_SUCCESS;
+}
+
+/** Determine the error for a search path without objects.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] searchPath The path that identifies the root of the search
+ *
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if the keystore is provisioned.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED if the profile of the path was not
+ *         provisioned.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations.
+ */
+static TSS2_RC
+check_provisioning(FAPI_CONTEXT *context, const char *searchPath)
+{
+    TSS2_RC r;
+    bool provision_check_ok;
+
+    if (searchPath && (strcmp(searchPath,"/") == 0
+                       || strcmp(searchPath,"") == 0)) {
+        LOG_WARNING("Path not found: %s", searchPath);
+        return TSS2_FAPI_RC_NOT_PROVISIONED;
+    }
+    r = ifapi_check_provisioned(&context->keystore, searchPath, &provision_check_ok);
+    return_if_error(r, "Provisioning check.");
+
+    if (provision_check_ok) {
+        LOG_WARNING("Path not found: %s", searchPath);
+        return TSS2_FAPI_RC_PATH_NOT_FOUND;
+    }
+    LOG_WARNING("Profile of path not provisioned: %s", searchPath);
+    return TSS2_FAPI_RC_NOT_PROVISIONED;
+}
+
 /** One-Call function for Fapi_List
  *
  * Enumerates all objects in the metadatastore in a fiven path and returns them
@@ -169,10 +240,8 @@ Fapi_List_Finish(
     char        **pathList)
 {
     LOG_TRACE("called for context:%p", context);
-    bool provision_check_ok;
 
     TSS2_RC r = TSS2_RC_SUCCESS;
-    size_t sizePathList = 0;
     size_t numPaths = 0;
     char **pathArray = NULL;
 
@@ -188,56 +257,248 @@ Fapi_List_Finish(
                                 &pathArray, &numPaths);
     goto_if_error(r, "get entities.", cleanup);
 
-    if (numPaths == 0)
-        goto check_provisioning;
+    if (numPaths == 0) {
+        r = check_provisioning(context, command->searchPath);
+        goto cleanup;
+    }
 
-    /* Determine size of char string to be returnded */
-    for (size_t i = 0; i < numPaths; i++)
-        sizePathList += strlen(pathArray[i]);
+    r = join_paths(pathArray, numPaths, pathList);
+    goto_if_error(r, "Join paths.", cleanup);
 
-    /* Allocate path list plus colon separators plus \0-terminator */
-    *pathList = malloc(sizePathList + (numPaths - 1) + 1);
-    goto_if_null2(*pathList, "Out of memory", r, TSS2_FAPI_RC_MEMORY,  cleanup);
+    LOG_TRACE("finished");
 
-    (*pathList)[0] = '\0';
-    (*pathList)[sizePathList + numPaths - 1] = '\0';
+cleanup:
+    /* Cleanup any intermediate results and state stored in the context. */
+    for (size_t i = 0; i < numPaths; i++){
+        SAFE_FREE(pathArray[i]);
+    }
+    SAFE_FREE(command->searchPath);
+    SAFE_FREE(pathArray);
+    return r;
+}
 
-    /* Concatenate the path entries to the output string. */
-    for (size_t i = 0; i < numPaths; i++) {
-        strcat(*pathList, pathArray[i]);
-        if (i < numPaths - 1)
-            strcat(*pathList, IFAPI_LIST_DELIM);
+/** One-Call function for Fapi_ListNext
+ *
+ * Enumerates the objects in the metadatastore in a given path page by page.
+ * Each call returns at most pageSize objects in a list of complete paths from
+ * the root with the values separated by colons. In contrast to Fapi_List the
+ * memory needed per call only grows with the page size and the directories
+ * along the current path. The directories read are kept in the context, a
+ * call with the cursor returned by the previous call on the same context
+ * continues without reading them again, thus its time only depends on the
+ * page size. Other cursors restart the enumeration from the directories
+ * along the cursor, which takes time proportional to their size. Objects
+ * created in a directory after it was read are not returned until the
+ * enumeration is restarted.
+ *
+ * The first call is done with a NULL cursor. If further objects may follow,
+ * a cursor is returned in nextCursor, which has to be passed together with the
+ * same searchPath to the next call. If all objects have been enumerated,
+ * nextCursor is set to NULL. The cursor is an opaque string which has to be
+ * freed with Fapi_Free.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] searchPath The path that identifies the root of the search
+ * @param[in] cursor The cursor returned by the previous call or NULL
+ * @param[in] pageSize The maximum number of objects to be returned
+ * @param[out] pathList A colon-separated list of the next objects in the root
+ *             path. The list is empty if the previous page was the last one.
+ * @param[out] nextCursor The cursor for the next call or NULL
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, searchPath, pathlist or
+ *         nextCursor is NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_PATH: if searchPath does not map to a FAPI entity.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be saved.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if pageSize is 0 or the cursor is invalid.
+ */
+TSS2_RC
+Fapi_ListNext(
+    FAPI_CONTEXT *context,
+    char   const *searchPath,
+    char   const *cursor,
+    size_t        pageSize,
+    char        **pathList,
+    char        **nextCursor)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(searchPath);
+    check_not_null(pathList);
+    check_not_null(nextCursor);
+
+    r = Fapi_ListNext_Async(context, searchPath, cursor, pageSize);
+    return_if_error_reset_state(r, "Entities_ListNext");
+
+    do {
+        /* We wait for file I/O to be ready if the FAPI state automata
+           are in a file I/O state. */
+        r = ifapi_io_poll(&context->io);
+        return_if_error(r, "Something went wrong with IO polling");
+
+        /* Repeatedly call the finish function, until FAPI has transitioned
+           through all execution stages / states of this invocation. */
+        r = Fapi_ListNext_Finish(context, pathList, nextCursor);
+    } while (base_rc(r) == TSS2_BASE_RC_TRY_AGAIN);
+
+    return_if_error_reset_state(r, "Entities_ListNext");
+
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+}
+
+/** Asynchronous function for Fapi_ListNext
+ *
+ * Enumerates the next objects in the metadatastore in a given path.
+ *
+ * Call Fapi_ListNext_Finish to finish the execution of this command.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[in] searchPath The path that identifies the root of the search
+ * @param[in] cursor The cursor returned by the previous call or NULL
+ * @param[in] pageSize The maximum number of objects to be returned
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context or searchPath is
+ *         NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_BAD_VALUE: if pageSize is 0.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ */
+TSS2_RC
+Fapi_ListNext_Async(
+    FAPI_CONTEXT *context,
+    char   const *searchPath,
+    char   const *cursor,
+    size_t        pageSize)
+{
+    LOG_TRACE("called for context:%p", context);
+    LOG_TRACE("searchPath: %s", searchPath);
+    LOG_TRACE("cursor: %s", cursor ? cursor : "(null)");
+
+    TSS2_RC r;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(searchPath);
+
+    if (pageSize == 0) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Page size 0.");
     }
 
- check_provisioning:
-    if (numPaths == 0 && (r == TSS2_RC_SUCCESS)) {
-        if (command->searchPath && (strcmp(command->searchPath,"/") == 0
-                                    || strcmp(command->searchPath,"") == 0)) {
-            LOG_WARNING("Path not found: %s", command->searchPath);
-            r = TSS2_FAPI_RC_NOT_PROVISIONED;
-        } else {
-            r = ifapi_check_provisioned(&context->keystore, command->searchPath, &provision_check_ok);
-            goto_if_error(r, "Provisioning check.", cleanup);
-
-            if (provision_check_ok) {
-                LOG_WARNING("Path not found: %s", command->searchPath);
-                r = TSS2_FAPI_RC_PATH_NOT_FOUND;
-            } else {
-                LOG_WARNING("Profile of path not provisioned: %s", command->searchPath);
-                r = TSS2_FAPI_RC_NOT_PROVISIONED;
-            }
-        }
+    /* Helpful alias pointers */
+    IFAPI_Entities_List * command = &context->cmd.Entities_List;
+
+    r = ifapi_non_tpm_mode_init(context);
+    return_if_error(r, "Initialize ListNext");
+
+    /* Copy parameters to context for use during _Finish. */
+    memset(command, 0, sizeof(IFAPI_Entities_List));
+    strdup_check(command->searchPath, searchPath, r, error_cleanup);
+    if (cursor) {
+        strdup_check(command->cursor, cursor, r, error_cleanup);
     }
+    command->pageSize = pageSize;
+
+    LOG_TRACE("finished");
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    /* Cleanup duplicated input parameters that were copied before. */
+    SAFE_FREE(command->searchPath);
+    SAFE_FREE(command->cursor);
+    return r;
+}
+
+/** Asynchronous finish function for Fapi_ListNext
+ *
+ * This function should be called after a previous Fapi_ListNext_Async.
+ *
+ * @param[in,out] context The FAPI_CONTEXT
+ * @param[out] pathList A colon-separated list of the next objects in the root
+ *             path
+ * @param[out] nextCursor The cursor for the next call or NULL
+ *
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE: if context, pathList or nextCursor is
+ *         NULL.
+ * @retval TSS2_FAPI_RC_BAD_CONTEXT: if context corruption is detected.
+ * @retval TSS2_FAPI_RC_BAD_SEQUENCE: if the context has an asynchronous
+ *         operation already pending.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if the data cannot be saved.
+ * @retval TSS2_FAPI_RC_MEMORY: if the FAPI cannot allocate enough memory for
+ *         internal operations or return parameters.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN: if the asynchronous operation is not yet
+ *         complete. Call this function again later.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ * @retval TSS2_FAPI_RC_NOT_PROVISIONED FAPI was not provisioned.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the cursor is invalid.
+ */
+TSS2_RC
+Fapi_ListNext_Finish(
+    FAPI_CONTEXT *context,
+    char        **pathList,
+    char        **nextCursor)
+{
+    LOG_TRACE("called for context:%p", context);
+
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    size_t numPaths = 0;
+    char **pathArray = NULL;
+
+    /* Check for NULL parameters */
+    check_not_null(context);
+    check_not_null(pathList);
+    check_not_null(nextCursor);
+
+    /* Helpful alias pointers */
+    IFAPI_Entities_List * command = &context->cmd.Entities_List;
+
+    /* Retrieve the next objects along the search path. */
+    r = ifapi_keystore_list_next(&context->keystore, &context->list_walk,
+                                 command->searchPath, command->cursor, command->pageSize,
+                                 &pathArray, &numPaths, nextCursor);
+    goto_if_error(r, "get entities.", cleanup);
+
+    /* Only an empty first page means that the search path is not valid. */
+    if (numPaths == 0 && !command->cursor) {
+        r = check_provisioning(context, command->searchPath);
+        goto cleanup;
+    }
+
+    r = join_paths(pathArray, numPaths, pathList);
+    goto_if_error(r, "Join paths.", cleanup);
+
     LOG_TRACE("finished");
 
 cleanup:
     /* Cleanup any intermediate results and state stored in the context. */
-    if (numPaths > 0) {
-        for (size_t i = 0; i < numPaths; i++){
-            SAFE_FREE(pathArray[i]);
-        }
+    if (r != TSS2_RC_SUCCESS) {
+        SAFE_FREE(*nextCursor);
+    }
+    for (size_t i = 0; i < numPaths; i++){
+        SAFE_FREE(pathArray[i]);
     }
     SAFE_FREE(command->searchPath);
+    SAFE_FREE(command->cursor);
     SAFE_FREE(pathArray);
     return r;
 }
@@ -243,6 +243,11 @@ Fapi_Provision_Async(
     }
     SAFE_FREE(profile_dir);
 
+    /* Primaries kept loaded from earlier commands might be replaced. */
+    ifapi_session_pool_flush(context);
+    ifapi_primary_cache_flush(context);
+    ifapi_key_cache_flush(context);
+
     /* Initialize context and duplicate parameters */
     strdup_check(command->authValueLockout, authValueLockout, r, end);
     strdup_check(command->authValueEh, authValueEh, r, end);
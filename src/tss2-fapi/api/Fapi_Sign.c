@@ -208,6 +208,7 @@ Fapi_Sign_Async(
                      command->digest.size, digest, digestSize);
     strdup_check(command->keyPath, keyPath, r, error_cleanup);
     strdup_check(command->padding, padding, r, error_cleanup);
+    command->cache_key = true;
 
     /* Initialize the context state for this operation. */
     context->state = KEY_SIGN_WAIT_FOR_KEY;
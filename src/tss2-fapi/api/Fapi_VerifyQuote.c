@@ -306,7 +306,8 @@ Fapi_VerifyQuote_Finish(
 
             /* Recalculate and verify the PCR digests. */
             r = ifapi_calculate_pcr_digest(command->event_list,
-                                           &command->fapi_quote_info, &pcr_digest);
+                                           &command->fapi_quote_info,
+                                           &context->pcr_replay_cache, &pcr_digest);
 
             goto_if_error(r, "Verify event list.", error_cleanup);
 
@@ -16,6 +16,7 @@
 #include "ifapi_keystore.h"
 #include "ifapi_policy_store.h"
 #include "ifapi_config.h"
+#include "ifapi_pcr_replay.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -36,6 +37,7 @@
 
 #define DEFAULT_LOG_DIR "/run/tpm2_tss"
 #define IFAPI_PCR_LOG_FILE "pcr.log"
+#define IFAPI_PCR_EVENTS_FILE "pcr.jsonl"
 #define IFAPI_OBJECT_TYPE ".json"
 #define IFAPI_OBJECT_FILE "object.json"
 #define IFAPI_SRK_KEY_PATH "/HS/SRK"
@@ -291,7 +293,6 @@ typedef struct {
     FAPI_QUOTE_INFO fapi_quote_info;
     uint8_t *pcrValue;
     size_t pcrValueSize;
-    char *event_log_file;
 } IFAPI_PCR;
 
 /** The data structure holding internal state of Fapi_SetDescription.
@@ -428,6 +429,7 @@ typedef struct {
     uint8_t *ret_signature;         /**< Result signature */
     size_t signatureSize;
     char *publicKey;                /**< Public key of the signing key. */
+    bool cache_key;                 /**< The signing key may be kept resident */
 } IFAPI_Key_Sign;
 
 /** The data structure holding internal state of Fapi_Unseal.
@@ -545,6 +547,95 @@ typedef struct {
     ESYS_TR ek_tpm_handle;
 } IFAPI_Provision;
 
+/** A regenerated primary key which is kept loaded in the TPM.
+ *
+ * The primary is identified by its hierarchy and the name computed from the
+ * public area stored in the keystore.
+ */
+typedef struct {
+    TPMI_RH_HIERARCHY hierarchy;     /**< The hierarchy of the primary */
+    char *root;                      /**< Keystore path of the primary starting with the profile */
+    TPM2B_NAME name;                 /**< Name of the keystore object; size 0 for an unused entry */
+    ESYS_TR handle;                  /**< The ESYS handle of the loaded primary */
+    UINT64 last_use;                 /**< Clock value of the last use of the primary */
+    UINT64 command;                  /**< Number of the command which used the primary last */
+} IFAPI_PRIMARY_CACHE_ENTRY;
+
+/** Cache of primary keys kept loaded across FAPI commands.
+ *
+ * Non persistent primaries are not flushed after a command, so subsequent
+ * commands do not have to regenerate them with TPM2_CreatePrimary. The number
+ * of TPM transient slots used is limited by the primary_cache_size option of
+ * the FAPI configuration. A primary is only reused for the same keystore path,
+ * thus primaries of different profiles are kept apart.
+ */
+typedef struct {
+    IFAPI_PRIMARY_CACHE_ENTRY *entries; /**< The entries; NULL if not yet used */
+    size_t size;                     /**< Number of entries */
+    UINT64 clock;                    /**< Counter for the least recently used replacement */
+    UINT64 command;                  /**< Counter of the executed commands */
+} IFAPI_PRIMARY_CACHE;
+
+/** A key kept resident in the TPM across FAPI commands.
+ *
+ * The key is identified by the name computed from the public area stored in
+ * the keystore. It is either loaded into a transient slot or, after it was
+ * evicted, available as saved context which can be restored with
+ * TPM2_ContextLoad.
+ */
+typedef struct {
+    char *root;                      /**< Keystore path of the primary the key was loaded under */
+    TPM2B_NAME name;                 /**< Name of the keystore object; size 0 for an unused entry */
+    ESYS_TR handle;                  /**< The ESYS handle of the loaded key; ESYS_TR_NONE if evicted */
+    TPMS_CONTEXT *context;           /**< The saved context; NULL if the key was never evicted */
+    UINT64 last_use;                 /**< Clock value of the last use of the key */
+    UINT64 command;                  /**< Number of the command which uses the key; 0 if released */
+} IFAPI_KEY_CACHE_ENTRY;
+
+/** Cache of keys kept resident across FAPI commands.
+ *
+ * Loaded keys are not flushed after a command, so subsequent commands do
+ * not have to load the key and all its parents again. If more than
+ * key_cache_slots keys are loaded, the least recently used key is saved with
+ * TPM2_ContextSave and flushed. The number of keys is limited by the
+ * key_cache_size option of the FAPI configuration. A key is only reused if
+ * it is loaded below the same profile and primary.
+ */
+typedef struct {
+    IFAPI_KEY_CACHE_ENTRY *entries;  /**< The entries; NULL if not yet used */
+    size_t size;                     /**< Number of entries */
+    size_t loaded;                   /**< Number of keys loaded into transient slots */
+    UINT64 clock;                    /**< Counter for the least recently used replacement */
+    UINT64 command;                  /**< Counter of the executed commands */
+} IFAPI_KEY_CACHE;
+
+/** A salted HMAC session kept open for subsequent FAPI commands. */
+typedef struct {
+    ESYS_TR handle;                  /**< The ESYS handle of the session */
+    TPMI_ALG_HASH hash_alg;          /**< The hash algorithm of the session */
+    TPMT_SYM_DEF symmetric;          /**< The parameter encryption of the session */
+    TPM2B_NAME srk_name;             /**< Name of the SRK which salted the session */
+    ESYS_TR srk;                     /**< The ESYS handle of the SRK which salted the session */
+    UINT32 uses;                     /**< Number of commands which used the session; 0 for an unused entry */
+} IFAPI_SESSION_POOL_ENTRY;
+
+/** Pool of HMAC sessions reused across FAPI commands.
+ *
+ * Instead of starting a new session salted with the SRK for each command,
+ * the first session of a command is taken from the pool and put back after
+ * the command. A session is only reused with the same SRK and the same
+ * session parameters of the profile. Sessions are replaced by new ones after
+ * session_max_uses commands. The sizes are set by the FAPI configuration.
+ */
+typedef struct {
+    IFAPI_SESSION_POOL_ENTRY *entries; /**< The entries; NULL if not yet used */
+    size_t size;                     /**< Number of entries */
+    bool clock_valid;                /**< The TPM counters below were read */
+    UINT32 reset_count;              /**< TPM reset counter when the sessions were started */
+    UINT32 restart_count;            /**< TPM restart counter when the sessions were started */
+    IFAPI_SESSION_POOL_ENTRY session1; /**< Parameters and earlier uses of the current session1 */
+} IFAPI_SESSION_POOL;
+
 /** The data structure holding internal state of regenerate primary key.
  */
 typedef struct {
@@ -557,6 +648,8 @@ typedef struct {
     ESYS_TR handle;
     TPMI_DH_PERSISTENT persistent_handle;
     TPMS_CAPABILITY_DATA *capabilityData;
+    IFAPI_PRIMARY_CACHE_ENTRY *cache_entry; /**< The cached primary to be verified */
+    char *root;                   /**< Keystore path of the primary for the primary cache */
 } IFAPI_CreatePrimary;
 
 /** The data structure holding internal state of key verify signature.
@@ -630,6 +723,11 @@ typedef struct {
     size_t path_idx;                /**< Index of array of objects to be searched */
     size_t numPaths;                /**< Number of all objects in data store */
     char *current_path;
+    bool from_index;                /**< The path list contains the candidates from the index */
+    bool index_stale;               /**< An indexed policy did not match the index */
+    bool append_index;              /**< Only the policies without a trusted record are read */
+    IFAPI_INDEX_STATE index_state;  /**< The state of the index before the search */
+    char *index_records;            /**< The index records collected during a full search */
 } IFAPI_FILE_SEARCH_CTX;
 
 /** The states for the FAPI's key loading */
@@ -639,7 +737,11 @@ enum _FAPI_STATE_LOAD_KEY {
     LOAD_KEY_WAIT_FOR_PRIMARY,
     LOAD_KEY_LOAD_KEY,
     LOAD_KEY_AUTH,
-    LOAD_KEY_AUTHORIZE
+    LOAD_KEY_AUTHORIZE,
+    LOAD_KEY_RESIDENT,
+    LOAD_KEY_USE_RESIDENT,
+    LOAD_KEY_READ_PUBLIC,
+    LOAD_KEY_CONTEXT_LOAD
 };
 
 /** The data structure holding internal state of export key.
@@ -693,6 +795,9 @@ typedef struct {
     bool parent_handle_persistent;
     IFAPI_OBJECT *key_object;
     char *key_path;
+    bool cache_key;               /**< The loaded key may be kept resident */
+    IFAPI_KEY_CACHE_ENTRY *cache_entry; /**< The entry of a resident key */
+    char *root;                   /**< Keystore path of the primary of the loaded keys */
 } IFAPI_LoadKey;
 
 /** The data structure holding internal state of entity delete.
@@ -732,6 +837,8 @@ typedef struct {
  */
 typedef struct {
     const char *searchPath;               /**< The path to searched for objectws */
+    char *cursor;                         /**< The position to continue listing */
+    size_t pageSize;                      /**< The maximum number of paths */
 } IFAPI_Entities_List;
 
 /** Union for all input parameters.
@@ -772,7 +879,9 @@ enum _FAPI_STATE_PRIMARY {
     PRIMARY_HAUTH_SENT,
     PRIMARY_CREATED,
     PRIMARY_VERIFY_PERSISTENT,
-    PRIMARY_GET_CAP
+    PRIMARY_GET_CAP,
+    PRIMARY_VERIFY_CACHED,
+    PRIMARY_READ_PUBLIC
 };
 
 /** The states for the FAPI's primary key regeneration */
@@ -781,7 +890,11 @@ enum _FAPI_STATE_SESSION {
     SESSION_WAIT_FOR_PRIMARY,
     SESSION_CREATE_SESSION,
     SESSION_WAIT_FOR_SESSION1,
-    SESSION_WAIT_FOR_SESSION2
+    SESSION_WAIT_FOR_SESSION2,
+    SESSION_WAIT_FOR_CLOCK,
+    SESSION_TAKE_SESSION1,
+    SESSION_START_SESSION1,
+    SESSION_CREATE_SESSION2
 };
 
 /** The states for the FAPI's get random  state */
@@ -1146,11 +1259,16 @@ struct FAPI_CONTEXT {
     IFAPI_MAX_BUFFER aux_data; /**< tpm2b data to be transferred */
     IFAPI_POLICY_CTX policy;  /**< The context of current policy. */
     IFAPI_FILE_SEARCH_CTX fsearch;  /**< The context for object search in key/policy store */
+    IFAPI_DIR_WALK list_walk; /**< The directory walk of Fapi_ListNext */
     IFAPI_Key_Sign Key_Sign; /**< State information for key signing */
     enum IFAPI_IO_STATE io_state;
     NODE_OBJECT_T *object_list;
     IFAPI_OBJECT *duplicate_key; /**< Will be needed for policy execution */
     IFAPI_OBJECT *current_auth_object;
+    IFAPI_PCR_REPLAY_CACHE *pcr_replay_cache; /**< Checkpoints of verified event lists */
+    IFAPI_PRIMARY_CACHE primary_cache; /**< Primaries kept loaded across commands */
+    IFAPI_SESSION_POOL session_pool; /**< Sessions kept open across commands */
+    IFAPI_KEY_CACHE key_cache; /**< Keys kept resident across commands */
 };
 
 #define VENDOR_IFX  0x49465800
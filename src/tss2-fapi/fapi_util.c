@@ -49,7 +49,7 @@ ifapi_flush_object(FAPI_CONTEXT *context, ESYS_TR handle)
 {
     TSS2_RC r = TSS2_RC_SUCCESS;
 
-    if (handle == ESYS_TR_NONE)
+    if (handle == ESYS_TR_NONE || ifapi_object_cached(context, handle))
         return r;
 
     switch (context->flush_object_state) {
@@ -768,6 +768,464 @@ error_cleanup:
     return r;
 }
 
+/** Compute the keystore path of the primary at the root of a key path.
+ *
+ * The path consists of the profile, the hierarchy and the primary, e.g.
+ * "P_RSA2048SHA256/HS/SRK". Objects kept loaded across commands are only
+ * reused for the same path.
+ *
+ * @param[in] path_list The explicit key path.
+ * @param[out] root The path of the primary (callee-allocated) or NULL.
+ */
+static void
+cache_root(NODE_STR_T *path_list, char **root)
+{
+    SAFE_FREE(*root);
+    if (!path_list || !path_list->next || !path_list->next->next)
+        return;
+    if (ifapi_asprintf(root, "%s%s%s%s%s", path_list->str, IFAPI_FILE_DELIM,
+                       path_list->next->str, IFAPI_FILE_DELIM,
+                       path_list->next->next->str) != TSS2_RC_SUCCESS)
+        *root = NULL;
+}
+
+/** Get the cache entry of a primary key.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] pkey The primary key read from keystore.
+ * @param[out] name The name of the keystore object.
+ * @retval The cache entry or NULL if the primary is not cached.
+ */
+static IFAPI_PRIMARY_CACHE_ENTRY *
+primary_cache_lookup(FAPI_CONTEXT *context, IFAPI_KEY *pkey, TPM2B_NAME *name)
+{
+    IFAPI_PRIMARY_CACHE *cache = &context->primary_cache;
+    const char *root = context->createPrimary.root;
+
+    if (!root || ifapi_get_name(&pkey->public.publicArea, name) != TSS2_RC_SUCCESS) {
+        name->size = 0;
+        return NULL;
+    }
+    for (size_t i = 0; i < cache->size; i++) {
+        IFAPI_PRIMARY_CACHE_ENTRY *entry = &cache->entries[i];
+        if (entry->name.size == name->size &&
+            entry->hierarchy == pkey->creationTicket.hierarchy &&
+            memcmp(&entry->name.name[0], &name->name[0], name->size) == 0 &&
+            strcmp(entry->root, root) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/** Mark a cache entry as used by the current command.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] entry The entry of the used primary.
+ */
+static void
+primary_cache_use(FAPI_CONTEXT *context, IFAPI_PRIMARY_CACHE_ENTRY *entry)
+{
+    entry->last_use = ++context->primary_cache.clock;
+    entry->command = context->primary_cache.command;
+}
+
+/** Store a regenerated primary key in the cache.
+ *
+ * If no free entry exists the least recently used primary, which is not used
+ * by the current command, will be flushed. If all entries are in use the
+ * primary will not be cached and has to be flushed by the caller.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] pkey The primary key read from keystore.
+ * @param[in] handle The ESYS handle of the loaded primary.
+ */
+static void
+primary_cache_store(FAPI_CONTEXT *context, IFAPI_KEY *pkey, ESYS_TR handle)
+{
+    IFAPI_PRIMARY_CACHE *cache = &context->primary_cache;
+    IFAPI_PRIMARY_CACHE_ENTRY *entry = NULL;
+    TPM2B_NAME name;
+    char *root;
+    size_t i;
+
+    if (context->config.primary_cache_size == 0)
+        return;
+
+    if (!cache->entries) {
+        cache->entries = calloc(context->config.primary_cache_size,
+                                sizeof(IFAPI_PRIMARY_CACHE_ENTRY));
+        if (!cache->entries) {
+            LOG_WARNING("Out of memory, primary will not be cached.");
+            return;
+        }
+        cache->size = context->config.primary_cache_size;
+    }
+
+    if (primary_cache_lookup(context, pkey, &name) || name.size == 0)
+        return;
+
+    root = strdup(context->createPrimary.root);
+    if (!root) {
+        LOG_WARNING("Out of memory, primary will not be cached.");
+        return;
+    }
+
+    for (i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size == 0) {
+            entry = &cache->entries[i];
+            break;
+        }
+        /* Primaries used by the current command may not be flushed. */
+        if (cache->entries[i].command != cache->command &&
+            (!entry || cache->entries[i].last_use < entry->last_use))
+            entry = &cache->entries[i];
+    }
+    if (!entry) {
+        SAFE_FREE(root);
+        return;
+    }
+
+    if (entry->name.size) {
+        LOG_DEBUG("Flush least recently used primary 0x%x", entry->handle);
+        if (Esys_FlushContext(context->esys, entry->handle) != TSS2_RC_SUCCESS)
+            LOG_WARNING("Flush of cached primary failed.");
+        SAFE_FREE(entry->root);
+    }
+    entry->hierarchy = pkey->creationTicket.hierarchy;
+    entry->root = root;
+    entry->name = name;
+    entry->handle = handle;
+    primary_cache_use(context, entry);
+}
+
+/** Check whether an object is a primary key kept loaded across commands.
+ *
+ * Cached primaries must not be flushed at the end of a command.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] handle The ESYS handle of the object.
+ * @retval true if the object is a cached primary.
+ * @retval false if the object has to be flushed after usage.
+ */
+bool
+ifapi_primary_cached(FAPI_CONTEXT *context, ESYS_TR handle)
+{
+    IFAPI_PRIMARY_CACHE *cache = &context->primary_cache;
+
+    if (handle == ESYS_TR_NONE)
+        return false;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size && cache->entries[i].handle == handle)
+            return true;
+    }
+    return false;
+}
+
+/** Check whether a cached primary was verified or created by the current command.
+ *
+ * Such a primary was loaded in the TPM during the whole time since it was
+ * created, thus the TPM was neither reset nor restarted meanwhile.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] handle The ESYS handle of the object.
+ * @retval true if the object is a cached primary checked by this command.
+ * @retval false otherwise.
+ */
+static bool
+primary_cache_current(FAPI_CONTEXT *context, ESYS_TR handle)
+{
+    IFAPI_PRIMARY_CACHE *cache = &context->primary_cache;
+
+    if (handle == ESYS_TR_NONE)
+        return false;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size && cache->entries[i].handle == handle)
+            return cache->entries[i].command == cache->command;
+    }
+    return false;
+}
+
+/** Flush all cached primary keys (non asynchronous).
+ *
+ * Used if the primaries of the TPM change, e.g. during provisioning, and
+ * when the FAPI context is finalized.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ */
+void
+ifapi_primary_cache_flush(FAPI_CONTEXT *context)
+{
+    IFAPI_PRIMARY_CACHE *cache = &context->primary_cache;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size &&
+            Esys_FlushContext(context->esys, cache->entries[i].handle) != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Flush of cached primary failed.");
+        }
+        SAFE_FREE(cache->entries[i].root);
+    }
+    SAFE_FREE(cache->entries);
+    cache->size = 0;
+}
+
+/** Get the entry of a key kept resident in the TPM.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] key The key read from keystore.
+ * @param[out] name The name of the keystore object.
+ * @retval The cache entry or NULL if the key is not resident.
+ */
+static IFAPI_KEY_CACHE_ENTRY *
+key_cache_lookup(FAPI_CONTEXT *context, IFAPI_KEY *key, TPM2B_NAME *name)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+    const char *root = context->loadKey.root;
+
+    if (!root || ifapi_get_name(&key->public.publicArea, name) != TSS2_RC_SUCCESS) {
+        name->size = 0;
+        return NULL;
+    }
+    for (size_t i = 0; i < cache->size; i++) {
+        IFAPI_KEY_CACHE_ENTRY *entry = &cache->entries[i];
+        if (entry->name.size == name->size &&
+            memcmp(&entry->name.name[0], &name->name[0], name->size) == 0 &&
+            strcmp(entry->root, root) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/** Mark a resident key as used by the current command.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] entry The entry of the used key.
+ */
+static void
+key_cache_use(FAPI_CONTEXT *context, IFAPI_KEY_CACHE_ENTRY *entry)
+{
+    entry->last_use = ++context->key_cache.clock;
+    entry->command = context->key_cache.command;
+}
+
+/** Remove a key from the cache.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] entry The entry of the key.
+ * @param[in] flush If true a loaded key will be flushed, otherwise the
+ *            caller takes over the ESYS handle.
+ */
+static void
+key_cache_remove(FAPI_CONTEXT *context, IFAPI_KEY_CACHE_ENTRY *entry, bool flush)
+{
+    if (entry->handle != ESYS_TR_NONE) {
+        if (flush && Esys_FlushContext(context->esys, entry->handle) != TSS2_RC_SUCCESS)
+            LOG_WARNING("Flush of resident key failed.");
+        context->key_cache.loaded -= 1;
+    }
+    SAFE_FREE(entry->context);
+    SAFE_FREE(entry->root);
+    memset(entry, 0, sizeof(IFAPI_KEY_CACHE_ENTRY));
+    entry->handle = ESYS_TR_NONE;
+}
+
+/** Evict a resident key from its transient slot.
+ *
+ * The context of the key is saved, so it can be restored with ContextLoad.
+ * A context saved during an earlier eviction can be loaded again, so only the
+ * first eviction of a key needs a ContextSave.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] entry The entry of the key to be evicted.
+ */
+static void
+key_cache_evict(FAPI_CONTEXT *context, IFAPI_KEY_CACHE_ENTRY *entry)
+{
+    TSS2_RC r;
+
+    LOG_DEBUG("Evict least recently used key 0x%x", entry->handle);
+    if (!entry->context) {
+        r = Esys_ContextSave(context->esys, entry->handle, &entry->context);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("ContextSave of resident key failed.");
+            key_cache_remove(context, entry, true);
+            return;
+        }
+    }
+    r = Esys_FlushContext(context->esys, entry->handle);
+    if (r != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Flush of resident key failed.");
+        key_cache_remove(context, entry, false);
+        return;
+    }
+    entry->handle = ESYS_TR_NONE;
+    context->key_cache.loaded -= 1;
+}
+
+/** Free a transient slot for the loading of a key.
+ *
+ * Resident keys which are not used by the current command will be evicted
+ * until less than key_cache_slots keys are loaded.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ */
+static void
+key_cache_make_room(FAPI_CONTEXT *context)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+    IFAPI_KEY_CACHE_ENTRY *entry;
+
+    while (cache->loaded && cache->loaded >= context->config.key_cache_slots) {
+        entry = NULL;
+        for (size_t i = 0; i < cache->size; i++) {
+            if (cache->entries[i].name.size &&
+                cache->entries[i].handle != ESYS_TR_NONE &&
+                cache->entries[i].command != cache->command &&
+                (!entry || cache->entries[i].last_use < entry->last_use))
+                entry = &cache->entries[i];
+        }
+        if (!entry)
+            return;
+        key_cache_evict(context, entry);
+    }
+}
+
+/** Keep a loaded key resident in the TPM.
+ *
+ * If no free entry exists the least recently used key, which is not used
+ * by the current command, will be removed. If no transient slot for resident
+ * keys is available the key will not be cached and has to be flushed by the
+ * caller.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] key The key read from keystore.
+ * @param[in] handle The ESYS handle of the loaded key.
+ */
+static void
+key_cache_store(FAPI_CONTEXT *context, IFAPI_KEY *key, ESYS_TR handle)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+    IFAPI_KEY_CACHE_ENTRY *entry = NULL;
+    TPM2B_NAME name;
+    char *root;
+    size_t i;
+
+    if (context->config.key_cache_size == 0 || context->config.key_cache_slots == 0)
+        return;
+
+    if (!cache->entries) {
+        cache->entries = calloc(context->config.key_cache_size,
+                                sizeof(IFAPI_KEY_CACHE_ENTRY));
+        if (!cache->entries) {
+            LOG_WARNING("Out of memory, key will not be cached.");
+            return;
+        }
+        cache->size = context->config.key_cache_size;
+        for (i = 0; i < cache->size; i++)
+            cache->entries[i].handle = ESYS_TR_NONE;
+    }
+
+    if (key_cache_lookup(context, key, &name) || name.size == 0)
+        return;
+
+    key_cache_make_room(context);
+    if (cache->loaded >= context->config.key_cache_slots)
+        return;
+
+    for (i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size == 0) {
+            entry = &cache->entries[i];
+            break;
+        }
+        /* Keys used by the current command may not be removed. */
+        if (cache->entries[i].command != cache->command &&
+            (!entry || cache->entries[i].last_use < entry->last_use))
+            entry = &cache->entries[i];
+    }
+    if (!entry)
+        return;
+
+    root = strdup(context->loadKey.root);
+    if (!root) {
+        LOG_WARNING("Out of memory, key will not be cached.");
+        return;
+    }
+    key_cache_remove(context, entry, true);
+    entry->root = root;
+    entry->name = name;
+    entry->handle = handle;
+    cache->loaded += 1;
+    key_cache_use(context, entry);
+}
+
+/** Release a resident parent key which is not needed by the current command.
+ *
+ * The key can be evicted if a slot is needed for the loading of further keys.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] handle The ESYS handle of the key.
+ */
+static void
+key_cache_release(FAPI_CONTEXT *context, ESYS_TR handle)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size && cache->entries[i].handle == handle)
+            cache->entries[i].command = 0;
+    }
+}
+
+/** Check whether an object is kept loaded across commands.
+ *
+ * Cached primaries and resident keys must not be flushed at the end of a
+ * command.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @param[in] handle The ESYS handle of the object.
+ * @retval true if the object is a cached primary or a resident key.
+ * @retval false if the object has to be flushed after usage.
+ */
+bool
+ifapi_object_cached(FAPI_CONTEXT *context, ESYS_TR handle)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+
+    if (handle == ESYS_TR_NONE)
+        return false;
+
+    if (ifapi_primary_cached(context, handle))
+        return true;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size && cache->entries[i].handle == handle)
+            return true;
+    }
+    return false;
+}
+
+/** Flush all resident keys (non asynchronous).
+ *
+ * Used if keys of the keystore are deleted or replaced, e.g. during
+ * provisioning, and when the FAPI context is finalized.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ */
+void
+ifapi_key_cache_flush(FAPI_CONTEXT *context)
+{
+    IFAPI_KEY_CACHE *cache = &context->key_cache;
+
+    for (size_t i = 0; i < cache->size; i++) {
+        if (cache->entries[i].name.size)
+            key_cache_remove(context, &cache->entries[i], true);
+    }
+    SAFE_FREE(cache->entries);
+    cache->size = 0;
+    cache->loaded = 0;
+}
+
 /** Prepare the loading of a primary key from key store.
  *
  * The asynchronous loading or the key from keystore will be prepared and
@@ -795,6 +1253,8 @@ ifapi_load_primary_async(FAPI_CONTEXT *context, char *path)
 
     memset(&context->createPrimary.pkey_object, 0, sizeof(IFAPI_OBJECT));
     context->createPrimary.path = path;
+    SAFE_FREE(context->createPrimary.root);
+    context->createPrimary.root = strdup(path[0] == IFAPI_FILE_DELIM_CHAR ? &path[1] : path);
     r = ifapi_keystore_load_async(&context->keystore, &context->io, path);
     return_if_error2(r, "Could not open: %s", path);
     context->primary_state = PRIMARY_READ_KEY;
@@ -849,6 +1309,10 @@ ifapi_load_primary_finish(FAPI_CONTEXT *context, ESYS_TR *handle)
     TPMS_CAPABILITY_DATA **capabilityData = &context->createPrimary.capabilityData;
     TPMI_YES_NO moreData;
     ESYS_TR auth_session;
+    IFAPI_PRIMARY_CACHE_ENTRY *entry;
+    TPM2B_NAME name;
+    TPM2B_NAME *readName = NULL;
+    TPM2B_NAME *esysName = NULL;
 
     LOG_TRACE("call");
 
@@ -885,6 +1349,22 @@ ifapi_load_primary_finish(FAPI_CONTEXT *context, ESYS_TR *handle)
         fallthrough;
 
     statecase(context->primary_state, PRIMARY_READ_HIERARCHY);
+        /* A primary kept loaded by a previous command can be used if it is
+           still present in the TPM. */
+        entry = primary_cache_lookup(context, pkey, &name);
+        if (entry && entry->command == context->primary_cache.command) {
+            /* Already verified by the current command. */
+            primary_cache_use(context, entry);
+            pkey_object->handle = entry->handle;
+            *handle = pkey_object->handle;
+            context->primary_state = PRIMARY_INIT;
+            break;
+        } else if (entry) {
+            context->createPrimary.cache_entry = entry;
+            context->primary_state = PRIMARY_VERIFY_CACHED;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+
         /* The hierarchy object ussed for auth_session will be loaded from key store. */
         if (pkey->creationTicket.hierarchy == TPM2_RH_EK) {
             r = ifapi_keystore_load_async(&context->keystore, &context->io, "/HE");
@@ -947,10 +1427,56 @@ ifapi_load_primary_finish(FAPI_CONTEXT *context, ESYS_TR *handle)
             return_try_again(r);
             goto_if_error_reset_state(r, "FAPI regenerate primary", error_cleanup);
         }
+        primary_cache_store(context, pkey, pkey_object->handle);
         *handle = pkey_object->handle;
         context->primary_state = PRIMARY_INIT;
         break;
 
+    statecase(context->primary_state, PRIMARY_VERIFY_CACHED);
+        /* A TPM reset or a change of the hierarchy removes the primary.
+           The object at its TPM handle has to be checked. */
+        r = Esys_ReadPublic_Async(context->esys,
+                                  context->createPrimary.cache_entry->handle,
+                                  ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE);
+        goto_if_error(r, "ReadPublic async", error_cleanup);
+        fallthrough;
+
+    statecase(context->primary_state, PRIMARY_READ_PUBLIC);
+        r = Esys_ReadPublic_Finish(context->esys, NULL, &readName, NULL);
+        return_try_again(r);
+        if (r != TSS2_RC_SUCCESS &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_TPM_RC_LAYER &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_TPM_RC_LAYER &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_RC_LAYER) {
+            goto_if_error(r, "ReadPublic", error_cleanup);
+        }
+
+        entry = context->createPrimary.cache_entry;
+        if (r == TSS2_RC_SUCCESS &&
+            Esys_TR_GetName(context->esys, entry->handle, &esysName) == TSS2_RC_SUCCESS &&
+            esysName->size == readName->size &&
+            memcmp(&esysName->name[0], &readName->name[0], readName->size) == 0) {
+            LOG_DEBUG("Use cached primary 0x%x", entry->handle);
+            primary_cache_use(context, entry);
+            pkey_object->handle = entry->handle;
+            *handle = pkey_object->handle;
+            context->primary_state = PRIMARY_INIT;
+            SAFE_FREE(readName);
+            SAFE_FREE(esysName);
+            break;
+        }
+        SAFE_FREE(readName);
+        SAFE_FREE(esysName);
+
+        /* The handle of the TPM object is unknown or belongs to another
+           object; only the ESYS resource has to be released. */
+        LOG_DEBUG("Cached primary 0x%x was removed from TPM", entry->handle);
+        Esys_TR_Close(context->esys, &entry->handle);
+        SAFE_FREE(entry->root);
+        memset(entry, 0, sizeof(IFAPI_PRIMARY_CACHE_ENTRY));
+        context->primary_state = PRIMARY_READ_HIERARCHY;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
     statecase(context->primary_state, PRIMARY_VERIFY_PERSISTENT);
         /* Check the TPM capabilities for the persistent handle. */
         r = Esys_GetCapability_Async(context->esys,
@@ -1029,6 +1555,8 @@ ifapi_session_init(FAPI_CONTEXT *context)
     context->session2 = ESYS_TR_NONE;
     context->policy.session = ESYS_TR_NONE;
     context->srk_handle = ESYS_TR_NONE;
+    context->primary_cache.command += 1;
+    context->key_cache.command += 1;
     return TSS2_RC_SUCCESS;
 }
 
@@ -1058,9 +1586,193 @@ ifapi_non_tpm_mode_init(FAPI_CONTEXT *context)
     context->session2 = ESYS_TR_NONE;
     context->policy.session = ESYS_TR_NONE;
     context->srk_handle = ESYS_TR_NONE;
+    context->primary_cache.command += 1;
+    context->key_cache.command += 1;
     return TSS2_RC_SUCCESS;
 }
 
+/** Release the sessions of the session pool without flushing them.
+ *
+ * Used if the TPM does not know the sessions anymore, e.g. after a TPM reset.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ */
+static void
+session_pool_close(FAPI_CONTEXT *context)
+{
+    IFAPI_SESSION_POOL *pool = &context->session_pool;
+
+    for (size_t i = 0; i < pool->size; i++) {
+        if (pool->entries[i].uses) {
+            Esys_TR_Close(context->esys, &pool->entries[i].handle);
+            pool->entries[i].uses = 0;
+        }
+    }
+}
+
+/** Check whether the TPM was reset or restarted since the pooled sessions
+ *  were started.
+ *
+ * In this case the sessions are not loaded anymore and will be released.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @param[in] clockInfo The current clock info of the TPM.
+ */
+static void
+session_pool_check_clock(FAPI_CONTEXT *context, const TPMS_CLOCK_INFO *clockInfo)
+{
+    IFAPI_SESSION_POOL *pool = &context->session_pool;
+
+    if (!pool->clock_valid ||
+        pool->reset_count != clockInfo->resetCount ||
+        pool->restart_count != clockInfo->restartCount) {
+        LOG_DEBUG("TPM was reset, release pooled sessions.");
+        session_pool_close(context);
+        pool->clock_valid = true;
+        pool->reset_count = clockInfo->resetCount;
+        pool->restart_count = clockInfo->restartCount;
+    }
+}
+
+/** Record the parameters of the first session of a command.
+ *
+ * A pooled session is only used if it was salted with the same SRK and has
+ * the same hash algorithm and symmetric parameters.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @param[in] profile The profile with the session parameters.
+ * @param[in] hash_alg The hash algorithm of the session.
+ */
+static void
+session_pool_select(FAPI_CONTEXT *context, const IFAPI_PROFILE *profile,
+                    TPMI_ALG_HASH hash_alg)
+{
+    IFAPI_SESSION_POOL_ENTRY *session1 = &context->session_pool.session1;
+    TPM2B_NAME *srk_name = NULL;
+
+    memset(session1, 0, sizeof(IFAPI_SESSION_POOL_ENTRY));
+    session1->hash_alg = hash_alg;
+    session1->symmetric = profile->session_symmetric;
+    session1->srk = context->srk_handle;
+    if (context->srk_handle != ESYS_TR_NONE &&
+        Esys_TR_GetName(context->esys, context->srk_handle, &srk_name) == TSS2_RC_SUCCESS) {
+        session1->srk_name = *srk_name;
+    }
+    SAFE_FREE(srk_name);
+}
+
+/** Search a pooled session with the parameters of the first session.
+ *
+ * @param[in] context The FAPI_CONTEXT.
+ * @retval The pool entry or NULL if a new session has to be started.
+ */
+static IFAPI_SESSION_POOL_ENTRY *
+session_pool_find(FAPI_CONTEXT *context)
+{
+    IFAPI_SESSION_POOL *pool = &context->session_pool;
+    const IFAPI_SESSION_POOL_ENTRY *session1 = &pool->session1;
+
+    if (session1->srk_name.size == 0)
+        return NULL;
+
+    for (size_t i = 0; i < pool->size; i++) {
+        IFAPI_SESSION_POOL_ENTRY *entry = &pool->entries[i];
+        if (entry->uses && entry->hash_alg == session1->hash_alg &&
+            entry->symmetric.algorithm == session1->symmetric.algorithm &&
+            entry->symmetric.keyBits.sym == session1->symmetric.keyBits.sym &&
+            entry->symmetric.mode.sym == session1->symmetric.mode.sym &&
+            entry->srk_name.size == session1->srk_name.size &&
+            memcmp(&entry->srk_name.name[0], &session1->srk_name.name[0],
+                   entry->srk_name.size) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/** Take a session with the parameters of the first session from the pool.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @param[out] session The pooled session.
+ * @retval true if a session was found.
+ * @retval false if a new session has to be started.
+ */
+static bool
+session_pool_take(FAPI_CONTEXT *context, ESYS_TR *session)
+{
+    IFAPI_SESSION_POOL_ENTRY *entry = session_pool_find(context);
+
+    if (!entry)
+        return false;
+    *session = entry->handle;
+    context->session_pool.session1.uses = entry->uses;
+    entry->uses = 0;
+    return true;
+}
+
+/** Put the first session of a finished command into the session pool.
+ *
+ * Only sessions salted with the SRK are kept. Sessions which reached the
+ * configured number of uses are not kept, so they will be replaced by a new
+ * session with a fresh salt.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @param[in] session The session to be kept.
+ * @retval true if the session was put into the pool.
+ * @retval false if the session has to be flushed.
+ */
+static bool
+session_pool_put(FAPI_CONTEXT *context, ESYS_TR session)
+{
+    IFAPI_SESSION_POOL *pool = &context->session_pool;
+    UINT32 uses = pool->session1.uses + 1;
+
+    if (context->config.session_pool_size == 0 ||
+        !(context->session_flags & IFAPI_SESSION_GENEK) ||
+        pool->session1.srk_name.size == 0 ||
+        uses >= context->config.session_max_uses)
+        return false;
+
+    if (!pool->entries) {
+        pool->entries = calloc(context->config.session_pool_size,
+                               sizeof(IFAPI_SESSION_POOL_ENTRY));
+        if (!pool->entries)
+            return false;
+        pool->size = context->config.session_pool_size;
+    }
+
+    for (size_t i = 0; i < pool->size; i++) {
+        if (!pool->entries[i].uses) {
+            pool->entries[i] = pool->session1;
+            pool->entries[i].handle = session;
+            pool->entries[i].uses = uses;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Flush all sessions of the session pool (non asynchronous).
+ *
+ * Used if the SRK changes during provisioning and when the FAPI context is
+ * finalized.
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ */
+void
+ifapi_session_pool_flush(FAPI_CONTEXT *context)
+{
+    IFAPI_SESSION_POOL *pool = &context->session_pool;
+
+    for (size_t i = 0; i < pool->size; i++) {
+        if (pool->entries[i].uses &&
+            Esys_FlushContext(context->esys, pool->entries[i].handle) != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Flush of pooled session failed.");
+        }
+    }
+    SAFE_FREE(pool->entries);
+    pool->size = 0;
+}
+
 /** Cleanup FAPI sessions in error cases.
  *
  * The uses sessions and the SRK (if not persistent) will be flushed
@@ -1077,6 +1789,9 @@ ifapi_session_clean(FAPI_CONTEXT *context)
     if (context->session1 != ESYS_TR_NONE) {
         if (Esys_FlushContext(context->esys, context->session1) != TSS2_RC_SUCCESS) {
             LOG_ERROR("Cleanup session failed.");
+            /* The TPM does not know the session, e.g. due to a TPM reset.
+               The same holds for the pooled sessions. */
+            session_pool_close(context);
         }
         context->session1 = ESYS_TR_NONE;
     }
@@ -1086,7 +1801,8 @@ ifapi_session_clean(FAPI_CONTEXT *context)
             context->session2 = ESYS_TR_NONE;
         }
     }
-    if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE) {
+    if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE &&
+        !ifapi_object_cached(context, context->srk_handle)) {
         if (Esys_FlushContext(context->esys, context->srk_handle) != TSS2_RC_SUCCESS) {
             LOG_ERROR("Cleanup Policy Session  failed.");
         }
@@ -1118,6 +1834,11 @@ ifapi_cleanup_session(FAPI_CONTEXT *context)
 
     switch (context->cleanup_state) {
         statecase(context->cleanup_state, CLEANUP_INIT);
+            /* Keep the session open for the next command if possible. */
+            if (context->session1 != ESYS_TR_NONE &&
+                session_pool_put(context, context->session1)) {
+                context->session1 = ESYS_TR_NONE;
+            }
             if (context->session1 != ESYS_TR_NONE) {
                 r = Esys_FlushContext_Async(context->esys, context->session1);
                 try_again_or_error(r, "Flush session.");
@@ -1144,14 +1865,16 @@ ifapi_cleanup_session(FAPI_CONTEXT *context)
             }
             context->session2 = ESYS_TR_NONE;
 
-            if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE) {
+            if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE &&
+                !ifapi_object_cached(context, context->srk_handle)) {
                 r = Esys_FlushContext_Async(context->esys, context->srk_handle);
                 try_again_or_error(r, "Flush SRK.");
             }
             fallthrough;
 
         statecase(context->cleanup_state, CLEANUP_SRK);
-            if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE) {
+            if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE &&
+                !ifapi_object_cached(context, context->srk_handle)) {
                 r = Esys_FlushContext_Finish(context->esys);
                 try_again_or_error(r, "Flush SRK.");
 
@@ -1175,7 +1898,8 @@ ifapi_cleanup_session(FAPI_CONTEXT *context)
 void
 ifapi_primary_clean(FAPI_CONTEXT *context)
 {
-    if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE) {
+    if (!context->srk_persistent && context->srk_handle != ESYS_TR_NONE &&
+        !ifapi_object_cached(context, context->srk_handle)) {
         if (Esys_FlushContext(context->esys, context->srk_handle) != TSS2_RC_SUCCESS) {
             LOG_ERROR("Cleanup session failed.");
         }
@@ -1298,6 +2022,8 @@ ifapi_get_sessions_finish(
     TPMI_ALG_HASH hash_alg)
 {
     TSS2_RC r;
+    TPMS_TIME_INFO *currentTime = NULL;
+    IFAPI_SESSION_POOL_ENTRY *entry;
 
     switch (context->session_state) {
     statecase(context->session_state, SESSION_WAIT_FOR_PRIMARY);
@@ -1316,7 +2042,31 @@ ifapi_get_sessions_finish(
             return TSS2_RC_SUCCESS;
         }
 
+        session_pool_select(context, profile, hash_alg);
+        if (context->config.session_pool_size &&
+            (context->session_flags & IFAPI_SESSION_GENEK)) {
+            entry = session_pool_find(context);
+            if (entry && entry->srk == context->srk_handle &&
+                primary_cache_current(context, context->srk_handle)) {
+                /* The SRK which salted the session was found in the TPM by
+                   this command, thus the TPM was not reset meanwhile. */
+                context->session_state = SESSION_TAKE_SESSION1;
+                return TSS2_FAPI_RC_TRY_AGAIN;
+            }
+            if (entry || !context->session_pool.clock_valid) {
+                /* Pooled sessions can only be used if the TPM was not reset. */
+                r = Esys_ReadClock_Async(context->esys,
+                                         ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE);
+                return_if_error_reset_state(r, "Read clock async");
+                context->session_state = SESSION_WAIT_FOR_CLOCK;
+                return TSS2_FAPI_RC_TRY_AGAIN;
+            }
+        }
+        fallthrough;
+
+    statecase(context->session_state, SESSION_START_SESSION1);
         /* Initializing the first session for the caller */
+        context->session_pool.session1.uses = 0;
 
         r = ifapi_get_session_async(context->esys, context->srk_handle, profile,
                                     hash_alg);
@@ -1329,7 +2079,9 @@ ifapi_get_sessions_finish(
                                      context->session1_attribute_flags);
         return_try_again(r);
         return_if_error_reset_state(r, "Create FAPI session finish");
+        fallthrough;
 
+    statecase(context->session_state, SESSION_CREATE_SESSION2);
         if (!(context->session_flags & IFAPI_SESSION2)) {
             LOG_TRACE("finished");
             return TSS2_RC_SUCCESS;
@@ -1351,6 +2103,29 @@ ifapi_get_sessions_finish(
         return_if_error_reset_state(r, "Create FAPI session finish");
         break;
 
+    statecase(context->session_state, SESSION_WAIT_FOR_CLOCK);
+        r = Esys_ReadClock_Finish(context->esys, &currentTime);
+        return_try_again(r);
+        return_if_error_reset_state(r, "Read clock finish");
+
+        session_pool_check_clock(context, &currentTime->clockInfo);
+        SAFE_FREE(currentTime);
+        fallthrough;
+
+    statecase(context->session_state, SESSION_TAKE_SESSION1);
+        if (!session_pool_take(context, &context->session1)) {
+            context->session_state = SESSION_START_SESSION1;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        LOG_DEBUG("Use pooled session 0x%x", context->session1);
+
+        r = Esys_TRSess_SetAttributes(context->esys, context->session1,
+                                      context->session1_attribute_flags |
+                                      TPMA_SESSION_CONTINUESESSION, 0xff);
+        return_if_error_reset_state(r, "Set session attributes.");
+        context->session_state = SESSION_CREATE_SESSION2;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
     statecasedefault(context->session_state);
     }
 
@@ -1675,10 +2450,53 @@ ifapi_load_key_async(FAPI_CONTEXT *context, size_t position)
     context->loadKey.position = position;
     context->loadKey.key_list = NULL;
     context->loadKey.parent_handle = ESYS_TR_NONE;
+    context->loadKey.cache_key = false;
+    context->loadKey.cache_entry = NULL;
+    cache_root(context->loadKey.path_list, &context->loadKey.root);
 
     return TSS2_RC_SUCCESS;
 }
 
+/** Continue the loading of a key whose resident copy is not available.
+ *
+ * The key stored in context->loadKey.auth_object is removed from the key
+ * cache and will be loaded via its parents.
+ *
+ * @param[in,out] context for storing all state information.
+ *
+ * @retval TSS2_FAPI_RC_TRY_AGAIN if the loading of the parents is prepared.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+load_key_from_parents(FAPI_CONTEXT *context)
+{
+    TSS2_RC r;
+    IFAPI_OBJECT *copyToPush;
+
+    key_cache_remove(context, context->loadKey.cache_entry, true);
+    context->loadKey.cache_entry = NULL;
+
+    copyToPush = malloc(sizeof(IFAPI_OBJECT));
+    return_if_null(copyToPush, "Out of memory", TSS2_FAPI_RC_MEMORY);
+    r = ifapi_copy_ifapi_key_object(copyToPush, &context->loadKey.auth_object);
+    if (r) {
+        free(copyToPush);
+        return_error(r, "Could not create a copy to push");
+    }
+    ifapi_cleanup_ifapi_object(&context->loadKey.auth_object);
+
+    /* Add object to the list of keys to be loaded. */
+    r = push_object_to_list(copyToPush, &context->loadKey.key_list);
+    if (r) {
+        ifapi_cleanup_ifapi_object(copyToPush);
+        free(copyToPush);
+        return_error(TSS2_FAPI_RC_MEMORY, "Out of memory");
+    }
+    context->loadKey.position -= 1;
+    context->loadKey.state = LOAD_KEY_GET_PATH;
+    return TSS2_FAPI_RC_TRY_AGAIN;
+}
+
 /** State machine for loading a key.
  *
  * A stack with all sup keys will be created and decremented during
@@ -1726,6 +2544,10 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
     IFAPI_OBJECT *key_object = NULL;
     IFAPI_KEY *key = NULL;
     ESYS_TR auth_session;
+    IFAPI_KEY_CACHE_ENTRY *entry;
+    TPM2B_NAME name;
+    TPM2B_NAME *readName = NULL;
+    TPM2B_NAME *esysName = NULL;
 
     switch (context->loadKey.state) {
     statecase(context->loadKey.state, LOAD_KEY_GET_PATH);
@@ -1792,10 +2614,25 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
             goto_if_error(r, "Could not copy primary key", error_cleanup);
 
             ifapi_cleanup_ifapi_key(key);
+            SAFE_FREE(context->createPrimary.root);
+            if (context->loadKey.root)
+                context->createPrimary.root = strdup(context->loadKey.root);
             context->primary_state = PRIMARY_READ_HIERARCHY;
             context->loadKey.state = LOAD_KEY_WAIT_FOR_PRIMARY;
             return TSS2_FAPI_RC_TRY_AGAIN;
         }
+
+        /* A key kept resident by an earlier command makes the loading of
+           the key and its parents unnecessary. */
+        context->loadKey.cache_entry = key_cache_lookup(context, key, &name);
+        if (context->loadKey.cache_entry) {
+            r = ifapi_copy_ifapi_key_object(&context->loadKey.auth_object,
+                                            context->loadKey.key_object);
+            goto_if_error(r, "Could not copy key object", error_cleanup);
+            ifapi_cleanup_ifapi_object(context->loadKey.key_object);
+            context->loadKey.state = LOAD_KEY_RESIDENT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
         IFAPI_OBJECT * copyToPush = malloc(sizeof(IFAPI_OBJECT));
         goto_if_null(copyToPush, "Out of memory", TSS2_FAPI_RC_MEMORY, error_cleanup);
         r = ifapi_copy_ifapi_key_object(copyToPush, context->loadKey.key_object);
@@ -1826,7 +2663,8 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
 
         /* if flush_parent is false parent is only flushed if a new parent
            is available */
-        if (!flush_parent && context->loadKey.parent_handle != ESYS_TR_NONE) {
+        if (!flush_parent && context->loadKey.parent_handle != ESYS_TR_NONE &&
+            !ifapi_object_cached(context, context->loadKey.parent_handle)) {
             r = Esys_FlushContext(context->esys, context->loadKey.parent_handle);
             goto_if_error_reset_state(r, "Flush object", error_cleanup);
         }
@@ -1838,6 +2676,9 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
         r = ifapi_authorize_object(context, &context->loadKey.auth_object, &auth_session);
         FAPI_SYNC(r, "Authorize key.", error_cleanup);
 
+        /* Keep the number of loaded resident keys below key_cache_slots. */
+        key_cache_make_room(context);
+
         /* Store parent handle in context for usage in ChangeAuth if not persistent */
         context->loadKey.parent_handle = context->loadKey.handle;
         if (context->loadKey.auth_object.misc.key.persistent_handle)
@@ -1865,9 +2706,19 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
         /* The current parent is flushed if not prohibited by flush parent */
         if (flush_parent && context->loadKey.auth_object.objectType == IFAPI_KEY_OBJ &&
             ! context->loadKey.auth_object.misc.key.persistent_handle) {
-            r = Esys_FlushContext(context->esys, context->loadKey.auth_object.handle);
-            goto_if_error_reset_state(r, "Flush object", error_cleanup);
+            if (ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
+                key_cache_release(context, context->loadKey.auth_object.handle);
+            } else {
+                r = Esys_FlushContext(context->esys, context->loadKey.auth_object.handle);
+                goto_if_error_reset_state(r, "Flush object", error_cleanup);
+            }
+        }
 
+        /* Parents are kept resident; the loaded key only if the caller
+           does not flush it. */
+        if (context->loadKey.key_list->next || context->loadKey.cache_key) {
+            key_object = context->loadKey.key_list->object;
+            key_cache_store(context, &key_object->misc.key, context->loadKey.handle);
         }
         LOG_TRACE("New key used as auth object.");
         ifapi_cleanup_ifapi_object(&context->loadKey.auth_object);
@@ -1910,6 +2761,103 @@ ifapi_load_key_finish(FAPI_CONTEXT *context, bool flush_parent)
         }
         break;
 
+    statecase(context->loadKey.state, LOAD_KEY_RESIDENT);
+        entry = context->loadKey.cache_entry;
+        if (entry->handle == ESYS_TR_NONE) {
+            /* The evicted key is restored from its saved context. */
+            key_cache_make_room(context);
+            r = Esys_ContextLoad_Async(context->esys, entry->context);
+            goto_if_error(r, "ContextLoad async", error_cleanup);
+
+            context->loadKey.state = LOAD_KEY_CONTEXT_LOAD;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        if (entry->command != context->key_cache.command) {
+            /* A TPM reset or another application might have removed the
+               key. The object at its TPM handle has to be checked. */
+            r = Esys_ReadPublic_Async(context->esys, entry->handle,
+                                      ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE);
+            goto_if_error(r, "ReadPublic async", error_cleanup);
+
+            context->loadKey.state = LOAD_KEY_READ_PUBLIC;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        fallthrough;
+
+    statecase(context->loadKey.state, LOAD_KEY_USE_RESIDENT);
+        entry = context->loadKey.cache_entry;
+        LOG_DEBUG("Use resident key 0x%x", entry->handle);
+        context->loadKey.handle = entry->handle;
+        context->loadKey.auth_object.handle = entry->handle;
+        if (context->loadKey.key_list || context->loadKey.cache_key) {
+            key_cache_use(context, entry);
+        } else {
+            /* The caller will flush the key. */
+            key_cache_remove(context, entry, false);
+        }
+        context->loadKey.cache_entry = NULL;
+        context->loadKey.state = LOAD_KEY_LOAD_KEY;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
+    statecase(context->loadKey.state, LOAD_KEY_READ_PUBLIC);
+        r = Esys_ReadPublic_Finish(context->esys, NULL, &readName, NULL);
+        return_try_again(r);
+        if (r != TSS2_RC_SUCCESS &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_TPM_RC_LAYER &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_TPM_RC_LAYER &&
+            (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_RC_LAYER) {
+            goto_if_error(r, "ReadPublic", error_cleanup);
+        }
+
+        entry = context->loadKey.cache_entry;
+        if (r == TSS2_RC_SUCCESS &&
+            Esys_TR_GetName(context->esys, entry->handle, &esysName) == TSS2_RC_SUCCESS &&
+            esysName->size == readName->size &&
+            memcmp(&esysName->name[0], &readName->name[0], readName->size) == 0) {
+            SAFE_FREE(readName);
+            SAFE_FREE(esysName);
+            context->loadKey.state = LOAD_KEY_USE_RESIDENT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        SAFE_FREE(readName);
+        SAFE_FREE(esysName);
+
+        /* The handle of the TPM object is unknown or belongs to another
+           object; only the ESYS resource has to be released. */
+        LOG_DEBUG("Resident key 0x%x was removed from TPM", entry->handle);
+        Esys_TR_Close(context->esys, &entry->handle);
+        entry->handle = ESYS_TR_NONE;
+        context->key_cache.loaded -= 1;
+        if (entry->context) {
+            /* Without a TPM reset the saved context is still valid. */
+            context->loadKey.state = LOAD_KEY_RESIDENT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        r = load_key_from_parents(context);
+        return_try_again(r);
+        goto error_cleanup;
+
+    statecase(context->loadKey.state, LOAD_KEY_CONTEXT_LOAD);
+        entry = context->loadKey.cache_entry;
+        r = Esys_ContextLoad_Finish(context->esys, &entry->handle);
+        return_try_again(r);
+        if (r != TSS2_RC_SUCCESS) {
+            if ((r & TSS2_RC_LAYER_MASK) != TSS2_TPM_RC_LAYER &&
+                (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_TPM_RC_LAYER &&
+                (r & TSS2_RC_LAYER_MASK) != TSS2_RESMGR_RC_LAYER) {
+                goto_if_error(r, "ContextLoad", error_cleanup);
+            }
+            /* The saved context is invalidated by a TPM reset. */
+            LOG_DEBUG("Saved context of resident key was rejected by TPM.");
+            entry->handle = ESYS_TR_NONE;
+            r = load_key_from_parents(context);
+            return_try_again(r);
+            goto error_cleanup;
+        }
+        context->key_cache.loaded += 1;
+        context->loadKey.state = LOAD_KEY_USE_RESIDENT;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
     statecasedefault(context->loadKey.state);
     }
 
@@ -2647,6 +3595,11 @@ ifapi_load_key(
         /* Prepare the key loading. */
         r = ifapi_load_keys_async(context, context->Key_Sign.keyPath);
         goto_if_error(r, "Load keys.", error_cleanup);
+
+        /* Only the signing key of Fapi_Sign is kept resident, keys loaded
+           e.g. for policy execution are flushed by their users. */
+        context->loadKey.cache_key = context->Key_Sign.cache_key;
+        context->Key_Sign.cache_key = false;
         fallthrough;
 
     statecase(context->Key_Sign.state, SIGN_WAIT_FOR_KEY);
@@ -2761,14 +3714,16 @@ ifapi_key_sign(
         goto_if_error(r, "Error: Sign", cleanup);
 
         /* Prepare the flushing of the signing key. */
-        if (!sig_key_object->misc.key.persistent_handle) {
+        if (!sig_key_object->misc.key.persistent_handle &&
+            !ifapi_object_cached(context, context->Key_Sign.handle)) {
             r = Esys_FlushContext_Async(context->esys, context->Key_Sign.handle);
             goto_if_error(r, "Error: FlushContext", cleanup);
         }
         fallthrough;
 
     statecase(context->Key_Sign.state, SIGN_WAIT_FOR_FLUSH);
-        if (!sig_key_object->misc.key.persistent_handle) {
+        if (!sig_key_object->misc.key.persistent_handle &&
+            !ifapi_object_cached(context, context->Key_Sign.handle)) {
             r = Esys_FlushContext_Finish(context->esys);
             return_try_again(r);
             goto_if_error(r, "Error: Sign", cleanup);
@@ -2802,7 +3757,8 @@ ifapi_key_sign(
     }
 
 cleanup:
-    if (context->Key_Sign.handle != ESYS_TR_NONE)
+    if (context->Key_Sign.handle != ESYS_TR_NONE &&
+        !ifapi_object_cached(context, context->Key_Sign.handle))
         Esys_FlushContext(context->esys, context->Key_Sign.handle);
     ifapi_cleanup_ifapi_object(context->Key_Sign.key_object);
     return r;
@@ -3427,7 +4383,8 @@ ifapi_key_create(
             goto_if_error_reset_state(r, "Load", error_cleanup);
         }
         /* Prepare Flushing of key used for authorization */
-        if (!context->loadKey.auth_object.misc.key.persistent_handle) {
+        if (!context->loadKey.auth_object.misc.key.persistent_handle &&
+            !ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
             r = Esys_FlushContext_Async(context->esys, context->loadKey.auth_object.handle);
             goto_if_error(r, "Flush parent", error_cleanup);
         }
@@ -3435,8 +4392,10 @@ ifapi_key_create(
 
     statecase(context->cmd.Key_Create.state, KEY_CREATE_FLUSH1);
         if (!context->loadKey.auth_object.misc.key.persistent_handle) {
-            r = Esys_FlushContext_Finish(context->esys);
-            try_again_or_error_goto(r, "Flush context", error_cleanup);
+            if (!ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
+                r = Esys_FlushContext_Finish(context->esys);
+                try_again_or_error_goto(r, "Flush context", error_cleanup);
+            }
 
             ifapi_cleanup_ifapi_object(&context->loadKey.auth_object);
         }
@@ -3566,7 +4525,8 @@ ifapi_key_create(
     if  (template->persistent_handle)
         ifapi_cleanup_ifapi_object(hierarchy);
     if (context->loadKey.auth_object.handle != ESYS_TR_NONE &&
-        !context->loadKey.auth_object.misc.key.persistent_handle) {
+        !context->loadKey.auth_object.misc.key.persistent_handle &&
+        !ifapi_object_cached(context, context->loadKey.auth_object.handle)) {
         Esys_FlushContext(context->esys, context->loadKey.auth_object.handle);
     }
     goto cleanup;
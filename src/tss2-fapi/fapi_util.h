@@ -75,6 +75,21 @@ ifapi_cleanup_session(FAPI_CONTEXT *context);
 void
 ifapi_primary_clean(FAPI_CONTEXT *context);
 
+bool
+ifapi_primary_cached(FAPI_CONTEXT *context, ESYS_TR handle);
+
+void
+ifapi_primary_cache_flush(FAPI_CONTEXT *context);
+
+bool
+ifapi_object_cached(FAPI_CONTEXT *context, ESYS_TR handle);
+
+void
+ifapi_key_cache_flush(FAPI_CONTEXT *context);
+
+void
+ifapi_session_pool_flush(FAPI_CONTEXT *context);
+
 TSS2_RC
 ifapi_get_sessions_async(
     FAPI_CONTEXT *context,
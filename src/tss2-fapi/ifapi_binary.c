@@ -0,0 +1,719 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <json-c/json.h>
+
+#include "tss2_mu.h"
+#include "ifapi_io.h"
+#include "ifapi_binary.h"
+#include "ifapi_helpers.h"
+#include "ifapi_policy_json_serialize.h"
+#include "ifapi_policy_json_deserialize.h"
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * A binary keystore object starts with the magic bytes, the version of the
+ * encoding, the object type and the system flag. The fields of the object
+ * follow in a fixed order. TPM structures are encoded with the Tss2_MU_*
+ * marshaling functions. Each optional field, string or byte array is preceded
+ * by one byte which states whether the field is present. Strings and byte
+ * arrays are stored as UINT32 length followed by the data. The policy of an
+ * object is stored as JSON string, because TPMS_POLICY has no TPM encoding.
+ */
+
+/** Buffer for the encoding of an object. */
+typedef struct {
+    uint8_t *buffer;
+    size_t size;
+    size_t offset;
+} IFAPI_BINARY_WRITER;
+
+/** Buffer for the decoding of an object. */
+typedef struct {
+    const uint8_t *buffer;
+    size_t size;
+    size_t offset;
+} IFAPI_BINARY_READER;
+
+/** Ensure that size bytes can be appended to the writer's buffer.
+ *
+ * @param[in,out] out The writer.
+ * @param[in] size The number of bytes to be appended.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if the buffer cannot be enlarged.
+ */
+static TSS2_RC
+binary_reserve(IFAPI_BINARY_WRITER *out, size_t size)
+{
+    uint8_t *buffer;
+    size_t new_size = out->size ? out->size : 1024;
+
+    if (out->size - out->offset >= size)
+        return TSS2_RC_SUCCESS;
+
+    while (new_size - out->offset < size)
+        new_size *= 2;
+    buffer = realloc(out->buffer, new_size);
+    return_if_null(buffer, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+
+    out->buffer = buffer;
+    out->size = new_size;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Write and read functions for types encoded by the Tss2_MU_* functions.
+ * The writer reserves the size of the structure, which is never smaller
+ * than its encoding.
+ */
+#define BINARY_MU_FUNCTIONS(type) \
+static TSS2_RC \
+binary_write_##type(IFAPI_BINARY_WRITER *out, const type *in) \
+{ \
+    TSS2_RC r = binary_reserve(out, sizeof(type)); \
+    return_if_error(r, "Reserve " #type "."); \
+    r = Tss2_MU_##type##_Marshal(in, out->buffer, out->size, &out->offset); \
+    return_if_error2(r == TSS2_RC_SUCCESS ? r : TSS2_FAPI_RC_BAD_VALUE, \
+                     "Marshal " #type "."); \
+    return TSS2_RC_SUCCESS; \
+} \
+\
+static TSS2_RC \
+binary_read_##type(IFAPI_BINARY_READER *in, type *out) \
+{ \
+    TSS2_RC r = Tss2_MU_##type##_Unmarshal(in->buffer, in->size, \
+                                           &in->offset, out); \
+    return_if_error2(r == TSS2_RC_SUCCESS ? r : TSS2_FAPI_RC_BAD_VALUE, \
+                     "Unmarshal " #type "."); \
+    return TSS2_RC_SUCCESS; \
+}
+
+BINARY_MU_FUNCTIONS(TPM2B_PUBLIC)
+BINARY_MU_FUNCTIONS(TPM2B_NV_PUBLIC)
+BINARY_MU_FUNCTIONS(TPM2B_CREATION_DATA)
+BINARY_MU_FUNCTIONS(TPMT_TK_CREATION)
+BINARY_MU_FUNCTIONS(TPMT_SIG_SCHEME)
+BINARY_MU_FUNCTIONS(TPM2B_NAME)
+BINARY_MU_FUNCTIONS(TPM2B_DIGEST)
+
+static TSS2_RC
+binary_write_UINT32(IFAPI_BINARY_WRITER *out, UINT32 in)
+{
+    TSS2_RC r = binary_reserve(out, sizeof(UINT32));
+    return_if_error(r, "Reserve UINT32.");
+
+    return Tss2_MU_UINT32_Marshal(in, out->buffer, out->size, &out->offset);
+}
+
+static TSS2_RC
+binary_read_UINT32(IFAPI_BINARY_READER *in, UINT32 *out)
+{
+    TSS2_RC r = Tss2_MU_UINT32_Unmarshal(in->buffer, in->size, &in->offset, out);
+    return_if_error2(r == TSS2_RC_SUCCESS ? r : TSS2_FAPI_RC_BAD_VALUE,
+                     "Unmarshal UINT32.");
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_write_UINT8(IFAPI_BINARY_WRITER *out, UINT8 in)
+{
+    TSS2_RC r = binary_reserve(out, sizeof(UINT8));
+    return_if_error(r, "Reserve UINT8.");
+
+    out->buffer[out->offset++] = in;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_read_UINT8(IFAPI_BINARY_READER *in, UINT8 *out)
+{
+    if (in->offset >= in->size) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Binary object too short.");
+    }
+    *out = in->buffer[in->offset++];
+    return TSS2_RC_SUCCESS;
+}
+
+/** Append a byte sequence preceded by its UINT32 length. */
+static TSS2_RC
+binary_write_bytes(IFAPI_BINARY_WRITER *out, const void *in, size_t size)
+{
+    TSS2_RC r;
+
+    if (size > UINT32_MAX) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Field too large.");
+    }
+    r = binary_write_UINT32(out, (UINT32)size);
+    return_if_error(r, "Write size.");
+
+    r = binary_reserve(out, size);
+    return_if_error(r, "Reserve bytes.");
+
+    if (size)
+        memcpy(&out->buffer[out->offset], in, size);
+    out->offset += size;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Read a byte sequence preceded by its UINT32 length.
+ *
+ * The returned buffer is zero terminated and has to be freed by the caller.
+ * At least one byte is allocated, thus an empty sequence is distinguishable
+ * from a missing one.
+ */
+static TSS2_RC
+binary_read_bytes(IFAPI_BINARY_READER *in, uint8_t **out, size_t *size)
+{
+    TSS2_RC r;
+    UINT32 length;
+
+    r = binary_read_UINT32(in, &length);
+    return_if_error(r, "Read size.");
+
+    if (in->size - in->offset < length) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Binary object too short.");
+    }
+    *out = malloc((size_t)length + 1);
+    return_if_null(*out, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+
+    memcpy(*out, &in->buffer[in->offset], length);
+    (*out)[length] = '\0';
+    in->offset += length;
+    *size = length;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_write_string(IFAPI_BINARY_WRITER *out, const char *in)
+{
+    TSS2_RC r = binary_write_UINT8(out, in != NULL);
+    return_if_error(r, "Write string flag.");
+
+    if (!in)
+        return TSS2_RC_SUCCESS;
+    return binary_write_bytes(out, in, strlen(in));
+}
+
+static TSS2_RC
+binary_read_string(IFAPI_BINARY_READER *in, char **out)
+{
+    TSS2_RC r;
+    UINT8 present;
+    size_t size;
+
+    r = binary_read_UINT8(in, &present);
+    return_if_error(r, "Read string flag.");
+
+    *out = NULL;
+    if (!present)
+        return TSS2_RC_SUCCESS;
+    return binary_read_bytes(in, (uint8_t **)out, &size);
+}
+
+static TSS2_RC
+binary_write_UINT8_ARY(IFAPI_BINARY_WRITER *out, const UINT8_ARY *in)
+{
+    TSS2_RC r = binary_write_UINT8(out, in->buffer != NULL);
+    return_if_error(r, "Write array flag.");
+
+    if (!in->buffer)
+        return TSS2_RC_SUCCESS;
+    return binary_write_bytes(out, in->buffer, in->size);
+}
+
+static TSS2_RC
+binary_read_UINT8_ARY(IFAPI_BINARY_READER *in, UINT8_ARY *out)
+{
+    TSS2_RC r;
+    UINT8 present;
+
+    r = binary_read_UINT8(in, &present);
+    return_if_error(r, "Read array flag.");
+
+    out->buffer = NULL;
+    out->size = 0;
+    if (!present)
+        return TSS2_RC_SUCCESS;
+    return binary_read_bytes(in, &out->buffer, &out->size);
+}
+
+static TSS2_RC
+binary_write_policy(IFAPI_BINARY_WRITER *out, const TPMS_POLICY *in)
+{
+    TSS2_RC r;
+    json_object *jso = NULL;
+
+    r = binary_write_UINT8(out, in != NULL);
+    return_if_error(r, "Write policy flag.");
+
+    if (!in)
+        return TSS2_RC_SUCCESS;
+
+    r = ifapi_json_TPMS_POLICY_serialize(in, &jso);
+    return_if_error(r, "Serialize policy.");
+
+    r = binary_write_string(out, json_object_to_json_string_ext(jso,
+                                                                JSON_C_TO_STRING_PLAIN));
+    json_object_put(jso);
+    return r;
+}
+
+static TSS2_RC
+binary_read_policy(IFAPI_BINARY_READER *in, TPMS_POLICY **out)
+{
+    TSS2_RC r;
+    UINT8 present;
+    char *json_string = NULL;
+    json_object *jso = NULL;
+
+    r = binary_read_UINT8(in, &present);
+    return_if_error(r, "Read policy flag.");
+
+    *out = NULL;
+    if (!present)
+        return TSS2_RC_SUCCESS;
+
+    r = binary_read_string(in, &json_string);
+    return_if_error(r, "Read policy.");
+    goto_if_null2(json_string, "Policy missing.", r, TSS2_FAPI_RC_BAD_VALUE,
+                  cleanup);
+
+    jso = json_tokener_parse(json_string);
+    goto_if_null2(jso, "Policy could not be parsed.", r, TSS2_FAPI_RC_BAD_VALUE,
+                  cleanup);
+
+    *out = calloc(1, sizeof(TPMS_POLICY));
+    goto_if_null2(*out, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, cleanup);
+
+    r = ifapi_json_TPMS_POLICY_deserialize(jso, *out);
+    goto_if_error(r, "Deserialize policy.", cleanup);
+
+cleanup:
+    if (jso)
+        json_object_put(jso);
+    SAFE_FREE(json_string);
+    return r;
+}
+
+static TSS2_RC
+binary_write_IFAPI_KEY(IFAPI_BINARY_WRITER *out, const IFAPI_KEY *in)
+{
+    TSS2_RC r;
+
+    r = binary_write_UINT32(out, in->persistent_handle);
+    return_if_error(r, "Write persistent_handle.");
+    r = binary_write_UINT8(out, in->with_auth);
+    return_if_error(r, "Write with_auth.");
+    r = binary_write_TPM2B_PUBLIC(out, &in->public);
+    return_if_error(r, "Write public.");
+    r = binary_write_UINT8_ARY(out, &in->serialization);
+    return_if_error(r, "Write serialization.");
+    r = binary_write_UINT8_ARY(out, &in->private);
+    return_if_error(r, "Write private.");
+    r = binary_write_UINT8_ARY(out, &in->appData);
+    return_if_error(r, "Write appData.");
+    r = binary_write_string(out, in->policyInstance);
+    return_if_error(r, "Write policyInstance.");
+
+    r = binary_write_UINT8(out, in->creationData.size != 0);
+    return_if_error(r, "Write creationData flag.");
+    if (in->creationData.size != 0) {
+        r = binary_write_TPM2B_CREATION_DATA(out, &in->creationData);
+        return_if_error(r, "Write creationData.");
+    }
+    r = binary_write_UINT8(out, in->creationTicket.tag != 0);
+    return_if_error(r, "Write creationTicket flag.");
+    if (in->creationTicket.tag != 0) {
+        r = binary_write_TPMT_TK_CREATION(out, &in->creationTicket);
+        return_if_error(r, "Write creationTicket.");
+    }
+
+    r = binary_write_string(out, in->description);
+    return_if_error(r, "Write description.");
+    r = binary_write_string(out, in->certificate);
+    return_if_error(r, "Write certificate.");
+
+    /* Keyed hash objects have no signing scheme, like in the JSON encoding. */
+    if (in->public.publicArea.type != TPM2_ALG_KEYEDHASH) {
+        r = binary_write_TPMT_SIG_SCHEME(out, &in->signing_scheme);
+        return_if_error(r, "Write signing_scheme.");
+    }
+    r = binary_write_TPM2B_NAME(out, &in->name);
+    return_if_error(r, "Write name.");
+    r = binary_write_UINT32(out, in->reset_count);
+    return_if_error(r, "Write reset_count.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_read_IFAPI_KEY(IFAPI_BINARY_READER *in, IFAPI_KEY *out)
+{
+    TSS2_RC r;
+    UINT8 value;
+
+    r = binary_read_UINT32(in, &out->persistent_handle);
+    return_if_error(r, "Read persistent_handle.");
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read with_auth.");
+    out->with_auth = value;
+    r = binary_read_TPM2B_PUBLIC(in, &out->public);
+    return_if_error(r, "Read public.");
+    r = binary_read_UINT8_ARY(in, &out->serialization);
+    return_if_error(r, "Read serialization.");
+    r = binary_read_UINT8_ARY(in, &out->private);
+    return_if_error(r, "Read private.");
+    r = binary_read_UINT8_ARY(in, &out->appData);
+    return_if_error(r, "Read appData.");
+    r = binary_read_string(in, &out->policyInstance);
+    return_if_error(r, "Read policyInstance.");
+
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read creationData flag.");
+    if (value) {
+        r = binary_read_TPM2B_CREATION_DATA(in, &out->creationData);
+        return_if_error(r, "Read creationData.");
+    }
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read creationTicket flag.");
+    if (value) {
+        r = binary_read_TPMT_TK_CREATION(in, &out->creationTicket);
+        return_if_error(r, "Read creationTicket.");
+    }
+
+    r = binary_read_string(in, &out->description);
+    return_if_error(r, "Read description.");
+    r = binary_read_string(in, &out->certificate);
+    return_if_error(r, "Read certificate.");
+
+    if (out->public.publicArea.type != TPM2_ALG_KEYEDHASH) {
+        r = binary_read_TPMT_SIG_SCHEME(in, &out->signing_scheme);
+        return_if_error(r, "Read signing_scheme.");
+    }
+    r = binary_read_TPM2B_NAME(in, &out->name);
+    return_if_error(r, "Read name.");
+    r = binary_read_UINT32(in, &out->reset_count);
+    return_if_error(r, "Read reset_count.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_write_IFAPI_NV(IFAPI_BINARY_WRITER *out, const IFAPI_NV *in)
+{
+    TSS2_RC r;
+
+    r = binary_write_UINT8(out, in->with_auth);
+    return_if_error(r, "Write with_auth.");
+    r = binary_write_TPM2B_NV_PUBLIC(out, &in->public);
+    return_if_error(r, "Write public.");
+    r = binary_write_UINT8_ARY(out, &in->serialization);
+    return_if_error(r, "Write serialization.");
+    r = binary_write_UINT32(out, in->hierarchy);
+    return_if_error(r, "Write hierarchy.");
+    r = binary_write_string(out, in->policyInstance);
+    return_if_error(r, "Write policyInstance.");
+    r = binary_write_string(out, in->description);
+    return_if_error(r, "Write description.");
+    r = binary_write_UINT8_ARY(out, &in->appData);
+    return_if_error(r, "Write appData.");
+    r = binary_write_string(out, in->event_log);
+    return_if_error(r, "Write event_log.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_read_IFAPI_NV(IFAPI_BINARY_READER *in, IFAPI_NV *out)
+{
+    TSS2_RC r;
+    UINT8 value;
+
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read with_auth.");
+    out->with_auth = value;
+    r = binary_read_TPM2B_NV_PUBLIC(in, &out->public);
+    return_if_error(r, "Read public.");
+    r = binary_read_UINT8_ARY(in, &out->serialization);
+    return_if_error(r, "Read serialization.");
+    r = binary_read_UINT32(in, &out->hierarchy);
+    return_if_error(r, "Read hierarchy.");
+    r = binary_read_string(in, &out->policyInstance);
+    return_if_error(r, "Read policyInstance.");
+    r = binary_read_string(in, &out->description);
+    return_if_error(r, "Read description.");
+    r = binary_read_UINT8_ARY(in, &out->appData);
+    return_if_error(r, "Read appData.");
+    r = binary_read_string(in, &out->event_log);
+    return_if_error(r, "Read event_log.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_write_IFAPI_HIERARCHY(IFAPI_BINARY_WRITER *out, const IFAPI_HIERARCHY *in)
+{
+    TSS2_RC r;
+
+    r = binary_write_UINT8(out, in->with_auth);
+    return_if_error(r, "Write with_auth.");
+    r = binary_write_TPM2B_DIGEST(out, &in->authPolicy);
+    return_if_error(r, "Write authPolicy.");
+    r = binary_write_string(out, in->description);
+    return_if_error(r, "Write description.");
+    r = binary_write_UINT32(out, in->esysHandle);
+    return_if_error(r, "Write esysHandle.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_read_IFAPI_HIERARCHY(IFAPI_BINARY_READER *in, IFAPI_HIERARCHY *out)
+{
+    TSS2_RC r;
+    UINT8 value;
+
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read with_auth.");
+    out->with_auth = value;
+    r = binary_read_TPM2B_DIGEST(in, &out->authPolicy);
+    return_if_error(r, "Read authPolicy.");
+    r = binary_read_string(in, &out->description);
+    return_if_error(r, "Read description.");
+    r = binary_read_UINT32(in, &out->esysHandle);
+    return_if_error(r, "Read esysHandle.");
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_write_IFAPI_EXT_PUB_KEY(IFAPI_BINARY_WRITER *out,
+                               const IFAPI_EXT_PUB_KEY *in)
+{
+    TSS2_RC r;
+
+    r = binary_write_string(out, in->pem_ext_public);
+    return_if_error(r, "Write pem_ext_public.");
+    r = binary_write_string(out, in->certificate);
+    return_if_error(r, "Write certificate.");
+
+    r = binary_write_UINT8(out, in->public.publicArea.type != 0);
+    return_if_error(r, "Write public flag.");
+    if (in->public.publicArea.type != 0) {
+        r = binary_write_TPM2B_PUBLIC(out, &in->public);
+        return_if_error(r, "Write public.");
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+binary_read_IFAPI_EXT_PUB_KEY(IFAPI_BINARY_READER *in, IFAPI_EXT_PUB_KEY *out)
+{
+    TSS2_RC r;
+    UINT8 value;
+
+    r = binary_read_string(in, &out->pem_ext_public);
+    return_if_error(r, "Read pem_ext_public.");
+    r = binary_read_string(in, &out->certificate);
+    return_if_error(r, "Read certificate.");
+
+    r = binary_read_UINT8(in, &value);
+    return_if_error(r, "Read public flag.");
+    if (value) {
+        r = binary_read_TPM2B_PUBLIC(in, &out->public);
+        return_if_error(r, "Read public.");
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+/** Check whether a buffer holds a binary keystore object.
+ *
+ * @param[in] buffer The content of a keystore file.
+ * @param[in] size The size of the buffer.
+ * @retval true if the buffer starts with the magic of the binary encoding.
+ * @retval false otherwise.
+ */
+bool
+ifapi_binary_is_object(
+    const uint8_t *buffer,
+    size_t size)
+{
+    return buffer && size >= IFAPI_BINARY_MAGIC_SIZE &&
+        memcmp(buffer, IFAPI_BINARY_MAGIC, IFAPI_BINARY_MAGIC_SIZE) == 0;
+}
+
+/** Check whether an object can be stored in the binary encoding.
+ *
+ * Duplication objects are not stored in the keystore and are always
+ * exchanged as JSON.
+ *
+ * @param[in] object The object to be stored.
+ * @retval true if the binary encoding supports the object type.
+ * @retval false otherwise.
+ */
+bool
+ifapi_binary_supported(
+    const IFAPI_OBJECT *object)
+{
+    switch (object->objectType) {
+    case IFAPI_KEY_OBJ:
+    case IFAPI_NV_OBJ:
+    case IFAPI_EXT_PUB_KEY_OBJ:
+    case IFAPI_HIERARCHY_OBJ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/** Serialize a keystore object to the binary encoding.
+ *
+ * @param[in] in The object to be serialized.
+ * @param[out] buffer The encoded object. It has to be freed by the caller.
+ * @param[out] size The size of the encoded object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE if a NULL pointer was passed.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the object type is not supported or a
+ *         field can not be encoded.
+ * @retval TSS2_FAPI_RC_MEMORY if the FAPI cannot allocate enough memory.
+ */
+TSS2_RC
+ifapi_binary_IFAPI_OBJECT_serialize(
+    const IFAPI_OBJECT *in,
+    uint8_t **buffer,
+    size_t *size)
+{
+    TSS2_RC r;
+    IFAPI_BINARY_WRITER out = { NULL, 0, 0 };
+
+    check_not_null(in);
+    check_not_null(buffer);
+    check_not_null(size);
+
+    r = binary_reserve(&out, IFAPI_BINARY_MAGIC_SIZE);
+    goto_if_error(r, "Reserve header.", error_cleanup);
+    memcpy(out.buffer, IFAPI_BINARY_MAGIC, IFAPI_BINARY_MAGIC_SIZE);
+    out.offset = IFAPI_BINARY_MAGIC_SIZE;
+
+    r = binary_write_UINT32(&out, IFAPI_BINARY_VERSION);
+    goto_if_error(r, "Write version.", error_cleanup);
+    r = binary_write_UINT32(&out, in->objectType);
+    goto_if_error(r, "Write objectType.", error_cleanup);
+    r = binary_write_UINT8(&out, in->system);
+    goto_if_error(r, "Write system.", error_cleanup);
+
+    switch (in->objectType) {
+    case IFAPI_KEY_OBJ:
+        r = binary_write_IFAPI_KEY(&out, &in->misc.key);
+        break;
+    case IFAPI_NV_OBJ:
+        r = binary_write_IFAPI_NV(&out, &in->misc.nv);
+        break;
+    case IFAPI_EXT_PUB_KEY_OBJ:
+        r = binary_write_IFAPI_EXT_PUB_KEY(&out, &in->misc.ext_pub_key);
+        break;
+    case IFAPI_HIERARCHY_OBJ:
+        r = binary_write_IFAPI_HIERARCHY(&out, &in->misc.hierarchy);
+        break;
+    default:
+        goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Invalid object type %"PRIu32,
+                   error_cleanup, in->objectType);
+    }
+    goto_if_error(r, "Write object.", error_cleanup);
+
+    r = binary_write_policy(&out, in->policy);
+    goto_if_error(r, "Write policy.", error_cleanup);
+
+    *buffer = out.buffer;
+    *size = out.offset;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    SAFE_FREE(out.buffer);
+    return r;
+}
+
+/** Deserialize a keystore object from the binary encoding.
+ *
+ * @param[in] buffer The encoded object.
+ * @param[in] size The size of the encoded object.
+ * @param[out] out The deserialized object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE if a NULL pointer was passed.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the buffer does not hold a valid
+ *         binary object of a supported version.
+ * @retval TSS2_FAPI_RC_MEMORY if the FAPI cannot allocate enough memory.
+ */
+TSS2_RC
+ifapi_binary_IFAPI_OBJECT_deserialize(
+    const uint8_t *buffer,
+    size_t size,
+    IFAPI_OBJECT *out)
+{
+    TSS2_RC r;
+    UINT32 version;
+    UINT8 value;
+    IFAPI_BINARY_READER in = { buffer, size, IFAPI_BINARY_MAGIC_SIZE };
+
+    check_not_null(buffer);
+    check_not_null(out);
+
+    memset(out, 0, sizeof(IFAPI_OBJECT));
+
+    if (!ifapi_binary_is_object(buffer, size)) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "No binary keystore object.");
+    }
+
+    r = binary_read_UINT32(&in, &version);
+    return_if_error(r, "Read version.");
+    if (version != IFAPI_BINARY_VERSION) {
+        return_error2(TSS2_FAPI_RC_BAD_VALUE,
+                      "Unsupported binary object version %"PRIu32
+                      " (supported: %i)", version, IFAPI_BINARY_VERSION);
+    }
+    r = binary_read_UINT32(&in, &out->objectType);
+    return_if_error(r, "Read objectType.");
+    r = binary_read_UINT8(&in, &value);
+    return_if_error(r, "Read system.");
+    out->system = value;
+
+    switch (out->objectType) {
+    case IFAPI_KEY_OBJ:
+        r = binary_read_IFAPI_KEY(&in, &out->misc.key);
+        break;
+    case IFAPI_NV_OBJ:
+        r = binary_read_IFAPI_NV(&in, &out->misc.nv);
+        break;
+    case IFAPI_EXT_PUB_KEY_OBJ:
+        r = binary_read_IFAPI_EXT_PUB_KEY(&in, &out->misc.ext_pub_key);
+        break;
+    case IFAPI_HIERARCHY_OBJ:
+        r = binary_read_IFAPI_HIERARCHY(&in, &out->misc.hierarchy);
+        break;
+    default:
+        return_error2(TSS2_FAPI_RC_BAD_VALUE, "Invalid object type %"PRIu32,
+                      out->objectType);
+    }
+    goto_if_error(r, "Read object.", error_cleanup);
+
+    r = binary_read_policy(&in, &out->policy);
+    goto_if_error(r, "Read policy.", error_cleanup);
+
+    if (in.offset != in.size) {
+        goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Trailing data in binary object.",
+                   error_cleanup);
+    }
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    ifapi_cleanup_ifapi_object(out);
+    return r;
+}
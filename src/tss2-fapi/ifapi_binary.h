@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef IFAPI_BINARY_H
+#define IFAPI_BINARY_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "tss2_common.h"
+#include "ifapi_keystore.h"
+
+/** Magic bytes at the start of a binary keystore object.
+ *
+ * The leading zero byte can not occur at the start of a JSON object, thus
+ * both encodings can be distinguished by the first bytes of a file.
+ */
+#define IFAPI_BINARY_MAGIC "\0TSS2OBJ"
+#define IFAPI_BINARY_MAGIC_SIZE 8
+
+/** Version of the binary keystore object encoding.
+ *
+ * Stored as big endian UINT32 after the magic. Objects of other versions are
+ * rejected. Binary objects keep the file name object.json, so the magic and
+ * the version are the only means to recognize the encoding.
+ */
+#define IFAPI_BINARY_VERSION 1
+
+bool
+ifapi_binary_is_object(
+    const uint8_t *buffer,
+    size_t size);
+
+bool
+ifapi_binary_supported(
+    const IFAPI_OBJECT *object);
+
+TSS2_RC
+ifapi_binary_IFAPI_OBJECT_serialize(
+    const IFAPI_OBJECT *in,
+    uint8_t **buffer,
+    size_t *size);
+
+TSS2_RC
+ifapi_binary_IFAPI_OBJECT_deserialize(
+    const uint8_t *buffer,
+    size_t size,
+    IFAPI_OBJECT *out);
+
+#endif /* IFAPI_BINARY_H */
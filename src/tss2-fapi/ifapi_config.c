@@ -126,6 +126,58 @@ ifapi_json_IFAPI_CONFIG_deserialize(json_object *jso, IFAPI_CONFIG *out)
         return_if_error(r, "BAD VALUE");
     }
 
+    if (ifapi_get_sub_object(jso, "primary_cache_size", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->primary_cache_size);
+        return_if_error(r, "BAD VALUE");
+    } else {
+        out->primary_cache_size = DEFAULT_PRIMARY_CACHE_SIZE;
+    }
+
+    if (ifapi_get_sub_object(jso, "session_pool_size", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->session_pool_size);
+        return_if_error(r, "BAD VALUE");
+    } else {
+        out->session_pool_size = DEFAULT_SESSION_POOL_SIZE;
+    }
+
+    if (ifapi_get_sub_object(jso, "session_max_uses", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->session_max_uses);
+        return_if_error(r, "BAD VALUE");
+    } else {
+        out->session_max_uses = DEFAULT_SESSION_MAX_USES;
+    }
+
+    if (ifapi_get_sub_object(jso, "key_cache_size", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->key_cache_size);
+        return_if_error(r, "BAD VALUE");
+    } else {
+        out->key_cache_size = DEFAULT_KEY_CACHE_SIZE;
+    }
+
+    if (ifapi_get_sub_object(jso, "key_cache_slots", &jso2)) {
+        r = ifapi_json_UINT32_deserialize(jso2, &out->key_cache_slots);
+        return_if_error(r, "BAD VALUE");
+    } else {
+        out->key_cache_slots = DEFAULT_KEY_CACHE_SLOTS;
+    }
+
+    out->keystore_format = IFAPI_KEYSTORE_FORMAT_JSON;
+    if (ifapi_get_sub_object(jso, "keystore_format", &jso2)) {
+        char *format = NULL;
+
+        r = ifapi_json_char_deserialize(jso2, &format);
+        return_if_error(r, "BAD VALUE");
+
+        if (strcmp(format, "binary") == 0) {
+            out->keystore_format = IFAPI_KEYSTORE_FORMAT_BINARY;
+        } else if (strcmp(format, "json") != 0) {
+            LOG_ERROR("Invalid keystore_format %s", format);
+            free(format);
+            return TSS2_FAPI_RC_BAD_VALUE;
+        }
+        free(format);
+    }
+
     LOG_TRACE("true");
     return TSS2_RC_SUCCESS;
 }
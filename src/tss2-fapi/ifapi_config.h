@@ -14,6 +14,27 @@
 
 #define ENV_FAPI_CONFIG "TSS2_FAPICONF"
 
+/** Number of primaries kept loaded if primary_cache_size is not configured */
+#define DEFAULT_PRIMARY_CACHE_SIZE 0
+
+/** Number of sessions kept open if session_pool_size is not configured */
+#define DEFAULT_SESSION_POOL_SIZE 0
+
+/** Number of commands using a pooled session before it is replaced */
+#define DEFAULT_SESSION_MAX_USES 100
+
+/** Number of keys kept resident if key_cache_size is not configured */
+#define DEFAULT_KEY_CACHE_SIZE 0
+
+/** Number of resident keys kept loaded if key_cache_slots is not configured */
+#define DEFAULT_KEY_CACHE_SLOTS 1
+
+/** Encoding of objects written to the keystore */
+typedef enum {
+    IFAPI_KEYSTORE_FORMAT_JSON = 0,   /**< JSON, readable by all FAPI versions */
+    IFAPI_KEYSTORE_FORMAT_BINARY      /**< Tss2_MU encoding with a binary header */
+} IFAPI_KEYSTORE_FORMAT;
+
 /**
  * Type for storing FAPI configuration
  */
@@ -40,6 +61,18 @@ typedef struct {
     TPMI_YES_NO         ek_cert_less;
     /** Certificate service for Intel TPMs */
     char                *intel_cert_service;
+    /** Number of transient TPM slots used for primaries kept loaded */
+    UINT32               primary_cache_size;
+    /** Number of HMAC sessions kept open across commands */
+    UINT32               session_pool_size;
+    /** Number of commands after which a pooled session is replaced */
+    UINT32               session_max_uses;
+    /** Number of keys kept resident across commands */
+    UINT32               key_cache_size;
+    /** Number of transient TPM slots used for resident keys */
+    UINT32               key_cache_slots;
+    /** Encoding of objects written to the keystore */
+    IFAPI_KEYSTORE_FORMAT keystore_format;
 
 } IFAPI_CONFIG;
 
@@ -8,17 +8,271 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "ifapi_helpers.h"
 #include "ifapi_eventlog.h"
 #include "ifapi_json_serialize.h"
+#include "tpm_json_deserialize.h"
 
 #define LOGMODULE fapi
 #include "util/log.h"
 #include "util/aux_util.h"
 #include "ifapi_macros.h"
 
+/** Suffix of the temporary file used for migrating a JSON array event log. */
+#define IFAPI_EVENTLOG_TMP_SUFFIX ".tmp"
+
+/** Number of bytes initially read from the end of an event log to find the
+ *  last record. */
+#define IFAPI_EVENTLOG_TAIL_SIZE 4096
+
+/** Number of records parsed per call of ifapi_eventlog_get_finish. */
+#define IFAPI_EVENTLOG_PARSE_LINES 256
+
+/** Construct the file names of the event log of a PCR.
+ *
+ * Events are stored one per line in the file IFAPI_PCR_EVENTS_FILE<pcr>.
+ * Logs written by former versions are stored as one JSON array in the file
+ * IFAPI_PCR_LOG_FILE<pcr>.
+ *
+ * @param[in] eventlog The context area for the eventlog.
+ * @param[in] pcr The PCR register of the event log.
+ * @param[out] log_file The file name of the event log.
+ * @param[out] legacy_file The file name of the event log in array format.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ */
+static TSS2_RC
+eventlog_file_names(
+    IFAPI_EVENTLOG *eventlog,
+    TPM2_HANDLE pcr,
+    char **log_file,
+    char **legacy_file)
+{
+    TSS2_RC r;
+
+    r = ifapi_asprintf(log_file, "%s/%s%i", eventlog->log_dir,
+                       IFAPI_PCR_EVENTS_FILE, pcr);
+    return_if_error(r, "Out of memory.");
+
+    r = ifapi_asprintf(legacy_file, "%s/%s%i", eventlog->log_dir,
+                       IFAPI_PCR_LOG_FILE, pcr);
+    if (r) {
+        SAFE_FREE(*log_file);
+        return_error(r, "Out of memory.");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free the file names of the event log currently processed.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ */
+static void
+eventlog_free_file_names(IFAPI_EVENTLOG *eventlog)
+{
+    SAFE_FREE(eventlog->log_file);
+    SAFE_FREE(eventlog->legacy_file);
+}
+
+/** Append an event as one line to a buffer.
+ *
+ * @param[in,out] lines The buffer with the lines (callee-allocated; use free()).
+ * @param[in,out] length The length of the lines in the buffer.
+ * @param[in] event The JSON object of the event.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ */
+static TSS2_RC
+eventlog_add_line(char **lines, size_t *length, json_object *event)
+{
+    /* JSON strings escape control characters, so the record contains no newline. */
+    const char *line = json_object_to_json_string_ext(event, JSON_C_TO_STRING_PLAIN);
+    size_t size = strlen(line);
+    char *new_lines;
+
+    new_lines = realloc(*lines, *length + size + 2);
+    return_if_null(new_lines, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+
+    memcpy(&new_lines[*length], line, size);
+    *length += size;
+    new_lines[(*length)++] = '\n';
+    new_lines[*length] = '\0';
+    *lines = new_lines;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Release the lock of the event log an event is appended to.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ */
+static void
+eventlog_unlock(IFAPI_EVENTLOG *eventlog)
+{
+    if (eventlog->lock) {
+        fclose(eventlog->lock);
+        eventlog->lock = NULL;
+    }
+}
+
+/** Check whether an event log in the line format contains records.
+ *
+ * @param[in] log_file The file name of the event log.
+ * @retval true if the file exists and is not empty.
+ * @retval false otherwise.
+ */
+static bool
+eventlog_has_records(const char *log_file)
+{
+    struct stat st;
+
+    return stat(log_file, &st) == 0 && st.st_size > 0;
+}
+
+/** Determine the number of the last record of an event log.
+ *
+ * Only the end of the file is read. Starting with the last line, the
+ * lines are parsed until a valid record is found. An incomplete last line
+ * left by an interrupted write is skipped.
+ * The locked stream is used, since opening and closing another stream of
+ * the file would release the lock.
+ *
+ * @param[in] stream The locked stream of the event log.
+ * @param[in] log_file The file name of the event log.
+ * @param[out] recnum The number of the last record; 0 if no record exists.
+ * @param[out] terminated false if the file does not end with a newline.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the file can't be read.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ */
+static TSS2_RC
+eventlog_last_recnum(
+    FILE *stream,
+    const char *log_file,
+    UINT32 *recnum,
+    bool *terminated)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    char *buffer = NULL;
+    long size, start, window;
+    size_t length, line_start, line_end;
+    json_object *jso, *jso_recnum;
+    bool found = false;
+
+    *recnum = 0;
+    *terminated = true;
+
+    if (fseek(stream, 0L, SEEK_END) || (size = ftell(stream)) < 0) {
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Seek in event log %s", cleanup,
+                   log_file);
+    }
+
+    for (window = IFAPI_EVENTLOG_TAIL_SIZE; !found; window *= 2) {
+        start = (size > window) ? size - window : 0;
+        length = size - start;
+        buffer = malloc(length + 1);
+        goto_if_null2(buffer, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, cleanup);
+
+        if (fseek(stream, start, SEEK_SET) ||
+            fread(buffer, 1, length, stream) != length) {
+            goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Read event log %s", cleanup,
+                       log_file);
+        }
+        buffer[length] = '\0';
+        if (length > 0 && buffer[length - 1] != '\n')
+            *terminated = false;
+
+        /* Skip an incomplete last line. */
+        line_end = length;
+        while (line_end > 0 && buffer[line_end - 1] != '\n')
+            line_end--;
+
+        while (line_end > 0) {
+            buffer[line_end - 1] = '\0';
+            line_start = line_end - 1;
+            while (line_start > 0 && buffer[line_start - 1] != '\n')
+                line_start--;
+            if (line_start == 0 && start > 0)
+                /* The line might begin before the window. */
+                break;
+
+            jso = json_tokener_parse(&buffer[line_start]);
+            if (jso && ifapi_get_sub_object(jso, "recnum", &jso_recnum) &&
+                ifapi_json_UINT32_deserialize(jso_recnum, recnum) == TSS2_RC_SUCCESS) {
+                json_object_put(jso);
+                found = true;
+                break;
+            }
+            if (jso)
+                json_object_put(jso);
+            LOG_WARNING("Invalid record in event log %s skipped.", log_file);
+            line_end = line_start;
+        }
+        SAFE_FREE(buffer);
+        if (start == 0)
+            break;
+    }
+
+cleanup:
+    SAFE_FREE(buffer);
+    return r;
+}
+
+/** Parse the next records of an event log in the line format.
+ *
+ * At most IFAPI_EVENTLOG_PARSE_LINES records are read from the stream and
+ * added to the log, thus only one record is held in memory besides the
+ * parsed events. Invalid records and an incomplete last line left by an
+ * interrupted write are skipped.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ * @retval TSS2_RC_SUCCESS if the end of the log was reached.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN if more records have to be parsed.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the log can't be read.
+ */
+static TSS2_RC
+eventlog_parse_lines(IFAPI_EVENTLOG *eventlog)
+{
+    TSS2_RC r = TSS2_FAPI_RC_TRY_AGAIN;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    json_object *event;
+    int i;
+
+    for (i = 0; i < IFAPI_EVENTLOG_PARSE_LINES; i++) {
+        length = getline(&line, &size, eventlog->stream);
+        if (length < 0) {
+            if (ferror(eventlog->stream)) {
+                LOG_ERROR("Read event log %s", eventlog->log_file);
+                r = TSS2_FAPI_RC_IO_ERROR;
+            } else {
+                r = TSS2_RC_SUCCESS;
+            }
+            break;
+        }
+        if (line[length - 1] != '\n') {
+            /* Incomplete last line. */
+            LOG_WARNING("Incomplete record in event log %s skipped.", eventlog->log_file);
+            continue;
+        }
+        line[length - 1] = '\0';
+        if (length == 1)
+            continue;
+
+        event = json_tokener_parse(line);
+        if (event)
+            json_object_array_add(eventlog->log, event);
+        else
+            LOG_WARNING("Invalid record in event log %s skipped.", eventlog->log_file);
+    }
+    SAFE_FREE(line);
+    return r;
+}
+
 /** Initialize the eventlog module of FAPI.
  *
  * @param[in,out] eventlog The context area for the eventlog.
@@ -142,38 +396,49 @@ loop:
 
     switch (eventlog->state) {
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_INIT)
-        /* Construct the filename for the eventlog file */
-        r = ifapi_asprintf(&event_log_file, "%s/%s%i",
-                           eventlog->log_dir, IFAPI_PCR_LOG_FILE,
-                           eventlog->pcrList[eventlog->pcrListIdx]);
+        /* Construct the filenames for the eventlog file */
+        r = eventlog_file_names(eventlog, eventlog->pcrList[eventlog->pcrListIdx],
+                                &eventlog->log_file, &eventlog->legacy_file);
         return_if_error(r, "Out of memory.");
 
-        if (!ifapi_io_path_exists(event_log_file)) {
-            LOG_DEBUG("No event log for pcr %i", eventlog->pcrList[eventlog->pcrListIdx]);
-            SAFE_FREE(event_log_file);
-            eventlog->pcrListIdx += 1;
+        /* Logs in the array format are read until the next extend migrates
+           them. The line format log is empty while a migration is pending. */
+        if (eventlog_has_records(eventlog->log_file) ||
+            !ifapi_io_path_exists(eventlog->legacy_file)) {
+            SAFE_FREE(eventlog->legacy_file);
+            eventlog->stream = fopen(eventlog->log_file, "rt");
+            if (!eventlog->stream) {
+                LOG_DEBUG("No event log for pcr %i", eventlog->pcrList[eventlog->pcrListIdx]);
+                eventlog_free_file_names(eventlog);
+                eventlog->pcrListIdx += 1;
+                goto loop;
+            }
+            eventlog->state = IFAPI_EVENTLOG_STATE_PARSING;
             goto loop;
         }
+        event_log_file = eventlog->legacy_file;
 
         /* Initiate the reading of the eventlog file */
         r = ifapi_io_read_async(io, event_log_file);
-        free(event_log_file);
         if (r) {
             LOG_DEBUG("No event log for pcr %i", eventlog->pcrList[eventlog->pcrListIdx]);
+            eventlog_free_file_names(eventlog);
             eventlog->pcrListIdx += 1;
             goto loop;
         }
         fallthrough;
 
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_READING)
-        /* Finish the reading of the eventlog file and return it directly to the output parameter */
+        /* Finish the reading of the array log */
         r = ifapi_io_read_finish(io, (uint8_t **)&logstr, NULL);
         return_try_again(r);
+        eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
+        eventlog_free_file_names(eventlog);
         return_if_error(r, "read_finish failed");
 
         logpart = json_tokener_parse(logstr);
         SAFE_FREE(logstr);
-        return_if_null(log, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
+        return_if_null(logpart, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
 
         /* Append the log-entry from logpart to the eventlog */
         json_type jso_type = json_object_get_type(logpart);
@@ -196,14 +461,90 @@ loop:
         eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
         goto loop;
 
+    statecase(eventlog->state, IFAPI_EVENTLOG_STATE_PARSING)
+        /* Parse the log line by line; one line contains one event. */
+        r = eventlog_parse_lines(eventlog);
+        return_try_again(r);
+        fclose(eventlog->stream);
+        eventlog->stream = NULL;
+        eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
+        eventlog_free_file_names(eventlog);
+        return_if_error(r, "Parse event log");
+
+        eventlog->pcrListIdx += 1;
+        goto loop;
+
     statecasedefault(eventlog->state);
     }
     return TSS2_RC_SUCCESS;
 }
 
+/** Prepare appending an event to the event log of a PCR.
+ *
+ * Events are appended to the log one line per event. If the PCR only has a
+ * log in the former JSON array format, it is read to be migrated by
+ * ifapi_eventlog_append_finish. The log in the line format is created and
+ * locked until ifapi_eventlog_append_finish has written the event.
+ * Call ifapi_eventlog_append_check afterwards.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ * @param[in,out] io The context area for the asynchronous io module.
+ * @param[in] pcr The PCR register of the event.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the event log can't be locked or read.
+ * @retval TSS2_FAPI_RC_MEMORY if memory allocation failed.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_eventlog_append_async(
+    IFAPI_EVENTLOG *eventlog,
+    IFAPI_IO *io,
+    TPM2_HANDLE pcr)
+{
+    check_not_null(eventlog);
+    check_not_null(io);
+
+    TSS2_RC r;
+    struct stat st;
+
+    eventlog_free_file_names(eventlog);
+    eventlog_unlock(eventlog);
+    r = eventlog_file_names(eventlog, pcr, &eventlog->log_file, &eventlog->legacy_file);
+    return_if_error(r, "Out of memory.");
+
+    /* The lock is held until the event is written, so concurrent writers
+       neither number their events alike nor append during a migration. */
+    r = ifapi_io_open_locked(eventlog->log_file, &eventlog->lock, &st);
+    if (r) {
+        eventlog_free_file_names(eventlog);
+        return_error(r, "Lock event log");
+    }
+
+    if (st.st_size > 0 || !ifapi_io_path_exists(eventlog->legacy_file)) {
+        /* An array log left over by an interrupted migration is outdated. */
+        if (ifapi_io_path_exists(eventlog->legacy_file) &&
+            ifapi_io_remove_file(eventlog->legacy_file)) {
+            LOG_WARNING("Outdated event log %s can't be removed.", eventlog->legacy_file);
+        }
+        SAFE_FREE(eventlog->legacy_file);
+        eventlog->state = IFAPI_EVENTLOG_STATE_APPENDING;
+        return TSS2_RC_SUCCESS;
+    }
+
+    r = ifapi_io_read_async(io, eventlog->legacy_file);
+    if (r) {
+        eventlog_unlock(eventlog);
+        eventlog_free_file_names(eventlog);
+        return_error(r, "Read event log");
+    }
+    eventlog->state = IFAPI_EVENTLOG_STATE_READING;
+
+    return TSS2_RC_SUCCESS;
+}
+
 /** Check event log format before appending an event to the existing event log.
  *
- * Call after ifapi_eventlog_get_async.
+ * Call after ifapi_eventlog_append_async.
  *
  * @param[in,out] eventlog The context area for the eventlog.
  * @param[in,out] io The context area for the asynchronous io module.
@@ -232,23 +573,23 @@ ifapi_eventlog_append_check(
 
     switch (eventlog->state) {
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_APPENDING)
-        /* No old log data can be read. */
-        eventlog->log = json_object_new_array();
-        return_if_null(eventlog->log, "Out of memory", TSS2_FAPI_RC_MEMORY);
+        /* The new event will be appended without reading the log. */
+        eventlog->log = NULL;
 
         return TSS2_RC_SUCCESS;
 
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_READING)
-        /* Finish the reading of the eventlog file and return it directly to the output parameter */
+        /* Finish the reading of the array log which will be migrated */
         r = ifapi_io_read_finish(io, (uint8_t **)&logstr, NULL);
         return_try_again(r);
-        return_if_error(r, "read_finish failed");
+        goto_if_error(r, "read_finish failed", error_cleanup);
 
         /* If a log was read, we deserialize it to JSON. Otherwise we start a new log. */
         if (logstr) {
             eventlog->log = json_tokener_parse(logstr);
             SAFE_FREE(logstr);
-            return_if_null(eventlog->log, "JSON parsing error", TSS2_FAPI_RC_BAD_VALUE);
+            goto_if_null2(eventlog->log, "JSON parsing error", r,
+                          TSS2_FAPI_RC_BAD_VALUE, error_cleanup);
 
              /* libjson-c does not deliver an array if array has only one element */
             json_type jso_type = json_object_get_type(eventlog->log);
@@ -259,7 +600,8 @@ ifapi_eventlog_append_check(
             }
         } else {
             eventlog->log = json_object_new_array();
-            return_if_null(eventlog->log, "Out of memory", TSS2_FAPI_RC_MEMORY);
+            goto_if_null2(eventlog->log, "Out of memory", r,
+                          TSS2_FAPI_RC_MEMORY, error_cleanup);
         }
         break;
 
@@ -268,11 +610,21 @@ ifapi_eventlog_append_check(
     eventlog->state = IFAPI_EVENTLOG_STATE_APPENDING;
 
     return TSS2_RC_SUCCESS;
+
+ error_cleanup:
+    eventlog_unlock(eventlog);
+    eventlog_free_file_names(eventlog);
+    return r;
 }
 
 /** Append an event to the existing event log.
  *
- * Call after ifapi_eventlog_get_async.
+ * The event is appended as one line with a single write. The number of
+ * the event is taken from the last record of the log. A log in the former
+ * array format which was read by ifapi_eventlog_append_check is converted
+ * into the line format; the array log is removed afterwards.
+ *
+ * Call after ifapi_eventlog_append_check.
  *
  * @param[in,out] eventlog The context area for the eventlog.
  * @param[in,out] io The context area for the asynchronous io module.
@@ -300,43 +652,99 @@ ifapi_eventlog_append_finish(
     check_not_null(pcr_event);
 
     TSS2_RC r;
-    char *event_log_file = NULL;
-    const char *logstr2 = NULL;
+    char *tmp_file = NULL;
+    char *lines = NULL;
+    size_t length = 0;
     json_object *event = NULL;
+    bool terminated = true;
 
     switch (eventlog->state) {
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_APPENDING)
         eventlog->event = *pcr_event;
 
-        /* Extend the eventlog with the data */
-        eventlog->event.recnum = json_object_array_length(eventlog->log) + 1;
+        /* Determine the number of the new event */
+        if (eventlog->log) {
+            eventlog->event.recnum = json_object_array_length(eventlog->log) + 1;
+        } else {
+            r = eventlog_last_recnum(eventlog->lock, eventlog->log_file,
+                                     &eventlog->event.recnum, &terminated);
+            goto_if_error(r, "Read last event", error_cleanup);
+
+            eventlog->event.recnum += 1;
+        }
 
         r = ifapi_json_IFAPI_EVENT_serialize(&eventlog->event, &event);
         if (r) {
             goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Error serializing event data", error_cleanup);
         }
 
-        json_object_array_add(eventlog->log, event);
-        logstr2 = json_object_to_json_string_ext(eventlog->log, JSON_C_TO_STRING_PRETTY);
+        if (eventlog->log) {
+            /* Convert the array log and the new event into the line format.
+               The converted log is written to a temporary file which replaces
+               the log after writing has finished. */
+            json_object_array_add(eventlog->log, event);
+            event = NULL;
+            for (size_t i = 0; i < json_object_array_length(eventlog->log); i++) {
+                r = eventlog_add_line(&lines, &length,
+                                      json_object_array_get_idx(eventlog->log, i));
+                goto_if_error(r, "Convert event log", error_cleanup);
+            }
 
-        /* Construct the filename for the eventlog file */
-        r = ifapi_asprintf(&event_log_file, "%s/%s%i",
-                           eventlog->log_dir, IFAPI_PCR_LOG_FILE, eventlog->event.pcr);
-        goto_if_error(r, "Create file name", error_cleanup);
+            r = ifapi_asprintf(&tmp_file, "%s%s", eventlog->log_file,
+                               IFAPI_EVENTLOG_TMP_SUFFIX);
+            goto_if_error(r, "Create file name", error_cleanup);
 
-        /* Start writing the eventlog back to disk */
-        r = ifapi_io_write_async(io, event_log_file, (uint8_t *) logstr2, strlen(logstr2));
-        SAFE_FREE(event_log_file);
-        json_object_put(eventlog->log); /* this also frees logstr2 */
-        eventlog->log = NULL;
+            r = ifapi_io_write_async(io, tmp_file, (uint8_t *) lines, length);
+            SAFE_FREE(tmp_file);
+        } else {
+            /* Terminate an incomplete line left by an interrupted write, so
+               the new event starts on a line of its own. */
+            if (!terminated) {
+                lines = strdup("\n");
+                goto_if_null2(lines, "Out of memory", r, TSS2_FAPI_RC_MEMORY,
+                              error_cleanup);
+                length = 1;
+            }
+            r = eventlog_add_line(&lines, &length, event);
+            goto_if_error(r, "Convert event", error_cleanup);
+
+            /* Start appending the event to the eventlog file */
+            r = ifapi_io_append_async(io, eventlog->log_file, (uint8_t *) lines, length);
+        }
+        SAFE_FREE(lines);
         goto_if_error(r, "write_async failed", error_cleanup);
+        if (event)
+            json_object_put(event);
+        event = NULL;
+        eventlog->state = IFAPI_EVENTLOG_STATE_WRITING;
         fallthrough;
 
     statecase(eventlog->state, IFAPI_EVENTLOG_STATE_WRITING)
         /* Finish writing the eventlog */
         r = ifapi_io_write_finish(io);
         return_try_again(r);
-        goto_if_error(r, "read_finish failed", error_cleanup);
+        goto_if_error(r, "write_finish failed", error_cleanup);
+
+        if (eventlog->log) {
+            /* Replace the array log by the converted log. */
+            r = ifapi_asprintf(&tmp_file, "%s%s", eventlog->log_file,
+                               IFAPI_EVENTLOG_TMP_SUFFIX);
+            goto_if_error(r, "Create file name", error_cleanup);
+
+            if (rename(tmp_file, eventlog->log_file)) {
+                goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Rename %s to %s", error_cleanup,
+                           tmp_file, eventlog->log_file);
+            }
+            SAFE_FREE(tmp_file);
+            if (ifapi_io_remove_file(eventlog->legacy_file)) {
+                LOG_WARNING("Outdated event log %s can't be removed.",
+                            eventlog->legacy_file);
+            }
+            json_object_put(eventlog->log);
+            eventlog->log = NULL;
+        }
+        eventlog_unlock(eventlog);
+        eventlog_free_file_names(eventlog);
 
         eventlog->state = IFAPI_EVENTLOG_STATE_INIT;
         break;
@@ -347,13 +755,39 @@ ifapi_eventlog_append_finish(
     return TSS2_RC_SUCCESS;
 
  error_cleanup:
-    SAFE_FREE(event_log_file);
+    SAFE_FREE(tmp_file);
+    SAFE_FREE(lines);
+    if (event)
+        json_object_put(event);
     if (eventlog->log)
         json_object_put(eventlog->log);
+    eventlog->log = NULL;
+    eventlog_unlock(eventlog);
+    eventlog_free_file_names(eventlog);
     return r;
 }
 
 
+/** Free the resources of the eventlog module.
+ *
+ * @param[in,out] eventlog The context area for the eventlog.
+ */
+void
+ifapi_eventlog_cleanup(IFAPI_EVENTLOG *eventlog)
+{
+    if (eventlog->stream) {
+        fclose(eventlog->stream);
+        eventlog->stream = NULL;
+    }
+    eventlog_unlock(eventlog);
+    if (eventlog->log) {
+        json_object_put(eventlog->log);
+        eventlog->log = NULL;
+    }
+    SAFE_FREE(eventlog->log_dir);
+    eventlog_free_file_names(eventlog);
+}
+
 /** Free allocated memory for an ifapi event.
  *
  * @param[in,out] event The structure to be cleaned up.
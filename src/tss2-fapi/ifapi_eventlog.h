@@ -6,6 +6,7 @@
 #ifndef IFAPI_EVENTLOG_H
 #define IFAPI_EVENTLOG_H
 
+#include <stdio.h>
 #include <json-c/json.h>
 
 #include "tss2_tpm2_types.h"
@@ -52,7 +53,8 @@ enum IFAPI_EVENTLOG_STATE {
     IFAPI_EVENTLOG_STATE_INIT = 0,
     IFAPI_EVENTLOG_STATE_READING,
     IFAPI_EVENTLOG_STATE_APPENDING,
-    IFAPI_EVENTLOG_STATE_WRITING
+    IFAPI_EVENTLOG_STATE_WRITING,
+    IFAPI_EVENTLOG_STATE_PARSING
 };
 
 typedef struct IFAPI_EVENTLOG {
@@ -63,6 +65,10 @@ typedef struct IFAPI_EVENTLOG {
     size_t pcrListSize;
     size_t pcrListIdx;
     json_object *log;
+    char *log_file;            /**< The event log of the current PCR (one event per line) */
+    char *legacy_file;         /**< The event log of the current PCR in the JSON array format */
+    FILE *stream;              /**< The event log being parsed line by line */
+    FILE *lock;                /**< The locked event log while an event is appended */
 } IFAPI_EVENTLOG;
 
 TSS2_RC
@@ -83,6 +89,12 @@ ifapi_eventlog_get_finish(
     IFAPI_IO *io,
     char **log);
 
+TSS2_RC
+ifapi_eventlog_append_async(
+    IFAPI_EVENTLOG *eventlog,
+    IFAPI_IO *io,
+    TPM2_HANDLE pcr);
+
 TSS2_RC
 ifapi_eventlog_append_check(
     IFAPI_EVENTLOG *eventlog,
@@ -98,4 +110,8 @@ void
 ifapi_cleanup_event(
     IFAPI_EVENT * event);
 
+void
+ifapi_eventlog_cleanup(
+    IFAPI_EVENTLOG *eventlog);
+
 #endif /* IFAPI_EVENTLOG_H */
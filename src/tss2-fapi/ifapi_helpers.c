@@ -2097,8 +2097,14 @@ error_cleanup:
  * to this event list. The PCR digest for these PCRs is computed and compared
  * with the attest passed with quote_info.
  *
+ * If a replay cache is passed, the PCR values computed from the event list
+ * are stored as checkpoint. If the event list starts with the events of a
+ * checkpoint with the same PCR selection, only the events added since then
+ * are replayed.
+ *
  * @param[in]  jso_event_list The event list in JSON representation.
  * @param[in]  quote_info The information structure with the attest.
+ * @param[in,out] cache The replay cache; allocated on first use. (Can be NULL)
  * @param[out] pcr_digest The computed pcr_digest for the PCRs uses by FAPI.
  *
  * @retval TSS2_RC_SUCCESS: If the PCR digest from the event list matches
@@ -2115,20 +2121,19 @@ TSS2_RC
 ifapi_calculate_pcr_digest(
     json_object *jso_event_list,
     const FAPI_QUOTE_INFO *quote_info,
+    IFAPI_PCR_REPLAY_CACHE **cache,
     TPM2B_DIGEST *pcr_digest)
 {
     TSS2_RC r;
     IFAPI_CRYPTO_CONTEXT_BLOB *cryptoContext = NULL;
+    IFAPI_PCR_CHECKPOINT *checkpoint = NULL;
 
-    struct {
-        TPMI_ALG_HASH bank;
-        TPM2_HANDLE pcr;
-        TPM2B_DIGEST value;
-    } pcrs[TPM2_MAX_PCRS];
+    IFAPI_VPCR pcrs[TPM2_MAX_PCRS];
     size_t i, pcr, i_evt, hash_size, n_pcrs = 0, n_events = 0;
+    size_t n_replayed = 0;
 
     json_object *jso;
-    IFAPI_EVENT event;
+    IFAPI_EVENT event = { 0 };
 
     const TPML_PCR_SELECTION *pcr_selection;
     TPMI_ALG_HASH pcr_digest_hash_alg;
@@ -2171,7 +2176,20 @@ ifapi_calculate_pcr_digest(
     /* Compute pcr values based on event list */
     if (jso_event_list) {
         n_events = json_object_array_length(jso_event_list);
-        for (i_evt = 0; i_evt < n_events; i_evt++) {
+
+        if (cache && n_events > 0) {
+            if (!*cache) {
+                *cache = calloc(1, sizeof(IFAPI_PCR_REPLAY_CACHE));
+                goto_if_null2(*cache, "Out of memory", r, TSS2_FAPI_RC_MEMORY,
+                              error_cleanup);
+            }
+            ifapi_pcr_replay_lookup(*cache, jso_event_list, &pcrs[0], n_pcrs,
+                                    &checkpoint);
+            if (checkpoint)
+                n_replayed = checkpoint->n_events;
+        }
+
+        for (i_evt = n_replayed; i_evt < n_events; i_evt++) {
             jso = json_object_array_get_idx(jso_event_list, i_evt);
             r = ifapi_json_IFAPI_EVENT_deserialize(jso, &event);
             goto_if_error(r, "Error serialize policy", error_cleanup);
@@ -2184,6 +2202,12 @@ ifapi_calculate_pcr_digest(
             }
             ifapi_cleanup_event(&event);
         }
+
+        if (cache && n_events > 0) {
+            r = ifapi_pcr_replay_store(*cache, checkpoint, jso_event_list,
+                                       &pcrs[0], n_pcrs);
+            goto_if_error(r, "Store replay checkpoint", error_cleanup);
+        }
     }
 
     /* Compute digest for the used pcrs */
@@ -163,6 +163,7 @@ ifapi_filter_pcr_selection_by_index(
 TSS2_RC ifapi_calculate_pcr_digest(
     json_object *jso_event_list,
     const FAPI_QUOTE_INFO *quote_info,
+    IFAPI_PCR_REPLAY_CACHE **cache,
     TPM2B_DIGEST *pcr_digest);
 
 TSS2_RC
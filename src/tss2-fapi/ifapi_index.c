@@ -0,0 +1,948 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "ifapi_index.h"
+#include "ifapi_io.h"
+#include "ifapi_helpers.h"
+#include "ifapi_macros.h"
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * The index is a text file with one record per line. A record either adds
+ * a path together with the keys it can be found by, or removes a path:
+ *
+ *   # complete 4096
+ *   + /P_RSA/HS/SRK/myKey name:000b1234... policy:a1b2...
+ *   - /P_RSA/HS/SRK/myKey
+ *
+ * Records are only appended, a later record for a path supersedes all
+ * earlier ones. Lines without a terminating newline stem from interrupted
+ * writes, they are ignored by readers and removed by the next writer.
+ *
+ * The optional header line is written whenever the file is replaced. It
+ * states whether the index covers all objects of the store ("complete",
+ * written after a full scan) or only the objects stored since the index
+ * was created ("partial") and the size of the records written with it.
+ *
+ * Records written with the name of the object file carry the key
+ * "file:<inode>.<size>.<ctime>" of the file at the time the record was
+ * written. A record is only trusted to describe the current object if the
+ * file still has this key. Objects copied into the store without FAPI,
+ * objects stored by another user in the system directory and objects
+ * replaced in place thus have no trusted record. A search which finds no
+ * candidate in a complete index reads exactly these objects, see
+ * ifapi_index_unindexed().
+ *
+ * Once the appended records have grown the file to twice this size (and
+ * at least IFAPI_INDEX_COMPACT_SIZE), the next append replaces the file
+ * with the live records only. Writers serialize via lockf() on the index
+ * file and reopen the file if it was replaced while they were waiting.
+ */
+
+/** Minimum size of the index file before it is compacted. */
+#define IFAPI_INDEX_COMPACT_SIZE (64 * 1024)
+
+/** Check whether a string can be stored as part of an index record.
+ *
+ * @param[in] str The path or key to be checked.
+ * @retval true if the string contains no whitespace.
+ * @retval false otherwise.
+ */
+static bool
+index_token_valid(const char *str)
+{
+    return str[0] != '\0' && strpbrk(str, " \t\r\n") == NULL;
+}
+
+/** Parse the header line of an index.
+ *
+ * @param[in] buffer The beginning of the index file.
+ * @param[out] complete true if the index covers all objects of the store.
+ * @param[out] compacted The size of the records when the file was written last.
+ */
+static void
+index_parse_header(const char *buffer, bool *complete, long *compacted)
+{
+    char kind[16];
+
+    *complete = false;
+    *compacted = 0;
+    if (sscanf(buffer, "# %15s %li", &kind[0], compacted) != 2) {
+        *compacted = 0;
+        return;
+    }
+    *complete = (strcmp(&kind[0], "complete") == 0);
+}
+
+/** Read the content of an index stream starting at a certain offset.
+ *
+ * @param[in] stream The opened index file.
+ * @param[in] offset The offset where reading starts.
+ * @param[out] buffer The content of the file. (callee-allocated)
+ * @param[out] length The number of bytes read.
+ * @retval TSS2_RC_SUCCESS if the file was read.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the file could not be read.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+index_read_stream(FILE *stream, long offset, char **buffer, long *length)
+{
+    long end;
+
+    *buffer = NULL;
+    if (fseek(stream, 0L, SEEK_END) != 0 || (end = ftell(stream)) < 0 ||
+        end < offset || fseek(stream, offset, SEEK_SET) != 0) {
+        return_error(TSS2_FAPI_RC_IO_ERROR, "Index could not be read.");
+    }
+
+    *buffer = malloc(end - offset + 1);
+    if (*buffer == NULL) {
+        LOG_ERROR("Memory could not be allocated. %li bytes requested",
+                  end - offset + 1);
+        return TSS2_FAPI_RC_MEMORY;
+    }
+    *length = fread(*buffer, 1, end - offset, stream);
+    (*buffer)[*length] = '\0';
+    return TSS2_RC_SUCCESS;
+}
+
+/** Split the next complete record of an index buffer.
+ *
+ * The record is terminated with '\0' in place.
+ *
+ * @param[in,out] pos The current position in the buffer, will be moved to
+ *                the next record.
+ * @param[out] op The operation of the record ('+' or '-').
+ * @param[out] path The path of the record.
+ * @param[out] keys The space separated keys of the record (may be empty).
+ * @retval true if a record was found.
+ * @retval false if the end of the buffer was reached.
+ */
+static bool
+index_next_record(char **pos, char *op, char **path, char **keys)
+{
+    char *line, *end, *sep;
+
+    while (**pos != '\0') {
+        line = *pos;
+        end = strchr(line, '\n');
+        if (end == NULL) {
+            /* Incomplete last record. */
+            *pos += strlen(line);
+            return false;
+        }
+        *end = '\0';
+        *pos = end + 1;
+
+        if ((line[0] != '+' && line[0] != '-') || line[1] != ' ' || line[2] == '\0')
+            continue;
+        *op = line[0];
+        *path = &line[2];
+        sep = strchr(*path, ' ');
+        if (sep) {
+            *sep = '\0';
+            *keys = sep + 1;
+        } else {
+            *keys = end;
+        }
+        return true;
+    }
+    return false;
+}
+
+/** Check whether a key is contained in the key list of a record.
+ *
+ * @param[in] keys The space separated key list.
+ * @param[in] key The key to search.
+ * @retval true if the key is contained in the list.
+ * @retval false otherwise.
+ */
+static bool
+index_keys_contain(const char *keys, const char *key)
+{
+    size_t key_len = strlen(key);
+    const char *pos = keys;
+
+    while ((pos = strstr(pos, key)) != NULL) {
+        if ((pos == keys || pos[-1] == ' ')
+                && (pos[key_len] == ' ' || pos[key_len] == '\0'))
+            return true;
+        pos += key_len;
+    }
+    return false;
+}
+
+/** Compute the key identifying the current version of an object file.
+ *
+ * Every change of the file by a write, a rename or a copy changes its
+ * inode change time, its size or its inode.
+ *
+ * @param[in] file The name of the object file.
+ * @param[out] key The buffer for the key.
+ * @param[in] size The size of the buffer.
+ * @retval true if the key was computed.
+ * @retval false if the file could not be accessed.
+ */
+static bool
+index_file_key(const char *file, char *key, size_t size)
+{
+    struct stat st;
+
+    if (stat(file, &st) != 0)
+        return false;
+    snprintf(key, size, "file:%jx.%jx.%jx.%lx", (uintmax_t)st.st_ino,
+             (uintmax_t)st.st_size, (uintmax_t)st.st_ctim.tv_sec,
+             (long)st.st_ctim.tv_nsec);
+    return true;
+}
+
+/** Replace the index file.
+ *
+ * The header and the passed parts are written to a temporary file which
+ * is renamed afterwards, thus readers either see the old or the new index.
+ * The caller has to hold the lock of the current index file.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] complete true if the records cover all objects of the store.
+ * @param[in] records The first part of the records (may be NULL).
+ * @param[in] tail The second part of the records (may be NULL).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be written.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+index_replace(
+    const char *index_file,
+    bool complete,
+    const char *records,
+    const char *tail)
+{
+    TSS2_RC r;
+    FILE *stream;
+    char *tmp_file = NULL;
+    char header[64];
+    size_t records_len = records ? strlen(records) : 0;
+    size_t tail_len = tail ? strlen(tail) : 0;
+    size_t header_len;
+
+    header_len = (size_t)snprintf(&header[0], sizeof(header), "# %s %zu\n",
+                                  complete ? "complete" : "partial",
+                                  records_len + tail_len);
+
+    r = ifapi_asprintf(&tmp_file, "%s.%li", index_file, (long)getpid());
+    return_if_error(r, "Out of memory.");
+
+    stream = fopen(tmp_file, "wt");
+    goto_if_null2(stream, "Index %s could not be created.", r, TSS2_FAPI_RC_IO_ERROR,
+                  cleanup, tmp_file);
+
+    if (fwrite(&header[0], 1, header_len, stream) != header_len ||
+        fwrite(records ? records : "", 1, records_len, stream) != records_len ||
+        fwrite(tail ? tail : "", 1, tail_len, stream) != tail_len) {
+        fclose(stream);
+        remove(tmp_file);
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Index %s could not be written.",
+                   cleanup, tmp_file);
+    }
+    if (fclose(stream) != 0) {
+        remove(tmp_file);
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Index %s could not be written.",
+                   cleanup, tmp_file);
+    }
+    if (rename(tmp_file, index_file) != 0) {
+        remove(tmp_file);
+        goto_error(r, TSS2_FAPI_RC_IO_ERROR, "Index %s could not be replaced.",
+                   cleanup, index_file);
+    }
+
+cleanup:
+    SAFE_FREE(tmp_file);
+    return r;
+}
+
+/** Order index records by path and position in the file. */
+struct index_rec {
+    const char *path;
+    const char *keys;
+    size_t pos;
+    char op;
+};
+
+static int
+index_rec_cmp(const void *a, const void *b)
+{
+    const struct index_rec *ra = a, *rb = b;
+    int c = strcmp(ra->path, rb->path);
+
+    if (c != 0)
+        return c;
+    return (ra->pos > rb->pos) - (ra->pos < rb->pos);
+}
+
+/** Split the records of an index and order them by path.
+ *
+ * @param[in,out] buffer The records of the index, will be modified.
+ * @param[out] records The records ordered by path and position in the
+ *             file. (callee-allocated; NULL if there are no records)
+ * @param[out] num_records The number of records.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+index_collect(char *buffer, struct index_rec **records, size_t *num_records)
+{
+    struct index_rec *recs = NULL, *new_recs;
+    size_t num_recs = 0, max_recs = 0;
+    char *pos = buffer, *path, *keys;
+    char op;
+
+    while (index_next_record(&pos, &op, &path, &keys)) {
+        if (num_recs == max_recs) {
+            max_recs = max_recs ? 2 * max_recs : 64;
+            new_recs = realloc(recs, max_recs * sizeof(*recs));
+            if (!new_recs) {
+                SAFE_FREE(recs);
+                return_error(TSS2_FAPI_RC_MEMORY, "Out of memory.");
+            }
+            recs = new_recs;
+        }
+        recs[num_recs].path = path;
+        recs[num_recs].keys = keys;
+        recs[num_recs].pos = num_recs;
+        recs[num_recs].op = op;
+        num_recs += 1;
+    }
+    if (num_recs > 1)
+        qsort(recs, num_recs, sizeof(*recs), index_rec_cmp);
+
+    *records = recs;
+    *num_records = num_recs;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Find the record of a path which supersedes all others.
+ *
+ * @param[in] recs The records ordered by index_collect().
+ * @param[in] num_recs The number of records.
+ * @param[in] path The path to be searched.
+ * @retval The last record of the path if it adds the path.
+ * @retval NULL if the index has no record of the path or the path was removed.
+ */
+static const struct index_rec *
+index_find_live(const struct index_rec *recs, size_t num_recs, const char *path)
+{
+    size_t low = 0, high = num_recs, mid;
+
+    /* Find the position behind the last record of the path. */
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (strcmp(recs[mid].path, path) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0 || strcmp(recs[low - 1].path, path) != 0 || recs[low - 1].op != '+')
+        return NULL;
+    return &recs[low - 1];
+}
+
+/** Reduce the records of an index to the live records.
+ *
+ * @param[in,out] buffer The records of the index, will be modified.
+ * @param[out] live The live records. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+index_compact(char *buffer, char **live)
+{
+    TSS2_RC r;
+    struct index_rec *recs = NULL;
+    size_t num_recs = 0, i, offset = 0;
+    size_t buffer_len = strlen(buffer);
+
+    *live = NULL;
+    r = index_collect(buffer, &recs, &num_recs);
+    return_if_error(r, "Collect index records.");
+
+    /* The live records can't be larger than the complete index. */
+    *live = malloc(buffer_len + 1);
+    if (!*live) {
+        SAFE_FREE(recs);
+        return_error(TSS2_FAPI_RC_MEMORY, "Out of memory.");
+    }
+    (*live)[0] = '\0';
+    for (i = 0; i < num_recs; i++) {
+        /* Only the last record of a path counts. */
+        if (i + 1 < num_recs && strcmp(recs[i].path, recs[i + 1].path) == 0)
+            continue;
+        if (recs[i].op != '+')
+            continue;
+        offset += sprintf(&(*live)[offset], "+ %s %s\n", recs[i].path, recs[i].keys);
+    }
+    SAFE_FREE(recs);
+    return TSS2_RC_SUCCESS;
+}
+
+/** Remove an incomplete last record from a locked index file.
+ *
+ * @param[in] fd The file descriptor of the locked index file.
+ * @param[in] size The size of the file.
+ * @retval 0 on success.
+ * @retval -1 if the file could not be read or truncated.
+ */
+static int
+index_truncate_incomplete(int fd, off_t size)
+{
+    char chunk[256];
+    off_t end = size, start;
+    ssize_t n;
+
+    while (end > 0) {
+        start = end > (off_t)sizeof(chunk) ? end - (off_t)sizeof(chunk) : 0;
+        n = pread(fd, &chunk[0], end - start, start);
+        if (n != end - start)
+            return -1;
+        while (n > 0 && chunk[n - 1] != '\n')
+            n--;
+        if (n > 0) {
+            end = start + n;
+            break;
+        }
+        end = start;
+    }
+    if (end == size)
+        return 0;
+    return ftruncate(fd, end);
+}
+
+/** Append one record to the index file.
+ *
+ * The index is not read, except for its header if the file has grown
+ * beyond IFAPI_INDEX_COMPACT_SIZE. In this case the index is compacted
+ * once it is twice as large as after the last rewrite.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] record The record including the terminating newline.
+ * @retval TSS2_RC_SUCCESS if the record was appended.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be written.
+ */
+static TSS2_RC
+index_append(const char *index_file, const char *record)
+{
+    TSS2_RC r;
+    FILE *stream;
+    struct stat st;
+    size_t length = strlen(record);
+    char header[64] = { 0 };
+    char *buffer = NULL, *live = NULL;
+    long size, compacted;
+    bool complete;
+
+    r = ifapi_io_open_locked(index_file, &stream, &st);
+    return_if_error(r, "Open index.");
+
+    /* Drop a record left incomplete by an interrupted write. */
+    if (st.st_size > 0 && index_truncate_incomplete(fileno(stream), st.st_size) != 0) {
+        fclose(stream);
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be written.",
+                      index_file);
+    }
+    if (fwrite(record, 1, length, stream) != length || fflush(stream) != 0 ||
+        fseek(stream, 0L, SEEK_END) != 0 || (size = ftell(stream)) < 0) {
+        fclose(stream);
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be written.",
+                      index_file);
+    }
+
+    if (size >= IFAPI_INDEX_COMPACT_SIZE) {
+        rewind(stream);
+        if (!fgets(&header[0], sizeof(header), stream))
+            header[0] = '\0';
+        index_parse_header(&header[0], &complete, &compacted);
+        if (size > 2 * compacted) {
+            /* The index only speeds up searching, thus errors are not fatal. */
+            r = index_read_stream(stream, 0, &buffer, &size);
+            if (r == TSS2_RC_SUCCESS)
+                r = index_compact(buffer, &live);
+            if (r == TSS2_RC_SUCCESS)
+                r = index_replace(index_file, complete, live, NULL);
+            if (r != TSS2_RC_SUCCESS)
+                LOG_WARNING("Index %s could not be compacted.", index_file);
+            SAFE_FREE(buffer);
+            SAFE_FREE(live);
+        }
+    }
+    if (fclose(stream) != 0) {
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be written.",
+                      index_file);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Append a typed key to a key list.
+ *
+ * The key is formatted as "<type>:<hex value>" and appended to the space
+ * separated key list.
+ *
+ * @param[in,out] keys The key list. (callee-allocated; may be NULL initially)
+ * @param[in] type The type prefix of the key, e.g. "name".
+ * @param[in] buffer The binary value of the key.
+ * @param[in] size The size of the buffer.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an empty key is passed.
+ */
+TSS2_RC
+ifapi_index_add_key(
+    char **keys,
+    const char *type,
+    const uint8_t *buffer,
+    size_t size)
+{
+    size_t old_len, type_len, i;
+    char *new_keys;
+
+    if (size == 0) {
+        return_error2(TSS2_FAPI_RC_BAD_VALUE, "Empty %s key.", type);
+    }
+    old_len = *keys ? strlen(*keys) : 0;
+    type_len = strlen(type);
+
+    /* Separator, type, ':', hex value and '\0'. */
+    new_keys = realloc(*keys, old_len + 1 + type_len + 1 + 2 * size + 1);
+    check_oom(new_keys);
+
+    *keys = new_keys;
+    if (old_len)
+        new_keys[old_len++] = ' ';
+    memcpy(&new_keys[old_len], type, type_len);
+    old_len += type_len;
+    new_keys[old_len++] = ':';
+    for (i = 0; i < size; i++) {
+        sprintf(&new_keys[old_len], "%02x", buffer[i]);
+        old_len += 2;
+    }
+    new_keys[old_len] = '\0';
+    return TSS2_RC_SUCCESS;
+}
+
+/** Append an add record to a buffer of records.
+ *
+ * The buffer can be passed to ifapi_index_rewrite() to create a new index or
+ * to ifapi_index_append() to add the records to the index. If the object
+ * file is passed, its current version is stored with the record. A record
+ * without this key is never trusted by ifapi_index_unindexed(), this is
+ * also the case if the file can't be accessed.
+ *
+ * @param[in,out] records The record buffer. (callee-allocated; may be NULL initially)
+ * @param[in] path The path of the object.
+ * @param[in] file The name of the object file (may be NULL).
+ * @param[in] keys The space separated keys of the object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the path or the keys can't be stored.
+ */
+TSS2_RC
+ifapi_index_add_record(
+    char **records,
+    const char *path,
+    const char *file,
+    const char *keys)
+{
+    size_t old_len, path_len, keys_len, file_key_len = 0;
+    char file_key[80];
+    char *new_records;
+
+    if (!index_token_valid(path) || strchr(keys, '\n')) {
+        return_error2(TSS2_FAPI_RC_BAD_VALUE, "Invalid index record for %s.", path);
+    }
+    if (file && index_file_key(file, &file_key[0], sizeof(file_key)))
+        file_key_len = 1 + strlen(&file_key[0]);
+    old_len = *records ? strlen(*records) : 0;
+    path_len = strlen(path);
+    keys_len = strlen(keys);
+
+    new_records = realloc(*records, old_len + 2 + path_len + 1 + keys_len +
+                          file_key_len + 2);
+    check_oom(new_records);
+
+    *records = new_records;
+    sprintf(&new_records[old_len], "+ %s %s%s%s\n", path, keys,
+            file_key_len ? " " : "", file_key_len ? &file_key[0] : "");
+    return TSS2_RC_SUCCESS;
+}
+
+/** Search all paths stored in the index for a certain key.
+ *
+ * The returned paths are only candidates, the caller has to verify the
+ * objects because the index might be outdated. If no candidate is found
+ * and the index is complete, only the objects without a trusted record
+ * have to be read, see ifapi_index_unindexed().
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] key The key to be searched.
+ * @param[out] paths The array of found paths. (callee-allocated)
+ * @param[out] num_paths The number of found paths. 0 if the index does not
+ *             exist.
+ * @param[out] state The state of the index which has to be passed to
+ *             ifapi_index_rewrite().
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be read.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_lookup(
+    const char *index_file,
+    const char *key,
+    char ***paths,
+    size_t *num_paths,
+    IFAPI_INDEX_STATE *state)
+{
+    TSS2_RC r;
+    FILE *stream;
+    struct stat st;
+    char *buffer, *pos, *path, *keys, **found = NULL, **new_found;
+    size_t num_found = 0, i;
+    long length, compacted;
+    char op;
+
+    check_not_null(index_file);
+    check_not_null(key);
+    check_not_null(paths);
+    check_not_null(num_paths);
+    check_not_null(state);
+
+    *paths = NULL;
+    *num_paths = 0;
+    memset(state, 0, sizeof(*state));
+
+    stream = fopen(index_file, "rt");
+    if (stream == NULL) {
+        if (errno == ENOENT)
+            return TSS2_RC_SUCCESS;
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be opened.",
+                      index_file);
+    }
+    if (fstat(fileno(stream), &st) != 0) {
+        fclose(stream);
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be read.",
+                      index_file);
+    }
+    r = index_read_stream(stream, 0, &buffer, &length);
+    fclose(stream);
+    return_if_error(r, "Read index.");
+
+    state->exists = true;
+    state->dev = st.st_dev;
+    state->ino = st.st_ino;
+    index_parse_header(buffer, &state->complete, &compacted);
+
+    /* Records behind the last newline are still being written. */
+    pos = strrchr(buffer, '\n');
+    state->size = pos ? (long)(pos - buffer) + 1 : 0;
+
+    pos = buffer;
+    while (index_next_record(&pos, &op, &path, &keys)) {
+        for (i = 0; i < num_found; i++) {
+            if (strcmp(found[i], path) == 0)
+                break;
+        }
+        if (op == '+' && index_keys_contain(keys, key)) {
+            if (i < num_found)
+                continue;
+            new_found = realloc(found, (num_found + 1) * sizeof(char *));
+            goto_if_null2(new_found, "Out of memory.", r, TSS2_FAPI_RC_MEMORY,
+                          error_cleanup);
+            found = new_found;
+            found[num_found] = strdup(path);
+            goto_if_null2(found[num_found], "Out of memory.", r, TSS2_FAPI_RC_MEMORY,
+                          error_cleanup);
+            num_found += 1;
+        } else if (i < num_found) {
+            /* The path was removed or does not have the key anymore. */
+            free(found[i]);
+            found[i] = found[--num_found];
+        }
+    }
+    SAFE_FREE(buffer);
+    if (num_found == 0)
+        SAFE_FREE(found);
+    *paths = found;
+    *num_paths = num_found;
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    for (i = 0; i < num_found; i++)
+        free(found[i]);
+    SAFE_FREE(found);
+    SAFE_FREE(buffer);
+    memset(state, 0, sizeof(*state));
+    return r;
+}
+
+/** Remove the paths with a trusted record from a list of paths.
+ *
+ * A record is trusted if it is the last record of the path, adds the path
+ * and the object file still has the version stored with the record. If
+ * the index is complete, the objects of the remaining paths are the only
+ * objects of the store which can have keys not found by
+ * ifapi_index_lookup(). These are objects copied into the store without
+ * FAPI, objects stored by another user in the system directory and
+ * objects replaced in place. The list is not changed if the index is not
+ * complete.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] object_file The function computing the object file of a path.
+ * @param[in] ctx The context passed to object_file.
+ * @param[in,out] paths The paths of all objects of the store. The paths
+ *                with a trusted record are freed and removed.
+ * @param[in,out] num_paths The number of paths.
+ * @param[out] complete true if the index is complete and the list was reduced.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be read.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_unindexed(
+    const char *index_file,
+    ifapi_index_object_file object_file,
+    void *ctx,
+    char **paths,
+    size_t *num_paths,
+    bool *complete)
+{
+    TSS2_RC r;
+    FILE *stream;
+    char *buffer = NULL, *file;
+    char file_key[80];
+    struct index_rec *recs = NULL;
+    const struct index_rec *rec;
+    size_t num_recs = 0, i, kept = 0;
+    bool *trusted = NULL;
+    long length, compacted;
+
+    check_not_null(index_file);
+    check_not_null(object_file);
+    check_not_null(num_paths);
+    check_not_null(complete);
+
+    *complete = false;
+    stream = fopen(index_file, "rt");
+    if (stream == NULL) {
+        if (errno == ENOENT)
+            return TSS2_RC_SUCCESS;
+        return_error2(TSS2_FAPI_RC_IO_ERROR, "Index %s could not be opened.",
+                      index_file);
+    }
+    r = index_read_stream(stream, 0, &buffer, &length);
+    fclose(stream);
+    return_if_error(r, "Read index.");
+
+    index_parse_header(buffer, complete, &compacted);
+    if (!*complete || *num_paths == 0)
+        goto cleanup;
+
+    r = index_collect(buffer, &recs, &num_recs);
+    goto_if_error(r, "Collect index records.", cleanup);
+
+    /* The list is only changed if all paths could be checked. */
+    trusted = calloc(*num_paths, sizeof(bool));
+    goto_if_null2(trusted, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, cleanup);
+
+    for (i = 0; i < *num_paths; i++) {
+        rec = index_find_live(recs, num_recs, paths[i]);
+        if (!rec)
+            continue;
+        file = NULL;
+        if (object_file(ctx, paths[i], &file) == TSS2_RC_SUCCESS &&
+            index_file_key(file, &file_key[0], sizeof(file_key)))
+            trusted[i] = index_keys_contain(rec->keys, &file_key[0]);
+        SAFE_FREE(file);
+    }
+    for (i = 0; i < *num_paths; i++) {
+        if (trusted[i]) {
+            SAFE_FREE(paths[i]);
+        } else {
+            paths[kept++] = paths[i];
+        }
+    }
+    *num_paths = kept;
+
+cleanup:
+    if (r != TSS2_RC_SUCCESS)
+        *complete = false;
+    SAFE_FREE(trusted);
+    SAFE_FREE(recs);
+    SAFE_FREE(buffer);
+    return r;
+}
+
+/** Store the keys of a path in the index.
+ *
+ * The record is appended without reading the index.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] path The path of the object.
+ * @param[in] file The name of the object file (may be NULL), see
+ *            ifapi_index_add_record().
+ * @param[in] keys The space separated keys of the object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be read or written.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the path or the keys can't be stored.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_update(
+    const char *index_file,
+    const char *path,
+    const char *file,
+    const char *keys)
+{
+    TSS2_RC r;
+    char *record = NULL;
+
+    check_not_null(index_file);
+    check_not_null(path);
+    check_not_null(keys);
+
+    r = ifapi_index_add_record(&record, path, file, keys);
+    return_if_error(r, "Create index record.");
+
+    r = index_append(index_file, record);
+    SAFE_FREE(record);
+    return r;
+}
+
+/** Append records collected with ifapi_index_add_record() to the index.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] records The records to be appended (may be NULL).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be read or written.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_append(
+    const char *index_file,
+    const char *records)
+{
+    check_not_null(index_file);
+
+    if (!records || records[0] == '\0')
+        return TSS2_RC_SUCCESS;
+    return index_append(index_file, records);
+}
+
+/** Remove a path from the index.
+ *
+ * The record is appended without reading the index.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] path The path of the removed object.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be read or written.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the path can't be stored.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_remove(
+    const char *index_file,
+    const char *path)
+{
+    TSS2_RC r;
+    char *record = NULL;
+
+    check_not_null(index_file);
+    check_not_null(path);
+
+    if (!index_token_valid(path)) {
+        return_error2(TSS2_FAPI_RC_BAD_VALUE, "Invalid index path %s.", path);
+    }
+
+    r = ifapi_asprintf(&record, "- %s\n", path);
+    return_if_error(r, "Out of memory.");
+
+    r = index_append(index_file, record);
+    SAFE_FREE(record);
+    return r;
+}
+
+/** Replace the index file with the records of a full scan.
+ *
+ * The records collected by a scan of the complete store form a complete
+ * index. Records appended by other writers since the index was read with
+ * ifapi_index_lookup() are kept behind the new records, thus they still
+ * supersede them. If the index was replaced in the meantime, the current
+ * records are kept as well but the index is not marked as complete.
+ *
+ * @param[in] index_file The name of the index file.
+ * @param[in] records The records created with ifapi_index_add_record() (may be NULL).
+ * @param[in] state The state returned by ifapi_index_lookup() before the scan.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the index could not be written.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_index_rewrite(
+    const char *index_file,
+    const char *records,
+    const IFAPI_INDEX_STATE *state)
+{
+    TSS2_RC r;
+    FILE *stream;
+    struct stat st;
+    char *tail = NULL, *end;
+    long offset = 0, length;
+    bool complete;
+
+    check_not_null(index_file);
+    check_not_null(state);
+
+    r = ifapi_io_open_locked(index_file, &stream, &st);
+    return_if_error(r, "Open index.");
+
+    if (!state->exists) {
+        /* Everything in the index was appended after the scan started. */
+        complete = true;
+    } else if (st.st_dev == state->dev && st.st_ino == state->ino &&
+               st.st_size >= state->size) {
+        complete = true;
+        offset = state->size;
+    } else {
+        complete = false;
+    }
+
+    r = index_read_stream(stream, offset, &tail, &length);
+    if (r == TSS2_RC_SUCCESS && length > 0 && tail[length - 1] != '\n') {
+        /* Drop a record left incomplete by an interrupted write. */
+        end = strrchr(tail, '\n');
+        if (end)
+            end[1] = '\0';
+        else
+            tail[0] = '\0';
+    }
+    if (r == TSS2_RC_SUCCESS)
+        r = index_replace(index_file, complete, records, tail);
+    fclose(stream);
+    SAFE_FREE(tail);
+    return r;
+}
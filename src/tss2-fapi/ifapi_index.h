@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef IFAPI_INDEX_H
+#define IFAPI_INDEX_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "tss2_common.h"
+#include "tss2_tpm2_types.h"
+
+/** Name of the index file stored in the root of a keystore directory.
+ *
+ * The leading dot keeps the file out of the keystore listings.
+ */
+#define IFAPI_INDEX_FILE ".index"
+
+/** The state of an index file as seen by ifapi_index_lookup().
+ *
+ * The state is needed to detect records appended by other writers before
+ * the index is rewritten after a full scan.
+ */
+typedef struct {
+    bool exists;                    /**< The index file existed */
+    bool complete;                  /**< The index covers all objects of the store */
+    dev_t dev;                      /**< The device of the index file */
+    ino_t ino;                      /**< The inode of the index file */
+    long size;                      /**< The size of the complete records read */
+} IFAPI_INDEX_STATE;
+
+/** Compute the name of the file of an object in the store.
+ *
+ * @param[in] ctx The context of the store.
+ * @param[in] path The path of the object used in the index.
+ * @param[out] file The name of the object file. (callee-allocated)
+ */
+typedef TSS2_RC (*ifapi_index_object_file)(
+    void *ctx,
+    const char *path,
+    char **file);
+
+TSS2_RC
+ifapi_index_add_key(
+    char **keys,
+    const char *type,
+    const uint8_t *buffer,
+    size_t size);
+
+TSS2_RC
+ifapi_index_add_record(
+    char **records,
+    const char *path,
+    const char *file,
+    const char *keys);
+
+TSS2_RC
+ifapi_index_lookup(
+    const char *index_file,
+    const char *key,
+    char ***paths,
+    size_t *num_paths,
+    IFAPI_INDEX_STATE *state);
+
+TSS2_RC
+ifapi_index_update(
+    const char *index_file,
+    const char *path,
+    const char *file,
+    const char *keys);
+
+TSS2_RC
+ifapi_index_append(
+    const char *index_file,
+    const char *records);
+
+TSS2_RC
+ifapi_index_unindexed(
+    const char *index_file,
+    ifapi_index_object_file object_file,
+    void *ctx,
+    char **paths,
+    size_t *num_paths,
+    bool *complete);
+
+TSS2_RC
+ifapi_index_remove(
+    const char *index_file,
+    const char *path);
+
+TSS2_RC
+ifapi_index_rewrite(
+    const char *index_file,
+    const char *records,
+    const IFAPI_INDEX_STATE *state);
+
+#endif /* IFAPI_INDEX_H */
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -30,7 +31,122 @@
 #include "util/log.h"
 #include "util/aux_util.h"
 
+/** Maximum number of attempts to lock a file that is replaced concurrently. */
+#define IFAPI_IO_LOCK_RETRIES 8
+
+/** Find a file read ahead by ifapi_io_read_batch.
+ *
+ * @param[in] io The input/output context being used for file I/O.
+ * @param[in] filename The name of the file.
+ * @retval The batch entry of the file or NULL if the file was not read ahead.
+ */
+static IFAPI_IO_BATCH_ENTRY *
+io_batch_find(struct IFAPI_IO *io, const char *filename)
+{
+    for (size_t i = 0; i < IFAPI_IO_BATCH_SIZE; i++) {
+        if (io->batch[i].path && strcmp(io->batch[i].path, filename) == 0)
+            return &io->batch[i];
+    }
+    return NULL;
+}
+
+static void
+io_batch_drop(IFAPI_IO_BATCH_ENTRY *entry)
+{
+    SAFE_FREE(entry->path);
+    SAFE_FREE(entry->buffer);
+    entry->length = 0;
+}
+
+/** Start the read engine.
+ *
+ * The file is read with non-blocking reads in ifapi_io_read_finish.
+ */
+static TSS2_RC
+io_read_start(struct IFAPI_IO *io, const char *filename)
+{
+    (void)io;
+    (void)filename;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Read the file with non-blocking reads up to its end.
+ *
+ * @retval TSS2_RC_SUCCESS: if the complete file was read.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if a read failed.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN: if no data is available yet.
+ */
+static TSS2_RC
+io_read_finish(struct IFAPI_IO *io)
+{
+    /* The condition also handles empty files, for which read is not called. */
+    while (io->buffer_idx < io->buffer_length) {
+        ssize_t ret = read(fileno(io->stream),
+                           &io->char_rbuffer[io->buffer_idx],
+                           io->buffer_length - io->buffer_idx);
+        if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+            return TSS2_FAPI_RC_TRY_AGAIN;
+
+        if (ret < 0) {
+            LOG_ERROR("Error reading from file: %i.", errno);
+            return TSS2_FAPI_RC_IO_ERROR;
+        }
+        if (ret == 0) {
+            /* The file was truncated after its size was determined. */
+            io->buffer_length = io->buffer_idx;
+            io->char_rbuffer[io->buffer_length] = '\0';
+            break;
+        }
+        io->buffer_idx += ret;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Start the batch engine.
+ *
+ * The content read ahead by ifapi_io_read_batch is moved into the read
+ * buffer, no file is opened.
+ */
+static TSS2_RC
+io_batch_start(struct IFAPI_IO *io, const char *filename)
+{
+    IFAPI_IO_BATCH_ENTRY *entry = io_batch_find(io, filename);
+
+    return_if_null(entry, "File was not read ahead.", TSS2_FAPI_RC_GENERAL_FAILURE);
+
+    io->stream = NULL;
+    io->char_rbuffer = entry->buffer;
+    io->buffer_length = entry->length;
+    io->buffer_idx = entry->length;
+    entry->buffer = NULL;
+    io_batch_drop(entry);
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+io_batch_finish(struct IFAPI_IO *io)
+{
+    (void)io;
+    return TSS2_RC_SUCCESS;
+}
+
+const IFAPI_IO_ENGINE ifapi_io_engine_read = {
+    .name = "read",
+    .start = io_read_start,
+    .finish = io_read_finish,
+};
+
+const IFAPI_IO_ENGINE ifapi_io_engine_batch = {
+    .name = "batch",
+    .start = io_batch_start,
+    .finish = io_batch_finish,
+};
+
 /** Start reading a file's complete content into memory in an asynchronous way.
+ *
+ * Files read ahead by ifapi_io_read_batch are served by the batch engine.
+ * Other files are opened once, their size is taken from fstat and they are
+ * read by the read engine.
  *
  * @param[in,out] io The input/output context being used for file I/O.
  * @param[in] filename The name of the file to be read into memory.
@@ -43,48 +159,61 @@ ifapi_io_read_async(
     struct IFAPI_IO *io,
     const char *filename)
 {
+    struct stat st;
+    size_t length;
+    int fd;
+
     if (io->char_rbuffer) {
         LOG_ERROR("rbuffer still in use; maybe use of old API.");
         return TSS2_FAPI_RC_IO_ERROR;
     }
 
-    io->stream = fopen(filename, "rt");
-    if (io->stream == NULL) {
+    if (io_batch_find(io, filename)) {
+        io->engine = &ifapi_io_engine_batch;
+        return io->engine->start(io, filename);
+    }
+
+    fd = open(filename, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
         LOG_ERROR("File \"%s\" not found.", filename);
         return TSS2_FAPI_RC_IO_ERROR;
     }
     /* Locking the file. Lock will be release upon close */
-    if (lockf(fileno(io->stream), F_TLOCK, 0) == -1 && errno == EAGAIN) {
+    if (lockf(fd, F_TLOCK, 0) == -1 && errno == EAGAIN) {
         LOG_ERROR("File %s currently locked.", filename);
-        fclose(io->stream);
+        close(fd);
+        return TSS2_FAPI_RC_IO_ERROR;
+    }
+    if (fstat(fd, &st) != 0) {
+        LOG_ERROR("File \"%s\" can't be accessed: %i.", filename, errno);
+        close(fd);
         return TSS2_FAPI_RC_IO_ERROR;
     }
+    length = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
 
-    fseek(io->stream, 0L, SEEK_END);
-    long length = ftell(io->stream);
-    fclose(io->stream);
+    io->stream = fdopen(fd, "r");
+    if (io->stream == NULL) {
+        LOG_ERROR("File \"%s\" can't be opened: %i.", filename, errno);
+        close(fd);
+        return TSS2_FAPI_RC_IO_ERROR;
+    }
 
-    io->stream = fopen(filename, "rt");
-    io->char_rbuffer = malloc (length + 1);
+    io->char_rbuffer = malloc(length + 1);
     if (io->char_rbuffer == NULL) {
         fclose(io->stream);
         io->stream = NULL;
-        LOG_ERROR("Memory could not be allocated. %li bytes requested", length + 1);
+        LOG_ERROR("Memory could not be allocated. %zu bytes requested", length + 1);
         return TSS2_FAPI_RC_MEMORY;
     }
 
-    int rc, flags = fcntl(fileno(io->stream), F_GETFL, 0);
-    rc = fcntl(fileno(io->stream), F_SETFL, flags | O_NONBLOCK);
-    if (rc < 0) {
-        LOG_ERROR("fcntl failed with %d", errno);
-        return TSS2_FAPI_RC_IO_ERROR;
-    }
-
     io->buffer_length = length;
     io->buffer_idx = 0;
     io->char_rbuffer[length] = '\0';
 
-    return TSS2_RC_SUCCESS;
+    io->engine = &ifapi_io_engine_read;
+    LOG_TRACE("Read %s with the %s engine.", filename, io->engine->name);
+
+    return io->engine->start(io, filename);
 }
 
 /** Finish reading a file's complete content into memory in an asynchronous way.
@@ -105,33 +234,29 @@ ifapi_io_read_finish(
     uint8_t **buffer,
     size_t *length)
 {
-    io->pollevents = POLLIN;
+    TSS2_RC r;
+
+    /* Reads served from the batch have no file to wait for. */
+    io->pollevents = io->stream ? POLLIN : 0;
     if (_ifapi_io_retry-- > 0)
         return TSS2_FAPI_RC_TRY_AGAIN;
     else
         _ifapi_io_retry = _IFAPI_IO_RETRIES;
 
-    ssize_t ret = read(fileno(io->stream),
-                       &io->char_rbuffer[io->buffer_idx],
-                       io->buffer_length - io->buffer_idx);
-    if (ret < 0 && (errno == EINTR || errno == EAGAIN))
-        return TSS2_FAPI_RC_TRY_AGAIN;
+    r = io->engine->finish(io);
+    if (r == TSS2_FAPI_RC_TRY_AGAIN)
+        return r;
 
-    if (ret < 0) {
-        LOG_ERROR("Error reading from file: %i.", errno);
+    io->pollevents = 0;
+    if (io->stream) {
         fclose(io->stream);
-        io->pollevents = 0;
+        io->stream = NULL;
+    }
+    if (r != TSS2_RC_SUCCESS) {
         SAFE_FREE(io->char_rbuffer);
-        return TSS2_FAPI_RC_IO_ERROR;
+        return r;
     }
 
-    io->pollevents = 0;
-    io->buffer_idx += ret;
-    if (io->buffer_idx < io->buffer_length)
-        return TSS2_FAPI_RC_TRY_AGAIN;
-
-    fclose(io->stream);
-
     if (!buffer) {
         LOG_WARNING("The old file read API is still being used");
         return TSS2_RC_SUCCESS;
@@ -145,28 +270,42 @@ ifapi_io_read_finish(
     return TSS2_RC_SUCCESS;
 }
 
-/** Start writing a buffer into a file in an asynchronous way.
+/** Open a file for asynchronous writing of a buffer.
+ *
+ * The file is locked before it is truncated, so a file being written by
+ * another writer is not truncated underneath it.
  *
  * @param[in,out] io The input/output context being used for file I/O.
- * @param[in] filename The name of the file to be read into memory.
+ * @param[in] filename The name of the file to be written.
+ * @param[in] append If true, the buffer is appended to the file, otherwise
+ *            the file is truncated.
  * @param[in] buffer The buffer to be written.
  * @param[in] length The number of bytes to be written.
  * @retval TSS2_RC_SUCCESS: if the function call was a success.
- * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered; such as the file was not found.
- * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated for the buffer.
  */
-TSS2_RC
-ifapi_io_write_async(
+static TSS2_RC
+io_open_write(
     struct IFAPI_IO *io,
     const char *filename,
+    bool append,
     const uint8_t *buffer,
     size_t length)
 {
+    IFAPI_IO_BATCH_ENTRY *entry;
+    int fd;
+
     if (io->char_rbuffer) {
         LOG_ERROR("rbuffer still in use; maybe use of old API.");
         return TSS2_FAPI_RC_IO_ERROR;
     }
 
+    /* Content read ahead is outdated by the write. */
+    entry = io_batch_find(io, filename);
+    if (entry)
+        io_batch_drop(entry);
+
     io->buffer_length = length;
     io->buffer_idx = 0;
     io->char_rbuffer = malloc(length);
@@ -176,16 +315,31 @@ ifapi_io_write_async(
     }
     memcpy(io->char_rbuffer, buffer, length);
 
-    io->stream = fopen(filename, "wt");
-    if (io->stream == NULL) {
+    fd = open(filename, O_WRONLY | O_CREAT | (append ? O_APPEND : 0), 0666);
+    if (fd < 0) {
         SAFE_FREE(io->char_rbuffer);
         LOG_ERROR("Could not open file \"%s\" for writing.", filename);
         return TSS2_FAPI_RC_IO_ERROR;
     }
     /* Locking the file. Lock will be release upon close */
-    if (lockf(fileno(io->stream), F_TLOCK, 0) == -1 && errno == EAGAIN) {
+    if (lockf(fd, F_TLOCK, 0) == -1 && errno == EAGAIN) {
         LOG_ERROR("File %s currently locked.", filename);
-        fclose(io->stream);
+        close(fd);
+        SAFE_FREE(io->char_rbuffer);
+        return TSS2_FAPI_RC_IO_ERROR;
+    }
+    if (!append && ftruncate(fd, 0) != 0) {
+        LOG_ERROR("File %s can't be truncated: %i.", filename, errno);
+        close(fd);
+        SAFE_FREE(io->char_rbuffer);
+        return TSS2_FAPI_RC_IO_ERROR;
+    }
+
+    io->stream = fdopen(fd, append ? "a" : "w");
+    if (io->stream == NULL) {
+        LOG_ERROR("File \"%s\" can't be opened: %i.", filename, errno);
+        close(fd);
+        SAFE_FREE(io->char_rbuffer);
         return TSS2_FAPI_RC_IO_ERROR;
     }
 
@@ -199,6 +353,51 @@ ifapi_io_write_async(
     return TSS2_RC_SUCCESS;
 }
 
+/** Start writing a buffer into a file in an asynchronous way.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] filename The name of the file to be read into memory.
+ * @param[in] buffer The buffer to be written.
+ * @param[in] length The number of bytes to be written.
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered; such as the file was not found.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
+ */
+TSS2_RC
+ifapi_io_write_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length)
+{
+    return io_open_write(io, filename, false, buffer, length);
+}
+
+/** Start appending a buffer to a file in an asynchronous way.
+ *
+ * The file is created if it does not exist. The data is written with
+ * O_APPEND, so it is placed at the end of the file even if other processes
+ * appended to it in the meantime. Call ifapi_io_write_finish to complete
+ * the operation.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] filename The name of the file to be appended to.
+ * @param[in] buffer The buffer to be written.
+ * @param[in] length The number of bytes to be written.
+ * @retval TSS2_RC_SUCCESS: if the function call was a success.
+ * @retval TSS2_FAPI_RC_IO_ERROR: if an I/O error was encountered; such as the file was not found.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
+ */
+TSS2_RC
+ifapi_io_append_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length)
+{
+    return io_open_write(io, filename, true, buffer, length);
+}
+
 /** Finish writing a buffer into a file in an asynchronous way.
  *
  * This function needs to be called repeatedly until it does not return TSS2_FAPI_RC_TRY_AGAIN.
@@ -523,6 +722,9 @@ dirfiles_all(const char *dir_name, NODE_OBJECT_T **list, size_t *n)
             return_if_error(r, "get_entities");
 
         } else {
+            /* Hidden files like the keystore index are no keystore objects. */
+            if (entry->d_name[0] == '.')
+                continue;
             r = ifapi_asprintf(&path, "%s/%s", dir_name, entry->d_name);
             if (r)
                 closedir(dir);
@@ -615,6 +817,328 @@ cleanup:
     return r;
 }
 
+/** Order directory entries like the full paths of the files below them.
+ *
+ * A directory sorts as if its name had a trailing delimiter, thus
+ * "dir/file" is placed after "dir.x". The depth-first walk done by
+ * ifapi_io_dirfiles_next() then produces the paths in strcmp() order, which allows
+ * to resume the walk after a given path.
+ */
+static int
+dirent_path_cmp(const struct dirent **a, const struct dirent **b)
+{
+    const unsigned char *s1 = (const unsigned char *)(*a)->d_name;
+    const unsigned char *s2 = (const unsigned char *)(*b)->d_name;
+    int c1, c2;
+
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    c1 = *s1 ? *s1 : ((*a)->d_type == DT_DIR ? '/' : 0);
+    c2 = *s2 ? *s2 : ((*b)->d_type == DT_DIR ? '/' : 0);
+    return c1 - c2;
+}
+
+/** Append a path to a dynamically growing array of paths.
+ *
+ * The capacity of the array is doubled whenever the number of entries
+ * reaches a power of two (starting at 16).
+ *
+ * @param[in,out] paths The array of paths.
+ * @param[in,out] n The number of paths in the array.
+ * @param[in] path The path to be appended (moved to the array).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+paths_append(char ***paths, size_t *n, char *path)
+{
+    char **new_paths;
+
+    if (*n == 0 || (*n >= 16 && (*n & (*n - 1)) == 0)) {
+        size_t capacity = *n ? 2 * *n : 16;
+        new_paths = realloc(*paths, capacity * sizeof(char *));
+        return_if_null(new_paths, "Out of memory.", TSS2_FAPI_RC_MEMORY);
+        *paths = new_paths;
+    }
+    (*paths)[(*n)++] = path;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Read a directory and push it onto the stack of a directory walk.
+ *
+ * The entries of the directory are read once and kept in sorted order until
+ * the walk leaves the directory. Directories which can't be read are
+ * skipped.
+ *
+ * @param[in,out] walk The directory walk.
+ * @param[in] path The directory (moved to the walk).
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+dirwalk_push(IFAPI_DIR_WALK *walk, char *path)
+{
+    IFAPI_DIR_WALK_LEVEL *levels, *level;
+    struct dirent **entries;
+    size_t capacity;
+    int num_entries, i;
+
+    num_entries = scandir(path, &entries, NULL, dirent_path_cmp);
+    if (num_entries < 0) {
+        LOG_TRACE("Directory %s can't be read.", path);
+        SAFE_FREE(path);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (walk->depth == walk->capacity) {
+        capacity = walk->capacity ? 2 * walk->capacity : 8;
+        levels = realloc(walk->levels, capacity * sizeof(IFAPI_DIR_WALK_LEVEL));
+        if (!levels) {
+            for (i = 0; i < num_entries; i++)
+                free(entries[i]);
+            free(entries);
+            SAFE_FREE(path);
+            LOG_ERROR("Out of memory.");
+            return TSS2_FAPI_RC_MEMORY;
+        }
+        walk->levels = levels;
+        walk->capacity = capacity;
+    }
+    level = &walk->levels[walk->depth++];
+    level->path = path;
+    level->entries = entries;
+    level->num_entries = num_entries;
+    level->next = 0;
+    return TSS2_RC_SUCCESS;
+}
+
+/** Remove the innermost directory from the stack of a directory walk.
+ *
+ * @param[in,out] walk The directory walk.
+ */
+static void
+dirwalk_pop(IFAPI_DIR_WALK *walk)
+{
+    IFAPI_DIR_WALK_LEVEL *level = &walk->levels[--walk->depth];
+    int i;
+
+    for (i = 0; i < level->num_entries; i++)
+        free(level->entries[i]);
+    SAFE_FREE(level->entries);
+    SAFE_FREE(level->path);
+}
+
+/** Position a new directory walk after a given path.
+ *
+ * Only the directories along the path are read, the entries not greater
+ * than the path are skipped. The walk only descends into directories read
+ * from the tree, thus a path outside of the tree just positions the walk
+ * before the first greater path or at its end.
+ *
+ * @param[in,out] walk The directory walk.
+ * @param[in] after The path after which the walk continues.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+dirwalk_seek(IFAPI_DIR_WALK *walk, const char *after)
+{
+    TSS2_RC r;
+    IFAPI_DIR_WALK_LEVEL *level;
+    struct dirent *entry;
+    char *path = NULL;
+    size_t len = 0;
+    int cmp;
+
+    while (walk->depth > 0) {
+        level = &walk->levels[walk->depth - 1];
+        for (; level->next < level->num_entries; level->next++) {
+            entry = level->entries[level->next];
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            r = ifapi_asprintf(&path, entry->d_type == DT_DIR ? "%s/%s/" : "%s/%s",
+                               level->path, entry->d_name);
+            return_if_error(r, "Out of memory");
+
+            len = strlen(path);
+            if (entry->d_type == DT_DIR && strncmp(path, after, len) == 0)
+                break;
+            cmp = strcmp(path, after);
+            SAFE_FREE(path);
+            if (cmp > 0)
+                return TSS2_RC_SUCCESS;
+        }
+        if (!path)
+            return TSS2_RC_SUCCESS;
+
+        /* The path lies within this directory. */
+        level->next++;
+        path[len - 1] = '\0';
+        r = dirwalk_push(walk, path);
+        path = NULL;
+        return_if_error(r, "Read directory");
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Continue a directory walk until a number of paths is collected.
+ *
+ * @param[in,out] walk The directory walk.
+ * @param[in] max_paths The walk stops when the array contains this many paths.
+ * @param[in,out] paths The array of paths.
+ * @param[in,out] n The number of paths in the array.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ */
+static TSS2_RC
+dirwalk_next(IFAPI_DIR_WALK *walk, size_t max_paths, char ***paths, size_t *n)
+{
+    TSS2_RC r;
+    IFAPI_DIR_WALK_LEVEL *level;
+    struct dirent *entry;
+    char *path = NULL;
+
+    while (walk->depth > 0 && *n < max_paths) {
+        level = &walk->levels[walk->depth - 1];
+        if (level->next == level->num_entries) {
+            dirwalk_pop(walk);
+            continue;
+        }
+        entry = level->entries[level->next++];
+
+        if (entry->d_type == DT_DIR) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            r = ifapi_asprintf(&path, "%s/%s", level->path, entry->d_name);
+            return_if_error(r, "Out of memory");
+
+            LOG_TRACE("Directory: %s", path);
+            r = dirwalk_push(walk, path);
+            return_if_error(r, "Read directory");
+        } else {
+            /* Hidden files like the keystore index are no keystore objects. */
+            if (entry->d_name[0] == '.')
+                continue;
+            r = ifapi_asprintf(&path, "%s/%s", level->path, entry->d_name);
+            return_if_error(r, "Out of memory");
+
+            LOG_TRACE("File: %s", path);
+            r = paths_append(paths, n, path);
+            if (r != TSS2_RC_SUCCESS) {
+                SAFE_FREE(path);
+                return r;
+            }
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Free the resources of a directory walk.
+ *
+ * The walk can be used again afterwards.
+ *
+ * @param[in,out] walk The directory walk.
+ */
+void
+ifapi_io_dirwalk_cleanup(IFAPI_DIR_WALK *walk)
+{
+    if (!walk)
+        return;
+    while (walk->depth > 0)
+        dirwalk_pop(walk);
+    SAFE_FREE(walk->levels);
+    SAFE_FREE(walk->root);
+    SAFE_FREE(walk->last);
+    walk->capacity = 0;
+}
+
+/** Enumerate the next files of a directory tree.
+ *
+ * In contrast to ifapi_io_dirfiles_all() the files are enumerated in sorted
+ * order and the enumeration stops after max_paths files. Subsequent calls
+ * with the last returned path as 'after' continue the enumeration.
+ *
+ * The sorted entries of the directories along the current path are kept in
+ * walk. If 'after' is the last path returned for the same search path, the
+ * walk continues from there and the cost of the call only depends on the
+ * number of paths returned. Otherwise the walk is restarted and positioned
+ * after 'after'; this reads and sorts the directories along 'after', thus
+ * the cost grows with the size of these directories. Directories are read
+ * once per walk, files created in a directory after it was read are not
+ * enumerated by this walk.
+ *
+ * @param[in,out] walk The state of the directory walk.
+ * @param[in] searchPath The directory to list files from.
+ * @param[in] after Only files with a path greater than this path are
+ *            enumerated (may be NULL to start with the first file).
+ * @param[in] max_paths The maximum number of paths in the list.
+ * @param[in,out] pathlist The list of file names. The files found are appended.
+ * @param[in,out] numPaths The size of pathlist.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated to hold the read data.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ */
+TSS2_RC
+ifapi_io_dirfiles_next(
+    IFAPI_DIR_WALK *walk,
+    const char *searchPath,
+    const char *after,
+    size_t max_paths,
+    char ***pathlist,
+    size_t *numPaths)
+{
+    TSS2_RC r;
+    size_t i, n;
+    char *root;
+
+    check_not_null(walk);
+    check_not_null(searchPath);
+    check_not_null(pathlist);
+    check_not_null(numPaths);
+
+    n = *numPaths;
+    if (!walk->root || strcmp(walk->root, searchPath) != 0 || !after ||
+        !walk->last || strcmp(walk->last, after) != 0) {
+        LOG_TRACE("Start directory walk of %s", searchPath);
+        ifapi_io_dirwalk_cleanup(walk);
+        walk->root = strdup(searchPath);
+        goto_if_null2(walk->root, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, error);
+
+        root = strdup(searchPath);
+        goto_if_null2(root, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, error);
+        r = dirwalk_push(walk, root);
+        goto_if_error(r, "Read directory", error);
+
+        if (after) {
+            r = dirwalk_seek(walk, after);
+            goto_if_error(r, "Position directory walk", error);
+        }
+    }
+
+    r = dirwalk_next(walk, max_paths, pathlist, numPaths);
+    goto_if_error(r, "Directory walk", error);
+
+    if (*numPaths > n) {
+        SAFE_FREE(walk->last);
+        walk->last = strdup((*pathlist)[*numPaths - 1]);
+        goto_if_null2(walk->last, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, error);
+    } else if (!walk->last && after) {
+        walk->last = strdup(after);
+        goto_if_null2(walk->last, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, error);
+    }
+    return TSS2_RC_SUCCESS;
+
+error:
+    /* Only drop the paths added by this call. */
+    for (i = n; i < *numPaths; i++)
+        SAFE_FREE((*pathlist)[i]);
+    *numPaths = n;
+    ifapi_io_dirwalk_cleanup(walk);
+    return r;
+}
+
 /** Determine whether a path exists.
  *
  * @param[in] path The absolute path of the file.
@@ -632,6 +1156,149 @@ ifapi_io_path_exists(const char *path)
         return false;
 }
 
+/** Open a file for appending and lock it.
+ *
+ * The file is created if it does not exist. Files which are replaced by
+ * renaming a new file over them are supported: if the file was replaced
+ * by another writer while waiting for the lock, the new file is opened.
+ * Note that lockf() locks belong to the process, closing any other stream
+ * of the file in this process releases the lock as well.
+ *
+ * @param[in] file The name of the file.
+ * @param[out] stream The locked stream, the lock is released upon close.
+ * @param[out] st The status of the locked file.
+ * @retval TSS2_RC_SUCCESS if the file was opened and locked.
+ * @retval TSS2_FAPI_RC_IO_ERROR if the file could not be opened or locked.
+ */
+TSS2_RC
+ifapi_io_open_locked(const char *file, FILE **stream, struct stat *st)
+{
+    struct stat path_st;
+    int i;
+
+    for (i = 0; i < IFAPI_IO_LOCK_RETRIES; i++) {
+        *stream = fopen(file, "a+");
+        return_if_null(*stream, "File could not be opened.", TSS2_FAPI_RC_IO_ERROR);
+
+        /* Locking the file. Lock will be release upon close */
+        if (lockf(fileno(*stream), F_LOCK, 0) == -1 ||
+            fstat(fileno(*stream), st) != 0) {
+            fclose(*stream);
+            return_error2(TSS2_FAPI_RC_IO_ERROR, "File %s could not be locked.",
+                          file);
+        }
+        if (stat(file, &path_st) == 0 && path_st.st_dev == st->st_dev &&
+            path_st.st_ino == st->st_ino)
+            return TSS2_RC_SUCCESS;
+
+        /* The file was replaced in the meantime. */
+        fclose(*stream);
+    }
+    return_error2(TSS2_FAPI_RC_IO_ERROR, "File %s could not be locked.", file);
+}
+
+/** Read a file's complete content with blocking reads.
+ *
+ * @param[in] fd The file descriptor of the file.
+ * @param[out] buffer The zero terminated content. (callee-allocated; use free())
+ * @param[out] length The length of the content.
+ * @retval true if the file was read.
+ * @retval false if the file is not a regular file or could not be read.
+ */
+static bool
+io_read_all(int fd, char **buffer, size_t *length)
+{
+    struct stat st;
+    size_t size, idx = 0;
+    ssize_t ret;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    size = st.st_size;
+    *buffer = malloc(size + 1);
+    if (*buffer == NULL)
+        return false;
+
+    while (idx < size) {
+        ret = read(fd, &(*buffer)[idx], size - idx);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0) {
+            SAFE_FREE(*buffer);
+            return false;
+        }
+        if (ret == 0)
+            break;
+        idx += ret;
+    }
+    (*buffer)[idx] = '\0';
+    *length = idx;
+    return true;
+}
+
+/** Read files which will be read soon in one batch.
+ *
+ * All files are opened and the kernel is asked to read them into the page
+ * cache, thus the reads of all files are in flight at the same time. Then
+ * the files are read into memory. Later calls of ifapi_io_read_async for
+ * these files are served from memory by the batch engine. Files read ahead
+ * before are dropped. Errors are ignored, the files are read regularly
+ * later on.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] files The absolute paths of the files.
+ * @param[in] num_files The number of files, at most IFAPI_IO_BATCH_SIZE are
+ *            read.
+ */
+void
+ifapi_io_read_batch(
+    struct IFAPI_IO *io,
+    const char **files,
+    size_t num_files)
+{
+    int fds[IFAPI_IO_BATCH_SIZE];
+    IFAPI_IO_BATCH_ENTRY *entry;
+    size_t i;
+
+    ifapi_io_batch_cleanup(io);
+    if (num_files > IFAPI_IO_BATCH_SIZE)
+        num_files = IFAPI_IO_BATCH_SIZE;
+
+    for (i = 0; i < num_files; i++) {
+        fds[i] = open(files[i], O_RDONLY);
+        if (fds[i] < 0) {
+            LOG_DEBUG("File %s can't be read ahead.", files[i]);
+            continue;
+        }
+#ifdef HAVE_POSIX_FADVISE
+        posix_fadvise(fds[i], 0, 0, POSIX_FADV_WILLNEED);
+#endif /* HAVE_POSIX_FADVISE */
+    }
+
+    for (i = 0; i < num_files; i++) {
+        if (fds[i] < 0)
+            continue;
+        entry = &io->batch[i];
+        if (io_read_all(fds[i], &entry->buffer, &entry->length)) {
+            entry->path = strdup(files[i]);
+            if (!entry->path)
+                io_batch_drop(entry);
+        }
+        close(fds[i]);
+    }
+}
+
+/** Drop the files read ahead by ifapi_io_read_batch.
+ *
+ * @param[in,out] io The input/output context being used for file I/O.
+ */
+void
+ifapi_io_batch_cleanup(
+    struct IFAPI_IO *io)
+{
+    for (size_t i = 0; i < IFAPI_IO_BATCH_SIZE; i++)
+        io_batch_drop(&io->batch[i]);
+}
 
 /** Wait for file I/O to be ready.
  *
@@ -9,9 +9,39 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <sys/stat.h>
 #include "tss2_common.h"
 #include "tss2_fapi.h"
 
+struct IFAPI_IO;
+
+/** An engine reading a file's complete content for ifapi_io_read_finish.
+ *
+ * ifapi_io_read_async selects the engine of a read and calls start, the file
+ * is already opened as stream unless it is served from the batch.
+ * ifapi_io_read_finish calls finish until it does not return
+ * TSS2_FAPI_RC_TRY_AGAIN. The engine fills char_rbuffer with buffer_length
+ * bytes and shortens buffer_length if the file shrank in the meantime.
+ */
+typedef struct {
+    const char *name;                /**< The name of the engine for log messages */
+    TSS2_RC (*start)(struct IFAPI_IO *io, const char *filename);
+    TSS2_RC (*finish)(struct IFAPI_IO *io);
+} IFAPI_IO_ENGINE;
+
+/** Maximum number of files read ahead by ifapi_io_read_batch */
+#define IFAPI_IO_BATCH_SIZE 16
+
+/** A file read ahead by ifapi_io_read_batch */
+typedef struct {
+    char *path;                      /**< The path of the file; NULL for an unused entry */
+    char *buffer;                    /**< The zero terminated content of the file */
+    size_t length;                   /**< The length of the content */
+} IFAPI_IO_BATCH_ENTRY;
+
+extern const IFAPI_IO_ENGINE ifapi_io_engine_read;
+extern const IFAPI_IO_ENGINE ifapi_io_engine_batch;
+
 typedef struct IFAPI_IO {
     FILE *stream;
     short pollevents;
@@ -19,8 +49,27 @@ typedef struct IFAPI_IO {
     char *char_rbuffer;
     size_t buffer_length;
     size_t buffer_idx;
+    const IFAPI_IO_ENGINE *engine;   /**< The engine of the pending read */
+    IFAPI_IO_BATCH_ENTRY batch[IFAPI_IO_BATCH_SIZE]; /**< Files read ahead */
 } IFAPI_IO;
 
+/** A directory read by a directory walk */
+typedef struct {
+    char *path;                     /**< The path of the directory */
+    struct dirent **entries;        /**< The sorted entries of the directory */
+    int num_entries;                /**< The number of entries */
+    int next;                       /**< The index of the next entry to visit */
+} IFAPI_DIR_WALK_LEVEL;
+
+/** The state of a sorted walk of a directory tree kept between pages */
+typedef struct {
+    char *root;                     /**< The directory tree of the walk */
+    char *last;                     /**< The last path enumerated by the walk */
+    IFAPI_DIR_WALK_LEVEL *levels;   /**< The directories along the current path */
+    size_t depth;                   /**< The number of directories in levels */
+    size_t capacity;                /**< The allocated size of levels */
+} IFAPI_DIR_WALK;
+
 #ifdef TEST_FAPI_ASYNC
 #define _IFAPI_IO_RETRIES 1
 #else /* TEST_FAPI_ASYNC */
@@ -53,6 +102,13 @@ ifapi_io_write_async(
     const uint8_t *buffer,
     size_t length);
 
+TSS2_RC
+ifapi_io_append_async(
+    struct IFAPI_IO *io,
+    const char *filename,
+    const uint8_t *buffer,
+    size_t length);
+
 TSS2_RC
 ifapi_io_write_finish(
     struct IFAPI_IO *io);
@@ -87,9 +143,38 @@ ifapi_io_dirfiles_all(
     char ***pathlist,
     size_t *numPaths);
 
+TSS2_RC
+ifapi_io_dirfiles_next(
+    IFAPI_DIR_WALK *walk,
+    const char *searchPath,
+    const char *after,
+    size_t max_paths,
+    char ***pathlist,
+    size_t *numPaths);
+
+void
+ifapi_io_dirwalk_cleanup(
+    IFAPI_DIR_WALK *walk);
+
+void
+ifapi_io_read_batch(
+    struct IFAPI_IO *io,
+    const char **files,
+    size_t num_files);
+
+void
+ifapi_io_batch_cleanup(
+    struct IFAPI_IO *io);
+
 bool
 ifapi_io_path_exists(const char *path);
 
+TSS2_RC
+ifapi_io_open_locked(
+    const char *file,
+    FILE **stream,
+    struct stat *st);
+
 TSS2_RC
 ifapi_io_poll(IFAPI_IO * io);
 
@@ -935,5 +935,42 @@ ifapi_json_IFAPI_CONFIG_serialize(const IFAPI_CONFIG *in, json_object **jso)
 
      json_object_object_add(*jso, "intel_cert_service", jso2);
 
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->primary_cache_size, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "primary_cache_size", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->session_pool_size, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "session_pool_size", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->session_max_uses, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "session_max_uses", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->key_cache_size, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "key_cache_size", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_UINT32_serialize(in->key_cache_slots, &jso2);
+     return_if_error(r, "Serialize UINT32");
+
+     json_object_object_add(*jso, "key_cache_slots", jso2);
+
+     jso2 = NULL;
+     r = ifapi_json_char_serialize(in->keystore_format == IFAPI_KEYSTORE_FORMAT_BINARY ?
+                                   "binary" : "json", &jso2);
+     return_if_error(r, "Serialize char");
+
+     json_object_object_add(*jso, "keystore_format", jso2);
+
      return TSS2_RC_SUCCESS;
  }
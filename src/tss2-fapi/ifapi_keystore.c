@@ -13,6 +13,9 @@
 #include "ifapi_io.h"
 #include "ifapi_helpers.h"
 #include "ifapi_keystore.h"
+#include "ifapi_index.h"
+#include "ifapi_binary.h"
+#include "tss2_mu.h"
 #define LOGMODULE fapi
 #include "util/log.h"
 #include "util/aux_util.h"
@@ -463,6 +466,10 @@ ifapi_keystore_initialize(
     r = ifapi_io_check_create_dir(keystore->userdir, FAPI_WRITE);
     goto_if_error2(r, "User directory %s can't be created.", error, keystore->userdir);
 
+    r = ifapi_asprintf(&keystore->index_file, "%s%s%s", keystore->userdir,
+                       IFAPI_FILE_DELIM, IFAPI_INDEX_FILE);
+    goto_if_error(r, "Out of memory.", error);
+
     keystore->systemdir = strdup(config_systemdir);
     goto_if_null2(keystore->systemdir, "Out of memory.", r, TSS2_FAPI_RC_MEMORY,
                   error);
@@ -478,6 +485,69 @@ error:
     SAFE_FREE(keystore->defaultprofile);
     SAFE_FREE(keystore->userdir);
     SAFE_FREE(keystore->systemdir);
+    SAFE_FREE(keystore->index_file);
+    return r;
+}
+
+/** Compute the keys used to find an object via the keystore index.
+ *
+ * Keys and NV objects can be found by their name and policy digest, NV
+ * objects additionally by their NV index.
+ *
+ * @param[in] object The object to be indexed.
+ * @param[out] keys The space separated keys of the object. (callee-allocated;
+ *             NULL if the object can't be searched)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the NV name can't be computed.
+ */
+static TSS2_RC
+keystore_index_keys(const IFAPI_OBJECT *object, char **keys)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    TPM2B_NAME nv_name;
+    const TPM2B_DIGEST *auth_policy;
+    UINT8 nv_index[sizeof(TPM2_HANDLE)];
+
+    *keys = NULL;
+    switch (object->objectType) {
+    case IFAPI_KEY_OBJ:
+        if (object->misc.key.name.size) {
+            r = ifapi_index_add_key(keys, "name", &object->misc.key.name.name[0],
+                                    object->misc.key.name.size);
+            goto_if_error(r, "Add name key.", error_cleanup);
+        }
+        auth_policy = &object->misc.key.public.publicArea.authPolicy;
+        break;
+    case IFAPI_NV_OBJ:
+        r = ifapi_nv_get_name((TPM2B_NV_PUBLIC *)&object->misc.nv.public, &nv_name);
+        return_if_error(r, "Get NV name.");
+
+        r = ifapi_index_add_key(keys, "name", &nv_name.name[0], nv_name.size);
+        goto_if_error(r, "Add name key.", error_cleanup);
+
+        r = Tss2_MU_TPM2_HANDLE_Marshal(object->misc.nv.public.nvPublic.nvIndex,
+                                        &nv_index[0], sizeof(nv_index), NULL);
+        goto_if_error(r, "Marshal NV index.", error_cleanup);
+
+        r = ifapi_index_add_key(keys, "nv", &nv_index[0], sizeof(nv_index));
+        goto_if_error(r, "Add NV key.", error_cleanup);
+
+        auth_policy = &object->misc.nv.public.nvPublic.authPolicy;
+        break;
+    default:
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (auth_policy->size) {
+        r = ifapi_index_add_key(keys, "policy", &auth_policy->buffer[0],
+                                auth_policy->size);
+        goto_if_error(r, "Add policy key.", error_cleanup);
+    }
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    SAFE_FREE(*keys);
     return r;
 }
 
@@ -643,14 +713,24 @@ ifapi_keystore_load_finish(
     TSS2_RC r;
     json_object *jso = NULL;
     uint8_t *buffer = NULL;
-    /* Keystore parameter is used to be prepared if transmission of state information
-       between async and finish will be necessary in future extensions. */
-    (void)keystore;
+    size_t length = 0;
 
-    r = ifapi_io_read_finish(io, &buffer, NULL);
+    r = ifapi_io_read_finish(io, &buffer, &length);
     return_try_again(r);
     return_if_error(r, "keystore read_finish failed");
 
+    /* Objects can be stored in the binary encoding independent of the
+       configured format. */
+    if (ifapi_binary_is_object(buffer, length)) {
+        r = ifapi_binary_IFAPI_OBJECT_deserialize(buffer, length, object);
+        SAFE_FREE(buffer);
+        goto_if_error(r, "Keystore is corrupted (binary object).", error_cleanup);
+
+        object->rel_path = keystore->rel_path;
+        LOG_TRACE("Return %x", r);
+        return r;
+    }
+
     /* If json objects can't be parse the object store is corrupted */
     jso = json_tokener_parse((char *)buffer);
     SAFE_FREE(buffer);
@@ -708,6 +788,8 @@ ifapi_keystore_store_async(
     char *directory = NULL;
     char *file = NULL;
     char *jso_string = NULL;
+    uint8_t *buffer = NULL;
+    size_t size = 0;
     json_object *jso = NULL;
 
     LOG_TRACE("Store object: %s", path);
@@ -731,23 +813,45 @@ ifapi_keystore_store_async(
     }
     goto_if_error2(r, "Object path %s could not be created.", cleanup, directory);
 
-    /* Generate JSON string to be written to store */
-    r = ifapi_json_IFAPI_OBJECT_serialize(object, &jso);
-    goto_if_error2(r, "Object for %s could not be serialized.", cleanup, file);
-
-    jso_string = strdup(json_object_to_json_string_ext(jso,
-                                                       JSON_C_TO_STRING_PRETTY));
-    goto_if_null2(jso_string, "Converting json to string", r, TSS2_FAPI_RC_MEMORY,
-                  cleanup);
+    if (keystore->binary && ifapi_binary_supported(object)) {
+        /* Generate the binary encoding to be written to store */
+        r = ifapi_binary_IFAPI_OBJECT_serialize(object, &buffer, &size);
+        goto_if_error2(r, "Object for %s could not be serialized.", cleanup, file);
+    } else {
+        /* Generate JSON string to be written to store */
+        r = ifapi_json_IFAPI_OBJECT_serialize(object, &jso);
+        goto_if_error2(r, "Object for %s could not be serialized.", cleanup, file);
+
+        jso_string = strdup(json_object_to_json_string_ext(jso,
+                                                           JSON_C_TO_STRING_PRETTY));
+        goto_if_null2(jso_string, "Converting json to string", r, TSS2_FAPI_RC_MEMORY,
+                      cleanup);
+        buffer = (uint8_t *) jso_string;
+        size = strlen(jso_string);
+    }
 
-    /* Start writing the json string to disk */
-    r = ifapi_io_write_async(io, file, (uint8_t *) jso_string, strlen(jso_string));
-    free(jso_string);
+    /* Start writing the object to disk */
+    r = ifapi_io_write_async(io, file, buffer, size);
+    SAFE_FREE(buffer);
     goto_if_error(r, "write_async failed", cleanup);
 
+    /* Remember the index entry, it will be written if the object is stored. */
+    SAFE_FREE(keystore->index_path);
+    SAFE_FREE(keystore->index_keys);
+    SAFE_FREE(keystore->index_object);
+    if (keystore_index_keys(object, &keystore->index_keys) != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Index keys for %s could not be computed.", directory);
+    } else if (keystore->index_keys) {
+        keystore->index_path = directory;
+        directory = NULL;
+        keystore->index_object = file;
+        file = NULL;
+    }
+
 cleanup:
     if (jso)
         json_object_put(jso);
+    SAFE_FREE(buffer);
     SAFE_FREE(directory);
     SAFE_FREE(file);
     return r;
@@ -830,17 +934,26 @@ ifapi_keystore_store_finish(
 {
     TSS2_RC r;
 
-    /* Keystore parameter is used to be prepared if transmission of state information
-       between async and finish will be necessary in future extensions. */
-    (void)keystore;
     /* Finish writing the object */
     r = ifapi_io_write_finish(io);
     return_try_again(r);
 
     LOG_TRACE("Return %x", r);
-    return_if_error(r, "read_finish failed");
+    goto_if_error(r, "read_finish failed", cleanup);
+
+    /* The index only speeds up searching, thus errors are not fatal. */
+    if (keystore->index_path &&
+        ifapi_index_update(keystore->index_file, keystore->index_path,
+                           keystore->index_object,
+                           keystore->index_keys) != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Index entry for %s could not be stored.", keystore->index_path);
+    }
 
-    return TSS2_RC_SUCCESS;
+cleanup:
+    SAFE_FREE(keystore->index_path);
+    SAFE_FREE(keystore->index_keys);
+    SAFE_FREE(keystore->index_object);
+    return r;
 }
 
 /** Create a list of all files in a certain directory.
@@ -970,6 +1083,117 @@ ifapi_keystore_list_all(
     return r;
 }
 
+/** Create the next page of a list of objects in a certain search path.
+ *
+ * The system store is enumerated before the user store. Within a store the
+ * objects are enumerated in the sorted order of their file names. The
+ * returned cursor identifies the last enumerated file: It consists of the
+ * index of the store ('0' for the system and '1' for the user store)
+ * followed by the path of the file relative to the store directory.
+ *
+ * The directory walk is kept in walk, thus a call with the cursor returned
+ * by the previous call continues without reading directories again.
+ *
+ * @param[in] keystore The key directories, the default profile.
+ * @param[in,out] walk The directory walk of the previous call.
+ * @param[in] searchpath The relative search path in key store.
+ * @param[in] cursor The cursor returned by the previous call or NULL to start
+ *            with the first object.
+ * @param[in] max_results The maximum number of objects to be returned.
+ * @param[out] results The array with pointers to the relative object paths.
+ * @param[out] numresults The number of found objects.
+ * @param[out] next_cursor The cursor for the next call (callee-allocated) or
+ *             NULL if all objects have been enumerated.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an invalid value was passed into
+ *         the function.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ */
+TSS2_RC
+ifapi_keystore_list_next(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_DIR_WALK *walk,
+    const char *searchpath,
+    const char *cursor,
+    size_t max_results,
+    char ***results,
+    size_t *numresults,
+    char **next_cursor)
+{
+    TSS2_RC r;
+    char *expanded_search_path = NULL, *full_search_path = NULL, *after = NULL;
+    const char *store_dirs[] = { keystore->systemdir, keystore->userdir };
+    size_t store = 0, last_store = 0, count, i;
+
+    *results = NULL;
+    *numresults = 0;
+    *next_cursor = NULL;
+
+    if (max_results == 0) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Page size 0.");
+    }
+    if (cursor) {
+        if ((cursor[0] != '0' && cursor[0] != '1') || cursor[1] == '\0') {
+            return_error2(TSS2_FAPI_RC_BAD_VALUE, "Invalid cursor %s", cursor);
+        }
+        store = cursor[0] - '0';
+        r = ifapi_asprintf(&after, "%s%s", store_dirs[store], &cursor[1]);
+        return_if_error(r, "Out of memory.");
+    }
+
+    if (searchpath && strcmp(searchpath, "") != 0 && strcmp(searchpath, "/") != 0) {
+        r = expand_path(keystore, searchpath, &expanded_search_path);
+        goto_if_error(r, "Expand path.", error);
+    }
+
+    for (; store < sizeof(store_dirs) / sizeof(store_dirs[0]) &&
+             *numresults < max_results; store++) {
+        r = ifapi_asprintf(&full_search_path, "%s%s", store_dirs[store],
+                           expanded_search_path ? expanded_search_path : "");
+        goto_if_error(r, "Out of memory.", error);
+
+        count = *numresults;
+        r = ifapi_io_dirfiles_next(walk, full_search_path, after, max_results,
+                                   results, numresults);
+        goto_if_error(r, "Get files in directory.", error);
+        SAFE_FREE(full_search_path);
+
+        if (*numresults > count)
+            last_store = store;
+        SAFE_FREE(after);
+    }
+
+    if (*numresults == max_results) {
+        /* More objects may follow, the last path relative to its store is
+           the cursor. */
+        r = ifapi_asprintf(next_cursor, "%zu%s", last_store,
+                           &(*results)[*numresults - 1][strlen(store_dirs[last_store])]);
+        goto_if_error(r, "Out of memory.", error);
+    }
+
+    /* Convert absolute path to relative path */
+    for (i = 0; i < *numresults; i++) {
+        full_path_to_fapi_path(keystore, (*results)[i]);
+    }
+    SAFE_FREE(expanded_search_path);
+    return TSS2_RC_SUCCESS;
+
+error:
+    for (i = 0; i < *numresults; i++)
+        SAFE_FREE((*results)[i]);
+    SAFE_FREE(*results);
+    *numresults = 0;
+    SAFE_FREE(full_search_path);
+    SAFE_FREE(expanded_search_path);
+    SAFE_FREE(after);
+    return r;
+}
+
 /** Remove file storing a keystore object.
  *
  * @param[in] keystore The key directories, the default profile.
@@ -994,15 +1218,24 @@ ifapi_keystore_delete(
 {
     TSS2_RC r;
     char *abs_path = NULL;
+    char *directory = NULL;
 
     /* Convert relative path to absolute path in keystore */
     r = rel_path_to_abs_path(keystore, path, &abs_path);
     goto_if_error2(r, "Object %s not found.", cleanup, path);
 
     r = ifapi_io_remove_file(abs_path);
+    goto_if_error2(r, "Object %s could not be removed.", cleanup, path);
+
+    /* The index only speeds up searching, thus errors are not fatal. */
+    if (expand_path(keystore, path, &directory) != TSS2_RC_SUCCESS ||
+        ifapi_index_remove(keystore->index_file, directory) != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Index entry for %s could not be removed.", path);
+    }
 
 cleanup:
     SAFE_FREE(abs_path);
+    SAFE_FREE(directory);
     return r;
 }
 
@@ -1133,12 +1366,87 @@ typedef TSS2_RC (*ifapi_keystore_object_cmp) (
     void *cmp_object,
     bool *equal);
 
+/** Free the path list of the keystore search.
+ *
+ * @param[in,out] key_search The state information of the search.
+ */
+static void
+keystore_search_free_paths(IFAPI_KEY_SEARCH *key_search)
+{
+    size_t i;
+
+    for (i = 0; i < key_search->numPaths; i++)
+        free(key_search->pathlist[i]);
+    SAFE_FREE(key_search->pathlist);
+    key_search->numPaths = 0;
+    key_search->path_idx = 0;
+}
+
+/** Read the objects read next during a full keystore search in one batch.
+ *
+ * At the start of every window of IFAPI_KEYSTORE_PREFETCH objects all
+ * objects of the window are read with ifapi_io_read_batch, the following
+ * loads of the objects are served from memory.
+ *
+ * @param[in] keystore The key directories and default profile.
+ * @param[in,out] io The input/output context being used for file I/O.
+ * @param[in] key_search The state information of the search.
+ */
+static void
+keystore_search_prefetch(IFAPI_KEYSTORE *keystore, IFAPI_IO *io,
+                         IFAPI_KEY_SEARCH *key_search)
+{
+    char *files[IFAPI_KEYSTORE_PREFETCH];
+    size_t i, num_files = 0;
+
+    if ((key_search->numPaths - key_search->path_idx) % IFAPI_KEYSTORE_PREFETCH != 0)
+        return;
+
+    for (i = key_search->path_idx; i > 0 && num_files < IFAPI_KEYSTORE_PREFETCH; i--) {
+        const char *path = key_search->pathlist[i - 1];
+
+        if (ifapi_path_type_p(path, IFAPI_POLICY_PATH))
+            continue;
+        if (rel_path_to_abs_path(keystore, path, &files[num_files]) == TSS2_RC_SUCCESS)
+            num_files += 1;
+    }
+    ifapi_io_read_batch(io, (const char **)files, num_files);
+
+    for (i = 0; i < num_files; i++)
+        free(files[i]);
+}
+
+/** Compute the file of an object for the keystore index.
+ *
+ * @param[in] ctx The keystore.
+ * @param[in] path The relative path of the object.
+ * @param[out] file The absolute path of the object file. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
+ * @retval TSS2_FAPI_RC_KEY_NOT_FOUND if the file does not exist (for key objects).
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if the file does not exist (for NV and hierarchy objects).
+ */
+static TSS2_RC
+keystore_index_object_file(void *ctx, const char *path, char **file)
+{
+    return rel_path_to_abs_path((IFAPI_KEYSTORE *)ctx, path, file);
+}
+
 /** Search object with a certain propoerty in keystore.
+ *
+ * First the candidates stored in the keystore index for the passed key are
+ * checked. If no candidate matches and the index is complete, the objects
+ * without a trusted index record are read and their records are appended
+ * to the index. These are the objects stored in the keystore behind the
+ * index, e.g. by another user in the system directory or without FAPI.
+ * Otherwise all objects of the keystore are read and the index is rebuilt
+ * from these objects.
  *
  * @param[in,out] keystore The key directories, the default profile, and the
  *               state information for the asynchronous search.
  * @param[in] io The input/output context being used for file I/O.
- * @param[in] name The name of the searched key.
+ * @param[in] cmp_object The object which will used for the comparison.
+ * @param[in] cmp_function The function comparing objects from keystore.
  * @param[out] found_path The relative path of the found key.
  * @retval TSS2_RC_SUCCESS on success.
  * @retval TSS2_FAPI_RC_MEMORY: if memory could not be allocated.
@@ -1170,29 +1478,75 @@ keystore_search_obj(
     TSS2_RC r;
     UINT32 path_idx;
     char *path;
+    char *keys = NULL;
+    char *file = NULL;
     IFAPI_OBJECT object;
-    size_t i;
-
-    switch (keystore->key_search.state) {
-    statecase(keystore->key_search.state, KSEARCH_INIT)
-        r = ifapi_keystore_list_all(keystore,
-                                    "/", /**< search keys and NV objects in store */
-                                    &keystore->key_search.pathlist,
-                                    &keystore->key_search.numPaths);
-        goto_if_error2(r, "Get entities.", cleanup);
-
-        keystore->key_search.path_idx = keystore->key_search.numPaths;
+    IFAPI_KEY_SEARCH *key_search = &keystore->key_search;
+
+    switch (key_search->state) {
+    statecase(key_search->state, KSEARCH_INIT)
+        /* Get the candidates from the index, a missing index yields no candidates. */
+        r = ifapi_index_lookup(keystore->index_file, key_search->index_key,
+                               &key_search->pathlist, &key_search->numPaths,
+                               &key_search->index_state);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Keystore index %s could not be read.", keystore->index_file);
+            key_search->pathlist = NULL;
+            key_search->numPaths = 0;
+        }
+        key_search->from_index = true;
+        key_search->index_stale = false;
+        key_search->path_idx = key_search->numPaths;
         fallthrough;
 
-    statecase(keystore->key_search.state, KSEARCH_SEARCH_OBJECT)
+    statecase(key_search->state, KSEARCH_SEARCH_OBJECT)
+        if (key_search->path_idx == 0 && key_search->from_index) {
+            /* No candidate matches, search the keystore. */
+            keystore_search_free_paths(key_search);
+            key_search->from_index = false;
+            r = ifapi_keystore_list_all(keystore,
+                                        "/", /**< search keys and NV objects in store */
+                                        &key_search->pathlist,
+                                        &key_search->numPaths);
+            goto_if_error2(r, "Get entities.", cleanup);
+
+            key_search->append_index = false;
+            if (key_search->index_state.complete && !key_search->index_stale &&
+                ifapi_index_unindexed(keystore->index_file, keystore_index_object_file,
+                                      keystore, key_search->pathlist,
+                                      &key_search->numPaths,
+                                      &key_search->append_index) != TSS2_RC_SUCCESS) {
+                LOG_WARNING("Keystore index %s could not be read.", keystore->index_file);
+            }
+            key_search->path_idx = key_search->numPaths;
+        }
+
         /* Use the next object in the path list */
-        if (keystore->key_search.path_idx == 0) {
+        if (key_search->path_idx == 0) {
+            /* All objects were read, add the collected records to the index. */
+            if (key_search->append_index)
+                r = ifapi_index_append(keystore->index_file, key_search->index_records);
+            else
+                r = ifapi_index_rewrite(keystore->index_file, key_search->index_records,
+                                        &key_search->index_state);
+            if (r != TSS2_RC_SUCCESS) {
+                LOG_WARNING("Keystore index %s could not be written.",
+                            keystore->index_file);
+            }
+            if (key_search->found_path) {
+                *found_path = key_search->found_path;
+                key_search->found_path = NULL;
+                r = TSS2_RC_SUCCESS;
+                break;
+            }
             goto_error(r, TSS2_FAPI_RC_PATH_NOT_FOUND, "Key not found.", cleanup);
         }
-        keystore->key_search.path_idx -= 1;
-        path_idx = keystore->key_search.path_idx;
-        path = keystore->key_search.pathlist[path_idx];
-        LOG_TRACE("Check file: %s %zu", path, keystore->key_search.path_idx);
+        if (!key_search->from_index)
+            keystore_search_prefetch(keystore, io, key_search);
+        key_search->path_idx -= 1;
+        path_idx = key_search->path_idx;
+        path = key_search->pathlist[path_idx];
+        LOG_TRACE("Check file: %s %zu", path, key_search->path_idx);
 
         /* Skip policy files. */
         if (ifapi_path_type_p(path, IFAPI_POLICY_PATH)) {
@@ -1200,45 +1554,85 @@ keystore_search_obj(
         }
 
         r = ifapi_keystore_load_async(keystore, io, path);
+        if (r != TSS2_RC_SUCCESS && key_search->from_index) {
+            /* The index is outdated, try the next candidate. */
+            LOG_DEBUG("Indexed object %s could not be opened.", path);
+            key_search->index_stale = true;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
         return_if_error2(r, "Could not open: %s", path);
 
         fallthrough;
 
-    statecase(keystore->key_search.state, KSEARCH_READ)
+    statecase(key_search->state, KSEARCH_READ)
         r = ifapi_keystore_load_finish(keystore, io, &object);
         return_try_again(r);
+        if (r != TSS2_RC_SUCCESS && key_search->from_index) {
+            LOG_DEBUG("Indexed object %s could not be read.",
+                      key_search->pathlist[key_search->path_idx]);
+            key_search->index_stale = true;
+            key_search->state = KSEARCH_SEARCH_OBJECT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
         goto_if_error(r, "read_finish failed", cleanup);
 
+        path_idx = key_search->path_idx;
+        path = key_search->pathlist[path_idx];
+
+        if (!key_search->from_index) {
+            /* Collect the index record of every object read. */
+            r = keystore_index_keys(&object, &keys);
+            if (r == TSS2_RC_SUCCESS && keys &&
+                rel_path_to_abs_path(keystore, path, &file) != TSS2_RC_SUCCESS) {
+                /* The record is stored without the version of the file. */
+                SAFE_FREE(file);
+            }
+            if (r == TSS2_RC_SUCCESS && keys)
+                r = ifapi_index_add_record(&key_search->index_records, path, file, keys);
+            SAFE_FREE(keys);
+            SAFE_FREE(file);
+        }
+
         /* Check whether the key has the passed name */
-        bool keys_equal;
-        r = cmp_function(&object, cmp_object, &keys_equal);
+        bool keys_equal = false;
+        if (r == TSS2_RC_SUCCESS)
+            r = cmp_function(&object, cmp_object, &keys_equal);
         ifapi_cleanup_ifapi_object(&object);
         goto_if_error(r, "Invalid object.", cleanup);
 
-        if (!keys_equal) {
-            /* Try next key */
-            keystore->key_search.state = KSEARCH_SEARCH_OBJECT;
-            return TSS2_FAPI_RC_TRY_AGAIN;
+        if (!keys_equal && key_search->from_index) {
+            /* The object does not have the key stored in the index anymore. */
+            key_search->index_stale = true;
         }
-        /* Key found, the absolute path will be converted to relative path. */
-        path_idx = keystore->key_search.path_idx;
-        *found_path = strdup(keystore->key_search.pathlist[path_idx]);
-        goto_if_null(*found_path, "Out of memory.",
-                     TSS2_FAPI_RC_MEMORY, cleanup);
-        full_path_to_fapi_path(keystore, *found_path);
-        break;
+        if (keys_equal && key_search->from_index) {
+            *found_path = strdup(path);
+            goto_if_null(*found_path, "Out of memory.",
+                         TSS2_FAPI_RC_MEMORY, cleanup);
+            break;
+        }
+        if (keys_equal && !key_search->found_path) {
+            /* Keep the first match and read the remaining objects for the index. */
+            key_search->found_path = strdup(path);
+            goto_if_null(key_search->found_path, "Out of memory.",
+                         TSS2_FAPI_RC_MEMORY, cleanup);
+        }
+        /* Try next key */
+        key_search->state = KSEARCH_SEARCH_OBJECT;
+        return TSS2_FAPI_RC_TRY_AGAIN;
 
-    statecasedefault(keystore->key_search.state);
+    statecasedefault(key_search->state);
     }
 cleanup:
-    for (i = 0; i < keystore->key_search.numPaths; i++)
-        free(keystore->key_search.pathlist[i]);
-    free(keystore->key_search.pathlist);
+    keystore_search_free_paths(key_search);
+    ifapi_io_batch_cleanup(io);
+    SAFE_FREE(key_search->index_records);
+    SAFE_FREE(key_search->found_path);
+    SAFE_FREE(key_search->index_key);
     if (!*found_path) {
         LOG_ERROR("Object not found");
         r = TSS2_FAPI_RC_KEY_NOT_FOUND;
     }
-    keystore->key_search.state = KSEARCH_INIT;
+    key_search->state = KSEARCH_INIT;
     return r;
 }
 
@@ -1275,6 +1669,14 @@ ifapi_keystore_search_obj(
     TPM2B_NAME *name,
     char **found_path)
 {
+    TSS2_RC r;
+
+    if (keystore->key_search.state == KSEARCH_INIT) {
+        SAFE_FREE(keystore->key_search.index_key);
+        r = ifapi_index_add_key(&keystore->key_search.index_key, "name",
+                                &name->name[0], name->size);
+        return_if_error(r, "Create index key.");
+    }
     return keystore_search_obj(keystore, io, name,
                                ifapi_object_cmp_name, found_path);
 }
@@ -1313,6 +1715,19 @@ ifapi_keystore_search_nv_obj(
     TPM2B_NV_PUBLIC *nv_public,
     char **found_path)
 {
+    TSS2_RC r;
+    UINT8 nv_index[sizeof(TPM2_HANDLE)];
+
+    if (keystore->key_search.state == KSEARCH_INIT) {
+        r = Tss2_MU_TPM2_HANDLE_Marshal(nv_public->nvPublic.nvIndex,
+                                        &nv_index[0], sizeof(nv_index), NULL);
+        return_if_error(r, "Marshal NV index.");
+
+        SAFE_FREE(keystore->key_search.index_key);
+        r = ifapi_index_add_key(&keystore->key_search.index_key, "nv",
+                                &nv_index[0], sizeof(nv_index));
+        return_if_error(r, "Create index key.");
+    }
     return keystore_search_obj(keystore, io, nv_public,
                                ifapi_object_cmp_nv_public, found_path);
 }
@@ -1652,6 +2067,13 @@ ifapi_cleanup_ifapi_keystore(IFAPI_KEYSTORE * keystore) {
         SAFE_FREE(keystore->systemdir);
         SAFE_FREE(keystore->userdir);
         SAFE_FREE(keystore->defaultprofile);
+        SAFE_FREE(keystore->index_file);
+        SAFE_FREE(keystore->index_path);
+        SAFE_FREE(keystore->index_keys);
+        SAFE_FREE(keystore->index_object);
+        SAFE_FREE(keystore->key_search.index_key);
+        SAFE_FREE(keystore->key_search.index_records);
+        SAFE_FREE(keystore->key_search.found_path);
     }
 }
 
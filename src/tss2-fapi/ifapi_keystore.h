@@ -13,8 +13,13 @@
 #include "tss2_tpm2_types.h"
 #include "fapi_types.h"
 #include "ifapi_policy_types.h"
+#include "ifapi_index.h"
+#include "ifapi_io.h"
 #include "tss2_esys.h"
 
+/** Number of objects read in one batch during a full keystore search */
+#define IFAPI_KEYSTORE_PREFETCH IFAPI_IO_BATCH_SIZE
+
 typedef UINT32 IFAPI_OBJECT_TYPE_CONSTANT;
 #define IFAPI_OBJ_NONE                 0    /**< Tag for key resource */
 #define IFAPI_KEY_OBJ                  1    /**< Tag for key resource */
@@ -108,6 +113,13 @@ typedef struct {
     size_t path_idx;                /**< Index of array of objects to be searched */
     size_t numPaths;                /**< Number of all objects in data store */
     char **pathlist;                /**< The array of all objects  in the search path */
+    char *index_key;                /**< The key of the searched object in the index */
+    bool from_index;                /**< The path list contains the candidates from the index */
+    bool index_stale;               /**< An indexed object did not match the index */
+    bool append_index;              /**< Only the objects without a trusted record are read */
+    IFAPI_INDEX_STATE index_state;  /**< The state of the index before the search */
+    char *index_records;            /**< The index records collected during a full search */
+    char *found_path;               /**< The first object found during a full search */
     enum FAPI_SEARCH_STATE state;
 } IFAPI_KEY_SEARCH;
 
@@ -117,6 +129,11 @@ typedef struct IFAPI_KEYSTORE {
     char *defaultprofile;
     IFAPI_KEY_SEARCH key_search;
     const char* rel_path;
+    char *index_file;               /**< The index mapping names and digests to paths */
+    char *index_path;               /**< The path of the object currently stored */
+    char *index_keys;               /**< The index keys of the object currently stored */
+    char *index_object;             /**< The file of the object currently stored */
+    bool binary;                    /**< Store objects in the binary encoding */
 } IFAPI_KEYSTORE;
 
 
@@ -198,6 +215,17 @@ ifapi_keystore_list_all(
     char ***results,
     size_t *numresults);
 
+TSS2_RC
+ifapi_keystore_list_next(
+    IFAPI_KEYSTORE *keystore,
+    IFAPI_DIR_WALK *walk,
+    const char *searchpath,
+    const char *cursor,
+    size_t max_results,
+    char ***results,
+    size_t *numresults,
+    char **next_cursor);
+
 TSS2_RC
 ifapi_keystore_delete(
      IFAPI_KEYSTORE *keystore,
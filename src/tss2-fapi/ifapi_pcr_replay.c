@@ -0,0 +1,274 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ifapi_pcr_replay.h"
+
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** Compare two JSON values.
+ *
+ * Objects are equal if they have the same keys with equal values, the order
+ * of the keys is not relevant.
+ *
+ * @param[in] jso1 The first value.
+ * @param[in] jso2 The second value.
+ * @retval true if the values are equal.
+ * @retval false otherwise.
+ */
+static bool
+pcr_replay_json_equal(
+    json_object *jso1,
+    json_object *jso2)
+{
+    json_type type = json_object_get_type(jso1);
+    json_object *jso;
+    size_t i, n;
+
+    if (jso1 == jso2)
+        return true;
+    if (!jso1 || !jso2 || type != json_object_get_type(jso2))
+        return false;
+
+    switch (type) {
+    case json_type_boolean:
+        return json_object_get_boolean(jso1) == json_object_get_boolean(jso2);
+    case json_type_double:
+        return json_object_get_double(jso1) == json_object_get_double(jso2);
+    case json_type_int:
+        /* Values beyond INT64_MAX are clamped by json_object_get_int64. */
+        if (json_object_get_int64(jso1) != json_object_get_int64(jso2))
+            return false;
+        return json_object_get_int64(jso1) != INT64_MAX ||
+            strcmp(json_object_to_json_string(jso1),
+                   json_object_to_json_string(jso2)) == 0;
+    case json_type_string:
+        n = json_object_get_string_len(jso1);
+        return n == (size_t) json_object_get_string_len(jso2) &&
+            memcmp(json_object_get_string(jso1), json_object_get_string(jso2), n) == 0;
+    case json_type_array:
+        n = json_object_array_length(jso1);
+        if (n != json_object_array_length(jso2))
+            return false;
+        for (i = 0; i < n; i++) {
+            if (!pcr_replay_json_equal(json_object_array_get_idx(jso1, i),
+                                       json_object_array_get_idx(jso2, i)))
+                return false;
+        }
+        return true;
+    case json_type_object:
+        if (json_object_object_length(jso1) != json_object_object_length(jso2))
+            return false;
+        json_object_object_foreach(jso1, key, val) {
+            if (!json_object_object_get_ex(jso2, key, &jso) ||
+                !pcr_replay_json_equal(val, jso))
+                return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+/** Check whether a checkpoint was computed for certain virtual PCRs.
+ *
+ * @param[in] checkpoint The checkpoint.
+ * @param[in] pcrs The virtual PCRs to be computed.
+ * @param[in] n_pcrs The number of virtual PCRs.
+ * @retval true if the checkpoint holds the same banks and registers.
+ * @retval false otherwise.
+ */
+static bool
+pcr_replay_same_selection(
+    const IFAPI_PCR_CHECKPOINT *checkpoint,
+    const IFAPI_VPCR *pcrs,
+    size_t n_pcrs)
+{
+    size_t i;
+
+    if (checkpoint->n_pcrs != n_pcrs)
+        return false;
+    for (i = 0; i < n_pcrs; i++) {
+        if (checkpoint->pcrs[i].bank != pcrs[i].bank ||
+            checkpoint->pcrs[i].pcr != pcrs[i].pcr)
+            return false;
+    }
+    return true;
+}
+
+/** Check whether an event list starts with the events of a checkpoint.
+ *
+ * @param[in] checkpoint The checkpoint.
+ * @param[in] jso_event_list The event list in JSON representation.
+ * @retval true if the first events of the list equal those of the checkpoint.
+ * @retval false otherwise.
+ */
+static bool
+pcr_replay_same_events(
+    const IFAPI_PCR_CHECKPOINT *checkpoint,
+    json_object *jso_event_list)
+{
+    size_t i;
+
+    for (i = 0; i < checkpoint->n_events; i++) {
+        if (!pcr_replay_json_equal(checkpoint->events[i],
+                                   json_object_array_get_idx(jso_event_list, i)))
+            return false;
+    }
+    return true;
+}
+
+/** Release the events of a checkpoint and mark it unused.
+ *
+ * @param[in,out] checkpoint The checkpoint.
+ */
+static void
+pcr_replay_release(
+    IFAPI_PCR_CHECKPOINT *checkpoint)
+{
+    size_t i;
+
+    for (i = 0; i < checkpoint->n_events; i++)
+        json_object_put(checkpoint->events[i]);
+    SAFE_FREE(checkpoint->events);
+    checkpoint->n_events = 0;
+}
+
+/** Search the checkpoint of a former replay of an event list.
+ *
+ * The checkpoints for the same PCRs are tried in the order of their number
+ * of events. A checkpoint is used if the list starts with events equal to
+ * the events of the checkpoint, so a list whose earlier events were changed
+ * is replayed completely. Neither the events of the list are serialized nor
+ * is any digest computed. The PCR values of the checkpoint found are copied
+ * to pcrs.
+ *
+ * @param[in] cache The replay cache.
+ * @param[in] jso_event_list The event list in JSON representation.
+ * @param[in,out] pcrs The virtual PCRs to be computed.
+ * @param[in] n_pcrs The number of virtual PCRs.
+ * @param[out] checkpoint The checkpoint found or NULL.
+ */
+void
+ifapi_pcr_replay_lookup(
+    IFAPI_PCR_REPLAY_CACHE *cache,
+    json_object *jso_event_list,
+    IFAPI_VPCR *pcrs,
+    size_t n_pcrs,
+    IFAPI_PCR_CHECKPOINT **checkpoint)
+{
+    IFAPI_PCR_CHECKPOINT *entry;
+    bool candidate[IFAPI_PCR_CHECKPOINTS];
+    size_t i, n_events = json_object_array_length(jso_event_list);
+
+    *checkpoint = NULL;
+
+    for (i = 0; i < IFAPI_PCR_CHECKPOINTS; i++) {
+        entry = &cache->checkpoints[i];
+        candidate[i] = entry->n_events > 0 && entry->n_events <= n_events &&
+            pcr_replay_same_selection(entry, pcrs, n_pcrs);
+    }
+
+    for (;;) {
+        entry = NULL;
+        for (i = 0; i < IFAPI_PCR_CHECKPOINTS; i++) {
+            if (candidate[i] && (!entry ||
+                                 cache->checkpoints[i].n_events > entry->n_events))
+                entry = &cache->checkpoints[i];
+        }
+        if (!entry)
+            return;
+        candidate[entry - &cache->checkpoints[0]] = false;
+        if (pcr_replay_same_events(entry, jso_event_list))
+            break;
+    }
+
+    LOG_DEBUG("Replay event list from event %zu", entry->n_events);
+    for (i = 0; i < n_pcrs; i++)
+        pcrs[i].value = entry->pcrs[i].value;
+    *checkpoint = entry;
+}
+
+/** Store the virtual PCR values computed from an event list in the replay cache.
+ *
+ * References to the events of the list are stored with the checkpoint. If
+ * the checkpoint found by ifapi_pcr_replay_lookup() is replaced, only the
+ * events appended since then are added to it.
+ *
+ * @param[in,out] cache The replay cache.
+ * @param[in,out] checkpoint The checkpoint to be replaced or NULL. If NULL an
+ *                unused or the least recently used checkpoint is replaced.
+ * @param[in] jso_event_list The replayed event list in JSON representation.
+ * @param[in] pcrs The virtual PCRs computed from the event list.
+ * @param[in] n_pcrs The number of virtual PCRs.
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+TSS2_RC
+ifapi_pcr_replay_store(
+    IFAPI_PCR_REPLAY_CACHE *cache,
+    IFAPI_PCR_CHECKPOINT *checkpoint,
+    json_object *jso_event_list,
+    const IFAPI_VPCR *pcrs,
+    size_t n_pcrs)
+{
+    json_object **events;
+    size_t i, n_events = json_object_array_length(jso_event_list);
+
+    /* An empty list needs no checkpoint. */
+    if (n_events == 0)
+        return TSS2_RC_SUCCESS;
+
+    if (!checkpoint) {
+        checkpoint = &cache->checkpoints[0];
+        for (i = 1; i < IFAPI_PCR_CHECKPOINTS && checkpoint->n_events; i++) {
+            if (cache->checkpoints[i].n_events == 0 ||
+                cache->checkpoints[i].last_use < checkpoint->last_use)
+                checkpoint = &cache->checkpoints[i];
+        }
+        pcr_replay_release(checkpoint);
+    }
+
+    events = realloc(checkpoint->events, n_events * sizeof(json_object *));
+    if (!events) {
+        pcr_replay_release(checkpoint);
+        return_error(TSS2_FAPI_RC_MEMORY, "Out of memory");
+    }
+    checkpoint->events = events;
+
+    /* The events of the checkpoint equal the first events of the list. */
+    for (i = checkpoint->n_events; i < n_events; i++)
+        events[i] = json_object_get(json_object_array_get_idx(jso_event_list, i));
+
+    checkpoint->n_events = n_events;
+    checkpoint->last_use = ++cache->clock;
+    checkpoint->n_pcrs = n_pcrs;
+    memcpy(&checkpoint->pcrs[0], pcrs, n_pcrs * sizeof(IFAPI_VPCR));
+    return TSS2_RC_SUCCESS;
+}
+
+/** Release the replay cache and the events referenced by its checkpoints.
+ *
+ * @param[in,out] cache The replay cache, which will be set to NULL.
+ */
+void
+ifapi_pcr_replay_cache_free(
+    IFAPI_PCR_REPLAY_CACHE **cache)
+{
+    size_t i;
+
+    if (!cache || !*cache)
+        return;
+    for (i = 0; i < IFAPI_PCR_CHECKPOINTS; i++)
+        pcr_replay_release(&(*cache)->checkpoints[i]);
+    SAFE_FREE(*cache);
+}
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef IFAPI_PCR_REPLAY_H
+#define IFAPI_PCR_REPLAY_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+
+#include "tss2_common.h"
+#include "tss2_tpm2_types.h"
+
+/** Number of checkpoints stored in the PCR replay cache. */
+#define IFAPI_PCR_CHECKPOINTS 16
+
+/** A virtual PCR computed from an event list.
+ */
+typedef struct {
+    TPMI_ALG_HASH bank;              /**< The PCR bank */
+    TPM2_HANDLE pcr;                 /**< The PCR register */
+    TPM2B_DIGEST value;              /**< The PCR value */
+} IFAPI_VPCR;
+
+/** Checkpoint of the replay of an event list.
+ *
+ * The virtual PCR values computed from the first n_events events of an event
+ * list. The checkpoint holds a reference to each of these events, another
+ * list is continued from the checkpoint if it starts with equal events.
+ */
+typedef struct {
+    size_t n_events;                 /**< Number of replayed events; 0 for an unused entry */
+    UINT64 last_use;                 /**< Clock value of the last use of the checkpoint */
+    json_object **events;            /**< The replayed events */
+    size_t n_pcrs;                   /**< Number of virtual PCRs */
+    IFAPI_VPCR pcrs[TPM2_MAX_PCRS];  /**< The virtual PCRs */
+} IFAPI_PCR_CHECKPOINT;
+
+/** Cache of event list replays used by Fapi_VerifyQuote.
+ *
+ * If an event list was verified before and has only grown, only the new
+ * events have to be replayed.
+ */
+typedef struct {
+    IFAPI_PCR_CHECKPOINT checkpoints[IFAPI_PCR_CHECKPOINTS];
+    UINT64 clock;                    /**< Counter for the least recently used replacement */
+} IFAPI_PCR_REPLAY_CACHE;
+
+void
+ifapi_pcr_replay_lookup(
+    IFAPI_PCR_REPLAY_CACHE *cache,
+    json_object *jso_event_list,
+    IFAPI_VPCR *pcrs,
+    size_t n_pcrs,
+    IFAPI_PCR_CHECKPOINT **checkpoint);
+
+TSS2_RC
+ifapi_pcr_replay_store(
+    IFAPI_PCR_REPLAY_CACHE *cache,
+    IFAPI_PCR_CHECKPOINT *checkpoint,
+    json_object *jso_event_list,
+    const IFAPI_VPCR *pcrs,
+    size_t n_pcrs);
+
+void
+ifapi_pcr_replay_cache_free(
+    IFAPI_PCR_REPLAY_CACHE **cache);
+
+#endif /* IFAPI_PCR_REPLAY_H */
@@ -19,6 +19,7 @@
 #include "ifapi_policyutil_execute.h"
 #include "ifapi_policy_execute.h"
 #include "ifapi_policy_callbacks.h"
+#include "ifapi_policy_search.h"
 #include "tss2_mu.h"
 
 #define LOGMODULE fapi
@@ -834,169 +835,41 @@ compare_policy_digest(
     return TSS2_RC_SUCCESS;
 }
 
-/** Search a policy file which fulfills a certain predicate.
- *
- * @param[in] context The context for storing the state information of the search
-              process and the keystore paths.
- * @param[in] compare The function which will be used for comparison.
- * @param[in] all_objects Switch which determines wheter all policies fulfilling the
- *            the condition will be returned or only the first policy.
- * @param[in] object1 The first object used for comparison.
- * @param[in] object2 The second object used for comparison.
- * @param[out] policy_found The linked list with the policies fulfilling the condition.
+/** Compute the policy store index key for a policy digest.
  *
+ * @param[in] authPolicyVoid The digest to be searched.
+ * @param[in] nameAlgVoid The hash algorithm used for the digest computation.
+ * @param[out] key The index key. (callee-allocated)
  * @retval TSS2_RC_SUCCESS on success.
- * @retval TSS2_FAPI_RC_POLICY_UNKNOWN if policy search for a certain policy digest
- *         was not successful.
- * @retval TSS2_FAPI_RC_TRY_AGAIN if an I/O operation is not finished yet and
- *         this function needs to be called again.
  * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
- * @retval TSS2_FAPI_RC_BAD_VALUE if an invalid value was passed into
- *         the function.
- * @retval TSS2_FAPI_RC_IO_ERROR if an error occurred while accessing the
- *         object store.
- * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
- * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
- * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
- *         or contains illegal characters.
- * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
- *         during authorization.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an invalid digest was passed.
  */
 static TSS2_RC
-search_policy(
-    FAPI_CONTEXT *context,
-    Policy_Compare_Object compare,
-    bool all_objects,
-    void *object1,
-    void *object2,
-    struct POLICY_LIST **policy_found)
+policy_digest_index_key(
+    void *authPolicyVoid,
+    void *nameAlgVoid,
+    char **key)
 {
-    TSS2_RC r = TSS2_RC_SUCCESS;
-    char *path;
-    TPMS_POLICY policy = { 0 };
-    bool found;
-    struct POLICY_LIST *policy_object = NULL;
-    struct POLICY_LIST *second;
-
-    switch (context->fsearch.state) {
-    case FSEARCH_INIT:
-        LOG_DEBUG("** STATE ** FSEARCH_INIT");
-        memset(&context->fsearch, 0, sizeof(IFAPI_FILE_SEARCH_CTX));
-        /* Get the list of all files. */
-        r = ifapi_keystore_list_all(&context->keystore, IFAPI_POLICY_DIR, &context->fsearch.pathlist,
-                                    &context->fsearch.numPaths);
-        return_if_error(r, "get entities.");
-        context->fsearch.path_idx = context->fsearch.numPaths;
-
-        context->fsearch.state = FSEARCH_OBJECT;
-    /* FALLTHRU */
-
-    case FSEARCH_OBJECT:
-        LOG_DEBUG("** STATE ** FSEARCH_OBJECT");
-
-        /* Test whether all files have been checked. */
-        if (context->fsearch.path_idx == 0) {
-            if (*policy_found) {
-                context->fsearch.state = FSEARCH_INIT;
-                for (size_t i = 0; i < context->fsearch.numPaths; i++) {
-                    SAFE_FREE(context->fsearch.pathlist[i]);
-                }
-                SAFE_FREE(context->fsearch.pathlist);
-                return TSS2_RC_SUCCESS;
-            }
-            goto_error(r, TSS2_FAPI_RC_POLICY_UNKNOWN, "Policy not found.", cleanup);
-        }
-        context->fsearch.path_idx -= 1;
-        path = context->fsearch.pathlist[context->fsearch.path_idx];
-        context->fsearch.current_path = path;
-        LOG_DEBUG("Check file: %s %zu", path, context->fsearch.path_idx);
-
-        /* Prepare policy loading. */
-        r = ifapi_policy_store_load_async(&context->pstore, &context->io, path);
-        goto_if_error2(r, "Can't open: %s", cleanup, path);
-
-        context->fsearch.state = FSEARCH_READ;
-    /* FALLTHRU */
-
-    case FSEARCH_READ:
-        LOG_DEBUG("** STATE ** FSEARCH_READ");
-        /* Finalize policy loading if possible. */
-        r = ifapi_policy_store_load_finish(&context->pstore, &context->io, &policy);
-        return_try_again(r);
-        goto_if_error(r, "read_finish failed", cleanup);
-
-        /* Call the passed compare function. */
-        r = compare(&policy, object1, object2, &found);
-        if (found) {
-            LOG_DEBUG("compare true  %s",
-                      context->fsearch.pathlist[context->fsearch.path_idx]);
-        } else {
-            LOG_DEBUG("compare false  %s",
-                      context->fsearch.pathlist[context->fsearch.path_idx]);
-        }
-        goto_if_error(r, "Invalid cipher object.", cleanup);
-
-        if (!found) {
-            if (!all_objects && context->fsearch.path_idx == 0) {
-                /* All files checked, but no policy found. */
-                context->fsearch.state = FSEARCH_INIT;
-                ifapi_cleanup_policy(&policy);
-                return TSS2_BASE_RC_POLICY_UNKNOWN;
-            } else {
-                /* Continue search. */
-                context->fsearch.state = FSEARCH_OBJECT;
-                ifapi_cleanup_policy(&policy);
-                return TSS2_FAPI_RC_TRY_AGAIN;
-            }
-        }
-        /* Extend linked list.*/
-        policy_object = calloc(sizeof(struct POLICY_LIST), 1);
-        return_if_null(policy_object, "Out of memory.", TSS2_FAPI_RC_MEMORY);
-
-        strdup_check(policy_object->path, context->fsearch.current_path, r, cleanup);
-        policy_object->policy = policy;
-        if (*policy_found != NULL) {
-            second = *policy_found;
-            policy_object->next = second;
-        }
-        *policy_found = policy_object;
-
-        if (context->fsearch.path_idx == 0) {
-            context->fsearch.state = FSEARCH_INIT;
-            /* Cleanup list of all paths. */
-            for (size_t i = 0; i < context->fsearch.numPaths; i++) {
-                SAFE_FREE(context->fsearch.pathlist[i]);
-            }
-            SAFE_FREE(context->fsearch.pathlist);
-            return TSS2_RC_SUCCESS;
-        }
-
-        if (all_objects) {
-            context->fsearch.state = FSEARCH_OBJECT;
-            return TSS2_FAPI_RC_TRY_AGAIN;
-        }
-
-        break;
+    return ifapi_policy_digest_index_key(*(TPMI_ALG_HASH *)nameAlgVoid,
+                                         authPolicyVoid, key);
+}
 
-    default:
-        context->state = _FAPI_STATE_INTERNALERROR;
-        goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Invalid state for load key.", cleanup);
-    }
-    context->fsearch.state = FSEARCH_INIT;
-    for (size_t i = 0; i < context->fsearch.numPaths; i++) {
-        SAFE_FREE(context->fsearch.pathlist[i]);
-    }
-    SAFE_FREE(context->fsearch.pathlist);
-    return TSS2_RC_SUCCESS;
-cleanup:
-    SAFE_FREE(policy_object);
-    ifapi_cleanup_policy(&policy);
-    for (size_t i = 0; i < context->fsearch.numPaths; i++) {
-        SAFE_FREE(context->fsearch.pathlist[i]);
-    }
-    SAFE_FREE(context->fsearch.pathlist);
-    context->fsearch.state = FSEARCH_INIT;
-    return r;
+/** Compute the policy store index key for a policy authorization.
+ *
+ * @param[in] publicVoid The public information of the key.
+ * @param[in] policyRefVoid The policy reference.
+ * @param[out] key The index key. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the key can't be marshaled.
+ */
+static TSS2_RC
+policy_authorization_index_key(
+    void *publicVoid,
+    void *policyRefVoid,
+    char **key)
+{
+    return ifapi_policy_authorization_index_key(publicVoid, policyRefVoid, key);
 }
 
 /** Get policy digest for a certain hash alg.
@@ -1085,25 +958,6 @@ get_policy_signature(
     return TSS2_FAPI_RC_GENERAL_FAILURE;
 }
 
-/** Cleanup a linked list of policies.
- *
- * @param[in] The linked list.
- */
-static void
-cleanup_policy_list(struct POLICY_LIST * list) {
-    if (list) {
-        struct POLICY_LIST * branch = list;
-        while (branch) {
-            struct POLICY_LIST *next = branch->next;
-            /* Cleanup the policy stored in the list. */
-            ifapi_cleanup_policy(&branch->policy);
-            SAFE_FREE(branch->path);
-            SAFE_FREE(branch);
-            branch = next;
-        }
-    }
-}
-
 /** Callback for retrieving, selecting and execute a authorized policy.
  *
  * All policies authorized by a certain key will be retrieved and one policy
@@ -1184,10 +1038,11 @@ ifapi_exec_auth_policy(
             fallthrough;
 
         statecase(cb_ctx->cb_state, POL_CB_SEARCH_POLICY)
-            r = search_policy(fapi_ctx,
-                              equal_policy_authorization, true,
-                              key_public, policyRef,
-                              &current_policy->policy_list);
+            r = ifapi_policy_search(fapi_ctx,
+                                    equal_policy_authorization,
+                                    policy_authorization_index_key, true,
+                                    key_public, policyRef,
+                                    &current_policy->policy_list);
             FAPI_SYNC(r, "Search policy", cleanup);
 
             if (current_policy->policy_list->next) {
@@ -1283,7 +1138,7 @@ ifapi_exec_auth_policy(
     }
 cleanup:
     SAFE_FREE(names);
-    cleanup_policy_list(current_policy->policy_list);
+    ifapi_cleanup_policy_list(current_policy->policy_list);
     return r;
 }
 
@@ -1417,9 +1272,10 @@ ifapi_exec_auth_nv_policy(
 
         statecase(cb_ctx->cb_state, POL_CB_SEARCH_POLICY)
             /* Search policy appropriate in object store */
-            r = search_policy(fapi_ctx, compare_policy_digest, false,
-                              &cb_ctx->policy_digest, &hash_alg,
-                              &current_policy->policy_list);
+            r = ifapi_policy_search(fapi_ctx, compare_policy_digest,
+                                    policy_digest_index_key, false,
+                                    &cb_ctx->policy_digest, &hash_alg,
+                                    &current_policy->policy_list);
             FAPI_SYNC(r, "Search policy", cleanup);
 
             if (!current_policy->policy_list) {
@@ -1444,7 +1300,7 @@ ifapi_exec_auth_nv_policy(
         statecasedefault_error(cb_ctx->state, r, cleanup);
     }
 cleanup:
-    cleanup_policy_list(current_policy->policy_list);
+    ifapi_cleanup_policy_list(current_policy->policy_list);
     SAFE_FREE(nv_path);
     return r;
 
@@ -27,6 +27,11 @@ typedef TSS2_RC(*Policy_Compare_Object)(
     void *object2,
     bool *found);
 
+typedef TSS2_RC(*Policy_Index_Key)(
+    void *object1,
+    void *object2,
+    char **key);
+
 /** List of policies which fulfill a certain predicate.
  *
  * The elements are stored in a linked list.
@@ -0,0 +1,301 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "ifapi_policy_search.h"
+#include "ifapi_helpers.h"
+#include "ifapi_index.h"
+
+#define LOGMODULE fapi
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/** Cleanup a linked list of policies.
+ *
+ * @param[in] The linked list.
+ */
+void
+ifapi_cleanup_policy_list(struct POLICY_LIST * list) {
+    if (list) {
+        struct POLICY_LIST * branch = list;
+        while (branch) {
+            struct POLICY_LIST *next = branch->next;
+            /* Cleanup the policy stored in the list. */
+            ifapi_cleanup_policy(&branch->policy);
+            SAFE_FREE(branch->path);
+            SAFE_FREE(branch);
+            branch = next;
+        }
+    }
+}
+
+/** Free the path list of the policy search.
+ *
+ * @param[in,out] fsearch The state information of the search.
+ */
+static void
+search_policy_free_paths(IFAPI_FILE_SEARCH_CTX *fsearch)
+{
+    for (size_t i = 0; i < fsearch->numPaths; i++) {
+        SAFE_FREE(fsearch->pathlist[i]);
+    }
+    SAFE_FREE(fsearch->pathlist);
+    fsearch->numPaths = 0;
+    fsearch->path_idx = 0;
+}
+
+/** Compute the file of a policy for the policy store index.
+ *
+ * @param[in] ctx The policy store.
+ * @param[in] path The relative path of the policy.
+ * @param[out] file The absolute path of the policy file. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+static TSS2_RC
+policy_index_object_file(void *ctx, const char *path, char **file)
+{
+    return ifapi_policy_store_file((IFAPI_POLICY_STORE *)ctx, path, file);
+}
+
+/** Search a policy file which fulfills a certain predicate.
+ *
+ * First the candidates stored in the policy store index for the key
+ * computed by index_key are checked. The result of the index is used if
+ * the first policy is searched and a candidate fulfills the predicate.
+ * Otherwise, if the index is complete and every candidate fulfilled the
+ * predicate, the policies without a trusted index record are read in
+ * addition and their records are appended to the index. These are the
+ * policies copied into the policy directory and the policies stored by
+ * older releases, which did not write index records. In all other cases
+ * all policy files are read and the index is rebuilt from these policies.
+ *
+ * @param[in] context The context for storing the state information of the search
+              process and the keystore paths.
+ * @param[in] compare The function which will be used for comparison.
+ * @param[in] index_key The function computing the index key for object1 and
+ *            object2.
+ * @param[in] all_objects Switch which determines wheter all policies fulfilling the
+ *            the condition will be returned or only the first policy.
+ * @param[in] object1 The first object used for comparison.
+ * @param[in] object2 The second object used for comparison.
+ * @param[out] policy_found The linked list with the policies fulfilling the condition.
+ *
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_POLICY_UNKNOWN if policy search for a certain policy digest
+ *         was not successful.
+ * @retval TSS2_FAPI_RC_TRY_AGAIN if an I/O operation is not finished yet and
+ *         this function needs to be called again.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an invalid value was passed into
+ *         the function.
+ * @retval TSS2_FAPI_RC_IO_ERROR if an error occurred while accessing the
+ *         object store.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if an internal error occurred.
+ * @retval TSS2_FAPI_RC_BAD_REFERENCE a invalid null pointer is passed.
+ * @retval TSS2_FAPI_RC_BAD_PATH if the path is used in inappropriate context
+ *         or contains illegal characters.
+ * @retval TSS2_FAPI_RC_PATH_NOT_FOUND if a FAPI object path was not found
+ *         during authorization.
+ */
+TSS2_RC
+ifapi_policy_search(
+    FAPI_CONTEXT *context,
+    Policy_Compare_Object compare,
+    Policy_Index_Key index_key,
+    bool all_objects,
+    void *object1,
+    void *object2,
+    struct POLICY_LIST **policy_found)
+{
+    TSS2_RC r = TSS2_RC_SUCCESS;
+    char *path;
+    char *key = NULL;
+    char *file = NULL;
+    TPMS_POLICY policy = { 0 };
+    bool found;
+    struct POLICY_LIST *policy_object = NULL;
+    struct POLICY_LIST *second;
+    IFAPI_FILE_SEARCH_CTX *fsearch = &context->fsearch;
+
+    switch (fsearch->state) {
+    case FSEARCH_INIT:
+        LOG_DEBUG("** STATE ** FSEARCH_INIT");
+        memset(fsearch, 0, sizeof(IFAPI_FILE_SEARCH_CTX));
+        /* Get the candidates from the index, a missing index yields no candidates. */
+        r = index_key(object1, object2, &key);
+        if (r == TSS2_RC_SUCCESS)
+            r = ifapi_index_lookup(context->pstore.index_file, key,
+                                   &fsearch->pathlist, &fsearch->numPaths,
+                                   &fsearch->index_state);
+        SAFE_FREE(key);
+        if (r != TSS2_RC_SUCCESS) {
+            LOG_WARNING("Policy index %s could not be used.", context->pstore.index_file);
+            fsearch->pathlist = NULL;
+            fsearch->numPaths = 0;
+        }
+        fsearch->from_index = true;
+        fsearch->path_idx = fsearch->numPaths;
+
+        fsearch->state = FSEARCH_OBJECT;
+    /* FALLTHRU */
+
+    case FSEARCH_OBJECT:
+        LOG_DEBUG("** STATE ** FSEARCH_OBJECT");
+
+        if (fsearch->path_idx == 0 && fsearch->from_index) {
+            /* All candidates were checked, search the policy store. */
+            search_policy_free_paths(fsearch);
+            fsearch->from_index = false;
+            r = ifapi_keystore_list_all(&context->keystore, IFAPI_POLICY_DIR,
+                                        &fsearch->pathlist, &fsearch->numPaths);
+            goto_if_error(r, "get entities.", cleanup);
+
+            fsearch->append_index = false;
+            if (fsearch->index_state.complete && !fsearch->index_stale &&
+                ifapi_index_unindexed(context->pstore.index_file,
+                                      policy_index_object_file, &context->pstore,
+                                      fsearch->pathlist, &fsearch->numPaths,
+                                      &fsearch->append_index) != TSS2_RC_SUCCESS) {
+                LOG_WARNING("Policy index %s could not be read.",
+                            context->pstore.index_file);
+            }
+            if (!fsearch->append_index) {
+                /* The index is incomplete or outdated, all policies are read. */
+                ifapi_cleanup_policy_list(*policy_found);
+                *policy_found = NULL;
+            }
+            fsearch->path_idx = fsearch->numPaths;
+        }
+
+        /* Test whether all files have been checked. */
+        if (fsearch->path_idx == 0) {
+            if (fsearch->append_index)
+                r = ifapi_index_append(context->pstore.index_file,
+                                       fsearch->index_records);
+            else
+                r = ifapi_index_rewrite(context->pstore.index_file,
+                                        fsearch->index_records,
+                                        &fsearch->index_state);
+            if (r != TSS2_RC_SUCCESS) {
+                LOG_WARNING("Policy index %s could not be written.",
+                            context->pstore.index_file);
+            }
+            if (*policy_found) {
+                break;
+            }
+            goto_error(r, TSS2_FAPI_RC_POLICY_UNKNOWN, "Policy not found.", cleanup);
+        }
+        fsearch->path_idx -= 1;
+        path = fsearch->pathlist[fsearch->path_idx];
+        fsearch->current_path = path;
+        LOG_DEBUG("Check file: %s %zu", path, fsearch->path_idx);
+
+        /* Prepare policy loading. */
+        r = ifapi_policy_store_load_async(&context->pstore, &context->io, path);
+        if (r != TSS2_RC_SUCCESS && fsearch->from_index) {
+            /* The index is outdated, try the next candidate. */
+            LOG_DEBUG("Indexed policy %s could not be opened.", path);
+            fsearch->index_stale = true;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        goto_if_error2(r, "Can't open: %s", cleanup, path);
+
+        fsearch->state = FSEARCH_READ;
+    /* FALLTHRU */
+
+    case FSEARCH_READ:
+        LOG_DEBUG("** STATE ** FSEARCH_READ");
+        /* Finalize policy loading if possible. */
+        r = ifapi_policy_store_load_finish(&context->pstore, &context->io, &policy);
+        return_try_again(r);
+        if (r != TSS2_RC_SUCCESS && fsearch->from_index) {
+            LOG_DEBUG("Indexed policy %s could not be read.", fsearch->current_path);
+            fsearch->index_stale = true;
+            fsearch->state = FSEARCH_OBJECT;
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        goto_if_error(r, "read_finish failed", cleanup);
+
+        if (!fsearch->from_index) {
+            /* Collect the index record of every policy read. */
+            if (ifapi_policy_store_index_keys(&policy, &key) != TSS2_RC_SUCCESS) {
+                LOG_WARNING("Policy %s can't be indexed.", fsearch->current_path);
+            } else if (key) {
+                if (ifapi_policy_store_file(&context->pstore, fsearch->current_path,
+                                            &file) != TSS2_RC_SUCCESS) {
+                    /* The record is stored without the version of the file. */
+                    SAFE_FREE(file);
+                }
+                r = ifapi_index_add_record(&fsearch->index_records,
+                                           fsearch->current_path, file, key);
+                SAFE_FREE(key);
+                SAFE_FREE(file);
+                goto_if_error(r, "Create index record.", cleanup);
+            }
+        }
+
+        /* Call the passed compare function. */
+        r = compare(&policy, object1, object2, &found);
+        if (found) {
+            LOG_DEBUG("compare true  %s", fsearch->current_path);
+        } else {
+            LOG_DEBUG("compare false  %s", fsearch->current_path);
+        }
+        goto_if_error(r, "Invalid cipher object.", cleanup);
+
+        if (!found && fsearch->from_index) {
+            /* The policy does not have the key stored in the index anymore. */
+            fsearch->index_stale = true;
+        }
+        /* A candidate read again because its record is not trusted. */
+        for (second = *policy_found; found && second; second = second->next) {
+            if (strcmp(second->path, fsearch->current_path) == 0)
+                found = false;
+        }
+        if (!found || (!all_objects && *policy_found)) {
+            /* Continue search. */
+            fsearch->state = FSEARCH_OBJECT;
+            ifapi_cleanup_policy(&policy);
+            return TSS2_FAPI_RC_TRY_AGAIN;
+        }
+        /* Extend linked list.*/
+        policy_object = calloc(sizeof(struct POLICY_LIST), 1);
+        goto_if_null2(policy_object, "Out of memory.", r, TSS2_FAPI_RC_MEMORY, cleanup);
+
+        strdup_check(policy_object->path, fsearch->current_path, r, cleanup);
+        policy_object->policy = policy;
+        if (*policy_found != NULL) {
+            second = *policy_found;
+            policy_object->next = second;
+        }
+        *policy_found = policy_object;
+
+        if (!all_objects && fsearch->from_index) {
+            break;
+        }
+        /* Continue the search to find all policies or to rebuild the index. */
+        fsearch->state = FSEARCH_OBJECT;
+        return TSS2_FAPI_RC_TRY_AGAIN;
+
+    default:
+        context->state = _FAPI_STATE_INTERNALERROR;
+        goto_error(r, TSS2_FAPI_RC_BAD_VALUE, "Invalid state for load key.", cleanup);
+    }
+    fsearch->state = FSEARCH_INIT;
+    search_policy_free_paths(fsearch);
+    SAFE_FREE(fsearch->index_records);
+    return TSS2_RC_SUCCESS;
+cleanup:
+    SAFE_FREE(policy_object);
+    ifapi_cleanup_policy(&policy);
+    search_policy_free_paths(fsearch);
+    SAFE_FREE(fsearch->index_records);
+    fsearch->state = FSEARCH_INIT;
+    return r;
+}
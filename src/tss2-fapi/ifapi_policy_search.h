@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef IFAPI_POLICY_SEARCH_H
+#define IFAPI_POLICY_SEARCH_H
+
+#include <stdbool.h>
+
+#include "tss2_common.h"
+#include "fapi_int.h"
+#include "ifapi_policy_execute.h"
+
+TSS2_RC
+ifapi_policy_search(
+    FAPI_CONTEXT *context,
+    Policy_Compare_Object compare,
+    Policy_Index_Key index_key,
+    bool all_objects,
+    void *object1,
+    void *object2,
+    struct POLICY_LIST **policy_found);
+
+void
+ifapi_cleanup_policy_list(struct POLICY_LIST *list);
+
+#endif /* IFAPI_POLICY_SEARCH_H */
@@ -14,6 +14,9 @@
 #include "ifapi_policy_types.h"
 #include "ifapi_policy_store.h"
 #include "ifapi_macros.h"
+#include "ifapi_index.h"
+#include "fapi_crypto.h"
+#include "tss2_mu.h"
 #define LOGMODULE fapi
 #include "util/log.h"
 #include "util/aux_util.h"
@@ -42,6 +45,178 @@ policy_rel_path_to_abs_path(
     return_if_error(r, "Create policy file name.");
     return r;
 }
+
+/** Compute the path of a policy used in the policy store index.
+ *
+ * The path is normalized to the form returned by listing the policy
+ * directory ("/policy/<name>").
+ *
+ * @param[in] path The relative path of the policy.
+ * @param[out] index_path The normalized path. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+TSS2_RC
+ifapi_policy_store_index_path(
+    const char *path,
+    char **index_path)
+{
+    size_t pos = (path[0] == IFAPI_FILE_DELIM_CHAR) ? 1 : 0;
+
+    if (ifapi_path_type_p(path, IFAPI_POLICY_PATH)) {
+        return ifapi_asprintf(index_path, "%s%s", IFAPI_FILE_DELIM, &path[pos]);
+    }
+    return ifapi_asprintf(index_path, "%s%s%s%s", IFAPI_FILE_DELIM,
+                          IFAPI_POLICY_PATH, IFAPI_FILE_DELIM, &path[pos]);
+}
+
+/** Compute the file of a policy in the policy store.
+ *
+ * @param[in] pstore The policy context with the policy directory.
+ * @param[in] path The relative path of the policy.
+ * @param[out] file The absolute path of the policy file. (callee-allocated)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ */
+TSS2_RC
+ifapi_policy_store_file(
+    IFAPI_POLICY_STORE *pstore,
+    const char *path,
+    char **file)
+{
+    return policy_rel_path_to_abs_path(pstore, path, file);
+}
+
+/** Compute the index key for a policy digest.
+ *
+ * The key is appended to the passed key list.
+ *
+ * @param[in] hash_alg The hash algorithm used for the digest computation.
+ * @param[in] digest The policy digest.
+ * @param[in,out] keys The key list. (callee-allocated; may be NULL initially)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if an empty digest is passed.
+ */
+TSS2_RC
+ifapi_policy_digest_index_key(
+    TPMI_ALG_HASH hash_alg,
+    const TPM2B_DIGEST *digest,
+    char **keys)
+{
+    TSS2_RC r;
+    UINT8 buffer[sizeof(TPMI_ALG_HASH) + sizeof(TPMU_HA)];
+    size_t offset = 0;
+
+    if (digest->size > sizeof(TPMU_HA)) {
+        return_error(TSS2_FAPI_RC_BAD_VALUE, "Invalid digest size.");
+    }
+    r = Tss2_MU_TPMI_ALG_HASH_Marshal(hash_alg, &buffer[0], sizeof(buffer), &offset);
+    return_if_error(r, "Marshal hash algorithm.");
+
+    memcpy(&buffer[offset], &digest->buffer[0], digest->size);
+    return ifapi_index_add_key(keys, "digest", &buffer[0], offset + digest->size);
+}
+
+/** Compute the index key for a policy authorization.
+ *
+ * Only the type and the unique field of the public key are used, as it is
+ * done by the comparison of authorizations during policy search. The key is
+ * appended to the passed key list.
+ *
+ * @param[in] public The public data of the authorizing key.
+ * @param[in] policyRef The policy reference (may be empty).
+ * @param[in,out] keys The key list. (callee-allocated; may be NULL initially)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if the key can't be marshaled.
+ */
+TSS2_RC
+ifapi_policy_authorization_index_key(
+    const TPMT_PUBLIC *public,
+    const TPM2B_NONCE *policyRef,
+    char **keys)
+{
+    TSS2_RC r;
+    UINT8 buffer[sizeof(TPMI_ALG_PUBLIC) + sizeof(TPMU_PUBLIC_ID) + sizeof(TPM2B_NONCE)];
+    size_t offset = 0;
+    TPM2B_NONCE empty_ref = { 0 };
+
+    r = Tss2_MU_UINT16_Marshal(public->type, &buffer[0], sizeof(buffer), &offset);
+    return_if_error(r, "Marshal key type.");
+
+    r = Tss2_MU_TPMU_PUBLIC_ID_Marshal(&public->unique, public->type, &buffer[0],
+                                       sizeof(buffer), &offset);
+    return_if_error(r, "Marshal unique data.");
+
+    r = Tss2_MU_TPM2B_NONCE_Marshal(policyRef ? policyRef : &empty_ref, &buffer[0],
+                                    sizeof(buffer), &offset);
+    return_if_error(r, "Marshal policy reference.");
+
+    return ifapi_index_add_key(keys, "auth", &buffer[0], offset);
+}
+
+/** Compute the keys used to find a policy via the policy store index.
+ *
+ * A policy can be found by the instantiated digest for each hash algorithm
+ * and by the key and policy reference of each authorization.
+ *
+ * @param[in] policy The policy to be indexed.
+ * @param[out] keys The space separated keys of the policy. (callee-allocated;
+ *             NULL if the policy can't be searched)
+ * @retval TSS2_RC_SUCCESS on success.
+ * @retval TSS2_FAPI_RC_MEMORY if not enough memory can be allocated.
+ * @retval TSS2_FAPI_RC_BAD_VALUE if a key can't be computed.
+ * @retval TSS2_FAPI_RC_GENERAL_FAILURE if a PEM key can't be converted.
+ */
+TSS2_RC
+ifapi_policy_store_index_keys(
+    const TPMS_POLICY *policy,
+    char **keys)
+{
+    TSS2_RC r;
+    size_t i, digest_size;
+    TPM2B_DIGEST digest;
+    TPM2B_PUBLIC pem_public;
+    const TPMT_PUBLIC *public;
+    TPMS_POLICYAUTHORIZATION *authorization;
+
+    *keys = NULL;
+    for (i = 0; i < policy->policyDigests.count; i++) {
+        digest_size = ifapi_hash_get_digest_size(policy->policyDigests.digests[i].hashAlg);
+        if (!digest_size)
+            continue;
+        digest.size = digest_size;
+        memcpy(&digest.buffer[0], &policy->policyDigests.digests[i].digest, digest_size);
+
+        r = ifapi_policy_digest_index_key(policy->policyDigests.digests[i].hashAlg,
+                                          &digest, keys);
+        goto_if_error(r, "Add digest key.", error_cleanup);
+    }
+
+    for (i = 0; policy->policyAuthorizations &&
+             i < policy->policyAuthorizations->count; i++) {
+        authorization = &policy->policyAuthorizations->authorizations[i];
+        if (authorization->type && strcmp(authorization->type, "pem") == 0) {
+            /* The public info has to be computed from the PEM key */
+            r = ifapi_get_tpm2b_public_from_pem(authorization->keyPEM, &pem_public);
+            goto_if_error(r, "Invalid PEM key.", error_cleanup);
+
+            public = &pem_public.publicArea;
+        } else {
+            public = &authorization->key;
+        }
+        r = ifapi_policy_authorization_index_key(public, &authorization->policyRef,
+                                                 keys);
+        goto_if_error(r, "Add authorization key.", error_cleanup);
+    }
+    return TSS2_RC_SUCCESS;
+
+error_cleanup:
+    SAFE_FREE(*keys);
+    return r;
+}
+
 /** Remove file storing a policy object.
  *
  * @param[in] pstore The policy directory.
@@ -58,6 +233,7 @@ ifapi_policy_delete(
 {
     TSS2_RC r;
     char *abs_path = NULL;
+    char *index_path = NULL;
 
     /* Convert relative path to absolute path in policy store */
     r = policy_rel_path_to_abs_path(pstore, path, &abs_path);
@@ -72,8 +248,15 @@ ifapi_policy_delete(
         LOG_WARNING("File: %s can't be deleted.", abs_path);
     }
 
+    /* The index only speeds up searching, thus errors are not fatal. */
+    if (ifapi_policy_store_index_path(path, &index_path) != TSS2_RC_SUCCESS ||
+        ifapi_index_remove(pstore->index_file, index_path) != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Index entry for %s could not be removed.", path);
+    }
+
 cleanup:
     SAFE_FREE(abs_path);
+    SAFE_FREE(index_path);
     return r;
 }
 
@@ -113,14 +296,37 @@ ifapi_policy_store_initialize(
     r = ifapi_io_check_create_dir(policy_dir, FAPI_READ);
     goto_if_error2(r, "Policy directory %s can't be created.", error, policy_dir);
 
+    r = ifapi_asprintf(&pstore->index_file, "%s%s%s", policy_dir,
+                       IFAPI_FILE_DELIM, IFAPI_INDEX_FILE);
+    goto_if_error(r, "Out of memory.", error);
+
     SAFE_FREE(policy_dir);
     return TSS2_RC_SUCCESS;
 
 error:
     SAFE_FREE(policy_dir);
+    SAFE_FREE(pstore->policydir);
     return r;
 }
 
+/** Free policy store related memory allocated during FAPI initialization.
+ *
+ * The policy store object will not be freed (might be declared on the stack).
+ *
+ * @param[in] pstore The policy store to be cleaned up.
+ */
+void
+ifapi_cleanup_policy_store(IFAPI_POLICY_STORE *pstore)
+{
+    if (pstore != NULL) {
+        SAFE_FREE(pstore->policydir);
+        SAFE_FREE(pstore->index_file);
+        SAFE_FREE(pstore->index_path);
+        SAFE_FREE(pstore->index_keys);
+        SAFE_FREE(pstore->index_object);
+    }
+}
+
 /** Start loading FAPI policy from policy store.
  *
  * Keys objects, NV objects, and hierarchies can be loaded.
@@ -267,6 +473,20 @@ ifapi_policy_store_store_async(
     free(jso_string);
     goto_if_error(r, "write_async failed", cleanup);
 
+    /* Remember the index entry, it will be written if the policy is stored. */
+    SAFE_FREE(pstore->index_path);
+    SAFE_FREE(pstore->index_keys);
+    SAFE_FREE(pstore->index_object);
+    if (ifapi_policy_store_index_keys(policy, &pstore->index_keys) != TSS2_RC_SUCCESS ||
+        (pstore->index_keys &&
+         ifapi_policy_store_index_path(path, &pstore->index_path) != TSS2_RC_SUCCESS)) {
+        LOG_WARNING("Index keys for %s could not be computed.", path);
+        SAFE_FREE(pstore->index_keys);
+    } else if (pstore->index_keys) {
+        pstore->index_object = abs_path;
+        abs_path = NULL;
+    }
+
 cleanup:
     if (jso)
         json_object_put(jso);
@@ -292,15 +512,24 @@ ifapi_policy_store_store_finish(
 {
     TSS2_RC r;
 
-    /* Pstore parameter is used to be prepared if transmission of state information
-       between async and finish will be necessary in future extensions. */
-    (void)pstore;
     /* Finish writing the policy */
     r = ifapi_io_write_finish(io);
     return_try_again(r);
 
     LOG_TRACE("Return %x", r);
-    return_if_error(r, "read_finish failed");
+    goto_if_error(r, "read_finish failed", cleanup);
+
+    /* The index only speeds up searching, thus errors are not fatal. */
+    if (pstore->index_path &&
+        ifapi_index_update(pstore->index_file, pstore->index_path,
+                           pstore->index_object,
+                           pstore->index_keys) != TSS2_RC_SUCCESS) {
+        LOG_WARNING("Index entry for %s could not be stored.", pstore->index_path);
+    }
 
-    return TSS2_RC_SUCCESS;
+cleanup:
+    SAFE_FREE(pstore->index_path);
+    SAFE_FREE(pstore->index_keys);
+    SAFE_FREE(pstore->index_object);
+    return r;
 }
@@ -16,6 +16,10 @@
 
 typedef struct IFAPI_POLICY_STORE {
     char *policydir;
+    char *index_file;               /**< The index mapping digests and authorizations to paths */
+    char *index_path;               /**< The path of the policy currently stored */
+    char *index_keys;               /**< The index keys of the policy currently stored */
+    char *index_object;             /**< The file of the policy currently stored */
 } IFAPI_POLICY_STORE;
 
 TSS2_RC
@@ -52,4 +56,36 @@ ifapi_policy_store_store_finish(
     IFAPI_POLICY_STORE *pstore,
     IFAPI_IO *io);
 
+TSS2_RC
+ifapi_policy_store_index_path(
+    const char *path,
+    char **index_path);
+
+TSS2_RC
+ifapi_policy_store_file(
+    IFAPI_POLICY_STORE *pstore,
+    const char *path,
+    char **file);
+
+TSS2_RC
+ifapi_policy_store_index_keys(
+    const TPMS_POLICY *policy,
+    char **keys);
+
+TSS2_RC
+ifapi_policy_digest_index_key(
+    TPMI_ALG_HASH hash_alg,
+    const TPM2B_DIGEST *digest,
+    char **keys);
+
+TSS2_RC
+ifapi_policy_authorization_index_key(
+    const TPMT_PUBLIC *public,
+    const TPM2B_NONCE *policyRef,
+    char **keys);
+
+void
+ifapi_cleanup_policy_store(
+    IFAPI_POLICY_STORE *pstore);
+
 #endif /* IFAPI_POLICY_STORE_H */
@@ -11,6 +11,7 @@
 #include "tss2_tpm2_types.h"
 #include "tss2_mu.h"
 #include "sysapi_util.h"
+#include "sysapi_mu.h"
 
 TSS2_RC Tss2_Sys_Create_Prepare(
     TSS2_SYS_CONTEXT *sysContext,
@@ -69,9 +70,9 @@ TSS2_RC Tss2_Sys_Create_Prepare(
         if (rval)
             return rval;
 
-        rval = Tss2_MU_TPM2B_PUBLIC_Marshal(inPublic, ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
-                                            &ctx->nextData);
+        rval = FastMarshal_TPM2B_PUBLIC(inPublic, ctx->cmdBuffer,
+                                        ctx->maxCmdSize,
+                                        &ctx->nextData);
     }
 
     if (rval)
@@ -92,10 +93,10 @@ TSS2_RC Tss2_Sys_Create_Prepare(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPML_PCR_SELECTION_Marshal(creationPCR,
-                                              ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
-                                              &ctx->nextData);
+    rval = FastMarshal_TPML_PCR_SELECTION(creationPCR,
+                                          ctx->cmdBuffer,
+                                          ctx->maxCmdSize,
+                                          &ctx->nextData);
     if (rval)
         return rval;
 
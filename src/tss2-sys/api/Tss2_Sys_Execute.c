@@ -58,28 +58,13 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
         return TSS2_SYS_RC_BAD_SEQUENCE;
 
     /*
-	 * Call tcti_receive with NULL response buffer to get the actual size
-	 * of the response. If we can read the response in multiple chunks
-	 * then the tcti should read the response header first and give us
-	 * the acctual size. If not it should set the response size to the
-	 * maximum possible size.
+     * Receive the response straight into the command buffer. The buffer
+     * is large enough for any response this context can process, so the
+     * TCTI does not need to be queried for the response size first. This
+     * saves a round trip through the TCTI per command, and for the device
+     * TCTI with partial reads the separate header read and copy.
      */
-    rval = Tss2_Tcti_Receive(ctx->tctiContext, &response_size,
-                             NULL, timeout);
-    if (rval)
-        return rval;
-
-    if (response_size < sizeof(TPM20_Header_Out)) {
-        ctx->previousStage = CMD_STAGE_PREPARE;
-        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
-    }
-    if (response_size > ctx->maxCmdSize) {
-        ctx->previousStage = CMD_STAGE_PREPARE;
-        LOG_ERROR("Response size to big: %zu > %u", response_size, ctx->maxCmdSize);
-        return TSS2_SYS_RC_INSUFFICIENT_CONTEXT;
-    }
-
-    /* Then call receive again with the response buffer to read the response */
+    response_size = ctx->maxCmdSize;
     rval = Tss2_Tcti_Receive(ctx->tctiContext, &response_size,
                              ctx->cmdBuffer, timeout);
     if (rval == TSS2_TCTI_RC_INSUFFICIENT_BUFFER) {
@@ -90,6 +75,11 @@ TSS2_RC Tss2_Sys_ExecuteFinish(TSS2_SYS_CONTEXT *sysContext, int32_t timeout)
     if (rval)
         return rval;
 
+    if (response_size < sizeof(TPM20_Header_Out)) {
+        ctx->previousStage = CMD_STAGE_PREPARE;
+        return TSS2_SYS_RC_INSUFFICIENT_RESPONSE;
+    }
+
     /*
      * Unmarshal the tag, response size, and response code as soon
      * as possible. Later processing code should get this data from
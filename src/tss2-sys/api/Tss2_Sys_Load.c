@@ -11,6 +11,7 @@
 #include "tss2_tpm2_types.h"
 #include "tss2_mu.h"
 #include "sysapi_util.h"
+#include "sysapi_mu.h"
 
 TSS2_RC Tss2_Sys_Load_Prepare(
     TSS2_SYS_CONTEXT *sysContext,
@@ -61,9 +62,9 @@ TSS2_RC Tss2_Sys_Load_Prepare(
         if (rval)
             return rval;
 
-        rval = Tss2_MU_TPM2B_PUBLIC_Marshal(inPublic, ctx->cmdBuffer,
-                                            ctx->maxCmdSize,
-                                            &ctx->nextData);
+        rval = FastMarshal_TPM2B_PUBLIC(inPublic, ctx->cmdBuffer,
+                                        ctx->maxCmdSize,
+                                        &ctx->nextData);
     }
 
     if (rval)
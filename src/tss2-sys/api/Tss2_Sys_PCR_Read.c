@@ -11,6 +11,7 @@
 #include "tss2_tpm2_types.h"
 #include "tss2_mu.h"
 #include "sysapi_util.h"
+#include "sysapi_mu.h"
 
 TSS2_RC Tss2_Sys_PCR_Read_Prepare(
     TSS2_SYS_CONTEXT *sysContext,
@@ -26,10 +27,10 @@ TSS2_RC Tss2_Sys_PCR_Read_Prepare(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPML_PCR_SELECTION_Marshal(pcrSelectionIn,
-                                              ctx->cmdBuffer,
-                                              ctx->maxCmdSize,
-                                              &ctx->nextData);
+    rval = FastMarshal_TPML_PCR_SELECTION(pcrSelectionIn,
+                                          ctx->cmdBuffer,
+                                          ctx->maxCmdSize,
+                                          &ctx->nextData);
     if (rval)
         return rval;
 
@@ -63,10 +64,10 @@ TSS2_RC Tss2_Sys_PCR_Read_Complete(
     if (rval)
         return rval;
 
-    rval = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(ctx->cmdBuffer,
-                                                ctx->maxCmdSize,
-                                                &ctx->nextData,
-                                                pcrSelectionOut);
+    rval = FastUnmarshal_TPML_PCR_SELECTION(ctx->cmdBuffer,
+                                            ctx->maxCmdSize,
+                                            &ctx->nextData,
+                                            pcrSelectionOut);
     if (rval)
         return rval;
 
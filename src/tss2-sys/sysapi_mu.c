@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "tss2_mu.h"
+#include "sysapi_mu.h"
+#include "util/tpm2b.h"
+#include "util/tss2_endian.h"
+
+/*
+ * The write functions below store one field at the position ptr and return
+ * the position behind the field. NULL is returned if the field has a value
+ * the Tss2_MU_* functions would reject. The caller guarantees that the
+ * buffer is large enough for the largest possible encoding, which is never
+ * larger than the in-memory size of the structure.
+ */
+
+static inline uint8_t *
+put_uint16(uint8_t *ptr, UINT16 value)
+{
+    value = HOST_TO_BE_16(value);
+    memcpy(ptr, &value, sizeof(value));
+    return ptr + sizeof(value);
+}
+
+static inline uint8_t *
+put_uint32(uint8_t *ptr, UINT32 value)
+{
+    value = HOST_TO_BE_32(value);
+    memcpy(ptr, &value, sizeof(value));
+    return ptr + sizeof(value);
+}
+
+static inline uint8_t *
+put_tpm2b(uint8_t *ptr, const TPM2B *src, size_t max_size)
+{
+    if (src->size > max_size)
+        return NULL;
+
+    ptr = put_uint16(ptr, src->size);
+    memcpy(ptr, src->buffer, src->size);
+    return ptr + src->size;
+}
+
+#define PUT_TPM2B(ptr, src) \
+    put_tpm2b(ptr, (const TPM2B *)(src), sizeof((src)->buffer))
+
+static uint8_t *
+put_sym_def_object(uint8_t *ptr, const TPMT_SYM_DEF_OBJECT *src)
+{
+    ptr = put_uint16(ptr, src->algorithm);
+    switch (src->algorithm) {
+    case TPM2_ALG_AES:
+    case TPM2_ALG_SM4:
+    case TPM2_ALG_CAMELLIA:
+    case TPM2_ALG_SYMCIPHER:
+        ptr = put_uint16(ptr, src->keyBits.sym);
+        return put_uint16(ptr, src->mode.sym);
+    case TPM2_ALG_XOR:
+        return put_uint16(ptr, src->keyBits.exclusiveOr);
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+/* Used for TPMT_RSA_SCHEME and TPMT_ECC_SCHEME, which share TPMU_ASYM_SCHEME. */
+static uint8_t *
+put_asym_scheme(uint8_t *ptr, TPM2_ALG_ID scheme, const TPMU_ASYM_SCHEME *details)
+{
+    ptr = put_uint16(ptr, scheme);
+    switch (scheme) {
+    case TPM2_ALG_ECDH:
+    case TPM2_ALG_ECMQV:
+    case TPM2_ALG_RSASSA:
+    case TPM2_ALG_RSAPSS:
+    case TPM2_ALG_ECDSA:
+    case TPM2_ALG_SM2:
+    case TPM2_ALG_ECSCHNORR:
+    case TPM2_ALG_OAEP:
+        return put_uint16(ptr, details->anySig.hashAlg);
+    case TPM2_ALG_ECDAA:
+        ptr = put_uint16(ptr, details->ecdaa.hashAlg);
+        return put_uint16(ptr, details->ecdaa.count);
+    case TPM2_ALG_RSAES:
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t *
+put_kdf_scheme(uint8_t *ptr, const TPMT_KDF_SCHEME *src)
+{
+    ptr = put_uint16(ptr, src->scheme);
+    switch (src->scheme) {
+    case TPM2_ALG_MGF1:
+    case TPM2_ALG_KDF1_SP800_56A:
+    case TPM2_ALG_KDF1_SP800_108:
+        return put_uint16(ptr, src->details.mgf1.hashAlg);
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t *
+put_keyedhash_scheme(uint8_t *ptr, const TPMT_KEYEDHASH_SCHEME *src)
+{
+    ptr = put_uint16(ptr, src->scheme);
+    switch (src->scheme) {
+    case TPM2_ALG_HMAC:
+        return put_uint16(ptr, src->details.hmac.hashAlg);
+    case TPM2_ALG_XOR:
+        ptr = put_uint16(ptr, src->details.exclusiveOr.hashAlg);
+        return put_uint16(ptr, src->details.exclusiveOr.kdf);
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t *
+put_public_parms(uint8_t *ptr, TPMI_ALG_PUBLIC type, const TPMU_PUBLIC_PARMS *src)
+{
+    switch (type) {
+    case TPM2_ALG_KEYEDHASH:
+        return put_keyedhash_scheme(ptr, &src->keyedHashDetail.scheme);
+    case TPM2_ALG_SYMCIPHER:
+        return put_sym_def_object(ptr, &src->symDetail.sym);
+    case TPM2_ALG_RSA:
+        ptr = put_sym_def_object(ptr, &src->rsaDetail.symmetric);
+        if (!ptr)
+            return NULL;
+        ptr = put_asym_scheme(ptr, src->rsaDetail.scheme.scheme,
+                              &src->rsaDetail.scheme.details);
+        if (!ptr)
+            return NULL;
+        ptr = put_uint16(ptr, src->rsaDetail.keyBits);
+        return put_uint32(ptr, src->rsaDetail.exponent);
+    case TPM2_ALG_ECC:
+        ptr = put_sym_def_object(ptr, &src->eccDetail.symmetric);
+        if (!ptr)
+            return NULL;
+        ptr = put_asym_scheme(ptr, src->eccDetail.scheme.scheme,
+                              &src->eccDetail.scheme.details);
+        if (!ptr)
+            return NULL;
+        ptr = put_uint16(ptr, src->eccDetail.curveID);
+        return put_kdf_scheme(ptr, &src->eccDetail.kdf);
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t *
+put_public_id(uint8_t *ptr, TPMI_ALG_PUBLIC type, const TPMU_PUBLIC_ID *src)
+{
+    switch (type) {
+    case TPM2_ALG_KEYEDHASH:
+        return PUT_TPM2B(ptr, &src->keyedHash);
+    case TPM2_ALG_SYMCIPHER:
+        return PUT_TPM2B(ptr, &src->sym);
+    case TPM2_ALG_RSA:
+        return PUT_TPM2B(ptr, &src->rsa);
+    case TPM2_ALG_ECC:
+        ptr = PUT_TPM2B(ptr, &src->ecc.x);
+        if (!ptr)
+            return NULL;
+        return PUT_TPM2B(ptr, &src->ecc.y);
+    case TPM2_ALG_NULL:
+        return ptr;
+    default:
+        return NULL;
+    }
+}
+
+static uint8_t *
+put_public(uint8_t *ptr, const TPMT_PUBLIC *src)
+{
+    ptr = put_uint16(ptr, src->type);
+    ptr = put_uint16(ptr, src->nameAlg);
+    ptr = put_uint32(ptr, src->objectAttributes);
+    ptr = PUT_TPM2B(ptr, &src->authPolicy);
+    if (!ptr)
+        return NULL;
+    ptr = put_public_parms(ptr, src->type, &src->parameters);
+    if (!ptr)
+        return NULL;
+    return put_public_id(ptr, src->type, &src->unique);
+}
+
+TSS2_RC
+FastMarshal_TPM2B_PUBLIC(const TPM2B_PUBLIC *src, uint8_t buffer[],
+                         size_t buffer_size, size_t *offset)
+{
+    uint8_t *start, *end;
+
+    if (!src || !buffer || !offset || buffer_size < *offset ||
+        buffer_size - *offset < sizeof(*src))
+        goto slow_path;
+
+    start = &buffer[*offset];
+    end = put_public(start + sizeof(src->size), &src->publicArea);
+    if (!end)
+        goto slow_path;
+
+    /* The size field holds the real size of the encoded public area. */
+    put_uint16(start, (UINT16)(end - start - sizeof(src->size)));
+    *offset += end - start;
+    return TSS2_RC_SUCCESS;
+
+slow_path:
+    return Tss2_MU_TPM2B_PUBLIC_Marshal(src, buffer, buffer_size, offset);
+}
+
+TSS2_RC
+FastMarshal_TPML_PCR_SELECTION(const TPML_PCR_SELECTION *src, uint8_t buffer[],
+                               size_t buffer_size, size_t *offset)
+{
+    uint8_t *ptr;
+    UINT32 i;
+
+    if (!src || !buffer || !offset || buffer_size < *offset ||
+        buffer_size - *offset < sizeof(*src) ||
+        src->count > TPM2_NUM_PCR_BANKS)
+        goto slow_path;
+
+    for (i = 0; i < src->count; i++) {
+        if (src->pcrSelections[i].sizeofSelect > TPM2_PCR_SELECT_MAX)
+            goto slow_path;
+    }
+
+    ptr = put_uint32(&buffer[*offset], src->count);
+    for (i = 0; i < src->count; i++) {
+        const TPMS_PCR_SELECTION *sel = &src->pcrSelections[i];
+
+        ptr = put_uint16(ptr, sel->hash);
+        *ptr++ = sel->sizeofSelect;
+        memcpy(ptr, sel->pcrSelect, sel->sizeofSelect);
+        ptr += sel->sizeofSelect;
+    }
+    *offset = ptr - buffer;
+    return TSS2_RC_SUCCESS;
+
+slow_path:
+    return Tss2_MU_TPML_PCR_SELECTION_Marshal(src, buffer, buffer_size, offset);
+}
+
+TSS2_RC
+FastUnmarshal_TPML_PCR_SELECTION(uint8_t const buffer[], size_t buffer_size,
+                                 size_t *offset, TPML_PCR_SELECTION *dest)
+{
+    TPML_PCR_SELECTION tmp;
+    const uint8_t *ptr;
+    UINT32 count;
+    UINT16 hash;
+    UINT32 i;
+
+    /* The encoding of a valid TPML_PCR_SELECTION is never larger than the
+       structure itself. */
+    if (!buffer || !offset || buffer_size < *offset ||
+        buffer_size - *offset < sizeof(*dest))
+        goto slow_path;
+
+    ptr = &buffer[*offset];
+    memcpy(&count, ptr, sizeof(count));
+    count = BE_TO_HOST_32(count);
+    ptr += sizeof(count);
+    if (count > TPM2_NUM_PCR_BANKS)
+        goto slow_path;
+
+    if (!dest)
+        dest = &tmp;
+    memset(dest, 0, sizeof(*dest));
+    dest->count = count;
+
+    for (i = 0; i < count; i++) {
+        TPMS_PCR_SELECTION *sel = &dest->pcrSelections[i];
+
+        memcpy(&hash, ptr, sizeof(hash));
+        sel->hash = BE_TO_HOST_16(hash);
+        ptr += sizeof(hash);
+        sel->sizeofSelect = *ptr++;
+        if (sel->sizeofSelect > TPM2_PCR_SELECT_MAX)
+            goto slow_path;
+        memcpy(sel->pcrSelect, ptr, sel->sizeofSelect);
+        ptr += sel->sizeofSelect;
+    }
+    *offset = ptr - buffer;
+    return TSS2_RC_SUCCESS;
+
+slow_path:
+    return Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, buffer_size, offset,
+                                                dest == &tmp ? NULL : dest);
+}
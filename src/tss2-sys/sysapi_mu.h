@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifndef TSS2_SYSAPI_MU_H
+#define TSS2_SYSAPI_MU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tss2_tpm2_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fast path (un)marshaling functions for the structures the SYS layer
+ * transfers most often. They have the signature and the result of the
+ * corresponding Tss2_MU_* functions. The remaining buffer is checked once
+ * against the largest possible encoding of the structure and the fields are
+ * then copied without further checks or logging. If the buffer is smaller
+ * or a field has an invalid value the Tss2_MU_* function is called, so the
+ * error codes and log messages do not change.
+ */
+TSS2_RC FastMarshal_TPM2B_PUBLIC(const TPM2B_PUBLIC *src, uint8_t buffer[],
+                                 size_t buffer_size, size_t *offset);
+TSS2_RC FastMarshal_TPML_PCR_SELECTION(const TPML_PCR_SELECTION *src,
+                                       uint8_t buffer[], size_t buffer_size,
+                                       size_t *offset);
+TSS2_RC FastUnmarshal_TPML_PCR_SELECTION(uint8_t const buffer[],
+                                         size_t buffer_size, size_t *offset,
+                                         TPML_PCR_SELECTION *dest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -13,8 +13,12 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <time.h>
+#include <unistd.h>
 
 #if defined (__FreeBSD__)
 #include <sys/procctl.h>
@@ -72,9 +76,9 @@ int tcti_cmd_fork (void)
 }
 
 TEST_VISIBILITY WEAK
-FILE * tcti_cmd_fdopen (int fd, const char *mode)
+int tcti_cmd_fcntl (int fd, int cmd, int arg)
 {
-    return fdopen (fd, mode);
+    return fcntl (fd, cmd, arg);
 }
 
 TEST_VISIBILITY WEAK
@@ -84,22 +88,15 @@ int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
 }
 
 TEST_VISIBILITY WEAK
-size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream)
-{
-    return fwrite (ptr, size, nmemb, stream);
-}
-
-TEST_VISIBILITY WEAK
-size_t tcti_cmd_fread (void *ptr, size_t size, size_t nmemb, FILE *stream)
+ssize_t tcti_cmd_write (int fd, const void *buf, size_t count)
 {
-    return fread (ptr, size, nmemb, stream);
+    return write (fd, buf, count);
 }
 
 TEST_VISIBILITY WEAK
-int tcti_cmd_ferror (FILE *stream)
+ssize_t tcti_cmd_read (int fd, void *buf, size_t count)
 {
-    return ferror (stream);
+    return read (fd, buf, count);
 }
 
 static int
@@ -178,6 +175,20 @@ out:
     (void)enable_sigchld ();
 }
 
+static int set_nonblock (int fd)
+{
+    int flags = tcti_cmd_fcntl (fd, F_GETFL, 0);
+    if (flags < 0) {
+        return errno;
+    }
+
+    if (tcti_cmd_fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return errno;
+    }
+
+    return 0;
+}
+
 static void pipe_close (int pipefd[2])
 {
     int rc = errno;
@@ -269,8 +280,8 @@ error:
 /*
  * Returns 0 on success or errno on error.
  */
-static int popen_w_pipes (const char *cmd, pid_t *pid, FILE **sink,
-        FILE **source)
+static int popen_w_pipes (const char *cmd, pid_t *pid, int *sink,
+        int *source)
 {
 
     pid_t _pid = 0;
@@ -319,36 +330,23 @@ static int popen_w_pipes (const char *cmd, pid_t *pid, FILE **sink,
     close_fd (stdout_pipefd[PIPE_WRITE_END]);
 
     /*
-     * make them stdio.h file streams so we don't have to worry
-     * about low level IO details.
+     * The parent ends are non-blocking, so a response can be read piece by
+     * piece with a timeout. The ends of the child stay blocking.
      */
-    *sink = tcti_cmd_fdopen (stdin_pipefd[1], "wb");
-    if (!*sink) {
-        rc = errno;
-        LOG_ERROR ("Could not fdopen sink: %s", strerror (errno));
-        goto error_close_all;
-    }
-
-    *source = tcti_cmd_fdopen (stdout_pipefd[0], "rb");
-    if (!*source) {
-        rc = errno;
-        LOG_ERROR ("Could not fdopen source: %s", strerror (errno));
-        fclose (*sink);
-        goto error_close_all;
-    }
-
-    rc = setvbuf (*sink, NULL, _IONBF, 0);
+    rc = set_nonblock (stdin_pipefd[PIPE_WRITE_END]);
     if (rc) {
-        LOG_WARNING ("Could not set stdin child pipe to non-buffering: %s",
-                strerror (errno));
+        LOG_ERROR ("Could not set sink non-blocking: %s", strerror (rc));
+        goto error_close_all;
     }
 
-    rc = setvbuf (*source, NULL, _IONBF, 0);
+    rc = set_nonblock (stdout_pipefd[PIPE_READ_END]);
     if (rc) {
-        LOG_WARNING ("Could not set stdout child pipe to non-buffering: %s",
-                strerror (errno));
+        LOG_ERROR ("Could not set source non-blocking: %s", strerror (rc));
+        goto error_close_all;
     }
 
+    *sink = stdin_pipefd[PIPE_WRITE_END];
+    *source = stdout_pipefd[PIPE_READ_END];
     *pid = _pid;
 
     /* parent */
@@ -359,7 +357,7 @@ error_close_all:
 error_close_stdin:
     pipe_close (stdin_pipefd);
 
-    *sink = *source = NULL;
+    *sink = *source = -1;
 
     /* The parent had an issue, so reap the child */
     if (_pid > 0) {
@@ -396,11 +394,88 @@ tcti_cmd_down_cast (TSS2_TCTI_CMD_CONTEXT *tcti_cmd)
     return &tcti_cmd->common;
 }
 
+/*
+ * Returns the time left until 'deadline' in milliseconds, which is passed to
+ * poll (). A NULL deadline never expires.
+ */
+static int remaining_ms (const struct timespec *deadline)
+{
+    struct timespec now;
+    int64_t ms;
+
+    if (deadline == NULL) {
+        return -1;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    ms = (int64_t)(deadline->tv_sec - now.tv_sec) * 1000 +
+            (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? (int)ms : 0;
+}
+
+/*
+ * Wait until 'fd' is ready for 'events' or 'deadline' has passed.
+ */
+static TSS2_RC wait_fd (int fd, short events, const struct timespec *deadline)
+{
+    struct pollfd fds = {
+        .fd = fd,
+        .events = events,
+    };
+    int rc;
+
+    TEMP_RETRY (rc, poll (&fds, 1, remaining_ms (deadline)));
+    if (rc < 0) {
+        LOG_ERROR ("Failed to poll fd %d: %s", fd, strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    } else if (rc == 0) {
+        LOG_DEBUG ("Poll timed out on fd %d.", fd);
+        return TSS2_TCTI_RC_TRY_AGAIN;
+    }
+
+    /* errors and hangups are reported by the next read or write */
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Read until '*done' of 'size' bytes are in 'buf'. The progress is kept in
+ * '*done', so a read that times out can be continued by the next call.
+ */
+static TSS2_RC read_exact (int fd, uint8_t *buf, size_t size, size_t *done,
+        const struct timespec *deadline)
+{
+    ssize_t bytes;
+    TSS2_RC rc;
+
+    while (*done < size) {
+        TEMP_RETRY (bytes, tcti_cmd_read (fd, &buf[*done], size - *done));
+        if (bytes > 0) {
+            *done += bytes;
+        } else if (bytes == 0) {
+            LOG_ERROR ("Subprocess closed stdout after %zu of %zu bytes",
+                    *done, size);
+            return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            rc = wait_fd (fd, POLLIN, deadline);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+        } else {
+            LOG_ERROR ("Reading from command TCTI: %s", strerror (errno));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
 TSS2_RC tcti_cmd_transmit (TSS2_TCTI_CONTEXT *tcti_ctx, size_t size,
         const uint8_t *cmd_buf)
 {
     TSS2_TCTI_CMD_CONTEXT *tcti_cmd = tcti_cmd_context_cast (tcti_ctx);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    size_t written = 0;
+    ssize_t bytes;
 
     TSS2_RC rc = tcti_common_transmit_checks (tcti_common, cmd_buf,
             TCTI_CMD_MAGIC);
@@ -408,14 +483,26 @@ TSS2_RC tcti_cmd_transmit (TSS2_TCTI_CONTEXT *tcti_ctx, size_t size,
         return rc;
     }
 
-    size_t bytes = tcti_cmd_fwrite (cmd_buf, 1, size, tcti_cmd->sink);
-    if (tcti_cmd_ferror (tcti_cmd->sink) || bytes != size) {
-        LOG_ERROR ("Transmitting to subprocess failed: %s", strerror (errno));
-        return TSS2_TCTI_RC_IO_ERROR;
+    /* the subprocess reads the command at its own pace */
+    while (written < size) {
+        TEMP_RETRY (bytes, tcti_cmd_write (tcti_cmd->sink, &cmd_buf[written],
+                size - written));
+        if (bytes >= 0) {
+            written += bytes;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            rc = wait_fd (tcti_cmd->sink, POLLOUT, NULL);
+            if (rc != TSS2_RC_SUCCESS) {
+                return rc;
+            }
+        } else {
+            LOG_ERROR ("Transmitting to subprocess failed: %s",
+                    strerror (errno));
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
     }
 
-    fflush (tcti_cmd->sink);
-
+    tcti_cmd->header_read = 0;
+    tcti_cmd->body_read = 0;
     tcti_common->state = TCTI_STATE_RECEIVE;
 
     return rc;
@@ -435,13 +522,11 @@ TSS2_RC tcti_cmd_get_poll_handles (TSS2_TCTI_CONTEXT *tctiContext,
         return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
     }
 
+    /* stdout of the subprocess becomes readable when the response arrives */
     *num_handles = 1;
     if (handles != NULL) {
-        handles->fd = fileno (cmd_tcti->source);
-        if (handles->fd < 0) {
-            LOG_ERROR ("Could not get fileno: %s", strerror (errno));
-            return TSS2_TCTI_RC_IO_ERROR;
-        }
+        handles->fd = cmd_tcti->source;
+        handles->events = POLLIN;
     }
 
     return TSS2_RC_SUCCESS;
@@ -457,8 +542,8 @@ void tcti_cmd_finalize (TSS2_TCTI_CONTEXT *tctiContext)
 
     reap_child (tcti_cmd->child_pid);
 
-    fclose (tcti_cmd->source);
-    fclose (tcti_cmd->sink);
+    close_fd (tcti_cmd->source);
+    close_fd (tcti_cmd->sink);
 }
 
 TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
@@ -470,6 +555,7 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
 #endif
     TSS2_TCTI_CMD_CONTEXT *tcti_cmd = tcti_cmd_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_cmd_down_cast (tcti_cmd);
+    struct timespec deadline, *deadline_ptr = NULL;
     TSS2_RC rc;
 
     rc = tcti_common_receive_checks (tcti_common, response_size,
@@ -478,9 +564,8 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
         return rc;
     }
 
-    if (timeout != TSS2_TCTI_TIMEOUT_BLOCK) {
-        LOG_TRACE ("Asynchronous I/O not actually implemented.");
 #ifdef TEST_FAPI_ASYNC
+    if (timeout != TSS2_TCTI_TIMEOUT_BLOCK) {
         if (wait < 1) {
             LOG_TRACE ("Simulating Async by requesting another invocation.");
             wait += 1;
@@ -489,70 +574,74 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
             LOG_TRACE ("Sending the actual result.");
             wait = 0;
         }
-#endif /* TEST_FAPI_ASYNC */
     }
+#endif /* TEST_FAPI_ASYNC */
 
-    if (!response_buffer) {
-        *response_size = 4096;
-        return TSS2_RC_SUCCESS;
+    /* a negative timeout, i.e. TSS2_TCTI_TIMEOUT_BLOCK, waits forever */
+    if (timeout >= 0) {
+        clock_gettime (CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        deadline_ptr = &deadline;
     }
 
-    /* block until we have a header or the child closes the pipe */
-    size_t size = tcti_cmd_fread (response_buffer, 1, TPM_HEADER_SIZE, tcti_cmd->source);
-    rc = tcti_cmd_ferror (tcti_cmd->source);
-    if (rc) {
-        LOG_ERROR ("Reading from command TCTI: %s", strerror (errno));
-        rc = TSS2_TCTI_RC_IO_ERROR;
-        goto out;
-    }
+    /* the header is read once, even if the caller asks for the size first */
+    if (tcti_cmd->header_read < TPM_HEADER_SIZE) {
+        rc = read_exact (tcti_cmd->source, tcti_cmd->header, TPM_HEADER_SIZE,
+                &tcti_cmd->header_read, deadline_ptr);
+        if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+            return rc;
+        } else if (rc != TSS2_RC_SUCCESS) {
+            goto out;
+        }
 
-    if (size != TPM_HEADER_SIZE) {
-        LOG_ERROR ("Read was not size of header, got %zu expected %zu",
-                size, TPM_HEADER_SIZE);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
-        goto out;
+        rc = header_unmarshal (tcti_cmd->header, &tcti_common->header);
+        if (rc) {
+            goto out;
+        }
+
+        if (tcti_common->header.size < TPM_HEADER_SIZE) {
+            LOG_ERROR ("Header response size is less than TPM_HEADER_SIZE,"
+                    " got %" PRIu32 " expected greater than or equal to %zu",
+                    tcti_common->header.size, TPM_HEADER_SIZE);
+            rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
+            goto out;
+        }
     }
 
-    /*
-     * we have a header, get the size field to compute the rest of
-     * the data.
-     */
-    rc = header_unmarshal (response_buffer, &tcti_common->header);
-    if (rc) {
-        goto out;
+    /* partial read: report the exact size of the response */
+    if (!response_buffer) {
+        *response_size = tcti_common->header.size;
+        return TSS2_RC_SUCCESS;
     }
 
-    if (tcti_common->header.size < TPM_HEADER_SIZE) {
-        LOG_ERROR ("Header response size is less than TPM_HEADER_SIZE,"
-                " got %" PRIu32 " expected greater than or equal to %zu",
-                tcti_common->header.size, TPM_HEADER_SIZE);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
-        goto out;
+    if (*response_size < tcti_common->header.size) {
+        LOG_DEBUG ("Response of %" PRIu32 " bytes does not fit into buffer "
+                "of %zu bytes", tcti_common->header.size, *response_size);
+        *response_size = tcti_common->header.size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
     }
 
     /*
-     * Read the remaining data that is past the header size
+     * Read exactly the remaining data that is past the header size. A read
+     * that timed out is continued in the same buffer by the next call.
      */
-    size_t data_size = tcti_common->header.size - TPM_HEADER_SIZE;
-
-    size = tcti_cmd_fread (&response_buffer[TPM_HEADER_SIZE], 1, data_size,
-            tcti_cmd->source);
-    rc = tcti_cmd_ferror (tcti_cmd->source);
-    if (rc) {
-        rc = errno == EFAULT ?
-                TSS2_TCTI_RC_INSUFFICIENT_BUFFER : TSS2_TCTI_RC_IO_ERROR;
-        LOG_ERROR ("Reading from command TCTI: %s", strerror (errno));
-        goto out;
-    }
-
-    if (size != data_size) {
-        LOG_ERROR ("Command response body read was not for expected size, "
-                "got %zu expected %zu", size, data_size);
-        rc = TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    rc = read_exact (tcti_cmd->source, &response_buffer[TPM_HEADER_SIZE],
+            tcti_common->header.size - TPM_HEADER_SIZE, &tcti_cmd->body_read,
+            deadline_ptr);
+    if (rc == TSS2_TCTI_RC_TRY_AGAIN) {
+        return rc;
+    } else if (rc != TSS2_RC_SUCCESS) {
         goto out;
     }
 
+    memcpy (response_buffer, tcti_cmd->header, TPM_HEADER_SIZE);
     *response_size = tcti_common->header.size;
+    LOGBLOB_DEBUG (response_buffer, *response_size, "Response Received");
 
     /*
      * Executing code beyond this point transitions the state machine to
@@ -560,6 +649,8 @@ TSS2_RC tcti_cmd_receive (TSS2_TCTI_CONTEXT *tctiContext, size_t *response_size,
      * another command is sent to the TPM.
      */
 out:
+    tcti_cmd->header_read = 0;
+    tcti_cmd->body_read = 0;
     tcti_common->header.size = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
 
@@ -602,9 +693,11 @@ TSS2_RC Tss2_Tcti_Cmd_Init (TSS2_TCTI_CONTEXT *tctiContext, size_t *size,
 
     LOG_DEBUG ("Initializing command TCTI with command: %s", conf);
 
-    tcti_command->sink = NULL;
-    tcti_command->source = NULL;
+    tcti_command->sink = -1;
+    tcti_command->source = -1;
     tcti_command->child_pid = -1;
+    tcti_command->header_read = 0;
+    tcti_command->body_read = 0;
 
     int rc = popen_w_pipes (conf, &tcti_command->child_pid, &tcti_command->sink,
             &tcti_command->source);
@@ -22,11 +22,19 @@
 typedef struct TSS2_TCTI_CMD_CONTEXT TSS2_TCTI_CMD_CONTEXT;
 struct TSS2_TCTI_CMD_CONTEXT {
     TSS2_TCTI_COMMON_CONTEXT common;
-    /* stdin of the subprocess */
-    FILE *sink;
-    /* stdout of the subprocess */
-    FILE *source;
+    /* stdin of the subprocess, non-blocking */
+    int sink;
+    /* stdout of the subprocess, non-blocking */
+    int source;
     pid_t child_pid;
+    /*
+     * A response is read in two steps that may each be interrupted by a
+     * timeout: the header into 'header' and then exactly the remaining bytes
+     * into the response buffer of the caller.
+     */
+    uint8_t header[TPM_HEADER_SIZE];
+    size_t header_read;
+    size_t body_read;
 };
 
 /*
@@ -40,12 +48,10 @@ struct TSS2_TCTI_CMD_CONTEXT {
 
 WEAK int tcti_cmd_pipe (int pipefd[2]);
 WEAK int tcti_cmd_fork (void);
-WEAK FILE *tcti_cmd_fdopen (int fd, const char *mode);
+WEAK int tcti_cmd_fcntl (int fd, int cmd, int arg);
 WEAK int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset);
-WEAK size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream);
-WEAK size_t tcti_cmd_fread (void *ptr, size_t size, size_t nmemb, FILE *stream);
-WEAK int tcti_cmd_ferror (FILE *stream);
+WEAK ssize_t tcti_cmd_write (int fd, const void *buf, size_t count);
+WEAK ssize_t tcti_cmd_read (int fd, void *buf, size_t count);
 #endif
 
 #endif /* TCTI_CMD_H */
@@ -8,6 +8,7 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
@@ -141,21 +142,23 @@ send_sim_session_end (
 }
 
 /*
- * This function is used to send the simulator a sort of command message
- * that tells it we're about to send it a TPM command. This requires that
- * we first send it a 4 byte code that's defined by the simulator. Then
- * another byte identifying the locality and finally the size of the TPM
- * command buffer that we're about to send. After these 9 bytes are sent
- * the simulator will accept a TPM command buffer.
+ * This function is used to send a TPM command to the simulator. The command
+ * buffer must be preceded by a sort of command message that tells the
+ * simulator we're about to send it a TPM command. This consists of a 4 byte
+ * code that's defined by the simulator, another byte identifying the locality
+ * and finally the size of the TPM command buffer. Both parts are handed to
+ * the socket in a single gather write so that they end up in one segment.
  */
 #define SIM_CMD_SIZE (sizeof (UINT32) + sizeof (UINT8) + sizeof (UINT32))
 TSS2_RC
-send_sim_cmd_setup (
+send_sim_cmd (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim,
+    const uint8_t *cmd_buf,
     UINT32 size)
 {
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
     uint8_t buf [SIM_CMD_SIZE] = { 0 };
+    struct iovec iov [2];
     size_t offset = 0;
     TSS2_RC rc;
 
@@ -180,7 +183,13 @@ send_sim_cmd_setup (
         return rc;
     }
 
-    return socket_xmit_buf (tcti_mssim->tpm_sock, buf, sizeof (buf));
+    iov[0].iov_base = buf;
+    iov[0].iov_len = sizeof (buf);
+    iov[1].iov_base = (void *)cmd_buf;
+    iov[1].iov_len = size;
+    LOGBLOB_DEBUG (cmd_buf, size, "Sending command of %" PRIu32 " bytes:", size);
+
+    return socket_xmit_bufs (tcti_mssim->tpm_sock, iov, 2);
 }
 
 TSS2_RC
@@ -210,11 +219,7 @@ tcti_mssim_transmit (
 
     LOG_DEBUG ("Sending command with TPM_CC 0x%" PRIx32 " and size %" PRIu32,
                header.code, header.size);
-    rc = send_sim_cmd_setup (tcti_mssim, header.size);
-    if (rc != TSS2_RC_SUCCESS) {
-        return rc;
-    }
-    rc = socket_xmit_buf (tcti_mssim->tpm_sock, cmd_buf, size);
+    rc = send_sim_cmd (tcti_mssim, cmd_buf, header.size);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
@@ -322,8 +327,10 @@ tcti_mssim_receive (
     TSS2_TCTI_MSSIM_CONTEXT *tcti_mssim = tcti_mssim_context_cast (tctiContext);
     TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mssim_down_cast (tcti_mssim);
     TSS2_RC rc;
-    UINT32 trash;
-    int ret;
+    struct iovec iov [2];
+    size_t total, offset;
+    ssize_t recvd;
+    int ret, iovcnt;
 
     rc = tcti_common_receive_checks (tcti_common,
                                      response_size,
@@ -389,42 +396,52 @@ tcti_mssim_receive (
 
     /* Receive the TPM response. */
     LOG_DEBUG ("Reading response of size %" PRIu32, tcti_common->header.size);
-    ret = socket_poll(tcti_mssim->tpm_sock, timeout);
-    if (ret != TSS2_RC_SUCCESS) {
+    /*
+     * The simulator sends the response right after its size, so it is read
+     * without polling first. The response is followed by four bytes of 0's,
+     * read both at once. Only if the rest has not arrived yet, wait for it
+     * within the timeout. The bytes received so far are kept in the context,
+     * so a call returning TSS2_TCTI_RC_TRY_AGAIN can be repeated with the
+     * same response buffer.
+     */
+    total = tcti_common->header.size + sizeof (tcti_mssim->trailer);
+    while (tcti_mssim->response_recvd < total) {
+        if (tcti_mssim->response_recvd < tcti_common->header.size) {
+            iov[0].iov_base = &response_buffer [tcti_mssim->response_recvd];
+            iov[0].iov_len = tcti_common->header.size - tcti_mssim->response_recvd;
+            iov[1].iov_base = &tcti_mssim->trailer;
+            iov[1].iov_len = sizeof (tcti_mssim->trailer);
+            iovcnt = 2;
+        } else {
+            offset = tcti_mssim->response_recvd - tcti_common->header.size;
+            iov[0].iov_base = (uint8_t *)&tcti_mssim->trailer + offset;
+            iov[0].iov_len = sizeof (tcti_mssim->trailer) - offset;
+            iovcnt = 1;
+        }
+        errno = 0;
+        recvd = socket_recv_bufs (tcti_mssim->tpm_sock, iov, iovcnt);
+        tcti_mssim->response_recvd += recvd;
+        if (tcti_mssim->response_recvd == total) {
+            break;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_DEBUG ("Error reading response, got %zu bytes",
+                       tcti_mssim->response_recvd);
+            rc = TSS2_TCTI_RC_IO_ERROR;
+            goto out;
+        }
+        ret = socket_poll (tcti_mssim->tpm_sock, timeout);
         if (ret == TSS2_TCTI_RC_TRY_AGAIN) {
             return ret;
         }
-        rc = ret;
-        goto out;
-    }
-    ret = socket_recv_buf (tcti_mssim->tpm_sock,
-                           (unsigned char *)response_buffer,
-                           tcti_common->header.size);
-    if (ret < (ssize_t)tcti_common->header.size) {
-        rc = TSS2_TCTI_RC_IO_ERROR;
-        goto out;
+        if (ret != TSS2_RC_SUCCESS) {
+            rc = ret;
+            goto out;
+        }
     }
     LOGBLOB_DEBUG(response_buffer, tcti_common->header.size,
                   "Response buffer received:");
 
-    ret = socket_poll (tcti_mssim->tpm_sock, timeout);
-    if (ret != TSS2_RC_SUCCESS) {
-        if (ret == TSS2_TCTI_RC_TRY_AGAIN) {
-            return ret;
-        }
-        rc = ret;
-        goto out;
-    }
-
-    /* Receive the appended four bytes of 0's */
-    ret = socket_recv_buf (tcti_mssim->tpm_sock,
-                           (unsigned char *)&trash, 4);
-    if (ret != 4) {
-        LOG_DEBUG ("Error reading last 4 bytes %" PRIu32, ret);
-        rc = TSS2_TCTI_RC_IO_ERROR;
-        goto out;
-    }
-
     if (tcti_mssim->cancel) {
         rc = tcti_platform_command (tctiContext, MS_SIM_CANCEL_OFF);
         tcti_mssim->cancel = 0;
@@ -436,6 +453,7 @@ tcti_mssim_receive (
      */
 out:
     tcti_common->header.size = 0;
+    tcti_mssim->response_recvd = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
 
     return rc;
@@ -39,6 +39,10 @@ typedef struct {
  * This is a temporary flag, which will be changed into
  * a tcti state when support for asynch operation will be added */
     bool cancel;
+/* Number of bytes of the response and of the four bytes of 0's appended by
+ * the simulator that have been received by previous calls to 'receive'. */
+    size_t response_recvd;
+    UINT32 trailer;
 } TSS2_TCTI_MSSIM_CONTEXT;
 
 #endif /* TCTI_MSSIM_H */
@@ -0,0 +1,669 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tss2_tpm2_types.h"
+#include "tss2_common.h"
+#include "tss2_tcti.h"
+#include "tss2_tcti_mux.h"
+#include "tss2_tctildr.h"
+#include "tcti-common.h"
+#include "tcti-mux.h"
+#define LOGMODULE tcti
+#include "util/log.h"
+
+/*
+ * This function wraps the "up-cast" of the opaque TCTI context type to the
+ * type for the mux TCTI context. The only safeguard we have to ensure this
+ * operation is possible is the magic number in the mux TCTI context.
+ * If passed a NULL context, or the magic number check fails, this function
+ * will return NULL.
+ */
+TSS2_TCTI_MUX_CONTEXT*
+tcti_mux_context_cast (TSS2_TCTI_CONTEXT *tcti_ctx)
+{
+    if (tcti_ctx != NULL && TSS2_TCTI_MAGIC (tcti_ctx) == TCTI_MUX_MAGIC) {
+        return (TSS2_TCTI_MUX_CONTEXT*)tcti_ctx;
+    }
+    return NULL;
+}
+
+/*
+ * This function down-casts the mux TCTI context to the common context
+ * defined in the tcti-common module.
+ */
+TSS2_TCTI_COMMON_CONTEXT*
+tcti_mux_down_cast (TSS2_TCTI_MUX_CONTEXT *tcti_mux)
+{
+    if (tcti_mux == NULL) {
+        return NULL;
+    }
+    return &tcti_mux->common;
+}
+
+/*
+ * Remove a client from the queue of the multiplexer. The mutex of the
+ * shared state must be held by the caller.
+ */
+static void
+tcti_mux_unqueue (
+    tcti_mux_shared_t *shared,
+    TSS2_TCTI_MUX_CONTEXT *client)
+{
+    TSS2_TCTI_MUX_CONTEXT **link;
+
+    for (link = &shared->queue; *link != NULL; link = &(*link)->next) {
+        if (*link == client) {
+            *link = client->next;
+            client->next = NULL;
+            return;
+        }
+    }
+}
+
+/*
+ * Select the next command to be dispatched and remove it from the queue.
+ * The queue is ordered by the time of transmission. The oldest command of
+ * the highest priority is selected, unless an older command was already
+ * passed over TCTI_MUX_MAX_SKIPS times. The mutex of the shared state must
+ * be held by the caller.
+ */
+static TSS2_TCTI_MUX_CONTEXT*
+tcti_mux_dequeue (
+    tcti_mux_shared_t *shared)
+{
+    TSS2_TCTI_MUX_CONTEXT *client, *next = NULL;
+
+    for (client = shared->queue; client != NULL; client = client->next) {
+        if (client->skips >= TCTI_MUX_MAX_SKIPS) {
+            next = client;
+            break;
+        }
+        if (next == NULL || client->priority > next->priority) {
+            next = client;
+        }
+    }
+    if (next == NULL) {
+        return NULL;
+    }
+
+    /* The older commands were passed over once more. */
+    for (client = shared->queue; client != next; client = client->next) {
+        client->skips += 1;
+    }
+    tcti_mux_unqueue (shared, next);
+    return next;
+}
+
+/*
+ * Signal the poll handle of a client: one byte is written to the pipe while
+ * a response is available.
+ */
+static void
+tcti_mux_notify (
+    TSS2_TCTI_MUX_CONTEXT *client)
+{
+    uint8_t byte = 0;
+
+    if (write (client->notify_fd[1], &byte, 1) != 1) {
+        LOG_WARNING ("Failed to signal poll handle: %s", strerror (errno));
+    }
+}
+
+/*
+ * Reset the poll handle of a client after the response was received.
+ */
+static void
+tcti_mux_notify_reset (
+    TSS2_TCTI_MUX_CONTEXT *client)
+{
+    uint8_t byte;
+
+    while (read (client->notify_fd[0], &byte, 1) == 1);
+}
+
+/*
+ * Execute the command of a client on the child TCTI. The command and
+ * response buffers of the client are owned by the worker thread while
+ * the command is in the DISPATCHED state.
+ */
+static TSS2_RC
+tcti_mux_execute (
+    tcti_mux_shared_t *shared,
+    TSS2_TCTI_MUX_CONTEXT *client)
+{
+    TSS2_RC rc;
+
+    if (client->locality_set &&
+        (!shared->locality_set || shared->locality != client->common.locality)) {
+        rc = Tss2_Tcti_SetLocality (shared->tcti_child, client->common.locality);
+        if (rc != TSS2_RC_SUCCESS) {
+            LOG_ERROR ("Failed calling TCTI set locality of child TCTI module");
+            return rc;
+        }
+        shared->locality = client->common.locality;
+        shared->locality_set = true;
+    }
+
+    rc = Tss2_Tcti_Transmit (shared->tcti_child, client->cmd_size,
+                             client->cmd_buf);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Failed calling TCTI transmit of child TCTI module");
+        return rc;
+    }
+
+    client->rsp_size = sizeof (client->rsp_buf);
+    rc = Tss2_Tcti_Receive (shared->tcti_child, &client->rsp_size,
+                            client->rsp_buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Failed calling TCTI receive of child TCTI module");
+    }
+    return rc;
+}
+
+/*
+ * The worker thread of a multiplexer. It dispatches the queued commands
+ * to the child TCTI until the last client was finalized.
+ */
+static void*
+tcti_mux_worker (
+    void *arg)
+{
+    tcti_mux_shared_t *shared = arg;
+    TSS2_TCTI_MUX_CONTEXT *client;
+    TSS2_RC rc;
+
+    pthread_mutex_lock (&shared->mutex);
+    for (;;) {
+        while (!shared->stop && shared->queue == NULL) {
+            pthread_cond_wait (&shared->queue_cond, &shared->mutex);
+        }
+        if (shared->stop) {
+            break;
+        }
+
+        client = tcti_mux_dequeue (shared);
+        client->cmd_state = TCTI_MUX_CMD_DISPATCHED;
+        pthread_mutex_unlock (&shared->mutex);
+
+        rc = tcti_mux_execute (shared, client);
+
+        pthread_mutex_lock (&shared->mutex);
+        client->rc = rc;
+        client->cmd_state = TCTI_MUX_CMD_DONE;
+        tcti_mux_notify (client);
+        pthread_cond_broadcast (&shared->done_cond);
+    }
+    pthread_mutex_unlock (&shared->mutex);
+
+    return NULL;
+}
+
+TSS2_RC
+tcti_mux_transmit (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tcti_ctx);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    tcti_mux_shared_t *shared;
+    TSS2_RC rc;
+
+    if (tcti_mux == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_transmit_checks (tcti_common, cmd_buf, TCTI_MUX_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (size > sizeof (tcti_mux->cmd_buf)) {
+        LOG_ERROR ("Command of %zu bytes exceeds the maximum of %zu bytes",
+                   size, sizeof (tcti_mux->cmd_buf));
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    LOGBLOB_DEBUG (cmd_buf, size, "queueing %zu byte command buffer:", size);
+
+    memcpy (tcti_mux->cmd_buf, cmd_buf, size);
+    tcti_mux->cmd_size = size;
+
+    /* Append the command to the queue and wake up the worker. */
+    shared = tcti_mux->shared;
+    pthread_mutex_lock (&shared->mutex);
+    TSS2_TCTI_MUX_CONTEXT **link = &shared->queue;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = tcti_mux;
+    tcti_mux->next = NULL;
+    tcti_mux->skips = 0;
+    tcti_mux->cmd_state = TCTI_MUX_CMD_QUEUED;
+    pthread_cond_signal (&shared->queue_cond);
+    pthread_mutex_unlock (&shared->mutex);
+
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Wait until the command of a client is done. The mutex of the shared state
+ * must be held by the caller. Returns false if the timeout expired.
+ */
+static bool
+tcti_mux_wait_done (
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux,
+    int32_t timeout)
+{
+    tcti_mux_shared_t *shared = tcti_mux->shared;
+    struct timespec deadline;
+
+    if (timeout == TSS2_TCTI_TIMEOUT_BLOCK) {
+        while (tcti_mux->cmd_state != TCTI_MUX_CMD_DONE) {
+            pthread_cond_wait (&shared->done_cond, &shared->mutex);
+        }
+        return true;
+    }
+
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long) (timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (tcti_mux->cmd_state != TCTI_MUX_CMD_DONE) {
+        if (pthread_cond_timedwait (&shared->done_cond, &shared->mutex,
+                                    &deadline) == ETIMEDOUT) {
+            return tcti_mux->cmd_state == TCTI_MUX_CMD_DONE;
+        }
+    }
+    return true;
+}
+
+TSS2_RC
+tcti_mux_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    unsigned char *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    tcti_mux_shared_t *shared;
+    TSS2_RC rc;
+
+    if (tcti_mux == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_receive_checks (tcti_common, response_size, TCTI_MUX_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    shared = tcti_mux->shared;
+    pthread_mutex_lock (&shared->mutex);
+    if (!tcti_mux_wait_done (tcti_mux, timeout)) {
+        pthread_mutex_unlock (&shared->mutex);
+        return TSS2_TCTI_RC_TRY_AGAIN;
+    }
+
+    rc = tcti_mux->rc;
+    if (rc == TSS2_RC_SUCCESS) {
+        /* partial read */
+        if (response_buffer == NULL) {
+            *response_size = tcti_mux->rsp_size;
+            pthread_mutex_unlock (&shared->mutex);
+            return TSS2_RC_SUCCESS;
+        }
+        if (*response_size < tcti_mux->rsp_size) {
+            *response_size = tcti_mux->rsp_size;
+            pthread_mutex_unlock (&shared->mutex);
+            return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+        }
+        memcpy (response_buffer, tcti_mux->rsp_buf, tcti_mux->rsp_size);
+        *response_size = tcti_mux->rsp_size;
+        LOGBLOB_DEBUG (response_buffer, *response_size, "Response Received");
+    }
+    tcti_mux->cmd_state = TCTI_MUX_CMD_IDLE;
+    tcti_mux_notify_reset (tcti_mux);
+    pthread_mutex_unlock (&shared->mutex);
+
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return rc;
+}
+
+TSS2_RC
+tcti_mux_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    tcti_mux_shared_t *shared;
+    TSS2_RC rc;
+
+    if (tcti_mux == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_cancel_checks (tcti_common, TCTI_MUX_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* Only commands which were not yet dispatched can be cancelled. */
+    shared = tcti_mux->shared;
+    pthread_mutex_lock (&shared->mutex);
+    if (tcti_mux->cmd_state == TCTI_MUX_CMD_DISPATCHED) {
+        pthread_mutex_unlock (&shared->mutex);
+        LOG_WARNING ("Command is executed by the child TCTI and can't be cancelled");
+        return TSS2_TCTI_RC_NOT_PERMITTED;
+    }
+    tcti_mux_unqueue (shared, tcti_mux);
+    tcti_mux->cmd_state = TCTI_MUX_CMD_IDLE;
+    tcti_mux_notify_reset (tcti_mux);
+    pthread_mutex_unlock (&shared->mutex);
+
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_mux_set_locality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    TSS2_RC rc;
+
+    if (tcti_mux == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_set_locality_checks (tcti_common, TCTI_MUX_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* The locality is set on the child TCTI before the next command. */
+    tcti_common->locality = locality;
+    tcti_mux->locality_set = true;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_mux_get_poll_handles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+
+    if (num_handles == NULL || tcti_mux == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+
+    if (handles != NULL && *num_handles < 1) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    /* The handle becomes readable when the response can be received. */
+    *num_handles = 1;
+    if (handles != NULL) {
+        handles->fd = tcti_mux->notify_fd[0];
+        handles->events = POLLIN;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Release the shared state of a multiplexer after the last client was
+ * finalized.
+ */
+static void
+tcti_mux_shared_free (
+    tcti_mux_shared_t *shared)
+{
+    Tss2_TctiLdr_Finalize (&shared->tcti_child);
+    pthread_cond_destroy (&shared->done_cond);
+    pthread_cond_destroy (&shared->queue_cond);
+    pthread_mutex_destroy (&shared->mutex);
+    free (shared);
+}
+
+void
+tcti_mux_finalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    tcti_mux_shared_t *shared;
+    bool last;
+
+    if (tcti_mux == NULL || tcti_common->state == TCTI_STATE_FINAL) {
+        return;
+    }
+
+    /* Drop a queued command and wait for a dispatched one. */
+    shared = tcti_mux->shared;
+    pthread_mutex_lock (&shared->mutex);
+    tcti_mux_unqueue (shared, tcti_mux);
+    while (tcti_mux->cmd_state == TCTI_MUX_CMD_DISPATCHED) {
+        pthread_cond_wait (&shared->done_cond, &shared->mutex);
+    }
+    tcti_mux->cmd_state = TCTI_MUX_CMD_IDLE;
+    shared->clients -= 1;
+    last = (shared->clients == 0);
+    if (last) {
+        shared->stop = true;
+        pthread_cond_signal (&shared->queue_cond);
+    }
+    pthread_mutex_unlock (&shared->mutex);
+
+    close (tcti_mux->notify_fd[0]);
+    close (tcti_mux->notify_fd[1]);
+    tcti_mux->shared = NULL;
+
+    if (last) {
+        pthread_join (shared->worker, NULL);
+        tcti_mux_shared_free (shared);
+    }
+
+    tcti_common->state = TCTI_STATE_FINAL;
+}
+
+/*
+ * Initialize a client context of the multiplexer with the given shared
+ * state. This also registers the client with the shared state.
+ */
+static TSS2_RC
+tcti_mux_client_init (
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux,
+    tcti_mux_shared_t *shared)
+{
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_mux_down_cast (tcti_mux);
+    int i;
+
+    if (pipe (tcti_mux->notify_fd) != 0) {
+        LOG_ERROR ("Failed to create poll handle: %s", strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    for (i = 0; i < 2; i++) {
+        if (fcntl (tcti_mux->notify_fd[i], F_SETFL, O_NONBLOCK) != 0 ||
+            fcntl (tcti_mux->notify_fd[i], F_SETFD, FD_CLOEXEC) != 0) {
+            LOG_ERROR ("Failed to configure poll handle: %s", strerror (errno));
+            close (tcti_mux->notify_fd[0]);
+            close (tcti_mux->notify_fd[1]);
+            return TSS2_TCTI_RC_IO_ERROR;
+        }
+    }
+
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_MUX_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_mux_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_mux_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = tcti_mux_finalize;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_mux_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_mux_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_mux_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = tcti_make_sticky_not_implemented;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    tcti_common->locality = 3;
+    memset (&tcti_common->header, 0, sizeof (tcti_common->header));
+
+    tcti_mux->shared = shared;
+    tcti_mux->next = NULL;
+    tcti_mux->cmd_state = TCTI_MUX_CMD_IDLE;
+    tcti_mux->priority = TSS2_TCTI_MUX_PRIORITY_NORMAL;
+    tcti_mux->skips = 0;
+    tcti_mux->locality_set = false;
+
+    pthread_mutex_lock (&shared->mutex);
+    shared->clients += 1;
+    pthread_mutex_unlock (&shared->mutex);
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * This is an implementation of the standard TCTI initialization function for
+ * this module. It loads the child TCTI and starts the worker thread; the
+ * context is the first client of the new multiplexer.
+ */
+TSS2_RC
+Tss2_Tcti_Mux_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = (TSS2_TCTI_MUX_CONTEXT*) tctiContext;
+    tcti_mux_shared_t *shared;
+    TSS2_RC rc;
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_MUX_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (conf == NULL) {
+        LOG_TRACE ("tctiContext: 0x%" PRIxPTR ", size: 0x%" PRIxPTR ""
+                   " no configuration will be used.",
+                   (uintptr_t)tctiContext, (uintptr_t)size);
+    } else {
+        LOG_TRACE ("tctiContext: 0x%" PRIxPTR ", size: 0x%" PRIxPTR ", conf: %s",
+                   (uintptr_t)tctiContext, (uintptr_t)size, conf);
+    }
+
+    shared = calloc (1, sizeof (tcti_mux_shared_t));
+    if (shared == NULL) {
+        return TSS2_TCTI_RC_MEMORY;
+    }
+
+    rc = Tss2_TctiLdr_Initialize (conf, &shared->tcti_child);
+    if (rc != TSS2_RC_SUCCESS) {
+        LOG_ERROR ("Error loading TCTI: %s", conf);
+        free (shared);
+        return rc;
+    }
+
+    pthread_mutex_init (&shared->mutex, NULL);
+    pthread_cond_init (&shared->queue_cond, NULL);
+    pthread_cond_init (&shared->done_cond, NULL);
+
+    rc = tcti_mux_client_init (tcti_mux, shared);
+    if (rc != TSS2_RC_SUCCESS) {
+        tcti_mux_shared_free (shared);
+        return rc;
+    }
+
+    if (pthread_create (&shared->worker, NULL, tcti_mux_worker, shared) != 0) {
+        LOG_ERROR ("Failed to start the worker thread");
+        close (tcti_mux->notify_fd[0]);
+        close (tcti_mux->notify_fd[1]);
+        tcti_mux_shared_free (shared);
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Initialize a further client of the multiplexer of muxContext. The client
+ * shares the child TCTI; the multiplexer is kept until all of its clients,
+ * including muxContext, were finalized.
+ */
+TSS2_RC
+Tss2_Tcti_Mux_ClientInit (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    TSS2_TCTI_CONTEXT *muxContext)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = (TSS2_TCTI_MUX_CONTEXT*) tctiContext;
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux_parent = tcti_mux_context_cast (muxContext);
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_MUX_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (tcti_mux_parent == NULL ||
+        tcti_mux_parent->common.state == TCTI_STATE_FINAL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    return tcti_mux_client_init (tcti_mux, tcti_mux_parent->shared);
+}
+
+/*
+ * Set the priority of the commands of a client. Queued commands with a
+ * higher priority are dispatched first.
+ */
+TSS2_RC
+Tss2_Tcti_Mux_SetPriority (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t priority)
+{
+    TSS2_TCTI_MUX_CONTEXT *tcti_mux = tcti_mux_context_cast (tctiContext);
+
+    if (tcti_mux == NULL || tcti_mux->common.state == TCTI_STATE_FINAL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+
+    pthread_mutex_lock (&tcti_mux->shared->mutex);
+    tcti_mux->priority = priority;
+    pthread_mutex_unlock (&tcti_mux->shared->mutex);
+
+    return TSS2_RC_SUCCESS;
+}
+
+/* public info structure */
+const TSS2_TCTI_INFO tss2_tcti_info = {
+    .version = TCTI_VERSION,
+    .name = "tcti-mux",
+    .description = "TCTI module for sharing one TCTI between multiple clients.",
+    .config_help = "The child tcti module and its config string: <name>:<conf>",
+    .init = Tss2_Tcti_Mux_Init,
+};
+
+const TSS2_TCTI_INFO*
+Tss2_Tcti_Info (void)
+{
+    return &tss2_tcti_info;
+}
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef TCTI_MUX_H
+#define TCTI_MUX_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tpm2_types.h"
+#include "tcti-common.h"
+
+#define TCTI_MUX_MAGIC 0x6d75785f74637469ULL
+
+/*
+ * A queued command is dispatched at the latest after commands of other
+ * clients were dispatched before it this many times. This keeps clients
+ * with a low priority from starving.
+ */
+#define TCTI_MUX_MAX_SKIPS 8
+
+/*
+ * The state of the command of a client:
+ *   IDLE:       no command was transmitted
+ *   QUEUED:     the command waits in the queue of the multiplexer
+ *   DISPATCHED: the command is executed by the child TCTI
+ *   DONE:       the response (or error) can be received
+ */
+typedef enum {
+    TCTI_MUX_CMD_IDLE,
+    TCTI_MUX_CMD_QUEUED,
+    TCTI_MUX_CMD_DISPATCHED,
+    TCTI_MUX_CMD_DONE,
+} tcti_mux_cmd_state_t;
+
+typedef struct TSS2_TCTI_MUX_CONTEXT TSS2_TCTI_MUX_CONTEXT;
+
+/*
+ * The state shared by all clients of one multiplexer. The worker thread
+ * executes the queued commands one after the other on the child TCTI. The
+ * shared state is freed when the last client is finalized.
+ */
+typedef struct {
+    TSS2_TCTI_CONTEXT *tcti_child;
+    pthread_mutex_t mutex;
+    pthread_cond_t queue_cond;
+    pthread_cond_t done_cond;
+    pthread_t worker;
+    bool stop;
+    size_t clients;
+    TSS2_TCTI_MUX_CONTEXT *queue;
+    bool locality_set;
+    uint8_t locality;
+} tcti_mux_shared_t;
+
+struct TSS2_TCTI_MUX_CONTEXT {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    tcti_mux_shared_t *shared;
+    TSS2_TCTI_MUX_CONTEXT *next;
+    tcti_mux_cmd_state_t cmd_state;
+    uint8_t priority;
+    unsigned int skips;
+    bool locality_set;
+    int notify_fd[2];
+    TSS2_RC rc;
+    size_t cmd_size;
+    size_t rsp_size;
+    uint8_t cmd_buf[TPM2_MAX_COMMAND_SIZE];
+    uint8_t rsp_buf[TPM2_MAX_RESPONSE_SIZE];
+};
+
+#endif /* TCTI_MUX_H */
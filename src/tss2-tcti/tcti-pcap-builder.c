@@ -9,14 +9,21 @@
 #endif
 
 #include <time.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <netinet/in.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "tss2_common.h"
 #include "tcti-pcap-builder.h"
@@ -33,12 +40,15 @@
 #define PCAP_MINOR                          0x0000
 #define PCAP_BLOCK_TYPE_SHB                 0x0A0D0D0A
 #define PCAP_BLOCK_TYPE_IDB                 0x00000001
+#define PCAP_BLOCK_TYPE_ISB                 0x00000005
 #define PCAP_BLOCK_TYPE_EPB                 0x00000006
 #define PCAP_SHB_BYTE_ORDER_MAGIC           0x1A2B3C4D
 #define PCAP_SHB_SECTION_LEN_NOT_SPECIFIED  0xFFFFFFFFFFFFFFFFUL
 #define PCAP_IDB_LINKTYPE_IPv4              0x00E4
 #define PCAP_IDB_SNAP_LEN_NO_LIMIT          0x0000
 #define PCAP_EPB_INTERFACE_ID               0x00000000
+#define PCAP_OPT_ENDOFOPT                   0x0000
+#define PCAP_ISB_OPT_IFDROP                 0x0005
 
 #define IPv4_VERSION                0x4
 #define IPv4_TOS_BEST_EFFORT        0x00
@@ -66,7 +76,7 @@
  * pcap-ng file stucture:
  *
  *  * section header block          (shb)           |<-- file header
- *  * interface statistics block    (idb)           |
+ *  * interface description block   (idb)           |
  *
  *  * ┬ enhanced packet block       (epb)           |<-- single tpm req. or rsp.
  *    | * header                    (epb_header)    |
@@ -76,6 +86,9 @@
  *    |   |   | * header            (tcp_header)    |
  *    |   ┴   ┴ * tpm req. or resp.                 |
  *    ┴ * footer                    (epb_footer)    |
+ *
+ *  * interface statistics block    (isb)           |<-- buffered mode only,
+ *                                                  |    at the end of a file
  */
 
 /* section header block */
@@ -118,6 +131,21 @@ typedef struct __attribute__((packed)) {
     uint32_t block_len_cp;
 } epb_footer;
 
+/* interface statistics block with the isb_ifdrop option */
+typedef struct __attribute__((packed)) {
+    uint32_t block_type;
+    uint32_t block_len;
+    uint32_t interface_id;
+    uint32_t timestamp_high;
+    uint32_t timestamp_low;
+    uint16_t ifdrop_code;
+    uint16_t ifdrop_len;
+    uint64_t ifdrop;
+    uint16_t endofopt_code;
+    uint16_t endofopt_len;
+    uint32_t block_len_cp;
+} isb;
+
 /* ipv4 packet */
 typedef struct __attribute__((packed)) {
     uint8_t version_header_len;
@@ -185,14 +213,492 @@ pcap_write_tcp_segment (
     size_t payload_len,
     int direction);
 
+static size_t
+pcap_enhanced_packet_block_len (size_t payload_len)
+{
+    return sizeof (epb_header) +
+        TO_MULTIPLE_OF_4_BYTE (sizeof (ip_header) + sizeof (tcp_header) +
+                               payload_len) +
+        sizeof (epb_footer);
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * In buffered mode, pcap_print builds the enhanced packet blocks directly
+ * into a preallocated ring buffer and a writer thread appends them to the
+ * file. Blocks are stored contiguously: a block that does not fit between
+ * head and the end of the buffer is placed at the start, and limit marks the
+ * end of the data at the top of the buffer. The writer only advances tail
+ * after the data is written, so blocks are never overwritten while they are
+ * written to the file.
+ */
+struct pcap_writer {
+    pthread_mutex_t mutex;
+    pthread_cond_t data_cond;   /* signalled when blocks are added or on stop */
+    pthread_cond_t space_cond;  /* signalled when blocks have been written */
+    pthread_t thread;
+    uint8_t *data;
+    size_t size;
+    size_t head;                /* start of free space */
+    size_t tail;                /* start of the data not yet written */
+    size_t limit;               /* end of the data at the top of the buffer */
+    size_t used;                /* bytes of data, without the gap at limit */
+    uint32_t drop_timeout;      /* milliseconds */
+    uint64_t dropped;
+    bool dropping;
+    bool stop;
+};
+#endif /* HAVE_PTHREAD */
+
+static uint64_t
+pcap_env_uint (const char *name, uint64_t default_value)
+{
+    const char *value = getenv (name);
+    unsigned long long result;
+    char *end;
+
+    if (value == NULL || value[0] == '\0') {
+        return default_value;
+    }
+
+    errno = 0;
+    result = strtoull (value, &end, 0);
+    if (errno != 0 || *end != '\0') {
+        LOG_WARNING ("Ignoring invalid value of %s: %s", name, value);
+        return default_value;
+    }
+    return result;
+}
+
+static time_t
+pcap_now (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec;
+}
+
+static uint64_t
+pcap_timestamp (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_REALTIME, &ts) != 0) {
+        LOG_WARNING ("Failed to get time: %s", strerror (errno));
+        return 0;
+    }
+    return (uint64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/* write file header: SHB and IDB (can be written multiple times to same file) */
+static int
+pcap_write_file_header (pcap_buider_ctx *ctx)
+{
+    uint8_t buf[sizeof (shb) + sizeof (idb)];
+    size_t buf_len = sizeof (buf);
+    size_t offset = 0;
+    size_t uret;
+    int ret;
+
+    ret = pcap_write_section_header_block (ctx, buf, buf_len);
+    if (ret < 0) {
+        return ret;
+    }
+    offset += ret;
+
+    ret = pcap_write_interface_description_block (ctx,
+                                                  buf + offset,
+                                                  buf_len - offset);
+    if (ret < 0) {
+        return ret;
+    }
+    offset += ret;
+
+    uret = write_all (ctx->fd, buf, offset);
+    if (uret != offset) {
+        return -1;
+    }
+    ctx->file_size += offset;
+
+    return 0;
+}
+
+/*
+ * In buffered mode, the number of dropped packets is stored at the end of
+ * each file in an interface statistics block.
+ */
+static void
+pcap_write_statistics (pcap_buider_ctx *ctx)
+{
+#ifdef HAVE_PTHREAD
+    pcap_writer *writer = ctx->writer;
+    uint64_t timestamp = pcap_timestamp ();
+    size_t uret;
+
+    if (writer == NULL || ctx->fd < 0) {
+        return;
+    }
+
+    isb statistics = {
+        .block_type = PCAP_BLOCK_TYPE_ISB,
+        .block_len = sizeof (isb),
+        .interface_id = PCAP_EPB_INTERFACE_ID,
+        .timestamp_high = (timestamp >> 32) & 0xFFFFFFFF,
+        .timestamp_low = timestamp & 0xFFFFFFFF,
+        .ifdrop_code = PCAP_ISB_OPT_IFDROP,
+        .ifdrop_len = sizeof (statistics.ifdrop),
+        .endofopt_code = PCAP_OPT_ENDOFOPT,
+        .endofopt_len = 0,
+        .block_len_cp = sizeof (isb),
+    };
+
+    pthread_mutex_lock (&writer->mutex);
+    statistics.ifdrop = writer->dropped;
+    pthread_mutex_unlock (&writer->mutex);
+
+    uret = write_all (ctx->fd, (uint8_t *) &statistics, sizeof (statistics));
+    if (uret != sizeof (statistics)) {
+        LOG_WARNING ("Failed to write statistics to file: %s", strerror (errno));
+    }
+#else
+    UNUSED (ctx);
+#endif /* HAVE_PTHREAD */
+}
+
+/*
+ * Close the current file and rename <file>.N-1 to <file>.N, ..., <file> to
+ * <file>.1. The oldest file is overwritten. A new file is started with a
+ * file header.
+ */
+static int
+pcap_rotate (pcap_buider_ctx *ctx)
+{
+    size_t name_len = strlen (ctx->filename) + sizeof (".4294967295");
+    char *from = NULL, *to = NULL;
+    unsigned int i;
+    int ret = -1;
+
+    if (ctx->fd >= 0) {
+        pcap_write_statistics (ctx);
+        if (close (ctx->fd) != 0) {
+            LOG_WARNING ("Failed to close file: %s", strerror (errno));
+        }
+        ctx->fd = -1;
+    }
+
+    from = malloc (name_len);
+    to = malloc (name_len);
+    if (!from || !to) {
+        LOG_ERROR ("Out of memory");
+        goto cleanup;
+    }
+
+    for (i = ctx->rotate_count; i > 0; i--) {
+        if (i > 1) {
+            snprintf (from, name_len, "%s.%u", ctx->filename, i - 1);
+        } else {
+            snprintf (from, name_len, "%s", ctx->filename);
+        }
+        snprintf (to, name_len, "%s.%u", ctx->filename, i);
+        if (rename (from, to) != 0 && errno != ENOENT) {
+            LOG_WARNING ("Failed to rename %s to %s: %s", from, to,
+                         strerror (errno));
+        }
+    }
+
+    ctx->fd = open (ctx->filename, O_WRONLY | O_APPEND | O_CREAT | O_TRUNC |
+                    O_NONBLOCK, 0644);
+    if (ctx->fd < 0) {
+        LOG_ERROR ("Failed to open file %s: %s", ctx->filename,
+                   strerror (errno));
+        goto cleanup;
+    }
+    ctx->file_size = 0;
+    ctx->file_start = pcap_now ();
+
+    ret = pcap_write_file_header (ctx);
+    if (ret != 0) {
+        LOG_ERROR ("Failed to write to file %s: %s", ctx->filename,
+                   strerror (errno));
+    }
+
+cleanup:
+    free (from);
+    free (to);
+    return ret;
+}
+
+/*
+ * Write complete blocks to the file. Rotation happens between writes, so a
+ * file may grow beyond the rotation size by the data of one write.
+ */
+static int
+pcap_write_file (pcap_buider_ctx *ctx, const uint8_t *buf, size_t buf_len)
+{
+    size_t uret;
+
+    if (ctx->filename != NULL &&
+        (ctx->fd < 0 ||
+         (ctx->rotate_size > 0 && ctx->file_size >= ctx->rotate_size) ||
+         (ctx->rotate_time > 0 && pcap_now () - ctx->file_start >= ctx->rotate_time))) {
+        if (pcap_rotate (ctx) != 0) {
+            return -1;
+        }
+    }
+
+    uret = write_all (ctx->fd, buf, buf_len);
+    if (uret != buf_len) {
+        LOG_ERROR ("Failed to write to file: %s", strerror (errno));
+        return -1;
+    }
+    ctx->file_size += buf_len;
+
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * Find space for a block of len bytes. Must be called with the mutex held.
+ */
+static bool
+pcap_writer_reserve (pcap_writer *writer, size_t len, size_t *pos)
+{
+    if (writer->used == 0) {
+        writer->head = 0;
+        writer->tail = 0;
+        writer->limit = writer->size;
+    }
+
+    if (writer->head < writer->tail ||
+        (writer->head == writer->tail && writer->used > 0)) {
+        /* the data wraps around, free space is between head and tail */
+        if (writer->tail - writer->head < len) {
+            return false;
+        }
+        *pos = writer->head;
+        return true;
+    }
+
+    if (writer->size - writer->head >= len) {
+        *pos = writer->head;
+        return true;
+    }
+    if (writer->tail >= len) {
+        writer->limit = writer->head;
+        *pos = 0;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * With size based rotation, take only the blocks that fit into the current
+ * file, but at least one, so buffered and synchronous files are rotated at
+ * the same block boundaries.
+ */
+static size_t
+pcap_writer_chunk_len (pcap_buider_ctx *ctx, const uint8_t *data, size_t len)
+{
+    size_t chunk = 0, room;
+    uint32_t block_len;
+
+    if (ctx->filename == NULL || ctx->rotate_size == 0) {
+        return len;
+    }
+
+    room = ctx->file_size < ctx->rotate_size ?
+        ctx->rotate_size - ctx->file_size : 0;
+    while (chunk < len) {
+        memcpy (&block_len, &data[chunk + 4], sizeof (block_len));
+        if (chunk > 0 && chunk + block_len > room) {
+            break;
+        }
+        chunk += block_len;
+    }
+    return chunk;
+}
+
+static void *
+pcap_writer_thread (void *arg)
+{
+    pcap_buider_ctx *ctx = arg;
+    pcap_writer *writer = ctx->writer;
+    size_t start, len;
+
+    pthread_mutex_lock (&writer->mutex);
+    for (;;) {
+        while (writer->used == 0 && !writer->stop) {
+            pthread_cond_wait (&writer->data_cond, &writer->mutex);
+        }
+        if (writer->used == 0) {
+            break;
+        }
+
+        if (writer->tail >= writer->limit) {
+            writer->tail = 0;
+            writer->limit = writer->size;
+        }
+        start = writer->tail;
+        len = (writer->head > start ? writer->head : writer->limit) - start;
+        pthread_mutex_unlock (&writer->mutex);
+
+        len = pcap_writer_chunk_len (ctx, &writer->data[start], len);
+
+        /* errors are logged, the data is discarded */
+        pcap_write_file (ctx, &writer->data[start], len);
+
+        pthread_mutex_lock (&writer->mutex);
+        writer->tail += len;
+        writer->used -= len;
+        pthread_cond_broadcast (&writer->space_cond);
+    }
+    pthread_mutex_unlock (&writer->mutex);
+
+    return NULL;
+}
+
+static int
+pcap_writer_start (pcap_buider_ctx *ctx, size_t size, uint32_t drop_timeout)
+{
+    pcap_writer *writer;
+
+    writer = calloc (1, sizeof (*writer));
+    if (!writer) {
+        LOG_ERROR ("Out of memory");
+        return -1;
+    }
+    writer->data = malloc (size);
+    if (!writer->data) {
+        LOG_ERROR ("Out of memory");
+        free (writer);
+        return -1;
+    }
+    writer->size = size;
+    writer->limit = size;
+    writer->drop_timeout = drop_timeout;
+    pthread_mutex_init (&writer->mutex, NULL);
+    pthread_cond_init (&writer->data_cond, NULL);
+    pthread_cond_init (&writer->space_cond, NULL);
+
+    ctx->writer = writer;
+    if (pthread_create (&writer->thread, NULL, pcap_writer_thread, ctx) != 0) {
+        LOG_ERROR ("Failed to start PCAP writer thread");
+        ctx->writer = NULL;
+        pthread_cond_destroy (&writer->space_cond);
+        pthread_cond_destroy (&writer->data_cond);
+        pthread_mutex_destroy (&writer->mutex);
+        free (writer->data);
+        free (writer);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Write all buffered blocks and stop the writer thread. */
+static void
+pcap_writer_stop (pcap_buider_ctx *ctx)
+{
+    pcap_writer *writer = ctx->writer;
+
+    pthread_mutex_lock (&writer->mutex);
+    writer->stop = true;
+    pthread_cond_signal (&writer->data_cond);
+    pthread_mutex_unlock (&writer->mutex);
+    pthread_join (writer->thread, NULL);
+
+    if (writer->dropped > 0) {
+        LOG_WARNING ("%" PRIu64 " packets were dropped because the PCAP "
+                     "buffer was full", writer->dropped);
+    }
+    pcap_write_statistics (ctx);
+
+    ctx->writer = NULL;
+    pthread_cond_destroy (&writer->space_cond);
+    pthread_cond_destroy (&writer->data_cond);
+    pthread_mutex_destroy (&writer->mutex);
+    free (writer->data);
+    free (writer);
+}
+
+static int
+pcap_print_buffered (
+    pcap_buider_ctx *ctx,
+    const void* payload,
+    size_t payload_len,
+    int direction)
+{
+    pcap_writer *writer = ctx->writer;
+    size_t pdu_len = pcap_enhanced_packet_block_len (payload_len);
+    struct timespec deadline;
+    bool reserved;
+    size_t pos;
+    int ret;
+
+    pthread_mutex_lock (&writer->mutex);
+
+    reserved = pdu_len <= writer->size &&
+        pcap_writer_reserve (writer, pdu_len, &pos);
+    if (!reserved && pdu_len <= writer->size && writer->drop_timeout > 0) {
+        clock_gettime (CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += writer->drop_timeout / 1000;
+        deadline.tv_nsec += (long) (writer->drop_timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (!reserved) {
+            if (pthread_cond_timedwait (&writer->space_cond, &writer->mutex,
+                                        &deadline) == ETIMEDOUT) {
+                reserved = pcap_writer_reserve (writer, pdu_len, &pos);
+                break;
+            }
+            reserved = pcap_writer_reserve (writer, pdu_len, &pos);
+        }
+    }
+
+    if (!reserved) {
+        writer->dropped += 1;
+        if (!writer->dropping) {
+            LOG_WARNING ("PCAP buffer full, dropping packets");
+            writer->dropping = true;
+        }
+        /* keep the sequence numbers, so the gap is visible in the capture */
+        if (direction == PCAP_DIR_HOST_TO_TPM) {
+            ctx->tcp_sequence_no_host += payload_len;
+        } else if (direction == PCAP_DIR_TPM_TO_HOST) {
+            ctx->tcp_sequence_no_tpm += payload_len;
+        }
+        pthread_mutex_unlock (&writer->mutex);
+        return 1;
+    }
+
+    ret = pcap_write_enhanced_packet_block (ctx, &writer->data[pos], pdu_len,
+                                            payload, payload_len, direction);
+    if (ret < 0) {
+        pthread_mutex_unlock (&writer->mutex);
+        return ret;
+    }
+    writer->head = pos + pdu_len;
+    writer->used += pdu_len;
+    writer->dropping = false;
+    pthread_cond_signal (&writer->data_cond);
+    pthread_mutex_unlock (&writer->mutex);
+
+    return 0;
+}
+#endif /* HAVE_PTHREAD */
+
 int
 pcap_init (pcap_buider_ctx *ctx)
 {
     char *filename = getenv (ENV_PCAP_FILE);
     struct timespec time;
-    size_t buf_len;
-    size_t offset;
-    size_t uret;
+    uint64_t buffer_size;
+    struct stat st;
     int ret;
 
     if (filename == NULL) {
@@ -212,6 +718,10 @@ pcap_init (pcap_buider_ctx *ctx)
     ctx->tcp_sequence_no_host = rand();
     ctx->tcp_sequence_no_tpm = rand();
 
+    ctx->filename = NULL;
+    ctx->file_size = 0;
+    ctx->writer = NULL;
+
     if (!strcmp (filename, "stdout") || !strcmp (filename, "-")) {
         ctx->fd = STDOUT_FILENO;
     } else if (!strcmp (filename, "stderr")) {
@@ -222,33 +732,45 @@ pcap_init (pcap_buider_ctx *ctx)
             LOG_ERROR ("Failed to open file %s: %s", filename, strerror (errno));
             goto error;
         }
-    }
 
-    uint8_t buf[sizeof (shb) + sizeof (idb)];
-    buf_len = sizeof (buf);
-    offset = 0;
-
-    ret = pcap_write_section_header_block (ctx, buf, buf_len);
-    if (ret < 0) {
-        return ret;
-    }
-    offset += ret;
-
-    ret = pcap_write_interface_description_block (ctx,
-                                                  buf + offset,
-                                                  buf_len - offset);
-    if (ret < 0) {
-        return ret;
+        /* only regular files are rotated */
+        ctx->rotate_size = pcap_env_uint (ENV_PCAP_ROTATE_SIZE, 0);
+        ctx->rotate_time = pcap_env_uint (ENV_PCAP_ROTATE_TIME, 0);
+        ctx->rotate_count = pcap_env_uint (ENV_PCAP_ROTATE_COUNT,
+                                           DEFAULT_PCAP_ROTATE_COUNT);
+        if (ctx->rotate_size > 0 || ctx->rotate_time > 0) {
+            ctx->filename = strdup (filename);
+            if (!ctx->filename) {
+                LOG_ERROR ("Out of memory");
+                goto error;
+            }
+            if (fstat (ctx->fd, &st) == 0) {
+                ctx->file_size = st.st_size;
+            }
+            ctx->file_start = pcap_now ();
+        }
     }
-    offset += ret;
 
-    /* write file header: SHB and IDB (can be written multiple times to same file) */
-    uret = write_all (ctx->fd, buf, offset);
-    if (uret != offset) {
+    ret = pcap_write_file_header (ctx);
+    if (ret != 0) {
         LOG_ERROR ("Failed to write to file %s: %s", filename, strerror (errno));
         goto error;
     }
 
+    buffer_size = pcap_env_uint (ENV_PCAP_BUFFER_SIZE, 0);
+    if (buffer_size > 0) {
+#ifdef HAVE_PTHREAD
+        ret = pcap_writer_start (ctx, buffer_size,
+                                 pcap_env_uint (ENV_PCAP_DROP_TIMEOUT, 0));
+        if (ret != 0) {
+            goto error;
+        }
+#else
+        LOG_WARNING (ENV_PCAP_BUFFER_SIZE " is not supported without "
+                     "pthreads. Writing synchronously.");
+#endif /* HAVE_PTHREAD */
+    }
+
     return 0;
 
 error:
@@ -256,6 +778,10 @@ error:
     return -1;
 }
 
+/*
+ * Returns 0 on success, 1 if the packet was dropped because the buffer was
+ * full and a negative value on errors.
+ */
 int
 pcap_print (
     pcap_buider_ctx *ctx,
@@ -264,21 +790,19 @@ pcap_print (
     int direction)
 {
     size_t pdu_len;
-    size_t uret;
     int ret;
 
     if (!payload) {
         return -1;
     }
 
-    /* get required buffer size */
-    ret = pcap_write_enhanced_packet_block (ctx, NULL, 0,
-                                            payload, payload_len, direction);
-    if (ret < 0) {
-        return ret;
+#ifdef HAVE_PTHREAD
+    if (ctx->writer) {
+        return pcap_print_buffered (ctx, payload, payload_len, direction);
     }
-    pdu_len = ret;
+#endif /* HAVE_PTHREAD */
 
+    pdu_len = pcap_enhanced_packet_block_len (payload_len);
     uint8_t *buf = malloc (pdu_len);
     if (!buf) {
         LOG_ERROR ("Out of memory");
@@ -292,31 +816,51 @@ pcap_print (
     }
     pdu_len = ret;
 
-    uret = write_all (ctx->fd, buf, pdu_len);
-    if (uret != pdu_len) {
-        LOG_ERROR ("Failed to write to file: %s", strerror (errno));
-        ret = -1;
-        goto cleanup;
-    }
-
-    ret = 0;
+    ret = pcap_write_file (ctx, buf, pdu_len);
 
 cleanup:
     free (buf);
     return ret;
 }
 
+uint64_t
+pcap_dropped (pcap_buider_ctx *ctx)
+{
+    uint64_t dropped = 0;
+
+#ifdef HAVE_PTHREAD
+    if (ctx->writer) {
+        pthread_mutex_lock (&ctx->writer->mutex);
+        dropped = ctx->writer->dropped;
+        pthread_mutex_unlock (&ctx->writer->mutex);
+    }
+#else
+    UNUSED (ctx);
+#endif /* HAVE_PTHREAD */
+
+    return dropped;
+}
+
 void
 pcap_deinit (pcap_buider_ctx *ctx)
 {
     int ret;
 
+#ifdef HAVE_PTHREAD
+    if (ctx->writer) {
+        pcap_writer_stop (ctx);
+    }
+#endif /* HAVE_PTHREAD */
+
     if (ctx->fd != STDOUT_FILENO && ctx->fd != STDERR_FILENO && ctx->fd >= 0) {
         ret = close (ctx->fd);
         if (ret != 0) {
             LOG_WARNING ("Failed to close file: %s", strerror (errno));
         }
     }
+    ctx->fd = -1;
+    free (ctx->filename);
+    ctx->filename = NULL;
 }
 
 static int
@@ -388,17 +932,9 @@ pcap_write_enhanced_packet_block (
     UNUSED (ctx);
 
     size_t pdu_len, sdu_len, sdu_padded_len;
-    struct timespec ts;
     uint64_t timestamp;
-    int ret;
 
-    ret = clock_gettime (CLOCK_REALTIME, &ts);
-    if (ret != 0) {
-        LOG_WARNING ("Failed to get time: %s", strerror (errno));
-        ts.tv_sec = 0;
-        ts.tv_nsec = 0;
-    }
-    timestamp = (uint64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+    timestamp = pcap_timestamp ();
 
     /* get ip packet size */
     sdu_len = pcap_write_ip_packet (ctx, NULL, 0,
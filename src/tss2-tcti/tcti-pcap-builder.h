@@ -7,6 +7,8 @@
 #define TCTI_PCAP_BUILDER_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 #define PCAP_DIR_HOST_TO_TPM 0
 #define PCAP_DIR_TPM_TO_HOST 1
@@ -14,12 +16,33 @@
 #define ENV_PCAP_FILE     "TCTI_PCAP_FILE"
 #define DEFAULT_PCAP_FILE "tpm2_log.pcap"
 
+/* Size of the buffer in bytes; a non-zero value enables buffered mode */
+#define ENV_PCAP_BUFFER_SIZE  "TCTI_PCAP_BUFFER_SIZE"
+/* Milliseconds to wait for space in a full buffer before dropping a packet */
+#define ENV_PCAP_DROP_TIMEOUT "TCTI_PCAP_DROP_TIMEOUT"
+/* Start a new file once the current one has this many bytes */
+#define ENV_PCAP_ROTATE_SIZE  "TCTI_PCAP_ROTATE_SIZE"
+/* Start a new file once the current one is this many seconds old */
+#define ENV_PCAP_ROTATE_TIME  "TCTI_PCAP_ROTATE_TIME"
+/* Number of rotated files <file>.1 ... <file>.N that are kept */
+#define ENV_PCAP_ROTATE_COUNT "TCTI_PCAP_ROTATE_COUNT"
+#define DEFAULT_PCAP_ROTATE_COUNT 8
+
+typedef struct pcap_writer pcap_writer;
+
 typedef struct {
     int fd;
     uint32_t ip_host;
     uint32_t ip_tpm;
     uint32_t tcp_sequence_no_host;
     uint32_t tcp_sequence_no_tpm;
+    char *filename;         /* NULL for stdout and stderr */
+    uint64_t rotate_size;
+    time_t rotate_time;
+    unsigned int rotate_count;
+    uint64_t file_size;     /* bytes written to the current file */
+    time_t file_start;      /* CLOCK_MONOTONIC when the file was opened */
+    pcap_writer *writer;    /* NULL unless in buffered mode */
 } pcap_buider_ctx;
 
 int
@@ -30,7 +53,9 @@ pcap_print (
     const void* payload,
     size_t payload_len,
     int direction);
+uint64_t
+pcap_dropped (pcap_buider_ctx *ctx);
 void
 pcap_deinit (pcap_buider_ctx *ctx);
 
-#endif /* TCTI_PCAP_BUILDER_H */
\ No newline at end of file
+#endif /* TCTI_PCAP_BUILDER_H */
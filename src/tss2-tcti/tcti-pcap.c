@@ -77,7 +77,7 @@ tcti_pcap_transmit (
     ret = pcap_print (&tcti_pcap->pcap_builder,
                       cmd_buf, size,
                       PCAP_DIR_HOST_TO_TPM);
-    if (ret != 0) {
+    if (ret < 0) {
         LOG_WARNING ("Failed to save transmission to PCAP file.");
     }
 
@@ -129,7 +129,7 @@ tcti_pcap_receive (
     ret = pcap_print (&tcti_pcap->pcap_builder,
                       response_buffer, *response_size,
                       PCAP_DIR_TPM_TO_HOST);
-    if (ret != 0) {
+    if (ret < 0) {
         LOG_WARNING ("Failed to save transmission to PCAP file.");
     }
 
@@ -0,0 +1,763 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tss2_tpm2_types.h"
+#include "tss2_common.h"
+#include "tss2_tcti.h"
+#include "tss2_tcti_replay.h"
+#include "tcti-common.h"
+#include "tcti-pcap-builder.h"
+#include "tcti-replay.h"
+#include "util/key-value-parse.h"
+#define LOGMODULE tcti
+#include "util/log.h"
+
+/*
+ * The replay TCTI serves the responses recorded by tcti-pcap. The capture is
+ * mapped into memory and indexed once during initialization: every command
+ * is paired with the response sent back on the same connection. Transmit then
+ * only looks up the exchange and receive copies the recorded response, so no
+ * TPM or simulator is involved.
+ */
+
+#define PCAP_BLOCK_TYPE_SHB         0x0A0D0D0A
+#define PCAP_BLOCK_TYPE_IDB         0x00000001
+#define PCAP_BLOCK_TYPE_EPB         0x00000006
+#define PCAP_SHB_BYTE_ORDER_MAGIC   0x1A2B3C4D
+#define PCAP_IDB_LINKTYPE_IPv4      0x00E4
+#define PCAP_BLOCK_MIN_LEN          12
+#define PCAP_SHB_MIN_LEN            28
+#define PCAP_IDB_MIN_LEN            20
+#define PCAP_EPB_HEADER_LEN         28
+#define PCAP_MAX_INTERFACES         64
+
+#define IPv4_VERSION                0x4
+#define IPv4_HEADER_MIN_LEN         20
+#define IPv4_PROTOCOL_TCP           0x06
+#define TCP_HEADER_MIN_LEN          20
+#define TCP_TPM_PORT                2321
+
+#define TPM_HEADER_LEN              10
+
+static uint16_t
+replay_get_be16 (const uint8_t *buf)
+{
+    return (uint16_t) buf[0] << 8 | buf[1];
+}
+
+static uint32_t
+replay_get_be32 (const uint8_t *buf)
+{
+    return (uint32_t) buf[0] << 24 | (uint32_t) buf[1] << 16 |
+        (uint32_t) buf[2] << 8 | buf[3];
+}
+
+/* pcapng blocks are stored in the byte order of the writing host */
+static uint32_t
+replay_get_uint32 (const uint8_t *buf, bool swap)
+{
+    uint32_t value;
+
+    memcpy (&value, buf, sizeof (value));
+    return swap ? __builtin_bswap32 (value) : value;
+}
+
+static uint16_t
+replay_get_uint16 (const uint8_t *buf, bool swap)
+{
+    uint16_t value;
+
+    memcpy (&value, buf, sizeof (value));
+    return swap ? __builtin_bswap16 (value) : value;
+}
+
+/*
+ * This function wraps the "up-cast" of the opaque TCTI context type to the
+ * type for the replay TCTI context. The only safeguard we have to ensure this
+ * operation is possible is the magic number in the replay TCTI context.
+ * If passed a NULL context, or the magic number check fails, this function
+ * will return NULL.
+ */
+TSS2_TCTI_REPLAY_CONTEXT*
+tcti_replay_context_cast (TSS2_TCTI_CONTEXT *tcti_ctx)
+{
+    if (tcti_ctx != NULL && TSS2_TCTI_MAGIC (tcti_ctx) == TCTI_REPLAY_MAGIC) {
+        return (TSS2_TCTI_REPLAY_CONTEXT*)tcti_ctx;
+    }
+    return NULL;
+}
+
+/*
+ * This function down-casts the replay TCTI context to the common context
+ * defined in the tcti-common module.
+ */
+TSS2_TCTI_COMMON_CONTEXT*
+tcti_replay_down_cast (TSS2_TCTI_REPLAY_CONTEXT *tcti_replay)
+{
+    if (tcti_replay == NULL) {
+        return NULL;
+    }
+    return &tcti_replay->common;
+}
+
+/*
+ * Find the slot of a command code in the table of the lenient mode. The
+ * table has at least twice as many slots as there are exchanges, so there is
+ * always an unused slot.
+ */
+static tcti_replay_cc_t *
+replay_cc_slot (
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay,
+    TPM2_CC command_code)
+{
+    size_t mask = tcti_replay->cc_table_size - 1;
+    size_t i = (command_code * UINT32_C (0x9E3779B1)) & mask;
+
+    while (tcti_replay->cc_table[i].used &&
+           tcti_replay->cc_table[i].command_code != command_code) {
+        i = (i + 1) & mask;
+    }
+    return &tcti_replay->cc_table[i];
+}
+
+/*
+ * Chain the exchanges with the same command code in the order of the capture
+ * so that the lenient mode finds the next response in constant time.
+ */
+static TSS2_RC
+replay_index_command_codes (TSS2_TCTI_REPLAY_CONTEXT *tcti_replay)
+{
+    tcti_replay_exchange_t *exchange;
+    tcti_replay_cc_t *slot;
+    size_t i;
+
+    tcti_replay->cc_table_size = 16;
+    while (tcti_replay->cc_table_size < 2 * tcti_replay->num_exchanges) {
+        tcti_replay->cc_table_size <<= 1;
+    }
+    tcti_replay->cc_table = calloc (tcti_replay->cc_table_size,
+                                    sizeof (tcti_replay_cc_t));
+    if (tcti_replay->cc_table == NULL) {
+        LOG_ERROR ("Out of memory");
+        return TSS2_TCTI_RC_MEMORY;
+    }
+
+    for (i = tcti_replay->num_exchanges; i > 0; i--) {
+        exchange = &tcti_replay->exchanges[i - 1];
+        slot = replay_cc_slot (tcti_replay, exchange->command_code);
+        if (!slot->used) {
+            slot->used = true;
+            slot->command_code = exchange->command_code;
+            slot->first = TCTI_REPLAY_NONE;
+        }
+        exchange->next_same_cc = slot->first;
+        slot->first = i - 1;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Find the exchange that was last started on the connection of a host. The
+ * packets of concurrent connections may be interleaved in one capture.
+ */
+static tcti_replay_exchange_t *
+replay_find_connection (
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay,
+    uint32_t host)
+{
+    size_t i;
+
+    for (i = tcti_replay->num_exchanges; i > 0; i--) {
+        if (tcti_replay->exchanges[i - 1].host == host) {
+            return &tcti_replay->exchanges[i - 1];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Add the TPM command or response in an IPv4 packet to the exchanges. Packets
+ * which are not sent to or from the TPM port are ignored.
+ */
+static TSS2_RC
+replay_add_packet (
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay,
+    const uint8_t *packet,
+    size_t packet_len,
+    size_t *capacity)
+{
+    tcti_replay_exchange_t *exchange, *exchanges;
+    const uint8_t *tcp, *payload;
+    size_t ip_header_len, tcp_header_len, payload_len;
+    uint32_t source, destination;
+
+    if (packet_len < IPv4_HEADER_MIN_LEN || packet[0] >> 4 != IPv4_VERSION ||
+        packet[9] != IPv4_PROTOCOL_TCP) {
+        return TSS2_RC_SUCCESS;
+    }
+    ip_header_len = (packet[0] & 0x0F) * 4;
+    if (replay_get_be16 (&packet[2]) < packet_len) {
+        /* the enhanced packet block pads the packet to 4 bytes */
+        packet_len = replay_get_be16 (&packet[2]);
+    }
+    if (ip_header_len < IPv4_HEADER_MIN_LEN ||
+        packet_len < ip_header_len + TCP_HEADER_MIN_LEN) {
+        LOG_WARNING ("Skipping malformed IPv4 packet");
+        return TSS2_RC_SUCCESS;
+    }
+    source = replay_get_be32 (&packet[12]);
+    destination = replay_get_be32 (&packet[16]);
+
+    tcp = &packet[ip_header_len];
+    tcp_header_len = (tcp[12] >> 4) * 4;
+    if (tcp_header_len < TCP_HEADER_MIN_LEN ||
+        packet_len < ip_header_len + tcp_header_len) {
+        LOG_WARNING ("Skipping malformed TCP segment");
+        return TSS2_RC_SUCCESS;
+    }
+    payload = &tcp[tcp_header_len];
+    payload_len = packet_len - ip_header_len - tcp_header_len;
+    if (payload_len == 0) {
+        return TSS2_RC_SUCCESS;
+    }
+    if (payload_len < TPM_HEADER_LEN) {
+        LOG_WARNING ("Skipping TPM message of %zu bytes", payload_len);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (replay_get_be16 (&tcp[2]) == TCP_TPM_PORT) {
+        exchange = replay_find_connection (tcti_replay, source);
+        if (exchange == NULL || exchange->rsp != NULL) {
+            if (tcti_replay->num_exchanges == *capacity) {
+                *capacity = *capacity ? 2 * *capacity : 256;
+                exchanges = realloc (tcti_replay->exchanges,
+                                     *capacity * sizeof (*exchanges));
+                if (exchanges == NULL) {
+                    LOG_ERROR ("Out of memory");
+                    return TSS2_TCTI_RC_MEMORY;
+                }
+                tcti_replay->exchanges = exchanges;
+            }
+            exchange = &tcti_replay->exchanges[tcti_replay->num_exchanges++];
+        } else {
+            LOG_WARNING ("Skipping command without response");
+        }
+        exchange->cmd = payload;
+        exchange->cmd_size = payload_len;
+        exchange->rsp = NULL;
+        exchange->rsp_size = 0;
+        exchange->command_code = replay_get_be32 (&payload[6]);
+        exchange->next_same_cc = TCTI_REPLAY_NONE;
+        exchange->host = source;
+    } else if (replay_get_be16 (&tcp[0]) == TCP_TPM_PORT) {
+        exchange = replay_find_connection (tcti_replay, destination);
+        if (exchange == NULL || exchange->rsp != NULL) {
+            LOG_WARNING ("Skipping response without command");
+            return TSS2_RC_SUCCESS;
+        }
+        exchange->rsp = payload;
+        exchange->rsp_size = payload_len;
+    }
+
+    return TSS2_RC_SUCCESS;
+}
+
+/*
+ * Walk the blocks of the mapped capture and collect the exchanges. A capture
+ * may hold several sections, e.g. when tcti-pcap appended to an existing
+ * file. A block that is cut off at the end of the file, e.g. because the
+ * recording process was killed, ends the capture.
+ */
+static TSS2_RC
+replay_load (TSS2_TCTI_REPLAY_CONTEXT *tcti_replay)
+{
+    const uint8_t *data = tcti_replay->map, *block;
+    size_t size = tcti_replay->map_size, offset = 0, capacity = 0, i, j;
+    uint32_t type, block_len, interface, captured_len;
+    uint64_t ipv4_interfaces = 0;
+    unsigned int num_interfaces = 0;
+    bool swap = false, in_section = false;
+    TSS2_RC rc;
+
+    while (size - offset >= PCAP_BLOCK_MIN_LEN) {
+        block = &data[offset];
+        type = replay_get_uint32 (block, false);
+        if (type == PCAP_BLOCK_TYPE_SHB) {
+            if (size - offset < PCAP_SHB_MIN_LEN) {
+                break;
+            }
+            if (replay_get_uint32 (&block[8], false) ==
+                PCAP_SHB_BYTE_ORDER_MAGIC) {
+                swap = false;
+            } else if (replay_get_uint32 (&block[8], true) ==
+                       PCAP_SHB_BYTE_ORDER_MAGIC) {
+                swap = true;
+            } else {
+                LOG_ERROR ("Bad byte order magic at offset %zu", offset);
+                return TSS2_TCTI_RC_BAD_VALUE;
+            }
+            in_section = true;
+            ipv4_interfaces = 0;
+            num_interfaces = 0;
+        } else if (!in_section) {
+            LOG_ERROR ("Not a pcapng file");
+            return TSS2_TCTI_RC_BAD_VALUE;
+        } else {
+            type = replay_get_uint32 (block, swap);
+        }
+
+        block_len = replay_get_uint32 (&block[4], swap);
+        if (block_len < PCAP_BLOCK_MIN_LEN || block_len % 4 != 0) {
+            LOG_ERROR ("Bad block length %" PRIu32 " at offset %zu",
+                       block_len, offset);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        if (block_len > size - offset) {
+            LOG_WARNING ("Capture is truncated at offset %zu", offset);
+            break;
+        }
+        if (replay_get_uint32 (&block[block_len - 4], swap) != block_len) {
+            LOG_ERROR ("Block lengths differ at offset %zu", offset);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+
+        if (type == PCAP_BLOCK_TYPE_IDB && block_len >= PCAP_IDB_MIN_LEN) {
+            if (num_interfaces < PCAP_MAX_INTERFACES &&
+                replay_get_uint16 (&block[8], swap) == PCAP_IDB_LINKTYPE_IPv4) {
+                ipv4_interfaces |= UINT64_C (1) << num_interfaces;
+            }
+            num_interfaces += 1;
+        } else if (type == PCAP_BLOCK_TYPE_EPB &&
+                   block_len >= PCAP_EPB_HEADER_LEN + 4) {
+            interface = replay_get_uint32 (&block[8], swap);
+            captured_len = replay_get_uint32 (&block[20], swap);
+            if (captured_len > block_len - PCAP_EPB_HEADER_LEN - 4) {
+                LOG_ERROR ("Bad packet length at offset %zu", offset);
+                return TSS2_TCTI_RC_BAD_VALUE;
+            }
+            if (captured_len != replay_get_uint32 (&block[24], swap)) {
+                LOG_WARNING ("Skipping truncated packet at offset %zu", offset);
+            } else if (interface < PCAP_MAX_INTERFACES &&
+                       ipv4_interfaces & UINT64_C (1) << interface) {
+                rc = replay_add_packet (tcti_replay,
+                                        &block[PCAP_EPB_HEADER_LEN],
+                                        captured_len, &capacity);
+                if (rc != TSS2_RC_SUCCESS) {
+                    return rc;
+                }
+            }
+        }
+        offset += block_len;
+    }
+
+    /* drop the commands whose responses are not in the capture */
+    for (i = 0, j = 0; i < tcti_replay->num_exchanges; i++) {
+        if (tcti_replay->exchanges[i].rsp != NULL) {
+            tcti_replay->exchanges[j++] = tcti_replay->exchanges[i];
+        }
+    }
+    if (j != tcti_replay->num_exchanges) {
+        LOG_WARNING ("Skipping %zu commands without response",
+                     tcti_replay->num_exchanges - j);
+    }
+    tcti_replay->num_exchanges = j;
+
+    if (tcti_replay->num_exchanges == 0) {
+        LOG_ERROR ("No TPM commands found in the capture");
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    if (tcti_replay->mode == TCTI_REPLAY_LENIENT) {
+        return replay_index_command_codes (tcti_replay);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+replay_map (
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay,
+    const char *file)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open (file, O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR ("Failed to open file %s: %s", file, strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    if (fstat (fd, &st) != 0) {
+        LOG_ERROR ("Failed to stat file %s: %s", file, strerror (errno));
+        close (fd);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    if (st.st_size == 0) {
+        LOG_ERROR ("File %s is empty", file);
+        close (fd);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        LOG_ERROR ("Failed to map file %s: %s", file, strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    tcti_replay->map = map;
+    tcti_replay->map_size = st.st_size;
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+replay_unmap (TSS2_TCTI_REPLAY_CONTEXT *tcti_replay)
+{
+    if (tcti_replay->map != NULL) {
+        munmap (tcti_replay->map, tcti_replay->map_size);
+        tcti_replay->map = NULL;
+    }
+    free (tcti_replay->exchanges);
+    tcti_replay->exchanges = NULL;
+    free (tcti_replay->cc_table);
+    tcti_replay->cc_table = NULL;
+}
+
+/*
+ * Find the recorded exchange for a command. In strict mode this is the next
+ * exchange of the capture, which must match byte by byte. In lenient mode it
+ * is the first exchange with the same command code that was not replayed.
+ */
+static const tcti_replay_exchange_t *
+replay_lookup (
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay,
+    const uint8_t *cmd_buf,
+    size_t size,
+    TPM2_CC command_code)
+{
+    const tcti_replay_exchange_t *exchange;
+    tcti_replay_cc_t *slot;
+
+    if (tcti_replay->mode == TCTI_REPLAY_LENIENT) {
+        slot = replay_cc_slot (tcti_replay, command_code);
+        if (!slot->used || slot->first == TCTI_REPLAY_NONE) {
+            LOG_ERROR ("No recorded response left for command code 0x%"
+                       PRIx32, command_code);
+            return NULL;
+        }
+        exchange = &tcti_replay->exchanges[slot->first];
+        slot->first = exchange->next_same_cc;
+        return exchange;
+    }
+
+    if (tcti_replay->next == tcti_replay->num_exchanges) {
+        LOG_ERROR ("All %zu recorded commands were replayed",
+                   tcti_replay->num_exchanges);
+        return NULL;
+    }
+    exchange = &tcti_replay->exchanges[tcti_replay->next];
+    if (exchange->cmd_size != size ||
+        memcmp (exchange->cmd, cmd_buf, size) != 0) {
+        LOG_ERROR ("Command %zu (command code 0x%" PRIx32 ") differs from "
+                   "the capture (command code 0x%" PRIx32 ")",
+                   tcti_replay->next, command_code, exchange->command_code);
+        LOGBLOB_DEBUG (exchange->cmd, exchange->cmd_size, "Recorded command:");
+        return NULL;
+    }
+    tcti_replay->next += 1;
+    return exchange;
+}
+
+TSS2_RC
+tcti_replay_transmit (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tcti_ctx);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_replay_down_cast (tcti_replay);
+    TSS2_RC rc;
+
+    if (tcti_replay == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_transmit_checks (tcti_common, cmd_buf, TCTI_REPLAY_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (size < TPM_HEADER_LEN) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    rc = header_unmarshal (cmd_buf, &tcti_common->header);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    if (tcti_common->header.size != size) {
+        LOG_ERROR ("Buffer size parameter: %zu, and TPM2 command header size "
+                   "field: %" PRIu32 " disagree.", size, tcti_common->header.size);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+
+    LOGBLOB_DEBUG (cmd_buf, size, "sending %zu byte command buffer:", size);
+
+    tcti_replay->current = replay_lookup (tcti_replay, cmd_buf, size,
+                                          tcti_common->header.code);
+    if (tcti_replay->current == NULL) {
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_replay_receive (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *response_size,
+    unsigned char *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_replay_down_cast (tcti_replay);
+    const tcti_replay_exchange_t *exchange;
+    TSS2_RC rc;
+
+    (void) timeout;
+    if (tcti_replay == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_receive_checks (tcti_common, response_size,
+                                     TCTI_REPLAY_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    exchange = tcti_replay->current;
+    /* partial read */
+    if (response_buffer == NULL) {
+        *response_size = exchange->rsp_size;
+        return TSS2_RC_SUCCESS;
+    }
+    if (*response_size < exchange->rsp_size) {
+        *response_size = exchange->rsp_size;
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    }
+    memcpy (response_buffer, exchange->rsp, exchange->rsp_size);
+    *response_size = exchange->rsp_size;
+    LOGBLOB_DEBUG (response_buffer, *response_size, "Response Received");
+
+    tcti_replay->current = NULL;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_replay_cancel (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tctiContext);
+
+    if (tcti_replay == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    /* the recorded response is available at once */
+    return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+}
+
+TSS2_RC
+tcti_replay_set_locality (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    uint8_t locality)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_replay_down_cast (tcti_replay);
+    TSS2_RC rc;
+
+    if (tcti_replay == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    rc = tcti_common_set_locality_checks (tcti_common, TCTI_REPLAY_MAGIC);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+
+    /* the locality is not part of the capture */
+    tcti_common->locality = locality;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+tcti_replay_get_poll_handles (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    TSS2_TCTI_POLL_HANDLE *handles,
+    size_t *num_handles)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tctiContext);
+
+    (void) handles;
+    (void) num_handles;
+    if (tcti_replay == NULL) {
+        return TSS2_TCTI_RC_BAD_CONTEXT;
+    }
+    return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+}
+
+void
+tcti_replay_finalize (
+    TSS2_TCTI_CONTEXT *tctiContext)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = tcti_replay_context_cast (tctiContext);
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_replay_down_cast (tcti_replay);
+
+    if (tcti_replay == NULL) {
+        return;
+    }
+
+    if (tcti_replay->mode == TCTI_REPLAY_STRICT) {
+        LOG_DEBUG ("Replayed %zu of %zu recorded commands", tcti_replay->next,
+                   tcti_replay->num_exchanges);
+    }
+    replay_unmap (tcti_replay);
+
+    tcti_common->state = TCTI_STATE_FINAL;
+}
+
+static TSS2_RC
+replay_kv_callback (const key_value_t *key_value,
+                    void *user_data)
+{
+    tcti_replay_conf_t *replay_conf = (tcti_replay_conf_t*)user_data;
+
+    if (key_value == NULL || user_data == NULL) {
+        LOG_WARNING ("%s passed NULL parameter", __func__);
+        return TSS2_TCTI_RC_GENERAL_FAILURE;
+    }
+    LOG_DEBUG ("key: %s / value: %s\n", key_value->key, key_value->value);
+    if (strcmp (key_value->key, "file") == 0) {
+        replay_conf->file = key_value->value;
+        return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "mode") == 0) {
+        if (strcmp (key_value->value, "strict") == 0) {
+            replay_conf->mode = TCTI_REPLAY_STRICT;
+        } else if (strcmp (key_value->value, "lenient") == 0) {
+            replay_conf->mode = TCTI_REPLAY_LENIENT;
+        } else {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        return TSS2_RC_SUCCESS;
+    } else {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+}
+
+/*
+ * This is an implementation of the standard TCTI initialization function for
+ * this module.
+ */
+TSS2_RC
+Tss2_Tcti_Replay_Init (
+    TSS2_TCTI_CONTEXT *tctiContext,
+    size_t *size,
+    const char *conf)
+{
+    TSS2_TCTI_REPLAY_CONTEXT *tcti_replay = (TSS2_TCTI_REPLAY_CONTEXT*) tctiContext;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_replay_down_cast (tcti_replay);
+    tcti_replay_conf_t replay_conf = {
+        .file = getenv (ENV_PCAP_FILE),
+        .mode = TCTI_REPLAY_STRICT,
+    };
+    char *conf_copy = NULL;
+    TSS2_RC rc;
+
+    if (tctiContext == NULL && size == NULL) {
+        return TSS2_TCTI_RC_BAD_VALUE;
+    } else if (tctiContext == NULL) {
+        *size = sizeof (TSS2_TCTI_REPLAY_CONTEXT);
+        return TSS2_RC_SUCCESS;
+    }
+
+    if (conf != NULL) {
+        LOG_TRACE ("conf is not NULL");
+        if (strlen (conf) > TCTI_REPLAY_CONF_MAX) {
+            LOG_WARNING ("Provided conf string exceeds maximum of %u",
+                         TCTI_REPLAY_CONF_MAX);
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        conf_copy = strdup (conf);
+        if (conf_copy == NULL) {
+            LOG_ERROR ("Out of memory");
+            return TSS2_TCTI_RC_MEMORY;
+        }
+        rc = parse_key_value_string (conf_copy,
+                                     replay_kv_callback,
+                                     &replay_conf);
+        if (rc != TSS2_RC_SUCCESS) {
+            goto out;
+        }
+    }
+    if (replay_conf.file == NULL) {
+        replay_conf.file = DEFAULT_PCAP_FILE;
+    }
+    LOG_DEBUG ("Initializing replay TCTI with file: %s, mode: %s",
+               replay_conf.file,
+               replay_conf.mode == TCTI_REPLAY_STRICT ? "strict" : "lenient");
+
+    memset (tcti_replay, 0, sizeof (*tcti_replay));
+    tcti_replay->mode = replay_conf.mode;
+
+    rc = replay_map (tcti_replay, replay_conf.file);
+    if (rc != TSS2_RC_SUCCESS) {
+        goto out;
+    }
+    rc = replay_load (tcti_replay);
+    if (rc != TSS2_RC_SUCCESS) {
+        replay_unmap (tcti_replay);
+        goto out;
+    }
+    LOG_DEBUG ("Loaded %zu recorded commands", tcti_replay->num_exchanges);
+
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_REPLAY_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_replay_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_replay_receive;
+    TSS2_TCTI_FINALIZE (tcti_common) = tcti_replay_finalize;
+    TSS2_TCTI_CANCEL (tcti_common) = tcti_replay_cancel;
+    TSS2_TCTI_GET_POLL_HANDLES (tcti_common) = tcti_replay_get_poll_handles;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_replay_set_locality;
+    TSS2_TCTI_MAKE_STICKY (tcti_common) = tcti_make_sticky_not_implemented;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+    tcti_common->locality = 3;
+
+out:
+    free (conf_copy);
+    return rc;
+}
+
+/* public info structure */
+const TSS2_TCTI_INFO tss2_tcti_info = {
+    .version = TCTI_VERSION,
+    .name = "tcti-replay",
+    .description = "TCTI module for replaying TPM responses from a pcapng "
+                   "capture of tcti-pcap.",
+    .config_help = "Key value pairs: file=<capture>,mode=<strict|lenient>",
+    .init = Tss2_Tcti_Replay_Init,
+};
+
+const TSS2_TCTI_INFO*
+Tss2_Tcti_Info (void)
+{
+    return &tss2_tcti_info;
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef TCTI_REPLAY_H
+#define TCTI_REPLAY_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tpm2_types.h"
+#include "tcti-common.h"
+
+#define TCTI_REPLAY_MAGIC 0x7265706c61795f74ULL
+
+#define TCTI_REPLAY_CONF_MAX (PATH_MAX + 32)
+#define TCTI_REPLAY_NONE SIZE_MAX
+
+/*
+ * strict:  the commands must be transmitted in the order of the capture and
+ *          must be identical to the recorded ones
+ * lenient: a command is answered with the response to the first recorded
+ *          command with the same command code that was not replayed yet
+ */
+typedef enum {
+    TCTI_REPLAY_STRICT,
+    TCTI_REPLAY_LENIENT,
+} tcti_replay_mode_t;
+
+typedef struct {
+    const char *file;
+    tcti_replay_mode_t mode;
+} tcti_replay_conf_t;
+
+/*
+ * One command of the capture and the response to it. The buffers point into
+ * the mapped capture file.
+ */
+typedef struct {
+    const uint8_t *cmd;
+    const uint8_t *rsp;
+    uint32_t cmd_size;
+    uint32_t rsp_size;
+    TPM2_CC command_code;
+    size_t next_same_cc;        /* next exchange with this command code */
+    uint32_t host;              /* IPv4 address of the client, for pairing */
+} tcti_replay_exchange_t;
+
+/* Entry of the open addressing table of the lenient mode */
+typedef struct {
+    bool used;
+    TPM2_CC command_code;
+    size_t first;               /* first exchange not replayed yet */
+} tcti_replay_cc_t;
+
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    tcti_replay_mode_t mode;
+    uint8_t *map;
+    size_t map_size;
+    tcti_replay_exchange_t *exchanges;
+    size_t num_exchanges;
+    size_t next;                /* strict mode: the next expected exchange */
+    tcti_replay_cc_t *cc_table;
+    size_t cc_table_size;       /* power of two */
+    const tcti_replay_exchange_t *current;
+} TSS2_TCTI_REPLAY_CONTEXT;
+
+#endif /* TCTI_REPLAY_H */
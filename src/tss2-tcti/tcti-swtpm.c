@@ -81,6 +81,36 @@ tcti_swtpm_down_cast (TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm)
     return &tcti_swtpm->common;
 }
 
+/*
+ * This function provides a connected socket in 'sock'. If 'path' is set the
+ * Unix domain socket bound to it is used, otherwise a TCP connection to the
+ * given port.
+ * In keepalive mode a socket that is still open from a previous command is
+ * reused, unless the peer has closed it in the meantime. In that case (and
+ * whenever keepalive is off) a new connection is established.
+ */
+static TSS2_RC
+tcti_swtpm_connect (
+    TSS2_TCTI_SWTPM_CONTEXT *tcti_swtpm,
+    const char *path,
+    uint16_t port,
+    SOCKET *sock)
+{
+    if (tcti_swtpm->swtpm_conf.keepalive && *sock != INVALID_SOCKET) {
+        if (socket_check_idle (*sock) == TSS2_RC_SUCCESS) {
+            return TSS2_RC_SUCCESS;
+        }
+        LOG_DEBUG ("Connection to port %" PRIu16 " closed by peer, "
+                   "reconnecting.", port);
+        socket_close (sock);
+    }
+
+    if (path != NULL) {
+        return socket_connect_unix (path, sock);
+    }
+    return socket_connect (tcti_swtpm->swtpm_conf.host, port, sock);
+}
+
 /*
  * This function is for sending one of the SWTPM_* control commands to the swtpm
  * simulator. These are sent over the out-of-band control socket.
@@ -116,6 +146,7 @@ TSS2_RC tcti_control_command (
     TSS2_RC rc = TSS2_RC_SUCCESS;
     int ret;
     uint32_t response_code;
+    bool keep_sock;
 
     if (tcti_swtpm == NULL) {
         return TSS2_TCTI_RC_BAD_REFERENCE;
@@ -136,9 +167,11 @@ TSS2_RC tcti_control_command (
     uint8_t resp_buf[SWTPM_CTRL_RESP_MAX_LEN] = { 0 };
     size_t resp_buf_len = sizeof(uint32_t);
 
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port + 1,
-                         &tcti_swtpm->ctrl_sock);
+    keep_sock = tcti_swtpm->swtpm_conf.keepalive;
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.ctrl_path,
+                             tcti_swtpm->swtpm_conf.port + 1,
+                             &tcti_swtpm->ctrl_sock);
     if (rc != TSS2_RC_SUCCESS) {
         LOG_ERROR ("Failed to connect to control socket.");
         rc = TSS2_TCTI_RC_IO_ERROR;
@@ -168,6 +201,7 @@ TSS2_RC tcti_control_command (
         LOG_ERROR("Failed to send control command %d with error: %d",
                   cmd_code, ret);
         rc = TSS2_TCTI_RC_IO_ERROR;
+        keep_sock = false;
         goto out;
     }
 
@@ -179,6 +213,7 @@ TSS2_RC tcti_control_command (
         LOG_ERROR("Failed to get response to control command, errno %d: %s",
                   WSAGetLastError(), strerror (WSAGetLastError()));
         rc = TSS2_TCTI_RC_IO_ERROR;
+        keep_sock = false;
         goto out;
     }
 #else
@@ -187,6 +222,7 @@ TSS2_RC tcti_control_command (
         LOG_ERROR ("Failed to get response to control command, errno %d: %s",
                    errno, strerror (errno));
         rc = TSS2_TCTI_RC_IO_ERROR;
+        keep_sock = false;
         goto out;
     }
 #endif
@@ -228,7 +264,9 @@ TSS2_RC tcti_control_command (
     rc = TSS2_RC_SUCCESS;
 
 out:
-    socket_close(&tcti_swtpm->ctrl_sock);
+    if (!keep_sock) {
+        socket_close(&tcti_swtpm->ctrl_sock);
+    }
     return rc;
 }
 
@@ -275,15 +313,17 @@ tcti_swtpm_transmit (
     LOG_DEBUG ("Sending command with TPM_CC 0x%" PRIx32 " and size %" PRIu32,
                header.code, header.size);
 
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port,
-                         &tcti_swtpm->tpm_sock);
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.path,
+                             tcti_swtpm->swtpm_conf.port,
+                             &tcti_swtpm->tpm_sock);
     if (rc != TSS2_RC_SUCCESS) {
         return rc;
     }
 
     rc = socket_xmit_buf (tcti_swtpm->tpm_sock, cmd_buf, size);
     if (rc != TSS2_RC_SUCCESS) {
+        socket_close (&tcti_swtpm->tpm_sock);
         return rc;
     }
 
@@ -359,6 +399,7 @@ tcti_swtpm_finalize(
     }
 
     socket_close (&tcti_swtpm->tpm_sock);
+    socket_close (&tcti_swtpm->ctrl_sock);
     free (tcti_swtpm->conf_copy);
 }
 
@@ -450,9 +491,14 @@ tcti_swtpm_receive (
      * Executing code beyond this point transitions the state machine to
      * TRANSMIT. Another call to this function will not be possible until
      * another command is sent to the TPM.
+     * In keepalive mode the data socket stays open for the next command
+     * unless the exchange failed, in which case the next transmit
+     * reconnects.
      */
 out:
-    socket_close (&tcti_swtpm->tpm_sock);
+    if (!tcti_swtpm->swtpm_conf.keepalive || rc != TSS2_RC_SUCCESS) {
+        socket_close (&tcti_swtpm->tpm_sock);
+    }
 
     tcti_common->header.size = 0;
     tcti_common->state = TCTI_STATE_TRANSMIT;
@@ -504,6 +550,27 @@ swtpm_kv_callback (const key_value_t *key_value,
             return TSS2_TCTI_RC_BAD_VALUE;
         }
         return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "keepalive") == 0) {
+        if (strcmp (key_value->value, "1") == 0) {
+            swtpm_conf->keepalive = true;
+        } else if (strcmp (key_value->value, "0") == 0) {
+            swtpm_conf->keepalive = false;
+        } else {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "path") == 0) {
+        if (strlen (key_value->value) >= TCTI_SWTPM_SOCKET_PATH_MAX) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        swtpm_conf->path = key_value->value;
+        return TSS2_RC_SUCCESS;
+    } else if (strcmp (key_value->key, "ctrl_path") == 0) {
+        if (strlen (key_value->value) >= TCTI_SWTPM_SOCKET_PATH_MAX) {
+            return TSS2_TCTI_RC_BAD_VALUE;
+        }
+        swtpm_conf->ctrl_path = key_value->value;
+        return TSS2_RC_SUCCESS;
     } else {
         return TSS2_TCTI_RC_BAD_VALUE;
     }
@@ -555,6 +622,9 @@ Tss2_Tcti_Swtpm_Init (
 
     tcti_swtpm->swtpm_conf.host = TCTI_SWTPM_DEFAULT_HOST;
     tcti_swtpm->swtpm_conf.port = TCTI_SWTPM_DEFAULT_PORT;
+    tcti_swtpm->swtpm_conf.keepalive = false;
+    tcti_swtpm->swtpm_conf.path = NULL;
+    tcti_swtpm->swtpm_conf.ctrl_path = NULL;
 
     if (conf != NULL) {
         LOG_TRACE ("conf is not NULL");
@@ -577,17 +647,28 @@ Tss2_Tcti_Swtpm_Init (
             goto fail_out;
         }
     }
-    LOG_DEBUG ("Initializing swtpm TCTI with host: %s, port: %" PRIu16,
-               tcti_swtpm->swtpm_conf.host, tcti_swtpm->swtpm_conf.port);
+    LOG_DEBUG ("Initializing swtpm TCTI with host: %s, port: %" PRIu16
+               ", keepalive: %d, path: %s, ctrl_path: %s",
+               tcti_swtpm->swtpm_conf.host, tcti_swtpm->swtpm_conf.port,
+               tcti_swtpm->swtpm_conf.keepalive,
+               tcti_swtpm->swtpm_conf.path ? tcti_swtpm->swtpm_conf.path : "-",
+               tcti_swtpm->swtpm_conf.ctrl_path ?
+                   tcti_swtpm->swtpm_conf.ctrl_path : "-");
 
     tcti_swtpm->tpm_sock = -1;
     tcti_swtpm->ctrl_sock = -1;
 
-    /* sanity check */
-    rc = socket_connect (tcti_swtpm->swtpm_conf.host,
-                         tcti_swtpm->swtpm_conf.port,
-                         &tcti_swtpm->tpm_sock);
-    socket_close (&tcti_swtpm->tpm_sock);
+    /*
+     * sanity check, in keepalive mode the connection is kept for the first
+     * command
+     */
+    rc = tcti_swtpm_connect (tcti_swtpm,
+                             tcti_swtpm->swtpm_conf.path,
+                             tcti_swtpm->swtpm_conf.port,
+                             &tcti_swtpm->tpm_sock);
+    if (rc != TSS2_RC_SUCCESS || !tcti_swtpm->swtpm_conf.keepalive) {
+        socket_close (&tcti_swtpm->tpm_sock);
+    }
     if (rc != TSS2_RC_SUCCESS) {
         LOG_ERROR ("Cannot connect to swtpm TPM socket");
         goto fail_out;
@@ -599,6 +680,8 @@ Tss2_Tcti_Swtpm_Init (
     if (rc != TSS2_RC_SUCCESS) {
         LOG_WARNING ("Could not set locality via control channel: 0x%" PRIx32,
                      rc);
+        socket_close (&tcti_swtpm->tpm_sock);
+        socket_close (&tcti_swtpm->ctrl_sock);
         return rc;
     }
 
@@ -616,7 +699,10 @@ const TSS2_TCTI_INFO tss2_tcti_info = {
     .version = TCTI_VERSION,
     .name = "tcti-swtpm",
     .description = "TCTI module for communication with the swtpm.",
-    .config_help = "Key / value string in the form \"host=localhost,port=2321\".",
+    .config_help = "Key / value string in the form \"host=localhost,port=2321\"."
+                   " Add \",keepalive=1\" to keep the connections to the swtpm"
+                   " open between commands. Use \"path=<file>,ctrl_path=<file>\""
+                   " to connect to the Unix domain sockets of the swtpm.",
     .init = Tss2_Tcti_Swtpm_Init,
 };
 
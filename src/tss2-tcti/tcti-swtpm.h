@@ -8,6 +8,7 @@
 #define TCTI_SWTPM_H
 
 #include <limits.h>
+#include <stdbool.h>
 
 #include "tcti-common.h"
 #include "util/io.h"
@@ -15,13 +16,19 @@
 /*
  * longest possible conf string:
  * HOST_NAME_MAX + max char uint16 (5) + strlen ("host=,port=") (11)
+ * + strlen (",keepalive=1") (12)
+ * + 2 * Unix socket path (108) + strlen (",path=,ctrl_path=") (17)
  */
-#define TCTI_SWTPM_CONF_MAX (_HOST_NAME_MAX + 16)
+#define TCTI_SWTPM_SOCKET_PATH_MAX 108
+#define TCTI_SWTPM_CONF_MAX (_HOST_NAME_MAX + 45 + 2 * TCTI_SWTPM_SOCKET_PATH_MAX)
 #define TCTI_SWTPM_DEFAULT_HOST "localhost"
 #define TCTI_SWTPM_DEFAULT_PORT 2321
 #define SWTPM_CONF_DEFAULT_INIT { \
     .host = TCTI_SWTPM_DEFAULT_HOST, \
     .port = TCTI_SWTPM_DEFAULT_PORT, \
+    .keepalive = false, \
+    .path = NULL, \
+    .ctrl_path = NULL, \
 }
 
 #define TCTI_SWTPM_MAGIC 0x496E66696E656F6EULL
@@ -36,6 +43,11 @@
 typedef struct {
     char *host;
     uint16_t port;
+    /* keep data and control sockets connected between commands */
+    bool keepalive;
+    /* Unix domain sockets used instead of TCP if set */
+    char *path;
+    char *ctrl_path;
 } swtpm_conf_t;
 
 typedef struct {
@@ -18,6 +18,7 @@
 #include <poll.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #endif
 
@@ -114,6 +115,132 @@ write_all (
     return (ssize_t)written_total;
 }
 
+/*
+ * Advance the scatter / gather list 'iov' by 'size' bytes. Elements that
+ * have been transferred completely (and empty ones) are dropped from the
+ * list, a partially transferred element is adjusted in place.
+ */
+static void
+iov_advance (
+    struct iovec **iov,
+    int *iovcnt,
+    size_t size)
+{
+    while (*iovcnt > 0 && size >= (*iov)->iov_len) {
+        size -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovcnt)--;
+    }
+    if (*iovcnt > 0) {
+        (*iov)->iov_base = (uint8_t *)(*iov)->iov_base + size;
+        (*iov)->iov_len -= size;
+    }
+}
+
+static size_t
+iov_size (
+    const struct iovec *iov,
+    int iovcnt)
+{
+    size_t size = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        size += iov[i].iov_len;
+    }
+    return size;
+}
+
+/*
+ * The 'readv_all' function fills all buffers of the scatter list 'iov' from
+ * 'fd'. Like 'read_all' it retries after interrupted system calls and short
+ * reads. On error or EOF, the number of bytes read (if any) will be returned.
+ * If the descriptor is non-blocking and the remainder of the data has not
+ * arrived yet, the number of bytes read is returned as well and errno is left
+ * at EAGAIN / EWOULDBLOCK, so the caller can wait with its own timeout.
+ */
+ssize_t
+readv_all (
+    SOCKET fd,
+    struct iovec *iov,
+    int iovcnt)
+{
+    ssize_t recvd;
+    size_t recvd_total = 0;
+
+    LOG_DEBUG ("reading %zu bytes from fd %d to %d buffers",
+               iov_size (iov, iovcnt), fd, iovcnt);
+    iov_advance (&iov, &iovcnt, 0);
+    while (iovcnt > 0) {
+#ifdef _WIN32
+        recvd = read_all (fd, iov->iov_base, iov->iov_len);
+        if (recvd < (ssize_t)iov->iov_len) {
+            return recvd_total + recvd;
+        }
+#else
+        TEMP_RETRY (recvd, readv (fd, iov, iovcnt));
+        if (recvd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return recvd_total;
+        }
+        if (recvd < 0) {
+            LOG_WARNING ("readv on fd %d failed with errno %d: %s",
+                         fd, errno, strerror (errno));
+            return recvd_total;
+        }
+        if (recvd == 0) {
+            LOG_WARNING ("Attempted readv of %zu bytes from fd %d, but EOF "
+                         "returned", iov_size (iov, iovcnt), fd);
+            return recvd_total;
+        }
+#endif
+        LOG_DEBUG ("read %zd bytes from fd %d", recvd, fd);
+        recvd_total += recvd;
+        iov_advance (&iov, &iovcnt, recvd);
+    }
+
+    return recvd_total;
+}
+
+/*
+ * The 'writev_all' function writes all buffers of the gather list 'iov' to
+ * 'fd', retrying after interrupted system calls and short writes. Sending
+ * a message that is split over several buffers with a single call avoids
+ * both the extra system calls and the small segments that would otherwise
+ * be put on the wire.
+ */
+ssize_t
+writev_all (
+    SOCKET fd,
+    struct iovec *iov,
+    int iovcnt)
+{
+    ssize_t written;
+    size_t written_total = 0;
+
+    iov_advance (&iov, &iovcnt, 0);
+    while (iovcnt > 0) {
+        LOG_DEBUG ("writing %zu bytes from %d buffers to fd %d",
+                   iov_size (iov, iovcnt), iovcnt, fd);
+#ifdef _WIN32
+        written = write_all (fd, iov->iov_base, iov->iov_len);
+        if (written < (ssize_t)iov->iov_len) {
+            return written_total + written;
+        }
+#else
+        TEMP_RETRY (written, writev (fd, iov, iovcnt));
+        if (written < 0) {
+            LOG_ERROR ("failed to write to fd %d: %s", fd, strerror (errno));
+            return written_total;
+        }
+#endif
+        LOG_DEBUG ("wrote %zd bytes to fd %d", written, fd);
+        written_total += (size_t)written;
+        iov_advance (&iov, &iovcnt, written);
+    }
+
+    return (ssize_t)written_total;
+}
+
 ssize_t
 socket_recv_buf (
     SOCKET sock,
@@ -144,6 +271,38 @@ socket_xmit_buf (
     return TSS2_RC_SUCCESS;
 }
 
+ssize_t
+socket_recv_bufs (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt)
+{
+    return readv_all (sock, iov, iovcnt);
+}
+
+TSS2_RC
+socket_xmit_bufs (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt)
+{
+    size_t size = iov_size (iov, iovcnt);
+    ssize_t ret;
+
+    LOG_DEBUG ("Writing %zu bytes from %d buffers to socket %d:",
+               size, iovcnt, sock);
+    ret = writev_all (sock, iov, iovcnt);
+    if (ret < (ssize_t) size) {
+#ifdef _WIN32
+        LOG_ERROR ("write to fd %d failed, errno %d: %s", sock, WSAGetLastError(), strerror (WSAGetLastError()));
+#else
+        LOG_ERROR ("write to fd %d failed, errno %d: %s", sock, errno, strerror (errno));
+#endif
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
 TSS2_RC
 socket_close (
     SOCKET *socket)
@@ -177,6 +336,23 @@ socket_close (
     return TSS2_RC_SUCCESS;
 }
 
+/*
+ * TPM commands and responses are small request / response exchanges. Disable
+ * Nagle's algorithm so that a command is put on the wire immediately instead
+ * of waiting for the acknowledgement of a previous segment.
+ */
+static void
+socket_set_nodelay (
+    SOCKET sock)
+{
+    int one = 1;
+
+    if (setsockopt (sock, IPPROTO_TCP, TCP_NODELAY,
+                    (const char *)&one, sizeof (one)) == SOCKET_ERROR) {
+        LOG_WARNING ("Failed to set TCP_NODELAY on socket %d.", sock);
+    }
+}
+
 TSS2_RC
 socket_connect (
     const char *hostname,
@@ -239,8 +415,10 @@ socket_connect (
             h = hostname;
 
         LOG_DEBUG ("Attempting TCP connection to host %s, port %s", h, port_str);
-        if (connect (*sock, p->ai_addr, p->ai_addrlen) != SOCKET_ERROR)
+        if (connect (*sock, p->ai_addr, p->ai_addrlen) != SOCKET_ERROR) {
+            socket_set_nodelay (*sock);
             break; /* socket connected OK */
+        }
         socket_close (sock);
     }
     freeaddrinfo (retp);
@@ -259,6 +437,48 @@ socket_connect (
     return TSS2_RC_SUCCESS;
 }
 
+TSS2_RC
+socket_connect_unix (
+    const char *path,
+    SOCKET *sock)
+{
+#ifdef _WIN32
+    (void)path;
+    (void)sock;
+    LOG_ERROR ("Unix domain sockets are not supported on this platform.");
+    return TSS2_TCTI_RC_NOT_IMPLEMENTED;
+#else
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (path == NULL || sock == NULL) {
+        return TSS2_TCTI_RC_BAD_REFERENCE;
+    }
+    if (strlen (path) >= sizeof (addr.sun_path)) {
+        LOG_WARNING ("Unix socket path %s exceeds maximum length of %zu",
+                     path, sizeof (addr.sun_path) - 1);
+        return TSS2_TCTI_RC_BAD_VALUE;
+    }
+    strcpy (addr.sun_path, path);
+
+    *sock = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (*sock == INVALID_SOCKET) {
+        LOG_WARNING ("Failed to create Unix socket: errno %d: %s",
+                     errno, strerror (errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    LOG_DEBUG ("Attempting connection to Unix socket %s", path);
+    if (connect (*sock, (struct sockaddr *)&addr, sizeof (addr)) == SOCKET_ERROR) {
+        LOG_WARNING ("Failed to connect to Unix socket %s: errno %d: %s",
+                     path, errno, strerror (errno));
+        socket_close (sock);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    return TSS2_RC_SUCCESS;
+#endif
+}
+
 TSS2_RC
 socket_set_nonblock (SOCKET sock)
 {
@@ -307,3 +527,38 @@ socket_poll (SOCKET sock, int timeout)
 #endif
     return TSS2_RC_SUCCESS;
 }
+
+/*
+ * The 'socket_check_idle' function is used for sockets that are kept open
+ * across commands. Since no response is outstanding on an idle socket, any
+ * readable or hangup condition means that the peer has closed the connection
+ * (or sent data we cannot make sense of). In both cases the caller must
+ * reconnect before the socket can be used again.
+ */
+TSS2_RC
+socket_check_idle (SOCKET sock)
+{
+    if (sock == INVALID_SOCKET) {
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+#ifndef _WIN32
+    struct pollfd fds;
+    int rc_poll;
+
+    fds.fd = sock;
+    fds.events = POLLIN;
+    fds.revents = 0;
+
+    rc_poll = poll(&fds, 1, 0);
+    if (rc_poll < 0) {
+        LOG_WARNING ("Failed to poll idle fd %d, got errno %d: %s",
+                     sock, errno, strerror(errno));
+        return TSS2_TCTI_RC_IO_ERROR;
+    } else if (rc_poll > 0 &&
+               (fds.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))) {
+        LOG_DEBUG ("Idle fd %d is readable or closed by peer.", sock);
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+#endif
+    return TSS2_RC_SUCCESS;
+}
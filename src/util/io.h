@@ -12,11 +12,16 @@
 #include <ws2tcpip.h>
 typedef SSIZE_T ssize_t;
 #define _HOST_NAME_MAX MAX_COMPUTERNAME_LENGTH
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
 
 #else
 #include <arpa/inet.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #define _HOST_NAME_MAX _POSIX_HOST_NAME_MAX
 #define SOCKET int
@@ -68,11 +73,34 @@ write_all (
     SOCKET fd,
     const uint8_t *buf,
     size_t size);
+/*
+ * Scatter / gather variants of 'read_all' and 'write_all'. All buffers
+ * described by the 'iovcnt' elements of 'iov' are transferred, using as few
+ * system calls as possible. The 'iov' array is modified to track partial
+ * transfers. The number of bytes transferred is returned.
+ */
+ssize_t
+readv_all (
+    SOCKET fd,
+    struct iovec *iov,
+    int iovcnt);
+ssize_t
+writev_all (
+    SOCKET fd,
+    struct iovec *iov,
+    int iovcnt);
 TSS2_RC
 socket_connect (
     const char *hostname,
     uint16_t port,
     SOCKET *socket);
+/*
+ * Connect 'socket' to the Unix domain socket bound to 'path'.
+ */
+TSS2_RC
+socket_connect_unix (
+    const char *path,
+    SOCKET *socket);
 TSS2_RC
 socket_close (
     SOCKET *socket);
@@ -89,10 +117,27 @@ socket_xmit_buf (
     SOCKET sock,
     const void *buf,
     size_t size);
+ssize_t
+socket_recv_bufs (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt);
+TSS2_RC
+socket_xmit_bufs (
+    SOCKET sock,
+    struct iovec *iov,
+    int iovcnt);
 TSS2_RC
 socket_poll (
     SOCKET sock,
     int timeout);
+/*
+ * Check whether an idle socket that is kept open between commands is still
+ * connected. Returns TSS2_TCTI_RC_IO_ERROR if the peer closed the connection.
+ */
+TSS2_RC
+socket_check_idle (
+    SOCKET sock);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,514 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "log-ring.h"
+
+#ifdef LOG_RING_SUPPORTED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_UNKNOWN 0
+#define RING_ON 1
+#define RING_OFF 2
+
+#define RING_MIN_SIZE 16
+#define RING_MAX_SIZE (1 << 20)
+
+/*
+ * The ring of one thread. Only the owning thread writes records, so head is
+ * advanced without read-modify-write operations. Readers detect records that
+ * are overwritten while they are copied by the seq field of the record,
+ * which is zero during an update. Rings are never freed; the ring of an
+ * exited thread is handed to the next thread that starts logging.
+ */
+typedef struct log_ring log_ring;
+struct log_ring {
+    log_ring *next;
+    uint64_t head;              /**< Number of records written by the owner */
+    uint64_t thread;
+    size_t capacity;            /**< Power of two */
+    int in_use;                 /**< The ring is owned by a thread */
+    log_ring_record records[];
+};
+
+static const int ring_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#define RING_SIGNALS (sizeof(ring_signals) / sizeof(ring_signals[0]))
+
+static int ring_state = RING_UNKNOWN;
+static char *ring_path;
+static size_t ring_capacity;
+static uint64_t ring_threads;
+static size_t ring_count;
+static uint64_t ring_lost;
+static log_ring *ring_list;
+static __thread log_ring *ring_self;
+static struct sigaction ring_old_actions[RING_SIGNALS];
+static int ring_signals_installed;
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static int ring_key_valid;
+#endif
+
+static void ring_install_signals(void);
+
+/** Reads the configuration from the environment.
+ *
+ * Several threads may run this at the same time; they all compute the same
+ * values and only one copy of the file name is kept.
+ *
+ * @retval true if the ring backend is enabled.
+ */
+static bool
+ring_init(void)
+{
+    const char *path = getenv("TSS2_LOG_RING");
+    const char *size = getenv("TSS2_LOG_RING_SIZE");
+    const char *signals;
+    size_t capacity = LOG_RING_DEFAULT_SIZE;
+    char *copy, *expected = NULL;
+
+    if (path == NULL || path[0] == '\0') {
+        __atomic_store_n(&ring_state, RING_OFF, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    if (size != NULL) {
+        unsigned long requested = strtoul(size, NULL, 0);
+        if (requested > RING_MAX_SIZE)
+            requested = RING_MAX_SIZE;
+        capacity = RING_MIN_SIZE;
+        while (capacity < requested)
+            capacity <<= 1;
+    }
+
+    copy = strdup(path);
+    if (copy == NULL) {
+        __atomic_store_n(&ring_state, RING_OFF, __ATOMIC_RELEASE);
+        return false;
+    }
+    if (!__atomic_compare_exchange_n(&ring_path, &expected, copy, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        free(copy);
+
+    __atomic_store_n(&ring_capacity, capacity, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring_state, RING_ON, __ATOMIC_RELEASE);
+
+    signals = getenv("TSS2_LOG_RING_SIGNALS");
+    if (signals != NULL && strcmp(signals, "1") == 0)
+        ring_install_signals();
+    return true;
+}
+
+/** Check whether log messages go to the ring buffers.
+ *
+ * @retval true if TSS2_LOG_RING is set.
+ */
+bool
+log_ring_enabled(void)
+{
+    int state = __atomic_load_n(&ring_state, __ATOMIC_ACQUIRE);
+
+    if (state != RING_UNKNOWN)
+        return state == RING_ON;
+    return ring_init();
+}
+
+static int ring_dump_one(int fd, log_ring *ring);
+
+#ifdef HAVE_PTHREAD
+/** Release the ring of an exiting thread.
+ *
+ * The records of the thread are appended to the file, then the ring is
+ * emptied and can be taken by the next thread that starts logging.
+ *
+ * @param[in] arg The ring of the thread.
+ */
+static void
+ring_release(void *arg)
+{
+    log_ring *ring = arg;
+    int fd;
+
+    fd = open(ring_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd >= 0) {
+        ring_dump_one(fd, ring);
+        close(fd);
+    }
+    ring_self = NULL;
+    __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void
+ring_key_init(void)
+{
+    ring_key_valid = pthread_key_create(&ring_key, ring_release) == 0;
+}
+#endif /* HAVE_PTHREAD */
+
+/** Get a ring for the calling thread and publish it for the dump.
+ *
+ * The ring of an exited thread is reused. A new ring is only allocated if
+ * there is none and fewer than LOG_RING_MAX_RINGS rings exist.
+ *
+ * @retval The ring or NULL if no ring is available.
+ */
+static log_ring *
+ring_acquire(void)
+{
+    size_t capacity = __atomic_load_n(&ring_capacity, __ATOMIC_RELAXED);
+    log_ring *ring;
+    int unused;
+
+    for (ring = __atomic_load_n(&ring_list, __ATOMIC_ACQUIRE); ring != NULL;
+         ring = ring->next) {
+        unused = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &unused, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (ring == NULL) {
+        if (__atomic_add_fetch(&ring_count, 1, __ATOMIC_RELAXED) > LOG_RING_MAX_RINGS) {
+            __atomic_sub_fetch(&ring_count, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        ring = calloc(1, sizeof(*ring) + capacity * sizeof(log_ring_record));
+        if (ring == NULL) {
+            __atomic_sub_fetch(&ring_count, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        ring->capacity = capacity;
+        ring->in_use = 1;
+        ring->next = __atomic_load_n(&ring_list, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&ring_list, &ring->next, ring, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    ring->thread = __atomic_add_fetch(&ring_threads, 1, __ATOMIC_RELAXED);
+
+#ifdef HAVE_PTHREAD
+    pthread_once(&ring_key_once, ring_key_init);
+    if (ring_key_valid)
+        pthread_setspecific(ring_key, ring);
+#endif
+    ring_self = ring;
+    return ring;
+}
+
+/** Copy a string into a fixed size field, truncate it and pad it with zeros. */
+static void
+copy_field(char *dest, size_t dest_size, const char *src)
+{
+    size_t len;
+
+    if (src == NULL)
+        src = "";
+    len = strnlen(src, dest_size - 1);
+    memcpy(dest, src, len);
+    memset(&dest[len], 0, dest_size - len);
+}
+
+/** Store one log message in the ring of the calling thread.
+ *
+ * The message is formatted into the record and truncated to
+ * LOG_RING_MSG_LEN - 1 characters. Of a blob only the first
+ * LOG_RING_BLOB_LEN bytes are kept together with its size.
+ */
+void
+log_ring_write(int level, const char *module,
+               const char *file, const char *func, int line,
+               const uint8_t *blob, size_t size,
+               const char *fmt, va_list vaargs)
+{
+    log_ring *ring = ring_self;
+    log_ring_record *record;
+    struct timespec now;
+    const char *base;
+    uint64_t seq;
+    int len;
+
+    if (ring == NULL) {
+        ring = ring_acquire();
+        if (ring == NULL) {
+            __atomic_add_fetch(&ring_lost, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    seq = ring->head + 1;
+    record = &ring->records[ring->head & (ring->capacity - 1)];
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    record->timestamp = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    record->line = line;
+    record->level = level;
+    record->blob_size = (uint32_t)size;
+    record->blob_len = blob == NULL ? 0 :
+        size < LOG_RING_BLOB_LEN ? size : LOG_RING_BLOB_LEN;
+    if (record->blob_len > 0)
+        memcpy(record->blob, blob, record->blob_len);
+
+    base = file ? strrchr(file, '/') : NULL;
+    copy_field(record->module, sizeof(record->module), module);
+    copy_field(record->file, sizeof(record->file), base ? base + 1 : file);
+    copy_field(record->func, sizeof(record->func), func);
+
+    len = vsnprintf(record->msg, sizeof(record->msg), fmt, vaargs);
+    if (len < 0)
+        len = 0;
+    if ((size_t)len < sizeof(record->msg))
+        memset(&record->msg[len], 0, sizeof(record->msg) - len);
+
+    __atomic_store_n(&record->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, seq, __ATOMIC_RELEASE);
+}
+
+/** Copy the records of a ring, oldest first.
+ *
+ * Records that are overwritten while they are copied are skipped.
+ *
+ * @param[in] ring The ring to copy.
+ * @param[out] header The header of the segment.
+ * @retval The copied records or NULL if there are none.
+ */
+static log_ring_record *
+ring_snapshot(log_ring *ring, log_ring_header *header)
+{
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > ring->capacity ? head - ring->capacity : 0;
+    log_ring_record *records;
+    uint64_t i, seq;
+
+    memcpy(header->magic, LOG_RING_MAGIC, sizeof(header->magic));
+    header->version = LOG_RING_VERSION;
+    header->record_size = sizeof(log_ring_record);
+    header->pid = getpid();
+    header->reserved = 0;
+    header->thread = ring->thread;
+    header->count = 0;
+    header->dropped = first;
+
+    if (head == first)
+        return NULL;
+    records = malloc((head - first) * sizeof(*records));
+    if (records == NULL)
+        return NULL;
+
+    for (i = first; i < head; i++) {
+        log_ring_record *src = &ring->records[i & (ring->capacity - 1)];
+        log_ring_record *dest = &records[header->count];
+
+        seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+        memcpy(dest, src, sizeof(*dest));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != i + 1 || __atomic_load_n(&src->seq, __ATOMIC_RELAXED) != seq) {
+            header->dropped += 1;
+            continue;
+        }
+        dest->seq = seq;
+        header->count += 1;
+    }
+    return records;
+}
+
+/** Append the records of one ring to a file.
+ *
+ * The ring is written as one segment with a single write call, so that
+ * segments of several processes or libraries do not interleave in a file
+ * opened with O_APPEND.
+ *
+ * @param[in] fd The file descriptor to write to.
+ * @param[in] ring The ring to write.
+ * @retval 0 on success.
+ * @retval -1 if the write failed.
+ */
+static int
+ring_dump_one(int fd, log_ring *ring)
+{
+    log_ring_header header;
+    log_ring_record *records;
+    struct iovec iov[2];
+    ssize_t total, written;
+
+    records = ring_snapshot(ring, &header);
+    if (records == NULL)
+        return 0;
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = records;
+    iov[1].iov_len = header.count * sizeof(*records);
+    total = iov[0].iov_len + iov[1].iov_len;
+
+    do {
+        written = writev(fd, iov, 2);
+    } while (written < 0 && errno == EINTR);
+    free(records);
+    return written == total ? 0 : -1;
+}
+
+/** Append the rings of all threads to a file.
+ *
+ * @param[in] fd The file descriptor to write to.
+ * @retval 0 on success.
+ * @retval -1 if a write failed.
+ */
+int
+log_ring_dump(int fd)
+{
+    log_ring *ring = __atomic_load_n(&ring_list, __ATOMIC_ACQUIRE);
+    int r = 0;
+
+    for (; ring != NULL; ring = ring->next) {
+        if (ring_dump_one(fd, ring) != 0)
+            r = -1;
+    }
+    return r;
+}
+
+/** Write the rings from a handler of a fatal signal.
+ *
+ * Only async-signal-safe functions are used, so the records are written
+ * directly from the rings without a snapshot. Records which are written by
+ * other threads at the same time may be torn or have a seq of zero.
+ *
+ * @param[in] sig The signal number.
+ */
+static void
+ring_signal_handler(int sig)
+{
+    log_ring *ring = __atomic_load_n(&ring_list, __ATOMIC_ACQUIRE);
+    log_ring_header header;
+    struct iovec iov[3];
+    uint64_t head, first;
+    size_t i, start;
+    int fd, saved_errno = errno;
+
+    fd = open(ring_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    for (; fd >= 0 && ring != NULL; ring = ring->next) {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        first = head > ring->capacity ? head - ring->capacity : 0;
+        if (head == first)
+            continue;
+
+        memcpy(header.magic, LOG_RING_MAGIC, sizeof(header.magic));
+        header.version = LOG_RING_VERSION;
+        header.record_size = sizeof(log_ring_record);
+        header.pid = getpid();
+        header.reserved = 0;
+        header.thread = ring->thread;
+        header.count = head - first;
+        header.dropped = first;
+
+        /* The records from first to head may wrap around the end of the ring. */
+        start = first & (ring->capacity - 1);
+        iov[0].iov_base = &header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = &ring->records[start];
+        if (start + header.count <= ring->capacity) {
+            iov[1].iov_len = header.count * sizeof(log_ring_record);
+            iov[2].iov_len = 0;
+        } else {
+            iov[1].iov_len = (ring->capacity - start) * sizeof(log_ring_record);
+            iov[2].iov_len = (start + header.count - ring->capacity) *
+                sizeof(log_ring_record);
+        }
+        iov[2].iov_base = &ring->records[0];
+        if (writev(fd, iov, 3) < 0)
+            break;
+    }
+    if (fd >= 0)
+        close(fd);
+
+    /* Hand the signal to the handler installed before. */
+    for (i = 0; i < RING_SIGNALS; i++) {
+        if (ring_signals[i] == sig)
+            sigaction(sig, &ring_old_actions[i], NULL);
+    }
+    errno = saved_errno;
+    raise(sig);
+}
+
+/** Install the handlers which write the rings on a fatal signal.
+ *
+ * The handlers installed before are saved and called after the dump.
+ */
+static void
+ring_install_signals(void)
+{
+    struct sigaction action;
+    int installed = 0;
+    size_t i;
+
+    if (!__atomic_compare_exchange_n(&ring_signals_installed, &installed, 1,
+                                     false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = ring_signal_handler;
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    for (i = 0; i < RING_SIGNALS; i++)
+        sigaction(ring_signals[i], &action, &ring_old_actions[i]);
+}
+
+/** Write the rings to the file named by TSS2_LOG_RING.
+ *
+ * Every library carries its own copy of the log code, so this runs once for
+ * each library that logged anything, when it is unloaded or the process
+ * exits.
+ */
+static void __attribute__((destructor))
+log_ring_fini(void)
+{
+    uint64_t lost = __atomic_load_n(&ring_lost, __ATOMIC_RELAXED);
+    size_t i;
+    int fd;
+
+#ifdef HAVE_PTHREAD
+    /* The destructor of the key must not run after the library is unloaded. */
+    if (ring_key_valid)
+        pthread_key_delete(ring_key);
+#endif
+    if (__atomic_load_n(&ring_signals_installed, __ATOMIC_ACQUIRE)) {
+        for (i = 0; i < RING_SIGNALS; i++)
+            sigaction(ring_signals[i], &ring_old_actions[i], NULL);
+    }
+
+    if (__atomic_load_n(&ring_state, __ATOMIC_ACQUIRE) != RING_ON ||
+        __atomic_load_n(&ring_list, __ATOMIC_ACQUIRE) == NULL)
+        return;
+
+    if (lost > 0)
+        fprintf(stderr, "%" PRIu64 " log messages were dropped, more than %d "
+                "threads were logging\n", lost, LOG_RING_MAX_RINGS);
+
+    fd = open(ring_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", ring_path, strerror(errno));
+        return;
+    }
+    if (log_ring_dump(fd) != 0)
+        fprintf(stderr, "Could not write %s: %s\n", ring_path, strerror(errno));
+    close(fd);
+}
+
+#endif /* LOG_RING_SUPPORTED */
@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary trace backend for the log macros. If the environment variable
+ * TSS2_LOG_RING names a file, log messages are not printed but stored as
+ * fixed size records in a ring buffer of the calling thread. Each thread
+ * writes only to its own ring, so no locks are taken. The ring of a thread
+ * is appended to the file when the thread exits and is then reused by other
+ * threads. All rings are appended to the file when the library is unloaded
+ * or the process exits, and on a fatal signal if TSS2_LOG_RING_SIGNALS is 1.
+ * script/log-ring-decode.py prints the records of such a file.
+ *
+ * The file consists of one segment per ring: a log_ring_header followed by
+ * header.count records, oldest first. All fields are in host byte order.
+ */
+#if !defined(_MSC_VER)
+#define LOG_RING_SUPPORTED 1
+#endif
+
+#define LOG_RING_MAGIC "TSS2RING"
+#define LOG_RING_VERSION 1
+
+/** Records per thread if TSS2_LOG_RING_SIZE is not set */
+#define LOG_RING_DEFAULT_SIZE 4096
+
+/** Maximum number of rings of one library; further threads are not logged */
+#define LOG_RING_MAX_RINGS 64
+
+#define LOG_RING_MODULE_LEN 16
+#define LOG_RING_FILE_LEN 32
+#define LOG_RING_FUNC_LEN 32
+#define LOG_RING_MSG_LEN 96
+#define LOG_RING_BLOB_LEN 48
+
+typedef struct {
+    uint64_t seq;                       /**< Number of the record, starting at 1 */
+    uint64_t timestamp;                 /**< CLOCK_REALTIME in nanoseconds */
+    uint32_t line;
+    uint32_t blob_size;                 /**< Size of the logged blob */
+    uint8_t level;                      /**< log_level of the message */
+    uint8_t blob_len;                   /**< Bytes of the blob stored in blob */
+    uint8_t reserved[6];
+    char module[LOG_RING_MODULE_LEN];
+    char file[LOG_RING_FILE_LEN];       /**< Base name of the source file */
+    char func[LOG_RING_FUNC_LEN];
+    char msg[LOG_RING_MSG_LEN];         /**< The formatted message */
+    uint8_t blob[LOG_RING_BLOB_LEN];    /**< The start of the logged blob */
+} log_ring_record;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t pid;                       /**< Process that wrote the segment */
+    uint32_t reserved;
+    uint64_t thread;                    /**< Number of the thread in the process */
+    uint64_t count;                     /**< Number of records in the segment */
+    uint64_t dropped;                   /**< Records overwritten in the ring */
+} log_ring_header;
+
+bool
+log_ring_enabled(void);
+
+void
+log_ring_write(int level, const char *module,
+               const char *file, const char *func, int line,
+               const uint8_t *blob, size_t size,
+               const char *fmt, va_list vaargs);
+
+int
+log_ring_dump(int fd);
+
+#endif /* LOG_RING_H */
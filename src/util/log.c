@@ -10,6 +10,7 @@
 
 #define LOGMODULE log
 #include "log.h"
+#include "log-ring.h"
 
 #if !defined(_MSC_VER) || defined(__INTEL_COMPILER)
 #define likely(x)       __builtin_expect(!!(x), 1)
@@ -74,6 +75,33 @@ case_insensitive_strncmp(const char *string1,
 static log_level
 getLogLevel(const char *module, log_level logdefault);
 
+static void
+vlogStderr(log_level loglevel, const char *module,
+           const char *file, const char *func, int line,
+           const char *msg, va_list vaargs)
+{
+    int size = snprintf(NULL, 0, "%s:%s:%s:%d:%s() %s \n",
+                log_strings[loglevel], module, file, line, func, msg);
+    char fmt[size+1];
+    snprintf(fmt, sizeof(fmt), "%s:%s:%s:%d:%s() %s \n",
+                log_strings[loglevel], module, file, line, func, msg);
+
+    vfprintf (stderr, fmt,
+        /* log_strings[loglevel], module, file, func, line, */
+        vaargs);
+}
+
+static void
+logStderr(log_level loglevel, const char *module,
+          const char *file, const char *func, int line,
+          const char *msg, ...)
+{
+    va_list vaargs;
+    va_start(vaargs, msg);
+    vlogStderr(loglevel, module, file, func, line, msg, vaargs);
+    va_end(vaargs);
+}
+
 void
 doLogBlob(log_level loglevel, const char *module, log_level logdefault,
            log_level *status,
@@ -86,6 +114,18 @@ doLogBlob(log_level loglevel, const char *module, log_level logdefault,
         return;
 
     va_list vaargs;
+#ifdef LOG_RING_SUPPORTED
+    if (log_ring_enabled()) {
+        va_start(vaargs, fmt);
+        log_ring_write(loglevel, module, file, func, line, blob, size,
+                       fmt, vaargs);
+        va_end(vaargs);
+        /* Errors are printed in addition to the trace. */
+        if (loglevel > LOGLEVEL_ERROR)
+            return;
+    }
+#endif /* LOG_RING_SUPPORTED */
+
     va_start(vaargs, fmt);
     /* TODO: Unfortunately, vsnprintf(NULL, 0, ...) do not behave the same as
        snprintf(NULL, 0, ...). Until there is an alternative, messages on
@@ -96,8 +136,8 @@ doLogBlob(log_level loglevel, const char *module, log_level logdefault,
     vsnprintf(msg, sizeof(msg), fmt, vaargs);
     va_end(vaargs);
 
-    doLog(loglevel, module, logdefault, status, file, func, line,
-          "%s (size=%zi):", msg, size);
+    logStderr(loglevel, module, file, func, line,
+              "%s (size=%zi):", msg, size);
 
     unsigned int i, y, x, off, off2;
     unsigned int width = 16;
@@ -159,17 +199,20 @@ doLog(log_level loglevel, const char *module, log_level logdefault,
     if (loglevel > *status)
         return;
 
-    int size = snprintf(NULL, 0, "%s:%s:%s:%d:%s() %s \n",
-                log_strings[loglevel], module, file, line, func, msg);
-    char fmt[size+1];
-    snprintf(fmt, sizeof(fmt), "%s:%s:%s:%d:%s() %s \n",
-                log_strings[loglevel], module, file, line, func, msg);
-
     va_list vaargs;
+#ifdef LOG_RING_SUPPORTED
+    if (log_ring_enabled()) {
+        va_start(vaargs, msg);
+        log_ring_write(loglevel, module, file, func, line, NULL, 0,
+                       msg, vaargs);
+        va_end(vaargs);
+        if (loglevel > LOGLEVEL_ERROR)
+            return;
+    }
+#endif /* LOG_RING_SUPPORTED */
+
     va_start(vaargs, msg);
-    vfprintf (stderr, fmt,
-        /* log_strings[loglevel], module, file, func, line, */
-        vaargs);
+    vlogStderr(loglevel, module, file, func, line, msg, vaargs);
     va_end(vaargs);
 }
 
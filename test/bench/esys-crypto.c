@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tss2_esys.h"
+#include "esys_crypto.h"
+
+/*
+ * Benchmark of the crypto operations done by ESYS for sessions. Reports the
+ * time per operation of:
+ * - the crypto of a command with an HMAC session, with the TPM round trip
+ *   left out, with and without a pool of reusable contexts,
+ * - the XOR parameter obfuscation, keying the HMAC of KDFa once per
+ *   parameter and, for reference, once per digest,
+ * - the AES-CFB parameter encryption with and without the crypto state
+ *   cached in the session.
+ */
+
+#define BENCH_ROUNDS 2000
+
+static double
+elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e6 +
+        (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+#define BENCH(result, call) \
+    do { \
+        struct timespec start, end; \
+        clock_gettime(CLOCK_MONOTONIC, &start); \
+        for (int i = 0; i < BENCH_ROUNDS; i++) { \
+            if (call != TSS2_RC_SUCCESS) { \
+                fprintf(stderr, "%s failed\n", #call); \
+                exit(EXIT_FAILURE); \
+            } \
+        } \
+        clock_gettime(CLOCK_MONOTONIC, &end); \
+        result = elapsed_us(&start, &end) / BENCH_ROUNDS; \
+    } while (0)
+
+/* The crypto operations of a command with one HMAC session */
+static TSS2_RC
+session_command(IESYS_CRYPTO_POOL **pool)
+{
+    TSS2_RC rc;
+    uint8_t key[32] = { 1, 2, 3 };
+    uint8_t cc[4] = { 0x00, 0x00, 0x01, 0x7b };
+    uint8_t rc_buffer[4] = { 0 };
+    uint8_t parameters[64] = { 4, 5, 6 };
+    TPM2B_NAME name = { .size = 4, .name = { 0x40, 0x00, 0x00, 0x01 } };
+    TPM2B_NONCE nonce_caller = { .size = 32, .buffer = { 7 } };
+    TPM2B_NONCE nonce_tpm = { .size = 32, .buffer = { 8 } };
+    TPM2B_AUTH hmac = { .size = sizeof(TPMU_HA) };
+    uint8_t digest[sizeof(TPMU_HA)];
+    size_t digest_size = sizeof(digest);
+
+    rc = iesys_crypto_cpHash(pool, TPM2_ALG_SHA256, cc, &name, NULL, NULL,
+                             parameters, sizeof(parameters),
+                             digest, &digest_size);
+    if (rc != TSS2_RC_SUCCESS)
+        return rc;
+    rc = iesys_crypto_authHmac(pool, TPM2_ALG_SHA256, key, sizeof(key),
+                               digest, digest_size, &nonce_caller, &nonce_tpm,
+                               NULL, NULL, TPMA_SESSION_CONTINUESESSION,
+                               &hmac);
+    if (rc != TSS2_RC_SUCCESS)
+        return rc;
+
+    digest_size = sizeof(digest);
+    rc = iesys_crypto_rpHash(pool, TPM2_ALG_SHA256, rc_buffer, cc,
+                             parameters, sizeof(parameters),
+                             digest, &digest_size);
+    if (rc != TSS2_RC_SUCCESS)
+        return rc;
+    hmac.size = sizeof(TPMU_HA);
+    return iesys_crypto_authHmac(pool, TPM2_ALG_SHA256, key, sizeof(key),
+                                 digest, digest_size, &nonce_tpm,
+                                 &nonce_caller, NULL, NULL,
+                                 TPMA_SESSION_CONTINUESESSION, &hmac);
+}
+
+/* XOR obfuscation with one KDFa iteration, and one keying, per digest */
+static TSS2_RC
+xor_per_digest(IESYS_CRYPTO_POOL **pool, uint8_t *key, size_t key_size,
+               TPM2B_NONCE *contextU, TPM2B_NONCE *contextV, BYTE *data,
+               size_t data_size)
+{
+    TSS2_RC rc;
+    BYTE block[sizeof(TPMU_HA)];
+    size_t digest_size;
+    uint32_t bit_size = data_size * 8;
+
+    for (uint32_t counter = 1; data_size > 0; counter++) {
+        digest_size = sizeof(block);
+        rc = iesys_crypto_KDFaHmac(pool, TPM2_ALG_SHA256, key, key_size,
+                                   counter, "XOR", contextU, contextV,
+                                   bit_size, block, &digest_size);
+        if (rc != TSS2_RC_SUCCESS)
+            return rc;
+        for (size_t i = 0; i < digest_size && data_size > 0; i++, data_size--)
+            *data++ ^= block[i];
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/* AES-CFB parameter encryption of a command with a new caller nonce */
+static TSS2_RC
+param_aes_cfb(IESYS_CRYPTO_POOL **pool, IESYS_CRYPTO_SESSION_CACHE **cache,
+              uint8_t *key, size_t key_size, TPM2B_NONCE *nonce_caller,
+              TPM2B_NONCE *nonce_tpm, int round, BYTE *data, size_t data_size)
+{
+    nonce_caller->buffer[0] = round;
+    return iesys_crypto_param_aes_cfb(pool, cache, TPM2_ALG_SHA256, key,
+                                      key_size, nonce_caller, nonce_tpm, 128,
+                                      data, data_size, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    IESYS_CRYPTO_POOL *pool = NULL;
+    IESYS_CRYPTO_SESSION_CACHE *cache = NULL;
+    uint8_t key[64] = { 1, 2, 3 };
+    TPM2B_NONCE contextU = { .size = 32, .buffer = { 7 } };
+    TPM2B_NONCE contextV = { .size = 32, .buffer = { 8 } };
+    static const size_t sizes[] = { 32, 33, 256, 1024, 2048 };
+    BYTE data[2048] = { 0 };
+    double unpooled_us, pooled_us, digest_us, once_us, uncached_us, cached_us;
+
+    BENCH(unpooled_us, session_command(NULL));
+    BENCH(pooled_us, session_command(&pool));
+    printf("HMAC session overhead per command: %.2f us unpooled, "
+           "%.2f us pooled\n", unpooled_us, pooled_us);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        BENCH(digest_us, xor_per_digest(&pool, key, sizeof(key), &contextU,
+                                        &contextV, data, sizes[s]));
+        BENCH(once_us, iesys_xor_parameter_obfuscation(&pool, TPM2_ALG_SHA256,
+                                                       key, sizeof(key),
+                                                       &contextU, &contextV,
+                                                       data, sizes[s]));
+        printf("XOR obfuscation of %zu bytes: %.2f us keyed per digest, "
+               "%.2f us keyed once\n", sizes[s], digest_us, once_us);
+    }
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        BENCH(uncached_us, param_aes_cfb(&pool, NULL, key, sizeof(key),
+                                         &contextU, &contextV, i, data,
+                                         sizes[s]));
+        BENCH(cached_us, param_aes_cfb(&pool, &cache, key, sizeof(key),
+                                       &contextU, &contextV, i, data,
+                                       sizes[s]));
+        printf("AES-CFB parameter encryption of %zu bytes: %.2f us uncached, "
+               "%.2f us cached\n", sizes[s], uncached_us, cached_us);
+    }
+
+    iesys_crypto_session_cache_free(&cache);
+    iesys_crypto_pool_free(&pool);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+
+/*
+ * Benchmark of the ESYS_TR hash table of an ESYS_CONTEXT. Reports the time
+ * per create, per lookup and per close at an increasing number of objects.
+ * With the table these stay flat, where the former list grew linearly.
+ */
+
+#define BENCH_LOOKUPS 1000000
+
+static const size_t object_counts[] = { 16, 256, 4096 };
+
+static void
+fail(const char *what)
+{
+    fprintf(stderr, "%s failed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct timespec start, end;
+    double create_ns, lookup_ns, close_ns;
+    ESYS_TR first = ESYS_TR_MIN_OBJECT;
+    ESYS_CONTEXT *ectx;
+    RSRC_NODE_T *node;
+    size_t n, i, count;
+
+    ectx = calloc(1, sizeof(ESYS_CONTEXT));
+    if (ectx == NULL)
+        fail("calloc");
+
+    for (n = 0; n < sizeof(object_counts) / sizeof(object_counts[0]); n++) {
+        count = object_counts[n];
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < count; i++) {
+            if (esys_CreateResourceObject(ectx, first + i, &node) !=
+                TSS2_RC_SUCCESS)
+                fail("esys_CreateResourceObject");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        create_ns = elapsed_ns(&start, &end) / count;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < BENCH_LOOKUPS; i++) {
+            if (esys_GetResourceObject(ectx, first + i % count, &node) !=
+                TSS2_RC_SUCCESS)
+                fail("esys_GetResourceObject");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        lookup_ns = elapsed_ns(&start, &end) / BENCH_LOOKUPS;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < count; i++) {
+            if (esys_DeleteResourceObject(ectx, first + i) != TSS2_RC_SUCCESS)
+                fail("esys_DeleteResourceObject");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        close_ns = elapsed_ns(&start, &end) / count;
+
+        printf("resource table with %zu objects: %.1f ns per create, "
+               "%.1f ns per lookup, %.1f ns per close\n", count, create_ns,
+               lookup_ns, close_ns);
+    }
+
+    iesys_DeleteAllResourceObjects(ectx);
+    free(ectx);
+    return EXIT_SUCCESS;
+}
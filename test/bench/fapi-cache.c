@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+
+#include "../integration/test-fapi.h"
+#include "fapi_util.h"
+#include "fapi_int.h"
+
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Benchmark of the caches FAPI keeps across commands. The latency of
+ * back-to-back Fapi_Sign calls is compared with and without the primary
+ * cache, the session pool and the key cache. Like the FAPI integration
+ * tests it needs a TPM, "make bench" runs it with the simulator through
+ * the integration test script.
+ */
+
+#define SIGN_TEMPLATE   "sign,noDa"
+#define PARENT_TEMPLATE "restricted,decrypt,noDa"
+#define SIGN_COUNT 20
+#define NUM_KEYS 4
+
+static const char *sign_key[] = { "HS/SRK/mySignKey" };
+
+static const char *parent_keys[NUM_KEYS] = {
+    "HS/SRK/myParent/mySignKey0",
+    "HS/SRK/myParent/mySignKey1",
+    "HS/SRK/myParent/mySignKey2",
+    "HS/SRK/myParent/mySignKey3",
+};
+
+/* Sign SIGN_COUNT times with each of the keys and report the latency. */
+static TSS2_RC
+bench_sign(FAPI_CONTEXT *context, const char *what, const char **paths,
+           size_t num_paths, const char *sigscheme)
+{
+    TSS2_RC r;
+    double ms;
+
+    /* The first command fills the caches. */
+    r = sign_loop(context, paths, num_paths, 1, sigscheme, NULL);
+    return_if_error(r, "Warm up");
+
+    r = sign_loop(context, paths, num_paths, SIGN_COUNT, sigscheme, &ms);
+    return_if_error(r, "Sign");
+
+    printf("%s: %.2f ms per Fapi_Sign\n", what,
+           ms / (SIGN_COUNT * num_paths));
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+caches_off(FAPI_CONTEXT *context)
+{
+    ifapi_primary_cache_flush(context);
+    ifapi_key_cache_flush(context);
+    ifapi_session_pool_flush(context);
+    context->config.primary_cache_size = 0;
+    context->config.key_cache_size = 0;
+    context->config.session_pool_size = 0;
+}
+
+int
+test_invoke_fapi(FAPI_CONTEXT *context)
+{
+    TSS2_RC r;
+    char *sigscheme = NULL;
+
+    if (strcmp("P_ECC", fapi_profile) != 0)
+        sigscheme = "RSA_PSS";
+
+    r = Fapi_Provision(context, NULL, NULL, NULL);
+    goto_if_error(r, "Error Fapi_Provision", error);
+
+    r = Fapi_CreateKey(context, sign_key[0], SIGN_TEMPLATE, "", "");
+    goto_if_error(r, "Error Fapi_CreateKey", error);
+
+    r = Fapi_CreateKey(context, "HS/SRK/myParent", PARENT_TEMPLATE, "", "");
+    goto_if_error(r, "Error Fapi_CreateKey", error);
+
+    for (size_t k = 0; k < NUM_KEYS; k++) {
+        r = Fapi_CreateKey(context, parent_keys[k], SIGN_TEMPLATE, "", "");
+        goto_if_error(r, "Error Fapi_CreateKey", error);
+    }
+
+    caches_off(context);
+    r = bench_sign(context, "no caches", sign_key, 1, sigscheme);
+    goto_if_error(r, "Bench", error);
+
+    context->config.primary_cache_size = 1;
+    r = bench_sign(context, "primary cache", sign_key, 1, sigscheme);
+    goto_if_error(r, "Bench", error);
+
+    context->config.session_pool_size = 1;
+    context->config.session_max_uses = 2 * SIGN_COUNT;
+    r = bench_sign(context, "primary cache and session pool", sign_key, 1,
+                   sigscheme);
+    goto_if_error(r, "Bench", error);
+
+    caches_off(context);
+    r = bench_sign(context, "no caches, key below a parent", parent_keys,
+                   NUM_KEYS, sigscheme);
+    goto_if_error(r, "Bench", error);
+
+    context->config.primary_cache_size = 1;
+    context->config.key_cache_size = NUM_KEYS + 1;
+    context->config.key_cache_slots = 2;
+    r = bench_sign(context, "primary and key cache, key below a parent",
+                   parent_keys, NUM_KEYS, sigscheme);
+    goto_if_error(r, "Bench", error);
+
+    r = Fapi_Delete(context, "/");
+    goto_if_error(r, "Error Fapi_Delete", error);
+
+    caches_off(context);
+    return EXIT_SUCCESS;
+
+error:
+    Fapi_Delete(context, "/");
+    caches_off(context);
+    return EXIT_FAILURE;
+}
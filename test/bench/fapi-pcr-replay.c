@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <json-c/json.h>
+
+#include "ifapi_pcr_replay.h"
+
+/*
+ * Benchmark of the checkpoint lookup of the PCR replay done by
+ * Fapi_VerifyQuote. An event list that was verified before is verified
+ * again with one appended event. Reports the time to validate the
+ * checkpoint by comparing the events of the list with the events of the
+ * checkpoint and, for reference, by chaining a SHA256 digest over the
+ * serialized events as the lookup did before. Like Fapi_VerifyQuote, every
+ * round parses the list again; the parsing is not timed.
+ */
+
+#define BENCH_ROUNDS 20
+
+static double
+elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e6 +
+        (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/* An event list with IMA like events for PCR 10 in JSON representation */
+static char *
+event_list_string(size_t n_events)
+{
+    static const char *fmt =
+        "%s{\"recnum\":%zu,\"pcr\":10,\"content_type\":\"ima_template\","
+        "\"digests\":[{\"hashAlg\":\"sha1\",\"digest\":\"%040zx\"},"
+        "{\"hashAlg\":\"sha256\",\"digest\":\"%064zx\"}],"
+        "\"content\":{\"template_name\":\"ima-ng\","
+        "\"template_value\":\"%0128zx\"}}";
+    size_t i, size = 512 * n_events + 3;
+    char *json = malloc(size), *pos = json;
+
+    if (!json)
+        return NULL;
+    *pos++ = '[';
+    for (i = 0; i < n_events; i++)
+        pos += snprintf(pos, size - (pos - json), fmt, i ? "," : "", i + 1,
+                        i, i, i);
+    strcpy(pos, "]");
+    return json;
+}
+
+/* The former validation: a SHA256 digest chained over the serialized events */
+static bool
+chained_digest(json_object *list)
+{
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    const char *event;
+    EVP_MD_CTX *ctx;
+    size_t i;
+    bool ok;
+
+    for (i = 0; i < json_object_array_length(list); i++) {
+        event = json_object_to_json_string_ext(json_object_array_get_idx(list, i),
+                                               JSON_C_TO_STRING_PLAIN);
+        ctx = EVP_MD_CTX_new();
+        ok = event && ctx &&
+            EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+            EVP_DigestUpdate(ctx, digest, size) == 1 &&
+            EVP_DigestUpdate(ctx, event, strlen(event)) == 1 &&
+            EVP_DigestFinal_ex(ctx, digest, &size) == 1;
+        EVP_MD_CTX_free(ctx);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+/* Validate the checkpoint for a freshly parsed list BENCH_ROUNDS times. */
+static double
+bench_lookup(IFAPI_PCR_REPLAY_CACHE *cache, const char *json, IFAPI_VPCR *pcr,
+             bool compare)
+{
+    IFAPI_PCR_CHECKPOINT *checkpoint = NULL;
+    struct timespec start, end;
+    json_object *list;
+    double us = 0;
+    bool ok;
+
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        list = json_tokener_parse(json);
+        if (!list) {
+            fprintf(stderr, "Parse event list failed\n");
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (compare) {
+            ifapi_pcr_replay_lookup(cache, list, pcr, 1, &checkpoint);
+            ok = checkpoint != NULL;
+        } else {
+            ok = chained_digest(list);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        json_object_put(list);
+        if (!ok) {
+            fprintf(stderr, "Checkpoint lookup failed\n");
+            exit(EXIT_FAILURE);
+        }
+        us += elapsed_us(&start, &end);
+    }
+    return us / BENCH_ROUNDS;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 100, 1000, 10000 };
+    IFAPI_PCR_REPLAY_CACHE *cache;
+    IFAPI_VPCR pcr = { .bank = TPM2_ALG_SHA256, .pcr = 10,
+                       .value = { .size = TPM2_SHA256_DIGEST_SIZE } };
+    char *json, *longer;
+    json_object *list;
+    double digest_us, compare_us;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        cache = calloc(1, sizeof(*cache));
+        json = event_list_string(sizes[s]);
+        longer = event_list_string(sizes[s] + 1);
+        list = json ? json_tokener_parse(json) : NULL;
+        if (!cache || !longer || !list ||
+            ifapi_pcr_replay_store(cache, NULL, list, &pcr, 1) != TSS2_RC_SUCCESS) {
+            fprintf(stderr, "Setup failed\n");
+            return EXIT_FAILURE;
+        }
+        json_object_put(list);
+
+        digest_us = bench_lookup(cache, longer, &pcr, false);
+        compare_us = bench_lookup(cache, longer, &pcr, true);
+        printf("Checkpoint of %zu events for a list of %zu events: "
+               "%.1f us chained digest, %.1f us compared\n",
+               sizes[s], sizes[s] + 1, digest_us, compare_us);
+
+        ifapi_pcr_replay_cache_free(&cache);
+        free(json);
+        free(longer);
+    }
+    return EXIT_SUCCESS;
+}
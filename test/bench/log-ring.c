@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOGMODULE test
+#include "util/log.h"
+
+/*
+ * Benchmark of the trace ring backend of the log macros. Reports the time
+ * per message. Errors are written to the ring and to stderr, which is
+ * redirected to /dev/null here, so the difference is the cost of the text
+ * output.
+ */
+
+#define BENCH_ROUNDS 20000
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+#define BENCH(result, call) \
+    do { \
+        struct timespec start, end; \
+        clock_gettime(CLOCK_MONOTONIC, &start); \
+        for (int i = 0; i < BENCH_ROUNDS; i++) { \
+            call; \
+        } \
+        clock_gettime(CLOCK_MONOTONIC, &end); \
+        result = elapsed_ns(&start, &end) / BENCH_ROUNDS; \
+    } while (0)
+
+int
+main(int argc, char *argv[])
+{
+    uint8_t blob[256] = { 0 };
+    double log_ns, blob_ns, error_ns;
+    int null_fd, stderr_fd;
+
+    setenv("TSS2_LOG", "test+debug", 1);
+    setenv("TSS2_LOG_RING", "/dev/null", 1);
+
+    BENCH(log_ns, LOG_DEBUG("benchmark %i", i));
+    BENCH(blob_ns, LOGBLOB_DEBUG(blob, sizeof(blob), "benchmark %i", i));
+
+    fflush(stderr);
+    stderr_fd = dup(STDERR_FILENO);
+    null_fd = open("/dev/null", O_WRONLY);
+    if (stderr_fd < 0 || null_fd < 0) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+    dup2(null_fd, STDERR_FILENO);
+    BENCH(error_ns, LOGBLOB_ERROR(blob, sizeof(blob), "benchmark %i", i));
+    fflush(stderr);
+    dup2(stderr_fd, STDERR_FILENO);
+    close(null_fd);
+    close(stderr_fd);
+
+    printf("log ring: %.1f ns per message, %.1f ns per blob, "
+           "%.1f ns per blob with text output\n", log_ns, blob_ns, error_ns);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tss2_tcti_mssim.h"
+
+#include "mssim-stand-in.h"
+
+#define BASE_PORT   23421
+#define MAX_CLIENTS 64
+#define CMD_MAX     4096
+#define RSP_SIZE    14
+
+static int
+listen_on (uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons (port),
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    int one = 1;
+    int fd;
+
+    fd = socket (AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0 ||
+        listen (fd, MAX_CLIENTS) != 0) {
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int
+read_all (int fd, uint8_t *buf, size_t size)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < size) {
+        ret = read (fd, buf + done, size - done);
+        if (ret <= 0)
+            return -1;
+        done += ret;
+    }
+    return 0;
+}
+
+static uint32_t
+get_be32 (const uint8_t *buf)
+{
+    return (uint32_t)buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+}
+
+static void
+put_be32 (uint8_t *buf, uint32_t value)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+/*
+ * Serve one message on a connected socket. Returns -1 when the client is
+ * gone or ended the session.
+ */
+static int
+serve (int fd, int is_platform)
+{
+    uint8_t buf[CMD_MAX];
+    uint8_t rsp[4 + RSP_SIZE + 4] = { 0 };
+    uint32_t size;
+
+    if (read_all (fd, buf, 4) != 0)
+        return -1;
+    if (is_platform) {
+        memset (buf, 0, 4);
+        return write (fd, buf, 4) == 4 ? 0 : -1;
+    }
+    if (get_be32 (buf) != MS_SIM_TPM_SEND_COMMAND)
+        return -1;
+
+    /* locality and size of the command */
+    if (read_all (fd, buf, 5) != 0)
+        return -1;
+    size = get_be32 (&buf[1]);
+    if (size < 10 || size > sizeof (buf) || read_all (fd, buf, size) != 0)
+        return -1;
+
+    /* size, success response echoing the command code, trailing 0's */
+    put_be32 (rsp, RSP_SIZE);
+    rsp[4] = 0x80;
+    rsp[5] = 0x01;
+    put_be32 (&rsp[6], RSP_SIZE);
+    memcpy (&rsp[14], &buf[6], 4);
+    return write (fd, rsp, sizeof (rsp)) == sizeof (rsp) ? 0 : -1;
+}
+
+static void
+stand_in (int tpm_fd, int platform_fd)
+{
+    struct pollfd fds[2 + MAX_CLIENTS];
+    int is_platform[2 + MAX_CLIENTS];
+    nfds_t nfds = 2;
+
+    fds[0] = (struct pollfd){ .fd = tpm_fd, .events = POLLIN };
+    fds[1] = (struct pollfd){ .fd = platform_fd, .events = POLLIN };
+    for (;;) {
+        if (poll (fds, nfds, -1) < 0)
+            _exit (EXIT_FAILURE);
+        for (nfds_t i = 2; i < nfds; i++) {
+            if (fds[i].revents == 0)
+                continue;
+            if (serve (fds[i].fd, is_platform[i]) != 0) {
+                close (fds[i].fd);
+                fds[i] = fds[--nfds];
+                is_platform[i] = is_platform[nfds];
+                i--;
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!(fds[i].revents & POLLIN) || nfds == 2 + MAX_CLIENTS)
+                continue;
+            fds[nfds] = (struct pollfd){
+                .fd = accept (fds[i].fd, NULL, NULL), .events = POLLIN };
+            is_platform[nfds] = i;
+            if (fds[nfds].fd >= 0)
+                nfds++;
+        }
+    }
+}
+
+/*
+ * Start the stand-in on the first free pair of ports. The TPM port is
+ * returned in 'port', the platform port is the one after it.
+ */
+pid_t
+mssim_stand_in_start (uint16_t *port)
+{
+    int tpm_fd = -1, platform_fd = -1;
+    pid_t pid;
+
+    for (*port = BASE_PORT; *port < BASE_PORT + 200; *port += 2) {
+        tpm_fd = listen_on (*port);
+        platform_fd = listen_on (*port + 1);
+        if (tpm_fd >= 0 && platform_fd >= 0)
+            break;
+        if (tpm_fd >= 0)
+            close (tpm_fd);
+        if (platform_fd >= 0)
+            close (platform_fd);
+        tpm_fd = platform_fd = -1;
+    }
+    if (tpm_fd < 0)
+        return -1;
+
+    pid = fork ();
+    if (pid == 0)
+        stand_in (tpm_fd, platform_fd);
+    close (tpm_fd);
+    close (platform_fd);
+    return pid;
+}
+
+void
+mssim_stand_in_stop (pid_t pid)
+{
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+}
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifndef MSSIM_STAND_IN_H
+#define MSSIM_STAND_IN_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * A stand-in for the Microsoft TPM2 simulator for benchmarks. It runs in a
+ * forked process and listens on two consecutive loopback ports like the
+ * simulator. Every TPM command is answered with a response that echoes the
+ * command code behind a success header, every platform command succeeds.
+ */
+
+pid_t
+mssim_stand_in_start (uint16_t *port);
+
+void
+mssim_stand_in_stop (pid_t pid);
+
+#endif /* MSSIM_STAND_IN_H */
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tss2_sys.h"
+#include "tss2_tcti.h"
+
+/*
+ * Benchmark of the receive path of Tss2_Sys_Execute. A TCTI stand-in
+ * answers every TPM2_GetRandom with a fixed response. The time per command
+ * is reported together with the number of receive calls and response size
+ * queries the SYS context issues per command.
+ */
+
+#define BENCH_COMMANDS 1000000
+
+static const uint8_t ok_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x2C,     /* Response Size 10 + 2 + 32 */
+    0x00, 0x00, 0x00, 0x00,     /* TPM_RC_SUCCESS */
+    0x00, 0x20,                 /* size of buffer */
+    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+    0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+};
+
+static size_t receive_calls;
+static size_t size_queries;
+
+static TSS2_RC
+tcti_transmit(TSS2_TCTI_CONTEXT *tctiContext, size_t size,
+              uint8_t const *command)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_receive(TSS2_TCTI_CONTEXT *tctiContext, size_t *size, uint8_t *response,
+             int32_t timeout)
+{
+    receive_calls++;
+    if (response == NULL) {
+        size_queries++;
+        *size = sizeof(ok_response);
+        return TSS2_RC_SUCCESS;
+    }
+    if (*size < sizeof(ok_response))
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+    memcpy(response, ok_response, sizeof(ok_response));
+    *size = sizeof(ok_response);
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+fail(const char *what)
+{
+    fprintf(stderr, "%s failed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int
+main(int argc, char *argv[])
+{
+    TSS2_ABI_VERSION ver = TSS2_ABI_VERSION_CURRENT;
+    TSS2_TCTI_CONTEXT_COMMON_V1 tcti_ctx = {
+        .version = 1,
+        .transmit = tcti_transmit,
+        .receive = tcti_receive,
+    };
+    struct timespec start, end;
+    TSS2_SYS_CONTEXT *sys_ctx;
+    TPM2B_DIGEST random;
+    size_t size_ctx;
+
+    size_ctx = Tss2_Sys_GetContextSize(0);
+    sys_ctx = calloc(1, size_ctx);
+    if (sys_ctx == NULL)
+        fail("calloc");
+    if (Tss2_Sys_Initialize(sys_ctx, size_ctx, (TSS2_TCTI_CONTEXT *)&tcti_ctx,
+                            &ver) != TSS2_RC_SUCCESS)
+        fail("Tss2_Sys_Initialize");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_COMMANDS; i++) {
+        if (Tss2_Sys_GetRandom(sys_ctx, NULL, 32, &random, NULL) !=
+            TSS2_RC_SUCCESS)
+            fail("Tss2_Sys_GetRandom");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("sys execute: %.1f ns per command, %.2f receive calls and "
+           "%.2f size queries per command\n",
+           elapsed_ns(&start, &end) / BENCH_COMMANDS,
+           (double)receive_calls / BENCH_COMMANDS,
+           (double)size_queries / BENCH_COMMANDS);
+
+    Tss2_Sys_Finalize(sys_ctx);
+    free(sys_ctx);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tss2_mu.h"
+#include "sysapi_mu.h"
+
+/*
+ * Benchmark of the fast path marshaling functions used by the SYS layer.
+ * Reports the time per marshaling operation of the Tss2_MU_* functions and
+ * of the fast path. TPMS_ATTEST is only transferred as an opaque
+ * TPM2B_ATTEST by the SYS layer; its marshaling time is reported for
+ * reference.
+ */
+
+#define BUFFER_SIZE 4096
+#define BENCH_ROUNDS 200000
+
+static void
+template_rsa(TPM2B_PUBLIC *pub)
+{
+    memset(pub, 0, sizeof(*pub));
+    pub->publicArea.type = TPM2_ALG_RSA;
+    pub->publicArea.nameAlg = TPM2_ALG_SHA256;
+    pub->publicArea.objectAttributes = TPMA_OBJECT_USERWITHAUTH |
+        TPMA_OBJECT_RESTRICTED | TPMA_OBJECT_DECRYPT |
+        TPMA_OBJECT_FIXEDTPM | TPMA_OBJECT_FIXEDPARENT |
+        TPMA_OBJECT_SENSITIVEDATAORIGIN;
+    pub->publicArea.authPolicy.size = 32;
+    memset(pub->publicArea.authPolicy.buffer, 0xa5, 32);
+    pub->publicArea.parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_AES;
+    pub->publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    pub->publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM2_ALG_CFB;
+    pub->publicArea.parameters.rsaDetail.scheme.scheme = TPM2_ALG_NULL;
+    pub->publicArea.parameters.rsaDetail.keyBits = 2048;
+    pub->publicArea.parameters.rsaDetail.exponent = 0;
+    pub->publicArea.unique.rsa.size = 256;
+    memset(pub->publicArea.unique.rsa.buffer, 0x5a, 256);
+}
+
+static void
+pcr_selection(TPML_PCR_SELECTION *sel)
+{
+    memset(sel, 0, sizeof(*sel));
+    sel->count = 3;
+    sel->pcrSelections[0].hash = TPM2_ALG_SHA1;
+    sel->pcrSelections[0].sizeofSelect = 3;
+    sel->pcrSelections[0].pcrSelect[0] = 0xff;
+    sel->pcrSelections[1].hash = TPM2_ALG_SHA256;
+    sel->pcrSelections[1].sizeofSelect = 4;
+    sel->pcrSelections[1].pcrSelect[3] = 0x80;
+    sel->pcrSelections[2].hash = TPM2_ALG_SHA384;
+    sel->pcrSelections[2].sizeofSelect = 0;
+}
+
+static void
+attest_quote(TPMS_ATTEST *attest)
+{
+    memset(attest, 0, sizeof(*attest));
+    attest->magic = TPM2_GENERATED_VALUE;
+    attest->type = TPM2_ST_ATTEST_QUOTE;
+    attest->qualifiedSigner.size = 34;
+    attest->extraData.size = 32;
+    attest->clockInfo.clock = 0x1122334455667788ULL;
+    attest->clockInfo.safe = TPM2_YES;
+    attest->firmwareVersion = 0x0102030405060708ULL;
+    pcr_selection(&attest->attested.quote.pcrSelect);
+    attest->attested.quote.pcrDigest.size = 32;
+}
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+        (end->tv_nsec - start->tv_nsec);
+}
+
+#define BENCH(result, call) \
+    do { \
+        struct timespec start, end; \
+        clock_gettime(CLOCK_MONOTONIC, &start); \
+        for (int i = 0; i < BENCH_ROUNDS; i++) { \
+            offset = 0; \
+            if (call != TSS2_RC_SUCCESS) { \
+                fprintf(stderr, "%s failed\n", #call); \
+                exit(EXIT_FAILURE); \
+            } \
+        } \
+        clock_gettime(CLOCK_MONOTONIC, &end); \
+        result = elapsed_ns(&start, &end) / BENCH_ROUNDS; \
+    } while (0)
+
+int
+main(int argc, char *argv[])
+{
+    uint8_t buffer[BUFFER_SIZE];
+    size_t offset;
+    TPM2B_PUBLIC pub;
+    TPML_PCR_SELECTION sel, sel_out;
+    TPMS_ATTEST attest;
+    double slow_ns, fast_ns;
+
+    template_rsa(&pub);
+    BENCH(slow_ns, Tss2_MU_TPM2B_PUBLIC_Marshal(&pub, buffer, sizeof(buffer),
+                                                &offset));
+    BENCH(fast_ns, FastMarshal_TPM2B_PUBLIC(&pub, buffer, sizeof(buffer),
+                                            &offset));
+    printf("TPM2B_PUBLIC marshal: %.1f ns generic, %.1f ns fast path\n",
+           slow_ns, fast_ns);
+
+    pcr_selection(&sel);
+    BENCH(slow_ns, Tss2_MU_TPML_PCR_SELECTION_Marshal(&sel, buffer,
+                                                      sizeof(buffer), &offset));
+    BENCH(fast_ns, FastMarshal_TPML_PCR_SELECTION(&sel, buffer, sizeof(buffer),
+                                                  &offset));
+    printf("TPML_PCR_SELECTION marshal: %.1f ns generic, %.1f ns fast path\n",
+           slow_ns, fast_ns);
+
+    BENCH(slow_ns, Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, sizeof(buffer),
+                                                        &offset, &sel_out));
+    BENCH(fast_ns, FastUnmarshal_TPML_PCR_SELECTION(buffer, sizeof(buffer),
+                                                    &offset, &sel_out));
+    printf("TPML_PCR_SELECTION unmarshal: %.1f ns generic, %.1f ns fast path\n",
+           slow_ns, fast_ns);
+
+    attest_quote(&attest);
+    BENCH(slow_ns, Tss2_MU_TPMS_ATTEST_Marshal(&attest, buffer, sizeof(buffer),
+                                               &offset));
+    printf("TPMS_ATTEST marshal: %.1f ns generic\n", slow_ns);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_mssim.h"
+
+#include "mssim-stand-in.h"
+
+/*
+ * Benchmark of the socket path of tcti-mssim against a stand-in for the
+ * simulator. Reports the time per command / response round trip and the
+ * number of system calls per round trip. The system calls of the socket
+ * layer are counted by wrapping them at link time.
+ */
+
+#define BENCH_ROUNDS 20000
+
+static size_t syscalls;
+
+ssize_t __real_read (int fd, void *buf, size_t len);
+ssize_t __real_readv (int fd, const struct iovec *iov, int iovcnt);
+ssize_t __real_write (int fd, const void *buf, size_t len);
+ssize_t __real_writev (int fd, const struct iovec *iov, int iovcnt);
+int __real_poll (struct pollfd *fds, nfds_t nfds, int timeout);
+
+ssize_t
+__wrap_read (int fd, void *buf, size_t len)
+{
+    syscalls++;
+    return __real_read (fd, buf, len);
+}
+
+ssize_t
+__wrap_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+    syscalls++;
+    return __real_readv (fd, iov, iovcnt);
+}
+
+ssize_t
+__wrap_write (int fd, const void *buf, size_t len)
+{
+    syscalls++;
+    return __real_write (fd, buf, len);
+}
+
+ssize_t
+__wrap_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+    syscalls++;
+    return __real_writev (fd, iov, iovcnt);
+}
+
+int
+__wrap_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    syscalls++;
+    return __real_poll (fds, nfds, timeout);
+}
+
+static void
+fail (const char *what)
+{
+    fprintf (stderr, "%s failed\n", what);
+    exit (EXIT_FAILURE);
+}
+
+static double
+elapsed_ns (const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    static const uint8_t cmd[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x01, 0x7b, 0x00, 0x08,
+    };
+    struct timespec start, end;
+    TSS2_TCTI_CONTEXT *ctx;
+    uint8_t rsp[64];
+    char conf[64];
+    size_t size;
+    uint16_t port;
+    pid_t pid;
+
+    pid = mssim_stand_in_start (&port);
+    if (pid < 0)
+        fail ("mssim_stand_in_start");
+    snprintf (conf, sizeof (conf), "host=127.0.0.1,port=%u", port);
+
+    if (Tss2_Tcti_Mssim_Init (NULL, &size, NULL) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Mssim_Init");
+    ctx = calloc (1, size);
+    if (ctx == NULL)
+        fail ("calloc");
+    if (Tss2_Tcti_Mssim_Init (ctx, &size, conf) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Mssim_Init");
+
+    syscalls = 0;
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        size = sizeof (rsp);
+        if (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd) != TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Transmit");
+        if (Tss2_Tcti_Receive (ctx, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK) !=
+            TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Receive");
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    printf ("mssim round trip: %.1f us, %.2f system calls per command\n",
+            elapsed_ns (&start, &end) / BENCH_ROUNDS / 1000,
+            (double)syscalls / BENCH_ROUNDS);
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+    mssim_stand_in_stop (pid);
+    return EXIT_SUCCESS;
+}
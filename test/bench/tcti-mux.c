@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_mssim.h"
+#include "tss2_tcti_mux.h"
+
+#include "mssim-stand-in.h"
+
+/*
+ * Stress benchmark of tcti-mux. N threads with one client each share one
+ * mssim TCTI connected to a stand-in for the simulator. Every thread checks
+ * that it receives the responses to its own commands. The throughput is
+ * reported for an increasing number of threads, one thread using the mssim
+ * TCTI directly is the baseline.
+ */
+
+#define BENCH_COMMANDS 20000
+
+static const size_t thread_counts[] = { 1, 2, 4, 8, 16 };
+
+typedef struct {
+    TSS2_TCTI_CONTEXT *ctx;
+    uint32_t first;
+    size_t commands;
+    size_t errors;
+} bench_thread_t;
+
+static void
+fail (const char *what)
+{
+    fprintf (stderr, "%s failed\n", what);
+    exit (EXIT_FAILURE);
+}
+
+/*
+ * The multiplexer loads its child TCTI with the TCTI loader; here the mssim
+ * TCTI is created directly, so the benchmark does not depend on the
+ * installed modules.
+ */
+TSS2_RC
+Tss2_TctiLdr_Initialize (const char *nameConf,
+                         TSS2_TCTI_CONTEXT **tctiContext)
+{
+    size_t size;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Mssim_Init (NULL, &size, NULL);
+    if (rc != TSS2_RC_SUCCESS)
+        return rc;
+    *tctiContext = calloc (1, size);
+    if (*tctiContext == NULL)
+        return TSS2_TCTI_RC_MEMORY;
+    rc = Tss2_Tcti_Mssim_Init (*tctiContext, &size, nameConf);
+    if (rc != TSS2_RC_SUCCESS) {
+        free (*tctiContext);
+        *tctiContext = NULL;
+    }
+    return rc;
+}
+
+void
+Tss2_TctiLdr_Finalize (TSS2_TCTI_CONTEXT **tctiContext)
+{
+    Tss2_Tcti_Finalize (*tctiContext);
+    free (*tctiContext);
+    *tctiContext = NULL;
+}
+
+static TSS2_TCTI_CONTEXT *
+client_new (TSS2_TCTI_CONTEXT *mux, const char *conf)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size;
+    TSS2_RC rc;
+
+    if (Tss2_Tcti_Mux_Init (NULL, &size, NULL) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Mux_Init");
+    ctx = calloc (1, size);
+    if (ctx == NULL)
+        fail ("calloc");
+    if (mux == NULL)
+        rc = Tss2_Tcti_Mux_Init (ctx, &size, conf);
+    else
+        rc = Tss2_Tcti_Mux_ClientInit (ctx, &size, mux);
+    if (rc != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Mux_Init");
+    return ctx;
+}
+
+static void
+client_free (TSS2_TCTI_CONTEXT *ctx)
+{
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
+
+/* Send a command with the code and check that the response echoes it. */
+static int
+round_trip (TSS2_TCTI_CONTEXT *ctx, uint32_t code)
+{
+    uint8_t cmd[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0a,
+        code >> 24, code >> 16, code >> 8, code,
+    };
+    uint8_t rsp[64];
+    size_t size = sizeof (rsp);
+
+    if (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd) != TSS2_RC_SUCCESS ||
+        Tss2_Tcti_Receive (ctx, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK) !=
+        TSS2_RC_SUCCESS)
+        return -1;
+    return (size == 14 && memcmp (&rsp[10], &cmd[6], 4) == 0) ? 0 : -1;
+}
+
+static void *
+bench_thread (void *arg)
+{
+    bench_thread_t *thread = arg;
+
+    for (size_t i = 0; i < thread->commands; i++) {
+        if (round_trip (thread->ctx, thread->first + i) != 0)
+            thread->errors += 1;
+    }
+    return NULL;
+}
+
+static double
+elapsed_s (const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double
+bench_direct (const char *conf)
+{
+    struct timespec start, end;
+    TSS2_TCTI_CONTEXT *ctx;
+
+    if (Tss2_TctiLdr_Initialize (conf, &ctx) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Mssim_Init");
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_COMMANDS; i++) {
+        if (round_trip (ctx, i) != 0)
+            fail ("round trip");
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    Tss2_TctiLdr_Finalize (&ctx);
+    return BENCH_COMMANDS / elapsed_s (&start, &end);
+}
+
+static double
+bench_mux (const char *conf, size_t threads)
+{
+    pthread_t ids[threads];
+    bench_thread_t args[threads];
+    struct timespec start, end;
+    size_t i;
+
+    for (i = 0; i < threads; i++) {
+        args[i].ctx = client_new (i == 0 ? NULL : args[0].ctx, conf);
+        args[i].first = (uint32_t)(i * BENCH_COMMANDS);
+        args[i].commands = BENCH_COMMANDS / threads;
+        args[i].errors = 0;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+        if (pthread_create (&ids[i], NULL, bench_thread, &args[i]) != 0)
+            fail ("pthread_create");
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join (ids[i], NULL);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    for (i = threads; i > 0; i--) {
+        if (args[i - 1].errors != 0)
+            fail ("response check");
+        client_free (args[i - 1].ctx);
+    }
+    return threads * (BENCH_COMMANDS / threads) / elapsed_s (&start, &end);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    char conf[64];
+    uint16_t port;
+    pid_t pid;
+
+    pid = mssim_stand_in_start (&port);
+    if (pid < 0)
+        fail ("mssim_stand_in_start");
+    snprintf (conf, sizeof (conf), "host=127.0.0.1,port=%u", port);
+
+    printf ("mssim without multiplexer: %.0f commands/s\n",
+            bench_direct (conf));
+    for (size_t i = 0; i < sizeof (thread_counts) / sizeof (thread_counts[0]);
+         i++) {
+        printf ("mux with %zu threads: %.0f commands/s\n", thread_counts[i],
+                bench_mux (conf, thread_counts[i]));
+    }
+
+    mssim_stand_in_stop (pid);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tss2-tcti/tcti-pcap-builder.h"
+
+/*
+ * Benchmark of the pcap builder. Reports the time spent in pcap_print on
+ * the caller's thread in the synchronous and, if built with pthreads, in
+ * the buffered mode.
+ */
+
+#define BENCH_PACKETS 20000
+
+static char dir[] = "/tmp/tcti-pcap-bench-XXXXXX";
+static char path[PATH_MAX];
+
+static double
+elapsed_ns (const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static double
+bench_print (void)
+{
+    struct timespec start, end;
+    pcap_buider_ctx ctx;
+    uint8_t payload[256] = { 0 };
+
+    if (pcap_init (&ctx) != 0) {
+        fprintf (stderr, "pcap_init failed\n");
+        exit (EXIT_FAILURE);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_PACKETS; i++) {
+        if (pcap_print (&ctx, payload, sizeof (payload), i % 2) < 0) {
+            fprintf (stderr, "pcap_print failed\n");
+            exit (EXIT_FAILURE);
+        }
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    pcap_deinit (&ctx);
+    unlink (path);
+
+    return elapsed_ns (&start, &end) / BENCH_PACKETS;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    if (mkdtemp (dir) == NULL) {
+        perror ("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    snprintf (path, sizeof (path), "%s/capture.pcap", dir);
+    setenv (ENV_PCAP_FILE, path, 1);
+
+    printf ("pcap_print: %.1f ns synchronous\n", bench_print ());
+#ifdef HAVE_PTHREAD
+    setenv (ENV_PCAP_BUFFER_SIZE, "4194304", 1);
+    setenv (ENV_PCAP_DROP_TIMEOUT, "1000", 1);
+    printf ("pcap_print: %.1f ns buffered\n", bench_print ());
+#endif /* HAVE_PTHREAD */
+
+    rmdir (dir);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_replay.h"
+
+#include "tss2-tcti/tcti-pcap-builder.h"
+
+/*
+ * Benchmark of tcti-replay. Records a capture with the pcap builder of
+ * tcti-pcap and reports the time to load it and the time per replayed
+ * command in the strict and the lenient mode.
+ */
+
+#define CMD_LEN 12
+#define RSP_LEN 14
+#define BENCH_EXCHANGES 20000
+
+static const TPM2_CC codes[] = {
+    TPM2_CC_GetRandom, TPM2_CC_GetCapability, TPM2_CC_PCR_Read,
+    TPM2_CC_ReadPublic,
+};
+
+static char dir[] = "/tmp/tcti-replay-bench-XXXXXX";
+static char path[PATH_MAX];
+static char conf[PATH_MAX + 32];
+
+static void
+fail (const char *what)
+{
+    fprintf (stderr, "%s failed\n", what);
+    exit (EXIT_FAILURE);
+}
+
+static void
+make_cmd (uint8_t *buf, TPM2_CC cc, uint16_t param)
+{
+    const uint8_t cmd[CMD_LEN] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, CMD_LEN,
+        cc >> 24, cc >> 16, cc >> 8, cc, param >> 8, param,
+    };
+    memcpy (buf, cmd, sizeof (cmd));
+}
+
+static void
+make_rsp (uint8_t *buf, uint16_t param)
+{
+    const uint8_t rsp[RSP_LEN] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, RSP_LEN, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x02, param >> 8, param,
+    };
+    memcpy (buf, rsp, sizeof (rsp));
+}
+
+static void
+record_capture (void)
+{
+    pcap_buider_ctx ctx;
+    uint8_t cmd[CMD_LEN], rsp[RSP_LEN];
+
+    if (pcap_init (&ctx) != 0)
+        fail ("pcap_init");
+    for (int i = 0; i < BENCH_EXCHANGES; i++) {
+        make_cmd (cmd, codes[i % 4], i);
+        make_rsp (rsp, i);
+        if (pcap_print (&ctx, cmd, sizeof (cmd), PCAP_DIR_HOST_TO_TPM) != 0 ||
+            pcap_print (&ctx, rsp, sizeof (rsp), PCAP_DIR_TPM_TO_HOST) != 0)
+            fail ("pcap_print");
+    }
+    pcap_deinit (&ctx);
+}
+
+static TSS2_TCTI_CONTEXT *
+replay_init (const char *mode)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size;
+
+    if (Tss2_Tcti_Replay_Init (NULL, &size, NULL) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Replay_Init");
+    ctx = calloc (1, size);
+    if (ctx == NULL)
+        fail ("calloc");
+    snprintf (conf, sizeof (conf), "file=%s,mode=%s", path, mode);
+    if (Tss2_Tcti_Replay_Init (ctx, &size, conf) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Replay_Init");
+    return ctx;
+}
+
+static void
+replay_finalize (TSS2_TCTI_CONTEXT *ctx)
+{
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
+
+static double
+elapsed_ns (const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static double
+bench_replay (const char *mode)
+{
+    struct timespec start, end;
+    TSS2_TCTI_CONTEXT *ctx;
+    uint8_t cmd[CMD_LEN], rsp[RSP_LEN];
+    size_t size;
+
+    ctx = replay_init (mode);
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_EXCHANGES; i++) {
+        make_cmd (cmd, codes[i % 4], i);
+        size = sizeof (rsp);
+        if (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd) != TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Transmit");
+        if (Tss2_Tcti_Receive (ctx, &size, rsp, TSS2_TCTI_TIMEOUT_BLOCK) !=
+            TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Receive");
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    replay_finalize (ctx);
+
+    return elapsed_ns (&start, &end) / BENCH_EXCHANGES;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    struct timespec start, end;
+    double load_ns, strict_ns, lenient_ns;
+
+    if (mkdtemp (dir) == NULL) {
+        perror ("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    snprintf (path, sizeof (path), "%s/capture.pcap", dir);
+    setenv (ENV_PCAP_FILE, path, 1);
+    record_capture ();
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    replay_finalize (replay_init ("lenient"));
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    load_ns = elapsed_ns (&start, &end);
+
+    strict_ns = bench_replay ("strict");
+    lenient_ns = bench_replay ("lenient");
+
+    printf ("replay of %d commands: %.0f us to load, %.1f ns per command "
+            "strict, %.1f ns per command lenient\n", BENCH_EXCHANGES,
+            load_ns / 1000, strict_ns, lenient_ns);
+
+    unlink (path);
+    rmdir (dir);
+    return EXIT_SUCCESS;
+}
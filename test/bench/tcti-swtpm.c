@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_swtpm.h"
+
+/*
+ * Benchmark of the keepalive mode of tcti-swtpm. A forked stand-in for
+ * swtpm answers every command on the data port with a fixed response and
+ * every control command with success. The time per round trip is reported
+ * with keepalive=1 and with the default reconnect per command.
+ */
+
+#define BENCH_ROUNDS 5000
+#define BASE_PORT 23321
+#define MAX_CLIENTS 16
+
+static const uint8_t cmd[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x01, 0x7b, 0x00, 0x08,
+};
+static const uint8_t rsp[] = {
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00,
+};
+
+static void
+fail (const char *what)
+{
+    fprintf (stderr, "%s failed\n", what);
+    exit (EXIT_FAILURE);
+}
+
+static int
+listen_on (uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons (port),
+        .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+    };
+    int one = 1;
+    int fd;
+
+    fd = socket (AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0 ||
+        listen (fd, MAX_CLIENTS) != 0) {
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int
+read_all (int fd, uint8_t *buf, size_t size)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < size) {
+        ret = read (fd, buf + done, size - done);
+        if (ret <= 0)
+            return -1;
+        done += ret;
+    }
+    return 0;
+}
+
+/*
+ * Serve one request on a connected socket. Data connections carry TPM
+ * commands, control connections a command code and a small payload that
+ * arrives in one piece. Returns -1 when the client is gone.
+ */
+static int
+serve (int fd, int is_ctrl)
+{
+    uint8_t buf[4096];
+    uint32_t size;
+    ssize_t ret;
+
+    if (is_ctrl) {
+        static const uint8_t ok[4] = { 0 };
+        ret = read (fd, buf, sizeof (buf));
+        if (ret <= 0)
+            return -1;
+        return write (fd, ok, sizeof (ok)) == sizeof (ok) ? 0 : -1;
+    }
+    if (read_all (fd, buf, 10) != 0)
+        return -1;
+    size = (uint32_t)buf[2] << 24 | buf[3] << 16 | buf[4] << 8 | buf[5];
+    if (size < 10 || size > sizeof (buf) ||
+        read_all (fd, buf + 10, size - 10) != 0)
+        return -1;
+    return write (fd, rsp, sizeof (rsp)) == sizeof (rsp) ? 0 : -1;
+}
+
+static void
+stand_in (int data_fd, int ctrl_fd)
+{
+    struct pollfd fds[2 + MAX_CLIENTS];
+    int is_ctrl[2 + MAX_CLIENTS];
+    nfds_t nfds = 2;
+
+    fds[0] = (struct pollfd){ .fd = data_fd, .events = POLLIN };
+    fds[1] = (struct pollfd){ .fd = ctrl_fd, .events = POLLIN };
+    for (;;) {
+        if (poll (fds, nfds, -1) < 0)
+            _exit (EXIT_FAILURE);
+        for (nfds_t i = 2; i < nfds; i++) {
+            if (fds[i].revents == 0)
+                continue;
+            if (serve (fds[i].fd, is_ctrl[i]) != 0) {
+                close (fds[i].fd);
+                fds[i] = fds[--nfds];
+                is_ctrl[i] = is_ctrl[nfds];
+                i--;
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!(fds[i].revents & POLLIN) || nfds == 2 + MAX_CLIENTS)
+                continue;
+            fds[nfds] = (struct pollfd){
+                .fd = accept (fds[i].fd, NULL, NULL), .events = POLLIN };
+            is_ctrl[nfds] = i;
+            if (fds[nfds].fd >= 0)
+                nfds++;
+        }
+    }
+}
+
+static pid_t
+start_stand_in (uint16_t *port)
+{
+    int data_fd = -1, ctrl_fd = -1;
+    pid_t pid;
+
+    /* swtpm uses two consecutive ports, the second for the control channel */
+    for (*port = BASE_PORT; *port < BASE_PORT + 200; *port += 2) {
+        data_fd = listen_on (*port);
+        ctrl_fd = listen_on (*port + 1);
+        if (data_fd >= 0 && ctrl_fd >= 0)
+            break;
+        if (data_fd >= 0)
+            close (data_fd);
+        if (ctrl_fd >= 0)
+            close (ctrl_fd);
+        data_fd = ctrl_fd = -1;
+    }
+    if (data_fd < 0)
+        fail ("listen");
+
+    pid = fork ();
+    if (pid < 0)
+        fail ("fork");
+    if (pid == 0)
+        stand_in (data_fd, ctrl_fd);
+    close (data_fd);
+    close (ctrl_fd);
+    return pid;
+}
+
+static double
+elapsed_ns (const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static double
+bench_round_trip (uint16_t port, int keepalive)
+{
+    struct timespec start, end;
+    TSS2_TCTI_CONTEXT *ctx;
+    uint8_t buf[sizeof (rsp)];
+    char conf[64];
+    size_t size;
+
+    snprintf (conf, sizeof (conf), "host=127.0.0.1,port=%u,keepalive=%d",
+              port, keepalive);
+    if (Tss2_Tcti_Swtpm_Init (NULL, &size, NULL) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Swtpm_Init");
+    ctx = calloc (1, size);
+    if (ctx == NULL)
+        fail ("calloc");
+    if (Tss2_Tcti_Swtpm_Init (ctx, &size, conf) != TSS2_RC_SUCCESS)
+        fail ("Tss2_Tcti_Swtpm_Init");
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        size = sizeof (buf);
+        if (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd) != TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Transmit");
+        if (Tss2_Tcti_Receive (ctx, &size, buf, TSS2_TCTI_TIMEOUT_BLOCK) !=
+            TSS2_RC_SUCCESS)
+            fail ("Tss2_Tcti_Receive");
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+    return elapsed_ns (&start, &end) / BENCH_ROUNDS;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    double keepalive_ns, reconnect_ns;
+    uint16_t port;
+    pid_t pid;
+
+    pid = start_stand_in (&port);
+    keepalive_ns = bench_round_trip (port, 1);
+    reconnect_ns = bench_round_trip (port, 0);
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+
+    printf ("swtpm round trip: %.1f us with keepalive, %.1f us with a "
+            "reconnect per command\n", keepalive_ns / 1000,
+            reconnect_ns / 1000);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+#include "tss2_sys.h"
+
+#include "test-fapi.h"
+#include "fapi_util.h"
+#include "fapi_int.h"
+
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+#define SIGN_TEMPLATE  "sign,noDa"
+#define PARENT_TEMPLATE "restricted,decrypt,noDa"
+#define NUM_KEYS 4
+#define SIGN_ROUNDS 5
+
+/* Sign with all keys of the working set in turn and verify the signatures. */
+static TSS2_RC
+sign_verify_loop(FAPI_CONTEXT *context, const char *sigscheme)
+{
+    TSS2_RC r;
+    uint8_t *signature = NULL;
+    size_t signatureSize = 0;
+    char path[64];
+
+    for (int i = 0; i < SIGN_ROUNDS; i++) {
+        for (int k = 0; k < NUM_KEYS; k++) {
+            snprintf(path, sizeof(path), "HS/SRK/myParent/mySignKey%d", k);
+            r = Fapi_Sign(context, path, sigscheme,
+                          &test_fapi_digest.buffer[0], test_fapi_digest.size,
+                          &signature, &signatureSize, NULL, NULL);
+            return_if_error(r, "Error Fapi_Sign");
+
+            r = Fapi_VerifySignature(context, path, &test_fapi_digest.buffer[0],
+                                     test_fapi_digest.size, signature,
+                                     signatureSize);
+            SAFE_FREE(signature);
+            return_if_error(r, "Error Fapi_VerifySignature");
+        }
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+/** Test the keys kept resident in the TPM across FAPI commands.
+ *
+ * Signing keys below an intermediate parent are used round robin. The
+ * working set is larger than the number of transient slots used for
+ * resident keys, so keys are evicted with ContextSave and restored with
+ * ContextLoad. It is checked that no more than the configured number of
+ * slots is used, that resident keys are kept across commands and that a
+ * resident key which was removed from the TPM behind the back of FAPI is
+ * loaded again.
+ *
+ * Tested FAPI commands:
+ *  - Fapi_Provision()
+ *  - Fapi_CreateKey()
+ *  - Fapi_Sign()
+ *  - Fapi_VerifySignature()
+ *  - Fapi_Delete()
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @retval EXIT_FAILURE
+ * @retval EXIT_SUCCESS
+ */
+int
+test_fapi_key_cache(FAPI_CONTEXT *context)
+{
+    TSS2_RC r;
+    char *sigscheme = NULL;
+    char path[64];
+    UINT32 count;
+    TPM2_HANDLE tpm_handle;
+    TSS2_SYS_CONTEXT *sys;
+    IFAPI_KEY_CACHE_ENTRY *entry = NULL;
+    size_t evicted = 0;
+
+    if (strcmp("P_ECC", fapi_profile) != 0)
+        sigscheme = "RSA_PSS";
+
+    r = Fapi_Provision(context, NULL, NULL, NULL);
+    goto_if_error(r, "Error Fapi_Provision", error);
+
+    r = Fapi_CreateKey(context, "HS/SRK/myParent", PARENT_TEMPLATE, "", "");
+    goto_if_error(r, "Error Fapi_CreateKey", error);
+
+    for (int k = 0; k < NUM_KEYS; k++) {
+        snprintf(path, sizeof(path), "HS/SRK/myParent/mySignKey%d", k);
+        r = Fapi_CreateKey(context, path, SIGN_TEMPLATE, "", "");
+        goto_if_error(r, "Error Fapi_CreateKey", error);
+    }
+
+    /* Load the whole parent chain for every command. */
+    ifapi_key_cache_flush(context);
+    context->config.key_cache_size = 0;
+
+    r = sign_verify_loop(context, sigscheme);
+    goto_if_error(r, "Sign without key cache", error);
+
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count > 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects loaded",
+                   error, count);
+    }
+
+    /* Keep the parent and the signing keys resident. */
+    context->config.key_cache_size = NUM_KEYS + 1;
+    context->config.key_cache_slots = 2;
+
+    r = sign_verify_loop(context, sigscheme);
+    goto_if_error(r, "Sign with key cache", error);
+
+    /* The SRK and at most key_cache_slots resident keys are loaded. */
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count > 1 + context->config.key_cache_slots) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects loaded",
+                   error, count);
+    }
+    if (context->key_cache.loaded > context->config.key_cache_slots) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%zu resident keys loaded",
+                   error, context->key_cache.loaded);
+    }
+
+    /* The working set does not fit into the slots, so keys were evicted. */
+    for (size_t i = 0; i < context->key_cache.size; i++) {
+        if (context->key_cache.entries[i].name.size &&
+            context->key_cache.entries[i].handle == ESYS_TR_NONE)
+            evicted += 1;
+    }
+    if (evicted == 0) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "No resident key evicted",
+                   error);
+    }
+
+    /* Remove a loaded resident key from the TPM as another application
+       would do. */
+    for (size_t i = 0; i < context->key_cache.size; i++) {
+        if (context->key_cache.entries[i].name.size &&
+            context->key_cache.entries[i].handle != ESYS_TR_NONE) {
+            entry = &context->key_cache.entries[i];
+            break;
+        }
+    }
+    if (!entry) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "No resident key", error);
+    }
+
+    r = Esys_TR_GetTpmHandle(context->esys, entry->handle, &tpm_handle);
+    goto_if_error(r, "Get TPM handle", error);
+
+    r = Esys_GetSysContext(context->esys, &sys);
+    goto_if_error(r, "Get SYS context", error);
+
+    r = Tss2_Sys_FlushContext(sys, tpm_handle);
+    goto_if_error(r, "Flush resident key", error);
+
+    r = sign_verify_loop(context, sigscheme);
+    goto_if_error(r, "Sign with removed key", error);
+
+    r = Fapi_Delete(context, "/");
+    goto_if_error(r, "Error Fapi_Delete", error);
+
+    /* Deleting the keystore releases all resident keys. */
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count > 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects loaded",
+                   error, count);
+    }
+
+    ifapi_primary_cache_flush(context);
+    return EXIT_SUCCESS;
+
+error:
+    Fapi_Delete(context, "/");
+    return EXIT_FAILURE;
+}
+
+int
+test_invoke_fapi(FAPI_CONTEXT *fapi_context)
+{
+    return test_fapi_key_cache(fapi_context);
+}
@@ -70,6 +70,7 @@ auth_callback(
  *  - Fapi_VerifySignature()
  *  - Fapi_SetCertificate()
  *  - Fapi_List()
+ *  - Fapi_ListNext()
  *  - Fapi_ChangeAuth()
  *  - Fapi_Delete()
  *
@@ -111,6 +112,10 @@ test_fapi_key_create_sign(FAPI_CONTEXT *context)
     uint8_t       *privateblob = NULL;
     char          *policy = NULL;
     char          *path_list = NULL;
+    char          *page = NULL;
+    char          *cursor = NULL;
+    char          *next_cursor = NULL;
+    size_t         num_paths, num_listed = 0;
     size_t         publicsize;
     size_t         privatesize;
     json_object   *jso = NULL;
@@ -205,6 +210,28 @@ test_fapi_key_create_sign(FAPI_CONTEXT *context)
 
     fprintf(stderr, "\nPathList:\n%s\n", path_list);
 
+    /* Listing page by page has to find the same number of objects. */
+    num_paths = 1;
+    for (size_t i = 0; path_list[i]; i++) {
+        if (path_list[i] == ':')
+            num_paths += 1;
+    }
+    do {
+        r = Fapi_ListNext(context, "/", cursor, 2, &page, &next_cursor);
+        goto_if_error(r, "Error Fapi_ListNext", error);
+        if (strlen(page) > 0) {
+            num_listed += 1;
+            for (size_t i = 0; page[i]; i++) {
+                if (page[i] == ':')
+                    num_listed += 1;
+            }
+        }
+        SAFE_FREE(page);
+        SAFE_FREE(cursor);
+        cursor = next_cursor;
+    } while (cursor);
+    assert(num_listed == num_paths);
+
     /* We need to reset the passwords again, in order to not brick physical TPMs */
     r = Fapi_ChangeAuth(context, "/HS", NULL);
     goto_if_error(r, "Error Fapi_ChangeAuth", error);
@@ -243,6 +270,8 @@ error:
         json_object_put(jso);
     Fapi_Delete(context, "/");
     SAFE_FREE(path_list);
+    SAFE_FREE(page);
+    SAFE_FREE(cursor);
     SAFE_FREE(publicblob);
     SAFE_FREE(privateblob);
     SAFE_FREE(policy);
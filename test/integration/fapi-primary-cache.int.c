@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+#include "tss2_sys.h"
+
+#include "test-fapi.h"
+#include "fapi_util.h"
+#include "fapi_int.h"
+
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+#define SIGN_TEMPLATE  "sign,noDa"
+#define SIGN_COUNT 10
+
+/** Test the cache of primary keys kept loaded across FAPI commands.
+ *
+ * It is checked that no primary stays loaded without the cache, that the
+ * cached primary is reused by back-to-back signing operations and that a
+ * primary which was removed from the TPM behind the back of FAPI is
+ * regenerated.
+ *
+ * Tested FAPI commands:
+ *  - Fapi_Provision()
+ *  - Fapi_CreateKey()
+ *  - Fapi_Sign()
+ *  - Fapi_Delete()
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @retval EXIT_FAILURE
+ * @retval EXIT_SUCCESS
+ */
+int
+test_fapi_primary_cache(FAPI_CONTEXT *context)
+{
+    TSS2_RC r;
+    char *sigscheme = NULL;
+    const char *path = "HS/SRK/mySignKey";
+    UINT32 count;
+    ESYS_TR cached;
+    TPM2_HANDLE tpm_handle;
+    TSS2_SYS_CONTEXT *sys;
+
+    if (strcmp("P_ECC", fapi_profile) != 0)
+        sigscheme = "RSA_PSS";
+
+    r = Fapi_Provision(context, NULL, NULL, NULL);
+    goto_if_error(r, "Error Fapi_Provision", error);
+
+    r = Fapi_CreateKey(context, "HS/SRK/mySignKey", SIGN_TEMPLATE, "", "");
+    goto_if_error(r, "Error Fapi_CreateKey", error);
+
+    /* Regenerate the SRK for every command. */
+    ifapi_primary_cache_flush(context);
+    context->config.primary_cache_size = 0;
+
+    r = sign_loop(context, &path, 1, SIGN_COUNT, sigscheme, NULL);
+    goto_if_error(r, "Sign without cache", error);
+
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count != 0) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects not flushed",
+                   error, count);
+    }
+
+    /* Keep the SRK loaded after the first command. */
+    context->config.primary_cache_size = 1;
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign", error);
+    cached = context->primary_cache.entries[0].handle;
+
+    r = sign_loop(context, &path, 1, SIGN_COUNT, sigscheme, NULL);
+    goto_if_error(r, "Sign with cache", error);
+    if (context->primary_cache.entries[0].handle != cached) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "Cached SRK not reused",
+                   error);
+    }
+
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count != 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects loaded",
+                   error, count);
+    }
+
+    /* Remove the cached SRK from the TPM as a TPM reset would do. */
+    r = Esys_TR_GetTpmHandle(context->esys,
+                             context->primary_cache.entries[0].handle,
+                             &tpm_handle);
+    goto_if_error(r, "Get TPM handle", error);
+
+    r = Esys_GetSysContext(context->esys, &sys);
+    goto_if_error(r, "Get SYS context", error);
+
+    r = Tss2_Sys_FlushContext(sys, tpm_handle);
+    goto_if_error(r, "Flush SRK", error);
+
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign with removed SRK", error);
+
+    r = count_transient(context, &count);
+    goto_if_error(r, "Count transient objects", error);
+    if (count != 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u objects loaded",
+                   error, count);
+    }
+
+    r = Fapi_Delete(context, "/");
+    goto_if_error(r, "Error Fapi_Delete", error);
+
+    ifapi_primary_cache_flush(context);
+    return EXIT_SUCCESS;
+
+error:
+    Fapi_Delete(context, "/");
+    return EXIT_FAILURE;
+}
+
+int
+test_invoke_fapi(FAPI_CONTEXT *fapi_context)
+{
+    return test_fapi_primary_cache(fapi_context);
+}
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "tss2_fapi.h"
+#include "tss2_sys.h"
+
+#include "test-fapi.h"
+#include "fapi_util.h"
+#include "fapi_int.h"
+
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+#define SIGN_TEMPLATE  "sign,noDa"
+#define SIGN_COUNT 10
+
+/* Check the number of sessions loaded between two commands. */
+#define CHECK_SESSIONS(context, expected) \
+    r = count_sessions(context, &count); \
+    goto_if_error(r, "Count sessions", error); \
+    if (count != expected) { \
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "%u sessions loaded", \
+                   error, count); \
+    }
+
+/** Test the pool of salted sessions reused across FAPI commands.
+ *
+ * It is checked that no session stays loaded without the pool, that the
+ * pooled session is reused by back-to-back signing operations, that it is
+ * replaced after the configured number of uses and that the pool recovers
+ * from sessions which were removed from the TPM behind the back of FAPI.
+ *
+ * Tested FAPI commands:
+ *  - Fapi_Provision()
+ *  - Fapi_CreateKey()
+ *  - Fapi_Sign()
+ *  - Fapi_Delete()
+ *
+ * @param[in,out] context The FAPI_CONTEXT.
+ * @retval EXIT_FAILURE
+ * @retval EXIT_SUCCESS
+ */
+int
+test_fapi_session_pool(FAPI_CONTEXT *context)
+{
+    TSS2_RC r;
+    char *sigscheme = NULL;
+    const char *path = "HS/SRK/mySignKey";
+    UINT32 count;
+    TPM2_HANDLE tpm_handle;
+    TSS2_SYS_CONTEXT *sys;
+
+    if (strcmp("P_ECC", fapi_profile) != 0)
+        sigscheme = "RSA_PSS";
+
+    r = Fapi_Provision(context, NULL, NULL, NULL);
+    goto_if_error(r, "Error Fapi_Provision", error);
+
+    r = Fapi_CreateKey(context, "HS/SRK/mySignKey", SIGN_TEMPLATE, "", "");
+    goto_if_error(r, "Error Fapi_CreateKey", error);
+
+    /* Start a new salted session for every command. */
+    ifapi_session_pool_flush(context);
+    context->config.session_pool_size = 0;
+
+    r = sign_loop(context, &path, 1, SIGN_COUNT, sigscheme, NULL);
+    goto_if_error(r, "Sign without session pool", error);
+    CHECK_SESSIONS(context, 0);
+
+    /* Keep the session of the first command open. */
+    context->config.session_pool_size = 1;
+    context->config.session_max_uses = SIGN_COUNT + 2;
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign", error);
+    CHECK_SESSIONS(context, 1);
+
+    r = sign_loop(context, &path, 1, SIGN_COUNT, sigscheme, NULL);
+    goto_if_error(r, "Sign with session pool", error);
+    CHECK_SESSIONS(context, 1);
+    if (context->session_pool.entries[0].uses != SIGN_COUNT + 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "Session was not reused",
+                   error);
+    }
+
+    /* The session reached the maximal number of uses and will be replaced. */
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign", error);
+    CHECK_SESSIONS(context, 0);
+
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign", error);
+    CHECK_SESSIONS(context, 1);
+    if (context->session_pool.entries[0].uses != 1) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "Session was not replaced",
+                   error);
+    }
+
+    /* Remove the pooled session from the TPM. The command using it fails,
+       afterwards new sessions have to be used. */
+    r = Esys_TR_GetTpmHandle(context->esys,
+                             context->session_pool.entries[0].handle,
+                             &tpm_handle);
+    goto_if_error(r, "Get TPM handle", error);
+
+    r = Esys_GetSysContext(context->esys, &sys);
+    goto_if_error(r, "Get SYS context", error);
+
+    r = Tss2_Sys_FlushContext(sys, tpm_handle);
+    goto_if_error(r, "Flush session", error);
+
+    r = sign_digest(context, path, sigscheme);
+    if (r == TSS2_RC_SUCCESS) {
+        goto_error(r, TSS2_FAPI_RC_GENERAL_FAILURE, "Removed session was used",
+                   error);
+    }
+
+    r = sign_digest(context, path, sigscheme);
+    goto_if_error(r, "Error Fapi_Sign after removed session", error);
+    CHECK_SESSIONS(context, 1);
+
+    r = Fapi_Delete(context, "/");
+    goto_if_error(r, "Error Fapi_Delete", error);
+
+    ifapi_session_pool_flush(context);
+    return EXIT_SUCCESS;
+
+error:
+    Fapi_Delete(context, "/");
+    return EXIT_FAILURE;
+}
+
+int
+test_invoke_fapi(FAPI_CONTEXT *fapi_context)
+{
+    return test_fapi_session_pool(fapi_context);
+}
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "tss2_fapi.h"
+
+#include "test-fapi.h"
+#include "fapi_int.h"
+
+#define LOGMODULE test
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/*
+ * Helpers shared by the integration tests and benchmarks of the caches
+ * FAPI keeps across commands (primaries, resident keys and sessions).
+ */
+
+TPM2B_DIGEST test_fapi_digest = {
+    .size = 32,
+    .buffer = {
+        0x67, 0x68, 0x03, 0x3e, 0x21, 0x64, 0x68, 0x24, 0x7b, 0xd0,
+        0x31, 0xa0, 0xa2, 0xd9, 0x87, 0x6d, 0x79, 0x81, 0x8f, 0x8f,
+        0x31, 0xa0, 0xa2, 0xd9, 0x87, 0x6d, 0x79, 0x81, 0x8f, 0x8f,
+        0x67, 0x68
+    }
+};
+
+static TSS2_RC
+count_handles(FAPI_CONTEXT *context, TPM2_HANDLE first, UINT32 *count)
+{
+    TSS2_RC r;
+    TPMS_CAPABILITY_DATA *capabilityData = NULL;
+    TPMI_YES_NO moreData;
+
+    r = Esys_GetCapability(context->esys,
+                           ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                           TPM2_CAP_HANDLES, first,
+                           TPM2_MAX_CAP_HANDLES, &moreData, &capabilityData);
+    return_if_error(r, "GetCapability");
+
+    *count = capabilityData->data.handles.count;
+    free(capabilityData);
+    return TSS2_RC_SUCCESS;
+}
+
+/* Count the transient objects loaded in the TPM. */
+TSS2_RC
+count_transient(FAPI_CONTEXT *context, UINT32 *count)
+{
+    return count_handles(context, TPM2_TRANSIENT_FIRST, count);
+}
+
+/* Count the sessions loaded in the TPM. */
+TSS2_RC
+count_sessions(FAPI_CONTEXT *context, UINT32 *count)
+{
+    return count_handles(context, TPM2_LOADED_SESSION_FIRST, count);
+}
+
+/* Sign test_fapi_digest with the key at path. */
+TSS2_RC
+sign_digest(FAPI_CONTEXT *context, const char *path, const char *sigscheme)
+{
+    TSS2_RC r;
+    uint8_t *signature = NULL;
+    size_t signatureSize = 0;
+
+    r = Fapi_Sign(context, path, sigscheme,
+                  &test_fapi_digest.buffer[0], test_fapi_digest.size,
+                  &signature, &signatureSize, NULL, NULL);
+    SAFE_FREE(signature);
+    return r;
+}
+
+/*
+ * Sign rounds times with all keys in paths in turn. If ms is not NULL, the
+ * time needed is returned in milliseconds.
+ */
+TSS2_RC
+sign_loop(FAPI_CONTEXT *context, const char **paths, size_t num_paths,
+          size_t rounds, const char *sigscheme, double *ms)
+{
+    TSS2_RC r;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < rounds; i++) {
+        for (size_t k = 0; k < num_paths; k++) {
+            r = sign_digest(context, paths[k], sigscheme);
+            return_if_error(r, "Error Fapi_Sign");
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (ms) {
+        *ms = (end.tv_sec - start.tv_sec) * 1e3 +
+            (end.tv_nsec - start.tv_nsec) / 1e6;
+    }
+    return TSS2_RC_SUCCESS;
+}
@@ -6,6 +6,7 @@
  * All rights reserved.
  ***********************************************************************/
 #include "tss2_fapi.h"
+#include "tss2_tpm2_types.h"
 
 #define EXIT_SKIP 77
 #define EXIT_ERROR 99
@@ -24,6 +25,23 @@ extern char *fapi_profile;
 
 TSS2_RC
 pcr_reset(FAPI_CONTEXT *context, UINT32 pcr);
+
+/* Helpers of the cache tests, see test-fapi.c */
+extern TPM2B_DIGEST test_fapi_digest;
+
+TSS2_RC
+count_transient(FAPI_CONTEXT *context, UINT32 *count);
+
+TSS2_RC
+count_sessions(FAPI_CONTEXT *context, UINT32 *count);
+
+TSS2_RC
+sign_digest(FAPI_CONTEXT *context, const char *path, const char *sigscheme);
+
+TSS2_RC
+sign_loop(FAPI_CONTEXT *context, const char **paths, size_t num_paths,
+          size_t rounds, const char *sigscheme, double *ms);
+
 /*
  * This is the prototype for all integration tests in the tpm2-tss
  * project. Integration tests are intended to exercise the combined
@@ -138,6 +138,252 @@ check_hmac_functions(void **state)
     iesys_crypto_hash_abort(&context);
 }
 
+/* The crypto operations of a command with one HMAC session */
+static void
+session_command(IESYS_CRYPTO_POOL **pool, TPM2B_AUTH *cmd_hmac,
+                TPM2B_AUTH *rsp_hmac)
+{
+    TSS2_RC rc;
+    uint8_t key[32] = { 1, 2, 3 };
+    uint8_t cc[4] = { 0x00, 0x00, 0x01, 0x7b };
+    uint8_t rc_buffer[4] = { 0 };
+    uint8_t parameters[64] = { 4, 5, 6 };
+    TPM2B_NAME name = { .size = 4, .name = { 0x40, 0x00, 0x00, 0x01 } };
+    TPM2B_NONCE nonce_caller = { .size = 32, .buffer = { 7 } };
+    TPM2B_NONCE nonce_tpm = { .size = 32, .buffer = { 8 } };
+    uint8_t digest[sizeof(TPMU_HA)];
+    size_t digest_size = sizeof(digest);
+
+    rc = iesys_crypto_cpHash(pool, TPM2_ALG_SHA256, cc, &name, NULL, NULL,
+                             parameters, sizeof(parameters),
+                             digest, &digest_size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    cmd_hmac->size = sizeof(TPMU_HA);
+    rc = iesys_crypto_authHmac(pool, TPM2_ALG_SHA256, key, sizeof(key),
+                               digest, digest_size, &nonce_caller, &nonce_tpm,
+                               NULL, NULL, TPMA_SESSION_CONTINUESESSION,
+                               cmd_hmac);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    digest_size = sizeof(digest);
+    rc = iesys_crypto_rpHash(pool, TPM2_ALG_SHA256, rc_buffer, cc,
+                             parameters, sizeof(parameters),
+                             digest, &digest_size);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rsp_hmac->size = sizeof(TPMU_HA);
+    rc = iesys_crypto_authHmac(pool, TPM2_ALG_SHA256, key, sizeof(key),
+                               digest, digest_size, &nonce_tpm, &nonce_caller,
+                               NULL, NULL, TPMA_SESSION_CONTINUESESSION,
+                               rsp_hmac);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+
+/*
+ * Check the crypto operations of a command with an HMAC session with a pool
+ * of reusable contexts against the computation without a pool.
+ */
+static void
+check_pool(void **state)
+{
+    IESYS_CRYPTO_POOL *pool = NULL;
+    TPM2B_AUTH cmd_hmac, rsp_hmac, cmd_hmac_pooled, rsp_hmac_pooled;
+
+    /* The pooled contexts are reused and compute the same values. */
+    session_command(NULL, &cmd_hmac, &rsp_hmac);
+    for (size_t i = 0; i < 3; i++) {
+        session_command(&pool, &cmd_hmac_pooled, &rsp_hmac_pooled);
+        assert_int_equal (cmd_hmac.size, cmd_hmac_pooled.size);
+        assert_memory_equal (cmd_hmac.buffer, cmd_hmac_pooled.buffer,
+                             cmd_hmac.size);
+        assert_int_equal (rsp_hmac.size, rsp_hmac_pooled.size);
+        assert_memory_equal (rsp_hmac.buffer, rsp_hmac_pooled.buffer,
+                             rsp_hmac.size);
+    }
+
+    iesys_crypto_pool_free(&pool);
+    assert_null (pool);
+    iesys_crypto_pool_free(&pool);
+}
+
+/* XOR obfuscation with one KDFa iteration, and one keying, per digest */
+static void
+xor_reference(IESYS_CRYPTO_POOL **pool, TPM2_ALG_ID hash_alg,
+              uint8_t *key, size_t key_size, TPM2B_NONCE *contextU,
+              TPM2B_NONCE *contextV, BYTE *data, size_t data_size)
+{
+    TSS2_RC rc;
+    BYTE block[sizeof(TPMU_HA)];
+    size_t digest_size;
+    uint32_t bit_size = data_size * 8;
+
+    for (uint32_t counter = 1; data_size > 0; counter++) {
+        digest_size = sizeof(block);
+        rc = iesys_crypto_KDFaHmac(pool, hash_alg, key, key_size, counter,
+                                   "XOR", contextU, contextV, bit_size,
+                                   block, &digest_size);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        for (size_t i = 0; i < digest_size && data_size > 0; i++, data_size--)
+            *data++ ^= block[i];
+    }
+}
+
+/*
+ * Check KDFa and XOR parameter obfuscation against one KDFa iteration per
+ * digest.
+ */
+static void
+check_kdfa_xor(void **state)
+{
+    TSS2_RC rc;
+    IESYS_CRYPTO_POOL *pool = NULL, *empty_pool = NULL;
+    uint8_t key[64] = { 1, 2, 3 };
+    TPM2B_NONCE contextU = { .size = 32, .buffer = { 7 } };
+    TPM2B_NONCE contextV = { .size = 32, .buffer = { 8 } };
+    static const size_t sizes[] = { 1, 31, 32, 33, 256, 1024, 2048 };
+    static const TPM2_ALG_ID algs[] = { TPM2_ALG_SHA1, TPM2_ALG_SHA256,
+                                        TPM2_ALG_SHA384 };
+    BYTE data[2048], expected[2048];
+    BYTE out[3 * sizeof(TPMU_HA)], out_expected[sizeof(out)];
+    size_t digest_size;
+    uint32_t counter = 0;
+
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    for (size_t a = 0; a < sizeof(algs) / sizeof(algs[0]); a++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            memcpy(expected, data, sizes[s]);
+            xor_reference(NULL, algs[a], key, sizeof(key), &contextU,
+                          &contextV, expected, sizes[s]);
+            rc = iesys_xor_parameter_obfuscation(&pool, algs[a], key,
+                                                 sizeof(key), &contextU,
+                                                 &contextV, data, sizes[s]);
+            assert_int_equal (rc, TSS2_RC_SUCCESS);
+            assert_memory_equal (data, expected, sizes[s]);
+            /* The obfuscation is its own inverse. */
+            rc = iesys_xor_parameter_obfuscation(NULL, algs[a], key,
+                                                 sizeof(key), &contextU,
+                                                 &contextV, data, sizes[s]);
+            assert_int_equal (rc, TSS2_RC_SUCCESS);
+            for (size_t i = 0; i < sizes[s]; i++)
+                assert_int_equal (data[i], (BYTE) i);
+        }
+    }
+
+    /* KDFa of three digests, continuing from counter 1 */
+    counter = 1;
+    rc = iesys_crypto_KDFa(&pool, TPM2_ALG_SHA256, key, sizeof(key), "CFB",
+                           &contextU, &contextV, 3 * 32 * 8 - 3, &counter,
+                           out, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (counter, 4);
+    for (uint32_t i = 0; i < 3; i++) {
+        digest_size = 32;
+        rc = iesys_crypto_KDFaHmac(NULL, TPM2_ALG_SHA256, key, sizeof(key),
+                                   i + 2, "CFB", &contextU, &contextV,
+                                   3 * 32 * 8 - 3, &out_expected[i * 32],
+                                   &digest_size);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+    }
+    out_expected[0] &= 0x1f;
+    assert_memory_equal (out, out_expected, 3 * 32);
+
+    rc = iesys_xor_parameter_obfuscation(&pool, TPM2_ALG_ERROR, key,
+                                         sizeof(key), &contextU, &contextV,
+                                         data, 32);
+    assert_int_not_equal (rc, TSS2_RC_SUCCESS);
+
+    /* Empty parameters are left alone without keying an HMAC. */
+    rc = iesys_xor_parameter_obfuscation(&empty_pool, TPM2_ALG_SHA256, key,
+                                         sizeof(key), &contextU, &contextV,
+                                         data, 0);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_null (empty_pool);
+    assert_int_equal (data[0], 0);
+
+    iesys_crypto_pool_free(&pool);
+}
+
+/*
+ * Check AES-CFB parameter encryption with the crypto state cached in a
+ * session against the uncached computation.
+ */
+static void
+check_param_aes_cfb(void **state)
+{
+    TSS2_RC rc;
+    IESYS_CRYPTO_POOL *pool = NULL;
+    IESYS_CRYPTO_SESSION_CACHE *cache = NULL;
+    uint8_t key[64] = { 1, 2, 3 };
+    TPM2B_NONCE nonce_caller = { .size = 32, .buffer = { 7 } };
+    TPM2B_NONCE nonce_tpm = { .size = 32, .buffer = { 8 } };
+    static const TPMI_AES_KEY_BITS key_bits[] = { 128, 128, 256, 128 };
+    BYTE data[100], expected[100], plaintext[100];
+
+    for (size_t i = 0; i < sizeof(data); i++)
+        plaintext[i] = i;
+
+    /* Commands with new nonces, a new key and a new AES key size */
+    for (size_t i = 0; i < sizeof(key_bits) / sizeof(key_bits[0]); i++) {
+        nonce_caller.buffer[0] = i;
+        nonce_tpm.buffer[0] = i;
+        key[0] = i / 2;
+
+        memcpy(expected, plaintext, 100);
+        rc = iesys_crypto_param_aes_cfb(NULL, NULL, TPM2_ALG_SHA256, key,
+                                        sizeof(key), &nonce_caller, &nonce_tpm,
+                                        key_bits[i], expected, 100, 1);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        memcpy(data, plaintext, 100);
+        rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA256, key,
+                                        sizeof(key), &nonce_caller, &nonce_tpm,
+                                        key_bits[i], data, 100, 1);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_non_null (cache);
+        assert_memory_equal (data, expected, 100);
+        assert_memory_not_equal (data, plaintext, 100);
+
+        rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA256, key,
+                                        sizeof(key), &nonce_caller, &nonce_tpm,
+                                        key_bits[i], data, 100, 0);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_memory_equal (data, plaintext, 100);
+    }
+
+    /* A new hash algorithm keys the HMAC of KDFa again. */
+    memcpy(expected, plaintext, 100);
+    rc = iesys_crypto_param_aes_cfb(NULL, NULL, TPM2_ALG_SHA1, key, 20,
+                                    &nonce_caller, &nonce_tpm, 128, expected,
+                                    100, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    memcpy(data, plaintext, 100);
+    rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA1, key, 20,
+                                    &nonce_caller, &nonce_tpm, 128, data, 100,
+                                    1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_memory_equal (data, expected, 100);
+
+    rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA256, key,
+                                    sizeof(key), &nonce_caller, &nonce_tpm,
+                                    512, data, 100, 1);
+    assert_int_equal (rc, TSS2_ESYS_RC_BAD_VALUE);
+    rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA256, key,
+                                    sizeof(key), &nonce_caller, &nonce_tpm,
+                                    192 + 1, data, 100, 1);
+    assert_int_not_equal (rc, TSS2_RC_SUCCESS);
+    rc = iesys_crypto_param_aes_cfb(&pool, &cache, TPM2_ALG_SHA256, NULL,
+                                    sizeof(key), &nonce_caller, &nonce_tpm,
+                                    128, data, 100, 1);
+    assert_int_equal (rc, TSS2_ESYS_RC_BAD_REFERENCE);
+
+    iesys_crypto_session_cache_free(&cache);
+    assert_null (cache);
+    iesys_crypto_session_cache_free(&cache);
+    iesys_crypto_pool_free(&pool);
+}
+
 static void
 check_random(void **state)
 {
@@ -281,6 +527,9 @@ main(int argc, char *argv[])
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(check_hash_functions),
         cmocka_unit_test(check_hmac_functions),
+        cmocka_unit_test(check_pool),
+        cmocka_unit_test(check_kdfa_xor),
+        cmocka_unit_test(check_param_aes_cfb),
         cmocka_unit_test(check_random),
         cmocka_unit_test(check_pk_encrypt),
         cmocka_unit_test(check_aes_encrypt),
@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+
+#include "tss2-esys/esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+#include "util/aux_util.h"
+
+/**
+ * This unit test checks the metrics recorded by the ESAPI if enabled with
+ * Esys_SetMetrics(). A TCTI answers TPM2_GetRandom with TPM_RC_YIELDED for
+ * a configurable number of times before it returns random bytes.
+ */
+
+#define TCTI_METRICS_MAGIC 0x4d4554524943530aULL        /* 'METRICS\n' */
+#define TCTI_METRICS_VERSION 0x1
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    TSS2_TCTI_TRANSMIT_FCN transmit;
+    TSS2_TCTI_RECEIVE_FCN receive;
+     TSS2_RC(*finalize) (TSS2_TCTI_CONTEXT * tctiContext);
+     TSS2_RC(*cancel) (TSS2_TCTI_CONTEXT * tctiContext);
+     TSS2_RC(*getPollHandles) (TSS2_TCTI_CONTEXT * tctiContext,
+                               TSS2_TCTI_POLL_HANDLE * handles,
+                               size_t * num_handles);
+     TSS2_RC(*setLocality) (TSS2_TCTI_CONTEXT * tctiContext, uint8_t locality);
+    uint32_t yields;
+} TSS2_TCTI_CONTEXT_METRICS;
+
+static TSS2_RC
+tcti_metrics_transmit(TSS2_TCTI_CONTEXT * tctiContext,
+                      size_t size, const uint8_t * buffer)
+{
+    return TSS2_RC_SUCCESS;
+}
+
+const uint8_t yielded_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x0A,     /* Response Size 10 */
+    0x00, 0x00, 0x09, 0x08      /* TPM_RC_YIELDED */
+};
+
+const uint8_t random_response[] = {
+    0x80, 0x01,                 /* TPM_ST_NO_SESSION */
+    0x00, 0x00, 0x00, 0x10,     /* Response Size 16 */
+    0x00, 0x00, 0x00, 0x00,     /* TPM_RC_SUCCESS */
+    0x00, 0x04,                 /* TPM2B_DIGEST size */
+    0x01, 0x02, 0x03, 0x04
+};
+
+static TSS2_RC
+tcti_metrics_receive(TSS2_TCTI_CONTEXT * tctiContext,
+                     size_t * response_size,
+                     uint8_t * response_buffer, int32_t timeout)
+{
+    TSS2_TCTI_CONTEXT_METRICS *tcti = (TSS2_TCTI_CONTEXT_METRICS *) tctiContext;
+    const uint8_t *response = &random_response[0];
+
+    *response_size = sizeof(random_response);
+    if (tcti->yields) {
+        response = &yielded_response[0];
+        *response_size = sizeof(yielded_response);
+    }
+    if (response_buffer != NULL) {
+        memcpy(response_buffer, response, *response_size);
+        if (tcti->yields)
+            tcti->yields -= 1;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+static void
+tcti_metrics_finalize(TSS2_TCTI_CONTEXT * tctiContext)
+{
+    memset(tctiContext, 0, sizeof(TSS2_TCTI_CONTEXT_METRICS));
+}
+
+static TSS2_RC
+tcti_metrics_initialize(TSS2_TCTI_CONTEXT * tctiContext)
+{
+    memset(tctiContext, 0, sizeof(TSS2_TCTI_CONTEXT_METRICS));
+    TSS2_TCTI_MAGIC(tctiContext) = TCTI_METRICS_MAGIC;
+    TSS2_TCTI_VERSION(tctiContext) = TCTI_METRICS_VERSION;
+    TSS2_TCTI_TRANSMIT(tctiContext) = tcti_metrics_transmit;
+    TSS2_TCTI_RECEIVE(tctiContext) = tcti_metrics_receive;
+    TSS2_TCTI_FINALIZE(tctiContext) = tcti_metrics_finalize;
+    TSS2_TCTI_CANCEL(tctiContext) = NULL;
+    TSS2_TCTI_GET_POLL_HANDLES(tctiContext) = NULL;
+    TSS2_TCTI_SET_LOCALITY(tctiContext) = NULL;
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+setup(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *ectx;
+    TSS2_TCTI_CONTEXT *tcti = malloc(sizeof(TSS2_TCTI_CONTEXT_METRICS));
+
+    if (!tcti)
+        return -1;
+    r = tcti_metrics_initialize(tcti);
+    if (r)
+        return (int)r;
+    r = Esys_Initialize(&ectx, tcti, NULL);
+    if (r)
+        return (int)r;
+    *state = (void *)ectx;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    TSS2_TCTI_CONTEXT *tcti;
+    ESYS_CONTEXT *ectx = (ESYS_CONTEXT *) * state;
+
+    Esys_GetTcti(ectx, &tcti);
+    Esys_Finalize(&ectx);
+    free(tcti);
+    return 0;
+}
+
+static UINT64
+histogram_sum(const UINT64 *histogram)
+{
+    UINT64 sum = 0;
+
+    for (int i = 0; i < ESYS_METRICS_BUCKETS; i++)
+        sum += histogram[i];
+    return sum;
+}
+
+static void
+test_metrics_disabled(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    ESYS_METRICS *metrics = NULL;
+    TPM2B_DIGEST *randomBytes = NULL;
+
+    r = Esys_GetRandom(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                       4, &randomBytes);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(randomBytes);
+
+    r = Esys_GetMetrics(esys_context, &metrics);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_SEQUENCE);
+    assert_null(metrics);
+
+    r = Esys_GetMetrics(esys_context, NULL);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_REFERENCE);
+}
+
+static void
+test_metrics_getrandom(void **state)
+{
+    TSS2_RC r;
+    ESYS_CONTEXT *esys_context = (ESYS_CONTEXT *) * state;
+    TSS2_TCTI_CONTEXT *tcti;
+    ESYS_METRICS *metrics = NULL;
+    ESYS_COMMAND_METRICS *cmd;
+    TPM2B_DIGEST *randomBytes = NULL;
+
+    r = Esys_SetMetrics(esys_context, TPM2_YES);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Two resubmissions before the TPM returns the random bytes. */
+    r = Esys_GetTcti(esys_context, &tcti);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    ((TSS2_TCTI_CONTEXT_METRICS *) tcti)->yields = 2;
+
+    r = Esys_GetRandom(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                       4, &randomBytes);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(randomBytes);
+
+    r = Esys_GetRandom(esys_context, ESYS_TR_NONE, ESYS_TR_NONE, ESYS_TR_NONE,
+                       4, &randomBytes);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(randomBytes);
+
+    r = Esys_GetMetrics(esys_context, &metrics);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(metrics->count, 1);
+
+    cmd = &metrics->commands[0];
+    assert_int_equal(cmd->commandCode, TPM2_CC_GetRandom);
+    assert_int_equal(cmd->calls, 2);
+    assert_int_equal(cmd->resubmissions, 2);
+    /* 4 submissions of a 12 byte command */
+    assert_int_equal(cmd->bytesSent, 4 * 12);
+    assert_int_equal(cmd->bytesReceived,
+                     2 * sizeof(yielded_response) + 2 * sizeof(random_response));
+    assert_int_equal(histogram_sum(cmd->clientHistogram), 2);
+    assert_int_equal(histogram_sum(cmd->tpmHistogram), 2);
+    Esys_Free(metrics);
+
+    /* Enabling the metrics again resets the recorded values. */
+    r = Esys_SetMetrics(esys_context, TPM2_YES);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = Esys_GetMetrics(esys_context, &metrics);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(metrics->count, 0);
+    Esys_Free(metrics);
+
+    r = Esys_SetMetrics(esys_context, TPM2_NO);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_metrics_disabled, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_metrics_getrandom, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
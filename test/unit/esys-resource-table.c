@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_esys.h"
+
+#include "esys_iutil.h"
+#define LOGMODULE tests
+#include "util/log.h"
+
+/**
+ * Tests for the hash table which stores the ESYS_TR objects of an
+ * ESYS_CONTEXT. The table is exercised with an increasing number of objects
+ * to cover growing as well as deletion with shifting of probe sequences.
+ */
+
+static const size_t object_counts[] = { 1, 12, 13, 100, 1000, 10000 };
+
+static int
+setup(void **state)
+{
+    *state = calloc(1, sizeof(ESYS_CONTEXT));
+    return *state == NULL;
+}
+
+static int
+teardown(void **state)
+{
+    ESYS_CONTEXT *ectx = *state;
+
+    iesys_DeleteAllResourceObjects(ectx);
+    assert_null(ectx->rsrc_table.slots);
+    assert_int_equal(ectx->rsrc_table.count, 0);
+    free(ectx);
+    return 0;
+}
+
+static void
+create_objects(ESYS_CONTEXT *ectx, ESYS_TR first, size_t count)
+{
+    RSRC_NODE_T *node;
+    TSS2_RC r;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        r = esys_CreateResourceObject(ectx, first + i, &node);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        node->rsrc.handle = first + i;
+    }
+}
+
+static void
+check_objects(ESYS_CONTEXT *ectx, ESYS_TR first, size_t count, size_t step)
+{
+    RSRC_NODE_T *node;
+    TSS2_RC r;
+    size_t i;
+
+    for (i = 0; i < count; i += step) {
+        r = esys_GetResourceObject(ectx, first + i, &node);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(node->esys_handle, first + i);
+        assert_int_equal(node->rsrc.handle, first + i);
+    }
+}
+
+static void
+test_create_get(void **state)
+{
+    ESYS_CONTEXT *ectx = *state;
+    ESYS_TR first = ESYS_TR_MIN_OBJECT + 4711;
+    RSRC_NODE_T *node;
+    size_t n;
+    TSS2_RC r;
+
+    for (n = 0; n < sizeof(object_counts) / sizeof(object_counts[0]); n++) {
+        create_objects(ectx, first, object_counts[n]);
+        assert_int_equal(ectx->rsrc_table.count, object_counts[n]);
+        assert_true(ectx->rsrc_table.count * 4 <= ectx->rsrc_table.size * 3);
+        check_objects(ectx, first, object_counts[n], 1);
+
+        r = esys_GetResourceObject(ectx, first + object_counts[n], &node);
+        assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+
+        iesys_DeleteAllResourceObjects(ectx);
+    }
+}
+
+static void
+test_duplicate(void **state)
+{
+    ESYS_CONTEXT *ectx = *state;
+    RSRC_NODE_T *node;
+    TSS2_RC r;
+
+    create_objects(ectx, ESYS_TR_MIN_OBJECT, 1);
+    r = esys_CreateResourceObject(ectx, ESYS_TR_MIN_OBJECT, &node);
+    assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+    assert_int_equal(ectx->rsrc_table.count, 1);
+}
+
+static void
+test_close(void **state)
+{
+    ESYS_CONTEXT *ectx = *state;
+    ESYS_TR first = ESYS_TR_MIN_OBJECT + 123;
+    ESYS_TR handle;
+    RSRC_NODE_T *node;
+    size_t n, i;
+    TSS2_RC r;
+
+    for (n = 0; n < sizeof(object_counts) / sizeof(object_counts[0]); n++) {
+        create_objects(ectx, first, object_counts[n]);
+
+        /* Close every second object, the others must stay reachable. */
+        for (i = 0; i < object_counts[n]; i += 2) {
+            handle = first + i;
+            r = Esys_TR_Close(ectx, &handle);
+            assert_int_equal(r, TSS2_RC_SUCCESS);
+            assert_int_equal(handle, ESYS_TR_NONE);
+        }
+        assert_int_equal(ectx->rsrc_table.count, object_counts[n] / 2);
+        check_objects(ectx, first + 1, object_counts[n] - 1, 2);
+
+        for (i = 0; i < object_counts[n]; i += 2) {
+            r = esys_GetResourceObject(ectx, first + i, &node);
+            assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+            handle = first + i;
+            r = Esys_TR_Close(ectx, &handle);
+            assert_int_equal(r, TSS2_ESYS_RC_BAD_TR);
+        }
+
+        /* Close the remaining objects. */
+        for (i = 1; i < object_counts[n]; i += 2) {
+            handle = first + i;
+            r = Esys_TR_Close(ectx, &handle);
+            assert_int_equal(r, TSS2_RC_SUCCESS);
+        }
+        assert_int_equal(ectx->rsrc_table.count, 0);
+    }
+}
+
+static void
+test_global_objects(void **state)
+{
+    ESYS_CONTEXT *ectx = *state;
+    RSRC_NODE_T *node1, *node2;
+    TSS2_RC r;
+
+    r = esys_GetResourceObject(ectx, ESYS_TR_RH_OWNER, &node1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(node1->rsrc.handle, TPM2_RH_OWNER);
+
+    /* The second lookup returns the object created by the first one. */
+    r = esys_GetResourceObject(ectx, ESYS_TR_RH_OWNER, &node2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(node1, node2);
+    assert_int_equal(ectx->rsrc_table.count, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_create_get, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_duplicate, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_close, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_global_objects, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
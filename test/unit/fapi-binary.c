@@ -0,0 +1,336 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_io.h"
+#include "ifapi_binary.h"
+#include "ifapi_policy_json_serialize.h"
+#include "ifapi_policy_json_deserialize.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the binary encoding of keystore objects. The objects used here
+ * have no policy, the JSON encoding of policies is tested by fapi-json.
+ */
+
+TSS2_RC
+ifapi_json_TPMS_POLICY_serialize(const TPMS_POLICY *in, json_object **jso)
+{
+    return TSS2_FAPI_RC_NOT_IMPLEMENTED;
+}
+
+TSS2_RC
+ifapi_json_TPMS_POLICY_deserialize(json_object *jso, TPMS_POLICY *out)
+{
+    return TSS2_FAPI_RC_NOT_IMPLEMENTED;
+}
+
+/* Reduced copy from ifapi_keystore.c for objects without policy */
+void
+ifapi_cleanup_ifapi_object(IFAPI_OBJECT *object)
+{
+    switch (object->objectType) {
+    case IFAPI_KEY_OBJ:
+        SAFE_FREE(object->misc.key.serialization.buffer);
+        SAFE_FREE(object->misc.key.private.buffer);
+        SAFE_FREE(object->misc.key.appData.buffer);
+        SAFE_FREE(object->misc.key.policyInstance);
+        SAFE_FREE(object->misc.key.description);
+        SAFE_FREE(object->misc.key.certificate);
+        break;
+    case IFAPI_NV_OBJ:
+        SAFE_FREE(object->misc.nv.serialization.buffer);
+        SAFE_FREE(object->misc.nv.appData.buffer);
+        SAFE_FREE(object->misc.nv.policyInstance);
+        SAFE_FREE(object->misc.nv.description);
+        SAFE_FREE(object->misc.nv.event_log);
+        break;
+    case IFAPI_EXT_PUB_KEY_OBJ:
+        SAFE_FREE(object->misc.ext_pub_key.pem_ext_public);
+        SAFE_FREE(object->misc.ext_pub_key.certificate);
+        break;
+    case IFAPI_HIERARCHY_OBJ:
+        SAFE_FREE(object->misc.hierarchy.description);
+        break;
+    }
+    object->objectType = IFAPI_OBJ_NONE;
+}
+
+static uint8_t serialization[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+static uint8_t private[] = { 0x10, 0x20, 0x30 };
+static uint8_t app_data[] = { 0xaa };
+
+static void
+init_key(IFAPI_OBJECT *object, TPMI_ALG_PUBLIC type)
+{
+    IFAPI_KEY *key = &object->misc.key;
+    TPMT_PUBLIC *public = &key->public.publicArea;
+
+    memset(object, 0, sizeof(IFAPI_OBJECT));
+    object->objectType = IFAPI_KEY_OBJ;
+    object->system = TPM2_YES;
+
+    key->persistent_handle = 0x81000001;
+    key->with_auth = TPM2_YES;
+    public->type = type;
+    public->nameAlg = TPM2_ALG_SHA256;
+    public->objectAttributes = TPMA_OBJECT_USERWITHAUTH | TPMA_OBJECT_SIGN_ENCRYPT;
+    public->authPolicy.size = 32;
+    memset(public->authPolicy.buffer, 0x5a, 32);
+    if (type == TPM2_ALG_RSA) {
+        public->parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_NULL;
+        public->parameters.rsaDetail.scheme.scheme = TPM2_ALG_RSASSA;
+        public->parameters.rsaDetail.scheme.details.rsassa.hashAlg = TPM2_ALG_SHA256;
+        public->parameters.rsaDetail.keyBits = 2048;
+        public->unique.rsa.size = 256;
+        memset(public->unique.rsa.buffer, 0xa5, 256);
+        key->signing_scheme.scheme = TPM2_ALG_RSAPSS;
+        key->signing_scheme.details.rsapss.hashAlg = TPM2_ALG_SHA256;
+    } else {
+        public->parameters.keyedHashDetail.scheme.scheme = TPM2_ALG_HMAC;
+        public->parameters.keyedHashDetail.scheme.details.hmac.hashAlg = TPM2_ALG_SHA256;
+        public->unique.keyedHash.size = 32;
+        memset(public->unique.keyedHash.buffer, 0x11, 32);
+    }
+
+    key->serialization.buffer = serialization;
+    key->serialization.size = sizeof(serialization);
+    key->private.buffer = private;
+    key->private.size = sizeof(private);
+    key->appData.buffer = app_data;
+    key->appData.size = sizeof(app_data);
+    key->policyInstance = "";
+    key->description = "Test key";
+    key->certificate = "-----BEGIN CERTIFICATE-----";
+    key->creationTicket.tag = TPM2_ST_CREATION;
+    key->creationTicket.hierarchy = TPM2_RH_OWNER;
+    key->name.size = 34;
+    memset(key->name.name, 0x42, 34);
+    key->reset_count = 7;
+}
+
+static void
+check_key(const IFAPI_OBJECT *in, const IFAPI_OBJECT *out)
+{
+    const IFAPI_KEY *k1 = &in->misc.key;
+    const IFAPI_KEY *k2 = &out->misc.key;
+
+    assert_int_equal(out->objectType, IFAPI_KEY_OBJ);
+    assert_int_equal(out->system, in->system);
+    assert_null(out->policy);
+    assert_int_equal(k2->persistent_handle, k1->persistent_handle);
+    assert_int_equal(k2->with_auth, k1->with_auth);
+    assert_memory_equal(&k2->public.publicArea, &k1->public.publicArea,
+                        sizeof(k1->public.publicArea));
+    assert_int_equal(k2->serialization.size, k1->serialization.size);
+    assert_memory_equal(k2->serialization.buffer, k1->serialization.buffer,
+                        k1->serialization.size);
+    assert_int_equal(k2->private.size, k1->private.size);
+    assert_memory_equal(k2->private.buffer, k1->private.buffer, k1->private.size);
+    assert_int_equal(k2->appData.size, k1->appData.size);
+    assert_memory_equal(k2->appData.buffer, k1->appData.buffer, k1->appData.size);
+    assert_string_equal(k2->policyInstance, k1->policyInstance);
+    assert_string_equal(k2->description, k1->description);
+    assert_string_equal(k2->certificate, k1->certificate);
+    assert_int_equal(k2->creationData.size, 0);
+    assert_memory_equal(&k2->creationTicket, &k1->creationTicket,
+                        sizeof(k1->creationTicket));
+    assert_memory_equal(&k2->signing_scheme, &k1->signing_scheme,
+                        sizeof(k1->signing_scheme));
+    assert_memory_equal(&k2->name, &k1->name, sizeof(k1->name));
+    assert_int_equal(k2->reset_count, k1->reset_count);
+}
+
+static void
+roundtrip(const IFAPI_OBJECT *in, IFAPI_OBJECT *out)
+{
+    TSS2_RC r;
+    uint8_t *buffer = NULL;
+    size_t size;
+
+    assert_true(ifapi_binary_supported(in));
+    r = ifapi_binary_IFAPI_OBJECT_serialize(in, &buffer, &size);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_true(ifapi_binary_is_object(buffer, size));
+
+    r = ifapi_binary_IFAPI_OBJECT_deserialize(buffer, size, out);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    free(buffer);
+}
+
+static void
+check_binary_key(void **state)
+{
+    IFAPI_OBJECT in, out;
+
+    init_key(&in, TPM2_ALG_RSA);
+    roundtrip(&in, &out);
+    check_key(&in, &out);
+    ifapi_cleanup_ifapi_object(&out);
+
+    /* Keyed hash objects are stored without signing scheme. */
+    init_key(&in, TPM2_ALG_KEYEDHASH);
+    in.misc.key.appData.buffer = NULL;
+    in.misc.key.appData.size = 0;
+    in.misc.key.certificate = NULL;
+    roundtrip(&in, &out);
+    assert_null(out.misc.key.appData.buffer);
+    assert_null(out.misc.key.certificate);
+    assert_int_equal(out.misc.key.signing_scheme.scheme, 0);
+    assert_memory_equal(&out.misc.key.public.publicArea,
+                        &in.misc.key.public.publicArea,
+                        sizeof(in.misc.key.public.publicArea));
+    ifapi_cleanup_ifapi_object(&out);
+}
+
+static void
+check_binary_nv(void **state)
+{
+    IFAPI_OBJECT in, out;
+    IFAPI_NV *nv = &in.misc.nv;
+
+    memset(&in, 0, sizeof(in));
+    in.objectType = IFAPI_NV_OBJ;
+    nv->with_auth = TPM2_NO;
+    nv->public.nvPublic.nvIndex = 0x01500000;
+    nv->public.nvPublic.nameAlg = TPM2_ALG_SHA256;
+    nv->public.nvPublic.attributes = TPMA_NV_AUTHREAD | TPMA_NV_AUTHWRITE;
+    nv->public.nvPublic.dataSize = 64;
+    nv->serialization.buffer = serialization;
+    nv->serialization.size = sizeof(serialization);
+    nv->hierarchy = TPM2_RH_OWNER;
+    nv->description = "Test NV";
+    nv->event_log = "[]";
+
+    roundtrip(&in, &out);
+    assert_int_equal(out.objectType, IFAPI_NV_OBJ);
+    assert_int_equal(out.misc.nv.with_auth, TPM2_NO);
+    assert_int_equal(out.misc.nv.public.nvPublic.nvIndex, 0x01500000);
+    assert_int_equal(out.misc.nv.public.nvPublic.attributes,
+                     TPMA_NV_AUTHREAD | TPMA_NV_AUTHWRITE);
+    assert_int_equal(out.misc.nv.public.nvPublic.dataSize, 64);
+    assert_int_equal(out.misc.nv.serialization.size, sizeof(serialization));
+    assert_int_equal(out.misc.nv.hierarchy, TPM2_RH_OWNER);
+    assert_null(out.misc.nv.policyInstance);
+    assert_string_equal(out.misc.nv.description, "Test NV");
+    assert_null(out.misc.nv.appData.buffer);
+    assert_string_equal(out.misc.nv.event_log, "[]");
+    ifapi_cleanup_ifapi_object(&out);
+}
+
+static void
+check_binary_hierarchy(void **state)
+{
+    IFAPI_OBJECT in, out;
+
+    memset(&in, 0, sizeof(in));
+    in.objectType = IFAPI_HIERARCHY_OBJ;
+    in.system = TPM2_YES;
+    in.misc.hierarchy.with_auth = TPM2_YES;
+    in.misc.hierarchy.authPolicy.size = 32;
+    memset(in.misc.hierarchy.authPolicy.buffer, 0x33, 32);
+    in.misc.hierarchy.description = "Owner hierarchy";
+    in.misc.hierarchy.esysHandle = ESYS_TR_RH_OWNER;
+
+    roundtrip(&in, &out);
+    assert_int_equal(out.objectType, IFAPI_HIERARCHY_OBJ);
+    assert_int_equal(out.system, TPM2_YES);
+    assert_int_equal(out.misc.hierarchy.with_auth, TPM2_YES);
+    assert_memory_equal(&out.misc.hierarchy.authPolicy,
+                        &in.misc.hierarchy.authPolicy,
+                        sizeof(in.misc.hierarchy.authPolicy));
+    assert_string_equal(out.misc.hierarchy.description, "Owner hierarchy");
+    assert_int_equal(out.misc.hierarchy.esysHandle, ESYS_TR_RH_OWNER);
+    ifapi_cleanup_ifapi_object(&out);
+}
+
+static void
+check_binary_ext_pub_key(void **state)
+{
+    IFAPI_OBJECT in, out;
+
+    memset(&in, 0, sizeof(in));
+    in.objectType = IFAPI_EXT_PUB_KEY_OBJ;
+    in.misc.ext_pub_key.pem_ext_public = "-----BEGIN PUBLIC KEY-----";
+
+    roundtrip(&in, &out);
+    assert_int_equal(out.objectType, IFAPI_EXT_PUB_KEY_OBJ);
+    assert_string_equal(out.misc.ext_pub_key.pem_ext_public,
+                        "-----BEGIN PUBLIC KEY-----");
+    assert_null(out.misc.ext_pub_key.certificate);
+    assert_int_equal(out.misc.ext_pub_key.public.publicArea.type, 0);
+    ifapi_cleanup_ifapi_object(&out);
+}
+
+static void
+check_binary_error(void **state)
+{
+    TSS2_RC r;
+    IFAPI_OBJECT in, out;
+    uint8_t *buffer = NULL;
+    size_t size, i;
+    const char *json = "{ \"objectType\": 1 }";
+
+    assert_false(ifapi_binary_is_object((const uint8_t *)json, strlen(json)));
+    r = ifapi_binary_IFAPI_OBJECT_deserialize((const uint8_t *)json,
+                                              strlen(json), &out);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+
+    memset(&in, 0, sizeof(in));
+    in.objectType = IFAPI_DUPLICATE_OBJ;
+    assert_false(ifapi_binary_supported(&in));
+    r = ifapi_binary_IFAPI_OBJECT_serialize(&in, &buffer, &size);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+
+    init_key(&in, TPM2_ALG_RSA);
+    r = ifapi_binary_IFAPI_OBJECT_serialize(&in, &buffer, &size);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Every truncation of the object is detected. */
+    for (i = 0; i < size; i++) {
+        r = ifapi_binary_IFAPI_OBJECT_deserialize(buffer, i, &out);
+        assert_int_not_equal(r, TSS2_RC_SUCCESS);
+    }
+
+    /* Trailing data is rejected. */
+    buffer = realloc(buffer, size + 1);
+    assert_non_null(buffer);
+    buffer[size] = 0;
+    r = ifapi_binary_IFAPI_OBJECT_deserialize(buffer, size + 1, &out);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+
+    /* Unknown versions are rejected. */
+    buffer[IFAPI_BINARY_MAGIC_SIZE + 3] = IFAPI_BINARY_VERSION + 1;
+    r = ifapi_binary_IFAPI_OBJECT_deserialize(buffer, size, &out);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+    free(buffer);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(check_binary_key),
+        cmocka_unit_test(check_binary_nv),
+        cmocka_unit_test(check_binary_hierarchy),
+        cmocka_unit_test(check_binary_ext_pub_key),
+        cmocka_unit_test(check_binary_error),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
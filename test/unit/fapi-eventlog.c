@@ -0,0 +1,422 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_eventlog.h"
+#include "fapi_int.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the event log stored one event per line, the determination of
+ * the record number from the end of the log, the recovery from interrupted
+ * writes, the migration of logs stored as one JSON array and the locking
+ * of the log against concurrent writers.
+ *
+ * Events are serialized with their record number and PCR only.
+ */
+
+#define PCR 16
+
+/* Copy from ifapi_helpers.c */
+TSS2_RC
+ifapi_asprintf(char **str, const char *fmt, ...)
+{
+    int size = 0;
+    va_list args;
+    va_start(args, fmt);
+    size = vasprintf(str, fmt, args);
+    va_end(args);
+    if (size == -1)
+        return TSS2_FAPI_RC_MEMORY;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_create_dirs(const char *supdir, const char *path)
+{
+    return TSS2_FAPI_RC_IO_ERROR;
+}
+
+bool
+ifapi_get_sub_object(json_object *jso, char *name, json_object **sub_jso)
+{
+    return json_object_object_get_ex(jso, name, sub_jso);
+}
+
+TSS2_RC
+ifapi_json_UINT32_deserialize(json_object *jso, UINT32 *out)
+{
+    if (json_object_get_type(jso) != json_type_int)
+        return TSS2_FAPI_RC_BAD_VALUE;
+    *out = (UINT32)json_object_get_int64(jso);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_json_IFAPI_EVENT_serialize(const IFAPI_EVENT *in, json_object **jso)
+{
+    *jso = json_object_new_object();
+    assert_non_null(*jso);
+    json_object_object_add(*jso, "recnum", json_object_new_int64(in->recnum));
+    json_object_object_add(*jso, "pcr", json_object_new_int64(in->pcr));
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+static int
+setup(void **state)
+{
+    char template[] = "/tmp/fapi-eventlog-XXXXXX";
+    IFAPI_EVENTLOG *eventlog;
+
+    if (!mkdtemp(template))
+        return -1;
+    eventlog = calloc(1, sizeof(IFAPI_EVENTLOG));
+    if (!eventlog)
+        return -1;
+    if (ifapi_eventlog_initialize(eventlog, template) != TSS2_RC_SUCCESS)
+        return -1;
+    *state = eventlog;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+
+    nftw(eventlog->log_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    ifapi_eventlog_cleanup(eventlog);
+    free(eventlog);
+    return 0;
+}
+
+static char *
+log_path(IFAPI_EVENTLOG *eventlog, const char *name)
+{
+    char *path = NULL;
+
+    assert_int_equal(ifapi_asprintf(&path, "%s/%s%i", eventlog->log_dir, name, PCR),
+                     TSS2_RC_SUCCESS);
+    return path;
+}
+
+static void
+write_file(IFAPI_EVENTLOG *eventlog, const char *name, const char *content)
+{
+    char *path = log_path(eventlog, name);
+    FILE *stream = fopen(path, "w");
+
+    assert_non_null(stream);
+    fputs(content, stream);
+    fclose(stream);
+    free(path);
+}
+
+static char *
+read_file(IFAPI_EVENTLOG *eventlog, const char *name)
+{
+    char *path = log_path(eventlog, name);
+    FILE *stream = fopen(path, "r");
+    char *content;
+    long size;
+
+    free(path);
+    if (!stream)
+        return NULL;
+    fseek(stream, 0L, SEEK_END);
+    size = ftell(stream);
+    rewind(stream);
+    content = calloc(1, size + 1);
+    assert_non_null(content);
+    assert_int_equal(fread(content, 1, size, stream), size);
+    fclose(stream);
+    return content;
+}
+
+static void
+append_event(IFAPI_EVENTLOG *eventlog)
+{
+    IFAPI_IO io = { 0 };
+    IFAPI_EVENT event = { 0 };
+    TSS2_RC r;
+
+    event.pcr = PCR;
+    r = ifapi_eventlog_append_async(eventlog, &io, PCR);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_eventlog_append_check(eventlog, &io);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_eventlog_append_finish(eventlog, &io, &event);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+}
+
+/* Read the log of the PCR and check the record numbers of the events. */
+static void
+check_log(IFAPI_EVENTLOG *eventlog, const UINT32 *recnums, size_t num)
+{
+    IFAPI_IO io = { 0 };
+    TPM2_HANDLE pcr = PCR;
+    json_object *log, *jso;
+    char *logstr = NULL;
+    size_t i;
+    TSS2_RC r;
+
+    r = ifapi_eventlog_get_async(eventlog, &io, &pcr, 1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_eventlog_get_finish(eventlog, &io, &logstr);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    log = json_tokener_parse(logstr);
+    assert_non_null(log);
+    assert_int_equal(json_object_array_length(log), num);
+    for (i = 0; i < num; i++) {
+        assert_true(json_object_object_get_ex(json_object_array_get_idx(log, i),
+                                              "recnum", &jso));
+        assert_int_equal(json_object_get_int64(jso), recnums[i]);
+    }
+    json_object_put(log);
+    free(logstr);
+}
+
+static void
+test_append(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    const UINT32 recnums[] = { 1, 2, 3 };
+    char *content;
+
+    check_log(eventlog, NULL, 0);
+    append_event(eventlog);
+    append_event(eventlog);
+    append_event(eventlog);
+
+    content = read_file(eventlog, IFAPI_PCR_EVENTS_FILE);
+    assert_string_equal(content,
+                        "{\"recnum\":1,\"pcr\":16}\n"
+                        "{\"recnum\":2,\"pcr\":16}\n"
+                        "{\"recnum\":3,\"pcr\":16}\n");
+    free(content);
+    check_log(eventlog, recnums, 3);
+}
+
+static void
+test_tail_recnum(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    char *content = NULL, *path;
+    size_t length = 0, i;
+    FILE *stream;
+    json_object *log;
+    char *logstr = NULL;
+    IFAPI_IO io = { 0 };
+    TPM2_HANDLE pcr = PCR;
+    TSS2_RC r;
+
+    /* The log is larger than the part read first from its end and the
+       last line is invalid. */
+    path = log_path(eventlog, IFAPI_PCR_EVENTS_FILE);
+    stream = fopen(path, "w");
+    assert_non_null(stream);
+    for (i = 1; i <= 1000; i++)
+        fprintf(stream, "{\"recnum\":%zu,\"pcr\":16}\n", i);
+    fprintf(stream, "{\"recnum\":\"invalid\"}\n");
+    fclose(stream);
+    free(path);
+
+    append_event(eventlog);
+    content = read_file(eventlog, IFAPI_PCR_EVENTS_FILE);
+    length = strlen(content);
+    assert_true(length > 30);
+    assert_string_equal(&content[length - strlen("{\"recnum\":1001,\"pcr\":16}\n")],
+                        "{\"recnum\":1001,\"pcr\":16}\n");
+    free(content);
+
+    /* The log is parsed in several steps. */
+    r = ifapi_eventlog_get_async(eventlog, &io, &pcr, 1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    i = 0;
+    do {
+        r = ifapi_eventlog_get_finish(eventlog, &io, &logstr);
+        i += 1;
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_true(i > 1);
+    log = json_tokener_parse(logstr);
+    assert_non_null(log);
+    assert_int_equal(json_object_array_length(log), 1002);
+    json_object_put(log);
+    free(logstr);
+}
+
+static void
+test_truncated_line(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    const UINT32 recnums[] = { 1, 2, 3 };
+    char *content;
+
+    /* An interrupted write left an incomplete last line. */
+    write_file(eventlog, IFAPI_PCR_EVENTS_FILE,
+               "{\"recnum\":1,\"pcr\":16}\n"
+               "{\"recnum\":2,\"pcr\":16}\n"
+               "{\"recnum\":3,\"pc");
+    check_log(eventlog, recnums, 2);
+
+    /* The next event starts on a line of its own. */
+    append_event(eventlog);
+    content = read_file(eventlog, IFAPI_PCR_EVENTS_FILE);
+    assert_string_equal(content,
+                        "{\"recnum\":1,\"pcr\":16}\n"
+                        "{\"recnum\":2,\"pcr\":16}\n"
+                        "{\"recnum\":3,\"pc\n"
+                        "{\"recnum\":3,\"pcr\":16}\n");
+    free(content);
+    check_log(eventlog, recnums, 3);
+}
+
+static void
+test_migration(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    const UINT32 recnums[] = { 1, 2, 3 };
+    char *content;
+
+    write_file(eventlog, IFAPI_PCR_LOG_FILE,
+               "[\n  {\n    \"recnum\":1,\n    \"pcr\":16\n  },\n"
+               "  {\n    \"recnum\":2,\n    \"pcr\":16\n  }\n]");
+
+    /* A log in the array format is read until the next extend. */
+    check_log(eventlog, recnums, 2);
+
+    append_event(eventlog);
+    content = read_file(eventlog, IFAPI_PCR_EVENTS_FILE);
+    assert_string_equal(content,
+                        "{\"recnum\":1,\"pcr\":16}\n"
+                        "{\"recnum\":2,\"pcr\":16}\n"
+                        "{\"recnum\":3,\"pcr\":16}\n");
+    free(content);
+    assert_null(read_file(eventlog, IFAPI_PCR_LOG_FILE));
+    check_log(eventlog, recnums, 3);
+}
+
+static void
+test_migration_interrupted(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    const UINT32 recnums[] = { 1, 2 };
+
+    /* The array log was not removed after the converted log was stored. */
+    write_file(eventlog, IFAPI_PCR_LOG_FILE,
+               "[{\"recnum\":1,\"pcr\":16},{\"recnum\":7,\"pcr\":16}]");
+    write_file(eventlog, IFAPI_PCR_EVENTS_FILE, "{\"recnum\":1,\"pcr\":16}\n");
+
+    /* The log in the line format wins. */
+    check_log(eventlog, recnums, 1);
+    append_event(eventlog);
+    assert_null(read_file(eventlog, IFAPI_PCR_LOG_FILE));
+    check_log(eventlog, recnums, 2);
+}
+
+/* Try to lock the log in the line format from another process. */
+static bool
+locked_by_other(IFAPI_EVENTLOG *eventlog)
+{
+    char *path = log_path(eventlog, IFAPI_PCR_EVENTS_FILE);
+    int status;
+    pid_t pid;
+
+    pid = fork();
+    assert_true(pid >= 0);
+    if (pid == 0) {
+        FILE *stream = fopen(path, "a");
+        _exit(stream == NULL || lockf(fileno(stream), F_TLOCK, 0) == 0 ? 0 : 1);
+    }
+    free(path);
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status));
+    return WEXITSTATUS(status) == 1;
+}
+
+static void
+test_append_locked(void **state)
+{
+    IFAPI_EVENTLOG *eventlog = *state;
+    IFAPI_EVENTLOG reader = { 0 };
+    IFAPI_EVENT event = { 0 };
+    IFAPI_IO io = { 0 };
+    const UINT32 recnums[] = { 1, 2, 3 };
+    TSS2_RC r;
+
+    write_file(eventlog, IFAPI_PCR_LOG_FILE,
+               "[{\"recnum\":1,\"pcr\":16},{\"recnum\":2,\"pcr\":16}]");
+    assert_false(locked_by_other(eventlog));
+
+    /* The log stays locked from the start of the migration until the
+       event is written. */
+    r = ifapi_eventlog_append_async(eventlog, &io, PCR);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_true(locked_by_other(eventlog));
+
+    /* Readers see the array log while the migration is pending. */
+    r = ifapi_eventlog_initialize(&reader, eventlog->log_dir);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    check_log(&reader, recnums, 2);
+
+    do {
+        r = ifapi_eventlog_append_check(eventlog, &io);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    event.pcr = PCR;
+    do {
+        r = ifapi_eventlog_append_finish(eventlog, &io, &event);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_null(eventlog->lock);
+    assert_false(locked_by_other(eventlog));
+
+    check_log(&reader, recnums, 3);
+    ifapi_eventlog_cleanup(&reader);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_append, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_tail_recnum, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_truncated_line, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_migration, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_migration_interrupted, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_append_locked, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,499 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_index.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the index file which maps object names and digests to
+ * keystore paths.
+ */
+
+/* Copy from ifapi_helpers.c */
+TSS2_RC
+ifapi_asprintf(char **str, const char *fmt, ...)
+{
+    int size = 0;
+    va_list args;
+    va_start(args, fmt);
+    size = vasprintf(str, fmt, args);
+    va_end(args);
+    if (size == -1)
+        return TSS2_FAPI_RC_MEMORY;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_create_dirs(const char *supdir, const char *path)
+{
+    return TSS2_FAPI_RC_IO_ERROR;
+}
+
+static const uint8_t name1[] = { 0x00, 0x0b, 0x01, 0x02 };
+static const uint8_t name2[] = { 0x00, 0x0b, 0x03, 0x04 };
+static const uint8_t digest[] = { 0xaa, 0xbb };
+
+static int
+setup(void **state)
+{
+    char template[] = "/tmp/fapi-index-XXXXXX";
+    char *index_file = NULL;
+    int fd;
+
+    /* Only a unique name is needed, the index file is created by the tests. */
+    fd = mkstemp(template);
+    if (fd < 0)
+        return -1;
+    close(fd);
+    unlink(template);
+    if (ifapi_asprintf(&index_file, "%s", template) != TSS2_RC_SUCCESS)
+        return -1;
+    *state = index_file;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    unlink(*state);
+    free(*state);
+    return 0;
+}
+
+static char *
+make_keys(const uint8_t *name, size_t name_size, bool with_policy)
+{
+    char *keys = NULL;
+    TSS2_RC r;
+
+    r = ifapi_index_add_key(&keys, "name", name, name_size);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    if (with_policy) {
+        r = ifapi_index_add_key(&keys, "policy", &digest[0], sizeof(digest));
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+    return keys;
+}
+
+static size_t
+lookup_state(const char *index_file, const uint8_t *name, size_t name_size,
+             const char *expected, IFAPI_INDEX_STATE *state)
+{
+    char *key = make_keys(name, name_size, false);
+    char **paths = NULL;
+    size_t num_paths, i;
+    TSS2_RC r;
+
+    r = ifapi_index_lookup(index_file, key, &paths, &num_paths, state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    if (expected) {
+        assert_int_equal(num_paths, 1);
+        assert_string_equal(paths[0], expected);
+    }
+    for (i = 0; i < num_paths; i++)
+        free(paths[i]);
+    free(paths);
+    free(key);
+    return num_paths;
+}
+
+static size_t
+lookup(const char *index_file, const uint8_t *name, size_t name_size,
+       const char *expected)
+{
+    IFAPI_INDEX_STATE state;
+
+    return lookup_state(index_file, name, name_size, expected, &state);
+}
+
+static long
+file_size(const char *index_file)
+{
+    FILE *stream = fopen(index_file, "r");
+    long size;
+
+    assert_non_null(stream);
+    fseek(stream, 0L, SEEK_END);
+    size = ftell(stream);
+    fclose(stream);
+    return size;
+}
+
+static void
+test_add_key(void **state)
+{
+    char *keys = make_keys(name1, sizeof(name1), true);
+
+    assert_string_equal(keys, "name:000b0102 policy:aabb");
+    free(keys);
+}
+
+static void
+test_missing_index(void **state)
+{
+    IFAPI_INDEX_STATE index_state;
+
+    assert_int_equal(lookup_state(*state, name1, sizeof(name1), NULL,
+                                  &index_state), 0);
+    assert_false(index_state.exists);
+    assert_false(index_state.complete);
+}
+
+static void
+test_update_lookup(void **state)
+{
+    char *index_file = *state;
+    char *keys1 = make_keys(name1, sizeof(name1), true);
+    char *keys2 = make_keys(name2, sizeof(name2), false);
+    long size;
+    TSS2_RC r;
+
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key2", NULL, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    lookup(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1");
+    lookup(index_file, name2, sizeof(name2), "/P_RSA/HS/SRK/key2");
+
+    /* Storing appends a record without reading the index. */
+    size = file_size(index_file);
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(file_size(index_file),
+                     size + strlen("+ /P_RSA/HS/SRK/key1 \n") + strlen(keys1));
+    lookup(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1");
+
+    /* A later record supersedes the earlier one. */
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(lookup(index_file, name1, sizeof(name1), NULL), 0);
+    assert_int_equal(lookup(index_file, name2, sizeof(name2), NULL), 2);
+
+    free(keys1);
+    free(keys2);
+}
+
+static void
+test_remove(void **state)
+{
+    char *index_file = *state;
+    char *keys = make_keys(name1, sizeof(name1), false);
+    TSS2_RC r;
+
+    r = ifapi_index_update(index_file, "/nv/Owner/myNV", NULL, keys);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_remove(index_file, "/nv/Owner/myNV");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(lookup(index_file, name1, sizeof(name1), NULL), 0);
+
+    /* Removing a path twice keeps it removed. */
+    r = ifapi_index_remove(index_file, "/nv/Owner/myNV");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(lookup(index_file, name1, sizeof(name1), NULL), 0);
+
+    /* The path can be added again. */
+    r = ifapi_index_update(index_file, "/nv/Owner/myNV", NULL, keys);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    lookup(index_file, name1, sizeof(name1), "/nv/Owner/myNV");
+
+    free(keys);
+}
+
+static void
+test_incomplete_record(void **state)
+{
+    char *index_file = *state;
+    char *keys = make_keys(name1, sizeof(name1), false);
+    FILE *stream;
+    TSS2_RC r;
+
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Simulate an interrupted write of a remove record. */
+    stream = fopen(index_file, "a");
+    assert_non_null(stream);
+    fputs("- /P_RSA/HS/SRK/key1", stream);
+    fclose(stream);
+
+    lookup(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1");
+
+    /* The next record is not merged with the incomplete one. */
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key2", NULL, keys);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(lookup(index_file, name1, sizeof(name1), NULL), 2);
+    free(keys);
+}
+
+static void
+test_rewrite(void **state)
+{
+    char *index_file = *state;
+    char *keys1 = make_keys(name1, sizeof(name1), false);
+    char *keys2 = make_keys(name2, sizeof(name2), false);
+    char *records = NULL;
+    IFAPI_INDEX_STATE index_state;
+    TSS2_RC r;
+
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/old", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    lookup_state(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/old", &index_state);
+    assert_true(index_state.exists);
+    assert_false(index_state.complete);
+
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key1", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/bad path", NULL, keys2);
+    assert_int_equal(r, TSS2_FAPI_RC_BAD_VALUE);
+
+    /* A record appended during the scan supersedes the scanned records. */
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key2", NULL, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_remove(index_file, "/P_RSA/HS/SRK/key1");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    r = ifapi_index_rewrite(index_file, records, &index_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    assert_int_equal(lookup_state(index_file, name1, sizeof(name1), NULL,
+                                  &index_state), 0);
+    assert_true(index_state.complete);
+    lookup(index_file, name2, sizeof(name2), "/P_RSA/HS/SRK/key2");
+
+    /* An empty record list creates an empty complete index. */
+    r = ifapi_index_rewrite(index_file, NULL, &index_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    lookup_state(index_file, name2, sizeof(name2), NULL, &index_state);
+    assert_true(index_state.complete);
+    assert_int_equal(file_size(index_file), strlen("# complete 0\n"));
+
+    free(records);
+    free(keys1);
+    free(keys2);
+}
+
+static void
+test_rewrite_replaced(void **state)
+{
+    char *index_file = *state;
+    char *keys1 = make_keys(name1, sizeof(name1), false);
+    char *records = NULL;
+    IFAPI_INDEX_STATE index_state, old_state;
+    TSS2_RC r;
+
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    lookup_state(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1", &old_state);
+
+    /* Another scan replaced the index in the meantime. */
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key1", NULL, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_rewrite(index_file, records, &old_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The current records are kept, but the index is not complete. */
+    r = ifapi_index_rewrite(index_file, NULL, &old_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    lookup_state(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1", &index_state);
+    assert_false(index_state.complete);
+
+    free(records);
+    free(keys1);
+}
+
+static void
+test_compaction(void **state)
+{
+    char *index_file = *state;
+    char *keys1 = make_keys(name1, sizeof(name1), true);
+    char *keys2 = make_keys(name2, sizeof(name2), false);
+    IFAPI_INDEX_STATE index_state;
+    char *records = NULL;
+    size_t i;
+    TSS2_RC r;
+
+    lookup_state(index_file, name2, sizeof(name2), NULL, &index_state);
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key2", NULL, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_rewrite(index_file, records, &index_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* Storing the same object repeatedly does not grow the index unbounded. */
+    for (i = 0; i < 4096; i++) {
+        r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", NULL, keys1);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        r = ifapi_index_remove(index_file, "/P_RSA/HS/SRK/key3");
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+    }
+    assert_true(file_size(index_file) < 64 * 1024);
+
+    /* The compaction keeps the live records and the completeness. */
+    lookup_state(index_file, name1, sizeof(name1), "/P_RSA/HS/SRK/key1", &index_state);
+    assert_true(index_state.complete);
+    lookup(index_file, name2, sizeof(name2), "/P_RSA/HS/SRK/key2");
+
+    free(records);
+    free(keys1);
+    free(keys2);
+}
+
+/* The object files of test_unindexed are stored in this directory. */
+static char store_dir[] = "/tmp/fapi-index-store-XXXXXX";
+
+static TSS2_RC
+store_object_file(void *ctx, const char *path, char **file)
+{
+    return ifapi_asprintf(file, "%s/%s", (const char *)ctx, strrchr(path, '/') + 1);
+}
+
+static void
+store_object(const char *path, const char *content)
+{
+    char *file = NULL;
+    FILE *stream;
+
+    assert_int_equal(store_object_file(store_dir, path, &file), TSS2_RC_SUCCESS);
+    stream = fopen(file, "w");
+    assert_non_null(stream);
+    fputs(content, stream);
+    fclose(stream);
+    free(file);
+}
+
+/* Return the paths without a trusted record as space separated list. */
+static char *
+unindexed(const char *index_file, bool expected_complete)
+{
+    static const char *all_paths[] = {
+        "/P_RSA/HS/SRK/key1", "/P_RSA/HS/SRK/key2", "/P_RSA/HS/SRK/key3"
+    };
+    static char result[128];
+    char *paths[3];
+    size_t num_paths = 3, i;
+    bool complete;
+    TSS2_RC r;
+
+    for (i = 0; i < num_paths; i++)
+        paths[i] = strdup(all_paths[i]);
+    r = ifapi_index_unindexed(index_file, store_object_file, store_dir,
+                              &paths[0], &num_paths, &complete);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(complete, expected_complete);
+
+    result[0] = '\0';
+    for (i = 0; i < num_paths; i++) {
+        if (i)
+            strcat(&result[0], " ");
+        strcat(&result[0], strrchr(paths[i], '/') + 1);
+        free(paths[i]);
+    }
+    return &result[0];
+}
+
+static void
+test_unindexed(void **state)
+{
+    char *index_file = *state;
+    char *keys1 = make_keys(name1, sizeof(name1), false);
+    char *keys2 = make_keys(name2, sizeof(name2), false);
+    char *records = NULL, *file1 = NULL, *file2 = NULL, *file3 = NULL;
+    IFAPI_INDEX_STATE index_state;
+    TSS2_RC r;
+
+    assert_non_null(mkdtemp(store_dir));
+    store_object_file(store_dir, "/P_RSA/HS/SRK/key1", &file1);
+    store_object_file(store_dir, "/P_RSA/HS/SRK/key2", &file2);
+    store_object_file(store_dir, "/P_RSA/HS/SRK/key3", &file3);
+    store_object("/P_RSA/HS/SRK/key1", "object 1");
+    store_object("/P_RSA/HS/SRK/key2", "object 2");
+
+    /* A partial index does not tell which objects are missing. */
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key1", file1, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_string_equal(unindexed(index_file, false), "key1 key2 key3");
+
+    /* The records of a full scan are trusted. */
+    lookup_state(index_file, name1, sizeof(name1), NULL, &index_state);
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key1", file1, keys1);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key2", file2, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_rewrite(index_file, records, &index_state);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_string_equal(unindexed(index_file, true), "key3");
+
+    /* An object added behind the index is not found by a lookup ... */
+    store_object("/P_RSA/HS/SRK/key3", "object 3");
+    assert_int_equal(lookup(index_file, name2, sizeof(name2), NULL), 1);
+    /* ... but it is the only object which has to be read. */
+    assert_string_equal(unindexed(index_file, true), "key3");
+
+    /* Its record is appended, afterwards the index covers all objects. */
+    SAFE_FREE(records);
+    r = ifapi_index_add_record(&records, "/P_RSA/HS/SRK/key3", file3, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    r = ifapi_index_append(index_file, records);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(lookup(index_file, name2, sizeof(name2), NULL), 2);
+    assert_string_equal(unindexed(index_file, true), "");
+
+    /* An object replaced in place is not trusted anymore. */
+    store_object("/P_RSA/HS/SRK/key1", "object 1, replaced");
+    assert_string_equal(unindexed(index_file, true), "key1");
+
+    /* Nor is an object stored with a record which has no file key. */
+    r = ifapi_index_update(index_file, "/P_RSA/HS/SRK/key2", NULL, keys2);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_string_equal(unindexed(index_file, true), "key1 key2");
+
+    /* Removed paths are not trusted. */
+    r = ifapi_index_remove(index_file, "/P_RSA/HS/SRK/key3");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_string_equal(unindexed(index_file, true), "key1 key2 key3");
+
+    unlink(file1);
+    unlink(file2);
+    unlink(file3);
+    rmdir(store_dir);
+    free(file1);
+    free(file2);
+    free(file3);
+    free(records);
+    free(keys1);
+    free(keys2);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_add_key),
+        cmocka_unit_test_setup_teardown(test_missing_index, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_update_lookup, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_remove, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_incomplete_record, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_rewrite, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_rewrite_replaced, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_compaction, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_unindexed, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,555 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_io.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the incremental enumeration of directory trees used for
+ * listing large keystores page by page and for reading files.
+ */
+
+/* Copy from ifapi_helpers.c */
+TSS2_RC
+ifapi_asprintf(char **str, const char *fmt, ...)
+{
+    int size = 0;
+    va_list args;
+    va_start(args, fmt);
+    size = vasprintf(str, fmt, args);
+    va_end(args);
+    if (size == -1)
+        return TSS2_FAPI_RC_MEMORY;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_create_dirs(const char *supdir, const char *path)
+{
+    return TSS2_FAPI_RC_IO_ERROR;
+}
+
+static void
+create_file(const char *dir, const char *name)
+{
+    char *path = NULL;
+    FILE *stream;
+
+    assert_int_equal(ifapi_asprintf(&path, "%s/%s", dir, name), TSS2_RC_SUCCESS);
+    stream = fopen(path, "w");
+    assert_non_null(stream);
+    fclose(stream);
+    free(path);
+}
+
+static char *
+create_dir(const char *dir, const char *name)
+{
+    char *path = NULL;
+
+    assert_int_equal(ifapi_asprintf(&path, "%s/%s", dir, name), TSS2_RC_SUCCESS);
+    assert_int_equal(mkdir(path, 0700), 0);
+    return path;
+}
+
+static int
+remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+static int
+setup(void **state)
+{
+    char template[] = "/tmp/fapi-io-XXXXXX";
+    char *dir = NULL;
+
+    if (!mkdtemp(template))
+        return -1;
+    if (ifapi_asprintf(&dir, "%s", template) != TSS2_RC_SUCCESS)
+        return -1;
+    *state = dir;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    nftw(*state, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    free(*state);
+    return 0;
+}
+
+static void
+free_paths(char **paths, size_t num_paths)
+{
+    for (size_t i = 0; i < num_paths; i++)
+        free(paths[i]);
+    free(paths);
+}
+
+/*
+ * Enumerate the tree below dir page by page and check that the pages contain
+ * the same files as the complete listing in strictly increasing order. If
+ * restart is set, every page is read with a new walk positioned via the
+ * cursor.
+ */
+static size_t
+check_pages(const char *dir, size_t page_size, bool restart)
+{
+    IFAPI_DIR_WALK walk = { 0 };
+    char **all = NULL, **page, *cursor = NULL;
+    const char *last;
+    size_t num_all = 0, num_page, total = 0, i, j;
+    TSS2_RC r;
+
+    r = ifapi_io_dirfiles_all(dir, &all, &num_all);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    do {
+        page = NULL;
+        num_page = 0;
+        if (restart)
+            ifapi_io_dirwalk_cleanup(&walk);
+        r = ifapi_io_dirfiles_next(&walk, dir, cursor, page_size, &page, &num_page);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_true(num_page <= page_size);
+
+        last = cursor;
+        for (i = 0; i < num_page; i++) {
+            if (last)
+                assert_true(strcmp(last, page[i]) < 0);
+            for (j = 0; j < num_all; j++) {
+                if (strcmp(all[j], page[i]) == 0)
+                    break;
+            }
+            assert_true(j < num_all);
+            last = page[i];
+        }
+        total += num_page;
+        free(cursor);
+        cursor = num_page ? strdup(page[num_page - 1]) : NULL;
+        free_paths(page, num_page);
+    } while (num_page == page_size);
+
+    assert_int_equal(total, num_all);
+    free(cursor);
+    free_paths(all, num_all);
+    ifapi_io_dirwalk_cleanup(&walk);
+    return total;
+}
+
+static void
+test_dirfiles_next(void **state)
+{
+    char *dir = *state;
+    char *sub, *subsub;
+
+    /* "a/" has to be enumerated after "a.x" to keep paths in sorted order. */
+    sub = create_dir(dir, "a");
+    create_file(sub, "object.json");
+    subsub = create_dir(sub, "b");
+    create_file(subsub, "object.json");
+    create_file(subsub, "policy.json");
+    free(subsub);
+    free(sub);
+    create_file(dir, "a.x");
+    create_file(dir, "b");
+    create_file(dir, ".index");
+    sub = create_dir(dir, "empty");
+    free(sub);
+
+    for (size_t page_size = 1; page_size <= 6; page_size++) {
+        assert_int_equal(check_pages(dir, page_size, 0), 5);
+        assert_int_equal(check_pages(dir, page_size, 1), 5);
+    }
+}
+
+static void
+test_dirfiles_next_missing(void **state)
+{
+    IFAPI_DIR_WALK walk = { 0 };
+    char *dir = NULL;
+    char **paths = NULL;
+    size_t num_paths = 0;
+    TSS2_RC r;
+
+    assert_int_equal(ifapi_asprintf(&dir, "%s/missing", (char *)*state),
+                     TSS2_RC_SUCCESS);
+    r = ifapi_io_dirfiles_next(&walk, dir, NULL, 10, &paths, &num_paths);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(num_paths, 0);
+    assert_null(paths);
+    ifapi_io_dirwalk_cleanup(&walk);
+    free(dir);
+}
+
+/* Read one page of the tree below dir and return its last path. */
+static char *
+next_page(IFAPI_DIR_WALK *walk, const char *dir, const char *cursor,
+          size_t page_size, size_t expected)
+{
+    char **paths = NULL, *last;
+    size_t num_paths = 0;
+    TSS2_RC r;
+
+    r = ifapi_io_dirfiles_next(walk, dir, cursor, page_size, &paths, &num_paths);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(num_paths, expected);
+    last = num_paths ? strdup(paths[num_paths - 1]) : NULL;
+    free_paths(paths, num_paths);
+    return last;
+}
+
+static void
+test_dirfiles_next_continue(void **state)
+{
+    IFAPI_DIR_WALK walk = { 0 }, fresh = { 0 };
+    char *dir = *state;
+    char *sub, *cursor, *last;
+
+    sub = create_dir(dir, "a");
+    create_file(sub, "1");
+    create_file(sub, "2");
+    create_file(sub, "3");
+
+    cursor = next_page(&walk, dir, NULL, 2, 2);
+    assert_true(strncmp(cursor, sub, strlen(sub)) == 0);
+    assert_string_equal(&cursor[strlen(sub)], "/2");
+
+    /* The continued walk uses the entries read before. */
+    create_file(sub, "4");
+    last = next_page(&walk, dir, cursor, 2, 1);
+    assert_string_equal(&last[strlen(sub)], "/3");
+    assert_null(next_page(&walk, dir, last, 2, 0));
+    free(last);
+
+    /* A walk positioned via the cursor reads the directory again. */
+    last = next_page(&fresh, dir, cursor, 2, 2);
+    assert_string_equal(&last[strlen(sub)], "/4");
+    free(last);
+
+    /* A cursor not returned by the walk restarts it. */
+    last = next_page(&walk, dir, cursor, 3, 2);
+    assert_string_equal(&last[strlen(sub)], "/4");
+    free(last);
+
+    ifapi_io_dirwalk_cleanup(&fresh);
+    ifapi_io_dirwalk_cleanup(&walk);
+    free(cursor);
+    free(sub);
+}
+
+static void
+test_dirfiles_next_outside(void **state)
+{
+    IFAPI_DIR_WALK walk = { 0 };
+    char *dir = *state;
+    char *sub, *cursor = NULL, *last;
+
+    sub = create_dir(dir, "b");
+    create_file(sub, "object.json");
+
+    /* Paths outside of the tree only position the walk. */
+    assert_int_equal(ifapi_asprintf(&cursor, "%s/../a/x", dir), TSS2_RC_SUCCESS);
+    last = next_page(&walk, dir, cursor, 10, 1);
+    assert_string_equal(&last[strlen(sub)], "/object.json");
+    free(last);
+    free(cursor);
+
+    assert_int_equal(ifapi_asprintf(&cursor, "%s/c/../../..", dir), TSS2_RC_SUCCESS);
+    assert_null(next_page(&walk, dir, cursor, 10, 0));
+    free(cursor);
+
+    ifapi_io_dirwalk_cleanup(&walk);
+    free(sub);
+}
+
+#define LARGE_DIRS 64
+#define LARGE_FILES 64
+static void
+test_dirfiles_next_large(void **state)
+{
+    char *dir = *state;
+    char name[16], *sub;
+
+    for (int i = 0; i < LARGE_DIRS; i++) {
+        snprintf(name, sizeof(name), "key%d", i);
+        sub = create_dir(dir, name);
+        for (int j = 0; j < LARGE_FILES; j++) {
+            snprintf(name, sizeof(name), "obj%d.json", j);
+            create_file(sub, name);
+        }
+        free(sub);
+    }
+
+    assert_int_equal(check_pages(dir, 10, 0), LARGE_DIRS * LARGE_FILES);
+    assert_int_equal(check_pages(dir, 1000, 1), LARGE_DIRS * LARGE_FILES);
+}
+
+static char *
+write_file(const char *dir, const char *name, const uint8_t *data, size_t size)
+{
+    char *path = NULL;
+    FILE *stream;
+
+    assert_int_equal(ifapi_asprintf(&path, "%s/%s", dir, name), TSS2_RC_SUCCESS);
+    stream = fopen(path, "w");
+    assert_non_null(stream);
+    assert_int_equal(fwrite(data, 1, size, stream), size);
+    fclose(stream);
+    return path;
+}
+
+static void
+read_file(IFAPI_IO *io, const char *path, const IFAPI_IO_ENGINE *engine,
+          uint8_t **buffer, size_t *size)
+{
+    TSS2_RC r;
+
+    r = ifapi_io_read_async(io, path);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_ptr_equal(io->engine, engine);
+    do {
+        r = ifapi_io_read_finish(io, buffer, size);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(io->pollevents, 0);
+}
+
+/*
+ * Read files of several sizes with the read engine and check the complete,
+ * zero terminated content.
+ */
+static void
+test_read(void **state)
+{
+    const size_t sizes[] = { 0, 1, 4096, 65535, 65536, 3 * 65536 + 7 };
+    IFAPI_IO io = { 0 };
+    uint8_t *data, *buffer;
+    size_t size, max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    char name[16], *path;
+
+    data = malloc(max_size);
+    assert_non_null(data);
+    for (size_t i = 0; i < max_size; i++)
+        data[i] = (uint8_t)(i * 7 + 1);
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        snprintf(name, sizeof(name), "file%zu", i);
+        path = write_file(*state, name, data, sizes[i]);
+
+        buffer = NULL;
+        size = 0;
+        read_file(&io, path, &ifapi_io_engine_read, &buffer, &size);
+        assert_int_equal(size, sizes[i]);
+        if (size)
+            assert_memory_equal(buffer, data, size);
+        assert_int_equal(buffer[size], '\0');
+        free(buffer);
+        free(path);
+    }
+    free(data);
+}
+
+static void
+test_read_missing(void **state)
+{
+    IFAPI_IO io = { 0 };
+    char *path = NULL;
+    TSS2_RC r;
+
+    assert_int_equal(ifapi_asprintf(&path, "%s/missing", (char *)*state),
+                     TSS2_RC_SUCCESS);
+    r = ifapi_io_read_async(&io, path);
+    assert_int_equal(r, TSS2_FAPI_RC_IO_ERROR);
+    assert_null(io.char_rbuffer);
+
+    /* Missing files are ignored by the batch. */
+    ifapi_io_read_batch(&io, (const char **)&path, 1);
+    assert_null(io.batch[0].path);
+    r = ifapi_io_read_async(&io, path);
+    assert_int_equal(r, TSS2_FAPI_RC_IO_ERROR);
+    free(path);
+}
+
+/*
+ * A file truncated after its size was taken is returned up to its new end.
+ */
+static void
+test_read_truncated(void **state)
+{
+    const size_t sizes[] = { 4096, 2 * 65536 };
+    IFAPI_IO io = { 0 };
+    uint8_t *data, *buffer;
+    size_t size;
+    char *path;
+    TSS2_RC r;
+
+    data = malloc(sizes[1]);
+    assert_non_null(data);
+    memset(data, 'x', sizes[1]);
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        path = write_file(*state, "truncated", data, sizes[i]);
+
+        r = ifapi_io_read_async(&io, path);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(truncate(path, 100), 0);
+        buffer = NULL;
+        size = 0;
+        do {
+            r = ifapi_io_read_finish(&io, &buffer, &size);
+        } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(size, 100);
+        assert_memory_equal(buffer, data, size);
+        assert_int_equal(buffer[size], '\0');
+        free(buffer);
+        free(path);
+    }
+    free(data);
+}
+
+/*
+ * Files read in a batch are served from memory with their complete content,
+ * a write drops the content read ahead.
+ */
+#define READ_FILES 64
+static void
+test_read_batch(void **state)
+{
+    IFAPI_IO io = { 0 };
+    char *paths[READ_FILES], name[16];
+    uint8_t data[1024], *buffer;
+    size_t size;
+    TSS2_RC r;
+
+    for (size_t i = 0; i < READ_FILES; i++) {
+        memset(data, 'a' + i % 26, sizeof(data));
+        snprintf(name, sizeof(name), "obj%zu.json", i);
+        paths[i] = write_file(*state, name, data, sizeof(data));
+    }
+
+    for (size_t i = 0; i < READ_FILES; i += IFAPI_IO_BATCH_SIZE) {
+        ifapi_io_read_batch(&io, (const char **)&paths[i], IFAPI_IO_BATCH_SIZE);
+        for (size_t j = i; j < i + IFAPI_IO_BATCH_SIZE; j++) {
+            memset(data, 'a' + j % 26, sizeof(data));
+            read_file(&io, paths[j], &ifapi_io_engine_batch, &buffer, &size);
+            assert_int_equal(size, sizeof(data));
+            assert_memory_equal(buffer, data, size);
+            assert_int_equal(buffer[size], '\0');
+            free(buffer);
+        }
+        /* Every file is served from the batch only once. */
+        for (size_t j = 0; j < IFAPI_IO_BATCH_SIZE; j++)
+            assert_null(io.batch[j].path);
+    }
+
+    ifapi_io_read_batch(&io, (const char **)paths, 2);
+    r = ifapi_io_write_async(&io, paths[0], (const uint8_t *)"new", 3);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    do {
+        r = ifapi_io_write_finish(&io);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    read_file(&io, paths[0], &ifapi_io_engine_read, &buffer, &size);
+    assert_int_equal(size, 3);
+    assert_memory_equal(buffer, "new", 3);
+    free(buffer);
+
+    ifapi_io_batch_cleanup(&io);
+    assert_null(io.batch[1].path);
+
+    for (size_t i = 0; i < READ_FILES; i++)
+        free(paths[i]);
+}
+
+/*
+ * A file locked by another writer is not truncated by a write.
+ */
+static void
+test_write_locked(void **state)
+{
+    uint8_t data[100], *buffer;
+    IFAPI_IO io = { 0 };
+    int ready[2], done[2];
+    size_t size;
+    char *path, c;
+    pid_t pid;
+    TSS2_RC r;
+
+    memset(data, 'x', sizeof(data));
+    path = write_file(*state, "locked", data, sizeof(data));
+
+    assert_int_equal(pipe(ready), 0);
+    assert_int_equal(pipe(done), 0);
+    pid = fork();
+    assert_true(pid >= 0);
+    if (pid == 0) {
+        int fd = open(path, O_WRONLY);
+
+        if (fd < 0 || lockf(fd, F_TLOCK, 0) != 0)
+            _exit(1);
+        if (write(ready[1], "l", 1) != 1 || read(done[0], &c, 1) != 1)
+            _exit(1);
+        _exit(0);
+    }
+    assert_int_equal(read(ready[0], &c, 1), 1);
+
+    r = ifapi_io_write_async(&io, path, (const uint8_t *)"new", 3);
+    assert_int_equal(r, TSS2_FAPI_RC_IO_ERROR);
+    assert_null(io.char_rbuffer);
+
+    assert_int_equal(write(done[1], "d", 1), 1);
+    waitpid(pid, NULL, 0);
+    close(ready[0]);
+    close(ready[1]);
+    close(done[0]);
+    close(done[1]);
+
+    read_file(&io, path, &ifapi_io_engine_read, &buffer, &size);
+    assert_int_equal(size, sizeof(data));
+    assert_memory_equal(buffer, data, size);
+    free(buffer);
+    free(path);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_dirfiles_next, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_dirfiles_next_missing, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_dirfiles_next_continue, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_dirfiles_next_outside, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_dirfiles_next_large, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_read, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_read_missing, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_read_truncated, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_read_batch, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_write_locked, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
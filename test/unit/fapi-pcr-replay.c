@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_pcr_replay.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the checkpoints of the PCR replay used by Fapi_VerifyQuote. The
+ * PCR values of a checkpoint are arbitrary values, only the selection of
+ * the virtual PCRs and the comparison of the replayed events are checked.
+ */
+
+/* Create an event list with events for PCR 16. */
+static json_object *
+event_list(size_t n_events)
+{
+    json_object *list = json_object_new_array();
+    json_object *event;
+    size_t i;
+
+    assert_non_null(list);
+    for (i = 0; i < n_events; i++) {
+        event = json_object_new_object();
+        assert_non_null(event);
+        json_object_object_add(event, "recnum", json_object_new_int64(i + 1));
+        json_object_object_add(event, "pcr", json_object_new_int(16));
+        json_object_array_add(list, event);
+    }
+    return list;
+}
+
+static size_t
+selection(IFAPI_VPCR *pcrs, TPM2_HANDLE pcr)
+{
+    memset(pcrs, 0, 2 * sizeof(IFAPI_VPCR));
+    pcrs[0].bank = TPM2_ALG_SHA1;
+    pcrs[0].pcr = pcr;
+    pcrs[0].value.size = TPM2_SHA1_DIGEST_SIZE;
+    pcrs[1].bank = TPM2_ALG_SHA256;
+    pcrs[1].pcr = pcr;
+    pcrs[1].value.size = TPM2_SHA256_DIGEST_SIZE;
+    return 2;
+}
+
+static IFAPI_PCR_REPLAY_CACHE *
+new_cache(void)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = calloc(1, sizeof(*cache));
+
+    assert_non_null(cache);
+    return cache;
+}
+
+/* Look up the checkpoint for the list and store a checkpoint for it, whose
+   PCR values are filled with tag. Returns the number of reused events. */
+static size_t
+replay(IFAPI_PCR_REPLAY_CACHE *cache, json_object *list, TPM2_HANDLE pcr,
+       uint8_t tag, uint8_t expected_tag)
+{
+    IFAPI_VPCR pcrs[2];
+    IFAPI_PCR_CHECKPOINT *checkpoint;
+    size_t n_pcrs = selection(&pcrs[0], pcr), n_replayed = 0;
+    TSS2_RC r;
+
+    ifapi_pcr_replay_lookup(cache, list, &pcrs[0], n_pcrs, &checkpoint);
+    if (checkpoint) {
+        n_replayed = checkpoint->n_events;
+        assert_int_equal(pcrs[0].value.buffer[0], expected_tag);
+        assert_int_equal(pcrs[1].value.buffer[0], expected_tag);
+    } else {
+        assert_int_equal(pcrs[0].value.buffer[0], 0);
+    }
+
+    memset(&pcrs[0].value.buffer[0], tag, pcrs[0].value.size);
+    memset(&pcrs[1].value.buffer[0], tag, pcrs[1].value.size);
+    r = ifapi_pcr_replay_store(cache, checkpoint, list, &pcrs[0], n_pcrs);
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    return n_replayed;
+}
+
+static void
+test_hit(void **state)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = new_cache();
+    json_object *list = event_list(3), *longer = event_list(5);
+
+    assert_int_equal(replay(cache, list, 16, 1, 0), 0);
+
+    /* The same list and a list with appended events reuse the checkpoint. */
+    assert_int_equal(replay(cache, list, 16, 1, 1), 3);
+    assert_int_equal(replay(cache, longer, 16, 2, 1), 3);
+    assert_int_equal(replay(cache, longer, 16, 2, 2), 5);
+
+    /* The checkpoint of the shorter list was replaced. */
+    assert_int_equal(replay(cache, list, 16, 1, 0), 0);
+
+    json_object_put(list);
+    json_object_put(longer);
+    ifapi_pcr_replay_cache_free(&cache);
+}
+
+static void
+test_miss(void **state)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = new_cache();
+    json_object *list = event_list(3), *shorter = event_list(2);
+
+    assert_int_equal(replay(cache, list, 16, 1, 0), 0);
+
+    /* Other PCRs and a shorter list don't match. */
+    assert_int_equal(replay(cache, list, 17, 2, 0), 0);
+    assert_int_equal(replay(cache, shorter, 16, 3, 0), 0);
+
+    /* All checkpoints are kept. */
+    assert_int_equal(replay(cache, list, 16, 1, 1), 3);
+    assert_int_equal(replay(cache, list, 17, 2, 2), 3);
+    assert_int_equal(replay(cache, shorter, 16, 3, 3), 2);
+
+    json_object_put(list);
+    json_object_put(shorter);
+    ifapi_pcr_replay_cache_free(&cache);
+}
+
+static void
+test_divergent_prefix(void **state)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = new_cache();
+    json_object *list = event_list(4), *changed = event_list(6), *jso;
+
+    assert_int_equal(replay(cache, list, 16, 1, 0), 0);
+
+    /* An event before the last event of the checkpoint was changed. */
+    json_object_object_add(json_object_array_get_idx(changed, 1), "pcr",
+                           json_object_new_int(17));
+    assert_int_equal(replay(cache, changed, 16, 2, 0), 0);
+
+    /* The first two events were swapped. */
+    json_object_put(changed);
+    changed = event_list(6);
+    jso = json_object_get(json_object_array_get_idx(changed, 0));
+    json_object_array_put_idx(changed, 0,
+                              json_object_get(json_object_array_get_idx(changed, 1)));
+    json_object_array_put_idx(changed, 1, jso);
+    assert_int_equal(replay(cache, changed, 16, 3, 0), 0);
+
+    /* The checkpoints of the changed lists don't match the original list. */
+    assert_int_equal(replay(cache, list, 16, 1, 1), 4);
+
+    json_object_put(list);
+    json_object_put(changed);
+    ifapi_pcr_replay_cache_free(&cache);
+}
+
+static void
+test_longest_checkpoint(void **state)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = new_cache();
+    json_object *lists[5];
+    size_t i;
+
+    for (i = 0; i < 5; i++)
+        lists[i] = event_list(i + 1);
+
+    /* Checkpoints for three events and for one event. */
+    assert_int_equal(replay(cache, lists[2], 16, 3, 0), 0);
+    assert_int_equal(replay(cache, lists[0], 16, 1, 0), 0);
+
+    /* The checkpoint with more events is used. */
+    assert_int_equal(replay(cache, lists[4], 16, 5, 3), 3);
+    assert_int_equal(replay(cache, lists[1], 16, 2, 1), 1);
+
+    /* Fill the cache, the least recently used checkpoint is replaced. */
+    for (i = 0; i < IFAPI_PCR_CHECKPOINTS - 1; i++)
+        assert_int_equal(replay(cache, lists[0], i, 9, 0), 0);
+    assert_int_equal(replay(cache, lists[4], 16, 5, 2), 2);
+
+    for (i = 0; i < 5; i++)
+        json_object_put(lists[i]);
+    ifapi_pcr_replay_cache_free(&cache);
+}
+
+/*
+ * Lists parsed again from their JSON representation share no objects with
+ * the checkpoint; their events are compared by value.
+ */
+static void
+test_parsed_list(void **state)
+{
+    IFAPI_PCR_REPLAY_CACHE *cache = new_cache();
+    json_object *list = event_list(3), *parsed;
+
+    assert_int_equal(replay(cache, list, 16, 1, 0), 0);
+
+    /* The same events with the keys in a different order. */
+    parsed = json_tokener_parse("[ { \"pcr\": 16, \"recnum\": 1 },"
+                                "  { \"pcr\": 16, \"recnum\": 2 },"
+                                "  { \"pcr\": 16, \"recnum\": 3 },"
+                                "  { \"pcr\": 16, \"recnum\": 4 } ]");
+    assert_non_null(parsed);
+    assert_int_equal(replay(cache, parsed, 16, 2, 1), 3);
+    json_object_put(parsed);
+
+    /* Values of another type or an additional key differ. */
+    parsed = json_tokener_parse("[ { \"pcr\": 16, \"recnum\": 1 },"
+                                "  { \"pcr\": \"16\", \"recnum\": 2 },"
+                                "  { \"pcr\": 16, \"recnum\": 3 },"
+                                "  { \"pcr\": 16, \"recnum\": 4 } ]");
+    assert_non_null(parsed);
+    assert_int_equal(replay(cache, parsed, 16, 3, 2), 0);
+    json_object_put(parsed);
+    parsed = json_tokener_parse("[ { \"pcr\": 16, \"recnum\": 1 },"
+                                "  { \"pcr\": 16, \"recnum\": 2 },"
+                                "  { \"pcr\": 16, \"recnum\": 3, \"x\": true },"
+                                "  { \"pcr\": 16, \"recnum\": 4 } ]");
+    assert_non_null(parsed);
+    assert_int_equal(replay(cache, parsed, 16, 4, 2), 0);
+    json_object_put(parsed);
+
+    /* The checkpoint keeps its events after the list was released. */
+    json_object_put(list);
+    list = event_list(5);
+    assert_int_equal(replay(cache, list, 16, 5, 2), 4);
+
+    json_object_put(list);
+    ifapi_pcr_replay_cache_free(&cache);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_hit),
+        cmocka_unit_test(test_miss),
+        cmocka_unit_test(test_divergent_prefix),
+        cmocka_unit_test(test_longest_checkpoint),
+        cmocka_unit_test(test_parsed_list),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
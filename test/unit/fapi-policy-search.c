@@ -0,0 +1,383 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_fapi.h"
+#include "ifapi_policy_search.h"
+#include "ifapi_index.h"
+
+#include "util/aux_util.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the policy search which uses the policy store index to find the
+ * policies for PolicyAuthorize and PolicyAuthorizeNV. The policy store is
+ * simulated by a table of paths and the index key of the stored policy.
+ * Every policy is backed by a file containing the key, thus the index can
+ * detect policies changed behind its back.
+ */
+
+#define MAX_POLICIES 4
+
+static struct {
+    const char *path;
+    const char *key;
+} store[MAX_POLICIES];
+
+static char store_dir[] = "/tmp/fapi-policy-store-XXXXXX";
+static const char *current_key;
+static size_t list_all_calls;
+static size_t load_calls;
+
+/* Copy from ifapi_helpers.c */
+TSS2_RC
+ifapi_asprintf(char **str, const char *fmt, ...)
+{
+    int size = 0;
+    va_list args;
+    va_start(args, fmt);
+    size = vasprintf(str, fmt, args);
+    va_end(args);
+    if (size == -1)
+        return TSS2_FAPI_RC_MEMORY;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_create_dirs(const char *supdir, const char *path)
+{
+    return TSS2_FAPI_RC_IO_ERROR;
+}
+
+void
+ifapi_cleanup_policy(TPMS_POLICY *policy)
+{
+    SAFE_FREE(policy->description);
+}
+
+TSS2_RC
+ifapi_keystore_list_all(
+    IFAPI_KEYSTORE *keystore,
+    const char *searchpath,
+    char ***results,
+    size_t *numresults)
+{
+    size_t i;
+
+    list_all_calls += 1;
+    *numresults = 0;
+    *results = calloc(MAX_POLICIES, sizeof(char *));
+    assert_non_null(*results);
+    for (i = 0; i < MAX_POLICIES; i++) {
+        if (store[i].path)
+            (*results)[(*numresults)++] = strdup(store[i].path);
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_policy_store_file(
+    IFAPI_POLICY_STORE *pstore,
+    const char *path,
+    char **file)
+{
+    return ifapi_asprintf(file, "%s/%s", store_dir, strrchr(path, '/') + 1);
+}
+
+TSS2_RC
+ifapi_policy_store_load_async(
+    IFAPI_POLICY_STORE *pstore,
+    IFAPI_IO *io,
+    const char *path)
+{
+    size_t i;
+
+    load_calls += 1;
+    for (i = 0; i < MAX_POLICIES; i++) {
+        if (store[i].path && strcmp(store[i].path, path) == 0) {
+            current_key = store[i].key;
+            return TSS2_RC_SUCCESS;
+        }
+    }
+    return TSS2_FAPI_RC_PATH_NOT_FOUND;
+}
+
+TSS2_RC
+ifapi_policy_store_load_finish(
+    IFAPI_POLICY_STORE *pstore,
+    IFAPI_IO *io,
+    TPMS_POLICY *policy)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->description = strdup(current_key);
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+ifapi_policy_store_index_keys(
+    const TPMS_POLICY *policy,
+    char **keys)
+{
+    *keys = strdup(policy->description);
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+compare_key(TPMS_POLICY *policy, void *object1, void *object2, bool *found)
+{
+    *found = strcmp(policy->description, object1) == 0;
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+index_key(void *object1, void *object2, char **key)
+{
+    *key = strdup(object1);
+    return TSS2_RC_SUCCESS;
+}
+
+/* Store a policy or remove it if path is NULL. */
+static void
+store_policy(size_t i, const char *path, const char *key)
+{
+    char *file = NULL;
+    FILE *stream;
+
+    if (store[i].path) {
+        ifapi_policy_store_file(NULL, store[i].path, &file);
+        unlink(file);
+        SAFE_FREE(file);
+    }
+    store[i].path = path;
+    store[i].key = key;
+    if (!path)
+        return;
+
+    assert_int_equal(ifapi_policy_store_file(NULL, path, &file), TSS2_RC_SUCCESS);
+    stream = fopen(file, "w");
+    assert_non_null(stream);
+    fputs(key, stream);
+    fclose(stream);
+    free(file);
+}
+
+static int
+setup(void **state)
+{
+    FAPI_CONTEXT *context;
+
+    strcpy(&store_dir[0], "/tmp/fapi-policy-store-XXXXXX");
+    if (!mkdtemp(store_dir))
+        return -1;
+
+    context = calloc(1, sizeof(FAPI_CONTEXT));
+    if (!context)
+        return -1;
+    if (ifapi_asprintf(&context->pstore.index_file, "%s/.index",
+                       store_dir) != TSS2_RC_SUCCESS)
+        return -1;
+    memset(store, 0, sizeof(store));
+    list_all_calls = 0;
+    load_calls = 0;
+    *state = context;
+    return 0;
+}
+
+static int
+teardown(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+    size_t i;
+
+    for (i = 0; i < MAX_POLICIES; i++)
+        store_policy(i, NULL, NULL);
+    unlink(context->pstore.index_file);
+    rmdir(store_dir);
+    free(context->pstore.index_file);
+    free(context);
+    return 0;
+}
+
+/* Run a search and return the number of policies found. */
+static size_t
+search(FAPI_CONTEXT *context, const char *key, bool all_objects, TSS2_RC expected_rc)
+{
+    struct POLICY_LIST *found = NULL, *branch;
+    size_t n = 0;
+    TSS2_RC r;
+
+    do {
+        r = ifapi_policy_search(context, compare_key, index_key, all_objects,
+                                (void *)key, NULL, &found);
+    } while (r == TSS2_FAPI_RC_TRY_AGAIN);
+    assert_int_equal(r, expected_rc);
+
+    for (branch = found; branch; branch = branch->next) {
+        assert_string_equal(branch->policy.description, key);
+        n += 1;
+    }
+    ifapi_cleanup_policy_list(found);
+    return n;
+}
+
+static void
+test_missing_index(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+
+    store_policy(0, "/policy/pol_a", "digest:aa");
+    store_policy(1, "/policy/pol_b", "digest:bb");
+
+    /* Without an index all policies are read and the index is created. */
+    assert_int_equal(search(context, "digest:bb", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(list_all_calls, 1);
+    assert_int_equal(load_calls, 2);
+
+    /* The policy is found via the index. */
+    assert_int_equal(search(context, "digest:bb", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(list_all_calls, 1);
+    assert_int_equal(load_calls, 3);
+
+    /* A miss in the complete index lists the store but reads no policy. */
+    assert_int_equal(search(context, "digest:cc", false,
+                            TSS2_FAPI_RC_POLICY_UNKNOWN), 0);
+    assert_int_equal(search(context, "digest:cc", true,
+                            TSS2_FAPI_RC_POLICY_UNKNOWN), 0);
+    assert_int_equal(list_all_calls, 3);
+    assert_int_equal(load_calls, 3);
+}
+
+static void
+test_policy_copied(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+    TSS2_RC r;
+
+    store_policy(0, "/policy/pol_a", "auth:01");
+    store_policy(1, "/policy/pol_b", "auth:02");
+
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(load_calls, 2);
+
+    /* Policies copied into the policy directory are found ... */
+    store_policy(2, "/policy/pol_c", "auth:01");
+    store_policy(3, "/policy/pol_d", "digest:dd");
+    assert_int_equal(search(context, "digest:dd", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 2);
+
+    /* ... by reading only them once, afterwards they are indexed. */
+    assert_int_equal(load_calls, 2 + 2 + 2);
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 2);
+    assert_int_equal(search(context, "digest:dd", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(load_calls, 6 + 2 + 1);
+
+    /* A policy replaced in place is read again. */
+    store_policy(1, "/policy/pol_b", "auth:01");
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 3);
+    assert_int_equal(load_calls, 9 + 2 + 1);
+
+    /* A record without the version of the file, e.g. from an older release,
+       is not trusted, but the policy is returned only once. */
+    r = ifapi_index_update(context->pstore.index_file, "/policy/pol_a", NULL,
+                           "auth:01");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 3);
+    assert_int_equal(load_calls, 12 + 3 + 1);
+    assert_int_equal(list_all_calls, 6);
+}
+
+static void
+test_index_hit(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+
+    store_policy(0, "/policy/pol_a", "auth:01");
+    store_policy(1, "/policy/pol_b", "auth:02");
+    store_policy(2, "/policy/pol_c", "auth:01");
+
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 2);
+    assert_int_equal(list_all_calls, 1);
+
+    /* All policies are taken from the complete index. */
+    assert_int_equal(load_calls, 3);
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 2);
+    assert_int_equal(search(context, "auth:02", true, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(load_calls, 3 + 2 + 1);
+}
+
+static void
+test_partial_index(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+    TSS2_RC r;
+
+    store_policy(0, "/policy/pol_a", "auth:01");
+    store_policy(1, "/policy/pol_b", "auth:01");
+
+    /* An index which only knows the policies stored since its creation. */
+    r = ifapi_index_update(context->pstore.index_file, "/policy/pol_a", NULL,
+                           "auth:01");
+    assert_int_equal(r, TSS2_RC_SUCCESS);
+
+    /* The first policy can be taken from a partial index. */
+    assert_int_equal(search(context, "auth:01", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(list_all_calls, 0);
+
+    /* The candidates of a partial index are not all policies. */
+    assert_int_equal(search(context, "auth:01", true, TSS2_RC_SUCCESS), 2);
+    assert_int_equal(list_all_calls, 1);
+}
+
+static void
+test_stale_index(void **state)
+{
+    FAPI_CONTEXT *context = *state;
+
+    store_policy(0, "/policy/pol_a", "digest:aa");
+    store_policy(1, "/policy/pol_b", "digest:aa");
+
+    assert_int_equal(search(context, "digest:aa", true, TSS2_RC_SUCCESS), 2);
+    assert_int_equal(list_all_calls, 1);
+
+    /* The store was changed without updating the index. */
+    store_policy(0, "/policy/pol_a", "digest:bb");
+    store_policy(1, NULL, NULL);
+    store_policy(2, "/policy/pol_c", "digest:aa");
+
+    assert_int_equal(search(context, "digest:aa", true, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(list_all_calls, 2);
+    assert_int_equal(search(context, "digest:bb", false, TSS2_RC_SUCCESS), 1);
+    assert_int_equal(list_all_calls, 2);
+
+    /* A policy which does not match its index entry is not trusted. */
+    store_policy(0, "/policy/pol_a", "digest:cc");
+    assert_int_equal(search(context, "digest:bb", false,
+                            TSS2_FAPI_RC_POLICY_UNKNOWN), 0);
+    assert_int_equal(list_all_calls, 3);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_missing_index, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_index_hit, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_partial_index, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_stale_index, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_policy_copied, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
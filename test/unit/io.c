@@ -65,6 +65,37 @@ __wrap_write (int fd, const void *buffer, size_t buffer_size)
     return mock_type (ssize_t);
 }
 
+/*
+ * Wrap the 'readv' system call. The buffers are filled with an increasing
+ * byte pattern so that the tests can check where the data ended up. A
+ * negative return value simulates a non-blocking descriptor without data.
+ */
+static uint8_t readv_pattern;
+ssize_t
+__wrap_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+    ssize_t r = mock_type (ssize_t);
+    ssize_t left = r;
+    size_t i;
+    int j;
+
+    if (r < 0)
+        errno = EAGAIN;
+    for (j = 0; j < iovcnt && left > 0; j++) {
+        for (i = 0; i < iov[j].iov_len && left > 0; i++, left--) {
+            ((uint8_t *)iov[j].iov_base)[i] = readv_pattern++;
+        }
+    }
+    return r;
+}
+
+ssize_t
+__wrap_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+    LOG_DEBUG ("writing %d buffers to fd: %d", iovcnt, fd);
+    return mock_type (ssize_t);
+}
+
 /*
  * A test case for a successful call to the receive function. This requires
  * that the context and the command buffer be valid (including the size
@@ -112,6 +143,97 @@ read_all_twice_eof (void **state)
     ret = read_all (10, buf, 10);
     assert_int_equal (ret, 5);
 }
+/*
+ * A short gather write is completed by another call with the remaining data.
+ */
+static void
+writev_all_short_write_test (void **state)
+{
+    ssize_t ret;
+    uint8_t buf1 [9], buf2 [12];
+    struct iovec iov [] = {
+        { .iov_base = buf1, .iov_len = sizeof (buf1) },
+        { .iov_base = buf2, .iov_len = sizeof (buf2) },
+    };
+
+    will_return (__wrap_writev, 5);
+    will_return (__wrap_writev, 16);
+    ret = writev_all (99, iov, 2);
+    assert_int_equal (ret, sizeof (buf1) + sizeof (buf2));
+
+    /* A failing write returns the number of bytes written before. */
+    iov[0].iov_base = buf1;
+    iov[0].iov_len = sizeof (buf1);
+    iov[1].iov_base = buf2;
+    iov[1].iov_len = sizeof (buf2);
+    will_return (__wrap_writev, 9);
+    will_return (__wrap_writev, -1);
+    ret = writev_all (99, iov, 2);
+    assert_int_equal (ret, sizeof (buf1));
+}
+/*
+ * A scatter read fills all buffers in order, also when the data arrives in
+ * pieces. Empty buffers are skipped.
+ */
+static void
+readv_all_scatter_test (void **state)
+{
+    ssize_t ret;
+    uint8_t buf1 [4] = { 0 }, buf2 [6] = { 0 };
+    uint8_t expected1 [] = { 0, 1, 2, 3 };
+    uint8_t expected2 [] = { 4, 5, 6, 7, 8, 9 };
+    struct iovec iov [] = {
+        { .iov_base = NULL, .iov_len = 0 },
+        { .iov_base = buf1, .iov_len = sizeof (buf1) },
+        { .iov_base = buf2, .iov_len = sizeof (buf2) },
+    };
+
+    readv_pattern = 0;
+    will_return (__wrap_readv, 6);
+    will_return (__wrap_readv, 4);
+    ret = readv_all (99, iov, 3);
+    assert_int_equal (ret, sizeof (buf1) + sizeof (buf2));
+    assert_memory_equal (buf1, expected1, sizeof (buf1));
+    assert_memory_equal (buf2, expected2, sizeof (buf2));
+}
+/*
+ * EOF before all buffers are filled returns the number of bytes read.
+ */
+static void
+readv_all_eof_test (void **state)
+{
+    ssize_t ret;
+    uint8_t buf1 [4], buf2 [6];
+    struct iovec iov [] = {
+        { .iov_base = buf1, .iov_len = sizeof (buf1) },
+        { .iov_base = buf2, .iov_len = sizeof (buf2) },
+    };
+
+    will_return (__wrap_readv, 5);
+    will_return (__wrap_readv, 0);
+    ret = readv_all (99, iov, 2);
+    assert_int_equal (ret, 5);
+}
+/*
+ * If the rest of the data has not arrived on a non-blocking descriptor, the
+ * number of bytes read is returned without waiting and errno is EAGAIN.
+ */
+static void
+readv_all_eagain_test (void **state)
+{
+    ssize_t ret;
+    uint8_t buf1 [4], buf2 [6];
+    struct iovec iov [] = {
+        { .iov_base = buf1, .iov_len = sizeof (buf1) },
+        { .iov_base = buf2, .iov_len = sizeof (buf2) },
+    };
+
+    will_return (__wrap_readv, 5);
+    will_return (__wrap_readv, -1);
+    ret = readv_all (99, iov, 2);
+    assert_int_equal (ret, 5);
+    assert_int_equal (errno, EAGAIN);
+}
 /* When passed all NULL values ensure that we get back the expected RC. */
 static void
 socket_connect_test (void **state)
@@ -200,6 +322,46 @@ socket_connect_null_test (void **state)
     assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
 }
 
+static void
+socket_connect_unix_test (void **state)
+{
+    TSS2_RC rc;
+    SOCKET sock;
+
+    will_return (__wrap_socket, 0);
+    will_return (__wrap_socket, 1);
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_connect, 1);
+    rc = socket_connect_unix ("/run/swtpm/tpm.sock", &sock);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+static void
+socket_connect_unix_fail_test (void **state)
+{
+    TSS2_RC rc;
+    SOCKET sock;
+    char path [sizeof (((struct sockaddr_un *)NULL)->sun_path) + 1];
+
+    rc = socket_connect_unix (NULL, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_REFERENCE);
+
+    memset (path, 'a', sizeof (path) - 1);
+    path [sizeof (path) - 1] = '\0';
+    rc = socket_connect_unix (path, &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    will_return (__wrap_socket, EINVAL);
+    will_return (__wrap_socket, -1);
+    rc = socket_connect_unix ("/run/swtpm/tpm.sock", &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+
+    will_return (__wrap_socket, 0);
+    will_return (__wrap_socket, 99);
+    will_return (__wrap_connect, ENOENT);
+    will_return (__wrap_connect, -1);
+    rc = socket_connect_unix ("/run/swtpm/tpm.sock", &sock);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+}
 int
 main (int   argc,
       char *argv[])
@@ -208,6 +370,10 @@ main (int   argc,
         cmocka_unit_test (write_all_simple_success_test),
         cmocka_unit_test (read_all_eof_test),
         cmocka_unit_test (read_all_twice_eof),
+        cmocka_unit_test (writev_all_short_write_test),
+        cmocka_unit_test (readv_all_scatter_test),
+        cmocka_unit_test (readv_all_eof_test),
+        cmocka_unit_test (readv_all_eagain_test),
         cmocka_unit_test (socket_connect_test),
         cmocka_unit_test (socket_connect_null_test),
         cmocka_unit_test (socket_connect_socket_fail_test),
@@ -215,6 +381,8 @@ main (int   argc,
         cmocka_unit_test (socket_ipv6_connect_test),
         cmocka_unit_test (socket_ipv6_connect_socket_fail_test),
         cmocka_unit_test (socket_ipv6_connect_connect_fail_test),
+        cmocka_unit_test (socket_connect_unix_test),
+        cmocka_unit_test (socket_connect_unix_fail_test),
     };
     return cmocka_run_group_tests (tests, NULL, NULL);
 }
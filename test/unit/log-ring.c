@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "util/log-ring.h"
+#define LOGMODULE test
+#include "util/log.h"
+
+/*
+ * Tests for the trace ring backend of the log macros. The backend is enabled
+ * once per process, so main sets the environment before the first message.
+ * The backend writes to /dev/null at thread and process exit, the tests
+ * dump the rings to temporary files themselves.
+ */
+
+#define RING_SIZE 16
+
+typedef struct {
+    log_ring_header header;
+    log_ring_record records[RING_SIZE];
+} ring_segment;
+
+/* Dump the rings and read back the segment of the calling thread. */
+static void
+dump_ring(ring_segment *segment)
+{
+    FILE *file = tmpfile();
+    size_t n;
+
+    assert_non_null(file);
+    assert_int_equal(log_ring_dump(fileno(file)), 0);
+    rewind(file);
+
+    n = fread(&segment->header, sizeof(segment->header), 1, file);
+    assert_int_equal(n, 1);
+    assert_memory_equal(segment->header.magic, LOG_RING_MAGIC,
+                        sizeof(segment->header.magic));
+    assert_int_equal(segment->header.version, LOG_RING_VERSION);
+    assert_int_equal(segment->header.record_size, sizeof(log_ring_record));
+    assert_true(segment->header.count <= RING_SIZE);
+
+    n = fread(segment->records, sizeof(log_ring_record),
+              segment->header.count, file);
+    assert_int_equal(n, segment->header.count);
+    /* This test runs a single thread, so there is exactly one segment. */
+    assert_int_equal(fgetc(file), EOF);
+    fclose(file);
+}
+
+static void
+test_record(void **state)
+{
+    ring_segment segment;
+    log_ring_record *rec;
+    uint8_t blob[64];
+    int i;
+
+    for (i = 0; i < (int)sizeof(blob); i++)
+        blob[i] = i;
+
+    LOG_DEBUG("message %i", 42);
+    LOGBLOB_DEBUG(blob, sizeof(blob), "blob");
+    LOG_TRACE("filtered");
+
+    dump_ring(&segment);
+    assert_int_equal(segment.header.count, 2);
+    assert_int_equal(segment.header.dropped, 0);
+
+    rec = &segment.records[0];
+    assert_int_equal(rec->seq, 1);
+    assert_int_equal(rec->level, LOGLEVEL_DEBUG);
+    assert_string_equal(rec->module, "test");
+    assert_string_equal(rec->file, "log-ring.c");
+    assert_string_equal(rec->func, "test_record");
+    assert_string_equal(rec->msg, "message 42");
+    assert_int_equal(rec->blob_size, 0);
+    assert_int_equal(rec->blob_len, 0);
+    assert_true(rec->timestamp > 0);
+
+    rec = &segment.records[1];
+    assert_int_equal(rec->seq, 2);
+    assert_string_equal(rec->msg, "blob");
+    assert_int_equal(rec->blob_size, sizeof(blob));
+    assert_int_equal(rec->blob_len, LOG_RING_BLOB_LEN);
+    assert_memory_equal(rec->blob, blob, LOG_RING_BLOB_LEN);
+    assert_true(rec->timestamp >= segment.records[0].timestamp);
+}
+
+static void
+test_truncate(void **state)
+{
+    ring_segment segment;
+    char msg[2 * LOG_RING_MSG_LEN];
+    log_ring_record *rec;
+
+    memset(msg, 'x', sizeof(msg) - 1);
+    msg[sizeof(msg) - 1] = '\0';
+    LOG_ERROR("%s", msg);
+
+    dump_ring(&segment);
+    rec = &segment.records[segment.header.count - 1];
+    assert_int_equal(rec->level, LOGLEVEL_ERROR);
+    assert_int_equal(strlen(rec->msg), LOG_RING_MSG_LEN - 1);
+    assert_memory_equal(rec->msg, msg, LOG_RING_MSG_LEN - 1);
+}
+
+static void
+test_wrap(void **state)
+{
+    ring_segment segment;
+    char expected[LOG_RING_MSG_LEN];
+    int i;
+
+    for (i = 0; i < 3 * RING_SIZE; i++)
+        LOG_DEBUG("wrap %i", i);
+
+    dump_ring(&segment);
+    assert_int_equal(segment.header.count, RING_SIZE);
+    assert_true(segment.header.dropped > 0);
+    for (i = 1; i < RING_SIZE; i++)
+        assert_int_equal(segment.records[i].seq,
+                         segment.records[i - 1].seq + 1);
+    snprintf(expected, sizeof(expected), "wrap %i", 3 * RING_SIZE - 1);
+    assert_string_equal(segment.records[RING_SIZE - 1].msg, expected);
+}
+
+#ifdef HAVE_PTHREAD
+/* Check whether a dump of the rings holds a message. */
+static bool
+dump_contains(const char *msg)
+{
+    FILE *file = tmpfile();
+    log_ring_header header;
+    log_ring_record record;
+    bool found = false;
+
+    if (file == NULL)
+        return false;
+    if (log_ring_dump(fileno(file)) == 0) {
+        rewind(file);
+        while (fread(&header, sizeof(header), 1, file) == 1) {
+            for (uint64_t i = 0; i < header.count; i++) {
+                if (fread(&record, sizeof(record), 1, file) != 1)
+                    break;
+                if (strcmp(record.msg, msg) == 0)
+                    found = true;
+            }
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+static void *
+log_thread(void *arg)
+{
+    char msg[LOG_RING_MSG_LEN];
+
+    snprintf(msg, sizeof(msg), "thread %i", *(int *)arg);
+    LOG_DEBUG("%s", msg);
+    return dump_contains(msg) ? arg : NULL;
+}
+
+/*
+ * The rings of exited threads are emptied and reused, so more threads than
+ * LOG_RING_MAX_RINGS can log one after the other.
+ */
+static void
+test_thread_exit(void **state)
+{
+    ring_segment segment;
+    pthread_t thread;
+    void *result;
+    int i;
+
+    for (i = 0; i < 2 * LOG_RING_MAX_RINGS; i++) {
+        assert_int_equal(pthread_create(&thread, NULL, log_thread, &i), 0);
+        assert_int_equal(pthread_join(thread, &result), 0);
+        assert_ptr_equal(result, &i);
+    }
+
+    /* Only the ring of this thread holds records. */
+    LOG_DEBUG("main");
+    dump_ring(&segment);
+    assert_string_equal(segment.records[segment.header.count - 1].msg, "main");
+}
+#endif /* HAVE_PTHREAD */
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_record),
+        cmocka_unit_test(test_truncate),
+        cmocka_unit_test(test_wrap),
+#ifdef HAVE_PTHREAD
+        cmocka_unit_test(test_thread_exit),
+#endif
+    };
+
+    setenv("TSS2_LOG", "test+debug", 1);
+    setenv("TSS2_LOG_RING", "/dev/null", 1);
+    setenv("TSS2_LOG_RING_SIZE", "16", 1);
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
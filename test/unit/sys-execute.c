@@ -75,6 +75,10 @@ tcti_transmit(
 
 #define NUM_OF_RETRIES 4
 
+/* Number of calls to the TCTI receive function and size queries among them */
+static size_t receive_calls;
+static size_t size_queries;
+
 static TSS2_RC
 tcti_receive(
     TSS2_TCTI_CONTEXT *tctiContext,
@@ -87,11 +91,16 @@ tcti_receive(
     LOG_DEBUG ("%s: receiving response, size %zu, buff %p",
                __func__, sizeof(ok_response), response);
 
+    receive_calls++;
     if (response == NULL) {
+        size_queries++;
         *size = sizeof(ok_response);
         return TPM2_RC_SUCCESS;
     }
 
+    if (*size < sizeof(ok_response))
+        return TSS2_TCTI_RC_INSUFFICIENT_BUFFER;
+
     if (i++ < NUM_OF_RETRIES) {
         LOG_DEBUG ("%s: return RC_RETRY", __func__);
         memcpy(response, retry_response, sizeof(retry_response));
@@ -158,11 +167,40 @@ test_resubmit(void **state)
     return;
 }
 
+/*
+ * Each command must be completed with a single call to the TCTI receive
+ * function that places the response directly into the command buffer of
+ * the SYS context, without querying the response size first.
+ */
+#define NUM_OF_COMMANDS 100
+
+static void
+test_receive_calls(void **state)
+{
+    TSS2_RC r = 0;
+    TSS2_SYS_CONTEXT *sys_ctx = (TSS2_SYS_CONTEXT *)*state;
+    TPM2B_DIGEST random = { 0 };
+    size_t i;
+
+    receive_calls = 0;
+    size_queries = 0;
+    for (i = 0; i < NUM_OF_COMMANDS; i++) {
+        do {
+            r = Tss2_Sys_GetRandom(sys_ctx, NULL, 32, &random, NULL);
+        } while (r == TPM2_RC_RETRY);
+        assert_int_equal(r, TSS2_RC_SUCCESS);
+        assert_int_equal(random.size, 32);
+    }
+    assert_int_equal(size_queries, 0);
+    assert_true(receive_calls <= NUM_OF_COMMANDS + NUM_OF_RETRIES);
+}
+
 int
 main(int argc, char *argv[])
 {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(test_resubmit, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_receive_calls, setup, teardown),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_mu.h"
+#include "sysapi_mu.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests for the fast path marshaling functions used by the SYS layer. The
+ * output has to be identical to the one of the Tss2_MU_* functions. The
+ * time per operation is reported by test/bench/sys-mu-fast.
+ */
+
+#define BUFFER_SIZE 4096
+
+static void
+template_rsa(TPM2B_PUBLIC *pub)
+{
+    memset(pub, 0, sizeof(*pub));
+    pub->publicArea.type = TPM2_ALG_RSA;
+    pub->publicArea.nameAlg = TPM2_ALG_SHA256;
+    pub->publicArea.objectAttributes = TPMA_OBJECT_USERWITHAUTH |
+        TPMA_OBJECT_RESTRICTED | TPMA_OBJECT_DECRYPT |
+        TPMA_OBJECT_FIXEDTPM | TPMA_OBJECT_FIXEDPARENT |
+        TPMA_OBJECT_SENSITIVEDATAORIGIN;
+    pub->publicArea.authPolicy.size = 32;
+    memset(pub->publicArea.authPolicy.buffer, 0xa5, 32);
+    pub->publicArea.parameters.rsaDetail.symmetric.algorithm = TPM2_ALG_AES;
+    pub->publicArea.parameters.rsaDetail.symmetric.keyBits.aes = 128;
+    pub->publicArea.parameters.rsaDetail.symmetric.mode.aes = TPM2_ALG_CFB;
+    pub->publicArea.parameters.rsaDetail.scheme.scheme = TPM2_ALG_NULL;
+    pub->publicArea.parameters.rsaDetail.keyBits = 2048;
+    pub->publicArea.parameters.rsaDetail.exponent = 0;
+    pub->publicArea.unique.rsa.size = 256;
+    memset(pub->publicArea.unique.rsa.buffer, 0x5a, 256);
+}
+
+static void
+template_ecc(TPM2B_PUBLIC *pub)
+{
+    memset(pub, 0, sizeof(*pub));
+    pub->publicArea.type = TPM2_ALG_ECC;
+    pub->publicArea.nameAlg = TPM2_ALG_SHA256;
+    pub->publicArea.objectAttributes = TPMA_OBJECT_USERWITHAUTH |
+        TPMA_OBJECT_SIGN_ENCRYPT | TPMA_OBJECT_SENSITIVEDATAORIGIN;
+    pub->publicArea.parameters.eccDetail.symmetric.algorithm = TPM2_ALG_NULL;
+    pub->publicArea.parameters.eccDetail.scheme.scheme = TPM2_ALG_ECDAA;
+    pub->publicArea.parameters.eccDetail.scheme.details.ecdaa.hashAlg = TPM2_ALG_SHA256;
+    pub->publicArea.parameters.eccDetail.scheme.details.ecdaa.count = 7;
+    pub->publicArea.parameters.eccDetail.curveID = TPM2_ECC_NIST_P256;
+    pub->publicArea.parameters.eccDetail.kdf.scheme = TPM2_ALG_KDF1_SP800_108;
+    pub->publicArea.parameters.eccDetail.kdf.details.kdf1_sp800_108.hashAlg = TPM2_ALG_SHA1;
+    pub->publicArea.unique.ecc.x.size = 32;
+    memset(pub->publicArea.unique.ecc.x.buffer, 0x11, 32);
+    pub->publicArea.unique.ecc.y.size = 32;
+    memset(pub->publicArea.unique.ecc.y.buffer, 0x22, 32);
+}
+
+static void
+template_keyedhash(TPM2B_PUBLIC *pub)
+{
+    memset(pub, 0, sizeof(*pub));
+    pub->publicArea.type = TPM2_ALG_KEYEDHASH;
+    pub->publicArea.nameAlg = TPM2_ALG_SHA1;
+    pub->publicArea.objectAttributes = TPMA_OBJECT_SIGN_ENCRYPT;
+    pub->publicArea.parameters.keyedHashDetail.scheme.scheme = TPM2_ALG_XOR;
+    pub->publicArea.parameters.keyedHashDetail.scheme.details.exclusiveOr.hashAlg = TPM2_ALG_SHA256;
+    pub->publicArea.parameters.keyedHashDetail.scheme.details.exclusiveOr.kdf = TPM2_ALG_KDF1_SP800_108;
+    pub->publicArea.unique.keyedHash.size = 20;
+}
+
+static void
+template_symcipher(TPM2B_PUBLIC *pub)
+{
+    memset(pub, 0, sizeof(*pub));
+    pub->publicArea.type = TPM2_ALG_SYMCIPHER;
+    pub->publicArea.nameAlg = TPM2_ALG_SHA256;
+    pub->publicArea.objectAttributes = TPMA_OBJECT_DECRYPT;
+    pub->publicArea.parameters.symDetail.sym.algorithm = TPM2_ALG_XOR;
+    pub->publicArea.parameters.symDetail.sym.keyBits.exclusiveOr = TPM2_ALG_SHA256;
+}
+
+static void
+pcr_selection(TPML_PCR_SELECTION *sel)
+{
+    memset(sel, 0, sizeof(*sel));
+    sel->count = 3;
+    sel->pcrSelections[0].hash = TPM2_ALG_SHA1;
+    sel->pcrSelections[0].sizeofSelect = 3;
+    sel->pcrSelections[0].pcrSelect[0] = 0xff;
+    sel->pcrSelections[1].hash = TPM2_ALG_SHA256;
+    sel->pcrSelections[1].sizeofSelect = 4;
+    sel->pcrSelections[1].pcrSelect[3] = 0x80;
+    sel->pcrSelections[2].hash = TPM2_ALG_SHA384;
+    sel->pcrSelections[2].sizeofSelect = 0;
+}
+
+/* Marshal pub with both variants and compare the results. */
+static void
+check_public(const TPM2B_PUBLIC *pub, size_t start)
+{
+    uint8_t slow[BUFFER_SIZE], fast[BUFFER_SIZE];
+    size_t slow_offset = start, fast_offset = start;
+    TSS2_RC slow_rc, fast_rc;
+
+    memset(slow, 0, sizeof(slow));
+    memset(fast, 0, sizeof(fast));
+    slow_rc = Tss2_MU_TPM2B_PUBLIC_Marshal(pub, slow, sizeof(slow), &slow_offset);
+    fast_rc = FastMarshal_TPM2B_PUBLIC(pub, fast, sizeof(fast), &fast_offset);
+    assert_int_equal(fast_rc, slow_rc);
+    assert_int_equal(fast_offset, slow_offset);
+    /* The content of the buffer is undefined if an error is returned. */
+    if (slow_rc == TSS2_RC_SUCCESS)
+        assert_memory_equal(fast, slow, sizeof(slow));
+}
+
+static void
+test_marshal_public(void **state)
+{
+    TPM2B_PUBLIC pub;
+
+    template_rsa(&pub);
+    check_public(&pub, 10);
+    /* Too close to the end of the buffer for the fast path. */
+    check_public(&pub, BUFFER_SIZE - 300);
+    check_public(&pub, BUFFER_SIZE - 100);
+
+    template_ecc(&pub);
+    check_public(&pub, 0);
+    template_keyedhash(&pub);
+    check_public(&pub, 0);
+    template_symcipher(&pub);
+    check_public(&pub, 0);
+
+    pub.publicArea.type = TPM2_ALG_NULL;
+    check_public(&pub, 0);
+}
+
+static void
+test_marshal_public_bad_value(void **state)
+{
+    TPM2B_PUBLIC pub;
+
+    template_rsa(&pub);
+    pub.publicArea.type = TPM2_ALG_SHA256;
+    check_public(&pub, 0);
+
+    template_ecc(&pub);
+    pub.publicArea.parameters.eccDetail.kdf.scheme = TPM2_ALG_AES;
+    check_public(&pub, 0);
+
+    template_rsa(&pub);
+    pub.publicArea.unique.rsa.size = sizeof(pub.publicArea.unique.rsa.buffer) + 1;
+    check_public(&pub, 0);
+}
+
+static void
+check_pcr_selection(const TPML_PCR_SELECTION *sel, size_t start)
+{
+    uint8_t slow[BUFFER_SIZE], fast[BUFFER_SIZE];
+    size_t slow_offset = start, fast_offset = start;
+    TPML_PCR_SELECTION slow_sel, fast_sel;
+    TSS2_RC slow_rc, fast_rc;
+
+    memset(slow, 0, sizeof(slow));
+    memset(fast, 0, sizeof(fast));
+    slow_rc = Tss2_MU_TPML_PCR_SELECTION_Marshal(sel, slow, sizeof(slow),
+                                                 &slow_offset);
+    fast_rc = FastMarshal_TPML_PCR_SELECTION(sel, fast, sizeof(fast),
+                                             &fast_offset);
+    assert_int_equal(fast_rc, slow_rc);
+    assert_int_equal(fast_offset, slow_offset);
+    if (slow_rc)
+        return;
+    assert_memory_equal(fast, slow, sizeof(slow));
+
+    slow_offset = fast_offset = start;
+    memset(&slow_sel, 0xff, sizeof(slow_sel));
+    memset(&fast_sel, 0xff, sizeof(fast_sel));
+    slow_rc = Tss2_MU_TPML_PCR_SELECTION_Unmarshal(slow, sizeof(slow),
+                                                   &slow_offset, &slow_sel);
+    fast_rc = FastUnmarshal_TPML_PCR_SELECTION(slow, sizeof(slow),
+                                               &fast_offset, &fast_sel);
+    assert_int_equal(fast_rc, slow_rc);
+    assert_int_equal(fast_offset, slow_offset);
+    assert_memory_equal(&fast_sel, &slow_sel, sizeof(slow_sel));
+
+    /* Skip the selection without storing it. */
+    fast_offset = start;
+    fast_rc = FastUnmarshal_TPML_PCR_SELECTION(slow, sizeof(slow),
+                                               &fast_offset, NULL);
+    assert_int_equal(fast_rc, TSS2_RC_SUCCESS);
+    assert_int_equal(fast_offset, slow_offset);
+}
+
+static void
+test_pcr_selection(void **state)
+{
+    TPML_PCR_SELECTION sel;
+
+    pcr_selection(&sel);
+    check_pcr_selection(&sel, 0);
+    check_pcr_selection(&sel, BUFFER_SIZE - 30);
+
+    sel.count = 0;
+    check_pcr_selection(&sel, 0);
+
+    sel.count = TPM2_NUM_PCR_BANKS + 1;
+    check_pcr_selection(&sel, 0);
+
+    pcr_selection(&sel);
+    sel.pcrSelections[1].sizeofSelect = TPM2_PCR_SELECT_MAX + 1;
+    check_pcr_selection(&sel, 0);
+}
+
+static void
+test_unmarshal_pcr_selection_malformed(void **state)
+{
+    uint8_t buffer[BUFFER_SIZE] = { 0 };
+    size_t slow_offset = 0, fast_offset = 0;
+    TPML_PCR_SELECTION slow_sel, fast_sel;
+
+    /* One bank with a sizeofSelect of 0xff */
+    buffer[3] = 1;
+    buffer[4] = 0x00;
+    buffer[5] = 0x0b;
+    buffer[6] = 0xff;
+    assert_int_equal(FastUnmarshal_TPML_PCR_SELECTION(buffer, sizeof(buffer),
+                                                      &fast_offset, &fast_sel),
+                     Tss2_MU_TPML_PCR_SELECTION_Unmarshal(buffer, sizeof(buffer),
+                                                          &slow_offset, &slow_sel));
+    assert_int_equal(fast_offset, slow_offset);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_marshal_public),
+        cmocka_unit_test(test_marshal_public_bad_value),
+        cmocka_unit_test(test_pcr_selection),
+        cmocka_unit_test(test_unmarshal_pcr_selection_malformed),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
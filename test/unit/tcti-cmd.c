@@ -15,6 +15,8 @@
 #include <string.h>
 
 #include <cmocka.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <signal.h>
 
@@ -23,6 +25,7 @@
 #else
 #include <sys/prctl.h>
 #endif
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/time.h>
@@ -69,15 +72,15 @@ int tcti_cmd_fork (void)
     return -1;
 }
 
-FILE *tcti_cmd_fdopen (int fd, const char *mode)
+int tcti_cmd_fcntl (int fd, int cmd, int arg)
 {
     int rc = mock_type (int);
     if (!rc) {
-        return fdopen (fd, mode);
+        return fcntl (fd, cmd, arg);
     }
 
     errno = rc;
-    return NULL;
+    return -1;
 }
 
 int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
@@ -91,35 +94,22 @@ int tcti_cmd_sigprocmask (int how, const sigset_t *set, sigset_t *oldset)
     return -1;
 }
 
-int tcti_cmd_ferror (FILE *stream)
+ssize_t tcti_cmd_write (int fd, const void *buf, size_t count)
 {
     int rc = mock_type (int);
     if (!rc) {
-        return ferror (stream);
+        return write (fd, buf, count);
     }
 
     errno = rc;
     return -1;
 }
 
-size_t tcti_cmd_fwrite (const void *ptr, size_t size, size_t nmemb,
-        FILE *stream)
-{
-    int rc = mock_type (int);
-    if (!rc) {
-        return fwrite (ptr, size, nmemb, stream);
-    }
-
-    will_return (tcti_cmd_ferror, rc);
-    errno = rc;
-    return 0;
-}
-
 TSS2_TCTI_CONTEXT *
 test_common_setup (const char *cmd)
 {
     will_return_always (tcti_cmd_sigprocmask, 0);
-    will_return_always (tcti_cmd_fdopen, 0);
+    will_return_always (tcti_cmd_fcntl, 0);
     will_return_always (tcti_cmd_fork, 0);
     will_return_always (tcti_cmd_pipe, 0);
 
@@ -222,7 +212,7 @@ tcti_cmd_test_fork_fail (void **state)
 }
 
 static void
-tcti_cmd_test_fdopen_1_fail (void **state)
+tcti_cmd_test_fcntl_1_fail (void **state)
 {
     uint8_t buf[4096];
     size_t tcti_size = sizeof (buf);
@@ -232,14 +222,14 @@ tcti_cmd_test_fdopen_1_fail (void **state)
     will_return_always (tcti_cmd_fork, 0);
     will_return_always (tcti_cmd_sigprocmask, 0);
 
-    will_return (tcti_cmd_fdopen, EINVAL);
+    will_return (tcti_cmd_fcntl, EINVAL);
 
     TSS2_RC rval = Tss2_Tcti_Cmd_Init (tcti_context, &tcti_size, __func__);
     assert_int_equal (rval, TSS2_TCTI_RC_GENERAL_FAILURE);
 }
 
 static void
-tcti_cmd_test_fdopen_2_fail (void **state)
+tcti_cmd_test_fcntl_2_fail (void **state)
 {
     uint8_t buf[4096];
     size_t tcti_size = sizeof (buf);
@@ -249,9 +239,10 @@ tcti_cmd_test_fdopen_2_fail (void **state)
     will_return_always (tcti_cmd_fork, 0);
     will_return_always (tcti_cmd_sigprocmask, 0);
 
-    /* first fdopen works, second fails */
-    will_return (tcti_cmd_fdopen, 0);
-    will_return (tcti_cmd_fdopen, EINVAL);
+    /* the sink is set non-blocking (get and set flags), the source fails */
+    will_return (tcti_cmd_fcntl, 0);
+    will_return (tcti_cmd_fcntl, 0);
+    will_return (tcti_cmd_fcntl, EINVAL);
 
     TSS2_RC rval = Tss2_Tcti_Cmd_Init (tcti_context, &tcti_size, __func__);
     assert_int_equal (rval, TSS2_TCTI_RC_GENERAL_FAILURE);
@@ -275,8 +266,7 @@ tcti_cmd_test_sigprocmask_1_fail (void **state)
 static void
 tcti_cmd_test_good (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" good");
@@ -303,8 +293,7 @@ tcti_cmd_test_good (void **state)
 static void
 tcti_cmd_test_malformed_size_smaller (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" smaller");
@@ -327,8 +316,7 @@ tcti_cmd_test_malformed_size_smaller (void **state)
 static void
 tcti_cmd_test_malformed_size_bigger (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, 0);
-    will_return_always (tcti_cmd_ferror, 0);
+    will_return_always (tcti_cmd_write, 0);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" bigger");
@@ -351,10 +339,140 @@ tcti_cmd_test_malformed_size_bigger (void **state)
     assert_int_equal (rval, TSS2_TCTI_RC_MALFORMED_RESPONSE);
 }
 
+/*
+ * Ask for the size of the response first, then provide a buffer that is too
+ * small and finally one that fits.
+ */
+static void
+tcti_cmd_test_partial_read (void **state)
+{
+    will_return_always (tcti_cmd_write, 0);
+
+    TSS2_TCTI_CONTEXT *tcti_context = *state =
+            test_common_setup (EXECLP_CMD" good");
+    assert_non_null (tcti_context);
+
+    TSS2_RC rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    uint8_t rbuf[sizeof (getcap_good_resp)];
+    size_t rsize = 0;
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, NULL,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (getcap_good_resp));
+
+    rsize = sizeof (rbuf) - 1;
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (rsize, sizeof (getcap_good_resp));
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (getcap_good_resp));
+    assert_memory_equal (rbuf, getcap_good_resp, rsize);
+}
+
+/*
+ * The subprocess of the timeout test blocks on a FIFO between the steps
+ * of its response. The test writes a byte to the FIFO for every step and
+ * closes it to end the subprocess.
+ */
+static char fifo_dir[] = "/tmp/tcti-cmd-XXXXXX";
+static char fifo_path[sizeof (fifo_dir) + sizeof ("/fifo")];
+static int fifo_fd = -1;
+
+static int
+test_teardown_fifo (void **state)
+{
+    if (fifo_fd >= 0) {
+        close (fifo_fd);
+        fifo_fd = -1;
+    }
+    unlink (fifo_path);
+    rmdir (fifo_dir);
+    return test_teardown (state);
+}
+
+/*
+ * The subprocess sends the header of a 12 byte response at once and the
+ * body only when the test releases it. Until then receive times out and the
+ * poll handle is not readable. The subprocess stays alive until the FIFO
+ * is closed, then the poll handle reports the hangup.
+ */
+static void
+tcti_cmd_test_timeout (void **state)
+{
+    static const uint8_t resp[] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0xab, 0xcd
+    };
+    char cmd[256];
+
+    will_return_always (tcti_cmd_write, 0);
+
+    assert_non_null (mkdtemp (fifo_dir));
+    snprintf (fifo_path, sizeof (fifo_path), "%s/fifo", fifo_dir);
+    assert_int_equal (mkfifo (fifo_path, 0600), 0);
+    /* opened for reading as well, so the subprocess does not block in open */
+    fifo_fd = open (fifo_path, O_RDWR | O_CLOEXEC);
+    assert_true (fifo_fd >= 0);
+
+    snprintf (cmd, sizeof (cmd),
+            "printf '\\200\\001\\000\\000\\000\\014\\000\\000\\000\\000'; "
+            "exec 3<'%s'; head -c 1 <&3 >/dev/null; printf '\\253\\315'; "
+            "head -c 1 <&3 >/dev/null", fifo_path);
+    TSS2_TCTI_CONTEXT *tcti_context = *state = test_common_setup (cmd);
+    assert_non_null (tcti_context);
+
+    TSS2_TCTI_POLL_HANDLE handle;
+    size_t num_handles = 1;
+    TSS2_RC rval = Tss2_Tcti_GetPollHandles (tcti_context, &handle,
+            &num_handles);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (handle.events, POLLIN);
+
+    rval = Tss2_Tcti_Transmit (tcti_context,
+            sizeof (getcap_command), getcap_command);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+
+    uint8_t rbuf[sizeof (resp)];
+    size_t rsize = 0;
+
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, NULL,
+            TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (resp));
+
+    /* the body is held back by the subprocess */
+    assert_int_equal (poll (&handle, 1, 0), 0);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 0);
+    assert_int_equal (rval, TSS2_TCTI_RC_TRY_AGAIN);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 50);
+    assert_int_equal (rval, TSS2_TCTI_RC_TRY_AGAIN);
+
+    assert_int_equal (write (fifo_fd, "b", 1), 1);
+    assert_int_equal (poll (&handle, 1, 5000), 1);
+    rval = Tss2_Tcti_Receive (tcti_context, &rsize, rbuf, 5000);
+    assert_int_equal (rval, TSS2_RC_SUCCESS);
+    assert_int_equal (rsize, sizeof (resp));
+    assert_memory_equal (rbuf, resp, rsize);
+
+    /* the subprocess is still alive and keeps its end of the pipe open */
+    assert_int_equal (poll (&handle, 1, 0), 0);
+    close (fifo_fd);
+    fifo_fd = -1;
+    assert_int_equal (poll (&handle, 1, 5000), 1);
+    assert_true (handle.revents & POLLHUP);
+}
+
 static void
 tcti_cmd_test_transmit_fail (void **state)
 {
-    will_return_always (tcti_cmd_fwrite, EBADF);
+    will_return_always (tcti_cmd_write, EBADF);
 
     TSS2_TCTI_CONTEXT *tcti_context = *state =
             test_common_setup (EXECLP_CMD" good");
@@ -447,8 +565,8 @@ main (int   argc,
         cmocka_unit_test (tcti_cmd_test_pipe_1_fail),
         cmocka_unit_test (tcti_cmd_test_pipe_2_fail),
         cmocka_unit_test (tcti_cmd_test_fork_fail),
-        cmocka_unit_test (tcti_cmd_test_fdopen_1_fail),
-        cmocka_unit_test (tcti_cmd_test_fdopen_2_fail),
+        cmocka_unit_test (tcti_cmd_test_fcntl_1_fail),
+        cmocka_unit_test (tcti_cmd_test_fcntl_2_fail),
         cmocka_unit_test (tcti_cmd_test_sigprocmask_1_fail),
         /*
          * Tests that **do** require a teardown routine as they
@@ -463,6 +581,12 @@ main (int   argc,
         cmocka_unit_test_teardown (
             tcti_cmd_test_malformed_size_bigger,
             test_teardown),
+        cmocka_unit_test_teardown (
+            tcti_cmd_test_partial_read,
+            test_teardown),
+        cmocka_unit_test_teardown (
+            tcti_cmd_test_timeout,
+            test_teardown_fifo),
         cmocka_unit_test_teardown (
             tcti_cmd_test_transmit_fail,
             test_teardown),
@@ -8,12 +8,14 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -161,6 +163,8 @@ tcti_socket_init_size_test (void **state)
     assert_int_equal (ret, TSS2_RC_SUCCESS);
     assert_int_equal (tcti_size, sizeof (TSS2_TCTI_MSSIM_CONTEXT));
 }
+/* Number of calls to the wrapped I/O functions. */
+static size_t syscalls;
 /*
  * Wrap the 'connect' system call. The mock queue for this function must have
  * an integer to return as a response.
@@ -185,9 +189,38 @@ __wrap_read (int sockfd,
     ssize_t  ret = mock_type (ssize_t);
     uint8_t *buf_in = mock_ptr_type (uint8_t*);
 
+    syscalls++;
     memcpy (buf, buf_in, ret);
     return ret;
 }
+/*
+ * Wrap the 'readv' system call. The mock queue for this function must have an
+ * integer return value (the number of bytes read), as well as a pointer to a
+ * buffer to scatter the data from. A negative return value simulates the
+ * non-blocking socket without data.
+ */
+ssize_t
+__wrap_readv (int sockfd,
+              const struct iovec *iov,
+              int iovcnt)
+{
+    ssize_t  ret = mock_type (ssize_t);
+    uint8_t *buf_in = mock_ptr_type (uint8_t*);
+    size_t copied = 0, len;
+    int i;
+
+    syscalls++;
+    if (ret < 0) {
+        errno = EAGAIN;
+        return ret;
+    }
+    for (i = 0; i < iovcnt && copied < (size_t)ret; i++) {
+        len = iov[i].iov_len < ret - copied ? iov[i].iov_len : ret - copied;
+        memcpy (iov[i].iov_base, &buf_in [copied], len);
+        copied += len;
+    }
+    return ret;
+}
 /*
  * Wrap the 'send' system call. The mock queue for this function must have an
  * integer to return as a response.
@@ -198,8 +231,21 @@ __wrap_write (int sockfd,
               size_t len)
 
 {
+    syscalls++;
     return mock_type (TSS2_RC);
 }
+/*
+ * Wrap the 'writev' system call. The mock queue for this function must have
+ * an integer to return as a response.
+ */
+ssize_t
+__wrap_writev (int sockfd,
+               const struct iovec *iov,
+               int iovcnt)
+{
+    syscalls++;
+    return mock_type (ssize_t);
+}
 /*
  * Wrap the 'poll' system call.
  */
@@ -208,6 +254,7 @@ __wrap_poll (struct pollfd *fds, nfds_t nfds, int timeout)
 {
     int ret = mock_type (int);
 
+    syscalls++;
     fds->revents = fds->events;
     return ret;
 }
@@ -349,20 +396,9 @@ tcti_socket_receive_success_test (void **state)
     will_return (__wrap_poll, 1);
     will_return (__wrap_read, 4);
     will_return (__wrap_read, &response_in [2]);
-    /* receive tag */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 2);
-    will_return (__wrap_read, response_in);
-    /* receive size (again)  */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
-    /* receive the rest of the command */
-    will_return (__wrap_read, 0xc - sizeof (TPM2_ST) - sizeof (UINT32));
-    will_return (__wrap_read, &response_in [6]);
-    /* receive the 4 bytes of 0's appended by the simulator */
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [12]);
+    /* receive the response and the 4 bytes of 0's appended by the simulator */
+    will_return (__wrap_readv, sizeof (response_in));
+    will_return (__wrap_readv, response_in);
 
     rc = Tss2_Tcti_Receive (ctx, &response_size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
@@ -395,20 +431,9 @@ tcti_socket_receive_size_success_test (void **state)
 
     assert_int_equal (rc, TSS2_RC_SUCCESS);
     assert_int_equal (response_size, 0xc);
-    /* receive tag */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 2);
-    will_return (__wrap_read, response_in);
-    /* receive size (again)  */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [2]);
-    /* receive the rest of the command */
-    will_return (__wrap_read, 0xc - sizeof (TPM2_ST) - sizeof (UINT32));
-    will_return (__wrap_read, &response_in [6]);
-    /* receive the 4 bytes of 0's appended by the simulator */
-    will_return (__wrap_read, 4);
-    will_return (__wrap_read, &response_in [12]);
+    /* receive the response and the 4 bytes of 0's appended by the simulator */
+    will_return (__wrap_readv, sizeof (response_in));
+    will_return (__wrap_readv, response_in);
 
     rc = Tss2_Tcti_Receive (ctx, &response_size, response_out, TSS2_TCTI_TIMEOUT_BLOCK);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
@@ -469,15 +494,63 @@ tcti_mssim_receive_eof_second_read_test (void **state)
     will_return (__wrap_read, 4);
     will_return (__wrap_read, &response_in [2]);
     /* setup 0 for EOF on second read */
-    will_return (__wrap_poll, 1);
-    will_return (__wrap_read, 0);
-    will_return (__wrap_read, response_in);
+    will_return (__wrap_readv, 0);
+    will_return (__wrap_readv, response_in);
     rc = Tss2_Tcti_Receive (ctx,
                             &size,
                             response_out,
                             TSS2_TCTI_TIMEOUT_BLOCK);
     assert_true (rc == TSS2_TCTI_RC_IO_ERROR);
 }
+/*
+ * This test receives a response that arrives in two parts. The receive call
+ * waits for the second part only as long as the timeout allows and returns
+ * TRY_AGAIN. The next call continues where the first one stopped.
+ */
+static void
+tcti_mssim_receive_partial_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common = tcti_common_context_cast (ctx);
+    TSS2_RC rc;
+    uint8_t response_in [] = { 0x80, 0x02,
+                               0x00, 0x00, 0x00, 0x0c,
+                               0x00, 0x00, 0x00, 0x00,
+                               0x01, 0x02,
+    /* simulator appends 4 bytes of 0's to every response */
+                               0x00, 0x00, 0x00, 0x00 };
+    uint8_t response_out [12] = { 0 };
+    size_t size = sizeof (response_out);
+
+    /* Keep state machine check in `receive` from returning error. */
+    tcti_common->state = TCTI_STATE_RECEIVE;
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, &response_in [2]);
+    /* the first part of the response, then the timeout expires */
+    will_return (__wrap_readv, 6);
+    will_return (__wrap_readv, response_in);
+    will_return (__wrap_readv, -1);
+    will_return (__wrap_readv, NULL);
+    will_return (__wrap_poll, 0);
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, 100);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (tcti_common->state, TCTI_STATE_RECEIVE);
+
+    /* the rest of the response and part of the trailer */
+    will_return (__wrap_readv, 8);
+    will_return (__wrap_readv, &response_in [6]);
+    will_return (__wrap_readv, -1);
+    will_return (__wrap_readv, NULL);
+    will_return (__wrap_poll, 1);
+    will_return (__wrap_readv, 2);
+    will_return (__wrap_readv, &response_in [14]);
+    rc = Tss2_Tcti_Receive (ctx, &size, response_out, 100);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (response_out));
+    assert_memory_equal (response_in, response_out, size);
+    assert_int_equal (tcti_common->state, TCTI_STATE_TRANSMIT);
+}
 /*
  * This test exercises the successful code path through the transmit function.
  */
@@ -492,17 +565,78 @@ tcti_socket_transmit_success_test (void **state)
                            0x01, 0x02 };
     size_t  command_size = sizeof (command);
 
-    /* send the TPM2_SEND_COMMAND code */
-    will_return (__wrap_write, 4);
-    /* send the locality for the command */
-    will_return (__wrap_write, 1);
-    /* send the number of bytes in command */
-    will_return (__wrap_write, 4);
-    /* send the command buffer */
-    will_return (__wrap_write, 0xc);
+    /*
+     * send the TPM2_SEND_COMMAND code, the locality, the number of bytes in
+     * the command and the command buffer in one go
+     */
+    will_return (__wrap_writev, 4 + 1 + 4 + 0xc);
     rc = Tss2_Tcti_Transmit (ctx, command_size, command);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
 }
+/*
+ * This test transmits the command with a short write. The remainder of the
+ * command is sent by another call.
+ */
+static void
+tcti_socket_transmit_short_write_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    uint8_t command [] = { 0x80, 0x02,
+                           0x00, 0x00, 0x00, 0x0c,
+                           0x00, 0x00, 0x00, 0x00,
+                           0x01, 0x02 };
+
+    will_return (__wrap_writev, 4 + 1 + 2);
+    will_return (__wrap_writev, 2 + 0xc);
+    rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
+/*
+ * Count the system calls needed for a complete command / response exchange
+ * with the simulator. The header for the simulator protocol and the command
+ * are sent with a single write, the response and the trailing 4 bytes of 0's
+ * are received with a single read.
+ */
+#define SYSCALLS_COMMANDS 1000
+static void
+tcti_socket_syscalls_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    uint8_t command [] = { 0x80, 0x01,
+                           0x00, 0x00, 0x00, 0x0c,
+                           0x00, 0x00, 0x01, 0x7b,
+                           0x00, 0x08 };
+    uint8_t response_in [] = { 0x00, 0x00, 0x00, 0x0c,
+                               0x80, 0x01,
+                               0x00, 0x00, 0x00, 0x0c,
+                               0x00, 0x00, 0x00, 0x00,
+                               0x01, 0x02,
+                               0x00, 0x00, 0x00, 0x00 };
+    uint8_t response_out [12] = { 0 };
+    size_t size;
+    int i;
+
+    syscalls = 0;
+    for (i = 0; i < SYSCALLS_COMMANDS; i++) {
+        will_return (__wrap_writev, sizeof (command) + 9);
+        rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+        will_return (__wrap_poll, 1);
+        will_return (__wrap_read, 4);
+        will_return (__wrap_read, response_in);
+        will_return (__wrap_readv, sizeof (response_in) - 4);
+        will_return (__wrap_readv, &response_in [4]);
+        size = sizeof (response_out);
+        rc = Tss2_Tcti_Receive (ctx, &size, response_out,
+                                TSS2_TCTI_TIMEOUT_BLOCK);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_memory_equal (response_out, &response_in [4], size);
+    }
+    assert_int_equal (syscalls, 4 * SYSCALLS_COMMANDS);
+}
 
 int
 main (int   argc,
@@ -537,6 +671,15 @@ main (int   argc,
                                          tcti_socket_setup,
                                          tcti_socket_teardown),
         cmocka_unit_test_setup_teardown (tcti_socket_transmit_success_test,
+                                  tcti_socket_setup,
+                                  tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_socket_transmit_short_write_test,
+                                  tcti_socket_setup,
+                                  tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_mssim_receive_partial_test,
+                                         tcti_socket_setup,
+                                         tcti_socket_teardown),
+        cmocka_unit_test_setup_teardown (tcti_socket_syscalls_test,
                                   tcti_socket_setup,
                                   tcti_socket_teardown)
     };
@@ -0,0 +1,523 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_mux.h"
+
+#include "tss2-tcti/tcti-common.h"
+#include "tss2-tcti/tcti-mux.h"
+
+/*
+ * The child TCTI is a stand-in for the simulator: it answers each command
+ * with a response which echoes the command code, so every client can check
+ * that it received the response to its own command. The stand-in can be
+ * blocked to keep a command dispatched while others are queued.
+ */
+#define TCTI_STUB_CONF      "stub"
+#define TCTI_STUB_MAGIC     0x5354554253545542ULL
+#define STUB_LOG_SIZE       16
+#define STRESS_THREADS      8
+#define STRESS_COMMANDS     2000
+
+typedef struct {
+    TSS2_TCTI_COMMON_CONTEXT common;
+    uint8_t cmd_buf[TPM2_MAX_COMMAND_SIZE];
+    size_t cmd_size;
+} TSS2_TCTI_STUB_CONTEXT;
+
+static pthread_mutex_t stub_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stub_cond = PTHREAD_COND_INITIALIZER;
+static bool stub_blocked;
+static size_t stub_transmitted;
+static TPM2_CC stub_log[STUB_LOG_SIZE];
+static uint8_t stub_locality;
+
+static TSS2_RC
+tcti_stub_transmit (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t size,
+    const uint8_t *cmd_buf)
+{
+    TSS2_TCTI_STUB_CONTEXT *tcti_stub = (TSS2_TCTI_STUB_CONTEXT*) tcti_ctx;
+    tpm_header_t header;
+
+    memcpy (tcti_stub->cmd_buf, cmd_buf, size);
+    tcti_stub->cmd_size = size;
+    header_unmarshal (cmd_buf, &header);
+
+    pthread_mutex_lock (&stub_mutex);
+    if (stub_transmitted < STUB_LOG_SIZE) {
+        stub_log[stub_transmitted] = header.code;
+    }
+    stub_transmitted += 1;
+    pthread_cond_broadcast (&stub_cond);
+    pthread_mutex_unlock (&stub_mutex);
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_receive (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    size_t *response_size,
+    uint8_t *response_buffer,
+    int32_t timeout)
+{
+    TSS2_TCTI_STUB_CONTEXT *tcti_stub = (TSS2_TCTI_STUB_CONTEXT*) tcti_ctx;
+    tpm_header_t header;
+
+    pthread_mutex_lock (&stub_mutex);
+    while (stub_blocked) {
+        pthread_cond_wait (&stub_cond, &stub_mutex);
+    }
+    pthread_mutex_unlock (&stub_mutex);
+
+    /* Echo the command code behind a success response header. */
+    header_unmarshal (tcti_stub->cmd_buf, &header);
+    header.tag = TPM2_ST_NO_SESSIONS;
+    header.size = TPM_HEADER_SIZE + sizeof (TPM2_CC);
+    memcpy (&response_buffer[TPM_HEADER_SIZE], &header.code, sizeof (TPM2_CC));
+    header.code = TPM2_RC_SUCCESS;
+    header_marshal (&header, response_buffer);
+    *response_size = header.size;
+
+    return TSS2_RC_SUCCESS;
+}
+
+static TSS2_RC
+tcti_stub_set_locality (
+    TSS2_TCTI_CONTEXT *tcti_ctx,
+    uint8_t locality)
+{
+    stub_locality = locality;
+    return TSS2_RC_SUCCESS;
+}
+
+TSS2_RC
+Tss2_TctiLdr_Initialize (const char *nameConf,
+                         TSS2_TCTI_CONTEXT **tctiContext)
+{
+    TSS2_TCTI_STUB_CONTEXT *tcti_stub;
+    TSS2_TCTI_COMMON_CONTEXT *tcti_common;
+
+    *tctiContext = NULL;
+    if (nameConf == NULL || strcmp (nameConf, TCTI_STUB_CONF) != 0) {
+        return TSS2_TCTI_RC_IO_ERROR;
+    }
+
+    tcti_stub = calloc (1, sizeof (TSS2_TCTI_STUB_CONTEXT));
+    if (tcti_stub == NULL) {
+        return TSS2_TCTI_RC_MEMORY;
+    }
+    tcti_common = (TSS2_TCTI_COMMON_CONTEXT*) tcti_stub;
+    TSS2_TCTI_MAGIC (tcti_common) = TCTI_STUB_MAGIC;
+    TSS2_TCTI_VERSION (tcti_common) = TCTI_VERSION;
+    TSS2_TCTI_TRANSMIT (tcti_common) = tcti_stub_transmit;
+    TSS2_TCTI_RECEIVE (tcti_common) = tcti_stub_receive;
+    TSS2_TCTI_SET_LOCALITY (tcti_common) = tcti_stub_set_locality;
+    tcti_common->state = TCTI_STATE_TRANSMIT;
+
+    *tctiContext = (TSS2_TCTI_CONTEXT*) tcti_stub;
+    return TSS2_RC_SUCCESS;
+}
+
+void
+Tss2_TctiLdr_Finalize (TSS2_TCTI_CONTEXT **tctiContext)
+{
+    free (*tctiContext);
+    *tctiContext = NULL;
+}
+
+static void
+stub_block (bool blocked)
+{
+    pthread_mutex_lock (&stub_mutex);
+    stub_blocked = blocked;
+    pthread_cond_broadcast (&stub_cond);
+    pthread_mutex_unlock (&stub_mutex);
+}
+
+/* Wait until the stand-in has received the given number of commands. */
+static void
+stub_wait_transmitted (size_t count)
+{
+    pthread_mutex_lock (&stub_mutex);
+    while (stub_transmitted < count) {
+        pthread_cond_wait (&stub_cond, &stub_mutex);
+    }
+    pthread_mutex_unlock (&stub_mutex);
+}
+
+static TSS2_TCTI_CONTEXT*
+client_new (TSS2_TCTI_CONTEXT *mux)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size;
+    TSS2_RC rc;
+
+    if (mux == NULL) {
+        rc = Tss2_Tcti_Mux_Init (NULL, &size, NULL);
+    } else {
+        rc = Tss2_Tcti_Mux_ClientInit (NULL, &size, mux);
+    }
+    if (rc != TSS2_RC_SUCCESS || size != sizeof (TSS2_TCTI_MUX_CONTEXT)) {
+        return NULL;
+    }
+    ctx = calloc (1, size);
+    if (ctx == NULL) {
+        return NULL;
+    }
+    if (mux == NULL) {
+        rc = Tss2_Tcti_Mux_Init (ctx, &size, TCTI_STUB_CONF);
+    } else {
+        rc = Tss2_Tcti_Mux_ClientInit (ctx, &size, mux);
+    }
+    if (rc != TSS2_RC_SUCCESS) {
+        free (ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void
+client_free (TSS2_TCTI_CONTEXT *ctx)
+{
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
+
+static TSS2_RC
+client_transmit (TSS2_TCTI_CONTEXT *ctx, TPM2_CC code)
+{
+    tpm_header_t header = {
+        .tag = TPM2_ST_NO_SESSIONS,
+        .size = TPM_HEADER_SIZE,
+        .code = code,
+    };
+    uint8_t cmd_buf[TPM_HEADER_SIZE];
+
+    header_marshal (&header, cmd_buf);
+    return Tss2_Tcti_Transmit (ctx, sizeof (cmd_buf), cmd_buf);
+}
+
+/* Receive a response and check that it answers the command with the code. */
+static TSS2_RC
+client_receive (TSS2_TCTI_CONTEXT *ctx, TPM2_CC code, int32_t timeout)
+{
+    uint8_t rsp_buf[TPM2_MAX_RESPONSE_SIZE];
+    size_t size = sizeof (rsp_buf);
+    TPM2_CC echo;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Receive (ctx, &size, rsp_buf, timeout);
+    if (rc != TSS2_RC_SUCCESS) {
+        return rc;
+    }
+    memcpy (&echo, &rsp_buf[TPM_HEADER_SIZE], sizeof (echo));
+    if (size != TPM_HEADER_SIZE + sizeof (TPM2_CC) || echo != code) {
+        return TSS2_TCTI_RC_MALFORMED_RESPONSE;
+    }
+    return TSS2_RC_SUCCESS;
+}
+
+static int
+client_readable (TSS2_TCTI_CONTEXT *ctx, int timeout)
+{
+    TSS2_TCTI_POLL_HANDLE handle;
+    size_t num_handles = 1;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_GetPollHandles (ctx, &handle, &num_handles);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (num_handles, 1);
+    return poll (&handle, 1, timeout);
+}
+
+static int
+setup (void **state)
+{
+    stub_blocked = false;
+    stub_transmitted = 0;
+    stub_locality = 0;
+    memset (stub_log, 0, sizeof (stub_log));
+
+    *state = client_new (NULL);
+    return *state == NULL;
+}
+
+static int
+teardown (void **state)
+{
+    stub_block (false);
+    client_free (*state);
+    return 0;
+}
+
+static void
+tcti_mux_init_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size;
+    TSS2_RC rc;
+
+    rc = Tss2_Tcti_Mux_Init (NULL, NULL, NULL);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+
+    rc = Tss2_Tcti_Mux_Init (NULL, &size, NULL);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (TSS2_TCTI_MUX_CONTEXT));
+
+    /* The error of the child TCTI is returned. */
+    ctx = calloc (1, size);
+    assert_non_null (ctx);
+    rc = Tss2_Tcti_Mux_Init (ctx, &size, "unknown");
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+
+    rc = Tss2_Tcti_Mux_ClientInit (ctx, &size, ctx);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_CONTEXT);
+    free (ctx);
+}
+
+static void
+tcti_mux_transmit_receive_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    uint8_t rsp_buf[TPM2_MAX_RESPONSE_SIZE];
+    size_t size = 0;
+    TSS2_RC rc;
+
+    rc = client_receive (ctx, 0x17f, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    rc = client_transmit (ctx, 0x17f);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = client_transmit (ctx, 0x17f);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    /* The poll handle becomes readable with the response. */
+    assert_int_equal (client_readable (ctx, 10000), 1);
+
+    /* A too small buffer reports the size of the response. */
+    rc = Tss2_Tcti_Receive (ctx, &size, rsp_buf, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, TPM_HEADER_SIZE + sizeof (TPM2_CC));
+    size = 0;
+    rc = Tss2_Tcti_Receive (ctx, &size, NULL, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (size, TPM_HEADER_SIZE + sizeof (TPM2_CC));
+
+    rc = client_receive (ctx, 0x17f, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (client_readable (ctx, 0), 0);
+}
+
+static void
+tcti_mux_timeout_cancel_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_CONTEXT *client = client_new (ctx);
+    TSS2_RC rc;
+
+    assert_non_null (client);
+    stub_block (true);
+
+    rc = client_transmit (ctx, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    stub_wait_transmitted (1);
+    rc = client_transmit (client, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    rc = client_receive (ctx, 1, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    rc = client_receive (ctx, 1, 10);
+    assert_int_equal (rc, TSS2_TCTI_RC_TRY_AGAIN);
+    assert_int_equal (client_readable (ctx, 0), 0);
+
+    /* The dispatched command can't be cancelled, the queued one can. */
+    rc = Tss2_Tcti_Cancel (ctx);
+    assert_int_equal (rc, TSS2_TCTI_RC_NOT_PERMITTED);
+    rc = Tss2_Tcti_Cancel (client);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = client_receive (client, 2, 0);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    stub_block (false);
+    rc = client_receive (ctx, 1, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* The cancelled command was never transmitted. */
+    rc = client_transmit (client, 3);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = client_receive (client, 3, TSS2_TCTI_TIMEOUT_BLOCK);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_int_equal (stub_transmitted, 2);
+    assert_int_equal (stub_log[1], 3);
+
+    client_free (client);
+}
+
+static void
+tcti_mux_priority_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_CONTEXT *low = client_new (ctx);
+    TSS2_TCTI_CONTEXT *high = client_new (ctx);
+    TSS2_RC rc;
+
+    assert_non_null (low);
+    assert_non_null (high);
+    rc = Tss2_Tcti_Mux_SetPriority (low, TSS2_TCTI_MUX_PRIORITY_LOW);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = Tss2_Tcti_Mux_SetPriority (high, TSS2_TCTI_MUX_PRIORITY_HIGH);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* Keep the first command dispatched while the others are queued. */
+    stub_block (true);
+    rc = client_transmit (ctx, 1);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    stub_wait_transmitted (1);
+    rc = client_transmit (low, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    rc = client_transmit (high, 3);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    stub_block (false);
+
+    assert_int_equal (client_receive (low, 2, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+    assert_int_equal (client_receive (high, 3, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+    assert_int_equal (client_receive (ctx, 1, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+
+    assert_int_equal (stub_log[0], 1);
+    assert_int_equal (stub_log[1], 3);
+    assert_int_equal (stub_log[2], 2);
+
+    client_free (low);
+    client_free (high);
+}
+
+static void
+tcti_mux_locality_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    TSS2_TCTI_CONTEXT *client = client_new (ctx);
+    TSS2_RC rc;
+
+    assert_non_null (client);
+    rc = Tss2_Tcti_SetLocality (client, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* The locality is only set on the child for the client's commands. */
+    assert_int_equal (client_transmit (ctx, 1), TSS2_RC_SUCCESS);
+    assert_int_equal (client_receive (ctx, 1, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+    assert_int_equal (stub_locality, 0);
+    assert_int_equal (client_transmit (client, 2), TSS2_RC_SUCCESS);
+    assert_int_equal (client_receive (client, 2, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+    assert_int_equal (stub_locality, 2);
+
+    client_free (client);
+}
+
+static void
+tcti_mux_finalize_order_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = client_new (NULL);
+    TSS2_TCTI_CONTEXT *client;
+
+    assert_non_null (ctx);
+    client = client_new (ctx);
+    assert_non_null (client);
+
+    /* The multiplexer is kept until its last client is finalized. */
+    client_free (ctx);
+    assert_int_equal (client_transmit (client, 1), TSS2_RC_SUCCESS);
+    assert_int_equal (client_receive (client, 1, TSS2_TCTI_TIMEOUT_BLOCK), TSS2_RC_SUCCESS);
+    client_free (client);
+}
+
+typedef struct {
+    TSS2_TCTI_CONTEXT *ctx;
+    TPM2_CC first;
+    size_t errors;
+} stress_thread_t;
+
+static void*
+stress_thread (void *arg)
+{
+    stress_thread_t *thread = arg;
+    TPM2_CC code;
+
+    for (code = thread->first; code < thread->first + STRESS_COMMANDS; code++) {
+        if (client_transmit (thread->ctx, code) != TSS2_RC_SUCCESS ||
+            client_receive (thread->ctx, code, TSS2_TCTI_TIMEOUT_BLOCK) != TSS2_RC_SUCCESS) {
+            thread->errors += 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Stress test with one client per thread sharing the stand-in.
+ */
+static void
+tcti_mux_stress_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = *state;
+    pthread_t threads[STRESS_THREADS];
+    stress_thread_t args[STRESS_THREADS];
+    size_t i;
+
+    for (i = 0; i < STRESS_THREADS; i++) {
+        args[i].ctx = (i == 0) ? ctx : client_new (ctx);
+        assert_non_null (args[i].ctx);
+        args[i].first = (TPM2_CC) (i * STRESS_COMMANDS);
+        args[i].errors = 0;
+    }
+
+    for (i = 0; i < STRESS_THREADS; i++) {
+        assert_int_equal (pthread_create (&threads[i], NULL, stress_thread, &args[i]), 0);
+    }
+    for (i = 0; i < STRESS_THREADS; i++) {
+        pthread_join (threads[i], NULL);
+    }
+
+    for (i = 0; i < STRESS_THREADS; i++) {
+        assert_int_equal (args[i].errors, 0);
+        if (i > 0) {
+            client_free (args[i].ctx);
+        }
+    }
+    assert_int_equal (stub_transmitted, STRESS_THREADS * STRESS_COMMANDS);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test (tcti_mux_init_test),
+        cmocka_unit_test_setup_teardown (tcti_mux_transmit_receive_test,
+                                         setup, teardown),
+        cmocka_unit_test_setup_teardown (tcti_mux_timeout_cancel_test,
+                                         setup, teardown),
+        cmocka_unit_test_setup_teardown (tcti_mux_priority_test,
+                                         setup, teardown),
+        cmocka_unit_test_setup_teardown (tcti_mux_locality_test,
+                                         setup, teardown),
+        cmocka_unit_test (tcti_mux_finalize_order_test),
+        cmocka_unit_test_setup_teardown (tcti_mux_stress_test,
+                                         setup, teardown),
+    };
+    return cmocka_run_group_tests (tests, NULL, NULL);
+}
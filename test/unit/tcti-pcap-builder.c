@@ -0,0 +1,361 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2-tcti/tcti-pcap-builder.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * Tests of the pcap builder with real files: buffered mode, the drop counter
+ * and file rotation.
+ */
+
+#define BLOCK_TYPE_SHB 0x0A0D0D0A
+#define BLOCK_TYPE_IDB 0x00000001
+#define BLOCK_TYPE_ISB 0x00000005
+#define BLOCK_TYPE_EPB 0x00000006
+
+#define EPB_HEADER_LEN 28
+#define EPB_CAPTURED_LEN_OFFSET 20
+#define EPB_TCP_SEQ_OFFSET (EPB_HEADER_LEN + 20 + 4)
+#define EPB_PAYLOAD_OFFSET (EPB_HEADER_LEN + 20 + 20)
+#define ISB_IFDROP_OFFSET 24
+
+#define MAX_BLOCKS 1024
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t num_blocks;
+    uint32_t type[MAX_BLOCKS];
+    size_t offset[MAX_BLOCKS];
+} pcap_file;
+
+static char dir[] = "/tmp/tcti-pcap-builder-XXXXXX";
+static char path[PATH_MAX];
+
+static uint32_t
+get_uint32 (const uint8_t *buf)
+{
+    uint32_t value;
+    memcpy (&value, buf, sizeof (value));
+    return value;
+}
+
+static void
+read_pcap (const char *filename, pcap_file *file)
+{
+    FILE *f = fopen (filename, "rb");
+    long size;
+    uint32_t len;
+
+    assert_non_null (f);
+    assert_int_equal (fseek (f, 0, SEEK_END), 0);
+    size = ftell (f);
+    rewind (f);
+    file->data = malloc (size);
+    file->size = size;
+    assert_non_null (file->data);
+    assert_int_equal (fread (file->data, 1, size, f), (size_t) size);
+    fclose (f);
+
+    file->num_blocks = 0;
+    for (size_t offset = 0; offset < file->size; offset += len) {
+        assert_true (file->num_blocks < MAX_BLOCKS);
+        assert_true (file->size - offset >= 12);
+        len = get_uint32 (&file->data[offset + 4]);
+        assert_true (len >= 12 && len % 4 == 0 && len <= file->size - offset);
+        assert_int_equal (get_uint32 (&file->data[offset + len - 4]), len);
+        file->type[file->num_blocks] = get_uint32 (&file->data[offset]);
+        file->offset[file->num_blocks] = offset;
+        file->num_blocks += 1;
+    }
+}
+
+static const uint8_t *
+epb_payload (pcap_file *file, size_t block, size_t *len)
+{
+    const uint8_t *epb = &file->data[file->offset[block]];
+
+    assert_int_equal (file->type[block], BLOCK_TYPE_EPB);
+    *len = get_uint32 (&epb[EPB_CAPTURED_LEN_OFFSET]) - 40;
+    return &epb[EPB_PAYLOAD_OFFSET];
+}
+
+#ifdef HAVE_PTHREAD
+static uint32_t
+epb_tcp_seq (pcap_file *file, size_t block)
+{
+    return ntohl (get_uint32 (&file->data[file->offset[block] + EPB_TCP_SEQ_OFFSET]));
+}
+
+static uint64_t
+isb_ifdrop (pcap_file *file, size_t block)
+{
+    uint64_t value;
+
+    assert_int_equal (file->type[block], BLOCK_TYPE_ISB);
+    memcpy (&value, &file->data[file->offset[block] + ISB_IFDROP_OFFSET],
+            sizeof (value));
+    return value;
+}
+#endif /* HAVE_PTHREAD */
+
+static void
+print_numbered (pcap_buider_ctx *ctx, uint32_t number, size_t len)
+{
+    uint8_t payload[512];
+
+    assert_true (len >= sizeof (number) && len <= sizeof (payload));
+    memset (payload, 0xa5, len);
+    memcpy (payload, &number, sizeof (number));
+    assert_int_equal (pcap_print (ctx, payload, len, number % 2), 0);
+}
+
+static void
+check_numbered (pcap_file *file, size_t block, uint32_t number, size_t len)
+{
+    const uint8_t *payload;
+    size_t payload_len;
+
+    payload = epb_payload (file, block, &payload_len);
+    assert_int_equal (payload_len, len);
+    assert_int_equal (get_uint32 (payload), number);
+}
+
+static int
+setup (void **state)
+{
+    snprintf (path, sizeof (path), "%s/capture.pcap", dir);
+    setenv (ENV_PCAP_FILE, path, 1);
+    return 0;
+}
+
+static int
+teardown (void **state)
+{
+    char name[PATH_MAX + 16];
+
+    unsetenv (ENV_PCAP_BUFFER_SIZE);
+    unsetenv (ENV_PCAP_DROP_TIMEOUT);
+    unsetenv (ENV_PCAP_ROTATE_SIZE);
+    unsetenv (ENV_PCAP_ROTATE_TIME);
+    unsetenv (ENV_PCAP_ROTATE_COUNT);
+    unlink (path);
+    for (int i = 1; i <= 10; i++) {
+        snprintf (name, sizeof (name), "%s.%i", path, i);
+        unlink (name);
+    }
+    return 0;
+}
+
+#ifdef HAVE_PTHREAD
+static void
+test_buffered (void **state)
+{
+    pcap_buider_ctx ctx;
+    pcap_file file;
+    uint32_t i;
+
+    setenv (ENV_PCAP_BUFFER_SIZE, "65536", 1);
+    assert_int_equal (pcap_init (&ctx), 0);
+    assert_non_null (ctx.writer);
+    for (i = 0; i < 100; i++) {
+        print_numbered (&ctx, i, 4 + i);
+    }
+    assert_int_equal (pcap_dropped (&ctx), 0);
+    pcap_deinit (&ctx);
+
+    read_pcap (path, &file);
+    assert_int_equal (file.num_blocks, 2 + 100 + 1);
+    assert_int_equal (file.type[0], BLOCK_TYPE_SHB);
+    assert_int_equal (file.type[1], BLOCK_TYPE_IDB);
+    for (i = 0; i < 100; i++) {
+        check_numbered (&file, 2 + i, i, 4 + i);
+    }
+    assert_int_equal (isb_ifdrop (&file, 102), 0);
+    free (file.data);
+}
+
+/* A small buffer wraps around many times; no packet may be lost or reordered. */
+static void
+test_buffered_wrap (void **state)
+{
+    pcap_buider_ctx ctx;
+    pcap_file file;
+    uint32_t i;
+
+    setenv (ENV_PCAP_BUFFER_SIZE, "1000", 1);
+    setenv (ENV_PCAP_DROP_TIMEOUT, "10000", 1);
+    assert_int_equal (pcap_init (&ctx), 0);
+    for (i = 0; i < 500; i++) {
+        print_numbered (&ctx, i, 4 + (i * 37) % 200);
+    }
+    pcap_deinit (&ctx);
+
+    read_pcap (path, &file);
+    assert_int_equal (file.num_blocks, 2 + 500 + 1);
+    for (i = 0; i < 500; i++) {
+        check_numbered (&file, 2 + i, i, 4 + (i * 37) % 200);
+    }
+    assert_int_equal (isb_ifdrop (&file, 502), 0);
+    free (file.data);
+}
+
+static void
+test_buffered_drop (void **state)
+{
+    pcap_buider_ctx ctx;
+    pcap_file file;
+    uint8_t big[300] = { 0 };
+
+    /* packets larger than the buffer are always dropped */
+    setenv (ENV_PCAP_BUFFER_SIZE, "256", 1);
+    assert_int_equal (pcap_init (&ctx), 0);
+    print_numbered (&ctx, 0, 10);
+    assert_int_equal (pcap_print (&ctx, big, sizeof (big), PCAP_DIR_HOST_TO_TPM), 1);
+    assert_int_equal (pcap_print (&ctx, big, sizeof (big), PCAP_DIR_HOST_TO_TPM), 1);
+    assert_int_equal (pcap_dropped (&ctx), 2);
+    print_numbered (&ctx, 2, 10);
+    pcap_deinit (&ctx);
+
+    read_pcap (path, &file);
+    assert_int_equal (file.num_blocks, 2 + 2 + 1);
+    check_numbered (&file, 2, 0, 10);
+    check_numbered (&file, 3, 2, 10);
+    /* the dropped data is a gap in the tcp stream */
+    assert_int_equal (epb_tcp_seq (&file, 3) - epb_tcp_seq (&file, 2),
+                      10 + 2 * sizeof (big));
+    assert_int_equal (isb_ifdrop (&file, 4), 2);
+    free (file.data);
+}
+
+#endif /* HAVE_PTHREAD */
+
+static void
+check_rotated (bool buffered)
+{
+    char name[PATH_MAX + 16];
+    pcap_buider_ctx ctx;
+    pcap_file file;
+    struct stat st;
+    size_t blocks, i;
+
+    setenv (ENV_PCAP_ROTATE_SIZE, "1000", 1);
+    setenv (ENV_PCAP_ROTATE_COUNT, "2", 1);
+    assert_int_equal (pcap_init (&ctx), 0);
+    for (i = 0; i < 50; i++) {
+        print_numbered (&ctx, i, 100);
+    }
+    pcap_deinit (&ctx);
+
+    /* capture.pcap.3 would have been the oldest file */
+    snprintf (name, sizeof (name), "%s.3", path);
+    assert_int_not_equal (stat (name, &st), 0);
+
+    for (i = 0; i <= 2; i++) {
+        if (i == 0) {
+            snprintf (name, sizeof (name), "%s", path);
+        } else {
+            snprintf (name, sizeof (name), "%s.%zu", path, i);
+        }
+        read_pcap (name, &file);
+        assert_int_equal (file.type[0], BLOCK_TYPE_SHB);
+        assert_int_equal (file.type[1], BLOCK_TYPE_IDB);
+        blocks = file.num_blocks - 2;
+        if (buffered) {
+            assert_int_equal (file.type[file.num_blocks - 1], BLOCK_TYPE_ISB);
+            blocks -= 1;
+        }
+        assert_true (blocks > 0);
+        if (i > 0) {
+            /* rotated files are full, but not much larger than the limit */
+            assert_true (file.size >= 1000);
+            assert_true (file.size < 1000 + 200);
+        }
+        free (file.data);
+    }
+}
+
+static void
+test_rotate_size (void **state)
+{
+    check_rotated (false);
+}
+
+#ifdef HAVE_PTHREAD
+static void
+test_rotate_size_buffered (void **state)
+{
+    setenv (ENV_PCAP_BUFFER_SIZE, "65536", 1);
+    check_rotated (true);
+}
+#endif /* HAVE_PTHREAD */
+
+static void
+test_rotate_time (void **state)
+{
+    char name[PATH_MAX + 16];
+    pcap_buider_ctx ctx;
+    pcap_file file;
+
+    setenv (ENV_PCAP_ROTATE_TIME, "1", 1);
+    assert_int_equal (pcap_init (&ctx), 0);
+    print_numbered (&ctx, 0, 10);
+    sleep (1);
+    print_numbered (&ctx, 1, 10);
+    pcap_deinit (&ctx);
+
+    snprintf (name, sizeof (name), "%s.1", path);
+    read_pcap (name, &file);
+    assert_int_equal (file.num_blocks, 3);
+    check_numbered (&file, 2, 0, 10);
+    free (file.data);
+
+    read_pcap (path, &file);
+    assert_int_equal (file.num_blocks, 3);
+    check_numbered (&file, 2, 1, 10);
+    free (file.data);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown (test_rotate_size, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_rotate_time, setup, teardown),
+#ifdef HAVE_PTHREAD
+        cmocka_unit_test_setup_teardown (test_buffered, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_buffered_wrap, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_buffered_drop, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_rotate_size_buffered, setup,
+                                         teardown),
+#endif /* HAVE_PTHREAD */
+    };
+    int ret;
+
+    if (mkdtemp (dir) == NULL) {
+        return EXIT_FAILURE;
+    }
+    ret = cmocka_run_group_tests (tests, NULL, NULL);
+    rmdir (dir);
+    return ret;
+}
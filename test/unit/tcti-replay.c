@@ -0,0 +1,368 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tss2_tcti.h"
+#include "tss2_tcti_replay.h"
+
+#include "tss2-tcti/tcti-common.h"
+#include "tss2-tcti/tcti-pcap-builder.h"
+#include "tss2-tcti/tcti-replay.h"
+
+#define LOGMODULE tests
+#include "util/log.h"
+
+/*
+ * The captures replayed by these tests are recorded with the pcap builder of
+ * tcti-pcap.
+ */
+
+#define CMD_LEN 12
+#define RSP_LEN 14
+
+static char dir[] = "/tmp/tcti-replay-XXXXXX";
+static char path[PATH_MAX];
+static char conf[PATH_MAX + 32];
+
+/*
+ * A TPM command with the command code cc, the parameter param and a
+ * response that is marked with the same parameter.
+ */
+static void
+make_cmd (uint8_t *buf, TPM2_CC cc, uint16_t param)
+{
+    const uint8_t cmd[CMD_LEN] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, CMD_LEN,
+        cc >> 24, cc >> 16, cc >> 8, cc, param >> 8, param,
+    };
+    memcpy (buf, cmd, sizeof (cmd));
+}
+
+static void
+make_rsp (uint8_t *buf, uint16_t param)
+{
+    const uint8_t rsp[RSP_LEN] = {
+        0x80, 0x01, 0x00, 0x00, 0x00, RSP_LEN, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x02, param >> 8, param,
+    };
+    memcpy (buf, rsp, sizeof (rsp));
+}
+
+static void
+record (pcap_buider_ctx *ctx, TPM2_CC cc, uint16_t param, int direction)
+{
+    uint8_t buf[RSP_LEN];
+
+    if (direction == PCAP_DIR_HOST_TO_TPM) {
+        make_cmd (buf, cc, param);
+        assert_int_equal (pcap_print (ctx, buf, CMD_LEN, direction), 0);
+    } else {
+        make_rsp (buf, param);
+        assert_int_equal (pcap_print (ctx, buf, RSP_LEN, direction), 0);
+    }
+}
+
+static void
+record_exchange (pcap_buider_ctx *ctx, TPM2_CC cc, uint16_t param)
+{
+    record (ctx, cc, param, PCAP_DIR_HOST_TO_TPM);
+    record (ctx, cc, param, PCAP_DIR_TPM_TO_HOST);
+}
+
+/* GetRandom 1, GetCapability 2, GetRandom 3 */
+static void
+record_capture (void)
+{
+    pcap_buider_ctx ctx;
+
+    assert_int_equal (pcap_init (&ctx), 0);
+    record_exchange (&ctx, TPM2_CC_GetRandom, 1);
+    record_exchange (&ctx, TPM2_CC_GetCapability, 2);
+    record_exchange (&ctx, TPM2_CC_GetRandom, 3);
+    pcap_deinit (&ctx);
+}
+
+static TSS2_TCTI_CONTEXT *
+replay_init (const char *mode, TSS2_RC expected)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size;
+    TSS2_RC rc;
+
+    assert_int_equal (Tss2_Tcti_Replay_Init (NULL, &size, NULL),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (size, sizeof (TSS2_TCTI_REPLAY_CONTEXT));
+    ctx = calloc (1, size);
+    assert_non_null (ctx);
+
+    snprintf (conf, sizeof (conf), "file=%s,mode=%s", path, mode);
+    rc = Tss2_Tcti_Replay_Init (ctx, &size, conf);
+    assert_int_equal (rc, expected);
+    if (rc != TSS2_RC_SUCCESS) {
+        free (ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void
+replay_finalize (TSS2_TCTI_CONTEXT *ctx)
+{
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
+
+/* Transmit a command and check that the recorded response is received. */
+static void
+replay (TSS2_TCTI_CONTEXT *ctx, TPM2_CC cc, uint16_t param,
+        uint16_t rsp_param)
+{
+    uint8_t cmd[CMD_LEN], expected[RSP_LEN], rsp[RSP_LEN + 1];
+    size_t size = sizeof (rsp);
+
+    make_cmd (cmd, cc, param);
+    make_rsp (expected, rsp_param);
+    assert_int_equal (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (Tss2_Tcti_Receive (ctx, &size, rsp,
+                                         TSS2_TCTI_TIMEOUT_BLOCK),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (size, RSP_LEN);
+    assert_memory_equal (rsp, expected, RSP_LEN);
+}
+
+static void
+replay_fails (TSS2_TCTI_CONTEXT *ctx, TPM2_CC cc, uint16_t param)
+{
+    uint8_t cmd[CMD_LEN];
+
+    make_cmd (cmd, cc, param);
+    assert_int_equal (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd),
+                      TSS2_TCTI_RC_GENERAL_FAILURE);
+}
+
+static int
+setup (void **state)
+{
+    snprintf (path, sizeof (path), "%s/capture.pcap", dir);
+    setenv (ENV_PCAP_FILE, path, 1);
+    return 0;
+}
+
+static int
+teardown (void **state)
+{
+    unlink (path);
+    return 0;
+}
+
+static void
+test_init_conf (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    size_t size = sizeof (TSS2_TCTI_REPLAY_CONTEXT);
+
+    assert_int_equal (Tss2_Tcti_Replay_Init (NULL, NULL, NULL),
+                      TSS2_TCTI_RC_BAD_VALUE);
+
+    /* the capture does not exist yet */
+    assert_null (replay_init ("strict", TSS2_TCTI_RC_IO_ERROR));
+
+    record_capture ();
+    assert_null (replay_init ("fast", TSS2_TCTI_RC_BAD_VALUE));
+
+    ctx = calloc (1, size);
+    assert_non_null (ctx);
+    assert_int_equal (Tss2_Tcti_Replay_Init (ctx, &size, "speed=high"),
+                      TSS2_TCTI_RC_BAD_VALUE);
+
+    /* without a file the capture of tcti-pcap is used */
+    assert_int_equal (Tss2_Tcti_Replay_Init (ctx, &size, NULL),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (((TSS2_TCTI_REPLAY_CONTEXT *) ctx)->num_exchanges, 3);
+    replay_finalize (ctx);
+}
+
+static void
+test_init_bad_file (void **state)
+{
+    static const uint8_t not_pcap[16] = "not a capture";
+    FILE *f;
+
+    f = fopen (path, "wb");
+    assert_non_null (f);
+    fclose (f);
+    assert_null (replay_init ("strict", TSS2_TCTI_RC_BAD_VALUE));
+
+    f = fopen (path, "wb");
+    assert_non_null (f);
+    assert_int_equal (fwrite (not_pcap, 1, sizeof (not_pcap), f),
+                      sizeof (not_pcap));
+    fclose (f);
+    assert_null (replay_init ("strict", TSS2_TCTI_RC_BAD_VALUE));
+}
+
+static void
+test_strict (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+
+    record_capture ();
+    ctx = replay_init ("strict", TSS2_RC_SUCCESS);
+
+    replay (ctx, TPM2_CC_GetRandom, 1, 1);
+    /* out of sequence */
+    replay_fails (ctx, TPM2_CC_GetRandom, 3);
+    /* other parameters */
+    replay_fails (ctx, TPM2_CC_GetCapability, 7);
+    replay (ctx, TPM2_CC_GetCapability, 2, 2);
+    replay (ctx, TPM2_CC_GetRandom, 3, 3);
+    /* the capture is exhausted */
+    replay_fails (ctx, TPM2_CC_GetRandom, 1);
+
+    replay_finalize (ctx);
+}
+
+static void
+test_lenient (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+
+    record_capture ();
+    ctx = replay_init ("lenient", TSS2_RC_SUCCESS);
+
+    replay (ctx, TPM2_CC_GetCapability, 7, 2);
+    replay (ctx, TPM2_CC_GetRandom, 8, 1);
+    replay (ctx, TPM2_CC_GetRandom, 9, 3);
+    replay_fails (ctx, TPM2_CC_GetRandom, 1);
+    replay_fails (ctx, TPM2_CC_GetCapability, 2);
+    replay_fails (ctx, TPM2_CC_Startup, 0);
+
+    replay_finalize (ctx);
+}
+
+static void
+test_receive (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    uint8_t cmd[CMD_LEN], rsp[RSP_LEN];
+    size_t size = 0;
+
+    record_capture ();
+    ctx = replay_init ("strict", TSS2_RC_SUCCESS);
+
+    size = sizeof (rsp);
+    assert_int_equal (Tss2_Tcti_Receive (ctx, &size, rsp, 0),
+                      TSS2_TCTI_RC_BAD_SEQUENCE);
+
+    make_cmd (cmd, TPM2_CC_GetRandom, 1);
+    assert_int_equal (Tss2_Tcti_Transmit (ctx, CMD_LEN - 1, cmd),
+                      TSS2_TCTI_RC_BAD_VALUE);
+    assert_int_equal (Tss2_Tcti_Transmit (ctx, sizeof (cmd), cmd),
+                      TSS2_RC_SUCCESS);
+
+    /* partial read */
+    size = 0;
+    assert_int_equal (Tss2_Tcti_Receive (ctx, &size, NULL, 0),
+                      TSS2_RC_SUCCESS);
+    assert_int_equal (size, RSP_LEN);
+    size = RSP_LEN - 1;
+    assert_int_equal (Tss2_Tcti_Receive (ctx, &size, rsp, 0),
+                      TSS2_TCTI_RC_INSUFFICIENT_BUFFER);
+    assert_int_equal (size, RSP_LEN);
+    assert_int_equal (Tss2_Tcti_Receive (ctx, &size, rsp, 0),
+                      TSS2_RC_SUCCESS);
+
+    assert_int_equal (Tss2_Tcti_SetLocality (ctx, 0), TSS2_RC_SUCCESS);
+    replay (ctx, TPM2_CC_GetCapability, 2, 2);
+
+    replay_finalize (ctx);
+}
+
+/*
+ * Two recordings appended to the same file, one of them with interleaved
+ * connections and a command that was never answered.
+ */
+static void
+test_connections (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    pcap_buider_ctx a, b;
+
+    assert_int_equal (pcap_init (&a), 0);
+    record_exchange (&a, TPM2_CC_GetRandom, 1);
+    pcap_deinit (&a);
+
+    assert_int_equal (pcap_init (&a), 0);
+    assert_int_equal (pcap_init (&b), 0);
+    record (&a, TPM2_CC_GetRandom, 2, PCAP_DIR_HOST_TO_TPM);
+    record (&b, TPM2_CC_GetCapability, 3, PCAP_DIR_HOST_TO_TPM);
+    record (&a, TPM2_CC_GetRandom, 2, PCAP_DIR_TPM_TO_HOST);
+    record (&a, TPM2_CC_Startup, 4, PCAP_DIR_HOST_TO_TPM);
+    record (&b, TPM2_CC_GetCapability, 3, PCAP_DIR_TPM_TO_HOST);
+    pcap_deinit (&b);
+    pcap_deinit (&a);
+
+    ctx = replay_init ("strict", TSS2_RC_SUCCESS);
+    assert_int_equal (((TSS2_TCTI_REPLAY_CONTEXT *) ctx)->num_exchanges, 3);
+    replay (ctx, TPM2_CC_GetRandom, 1, 1);
+    replay (ctx, TPM2_CC_GetRandom, 2, 2);
+    replay (ctx, TPM2_CC_GetCapability, 3, 3);
+    replay_fails (ctx, TPM2_CC_Startup, 4);
+    replay_finalize (ctx);
+}
+
+/* A capture whose last block was not written completely. */
+static void
+test_truncated (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx;
+    struct stat st;
+
+    record_capture ();
+    assert_int_equal (stat (path, &st), 0);
+    assert_int_equal (truncate (path, st.st_size - 4), 0);
+
+    ctx = replay_init ("strict", TSS2_RC_SUCCESS);
+    replay (ctx, TPM2_CC_GetRandom, 1, 1);
+    replay (ctx, TPM2_CC_GetCapability, 2, 2);
+    replay_fails (ctx, TPM2_CC_GetRandom, 3);
+    replay_finalize (ctx);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown (test_init_conf, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_init_bad_file, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_strict, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_lenient, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_receive, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_connections, setup, teardown),
+        cmocka_unit_test_setup_teardown (test_truncated, setup, teardown),
+    };
+    int ret;
+
+    if (mkdtemp (dir) == NULL) {
+        return EXIT_FAILURE;
+    }
+    ret = cmocka_run_group_tests (tests, NULL, NULL);
+    rmdir (dir);
+    return ret;
+}
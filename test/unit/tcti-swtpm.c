@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <poll.h>
 #include <setjmp.h>
 #include <cmocka.h>
 
@@ -137,6 +138,53 @@ conf_str_to_host_port_invalid_port_0_test (void **state)
     assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
 }
 
+/*
+ * The 'keepalive' key accepts "1" and "0" and rejects anything else.
+ */
+static void
+conf_str_keepalive_test (void **state)
+{
+    TSS2_RC rc;
+    char conf_on[] = "host=127.0.0.1,keepalive=1";
+    char conf_off[] = "keepalive=0";
+    char conf_bad[] = "keepalive=yes";
+    swtpm_conf_t swtpm_conf = { 0 };
+
+    rc = parse_key_value_string (conf_on, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_true (swtpm_conf.keepalive);
+
+    rc = parse_key_value_string (conf_off, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_false (swtpm_conf.keepalive);
+
+    rc = parse_key_value_string (conf_bad, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+/*
+ * The 'path' and 'ctrl_path' keys select the Unix domain sockets of the
+ * swtpm. Paths that do not fit into a socket address are rejected.
+ */
+static void
+conf_str_unix_path_test (void **state)
+{
+    TSS2_RC rc;
+    char conf[] = "path=/run/swtpm/tpm.sock,ctrl_path=/run/swtpm/ctrl.sock";
+    char conf_long[TCTI_SWTPM_SOCKET_PATH_MAX + sizeof ("path=")];
+    swtpm_conf_t swtpm_conf = { 0 };
+
+    rc = parse_key_value_string (conf, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+    assert_string_equal (swtpm_conf.path, "/run/swtpm/tpm.sock");
+    assert_string_equal (swtpm_conf.ctrl_path, "/run/swtpm/ctrl.sock");
+
+    memset (conf_long, 'a', sizeof (conf_long) - 1);
+    memcpy (conf_long, "path=", strlen ("path="));
+    conf_long [sizeof (conf_long) - 1] = '\0';
+    rc = parse_key_value_string (conf_long, swtpm_kv_callback, &swtpm_conf);
+    assert_int_equal (rc, TSS2_TCTI_RC_BAD_VALUE);
+}
+
 /* When passed all NULL values ensure that we get back the expected RC. */
 static void
 tcti_swtpm_init_all_null_test (void **state)
@@ -200,6 +248,21 @@ __wrap_write (int sockfd,
 {
     return mock_type (TSS2_RC);
 }
+/*
+ * Wrap the 'poll' system call used to check idle keepalive sockets. The mock
+ * queue for this function must have an integer to return as a response. A
+ * positive value signals a readable socket, i.e. EOF from the peer.
+ */
+int
+__wrap_poll (struct pollfd *fds,
+             nfds_t nfds,
+             int timeout)
+{
+    int ret = mock_type (int);
+
+    fds->revents = ret > 0 ? POLLIN : 0;
+    return ret;
+}
 /*
  * This is a utility function used by other tests to setup a TCTI context. It
  * effectively wraps the init / allocate / init pattern as well as priming the
@@ -249,6 +312,15 @@ tcti_swtpm_setup (void **state)
     printf ("%s: done\n", __func__);
     return 0;
 }
+/*
+ * This is a utility function to setup a TCTI context in keepalive mode.
+ */
+static int
+tcti_swtpm_keepalive_setup (void **state)
+{
+    *state = tcti_swtpm_init_from_conf ("host=127.0.0.1,port=666,keepalive=1");
+    return 0;
+}
 static void
 tcti_swtpm_init_null_conf_test (void **state)
 {
@@ -256,6 +328,23 @@ tcti_swtpm_init_null_conf_test (void **state)
     assert_non_null (ctx);
     free (ctx);
 }
+/*
+ * Initialization with Unix domain sockets for the data and control channel.
+ */
+static void
+tcti_swtpm_init_unix_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = tcti_swtpm_init_from_conf (
+        "path=/run/swtpm/tpm.sock,ctrl_path=/run/swtpm/ctrl.sock");
+    TSS2_TCTI_SWTPM_CONTEXT *swtpm_ctx = (TSS2_TCTI_SWTPM_CONTEXT*)ctx;
+
+    assert_non_null (ctx);
+    assert_string_equal (swtpm_ctx->swtpm_conf.path, "/run/swtpm/tpm.sock");
+    assert_string_equal (swtpm_ctx->swtpm_conf.ctrl_path,
+                         "/run/swtpm/ctrl.sock");
+    Tss2_Tcti_Finalize (ctx);
+    free (ctx);
+}
 /*
  * This test excersises the Tss2_Tcti_Info function
  */
@@ -524,6 +613,85 @@ tcti_swtpm_transmit_success_test (void **state)
     rc = Tss2_Tcti_Transmit (ctx, command_size, command);
     assert_int_equal (rc, TSS2_RC_SUCCESS);
 }
+/*
+ * This test runs several command round trips in keepalive mode. The data
+ * socket that was connected during initialization is reused as long as the
+ * peer keeps it open, and a new connection is only made after EOF.
+ */
+static void
+tcti_swtpm_keepalive_roundtrip_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    uint8_t command [] = { 0x80, 0x02,
+                           0x00, 0x00, 0x00, 0x0c,
+                           0x00, 0x00, 0x00, 0x00,
+                           0x01, 0x02 };
+    uint8_t response_in [] = { 0x80, 0x02,
+                               0x00, 0x00, 0x00, 0x0c,
+                               0x00, 0x00, 0x00, 0x00,
+                               0x01, 0x02 };
+    uint8_t response_out [12] = { 0 };
+    size_t response_size;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (i < 2) {
+            /* idle socket is still connected, no connect */
+            will_return (__wrap_poll, 0);
+        } else {
+            /* peer closed the idle socket, reconnect */
+            will_return (__wrap_poll, 1);
+            will_return (__wrap_connect, 0);
+        }
+        will_return (__wrap_write, sizeof (command));
+        rc = Tss2_Tcti_Transmit (ctx, sizeof (command), command);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+        will_return (__wrap_read, 10);
+        will_return (__wrap_read, response_in);
+        will_return (__wrap_read, sizeof (response_in) - 10);
+        will_return (__wrap_read, &response_in [10]);
+        response_size = sizeof (response_out);
+        rc = Tss2_Tcti_Receive (ctx, &response_size, response_out,
+                                TSS2_TCTI_TIMEOUT_BLOCK);
+        assert_int_equal (rc, TSS2_RC_SUCCESS);
+        assert_memory_equal (response_in, response_out, response_size);
+    }
+}
+/*
+ * In keepalive mode the control socket stays open across control commands,
+ * too.
+ */
+static void
+tcti_swtpm_keepalive_locality_test (void **state)
+{
+    TSS2_TCTI_CONTEXT *ctx = (TSS2_TCTI_CONTEXT*)*state;
+    TSS2_RC rc = TSS2_RC_SUCCESS;
+    uint32_t response = 0x00000000;
+
+    will_return (__wrap_poll, 0);
+    will_return (__wrap_write, 5);
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, (uint8_t *) &response);
+    rc = Tss2_Tcti_SetLocality (ctx, 3);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+
+    /* a failed read drops the connection, the next command reconnects */
+    will_return (__wrap_poll, 0);
+    will_return (__wrap_write, 5);
+    will_return (__wrap_read, 0);
+    will_return (__wrap_read, (uint8_t *) &response);
+    rc = Tss2_Tcti_SetLocality (ctx, 2);
+    assert_int_equal (rc, TSS2_TCTI_RC_IO_ERROR);
+
+    will_return (__wrap_connect, 0);
+    will_return (__wrap_write, 5);
+    will_return (__wrap_read, 4);
+    will_return (__wrap_read, (uint8_t *) &response);
+    rc = Tss2_Tcti_SetLocality (ctx, 2);
+    assert_int_equal (rc, TSS2_RC_SUCCESS);
+}
 /*
  * This test exercises the NULL checks of the transmit function.
  */
@@ -717,9 +885,12 @@ main (int   argc,
         cmocka_unit_test (conf_str_to_host_ipv6_port_no_port_test),
         cmocka_unit_test (conf_str_to_host_port_invalid_port_large_test),
         cmocka_unit_test (conf_str_to_host_port_invalid_port_0_test),
+        cmocka_unit_test (conf_str_keepalive_test),
+        cmocka_unit_test (conf_str_unix_path_test),
         cmocka_unit_test (tcti_swtpm_init_all_null_test),
         cmocka_unit_test (tcti_swtpm_init_size_test),
         cmocka_unit_test (tcti_swtpm_init_null_conf_test),
+        cmocka_unit_test (tcti_swtpm_init_unix_test),
         cmocka_unit_test (tcti_swtpm_get_info_test),
         cmocka_unit_test_setup_teardown (tcti_swtpm_init_fail_connect_test,
                                          tcti_swtpm_setup,
@@ -751,6 +922,12 @@ main (int   argc,
         cmocka_unit_test_setup_teardown (tcti_swtpm_transmit_success_test,
                                          tcti_swtpm_setup,
                                          tcti_swtpm_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swtpm_keepalive_roundtrip_test,
+                                         tcti_swtpm_keepalive_setup,
+                                         tcti_swtpm_teardown),
+        cmocka_unit_test_setup_teardown (tcti_swtpm_keepalive_locality_test,
+                                         tcti_swtpm_keepalive_setup,
+                                         tcti_swtpm_teardown),
         cmocka_unit_test_setup_teardown (tcti_swtpm_transmit_null_test,
                                          tcti_swtpm_setup,
                                          tcti_swtpm_teardown),